@@ -0,0 +1,221 @@
+#include "AllocationTracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+namespace
+{
+
+constexpr const char* subsystemNames[] = {
+    "other",
+    "input",
+    "simulation",
+    "frame_build",
+    "render",
+    "gui",
+    "resources"
+};
+
+static_assert(std::size(subsystemNames) == AllocationStats::NUM_SUBSYSTEMS);
+
+// One cache line per subsystem, so that threads allocating for different subsystems do not
+// contend.
+struct alignas(64) SubsystemCounters
+{
+    std::atomic<uint64_t> Count = 0;
+    std::atomic<uint64_t> Bytes = 0;
+};
+
+// Constant-initialized, so counting works for allocations made before main().
+std::array<SubsystemCounters, AllocationStats::NUM_SUBSYSTEMS> g_counters;
+
+thread_local AllocationSubsystem t_subsystem = AllocationSubsystem::Other;
+thread_local uint64_t t_numAllocations = 0;
+
+void Track(size_t size)
+{
+    SubsystemCounters& counters = g_counters[static_cast<size_t>(t_subsystem)];
+
+    counters.Count.fetch_add(1, std::memory_order_relaxed);
+    counters.Bytes.fetch_add(size, std::memory_order_relaxed);
+
+    ++t_numAllocations;
+}
+
+void* Allocate(size_t size)
+{
+    Track(size);
+
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* AllocateAligned(size_t size, std::align_val_t alignment)
+{
+    Track(size);
+
+    auto align = static_cast<size_t>(alignment);
+
+#ifdef _MSC_VER
+    void* ptr = _aligned_malloc(size ? size : 1, align);
+#else
+    // aligned_alloc() needs the size to be a multiple of the alignment.
+    void* ptr = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) & ~(align - 1));
+#endif
+
+    if (!ptr)
+        throw std::bad_alloc();
+
+    return ptr;
+}
+
+void FreeAligned(void* ptr)
+{
+#ifdef _MSC_VER
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+} // namespace
+
+uint64_t AllocationStats::GetTotalCount() const
+{
+    uint64_t total = 0;
+
+    for (uint64_t count : Counts)
+    {
+        total += count;
+    }
+
+    return total;
+}
+
+uint64_t AllocationStats::GetTotalBytes() const
+{
+    uint64_t total = 0;
+
+    for (uint64_t bytes : Bytes)
+    {
+        total += bytes;
+    }
+
+    return total;
+}
+
+AllocationStats AllocationStats::Since(const AllocationStats& earlier) const
+{
+    AllocationStats stats;
+
+    for (size_t i = 0; i < NUM_SUBSYSTEMS; ++i)
+    {
+        stats.Counts[i] = Counts[i] - earlier.Counts[i];
+        stats.Bytes[i] = Bytes[i] - earlier.Bytes[i];
+    }
+
+    return stats;
+}
+
+AllocationStats AllocationTracker::GetStats()
+{
+    AllocationStats stats;
+
+    for (size_t i = 0; i < AllocationStats::NUM_SUBSYSTEMS; ++i)
+    {
+        stats.Counts[i] = g_counters[i].Count.load(std::memory_order_relaxed);
+        stats.Bytes[i] = g_counters[i].Bytes.load(std::memory_order_relaxed);
+    }
+
+    return stats;
+}
+
+uint64_t AllocationTracker::GetThreadCount()
+{
+    return t_numAllocations;
+}
+
+AllocationSubsystem AllocationTracker::GetSubsystem()
+{
+    return t_subsystem;
+}
+
+void AllocationTracker::SetSubsystem(AllocationSubsystem subsystem)
+{
+    t_subsystem = subsystem;
+}
+
+const char* AllocationTracker::GetSubsystemName(AllocationSubsystem subsystem)
+{
+    return subsystemNames[static_cast<size_t>(subsystem)];
+}
+
+// The nothrow forms are left to the standard library, which implements them with these.
+
+void* operator new(size_t size)
+{
+    return Allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+    return Allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return AllocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return AllocateAligned(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    FreeAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    FreeAligned(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+    FreeAligned(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+    FreeAligned(ptr);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// What a heap allocation is charged to. Each thread charges its allocations to one subsystem at a
+// time, set with AllocationScope, and jobs are charged to the subsystem of the thread that
+// submitted them.
+enum class AllocationSubsystem : uint8_t
+{
+    Other,
+    Input,
+    Simulation,
+    FrameBuild,
+    Render,
+    Gui,
+    Resources,
+
+    Count
+};
+
+// Heap allocations made through operator new, per subsystem.
+struct AllocationStats
+{
+    static constexpr size_t NUM_SUBSYSTEMS = static_cast<size_t>(AllocationSubsystem::Count);
+
+    std::array<uint64_t, NUM_SUBSYSTEMS> Counts{};
+    std::array<uint64_t, NUM_SUBSYSTEMS> Bytes{};
+
+    uint64_t GetCount(AllocationSubsystem subsystem) const
+    {
+        return Counts[static_cast<size_t>(subsystem)];
+    }
+
+    uint64_t GetTotalCount() const;
+    uint64_t GetTotalBytes() const;
+
+    // The allocations made between |earlier| and these stats.
+    AllocationStats Since(const AllocationStats& earlier) const;
+};
+
+// Counts every heap allocation in the process. Its translation unit replaces the global operator
+// new and delete, so anything that calls into it - the app and the benchmarks - is tracked. An
+// allocation costs one relaxed atomic add on top of malloc(). Frees are not tracked.
+class AllocationTracker
+{
+public:
+    // Totals since the process started, across all threads.
+    static AllocationStats GetStats();
+
+    // Allocations made so far on the calling thread.
+    static uint64_t GetThreadCount();
+
+    // The subsystem the calling thread's allocations are charged to.
+    static AllocationSubsystem GetSubsystem();
+    static void SetSubsystem(AllocationSubsystem subsystem);
+
+    static const char* GetSubsystemName(AllocationSubsystem subsystem);
+};
+
+// Charges the calling thread's allocations to |subsystem| until destroyed.
+class AllocationScope
+{
+public:
+    explicit AllocationScope(AllocationSubsystem subsystem)
+        : m_prevSubsystem(AllocationTracker::GetSubsystem())
+    {
+        AllocationTracker::SetSubsystem(subsystem);
+    }
+
+    ~AllocationScope()
+    {
+        AllocationTracker::SetSubsystem(m_prevSubsystem);
+    }
+
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+
+private:
+    AllocationSubsystem m_prevSubsystem;
+};
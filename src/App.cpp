@@ -2,6 +2,8 @@
 
 #include "gen/ShaderPS.h"
 #include "gen/ShaderVS.h"
+#include "LoadProfiler.h"
+#include "Profiler.h"
 #include "Utils.h"
 
 #include <d3dx12.h>
@@ -15,19 +17,52 @@
 #include <glm/gtx/euler_angles.hpp>
 #pragma warning(pop)
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <map>
 #include <numbers>
+#include <utility>
 #include <vector>
 
 using winrt::check_bool;
 using winrt::check_hresult;
 using winrt::com_ptr;
 
-App::App(HWND hwnd, InputManager* inputManager)
-    : m_hwnd(hwnd), m_inputManager(inputManager)
+App::App(HWND hwnd, InputManager* inputManager, std::mutex* guiMutex)
+    : m_hwnd(hwnd), m_inputManager(inputManager), m_guiMutex(guiMutex)
 {
+    m_startTime = std::chrono::steady_clock::now();
+
+    AllocationScope allocationScope(AllocationSubsystem::Resources);
+
+    LoadProfiler::Get().Start();
+
     CreateDevice();
 
-    m_resourceManager = std::make_unique<GpuResourceManager>(m_device.get());
+    m_jobSystem = std::make_unique<JobSystem>();
+
+    m_resourceManager = std::make_unique<GpuResourceManager>(m_device.get(), m_jobSystem.get());
+
+    if (std::filesystem::exists(ASSET_ARCHIVE_PATH))
+        m_resourceManager->MountAssetArchive(ASSET_ARCHIVE_PATH, "assets");
+
+    m_pipelineCompiler = std::make_unique<D3D12PipelineCompiler>(m_device.get(), m_adapter.get());
+
+    m_pipelineStore = std::make_unique<PipelineStore>(m_pipelineCompiler->GetDriverHash());
+    {
+        LoadScope scope("LoadPipelineStore", PIPELINE_STORE_PATH);
+
+        m_pipelineStore->Load(PIPELINE_STORE_PATH);
+    }
+
+    m_pipelineCache = std::make_unique<PipelineCache>(m_pipelineCompiler.get(), m_jobSystem.get(),
+                                                      m_pipelineStore.get());
+
+    m_frameBuilder = std::make_unique<FrameBuilder>(m_jobSystem.get());
 
     CreateCmdQueueAndSwapChain();
 
@@ -39,27 +74,51 @@ App::App(HWND hwnd, InputManager* inputManager)
 
     CreateDepthTexture();
 
-    CreateConstantBuffer();
+    CreateInstanceBuffer();
 
-    m_debugPass = std::make_unique<DebugPass>(&m_scene, m_device.get(), m_resourceManager.get());
+    m_debugPass = std::make_unique<DebugPass>(&m_scene, m_device.get(), m_resourceManager.get(),
+                                              m_pipelineCompiler.get(), m_pipelineCache.get());
 
     m_camera = std::make_unique<Camera>(m_inputManager);
+    m_prevCameraState = m_camera->GetState();
+
+    CreateDefaultTexture();
+
+    if (STREAM_TEXTURES)
+        CreateTextureStreamer();
+
+    m_models.resize(2);
 
-    m_resourceManager->LoadGltfModel("assets/box/Box.gltf", &m_model);
+    m_resourceManager->LoadGltfModel("assets/box/Box.gltf", &m_models[BOX_MODEL_IDX],
+                                     m_textureStreamer.get());
 
-    m_resourceManager->LoadGltfModel("assets/sponza/Sponza.gltf", &m_sponza);
+    m_resourceManager->LoadGltfModel("assets/sponza/Sponza.gltf", &m_models[SPONZA_MODEL_IDX],
+                                     m_textureStreamer.get());
 
-    CreateMaterialBuffers();
+    CreateGeometryTable();
+
+    CreateMaterialTable();
+
+    CreateEntities();
 
     m_scene.LightPos = glm::vec3(0.f, 1.f, -1.5f);
 
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
+    {
+        LoadScope scope("InitGui");
+
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
 
-    ImGui_ImplWin32_Init(m_hwnd);
-    ImGui_ImplDX12_Init(m_device.get(), NUM_FRAMES, DXGI_FORMAT_R8G8B8A8_UNORM, m_guiSrvHeap.get(),
-                        m_guiSrvHeap->GetCPUDescriptorHandleForHeapStart(),
-                        m_guiSrvHeap->GetGPUDescriptorHandleForHeapStart());
+        ImGui_ImplWin32_Init(m_hwnd);
+        ImGui_ImplDX12_Init(m_device.get(), NUM_FRAMES, DXGI_FORMAT_R8G8B8A8_UNORM,
+                            m_guiSrvHeap.get(), m_guiSrvHeap->GetCPUDescriptorHandleForHeapStart(),
+                            m_guiSrvHeap->GetGPUDescriptorHandleForHeapStart());
+    }
+
+    m_constructedNs = LoadProfiler::Now();
+
+    // Starts the first textures loading before the first frame.
+    UpdateLoading(m_camera->GetState().Position);
 }
 
 App::~App()
@@ -68,10 +127,162 @@ App::~App()
     ImGui_ImplWin32_Shutdown();
 
     ImGui::DestroyContext();
+
+    // Closed while still loading, so the report covers what loaded until now.
+    if (!m_loaded)
+        WriteStartupReport();
+
+    // The store only saves compile time on the next launch, so failing to write it is not fatal.
+    try
+    {
+        m_pipelineStore->Save(PIPELINE_STORE_PATH);
+    }
+    catch (const std::exception&)
+    {
+    }
+}
+
+void App::UpdateLoading(const glm::vec3& eye)
+{
+    if (m_loaded)
+        return;
+
+    if (m_textureStreamer)
+    {
+        PROFILE_SCOPE("App::UpdateLoading");
+
+        AllocationScope allocationScope(AllocationSubsystem::Resources);
+
+        // A texture is as urgent as the most noticeable primitive that uses it.
+        m_streamPriorities.assign(m_textureStreamer->GetNumStreams(), 0.f);
+
+        m_scene.Entities.ForEach<const WorldTransform, const ModelInstance>(
+            [&](const WorldTransform& transform, const ModelInstance& instance) {
+                const Model& model = m_models[instance.ModelIdx];
+
+                if (!model.StreamsTextures)
+                    return;
+
+                for (const auto& mesh : model.Meshes)
+                {
+                    for (const auto& prim : mesh.Primitives)
+                    {
+                        if (prim.MaterialIdx < 0)
+                            continue;
+
+                        const Material& material = model.Materials[prim.MaterialIdx];
+                        float coverage = EstimateScreenCoverage(prim.BoundsMin, prim.BoundsMax,
+                                                                transform.WorldMat, eye);
+
+                        for (TextureId stream : {material.BaseColorTextureId,
+                                                 material.RoughnessTextureId,
+                                                 material.NormalTextureId})
+                        {
+                            if (stream >= 0)
+                            {
+                                float& priority = m_streamPriorities[stream];
+                                priority = std::max(priority, coverage);
+                            }
+                        }
+                    }
+                }
+            });
+
+        for (size_t i = 0; i < m_streamPriorities.size(); ++i)
+        {
+            m_textureStreamer->SetPriority(static_cast<uint32_t>(i), m_streamPriorities[i]);
+        }
+
+        size_t numChanged = 0;
+
+        {
+            std::lock_guard lock(m_materialsMutex);
+            numChanged = m_textureStreamer->Update(&m_materialTable);
+        }
+
+        // Render objects copy their material's base color texture, so they are rebuilt.
+        if (numChanged > 0)
+            m_syncedStructureVersion.reset();
+
+        TextureStreamer::Stats stats = m_textureStreamer->GetStats();
+        m_numTexturesStreamed = stats.NumLoaded + stats.NumFailed;
+        m_numTexturesToStream = m_textureStreamer->GetNumStreams();
+
+        if (!m_textureStreamer->IsDone())
+            return;
+    }
+
+    if (!m_firstFramePresented)
+        return;
+
+    m_loaded = true;
+    m_loadedMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - m_startTime).count();
+
+    // The main thread was waiting on the textures and the first frame since the constructor
+    // returned, so the critical path follows whichever finished last.
+    LoadSpan span;
+    span.Stage = "WaitLoaded";
+    span.Kind = LoadSpanKind::Wait;
+    span.ThreadIdx = LoadProfiler::GetThreadIdx();
+    span.StartNs = m_constructedNs;
+    span.EndNs = LoadProfiler::Now();
+
+    LoadProfiler::Get().AddSpan(std::move(span));
+    LoadProfiler::Get().AddMilestone("FullyLoaded");
+
+    WriteStartupReport();
+}
+
+void App::CreateDefaultTexture()
+{
+    LoadScope scope("CreateDefaultTexture");
+
+    constexpr std::byte white[] = {std::byte{0xff}, std::byte{0xff}, std::byte{0xff},
+                                   std::byte{0xff}};
+
+    GpuResourceManager::StagedTexture texture = m_resourceManager->StageTexture(1, 1, white);
+    m_defaultTexture = m_resourceManager->UploadTexture(texture);
+}
+
+void App::CreateTextureStreamer()
+{
+    LoadScope scope("CreateTextureStreamer");
+
+    TextureId placeholderId = m_defaultTexture->GetId();
+
+    auto load = [this](const std::filesystem::path& path) {
+        return m_resourceManager->LoadTexture(path);
+    };
+
+    auto getId = [](const RegisteredResource& texture) {
+        return static_cast<const GpuTextureRef&>(texture).GetId();
+    };
+
+    m_textureStreamer = std::make_unique<TextureStreamer>(load, getId, placeholderId,
+                                                          MAX_STREAMING_TEXTURES);
+}
+
+void App::WriteStartupReport()
+{
+    LoadTrace trace = LoadProfiler::Get().Stop();
+    LoadReport report = AnalyzeLoadTrace(trace);
+
+    // Like the pipeline store, the report is only for looking at later.
+    try
+    {
+        WriteLoadReport(report, STARTUP_REPORT_PATH);
+        WriteLoadChromeTrace(trace, report, STARTUP_TRACE_PATH);
+    }
+    catch (const std::exception&)
+    {
+    }
 }
 
 void App::CreateDevice()
 {
+    LoadScope scope("CreateDevice");
+
     com_ptr<ID3D12Debug1> debugController;
     check_hresult(D3D12GetDebugInterface(IID_PPV_ARGS(debugController.put())));
 
@@ -82,23 +293,23 @@ void App::CreateDevice()
 
     static constexpr D3D_FEATURE_LEVEL featureLevel = D3D_FEATURE_LEVEL_12_1;
 
-    com_ptr<IDXGIAdapter1> adapter;
-
     for (uint32_t adapterIdx = 0;
          m_factory->EnumAdapterByGpuPreference(adapterIdx, DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE,
-                                               IID_PPV_ARGS(adapter.put())) != DXGI_ERROR_NOT_FOUND;
+                                               IID_PPV_ARGS(m_adapter.put())) != DXGI_ERROR_NOT_FOUND;
         ++adapterIdx)
     {
-        if (SUCCEEDED(D3D12CreateDevice(adapter.get(), featureLevel, _uuidof(ID3D12Device),
+        if (SUCCEEDED(D3D12CreateDevice(m_adapter.get(), featureLevel, _uuidof(ID3D12Device),
                                         nullptr)))
             break;
     }
 
-    check_hresult(D3D12CreateDevice(adapter.get(), featureLevel, IID_PPV_ARGS(m_device.put())));
+    check_hresult(D3D12CreateDevice(m_adapter.get(), featureLevel, IID_PPV_ARGS(m_device.put())));
 }
 
 void App::CreateCmdQueueAndSwapChain()
 {
+    LoadScope scope("CreateCmdQueueAndSwapChain");
+
     D3D12_COMMAND_QUEUE_DESC queueDesc{};
     queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
 
@@ -136,6 +347,8 @@ void App::CreateCmdQueueAndSwapChain()
 
 void App::CreateCommandList()
 {
+    LoadScope scope("CreateCommandList");
+
     check_hresult(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
                                                    IID_PPV_ARGS(m_cmdAlloc.put())));
 
@@ -167,64 +380,51 @@ void App::CreateCommandList()
 
 void App::CreatePipelineState()
 {
+    LoadScope scope("CreatePipelineState");
+
     CD3DX12_DESCRIPTOR_RANGE1 ranges[2];
     ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
     ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 1, 0);
 
-    CD3DX12_ROOT_PARAMETER1 rootParams[4];
-    rootParams[0].InitAsConstantBufferView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE,
-                                           D3D12_SHADER_VISIBILITY_ALL);
-    rootParams[1].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_PIXEL);
-    rootParams[2].InitAsDescriptorTable(1, &ranges[1], D3D12_SHADER_VISIBILITY_PIXEL);
-    rootParams[3].InitAsConstantBufferView(1, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE,
-                                           D3D12_SHADER_VISIBILITY_ALL);
+    CD3DX12_ROOT_PARAMETER1 rootParams[3];
+    rootParams[0].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_PIXEL);
+    rootParams[1].InitAsDescriptorTable(1, &ranges[1], D3D12_SHADER_VISIBILITY_PIXEL);
+    // Materials edited at runtime are uploaded before the draws that read them.
+    rootParams[2].InitAsShaderResourceView(
+        1, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE,
+        D3D12_SHADER_VISIBILITY_PIXEL);
 
     CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSigDesc;
     rootSigDesc.Init_1_1(_countof(rootParams), rootParams, 0, nullptr,
                          D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
-    com_ptr<ID3DBlob> signatureBlob;
-    com_ptr<ID3DBlob> errorBlob;
-    check_hresult(D3D12SerializeVersionedRootSignature(&rootSigDesc, signatureBlob.put(),
-                                                       errorBlob.put()));
-    check_hresult(m_device->CreateRootSignature(0, signatureBlob->GetBufferPointer(),
-                                                signatureBlob->GetBufferSize(),
-                                                IID_PPV_ARGS(m_rootSig.put())));
-
-    D3D12_INPUT_ELEMENT_DESC inputElementDescs[] = {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,
-         D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-        {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-         0},
-        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 2, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-         0}
+    m_rootSig = m_pipelineCompiler->CreateRootSignature(rootSigDesc, &m_rootSigHash);
+
+    PipelineDesc pipelineDesc{};
+    pipelineDesc.RootSignature = m_rootSig.get();
+    pipelineDesc.RootSignatureHash = m_rootSigHash;
+    pipelineDesc.VS = {g_shaderVS, sizeof(g_shaderVS)};
+    pipelineDesc.PS = {g_shaderPS, sizeof(g_shaderPS)};
+    pipelineDesc.InputLayout = {
+        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0},
+        {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 0},
+        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 2, 0},
+        {"INSTANCE_TRANSFORM", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 3, 0, 1},
+        {"INSTANCE_TRANSFORM", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 3, 16, 1},
+        {"INSTANCE_TRANSFORM", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 3, 32, 1},
+        {"INSTANCE_TRANSFORM", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 3, 48, 1},
+        {"INSTANCE_MATERIAL", 0, DXGI_FORMAT_R32_UINT, 3, offsetof(InstanceData, MaterialIdx), 1}
     };
+    pipelineDesc.RenderTargetFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+    pipelineDesc.DepthFormat = DXGI_FORMAT_D32_FLOAT;
 
-    D3D12_INPUT_LAYOUT_DESC inputLayoutDesc{};
-    inputLayoutDesc.pInputElementDescs = inputElementDescs;
-    inputLayoutDesc.NumElements = _countof(inputElementDescs);
-
-    D3D12_GRAPHICS_PIPELINE_STATE_DESC pipelineDesc{};
-    pipelineDesc.InputLayout = inputLayoutDesc;
-    pipelineDesc.pRootSignature = m_rootSig.get();
-    pipelineDesc.VS = CD3DX12_SHADER_BYTECODE(g_shaderVS, ARRAYSIZE(g_shaderVS));
-    pipelineDesc.PS = CD3DX12_SHADER_BYTECODE(g_shaderPS, ARRAYSIZE(g_shaderPS));;
-    pipelineDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-    pipelineDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-    pipelineDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
-    pipelineDesc.SampleMask = UINT_MAX;
-    pipelineDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-    pipelineDesc.NumRenderTargets = 1;
-    pipelineDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-    pipelineDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
-    pipelineDesc.SampleDesc.Count = 1;
-
-    check_hresult(m_device->CreateGraphicsPipelineState(&pipelineDesc,
-                                                        IID_PPV_ARGS(m_pipeline.put())));
+    m_pipelineRequest = m_pipelineCache->Request(pipelineDesc);
 }
 
 void App::CreateDescriptorHeaps()
 {
+    LoadScope scope("CreateDescriptorHeaps");
+
     {
         D3D12_DESCRIPTOR_HEAP_DESC heapDesc{};
         heapDesc.NumDescriptors = _countof(m_frames);
@@ -300,6 +500,8 @@ void App::CreateDescriptorHeaps()
 
 void App::CreateDepthTexture()
 {
+    LoadScope scope("CreateDepthTexture");
+
     CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_DEFAULT);
     CD3DX12_RESOURCE_DESC resourceDesc =
         CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, m_windowWidth, m_windowHeight, 1, 0, 1,
@@ -319,50 +521,257 @@ void App::CreateDepthTexture()
     m_device->CreateDepthStencilView(m_depthTexture.get(), &depthViewDesc, m_dsvHandle);
 }
 
-void App::CreateConstantBuffer()
+void App::CreateInstanceBuffer()
 {
-    m_constantBuffer = m_resourceManager->CreateConstantBuffer(sizeof(Constants), 1);
+    LoadScope scope("CreateInstanceBuffer");
 
-    check_hresult(m_constantBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_constantsPtr)));
+    m_instanceBuffer = m_resourceManager->CreateConstantBuffer(sizeof(InstanceData) * MAX_INSTANCES,
+                                                               NUM_FRAMES,
+                                                               &m_instanceBufferStride);
+
+    check_hresult(m_instanceBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_instancesPtr)));
 
     m_projMat = glm::perspective(
         std::numbers::pi_v<float> / 4.f,
         static_cast<float>(m_windowWidth) / static_cast<float>(m_windowHeight), 0.1f, 1000.f);
 }
 
-void App::CreateMaterialBuffers()
+void App::CreateGeometryTable()
+{
+    LoadScope scope("CreateGeometryTable");
+
+    // Primitives whose welded contents matched share their ranges, and so one geometry index,
+    // letting their objects batch into the same instanced draws.
+    std::map<std::pair<D3D12_GPU_VIRTUAL_ADDRESS, D3D12_GPU_VIRTUAL_ADDRESS>, uint32_t> indices;
+
+    for (const Model& model : m_models)
+    {
+        std::vector<uint32_t>& modelGeometry = m_modelGeometry.emplace_back();
+
+        for (const auto& mesh : model.Meshes)
+        {
+            for (const auto& prim : mesh.Primitives)
+            {
+                auto [it, inserted] = indices.try_emplace(
+                    {prim.Positions.BufferLocation, prim.Indices.BufferLocation},
+                    static_cast<uint32_t>(m_geometry.size()));
+
+                if (inserted)
+                    m_geometry.push_back(&prim);
+
+                modelGeometry.push_back(it->second);
+            }
+        }
+    }
+}
+
+void App::CreateMaterialTable()
 {
-    m_materialsBuffer = m_resourceManager->CreateConstantBuffer(sizeof(Material),
-                                                                m_sponza.Materials.size(),
-                                                                &m_materialsBufferStride);
+    LoadScope scope("CreateMaterialTable");
 
-    std::byte* bytePtr = nullptr;
-    check_hresult(m_materialsBuffer->Map(0, nullptr, reinterpret_cast<void**>(&bytePtr)));
+    // The streamer fills in the texture IDs of streamed materials, the default texture included,
+    // as it is the streamer's placeholder.
+    auto addMaterial = [this](const Model& model, Material material) {
+        if (model.StreamsTextures)
+            return m_textureStreamer->AddMaterial(&m_materialTable, material);
 
-    for (const auto& material : m_sponza.Materials)
+        if (material.BaseColorTextureId < 0)
+            material.BaseColorTextureId = m_defaultTexture->GetId();
+
+        return m_materialTable.Add(material);
+    };
+
+    for (const Model& model : m_models)
     {
-        Material* materialPtr = reinterpret_cast<Material*>(bytePtr);
-        materialPtr->BaseColorFactor = material.BaseColorFactor;
+        std::vector<uint32_t>& indices = m_modelMaterials.emplace_back();
 
-        bytePtr += m_materialsBufferStride;
+        for (const auto& material : model.Materials)
+        {
+            indices.push_back(addMaterial(model, material));
+        }
     }
 
-    m_materialsBuffer->Unmap(0, nullptr);
+    // Tints for box instances, which keep the box's own textures.
+    constexpr glm::vec4 paletteColors[] = {
+        {0.90f, 0.30f, 0.25f, 1.f}, {0.95f, 0.65f, 0.20f, 1.f}, {0.90f, 0.85f, 0.30f, 1.f},
+        {0.35f, 0.75f, 0.35f, 1.f}, {0.25f, 0.65f, 0.80f, 1.f}, {0.35f, 0.40f, 0.85f, 1.f},
+        {0.65f, 0.35f, 0.80f, 1.f}, {0.85f, 0.85f, 0.85f, 1.f}
+    };
+
+    const std::vector<Material>& boxMaterials = m_models[BOX_MODEL_IDX].Materials;
+    Material paletteBase = boxMaterials.empty() ? Material{} : boxMaterials.front();
+
+    for (const glm::vec4& color : paletteColors)
+    {
+        Material material = paletteBase;
+        material.BaseColorFactor = color;
+
+        m_paletteMaterials.push_back(addMaterial(m_models[BOX_MODEL_IDX], material));
+    }
+
+    if (m_materialTable.GetSize() > MAX_MATERIALS)
+        throw std::runtime_error("Too many materials.");
+
+    // Everything added is dirty, so each frame uploads the whole table the first time it draws.
+    for (Frame& frame : m_frames)
+    {
+        // One element holding the whole table, which the shader reads with a stride of
+        // sizeof(MaterialRecord).
+        frame.MaterialsBuffer = m_resourceManager->CreateConstantBuffer(
+            sizeof(MaterialRecord) * MAX_MATERIALS, 1);
+
+        check_hresult(frame.MaterialsBuffer->Map(0, nullptr,
+                                                 reinterpret_cast<void**>(&frame.MaterialsPtr)));
+    }
 }
 
-void App::Render()
+void App::CreateEntities()
 {
+    LoadScope scope("CreateEntities");
+
+    EntityStore& entities = m_scene.Entities;
+
+    m_sponzaWorldMat = glm::scale(glm::mat4(1.f), glm::vec3(0.008f));
+
+    entities.Create(WorldTransform{m_sponzaWorldMat}, ModelInstance{SPONZA_MODEL_IDX},
+                    RenderProxy{});
+
+    // Rows of spinning boxes along the atrium floor.
+    constexpr int numColumns = 32;
+    constexpr int numRows = 4;
+    constexpr float spacing = 0.75f;
+    constexpr float boxSize = 0.3f;
+
+    for (int row = 0; row < numRows; ++row)
+    {
+        for (int column = 0; column < numColumns; ++column)
+        {
+            glm::vec3 position((static_cast<float>(column) - (numColumns - 1) * 0.5f) * spacing,
+                               boxSize * 0.5f,
+                               (static_cast<float>(row) - (numRows - 1) * 0.5f) * spacing);
+
+            glm::mat4 worldMat = glm::scale(glm::translate(glm::mat4(1.f), position),
+                                            glm::vec3(boxSize));
+
+            auto materialIdx = static_cast<uint32_t>(column + row) % 8;
+
+            entities.Create(WorldTransform{worldMat}, ModelInstance{BOX_MODEL_IDX},
+                            MaterialOverride{m_paletteMaterials[materialIdx]},
+                            Spin{0.5f + 0.1f * static_cast<float>(row)}, RenderProxy{});
+        }
+    }
+}
+
+void App::SyncRenderObjects()
+{
+    PROFILE_SCOPE("App::SyncRenderObjects");
+
+    EntityStore& entities = m_scene.Entities;
+
+    // Only spinning instances move once added, so they are all that needs updating until
+    // entities are created, destroyed or change components.
+    if (m_syncedStructureVersion == entities.GetStructureVersion())
+    {
+        entities.ForEach<const WorldTransform, const Spin, const RenderProxy>(
+            [this](const WorldTransform& transform, const Spin&, const RenderProxy& proxy) {
+                m_frameBuilder->SetTransform(proxy.TransformIdx, transform.WorldMat);
+            });
+
+        return;
+    }
+
+    // Materials may be edited from the GUI meanwhile.
+    std::lock_guard lock(m_materialsMutex);
+
+    m_frameBuilder->Clear();
+
+    entities.ForEachChunk<const WorldTransform, const ModelInstance, RenderProxy>(
+        [this](const EntityStore::ChunkView& view) {
+            std::span<const WorldTransform> transforms = view.Get<const WorldTransform>();
+            std::span<const ModelInstance> instances = view.Get<const ModelInstance>();
+            std::span<const MaterialOverride> overrides = view.TryGet<const MaterialOverride>();
+            std::span<RenderProxy> proxies = view.Get<RenderProxy>();
+
+            for (size_t i = 0; i < view.GetCount(); ++i)
+            {
+                uint32_t transformIdx = m_frameBuilder->AddTransform(transforms[i].WorldMat);
+                proxies[i].TransformIdx = transformIdx;
+
+                uint32_t modelIdx = instances[i].ModelIdx;
+                const uint32_t* geometryIdx = m_modelGeometry[modelIdx].data();
+
+                for (const auto& mesh : m_models[modelIdx].Meshes)
+                {
+                    for (const auto& prim : mesh.Primitives)
+                    {
+                        uint32_t materialIdx = overrides.empty() ?
+                            m_modelMaterials[modelIdx][prim.MaterialIdx] :
+                            overrides[i].MaterialIdx;
+
+                        RenderObject object{};
+                        object.GeometryIdx = *geometryIdx++;
+                        object.MaterialIdx = materialIdx;
+                        object.BaseColorTextureId =
+                            m_materialTable.Get(materialIdx).BaseColorTextureId;
+                        object.IndexCount = static_cast<uint32_t>(prim.VertexCount);
+                        object.TransformIdx = transformIdx;
+                        object.LocalBoundsMin = prim.BoundsMin;
+                        object.LocalBoundsMax = prim.BoundsMax;
+
+                        m_frameBuilder->AddObject(object);
+                    }
+                }
+            }
+        });
+
+    m_syncedStructureVersion = entities.GetStructureVersion();
+}
+
+void App::RenderFrame(const FramePacket& packet)
+{
+    PROFILE_SCOPE("App::RenderFrame");
+
+    // Everything recorded this frame completes at the fence value that PresentFrame() signals.
+    m_resourceManager->CollectGarbage(m_fenceValue, m_fence->GetCompletedValue());
+
     BeginFrame();
 
-    DrawModels();
+    DrawModels(packet);
 
     RenderGui();
 
     PresentFrame();
+
+    // Measured to the hand-off to the swap chain. Scan-out adds up to one more refresh interval.
+    if (packet.OldestInputTimestamp >= 0)
+    {
+        m_latencyTracker.AddSample(
+            packet.OldestInputTimestamp,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    if (!m_firstFramePresented)
+    {
+        m_firstFrameMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - m_startTime).count();
+
+        LoadProfiler::Get().AddMilestone("FirstFrame");
+        m_firstFramePresented = true;
+    }
+
+    // Frames are delimited by presents, so the profiler is driven from here.
+    Profiler::Get().EndFrame();
+
+    AllocationStats allocationStats = AllocationTracker::GetStats();
+    m_frameAllocations = allocationStats.Since(m_prevAllocationStats);
+    m_prevAllocationStats = allocationStats;
 }
 
 void App::BeginFrame()
 {
+    PROFILE_SCOPE("App::BeginFrame");
+
     check_hresult(m_frames[m_currentFrame].BeginCmdAlloc->Reset());
     check_hresult(m_cmdList->Reset(m_frames[m_currentFrame].BeginCmdAlloc.get(), nullptr));
 
@@ -385,12 +794,52 @@ void App::BeginFrame()
     m_cmdQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
 }
 
-void App::DrawModels()
+void App::UploadMaterials()
+{
+    PROFILE_SCOPE("App::UploadMaterials");
+
+    Frame& frame = m_frames[m_currentFrame];
+
+    {
+        std::lock_guard lock(m_materialsMutex);
+
+        m_dirtyMaterialRanges.clear();
+        m_materialTable.TakeDirtyRanges(&m_dirtyMaterialRanges);
+
+        // Every frame's buffer is missing these, but only this one is safe to write now.
+        for (Frame& other : m_frames)
+        {
+            other.PendingMaterialRanges.insert(other.PendingMaterialRanges.end(),
+                                               m_dirtyMaterialRanges.begin(),
+                                               m_dirtyMaterialRanges.end());
+        }
+
+        std::span<const MaterialRecord> records = m_materialTable.GetRecords();
+        assert(records.size() <= MAX_MATERIALS);
+
+        for (const MaterialRange& range : frame.PendingMaterialRanges)
+        {
+            std::memcpy(frame.MaterialsPtr + range.First, records.data() + range.First,
+                        range.Count * sizeof(MaterialRecord));
+        }
+    }
+
+    frame.PendingMaterialRanges.clear();
+
+    m_cmdList->SetGraphicsRootShaderResourceView(2, frame.MaterialsBuffer->GetGPUVirtualAddress());
+}
+
+void App::DrawModels(const FramePacket& packet)
 {
-    glm::mat4 worldMat = glm::scale(glm::mat4(1.f), glm::vec3(0.008f));
+    PROFILE_SCOPE("App::DrawModels");
+
+    assert(packet.Instances.size() <= MAX_INSTANCES);
 
-    m_constantsPtr->WorldViewProjMatrix = m_projMat * m_camera->GetViewMat() * worldMat;
-    m_constantsPtr->LightPos = glm::vec4(m_scene.LightPos, 1.f);
+    // The GPU may still be reading the other frame's instances.
+    size_t frameOffset = m_currentFrame * m_instanceBufferStride;
+
+    std::memcpy(m_instancesPtr + frameOffset, packet.Instances.data(),
+                packet.Instances.size_bytes());
 
     check_hresult(m_frames[m_currentFrame].DrawCmdAlloc->Reset());
     check_hresult(m_cmdList->Reset(m_frames[m_currentFrame].DrawCmdAlloc.get(), nullptr));
@@ -400,7 +849,8 @@ void App::DrawModels()
     m_cmdList->RSSetViewports(1, &m_viewport);
     m_cmdList->RSSetScissorRects(1, &m_scissorRect);
 
-    m_cmdList->SetPipelineState(m_pipeline.get());
+    // Only blocks if the pipeline is still being created.
+    m_cmdList->SetPipelineState(GetD3D12PipelineState(m_pipelineRequest.Wait()));
     m_cmdList->SetGraphicsRootSignature(m_rootSig.get());
 
     ID3D12DescriptorHeap* descriptorHeaps[] = {
@@ -409,37 +859,21 @@ void App::DrawModels()
 
     m_cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-    m_cmdList->SetGraphicsRootConstantBufferView(0, m_constantBuffer->GetGPUVirtualAddress());
-    m_cmdList->SetGraphicsRootDescriptorTable(2, m_samplerGpuHandle);
-
-    for (const auto& mesh : m_sponza.Meshes)
-    {
-        for (const auto& prim : mesh.Primitives)
-        {
-            TextureId baseColorTextureId =
-                m_sponza.Materials[prim.MaterialIdx].BaseColorTextureId;
-
-            m_cmdList->SetGraphicsRootDescriptorTable(
-                1, m_resourceManager->GetTextureSrvHandle(baseColorTextureId));
+    m_cmdList->SetGraphicsRootDescriptorTable(1, m_samplerGpuHandle);
+    UploadMaterials();
 
-            D3D12_GPU_VIRTUAL_ADDRESS materialAddress = m_materialsBuffer->GetGPUVirtualAddress() +
-                prim.MaterialIdx * m_materialsBufferStride;
+    m_cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-            m_cmdList->SetGraphicsRootConstantBufferView(3, materialAddress);
+    D3D12_VERTEX_BUFFER_VIEW instancesView{};
+    instancesView.BufferLocation = m_instanceBuffer->GetGPUVirtualAddress() + frameOffset;
+    instancesView.SizeInBytes = static_cast<UINT>(packet.Instances.size_bytes());
+    instancesView.StrideInBytes = sizeof(InstanceData);
 
-            m_cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    m_cmdList->IASetVertexBuffers(3, 1, &instancesView);
 
-            m_cmdList->IASetVertexBuffers(0, 1, &prim.Positions);
-            m_cmdList->IASetVertexBuffers(1, 1, &prim.Normals);
-            m_cmdList->IASetVertexBuffers(2, 1, &prim.TexCoords);
+    ExecuteCommands(packet.Commands);
 
-            m_cmdList->IASetIndexBuffer(&prim.Indices);
-
-            m_cmdList->DrawIndexedInstanced(prim.VertexCount, 1, 0, 0, 0);
-        }
-    }
-
-    m_debugPass->RecordCommands(m_constantsPtr->WorldViewProjMatrix, m_cmdList.get());
+    m_debugPass->RecordCommands(packet.ViewProjMat * m_sponzaWorldMat, m_cmdList.get());
 
     check_hresult(m_cmdList->Close());
 
@@ -447,34 +881,69 @@ void App::DrawModels()
     m_cmdQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
 }
 
+void App::ExecuteCommands(std::span<const Command> commands)
+{
+    PROFILE_SCOPE("App::ExecuteCommands");
+
+    // Draws take the frame's instances in order.
+    uint32_t instanceCount = 1;
+    uint32_t firstInstance = 0;
+
+    for (const Command& cmd : commands)
+    {
+        switch (cmd.Type)
+        {
+            case CommandType::SetBaseColorTexture:
+                m_cmdList->SetGraphicsRootDescriptorTable(
+                    0, m_resourceManager->GetTextureSrvHandle(static_cast<TextureId>(cmd.Value)));
+                break;
+            case CommandType::SetGeometry:
+            {
+                const Primitive* prim = m_geometry[cmd.Value];
+
+                m_cmdList->IASetVertexBuffers(0, 1, &prim->Positions);
+                m_cmdList->IASetVertexBuffers(1, 1, &prim->Normals);
+                m_cmdList->IASetVertexBuffers(2, 1, &prim->TexCoords);
+
+                m_cmdList->IASetIndexBuffer(&prim->Indices);
+                break;
+            }
+            case CommandType::SetInstanceCount:
+                instanceCount = cmd.Value;
+                break;
+            case CommandType::DrawIndexed:
+                m_cmdList->DrawIndexedInstanced(cmd.Value, instanceCount, 0, 0, firstInstance);
+                firstInstance += instanceCount;
+                break;
+        }
+    }
+}
+
 void App::RenderGui()
 {
-    ImGui_ImplDX12_NewFrame();
-    ImGui_ImplWin32_NewFrame();
-    ImGui::NewFrame();
+    PROFILE_SCOPE("App::RenderGui");
 
-    // static bool showDemoWindow = true;
+    AllocationScope allocationScope(AllocationSubsystem::Gui);
 
-    // if (showDemoWindow)
-    // {
-    //     ImGui::ShowDemoWindow(&showDemoWindow);
-    // }
+    {
+        std::lock_guard lock(*m_guiMutex);
 
-    // static bool showWindow = true;
+        ImGui_ImplDX12_NewFrame();
+        ImGui_ImplWin32_NewFrame();
+        ImGui::NewFrame();
 
-    // static int mode = 0;
+        m_profilerWindow.Draw();
 
-    // if (showWindow)
-    // {
-    //     ImGui::Begin("Window", &showWindow);
+        DrawInputLatencyWindow();
 
-    //     ImGui::RadioButton("Static", &mode, 0);
-    //     ImGui::RadioButton("FPS", &mode, 1);
+        DrawResourcesWindow();
 
-    //     ImGui::End();
-    // }
+        DrawAllocationsWindow();
 
-    ImGui::Render();
+        DrawMaterialsWindow();
+
+        ImGui::Render();
+    }
 
     check_hresult(m_frames[m_currentFrame].GuiCmdAlloc->Reset());
     check_hresult(m_cmdList->Reset(m_frames[m_currentFrame].GuiCmdAlloc.get(), nullptr));
@@ -492,8 +961,114 @@ void App::RenderGui()
     m_cmdQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
 }
 
+void App::DrawInputLatencyWindow()
+{
+    InputLatencyTracker::Stats stats = m_latencyTracker.GetStats();
+
+    ImGui::Begin("Input");
+
+    ImGui::Text("Input to present (%zu frames)", stats.NumSamples);
+    ImGui::Text("p50 %.2f ms  p95 %.2f ms  p99 %.2f ms", stats.P50 * 1000.0, stats.P95 * 1000.0,
+                stats.P99 * 1000.0);
+    ImGui::Text("Dropped events: %zu", m_inputManager->GetDroppedEvents());
+
+    ImGui::End();
+}
+
+void App::DrawResourcesWindow()
+{
+    ResourceRegistry::Stats stats = m_resourceManager->GetResourceStats();
+
+    static constexpr double bytesPerMb = 1024.0 * 1024.0;
+
+    ImGui::Begin("Resources");
+
+    ImGui::Text("Live: %llu (%.1f MB)", stats.NumLive,
+                static_cast<double>(stats.LiveBytes) / bytesPerMb);
+    ImGui::Text("Pending destroy: %llu (%.1f MB)", stats.NumPendingDestroy,
+                static_cast<double>(stats.PendingDestroyBytes) / bytesPerMb);
+    ImGui::Text("Requests: %llu  coalesced: %llu", stats.NumRequests, stats.NumCoalesced);
+    ImGui::Text("Failed loads: %llu  destroyed: %llu", stats.NumFailedLoads, stats.NumDestroyed);
+
+    GpuResourceManager::TextureStats textureStats = m_resourceManager->GetTextureStats();
+
+    ImGui::Text("Texture files: %llu  decoded: %llu  uploaded: %llu", textureStats.NumFilesRead,
+                textureStats.NumDecoded, textureStats.NumUploaded);
+    ImGui::Text("Saved by sharing: %.1f MB",
+                static_cast<double>(textureStats.ReadBytes - textureStats.UploadedBytes) /
+                    bytesPerMb);
+
+    if (m_loadedMs >= 0.0)
+    {
+        ImGui::Text("First frame: %.0f ms  fully loaded: %.0f ms", m_firstFrameMs.load(),
+                    m_loadedMs.load());
+    }
+    else
+    {
+        ImGui::Text("Streaming textures: %llu of %llu", m_numTexturesStreamed.load(),
+                    m_numTexturesToStream.load());
+    }
+
+    GeometryStats geometryStats = m_resourceManager->GetGeometryStats();
+
+    ImGui::Text("Vertices: %llu  welded: %llu", geometryStats.NumVerticesBefore,
+                geometryStats.NumVerticesAfter);
+    ImGui::Text("Primitives: %llu  shared: %llu", geometryStats.NumPrimitives,
+                geometryStats.NumSharedPrimitives);
+    ImGui::Text("Saved by welding: %.1f MB",
+                static_cast<double>(geometryStats.BytesBefore - geometryStats.BytesAfter) /
+                    bytesPerMb);
+
+    ImGui::End();
+}
+
+void App::DrawAllocationsWindow()
+{
+    ImGui::Begin("Allocations");
+
+    ImGui::Text("Last frame: %llu (%llu bytes)", m_frameAllocations.GetTotalCount(),
+                m_frameAllocations.GetTotalBytes());
+
+    for (size_t i = 0; i < AllocationStats::NUM_SUBSYSTEMS; ++i)
+    {
+        ImGui::Text("%-12s %6llu %10llu bytes",
+                    AllocationTracker::GetSubsystemName(static_cast<AllocationSubsystem>(i)),
+                    m_frameAllocations.Counts[i], m_frameAllocations.Bytes[i]);
+    }
+
+    ImGui::End();
+}
+
+void App::DrawMaterialsWindow()
+{
+    std::lock_guard lock(m_materialsMutex);
+
+    ImGui::Begin("Materials");
+
+    ImGui::Text("Materials: %zu  deduplicated: %zu", m_materialTable.GetSize(),
+                m_materialTable.GetNumDeduplicated());
+
+    // Edits are uploaded to each frame's buffer before it next draws.
+    for (size_t i = 0; i < m_paletteMaterials.size(); ++i)
+    {
+        uint32_t idx = m_paletteMaterials[i];
+        Material material = m_materialTable.Get(idx);
+
+        ImGui::PushID(static_cast<int>(i));
+
+        if (ImGui::ColorEdit4("Box tint", &material.BaseColorFactor.x))
+            m_materialTable.Set(idx, material);
+
+        ImGui::PopID();
+    }
+
+    ImGui::End();
+}
+
 void App::PresentFrame()
 {
+    PROFILE_SCOPE("App::PresentFrame");
+
     check_hresult(m_frames[m_currentFrame].PresentCmdAlloc->Reset());
     check_hresult(m_cmdList->Reset(m_frames[m_currentFrame].PresentCmdAlloc.get(), nullptr));
 
@@ -521,6 +1096,8 @@ void App::PresentFrame()
 
     if (m_fence->GetCompletedValue() < m_frames[m_currentFrame].FenceWaitValue)
     {
+        PROFILE_SCOPE("WaitForFrameFence");
+
         check_hresult(m_fence->SetEventOnCompletion(m_frames[m_currentFrame].FenceWaitValue,
                                                     m_fenceEvent.get()));
 
@@ -545,7 +1122,42 @@ void App::ExecuteAndWait()
     WaitForSingleObjectEx(m_fenceEvent.get(), INFINITE, false);
 }
 
-void App::Tick(double elapsedSec)
+void App::Tick(double stepSec)
 {
-    m_camera->Tick(elapsedSec);
+    PROFILE_SCOPE("App::Tick");
+
+    m_prevCameraState = m_camera->GetState();
+
+    m_camera->Tick(stepSec);
+
+    auto step = static_cast<float>(stepSec);
+
+    m_scene.Entities.ForEach<WorldTransform, const Spin>(
+        [step](WorldTransform& transform, const Spin& spin) {
+            transform.WorldMat = glm::rotate(transform.WorldMat, spin.RadiansPerSec * step,
+                                             glm::vec3(0.f, 1.f, 0.f));
+        });
+}
+
+void App::BuildFramePacket(uint64_t frameIdx, float alpha, FramePacket* packet)
+{
+    PROFILE_SCOPE("App::BuildFramePacket");
+
+    AllocationScope allocationScope(AllocationSubsystem::FrameBuild);
+
+    CameraState cameraState = CameraState::Lerp(m_prevCameraState, m_camera->GetState(), alpha);
+
+    packet->FrameIdx = frameIdx;
+    packet->ViewMat = cameraState.GetViewMat();
+    packet->ProjMat = m_projMat;
+    packet->ViewProjMat = m_projMat * packet->ViewMat;
+    packet->LightPos = glm::vec4(m_scene.LightPos, 1.f);
+
+    UpdateLoading(cameraState.Position);
+
+    SyncRenderObjects();
+
+    m_frameBuilder->BuildFramePacket(packet);
+
+    packet->OldestInputTimestamp = m_inputManager->TakeOldestEventTimestamp();
 }
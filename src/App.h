@@ -1,10 +1,21 @@
 #pragma once
 
+#include "AllocationTracker.h"
 #include "Camera.h"
+#include "CommandStream.h"
+#include "D3D12PipelineCompiler.h"
 #include "DebugPass.h"
+#include "FrameBuilder.h"
 #include "GpuResourceManager.h"
 #include "InputManager.h"
+#include "JobSystem.h"
+#include "MaterialTable.h"
+#include "PipelineCache.h"
+#include "PipelineStore.h"
+#include "ProfilerWindow.h"
+#include "RenderThread.h"
 #include "Scene.h"
+#include "TextureStreamer.h"
 
 #include <d3d12.h>
 #include <dxgi1_6.h>
@@ -12,17 +23,33 @@
 #include <wil/resource.h>
 #include <winrt/base.h>
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <vector>
 
-class App
+// Simulation runs on the main thread, which hands a FramePacket per frame to the render thread.
+// Only the methods marked below may be called from the main thread once rendering has started.
+class App : public RenderBackend
 {
 public:
-    App(HWND hwnd, InputManager* inputManager);
+    // |guiMutex| guards ImGui state shared with the window message handler.
+    App(HWND hwnd, InputManager* inputManager, std::mutex* guiMutex);
     ~App();
 
-    void Render();
+    // Main thread. Advances the simulation by one fixed step.
+    void Tick(double stepSec);
 
-    void Tick(double elapsedSec);
+    // Main thread. Fills in |packet| for frame |frameIdx| with the scene |alpha| of the way from
+    // the previous to the current step.
+    void BuildFramePacket(uint64_t frameIdx, float alpha, FramePacket* packet);
+
+    // Render thread.
+    void RenderFrame(const FramePacket& packet) override;
 
 private:
     void CreateDevice();
@@ -37,21 +64,56 @@ private:
 
     void CreateDepthTexture();
 
-    void CreateConstantBuffer();
+    void CreateInstanceBuffer();
+
+    void CreateMaterialTable();
+
+    void CreateGeometryTable();
+
+    void CreateEntities();
+
+    // A 1x1 white texture. Every draw binds a base color texture, so materials without one draw
+    // with this, as do streamed materials until theirs has loaded.
+    void CreateDefaultTexture();
+
+    void CreateTextureStreamer();
+
+    // Main thread. Reprioritizes the textures still to load by how much of the view from |eye|
+    // they cover, swaps in those loaded, and once everything is loaded and the first frame is
+    // presented, writes the startup report.
+    void UpdateLoading(const glm::vec3& eye);
 
-    void CreateMaterialBuffers();
+    // Writes where startup spent its time, and its critical path, for every launch.
+    void WriteStartupReport();
+
+    // Main thread. Brings the FrameBuilder up to date with the scene's entities.
+    void SyncRenderObjects();
 
     void BeginFrame();
 
-    void DrawModels();
+    // Copies materials changed since this frame's buffer was last written into it.
+    void UploadMaterials();
+
+    void DrawModels(const FramePacket& packet);
+
+    void ExecuteCommands(std::span<const Command> commands);
 
     void RenderGui();
 
+    void DrawInputLatencyWindow();
+
+    void DrawResourcesWindow();
+
+    void DrawAllocationsWindow();
+
+    void DrawMaterialsWindow();
+
     void PresentFrame();
 
     void ExecuteAndWait();
 
     InputManager* m_inputManager = nullptr;
+    std::mutex* m_guiMutex = nullptr;
 
     HWND m_hwnd;
 
@@ -61,10 +123,48 @@ private:
     static constexpr int NUM_FRAMES = 2;
 
     winrt::com_ptr<IDXGIFactory6> m_factory;
+    winrt::com_ptr<IDXGIAdapter1> m_adapter;
     winrt::com_ptr<ID3D12Device> m_device;
 
+    std::unique_ptr<JobSystem> m_jobSystem;
+
     std::unique_ptr<GpuResourceManager> m_resourceManager;
 
+    // Built by AssetPacker from the assets directory. Loose files are used when it is missing.
+    static constexpr const char* ASSET_ARCHIVE_PATH = "assets.pak";
+
+    static constexpr const char* PIPELINE_STORE_PATH = "pipeline_cache.bin";
+
+    static constexpr const char* STARTUP_REPORT_PATH = "startup_report.json";
+    static constexpr const char* STARTUP_TRACE_PATH = "startup_trace.json";
+
+    // Whether the first frame is drawn as soon as geometry is loaded, with textures streaming in
+    // afterwards, rather than once everything is loaded.
+    static constexpr bool STREAM_TEXTURES = true;
+
+    // Enough to keep every worker decoding, few enough that priorities still decide the order.
+    static constexpr size_t MAX_STREAMING_TEXTURES = 8;
+
+    std::chrono::steady_clock::time_point m_startTime;
+
+    // When the constructor returned, and whether loading has finished since.
+    int64_t m_constructedNs = 0;
+    bool m_loaded = false;
+
+    // Written by the render thread.
+    std::atomic<bool> m_firstFramePresented = false;
+
+    // Since m_startTime, for the GUI. Negative until reached.
+    std::atomic<double> m_firstFrameMs = -1.0;
+    std::atomic<double> m_loadedMs = -1.0;
+
+    std::atomic<uint64_t> m_numTexturesStreamed = 0;
+    std::atomic<uint64_t> m_numTexturesToStream = 0;
+
+    std::unique_ptr<D3D12PipelineCompiler> m_pipelineCompiler;
+    std::unique_ptr<PipelineStore> m_pipelineStore;
+    std::unique_ptr<PipelineCache> m_pipelineCache;
+
     winrt::com_ptr<ID3D12CommandQueue> m_cmdQueue;
     winrt::com_ptr<IDXGISwapChain3> m_swapChain;
 
@@ -90,13 +190,21 @@ private:
 
         D3D12_CPU_DESCRIPTOR_HANDLE RtvHandle;
 
+        // This frame's copy of the material table, and the records it is missing.
+        winrt::com_ptr<ID3D12Resource> MaterialsBuffer;
+        MaterialRecord* MaterialsPtr = nullptr;
+        std::vector<MaterialRange> PendingMaterialRanges;
+
         uint64_t FenceWaitValue = 0;
     };
 
     Frame m_frames[NUM_FRAMES];
 
     winrt::com_ptr<ID3D12RootSignature> m_rootSig;
-    winrt::com_ptr<ID3D12PipelineState> m_pipeline;
+    uint64_t m_rootSigHash = 0;
+
+    // Created in the background while assets load.
+    PipelineRequest m_pipelineRequest;
 
     winrt::com_ptr<ID3D12DescriptorHeap> m_rtvHeap;
     uint32_t m_rtvHandleSize = 0;
@@ -115,34 +223,74 @@ private:
 
     winrt::com_ptr<ID3D12Resource> m_depthTexture;
 
-    winrt::com_ptr<ID3D12Resource> m_constantBuffer;
+    // Room for this many InstanceData, for each frame in flight.
+    static constexpr size_t MAX_INSTANCES = 65536;
 
-    winrt::com_ptr<ID3D12Resource> m_materialsBuffer;
-    size_t m_materialsBufferStride = 0;
+    winrt::com_ptr<ID3D12Resource> m_instanceBuffer;
+    size_t m_instanceBufferStride = 0;
+
+    // Capacity of each frame's material buffer.
+    static constexpr size_t MAX_MATERIALS = 4096;
 
     std::unique_ptr<DebugPass> m_debugPass;
 
+    ProfilerWindow m_profilerWindow;
+
+    InputLatencyTracker m_latencyTracker;
+
+    // Render thread. Heap allocations made in the frame before the last present, across threads.
+    AllocationStats m_prevAllocationStats;
+    AllocationStats m_frameAllocations;
+
     int m_currentFrame = 0;
 
     std::unique_ptr<Camera> m_camera;
 
+    // Pose before the most recent Tick(), for interpolation.
+    CameraState m_prevCameraState;
+
     glm::mat4 m_projMat;
 
-    struct Constants
-    {
-        glm::mat4 WorldViewProjMatrix;
-        glm::vec4 LightPos;
-    };
+    std::byte* m_instancesPtr = nullptr;
 
-    Constants* m_constantsPtr = nullptr;
+    Scene m_scene;
 
-    struct Material
-    {
-        glm::vec4 BaseColorFactor;
-    };
+    std::unique_ptr<GpuTexture> m_defaultTexture;
 
-    Scene m_scene;
+    // Main thread. Set if STREAM_TEXTURES.
+    std::unique_ptr<TextureStreamer> m_textureStreamer;
+    std::vector<float> m_streamPriorities;
+
+    // Indexed by ModelInstance::ModelIdx.
+    std::vector<Model> m_models;
+
+    static constexpr uint32_t BOX_MODEL_IDX = 0;
+    static constexpr uint32_t SPONZA_MODEL_IDX = 1;
+
+    // Index into m_geometry of every model's primitives, by model and then in mesh order.
+    std::vector<std::vector<uint32_t>> m_modelGeometry;
+
+    // Indexed by RenderObject::MaterialIdx and MaterialOverride::MaterialIdx. Read by the main
+    // thread and edited from the GUI on the render thread, so guarded by |m_materialsMutex|.
+    MaterialTable m_materialTable;
+    std::mutex m_materialsMutex;
+
+    // Table index of every model's materials, by model and then by the model's own index.
+    std::vector<std::vector<uint32_t>> m_modelMaterials;
+
+    // Tints for box instances.
+    std::vector<uint32_t> m_paletteMaterials;
+
+    // Render thread scratch for UploadMaterials().
+    std::vector<MaterialRange> m_dirtyMaterialRanges;
+
+    glm::mat4 m_sponzaWorldMat;
+
+    std::unique_ptr<FrameBuilder> m_frameBuilder;
+
+    // Indexed by RenderObject::GeometryIdx.
+    std::vector<const Primitive*> m_geometry;
 
-    Model m_model;
-    Model m_sponza;
+    // Structure version of the scene's entities when the FrameBuilder was last rebuilt.
+    std::optional<uint64_t> m_syncedStructureVersion;
 };
@@ -0,0 +1,491 @@
+// Benchmark for asset archives. Round-trips generated data through the LZ codec and an asset
+// directory through an archive, and checks that truncated and corrupt input is rejected. Then
+// measures the codec on each kind of asset file, and reading every asset as loose files and from
+// the archive, with the page cache warm and - on Linux - cold. Exits with an error if any check
+// fails.
+
+#include "AssetArchive.h"
+#include "BenchmarkUtils.h"
+#include "JobSystem.h"
+#include "Lz.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+using benchmark::DropFromPageCache;
+using benchmark::ElapsedMs;
+using benchmark::GbPerSec;
+using benchmark::ListFiles;
+using benchmark::MeasureMs;
+
+struct Options
+{
+    std::string Dir = "assets";
+
+    // Written for the benchmark and removed afterwards. Kept off tmpfs, which cannot be evicted.
+    std::string ArchivePath = "archive_benchmark.pak";
+
+    int Iterations = 5;
+
+    std::string OutPath = "archive_benchmark_results.json";
+};
+
+constexpr const char* USAGE =
+    "Usage: ArchiveBenchmark [options]\n"
+    "  --dir DIR         Asset directory to pack and read (default assets)\n"
+    "  --archive FILE    Scratch archive (default archive_benchmark.pak)\n"
+    "  --iterations N    Reads to time, keeping the fastest (default 5)\n"
+    "  --out FILE        Results file (default archive_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--dir")
+            options->Dir = value;
+        else if (arg == "--archive")
+            options->ArchivePath = value;
+        else if (arg == "--iterations")
+            options->Iterations = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->Iterations > 0;
+}
+
+bool Throws(const std::function<void()>& fn)
+{
+    try
+    {
+        fn();
+    }
+    catch (const std::exception&)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+void WriteFile(const fs::path& path, const std::vector<std::byte>& data)
+{
+    std::ofstream strm(path, std::ios::binary);
+
+    if (!strm)
+        throw std::runtime_error("Could not open file.");
+
+    strm.write(reinterpret_cast<const char*>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+}
+
+std::vector<std::byte> MakeRandomBytes(size_t size, std::mt19937* rng)
+{
+    std::vector<std::byte> data(size);
+
+    for (std::byte& value : data)
+    {
+        value = static_cast<std::byte>((*rng)() & 0xff);
+    }
+
+    return data;
+}
+
+std::vector<std::byte> MakeText(size_t size, std::mt19937* rng)
+{
+    static const char* const words[] = {"vertex", "index", "buffer", "texture", "material",
+                                        "\"byteOffset\": ", "\"count\": ", "{", "}", ", ",
+                                        "\n", "    ", "0", "1", "1024"};
+
+    std::string text;
+
+    while (text.size() < size)
+    {
+        text += words[(*rng)() % std::size(words)];
+    }
+
+    text.resize(size);
+
+    std::vector<std::byte> data(size);
+    std::transform(text.begin(), text.end(), data.begin(), [](char c) {
+        return static_cast<std::byte>(c);
+    });
+
+    return data;
+}
+
+// Random runs interleaved with copies of earlier data, some from just within and some from just
+// beyond the codec's 64 KB window.
+std::vector<std::byte> MakeRepeats(size_t size, std::mt19937* rng)
+{
+    std::vector<std::byte> data = MakeRandomBytes(70000, rng);
+
+    while (data.size() < size)
+    {
+        size_t length = 4 + (*rng)() % 300;
+
+        if ((*rng)() % 3 == 0)
+        {
+            std::vector<std::byte> run = MakeRandomBytes(length, rng);
+            data.insert(data.end(), run.begin(), run.end());
+            continue;
+        }
+
+        size_t offset = 1 + (*rng)() % 70000;
+
+        for (size_t i = 0; i < length; ++i)
+        {
+            data.push_back(data[data.size() - offset]);
+        }
+    }
+
+    data.resize(size);
+
+    return data;
+}
+
+std::vector<std::vector<std::byte>> MakeLzInputs(std::mt19937* rng)
+{
+    std::vector<std::vector<std::byte>> inputs;
+
+    inputs.push_back({});
+    inputs.push_back({std::byte{42}});
+    inputs.push_back(MakeRandomBytes(1000, rng));
+    inputs.push_back(MakeRandomBytes(ASSET_CHUNK_SIZE, rng));
+    inputs.push_back(std::vector<std::byte>(100000));
+    inputs.push_back(MakeText(200000, rng));
+    inputs.push_back(MakeRepeats(300000, rng));
+
+    // Short periods give matches that overlap their own output.
+    for (size_t period = 1; period < 20; ++period)
+    {
+        std::vector<std::byte> pattern = MakeRandomBytes(period, rng);
+        std::vector<std::byte> data;
+
+        for (size_t i = 0; i < 5000 + period; ++i)
+        {
+            data.push_back(pattern[i % period]);
+        }
+
+        inputs.push_back(data);
+    }
+
+    return inputs;
+}
+
+bool CheckLzRoundTrips(const std::vector<std::vector<std::byte>>& inputs)
+{
+    for (const std::vector<std::byte>& input : inputs)
+    {
+        std::vector<std::byte> compressed = CompressLz(input);
+        std::vector<std::byte> decompressed(input.size());
+
+        DecompressLz(compressed, decompressed);
+
+        if (decompressed != input)
+            return false;
+    }
+
+    return true;
+}
+
+bool CheckLzRejectsInvalid(const std::vector<std::byte>& input, std::mt19937* rng,
+                           size_t* numMutationsRejected)
+{
+    std::vector<std::byte> compressed = CompressLz(input);
+    std::vector<std::byte> decompressed(input.size());
+
+    for (size_t size : {input.size() - 1, input.size() + 1})
+    {
+        std::vector<std::byte> wrongSize(size);
+
+        if (!Throws([&] { DecompressLz(compressed, wrongSize); }))
+            return false;
+    }
+
+    // Every prefix decodes to less than the whole.
+    for (size_t size = 0; size < compressed.size(); size += 1 + size / 64)
+    {
+        std::span<const std::byte> truncated = std::span(compressed).first(size);
+
+        if (!Throws([&] { DecompressLz(truncated, decompressed); }))
+            return false;
+    }
+
+    // A flipped byte may still decode to something, but must never write or read out of bounds,
+    // which a sanitizer build would catch.
+    *numMutationsRejected = 0;
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        std::vector<std::byte> corrupt = compressed;
+        corrupt[(*rng)() % corrupt.size()] ^= static_cast<std::byte>(1 + (*rng)() % 255);
+
+        if (Throws([&] { DecompressLz(corrupt, decompressed); }))
+            ++*numMutationsRejected;
+    }
+
+    return true;
+}
+
+bool CheckArchiveRoundTrips(const fs::path& archivePath, const fs::path& dir,
+                            const std::vector<fs::path>& paths, JobSystem* jobSystem)
+{
+    AssetArchive archive(archivePath, dir, jobSystem);
+
+    for (const fs::path& path : paths)
+    {
+        if (!archive.Contains(path) ||
+            archive.ReadFile(path) != ReadAssetFile(path, nullptr))
+        {
+            return false;
+        }
+    }
+
+    return !archive.Contains(dir / "missing.bin") && !archive.Contains(dir / ".." / "x") &&
+        Throws([&] { archive.GetFileSize(dir / "missing.bin"); });
+}
+
+bool CheckArchiveRejectsCorruption(const fs::path& archivePath, const fs::path& dir,
+                                   const std::vector<fs::path>& paths)
+{
+    std::vector<std::byte> data = ReadAssetFile(archivePath, nullptr);
+
+    fs::path corruptPath = archivePath;
+    corruptPath += ".corrupt";
+
+    // The last byte belongs to the last chunk, so some file must fail its hash.
+    std::vector<std::byte> corruptChunk = data;
+    corruptChunk.back() ^= std::byte{1};
+    WriteFile(corruptPath, corruptChunk);
+
+    bool chunkRejected = Throws([&] {
+        AssetArchive archive(corruptPath, dir);
+
+        for (const fs::path& path : paths)
+        {
+            archive.ReadFile(path);
+        }
+    });
+
+    // The table of contents follows the 40-byte header.
+    std::vector<std::byte> corruptToc = data;
+    corruptToc[41] ^= std::byte{1};
+    WriteFile(corruptPath, corruptToc);
+
+    bool tocRejected = Throws([&] { AssetArchive archive(corruptPath, dir); });
+
+    WriteFile(corruptPath, std::vector<std::byte>(data.begin(), data.begin() + 100));
+
+    bool truncationRejected = Throws([&] { AssetArchive archive(corruptPath, dir); });
+
+    fs::remove(corruptPath);
+
+    return chunkRejected && tocRejected && truncationRejected;
+}
+
+// Ratio and speed of the codec on each kind of file, compressed a chunk at a time.
+json MeasureLz(const std::vector<fs::path>& paths, int iterations)
+{
+    std::map<std::string, std::vector<std::vector<std::byte>>> chunksByKind;
+
+    for (const fs::path& path : paths)
+    {
+        std::vector<std::byte> data = ReadAssetFile(path, nullptr);
+        auto& chunks = chunksByKind[path.extension().string()];
+
+        for (size_t offset = 0; offset < data.size(); offset += ASSET_CHUNK_SIZE)
+        {
+            size_t size = std::min(ASSET_CHUNK_SIZE, data.size() - offset);
+            chunks.emplace_back(data.begin() + offset, data.begin() + offset + size);
+        }
+    }
+
+    json results = json::object();
+
+    for (const auto& [kind, chunks] : chunksByKind)
+    {
+        size_t bytes = 0;
+        size_t compressedBytes = 0;
+
+        std::vector<std::vector<std::byte>> compressed;
+
+        double compressMs = MeasureMs(1, [&] {
+            for (const std::vector<std::byte>& chunk : chunks)
+            {
+                compressed.push_back(CompressLz(chunk));
+            }
+        });
+
+        for (size_t i = 0; i < chunks.size(); ++i)
+        {
+            bytes += chunks[i].size();
+            compressedBytes += compressed[i].size();
+        }
+
+        std::vector<std::byte> decompressed(ASSET_CHUNK_SIZE);
+
+        double decompressMs = MeasureMs(iterations, [&] {
+            for (size_t i = 0; i < chunks.size(); ++i)
+            {
+                DecompressLz(compressed[i], std::span(decompressed).first(chunks[i].size()));
+            }
+        });
+
+        results[kind.empty() ? "(none)" : kind] = {
+            {"bytes", bytes},
+            {"ratio", bytes > 0 ? static_cast<double>(compressedBytes) /
+                                      static_cast<double>(bytes) : 1.0},
+            {"compress_gb_per_sec", GbPerSec(bytes, compressMs)},
+            {"decompress_gb_per_sec", GbPerSec(bytes, decompressMs)}
+        };
+    }
+
+    return results;
+}
+
+int RunBenchmark(const Options& options)
+{
+    Checks checks;
+    std::mt19937 rng(1234);
+
+    std::vector<std::vector<std::byte>> lzInputs = MakeLzInputs(&rng);
+    size_t numMutationsRejected = 0;
+
+    checks.Check("lz_round_trip", CheckLzRoundTrips(lzInputs));
+    checks.Check("lz_rejects_invalid",
+                 CheckLzRejectsInvalid(MakeText(100000, &rng), &rng, &numMutationsRejected));
+
+    JobSystem jobSystem;
+
+    fs::path dir = options.Dir;
+    fs::path archivePath = options.ArchivePath;
+
+    std::vector<fs::path> paths = ListFiles(dir);
+
+    Clock::time_point packStart = Clock::now();
+    AssetArchiveStats stats = WriteAssetArchive(dir, archivePath, &jobSystem);
+    double packMs = ElapsedMs(packStart);
+
+    checks.Check("archive_round_trip_serial",
+                 CheckArchiveRoundTrips(archivePath, dir, paths, nullptr));
+    checks.Check("archive_round_trip_parallel",
+                 CheckArchiveRoundTrips(archivePath, dir, paths, &jobSystem));
+    checks.Check("archive_rejects_corruption",
+                 CheckArchiveRejectsCorruption(archivePath, dir, paths));
+
+    json lzResults = MeasureLz(paths, options.Iterations);
+
+    auto readLoose = [&] {
+        for (const fs::path& path : paths)
+        {
+            ReadAssetFile(path, nullptr);
+        }
+    };
+
+    auto readArchive = [&](JobSystem* archiveJobSystem) {
+        AssetArchive archive(archivePath, dir, archiveJobSystem);
+
+        for (const fs::path& path : paths)
+        {
+            archive.ReadFile(path);
+        }
+    };
+
+    bool canDropCache = DropFromPageCache(archivePath);
+
+    auto dropLoose = [&] {
+        for (const fs::path& path : paths)
+        {
+            DropFromPageCache(path);
+        }
+    };
+
+    auto dropArchive = [&] { DropFromPageCache(archivePath); };
+
+    auto measureReads = [&](const std::function<void()>& read,
+                            const std::function<void()>& drop) -> json {
+        double warmMs = MeasureMs(options.Iterations, read);
+        double coldMs = canDropCache ? MeasureMs(options.Iterations, read, drop) : 0.0;
+
+        return {
+            {"warm_ms", warmMs},
+            {"warm_gb_per_sec", GbPerSec(stats.Bytes, warmMs)},
+            {"cold_ms", coldMs},
+            {"cold_gb_per_sec", GbPerSec(stats.Bytes, coldMs)}
+        };
+    };
+
+    json reads = {
+        {"loose_files", measureReads(readLoose, dropLoose)},
+        {"archive_serial", measureReads([&] { readArchive(nullptr); }, dropArchive)},
+        {"archive_parallel", measureReads([&] { readArchive(&jobSystem); }, dropArchive)}
+    };
+
+    fs::remove(archivePath);
+
+    json results = {
+        {"dir", dir.generic_string()},
+        {"threads", jobSystem.GetThreadCount()},
+        {"archive", {
+            {"files", stats.NumFiles},
+            {"chunks", stats.NumChunks},
+            {"bytes", stats.Bytes},
+            {"stored_bytes", stats.StoredBytes},
+            {"ratio", stats.Bytes > 0 ? static_cast<double>(stats.StoredBytes) /
+                                            static_cast<double>(stats.Bytes) : 1.0},
+            {"pack_ms", packMs}
+        }},
+        {"lz", lzResults},
+        {"lz_mutations_rejected", numMutationsRejected},
+        {"cold_cache_supported", canDropCache},
+        {"reads", reads},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Archive checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
@@ -0,0 +1,532 @@
+#include "AssetArchive.h"
+
+#include "Hash.h"
+#include "LoadProfiler.h"
+#include "Lz.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+// Header: magic, version, chunk size, file count, chunk count, a reserved word, then the size and
+// hash of the table of contents that follows it. Chunk data starts on a DATA_ALIGNMENT boundary.
+constexpr char MAGIC[4] = {'G', 'P', 'A', 'K'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t HEADER_SIZE = 40;
+constexpr uint64_t DATA_ALIGNMENT = 4096;
+
+// Offset and stored size of a chunk in the table of contents.
+constexpr size_t CHUNK_ENTRY_SIZE = 12;
+
+class Writer
+{
+public:
+    void WriteBytes(const void* src, size_t size)
+    {
+        const std::byte* bytes = static_cast<const std::byte*>(src);
+        m_data.insert(m_data.end(), bytes, bytes + size);
+    }
+
+    template<typename T>
+    void WriteValue(T value)
+    {
+        WriteBytes(&value, sizeof(value));
+    }
+
+    std::vector<std::byte>& GetData()
+    {
+        return m_data;
+    }
+
+private:
+    std::vector<std::byte> m_data;
+};
+
+[[noreturn]] void ThrowCorrupt()
+{
+    throw std::runtime_error("Corrupt asset archive.");
+}
+
+class Reader
+{
+public:
+    explicit Reader(std::span<const std::byte> data)
+        : m_data(data)
+    {
+    }
+
+    std::span<const std::byte> ReadBytes(size_t size)
+    {
+        if (size > m_data.size() - m_pos)
+            ThrowCorrupt();
+
+        std::span<const std::byte> bytes = m_data.subspan(m_pos, size);
+        m_pos += size;
+
+        return bytes;
+    }
+
+    template<typename T>
+    T ReadValue()
+    {
+        T value;
+        std::memcpy(&value, ReadBytes(sizeof(T)).data(), sizeof(T));
+
+        return value;
+    }
+
+    bool IsAtEnd() const
+    {
+        return m_pos == m_data.size();
+    }
+
+private:
+    std::span<const std::byte> m_data;
+    size_t m_pos = 0;
+};
+
+std::vector<std::byte> ReadDiskFile(const fs::path& path)
+{
+    std::ifstream strm(path, std::ios::binary);
+    if (!strm.is_open())
+        throw std::runtime_error("Could not open file.");
+
+    std::vector<std::byte> data(fs::file_size(path));
+
+    strm.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+    return data;
+}
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+uint64_t GetNumChunks(uint64_t size)
+{
+    return (size + ASSET_CHUNK_SIZE - 1) / ASSET_CHUNK_SIZE;
+}
+
+// A file's hash covers the hashes of its chunks, so reads can check them in parallel.
+uint64_t HashChunkHashes(std::span<const uint64_t> chunkHashes)
+{
+    return HashContent(std::as_bytes(chunkHashes));
+}
+
+} // namespace
+
+AssetArchiveStats WriteAssetArchive(const fs::path& dir, const fs::path& archivePath,
+                                    JobSystem* jobSystem)
+{
+    struct SourceFile
+    {
+        std::string Name;
+        std::vector<std::byte> Data;
+
+        uint32_t FirstChunk = 0;
+    };
+
+    std::vector<SourceFile> files;
+
+    for (const fs::directory_entry& item : fs::recursive_directory_iterator(dir))
+    {
+        // The archive may be written into the directory it packs.
+        if (!item.is_regular_file() ||
+            (fs::exists(archivePath) && fs::equivalent(item.path(), archivePath)))
+        {
+            continue;
+        }
+
+        files.push_back({item.path().lexically_relative(dir).generic_string(),
+                         ReadDiskFile(item.path())});
+    }
+
+    // Sorted, so that the same files always give the same archive.
+    std::sort(files.begin(), files.end(), [](const SourceFile& a, const SourceFile& b) {
+        return a.Name < b.Name;
+    });
+
+    struct SourceChunk
+    {
+        std::span<const std::byte> Data;
+
+        // Empty if compression did not shrink the chunk, which is then stored as is.
+        std::vector<std::byte> Compressed;
+
+        uint64_t Hash = 0;
+
+        std::span<const std::byte> GetStored() const
+        {
+            return Compressed.empty() ? Data : std::span<const std::byte>(Compressed);
+        }
+    };
+
+    std::vector<SourceChunk> chunks;
+
+    for (SourceFile& file : files)
+    {
+        file.FirstChunk = static_cast<uint32_t>(chunks.size());
+
+        for (size_t offset = 0; offset < file.Data.size(); offset += ASSET_CHUNK_SIZE)
+        {
+            size_t size = std::min(ASSET_CHUNK_SIZE, file.Data.size() - offset);
+            chunks.push_back({std::span(file.Data).subspan(offset, size), {}});
+        }
+    }
+
+    if (chunks.size() > UINT32_MAX)
+        throw std::runtime_error("Too many files to archive.");
+
+    jobSystem->ParallelFor(chunks.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            chunks[i].Compressed = CompressLz(chunks[i].Data);
+            chunks[i].Hash = HashContent(chunks[i].Data);
+
+            if (chunks[i].Compressed.size() >= chunks[i].Data.size())
+                chunks[i].Compressed.clear();
+        }
+    });
+
+    AssetArchiveStats stats;
+    stats.NumFiles = files.size();
+    stats.NumChunks = chunks.size();
+
+    Writer toc;
+
+    for (const SourceFile& file : files)
+    {
+        uint64_t numChunks = GetNumChunks(file.Data.size());
+        std::vector<uint64_t> chunkHashes;
+
+        for (uint64_t i = 0; i < numChunks; ++i)
+        {
+            chunkHashes.push_back(chunks[file.FirstChunk + i].Hash);
+        }
+
+        toc.WriteValue(static_cast<uint32_t>(file.Name.size()));
+        toc.WriteBytes(file.Name.data(), file.Name.size());
+        toc.WriteValue(static_cast<uint64_t>(file.Data.size()));
+        toc.WriteValue(HashChunkHashes(chunkHashes));
+        toc.WriteValue(file.FirstChunk);
+        toc.WriteValue(static_cast<uint32_t>(numChunks));
+
+        stats.Bytes += file.Data.size();
+    }
+
+    uint64_t tocSize = toc.GetData().size() + chunks.size() * CHUNK_ENTRY_SIZE;
+    uint64_t dataOffset = AlignUp(HEADER_SIZE + tocSize, DATA_ALIGNMENT);
+    uint64_t offset = dataOffset;
+
+    for (const SourceChunk& chunk : chunks)
+    {
+        size_t storedSize = chunk.GetStored().size();
+
+        toc.WriteValue(offset);
+        toc.WriteValue(static_cast<uint32_t>(storedSize));
+
+        offset += storedSize;
+        stats.StoredBytes += storedSize;
+    }
+
+    Writer header;
+    header.WriteBytes(MAGIC, sizeof(MAGIC));
+    header.WriteValue(VERSION);
+    header.WriteValue(static_cast<uint32_t>(ASSET_CHUNK_SIZE));
+    header.WriteValue(static_cast<uint32_t>(files.size()));
+    header.WriteValue(static_cast<uint32_t>(chunks.size()));
+    header.WriteValue(uint32_t{0});
+    header.WriteValue(tocSize);
+    header.WriteValue(HashContent(toc.GetData()));
+
+    // Written next to the destination and renamed over it, so that a crash mid-write cannot
+    // leave a truncated archive behind.
+    fs::path tempPath = archivePath;
+    tempPath += ".tmp";
+
+    {
+        std::ofstream strm(tempPath, std::ios::binary);
+        if (!strm.is_open())
+            throw std::runtime_error("Could not open file.");
+
+        auto write = [&](std::span<const std::byte> bytes) {
+            strm.write(reinterpret_cast<const char*>(bytes.data()),
+                       static_cast<std::streamsize>(bytes.size()));
+        };
+
+        write(header.GetData());
+        write(toc.GetData());
+        write(std::vector<std::byte>(dataOffset - HEADER_SIZE - tocSize));
+
+        for (const SourceChunk& chunk : chunks)
+        {
+            write(chunk.GetStored());
+        }
+
+        if (!strm)
+            throw std::runtime_error("Could not write file.");
+    }
+
+    fs::rename(tempPath, archivePath);
+
+    return stats;
+}
+
+AssetArchive::AssetArchive(const fs::path& path, const fs::path& mountDir, JobSystem* jobSystem)
+    : m_mountDir(mountDir.lexically_normal()),
+      m_jobSystem(jobSystem),
+      m_file(path, std::ios::binary)
+{
+    if (!m_file.is_open())
+        throw std::runtime_error("Could not open file.");
+
+    uint64_t archiveSize = fs::file_size(path);
+
+    if (archiveSize < HEADER_SIZE)
+        ThrowCorrupt();
+
+    std::vector<std::byte> headerData(HEADER_SIZE);
+    m_file.read(reinterpret_cast<char*>(headerData.data()),
+                static_cast<std::streamsize>(HEADER_SIZE));
+
+    Reader header(headerData);
+
+    if (std::memcmp(header.ReadBytes(sizeof(MAGIC)).data(), MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("Not an asset archive.");
+
+    if (header.ReadValue<uint32_t>() != VERSION ||
+        header.ReadValue<uint32_t>() != ASSET_CHUNK_SIZE)
+    {
+        throw std::runtime_error("Unsupported asset archive version.");
+    }
+
+    uint32_t numFiles = header.ReadValue<uint32_t>();
+    uint32_t numChunks = header.ReadValue<uint32_t>();
+    header.ReadValue<uint32_t>();
+    uint64_t tocSize = header.ReadValue<uint64_t>();
+    uint64_t tocHash = header.ReadValue<uint64_t>();
+
+    if (tocSize > archiveSize - HEADER_SIZE)
+        ThrowCorrupt();
+
+    std::vector<std::byte> tocData(tocSize);
+    m_file.read(reinterpret_cast<char*>(tocData.data()), static_cast<std::streamsize>(tocSize));
+
+    if (!m_file || HashContent(tocData) != tocHash)
+        ThrowCorrupt();
+
+    Reader toc(tocData);
+
+    for (uint32_t i = 0; i < numFiles; ++i)
+    {
+        std::span<const std::byte> name = toc.ReadBytes(toc.ReadValue<uint32_t>());
+
+        Entry entry;
+        entry.Size = toc.ReadValue<uint64_t>();
+        entry.Hash = toc.ReadValue<uint64_t>();
+        entry.FirstChunk = toc.ReadValue<uint32_t>();
+        entry.NumChunks = toc.ReadValue<uint32_t>();
+
+        if (entry.NumChunks != GetNumChunks(entry.Size) ||
+            uint64_t{entry.FirstChunk} + entry.NumChunks > numChunks)
+        {
+            ThrowCorrupt();
+        }
+
+        std::string key(reinterpret_cast<const char*>(name.data()), name.size());
+
+        if (!m_entries.emplace(std::move(key), entry).second)
+            ThrowCorrupt();
+    }
+
+    m_chunks.resize(numChunks);
+
+    for (Chunk& chunk : m_chunks)
+    {
+        chunk.Offset = toc.ReadValue<uint64_t>();
+        chunk.StoredSize = toc.ReadValue<uint32_t>();
+
+        if (chunk.StoredSize == 0 || chunk.Offset > archiveSize ||
+            chunk.StoredSize > archiveSize - chunk.Offset)
+        {
+            ThrowCorrupt();
+        }
+    }
+
+    if (!toc.IsAtEnd())
+        ThrowCorrupt();
+
+    // Reads rely on each file's chunks being contiguous and no larger than they decompress to.
+    for (const auto& [name, entry] : m_entries)
+    {
+        for (uint32_t i = 0; i < entry.NumChunks; ++i)
+        {
+            const Chunk& chunk = m_chunks[entry.FirstChunk + i];
+            uint64_t size = std::min<uint64_t>(ASSET_CHUNK_SIZE, entry.Size - i * ASSET_CHUNK_SIZE);
+
+            if (chunk.StoredSize > size)
+                ThrowCorrupt();
+
+            if (i > 0)
+            {
+                const Chunk& prevChunk = m_chunks[entry.FirstChunk + i - 1];
+
+                if (chunk.Offset != prevChunk.Offset + prevChunk.StoredSize)
+                    ThrowCorrupt();
+            }
+        }
+    }
+}
+
+bool AssetArchive::Contains(const fs::path& path) const
+{
+    return FindEntry(path) != nullptr;
+}
+
+size_t AssetArchive::GetFileSize(const fs::path& path) const
+{
+    return GetEntry(path).Size;
+}
+
+void AssetArchive::ReadFile(const fs::path& path, std::span<std::byte> dst) const
+{
+    PROFILE_SCOPE("ReadArchiveFile");
+
+    const Entry& entry = GetEntry(path);
+
+    if (dst.size() != entry.Size)
+        throw std::runtime_error("Destination does not match the file size.");
+
+    std::span<const Chunk> chunks(m_chunks.data() + entry.FirstChunk, entry.NumChunks);
+
+    uint64_t begin = chunks.empty() ? 0 : chunks.front().Offset;
+    uint64_t storedSize = chunks.empty() ? 0 :
+        chunks.back().Offset + chunks.back().StoredSize - begin;
+
+    auto read = [&](std::span<std::byte> bytes) {
+        std::lock_guard lock(m_fileMutex);
+
+        m_file.clear();
+        m_file.seekg(static_cast<std::streamoff>(begin));
+        m_file.read(reinterpret_cast<char*>(bytes.data()),
+                    static_cast<std::streamsize>(bytes.size()));
+
+        if (!m_file)
+            ThrowCorrupt();
+    };
+
+    // Files whose chunks are all stored as is, such as most images, are read straight into place.
+    bool isStoredAsIs = storedSize == entry.Size;
+    std::vector<std::byte> stored;
+
+    if (!isStoredAsIs)
+    {
+        stored.resize(storedSize);
+        read(stored);
+    }
+    else if (!dst.empty())
+    {
+        read(dst);
+    }
+
+    std::vector<uint64_t> chunkHashes(chunks.size());
+
+    auto decompressChunks = [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i)
+        {
+            size_t offset = i * ASSET_CHUNK_SIZE;
+
+            std::span<std::byte> chunkDst =
+                dst.subspan(offset, std::min(ASSET_CHUNK_SIZE, dst.size() - offset));
+
+            if (!isStoredAsIs)
+            {
+                std::span<const std::byte> src =
+                    std::span(stored).subspan(chunks[i].Offset - begin, chunks[i].StoredSize);
+
+                if (src.size() == chunkDst.size())
+                    std::memcpy(chunkDst.data(), src.data(), src.size());
+                else
+                    DecompressLz(src, chunkDst);
+            }
+
+            chunkHashes[i] = HashContent(chunkDst);
+        }
+    };
+
+    if (m_jobSystem)
+        m_jobSystem->ParallelFor(chunks.size(), decompressChunks);
+    else
+        decompressChunks(0, chunks.size());
+
+    if (HashChunkHashes(chunkHashes) != entry.Hash)
+        ThrowCorrupt();
+}
+
+std::vector<std::byte> AssetArchive::ReadFile(const fs::path& path) const
+{
+    std::vector<std::byte> data(GetFileSize(path));
+    ReadFile(path, data);
+
+    return data;
+}
+
+AssetArchiveStats AssetArchive::GetStats() const
+{
+    AssetArchiveStats stats;
+    stats.NumFiles = m_entries.size();
+    stats.NumChunks = m_chunks.size();
+
+    for (const auto& [name, entry] : m_entries)
+    {
+        stats.Bytes += entry.Size;
+    }
+
+    for (const Chunk& chunk : m_chunks)
+    {
+        stats.StoredBytes += chunk.StoredSize;
+    }
+
+    return stats;
+}
+
+const AssetArchive::Entry* AssetArchive::FindEntry(const fs::path& path) const
+{
+    fs::path relativePath = path.lexically_normal().lexically_relative(m_mountDir);
+
+    if (relativePath.empty() || *relativePath.begin() == "..")
+        return nullptr;
+
+    auto it = m_entries.find(relativePath.generic_string());
+
+    return it != m_entries.end() ? &it->second : nullptr;
+}
+
+const AssetArchive::Entry& AssetArchive::GetEntry(const fs::path& path) const
+{
+    const Entry* entry = FindEntry(path);
+
+    if (!entry)
+        throw std::runtime_error("File not in asset archive.");
+
+    return *entry;
+}
+
+std::vector<std::byte> ReadAssetFile(const fs::path& path, const AssetArchive* archive)
+{
+    LoadScope scope("ReadFile", path);
+
+    std::vector<std::byte> data = archive && archive->Contains(path) ? archive->ReadFile(path) :
+        ReadDiskFile(path);
+
+    scope.AddBytes(data.size());
+
+    return data;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "JobSystem.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Many asset files packed into one, so that loading a model takes one open and a few large
+// sequential reads instead of one open per file. Each file is split into chunks of
+// ASSET_CHUNK_SIZE bytes that are compressed independently (see Lz.h), or stored as is when that
+// does not shrink them, and can therefore be decompressed in parallel. A file's chunks are stored
+// back to back. A table of contents at the front maps each file's path to its size, its chunks
+// and a hash of its contents, which every read verifies chunk by chunk.
+constexpr size_t ASSET_CHUNK_SIZE = 64 * 1024;
+
+struct AssetArchiveStats
+{
+    uint64_t NumFiles = 0;
+    uint64_t NumChunks = 0;
+
+    // Total size of the files, and of their chunks as stored.
+    uint64_t Bytes = 0;
+    uint64_t StoredBytes = 0;
+};
+
+// Packs every regular file under |dir|, named by its path relative to |dir|. Chunks are
+// compressed in parallel on |jobSystem|.
+AssetArchiveStats WriteAssetArchive(const std::filesystem::path& dir,
+                                    const std::filesystem::path& archivePath,
+                                    JobSystem* jobSystem);
+
+class AssetArchive
+{
+public:
+    // Reads the table of contents. Files are looked up by their path relative to |mountDir|, so
+    // that an archive of "assets" serves "assets/box/Box.gltf". Chunks are decompressed on
+    // |jobSystem| if given, and on the reading thread otherwise.
+    AssetArchive(const std::filesystem::path& path, const std::filesystem::path& mountDir,
+                 JobSystem* jobSystem = nullptr);
+
+    AssetArchive(const AssetArchive&) = delete;
+    AssetArchive& operator=(const AssetArchive&) = delete;
+
+    bool Contains(const std::filesystem::path& path) const;
+
+    // Throws if the archive does not contain |path|.
+    size_t GetFileSize(const std::filesystem::path& path) const;
+
+    // Writes the file's contents to |dst|, which must be GetFileSize() long. Throws if the
+    // archive is corrupt. Thread-safe.
+    void ReadFile(const std::filesystem::path& path, std::span<std::byte> dst) const;
+    std::vector<std::byte> ReadFile(const std::filesystem::path& path) const;
+
+    AssetArchiveStats GetStats() const;
+
+private:
+    struct Entry
+    {
+        uint64_t Size = 0;
+        uint64_t Hash = 0;
+
+        uint32_t FirstChunk = 0;
+        uint32_t NumChunks = 0;
+    };
+
+    struct Chunk
+    {
+        uint64_t Offset = 0;
+        uint32_t StoredSize = 0;
+    };
+
+    const Entry* FindEntry(const std::filesystem::path& path) const;
+    const Entry& GetEntry(const std::filesystem::path& path) const;
+
+    std::filesystem::path m_mountDir;
+
+    JobSystem* m_jobSystem;
+
+    std::unordered_map<std::string, Entry> m_entries;
+    std::vector<Chunk> m_chunks;
+
+    // Reads seek the one stream, so they take turns. Decompression happens outside the lock.
+    mutable std::mutex m_fileMutex;
+    mutable std::ifstream m_file;
+};
+
+// Reads a file from |archive| if it is given and contains |path|, and from disk otherwise.
+std::vector<std::byte> ReadAssetFile(const std::filesystem::path& path,
+                                     const AssetArchive* archive);
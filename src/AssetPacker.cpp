@@ -0,0 +1,91 @@
+// Packs an asset directory into an archive, which the app then reads in place of the loose files.
+
+#include "AssetArchive.h"
+#include "JobSystem.h"
+
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <string>
+
+namespace
+{
+
+struct Options
+{
+    std::string Dir = "assets";
+    std::string OutPath = "assets.pak";
+};
+
+void PrintUsage()
+{
+    std::printf(
+        "Usage: AssetPacker [options]\n"
+        "  --dir DIR     Directory to pack (default assets)\n"
+        "  --out FILE    Archive to write (default assets.pak)\n");
+}
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--help" || i + 1 >= argc)
+            return false;
+
+        std::string value = argv[++i];
+
+        if (arg == "--dir")
+            options->Dir = value;
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        Options options;
+
+        if (!ParseOptions(argc, argv, &options))
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        JobSystem jobSystem;
+
+        auto start = std::chrono::steady_clock::now();
+
+        AssetArchiveStats stats = WriteAssetArchive(options.Dir, options.OutPath, &jobSystem);
+
+        double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+
+        std::printf("Packed %llu files (%llu chunks) from %s into %s in %.1f ms.\n",
+                    static_cast<unsigned long long>(stats.NumFiles),
+                    static_cast<unsigned long long>(stats.NumChunks), options.Dir.c_str(),
+                    options.OutPath.c_str(), ms);
+
+        std::printf("%llu bytes stored as %llu (%.1f%%).\n",
+                    static_cast<unsigned long long>(stats.Bytes),
+                    static_cast<unsigned long long>(stats.StoredBytes),
+                    stats.Bytes > 0 ? 100.0 * static_cast<double>(stats.StoredBytes) /
+                                          static_cast<double>(stats.Bytes) : 100.0);
+
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "Packing failed: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,1015 @@
+#include "AsyncIo.h"
+
+#include "AllocationTracker.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+// Of IoOperation::CancelState. Whoever moves the state on from NOT_CANCELLED decides whether the
+// operation reports Cancelled.
+constexpr int NOT_CANCELLED = 0;
+constexpr int CANCEL_REQUESTED = 1;
+constexpr int FINISHING = 2;
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+struct IoOperation
+{
+    IoService* Service = nullptr;
+
+    IoRequest Request;
+
+    std::atomic<IoStatus> Status = IoStatus::Pending;
+    std::atomic<int> CancelState = NOT_CANCELLED;
+
+    // Written by the I/O thread that runs the operation, and read by others once it has finished.
+    IoBuffer Buffer;
+
+    // All the room the data may land in, which unbuffered reads may fill past |Length|.
+    std::span<std::byte> Target;
+
+    uint64_t Length = 0;
+    uint64_t NumRead = 0;
+
+    std::string Error;
+
+#if defined(__linux__)
+    int Fd = -1;
+    bool Unbuffered = false;
+#endif
+};
+
+IoBuffer::IoBuffer(IoBufferPool* pool, std::byte* data, size_t capacity)
+    : m_pool(pool), m_data(data), m_capacity(capacity)
+{
+}
+
+IoBuffer::IoBuffer(IoBuffer&& other) noexcept
+    : m_pool(std::exchange(other.m_pool, nullptr)), m_data(std::exchange(other.m_data, nullptr)),
+      m_capacity(std::exchange(other.m_capacity, 0))
+{
+}
+
+IoBuffer& IoBuffer::operator=(IoBuffer&& other) noexcept
+{
+    if (this != &other)
+    {
+        Reset();
+
+        m_pool = std::exchange(other.m_pool, nullptr);
+        m_data = std::exchange(other.m_data, nullptr);
+        m_capacity = std::exchange(other.m_capacity, 0);
+    }
+
+    return *this;
+}
+
+IoBuffer::~IoBuffer()
+{
+    Reset();
+}
+
+void IoBuffer::Reset()
+{
+    if (m_data)
+        m_pool->Release(m_data, m_capacity);
+
+    m_pool = nullptr;
+    m_data = nullptr;
+    m_capacity = 0;
+}
+
+IoBufferPool::IoBufferPool(size_t maxCachedBytes)
+    : m_maxCachedBytes(maxCachedBytes),
+      m_free(std::countr_zero(MAX_POOLED_CAPACITY / MIN_CAPACITY) + 1)
+{
+}
+
+IoBufferPool::~IoBufferPool()
+{
+    for (const auto& buffers : m_free)
+    {
+        for (std::byte* data : buffers)
+            ::operator delete(data, std::align_val_t(ALIGNMENT));
+    }
+}
+
+IoBuffer IoBufferPool::Acquire(size_t size)
+{
+    size_t capacity = std::bit_ceil(std::max(size, MIN_CAPACITY));
+
+    if (capacity > MAX_POOLED_CAPACITY)
+        capacity = static_cast<size_t>(AlignUp(size, ALIGNMENT));
+
+    {
+        std::lock_guard lock(m_mutex);
+
+        ++m_stats.NumAcquired;
+
+        if (capacity <= MAX_POOLED_CAPACITY)
+        {
+            auto& buffers = m_free[std::countr_zero(capacity / MIN_CAPACITY)];
+
+            if (!buffers.empty())
+            {
+                std::byte* data = buffers.back();
+                buffers.pop_back();
+
+                ++m_stats.NumReused;
+                m_stats.CachedBytes -= capacity;
+
+                return IoBuffer(this, data, capacity);
+            }
+        }
+    }
+
+    auto* data = static_cast<std::byte*>(::operator new(capacity, std::align_val_t(ALIGNMENT)));
+
+    return IoBuffer(this, data, capacity);
+}
+
+IoBufferPool::Stats IoBufferPool::GetStats() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_stats;
+}
+
+void IoBufferPool::Release(std::byte* data, size_t capacity)
+{
+    {
+        std::lock_guard lock(m_mutex);
+
+        if (capacity <= MAX_POOLED_CAPACITY && m_stats.CachedBytes + capacity <= m_maxCachedBytes)
+        {
+            m_free[std::countr_zero(capacity / MIN_CAPACITY)].push_back(data);
+            m_stats.CachedBytes += capacity;
+
+            return;
+        }
+    }
+
+    ::operator delete(data, std::align_val_t(ALIGNMENT));
+}
+
+#if defined(__linux__)
+
+namespace
+{
+
+// An io_uring instance, set up with raw system calls. Used by one thread at a time.
+class IoUring
+{
+public:
+    explicit IoUring(uint32_t numEntries)
+    {
+        io_uring_params params{};
+
+        m_fd = static_cast<int>(syscall(__NR_io_uring_setup, numEntries, &params));
+
+        if (m_fd < 0)
+            throw std::runtime_error("Could not set up io_uring.");
+
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+        // Older kernels map the completion ring separately.
+        bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+
+        if (singleMmap)
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+        m_sqRing = Map(m_sqRingSize, IORING_OFF_SQ_RING);
+        m_cqRing = singleMmap ? m_sqRing : Map(m_cqRingSize, IORING_OFF_CQ_RING);
+        m_sqes = static_cast<io_uring_sqe*>(Map(m_sqesSize, IORING_OFF_SQES));
+
+        if (!m_sqRing || !m_cqRing || !m_sqes)
+        {
+            Destroy();
+            throw std::runtime_error("Could not map io_uring.");
+        }
+
+        auto* sq = static_cast<std::byte*>(m_sqRing);
+        auto* cq = static_cast<std::byte*>(m_cqRing);
+
+        m_sqHead = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+        m_sqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+        m_numSqEntries = params.sq_entries;
+
+        m_cqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+        m_cqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        m_sqTailLocal = *m_sqTail;
+    }
+
+    ~IoUring()
+    {
+        Destroy();
+    }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // A zeroed submission queue entry, submitted by the next Enter().
+    io_uring_sqe* GetSqe()
+    {
+        uint32_t head = std::atomic_ref(*m_sqHead).load(std::memory_order_acquire);
+
+        if (m_sqTailLocal - head >= m_numSqEntries)
+            throw std::runtime_error("io_uring submission queue full.");
+
+        uint32_t idx = m_sqTailLocal & m_sqMask;
+        ++m_sqTailLocal;
+
+        m_sqArray[idx] = idx;
+
+        io_uring_sqe* sqe = &m_sqes[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+
+        return sqe;
+    }
+
+    // Submits the entries got since the last call, then waits until at least |minComplete|
+    // completions are queued. Returns the number of system calls made, retries included.
+    uint32_t Enter(uint32_t minComplete)
+    {
+        std::atomic_ref(*m_sqTail).store(m_sqTailLocal, std::memory_order_release);
+
+        uint32_t numCalls = 0;
+        std::chrono::microseconds retryDelay = MIN_RETRY_DELAY;
+
+        for (;;)
+        {
+            uint32_t head = std::atomic_ref(*m_sqHead).load(std::memory_order_acquire);
+            uint32_t toSubmit = m_sqTailLocal - head;
+
+            ++numCalls;
+
+            long result = syscall(__NR_io_uring_enter, m_fd, toSubmit, minComplete,
+                                  minComplete ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+
+            if (result >= 0)
+                return numCalls;
+
+            // Out of kernel resources: completions have to be reaped first, and the entries stay
+            // queued until the next call.
+            if (errno == EAGAIN || errno == EBUSY)
+            {
+                if (HasCompletions())
+                    return numCalls;
+
+                // Only reads in flight can free the resources, so back off while they finish
+                // rather than spin the I/O thread on the kernel.
+                std::this_thread::sleep_for(retryDelay);
+                retryDelay = std::min(retryDelay * 2, MAX_RETRY_DELAY);
+
+                continue;
+            }
+
+            if (errno != EINTR)
+                throw std::runtime_error("io_uring_enter failed.");
+        }
+    }
+
+    bool HasCompletions() const
+    {
+        return std::atomic_ref(*m_cqTail).load(std::memory_order_acquire) != *m_cqHead;
+    }
+
+    // Calls |fn(userData, result)| for every queued completion, and frees their entries.
+    template<typename Fn>
+    void ForEachCompletion(Fn&& fn)
+    {
+        uint32_t head = *m_cqHead;
+        uint32_t tail = std::atomic_ref(*m_cqTail).load(std::memory_order_acquire);
+
+        for (; head != tail; ++head)
+        {
+            const io_uring_cqe& cqe = m_cqes[head & m_cqMask];
+            fn(cqe.user_data, cqe.res);
+        }
+
+        std::atomic_ref(*m_cqHead).store(head, std::memory_order_release);
+    }
+
+private:
+    // Bounds of the wait before retrying a submission the kernel had no resources for.
+    static constexpr std::chrono::microseconds MIN_RETRY_DELAY{50};
+    static constexpr std::chrono::microseconds MAX_RETRY_DELAY{1000};
+
+    void* Map(size_t size, off_t offset)
+    {
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd,
+                         offset);
+
+        return ptr == MAP_FAILED ? nullptr : ptr;
+    }
+
+    void Destroy()
+    {
+        if (m_sqes)
+            munmap(m_sqes, m_sqesSize);
+
+        if (m_cqRing && m_cqRing != m_sqRing)
+            munmap(m_cqRing, m_cqRingSize);
+
+        if (m_sqRing)
+            munmap(m_sqRing, m_sqRingSize);
+
+        close(m_fd);
+    }
+
+    int m_fd = -1;
+
+    void* m_sqRing = nullptr;
+    void* m_cqRing = nullptr;
+    io_uring_sqe* m_sqes = nullptr;
+
+    size_t m_sqRingSize = 0;
+    size_t m_cqRingSize = 0;
+    size_t m_sqesSize = 0;
+
+    uint32_t* m_sqHead = nullptr;
+    uint32_t* m_sqTail = nullptr;
+    uint32_t* m_sqArray = nullptr;
+    uint32_t m_sqMask = 0;
+    uint32_t m_numSqEntries = 0;
+
+    // Entries got but not yet submitted lie between the shared tail and this.
+    uint32_t m_sqTailLocal = 0;
+
+    uint32_t* m_cqHead = nullptr;
+    uint32_t* m_cqTail = nullptr;
+    uint32_t m_cqMask = 0;
+    io_uring_cqe* m_cqes = nullptr;
+};
+
+// Larger reads are split, as a read's length is 32-bit.
+constexpr uint64_t MAX_READ_SIZE = uint64_t{1} << 30;
+
+void PrepareRead(IoUring* ring, IoOperation* op, uint64_t userData)
+{
+    uint64_t size = op->Length - op->NumRead;
+
+    // Unbuffered reads cover whole blocks, past the end of the file if need be.
+    if (op->Unbuffered)
+        size = AlignUp(size, IoBufferPool::ALIGNMENT);
+
+    io_uring_sqe* sqe = ring->GetSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = op->Fd;
+    sqe->off = op->Request.Offset + op->NumRead;
+    sqe->addr = reinterpret_cast<uint64_t>(op->Target.data() + op->NumRead);
+    sqe->len = static_cast<uint32_t>(std::min(size, MAX_READ_SIZE));
+    sqe->user_data = userData;
+}
+
+void SetUnbuffered(IoOperation* op, bool unbuffered)
+{
+    int flags = fcntl(op->Fd, F_GETFL);
+
+    if (unbuffered)
+        flags |= O_DIRECT;
+    else
+        flags &= ~O_DIRECT;
+
+    op->Unbuffered = unbuffered && fcntl(op->Fd, F_SETFL, flags) == 0;
+}
+
+// Unbuffered reads need the file offset and memory address block-aligned, and room for whole
+// blocks.
+bool CanReadUnbuffered(const IoOperation& op)
+{
+    uint64_t alignment = IoBufferPool::ALIGNMENT;
+
+    return (op.Request.Offset + op.NumRead) % alignment == 0 &&
+        reinterpret_cast<uintptr_t>(op.Target.data() + op.NumRead) % alignment == 0 &&
+        op.Target.size() >= AlignUp(op.Length, alignment);
+}
+
+} // namespace
+
+#endif
+
+const char* GetIoBackendName(IoBackend backend)
+{
+    switch (backend)
+    {
+        case IoBackend::IoUring:
+            return "io_uring";
+        case IoBackend::ThreadPool:
+            return "thread_pool";
+    }
+
+    return "unknown";
+}
+
+bool IsIoBackendSupported(IoBackend backend)
+{
+    if (backend == IoBackend::ThreadPool)
+        return true;
+
+#if defined(__linux__)
+    static const bool ioUringSupported = [] {
+        try
+        {
+            IoUring ring(1);
+            return true;
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+    }();
+
+    return ioUringSupported;
+#else
+    return false;
+#endif
+}
+
+IoHandle::IoHandle(std::shared_ptr<IoOperation> op) : m_op(std::move(op))
+{
+}
+
+bool IoHandle::IsReady() const
+{
+    return GetStatus() != IoStatus::Pending;
+}
+
+IoStatus IoHandle::Wait() const
+{
+    IoStatus status;
+
+    while ((status = GetStatus()) == IoStatus::Pending)
+        m_op->Status.wait(IoStatus::Pending, std::memory_order_acquire);
+
+    return status;
+}
+
+bool IoHandle::Cancel() const
+{
+    return m_op->Service->Cancel(m_op);
+}
+
+IoStatus IoHandle::GetStatus() const
+{
+    return m_op->Status.load(std::memory_order_acquire);
+}
+
+std::span<const std::byte> IoHandle::GetData() const
+{
+    if (GetStatus() != IoStatus::Completed)
+        return {};
+
+    return m_op->Target.first(static_cast<size_t>(m_op->NumRead));
+}
+
+const std::string& IoHandle::GetError() const
+{
+    return m_op->Error;
+}
+
+IoBuffer IoHandle::TakeBuffer() const
+{
+    if (GetStatus() != IoStatus::Completed)
+        return {};
+
+    return std::move(m_op->Buffer);
+}
+
+IoService::IoService(JobSystem* jobSystem, IoOptions options)
+    : m_jobSystem(jobSystem), m_options(options),
+      m_backend(IsIoBackendSupported(IoBackend::IoUring) ? IoBackend::IoUring :
+                                                           IoBackend::ThreadPool)
+{
+    Start(true);
+}
+
+IoService::IoService(JobSystem* jobSystem, IoOptions options, IoBackend backend)
+    : m_jobSystem(jobSystem), m_options(options), m_backend(backend)
+{
+    if (!IsIoBackendSupported(backend))
+        throw std::runtime_error("I/O backend not supported.");
+
+    Start(false);
+}
+
+IoService::~IoService()
+{
+    std::vector<OperationPtr> queued;
+
+    {
+        std::lock_guard lock(m_mutex);
+
+        for (auto& queue : m_queues)
+        {
+            queued.insert(queued.end(), queue.begin(), queue.end());
+            queue.clear();
+        }
+
+        m_stop = true;
+    }
+
+    m_cv.notify_all();
+
+    for (const OperationPtr& op : queued)
+        Finish(op, IoStatus::Cancelled);
+
+    for (std::thread& thread : m_threads)
+        thread.join();
+
+    if (m_jobSystem)
+        m_jobSystem->Wait(m_callbacks);
+}
+
+IoHandle IoService::Submit(IoRequest request)
+{
+    std::vector<IoHandle> handles;
+    Enqueue({&request, 1}, &handles);
+
+    return std::move(handles[0]);
+}
+
+std::vector<IoHandle> IoService::SubmitBatch(std::span<IoRequest> requests)
+{
+    std::vector<IoHandle> handles;
+    Enqueue(requests, &handles);
+
+    return handles;
+}
+
+IoBackend IoService::GetBackend() const
+{
+    return m_backend;
+}
+
+const IoOptions& IoService::GetOptions() const
+{
+    return m_options;
+}
+
+IoBufferPool& IoService::GetBufferPool()
+{
+    return m_bufferPool;
+}
+
+IoService::Stats IoService::GetStats() const
+{
+    Stats stats;
+    stats.NumCompleted = m_numCompleted.load(std::memory_order_relaxed);
+    stats.NumCancelled = m_numCancelled.load(std::memory_order_relaxed);
+    stats.NumFailed = m_numFailed.load(std::memory_order_relaxed);
+    stats.BytesRead = m_bytesRead.load(std::memory_order_relaxed);
+    stats.NumUnbuffered = m_numUnbuffered.load(std::memory_order_relaxed);
+    stats.NumSubmitCalls = m_numSubmitCalls.load(std::memory_order_relaxed);
+    stats.MaxInFlight = m_maxInFlight.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+void IoService::Start(bool fallBack)
+{
+    if (m_options.QueueDepth == 0)
+        throw std::runtime_error("Queue depth must be at least 1.");
+
+    if (m_backend == IoBackend::IoUring)
+    {
+        std::promise<void> started;
+        std::future<void> startedFuture = started.get_future();
+
+        m_threads.emplace_back([this, &started] { IoUringMain(&started); });
+
+        try
+        {
+            startedFuture.get();
+            return;
+        }
+        catch (const std::exception&)
+        {
+            m_threads.back().join();
+            m_threads.clear();
+
+            if (!fallBack)
+                throw;
+
+            m_backend = IoBackend::ThreadPool;
+        }
+    }
+
+    for (uint32_t i = 0; i < m_options.QueueDepth; ++i)
+        m_threads.emplace_back([this] { ThreadPoolMain(); });
+}
+
+void IoService::Enqueue(std::span<IoRequest> requests, std::vector<IoHandle>* outHandles)
+{
+    std::vector<OperationPtr> ops;
+    ops.reserve(requests.size());
+
+    for (IoRequest& request : requests)
+    {
+        if (request.Priority >= IoPriority::Count)
+            throw std::runtime_error("Invalid I/O priority.");
+
+        auto op = std::make_shared<IoOperation>();
+        op->Service = this;
+        op->Request = std::move(request);
+
+        outHandles->push_back(IoHandle(op));
+        ops.push_back(std::move(op));
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+
+        for (OperationPtr& op : ops)
+            m_queues[static_cast<size_t>(op->Request.Priority)].push_back(std::move(op));
+    }
+
+    if (ops.size() > 1)
+        m_cv.notify_all();
+    else
+        m_cv.notify_one();
+}
+
+void IoService::Dequeue(size_t maxCount, bool wait, std::vector<OperationPtr>* outOps)
+{
+    std::unique_lock lock(m_mutex);
+
+    auto hasQueued = [this] {
+        return std::any_of(std::begin(m_queues), std::end(m_queues),
+                           [](const auto& queue) { return !queue.empty(); });
+    };
+
+    if (wait)
+        m_cv.wait(lock, [&] { return m_stop || hasQueued(); });
+
+    if (m_stop)
+        return;
+
+    for (auto& queue : m_queues)
+    {
+        while (!queue.empty() && outOps->size() < maxCount)
+        {
+            outOps->push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+    }
+}
+
+bool IoService::Cancel(const OperationPtr& op)
+{
+    bool dequeued = false;
+
+    {
+        std::lock_guard lock(m_mutex);
+
+        auto& queue = m_queues[static_cast<size_t>(op->Request.Priority)];
+        auto it = std::find(queue.begin(), queue.end(), op);
+
+        if (it != queue.end())
+        {
+            queue.erase(it);
+            dequeued = true;
+        }
+    }
+
+    if (dequeued)
+    {
+        Finish(op, IoStatus::Cancelled);
+        return true;
+    }
+
+    int state = NOT_CANCELLED;
+
+    return op->CancelState.compare_exchange_strong(state, CANCEL_REQUESTED) ||
+        state == CANCEL_REQUESTED;
+}
+
+bool IoService::Prepare(const OperationPtr& op, uint64_t fileSize)
+{
+    if (op->CancelState.load() == CANCEL_REQUESTED)
+    {
+        Finish(op, IoStatus::Cancelled);
+        return false;
+    }
+
+    const IoRequest& request = op->Request;
+
+    if (request.Offset > fileSize)
+    {
+        Finish(op, IoStatus::Failed, "Offset past the end of the file.");
+        return false;
+    }
+
+    uint64_t length = fileSize - request.Offset;
+
+    if (request.Size != 0)
+        length = std::min(length, request.Size);
+
+    if (!request.Destination.empty())
+    {
+        if (request.Destination.size() < length)
+        {
+            Finish(op, IoStatus::Failed, "Destination too small.");
+            return false;
+        }
+
+        op->Target = request.Destination;
+    }
+    else if (length > 0)
+    {
+        op->Buffer = m_bufferPool.Acquire(static_cast<size_t>(length));
+        op->Target = {op->Buffer.GetData(), op->Buffer.GetCapacity()};
+    }
+
+    op->Length = length;
+
+    if (length == 0)
+    {
+        Finish(op, IoStatus::Completed);
+        return false;
+    }
+
+    return true;
+}
+
+void IoService::Finish(const OperationPtr& op, IoStatus status, std::string error)
+{
+    if (op->CancelState.exchange(FINISHING) == CANCEL_REQUESTED)
+        status = IoStatus::Cancelled;
+
+    if (status != IoStatus::Completed)
+    {
+        op->Buffer.Reset();
+        op->Target = {};
+        op->NumRead = 0;
+    }
+
+    op->Error = std::move(error);
+
+    switch (status)
+    {
+        case IoStatus::Completed:
+            m_numCompleted.fetch_add(1, std::memory_order_relaxed);
+            m_bytesRead.fetch_add(op->NumRead, std::memory_order_relaxed);
+            break;
+        case IoStatus::Cancelled:
+            m_numCancelled.fetch_add(1, std::memory_order_relaxed);
+            break;
+        default:
+            m_numFailed.fetch_add(1, std::memory_order_relaxed);
+            break;
+    }
+
+    op->Status.store(status, std::memory_order_release);
+    op->Status.notify_all();
+
+    if (!op->Request.OnComplete)
+        return;
+
+    if (m_jobSystem)
+        m_jobSystem->Run([op] { op->Request.OnComplete(IoHandle(op)); }, &m_callbacks);
+    else
+        op->Request.OnComplete(IoHandle(op));
+}
+
+void IoService::UpdateMaxInFlight(uint32_t numInFlight)
+{
+    uint32_t maxInFlight = m_maxInFlight.load(std::memory_order_relaxed);
+
+    while (numInFlight > maxInFlight &&
+           !m_maxInFlight.compare_exchange_weak(maxInFlight, numInFlight,
+                                                std::memory_order_relaxed))
+    {
+    }
+}
+
+void IoService::ThreadPoolMain()
+{
+    AllocationTracker::SetSubsystem(AllocationSubsystem::Resources);
+
+    std::vector<OperationPtr> ops;
+
+    for (;;)
+    {
+        ops.clear();
+        Dequeue(1, true, &ops);
+
+        if (ops.empty())
+            return;
+
+        UpdateMaxInFlight(m_numInFlight.fetch_add(1, std::memory_order_relaxed) + 1);
+
+        ThreadPoolRead(ops[0]);
+
+        m_numInFlight.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void IoService::ThreadPoolRead(const OperationPtr& op)
+{
+    std::ifstream file(op->Request.Path, std::ios::binary);
+
+    std::error_code error;
+    uint64_t fileSize = fs::file_size(op->Request.Path, error);
+
+    if (!file.is_open() || error)
+    {
+        Finish(op, IoStatus::Failed, "Could not open file.");
+        return;
+    }
+
+    if (!Prepare(op, fileSize))
+        return;
+
+    file.seekg(static_cast<std::streamoff>(op->Request.Offset));
+    file.read(reinterpret_cast<char*>(op->Target.data()),
+              static_cast<std::streamsize>(op->Length));
+
+    op->NumRead = static_cast<uint64_t>(file.gcount());
+
+    if (op->NumRead < op->Length)
+        Finish(op, IoStatus::Failed, "Unexpected end of file.");
+    else
+        Finish(op, IoStatus::Completed);
+}
+
+void IoService::IoUringMain(std::promise<void>* started)
+{
+#if defined(__linux__)
+    AllocationTracker::SetSubsystem(AllocationSubsystem::Resources);
+
+    std::unique_ptr<IoUring> ring;
+
+    try
+    {
+        ring = std::make_unique<IoUring>(m_options.QueueDepth);
+    }
+    catch (const std::exception&)
+    {
+        started->set_exception(std::current_exception());
+        return;
+    }
+
+    started->set_value();
+
+    // Operations in flight by slot, which completions carry as their user data.
+    std::vector<OperationPtr> inFlight(m_options.QueueDepth);
+    std::vector<uint32_t> freeSlots(m_options.QueueDepth);
+
+    for (uint32_t i = 0; i < m_options.QueueDepth; ++i)
+        freeSlots[i] = m_options.QueueDepth - 1 - i;
+
+    auto complete = [&](uint32_t slot, IoStatus status, std::string error = {}) {
+        OperationPtr op = std::move(inFlight[slot]);
+
+        close(op->Fd);
+        op->Fd = -1;
+
+        if (status == IoStatus::Completed && op->Unbuffered)
+            m_numUnbuffered.fetch_add(1, std::memory_order_relaxed);
+
+        Finish(op, status, std::move(error));
+
+        freeSlots.push_back(slot);
+    };
+
+    std::vector<OperationPtr> ops;
+
+    for (;;)
+    {
+        uint32_t numInFlight = m_options.QueueDepth - static_cast<uint32_t>(freeSlots.size());
+
+        // New requests are only picked up between completions while reads are in flight, as the
+        // thread waits for those in the kernel.
+        ops.clear();
+        Dequeue(freeSlots.size(), numInFlight == 0, &ops);
+
+        if (ops.empty() && numInFlight == 0)
+            return;
+
+        for (const OperationPtr& op : ops)
+        {
+            const char* path = op->Request.Path.c_str();
+
+            op->Fd = open(path, O_RDONLY | O_CLOEXEC);
+
+            struct stat fileStat{};
+
+            if (op->Fd < 0 || fstat(op->Fd, &fileStat) != 0)
+            {
+                if (op->Fd >= 0)
+                    close(op->Fd);
+
+                Finish(op, IoStatus::Failed, "Could not open file.");
+                continue;
+            }
+
+            if (!Prepare(op, static_cast<uint64_t>(fileStat.st_size)))
+            {
+                close(op->Fd);
+                continue;
+            }
+
+            // File systems without unbuffered reads refuse the flag, and the read stays buffered.
+            if (m_options.Unbuffered && CanReadUnbuffered(*op))
+                SetUnbuffered(op.get(), true);
+
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+
+            inFlight[slot] = op;
+            PrepareRead(ring.get(), op.get(), slot);
+        }
+
+        numInFlight = m_options.QueueDepth - static_cast<uint32_t>(freeSlots.size());
+        UpdateMaxInFlight(numInFlight);
+
+        if (numInFlight == 0)
+            continue;
+
+        m_numSubmitCalls.fetch_add(ring->Enter(1), std::memory_order_relaxed);
+
+        ring->ForEachCompletion([&](uint64_t userData, int32_t result) {
+            auto slot = static_cast<uint32_t>(userData);
+            IoOperation* op = inFlight[slot].get();
+
+            if (result == -EINTR || result == -EAGAIN)
+            {
+                PrepareRead(ring.get(), op, slot);
+                return;
+            }
+
+            // Some file systems only refuse unbuffered reads once they are issued.
+            if (result == -EINVAL && op->Unbuffered)
+            {
+                SetUnbuffered(op, false);
+                PrepareRead(ring.get(), op, slot);
+                return;
+            }
+
+            if (result < 0)
+            {
+                complete(slot, IoStatus::Failed, std::strerror(-result));
+                return;
+            }
+
+            if (result == 0)
+            {
+                complete(slot, IoStatus::Failed, "Unexpected end of file.");
+                return;
+            }
+
+            op->NumRead = std::min(op->NumRead + static_cast<uint64_t>(result), op->Length);
+
+            if (op->NumRead == op->Length)
+            {
+                complete(slot, IoStatus::Completed);
+                return;
+            }
+
+            // A short read can leave the rest misaligned.
+            if (op->Unbuffered && !CanReadUnbuffered(*op))
+                SetUnbuffered(op, false);
+
+            PrepareRead(ring.get(), op, slot);
+        });
+    }
+#else
+    started->set_exception(
+        std::make_exception_ptr(std::runtime_error("I/O backend not supported.")));
+#endif
+}
@@ -0,0 +1,314 @@
+#pragma once
+
+#include "JobSystem.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+class IoBufferPool;
+
+// A read buffer from an IoBufferPool, aligned for unbuffered reads. Returns to the pool when
+// destroyed, which must happen before the pool is destroyed.
+class IoBuffer
+{
+public:
+    IoBuffer() = default;
+
+    IoBuffer(IoBuffer&& other) noexcept;
+    IoBuffer& operator=(IoBuffer&& other) noexcept;
+
+    ~IoBuffer();
+
+    std::byte* GetData() const
+    {
+        return m_data;
+    }
+
+    size_t GetCapacity() const
+    {
+        return m_capacity;
+    }
+
+    void Reset();
+
+private:
+    friend class IoBufferPool;
+
+    IoBuffer(IoBufferPool* pool, std::byte* data, size_t capacity);
+
+    IoBufferPool* m_pool = nullptr;
+    std::byte* m_data = nullptr;
+    size_t m_capacity = 0;
+};
+
+// Keeps released read buffers for reuse, by power-of-two size class. Thread-safe.
+class IoBufferPool
+{
+public:
+    // Of every buffer's address and capacity. Covers the sector size of any disk.
+    static constexpr size_t ALIGNMENT = 4096;
+
+    static constexpr size_t MIN_CAPACITY = 64 * 1024;
+
+    // Larger buffers are freed on release rather than kept.
+    static constexpr size_t MAX_POOLED_CAPACITY = 64 * 1024 * 1024;
+
+    // At most |maxCachedBytes| of released buffers are kept.
+    explicit IoBufferPool(size_t maxCachedBytes = 256 * 1024 * 1024);
+    ~IoBufferPool();
+
+    IoBufferPool(const IoBufferPool&) = delete;
+    IoBufferPool& operator=(const IoBufferPool&) = delete;
+
+    // The capacity is |size| rounded up to its size class.
+    IoBuffer Acquire(size_t size);
+
+    struct Stats
+    {
+        uint64_t NumAcquired = 0;
+
+        // Acquisitions served by a released buffer.
+        uint64_t NumReused = 0;
+
+        uint64_t CachedBytes = 0;
+    };
+
+    Stats GetStats() const;
+
+private:
+    friend class IoBuffer;
+
+    void Release(std::byte* data, size_t capacity);
+
+    size_t m_maxCachedBytes;
+
+    mutable std::mutex m_mutex;
+
+    // Released buffers per size class, MIN_CAPACITY << i.
+    std::vector<std::vector<std::byte*>> m_free;
+
+    Stats m_stats;
+};
+
+enum class IoBackend
+{
+    // Linux only. Reads of every file in flight are submitted with one system call.
+    IoUring,
+
+    // Blocking reads on I/O threads, one per read in flight.
+    ThreadPool
+};
+
+const char* GetIoBackendName(IoBackend backend);
+
+// Whether the OS supports |backend|. io_uring may be unavailable even on Linux, if the kernel is
+// too old or a sandbox forbids it.
+bool IsIoBackendSupported(IoBackend backend);
+
+// Queued reads are started highest priority first, and in submission order within a priority.
+enum class IoPriority : uint8_t
+{
+    High,
+    Normal,
+    Low,
+
+    Count
+};
+
+enum class IoStatus : uint8_t
+{
+    Pending,
+    Completed,
+    Cancelled,
+    Failed
+};
+
+class IoHandle;
+
+struct IoRequest
+{
+    std::filesystem::path Path;
+
+    uint64_t Offset = 0;
+
+    // Bytes to read, or zero for the rest of the file. Reads stop early at the end of the file.
+    uint64_t Size = 0;
+
+    // Where the data lands, such as upload memory. Must hold every byte that is read, or the read
+    // fails. Unbuffered reads fill whole blocks, so may write past the data where there is room.
+    // Data lands in a buffer from the service's pool when empty.
+    std::span<std::byte> Destination;
+
+    IoPriority Priority = IoPriority::Normal;
+
+    // Runs as a job once the read has finished, whatever its status. The handle is ready by then.
+    std::function<void(const IoHandle& handle)> OnComplete;
+};
+
+struct IoOperation;
+
+// Counted reference to a read submitted to an IoService. Must not outlive the service.
+class IoHandle
+{
+public:
+    IoHandle() = default;
+
+    explicit operator bool() const
+    {
+        return m_op != nullptr;
+    }
+
+    bool IsReady() const;
+
+    // Blocks until the read has finished. Returns its status.
+    IoStatus Wait() const;
+
+    // Queued reads are dropped. Reads in flight still run to the end, then report Cancelled and
+    // release their data. Reads that have finished are left alone. Returns whether the read will
+    // report Cancelled.
+    bool Cancel() const;
+
+    IoStatus GetStatus() const;
+
+    // The bytes read, once the read has completed. In the request's destination if it had one.
+    std::span<const std::byte> GetData() const;
+
+    // Why the read failed.
+    const std::string& GetError() const;
+
+    // Hands over the pooled buffer the data is in, if the request had no destination.
+    IoBuffer TakeBuffer() const;
+
+private:
+    friend class IoService;
+
+    explicit IoHandle(std::shared_ptr<IoOperation> op);
+
+    std::shared_ptr<IoOperation> m_op;
+};
+
+struct IoOptions
+{
+    // Reads in flight at once: io_uring entries, or I/O threads.
+    uint32_t QueueDepth = 16;
+
+    // Reads bypass the OS page cache where the file system allows it and the destination,
+    // offset and size are aligned. io_uring only.
+    bool Unbuffered = false;
+};
+
+// Reads files in the background. Requests are queued by priority and started as reads in flight
+// finish, up to the queue depth. Completion callbacks run on |jobSystem|, or on an I/O thread if
+// it is null.
+class IoService
+{
+public:
+    // Uses io_uring where the OS supports it unless |backend| is given.
+    IoService(JobSystem* jobSystem, IoOptions options = {});
+    IoService(JobSystem* jobSystem, IoOptions options, IoBackend backend);
+
+    // Cancels every queued read and waits for those in flight and their callbacks.
+    ~IoService();
+
+    IoService(const IoService&) = delete;
+    IoService& operator=(const IoService&) = delete;
+
+    // Thread-safe.
+    IoHandle Submit(IoRequest request);
+
+    // Queues every request at once and wakes the I/O threads once. Moves from |requests|.
+    // Thread-safe.
+    std::vector<IoHandle> SubmitBatch(std::span<IoRequest> requests);
+
+    IoBackend GetBackend() const;
+    const IoOptions& GetOptions() const;
+
+    IoBufferPool& GetBufferPool();
+
+    struct Stats
+    {
+        uint64_t NumCompleted = 0;
+        uint64_t NumCancelled = 0;
+        uint64_t NumFailed = 0;
+
+        uint64_t BytesRead = 0;
+
+        // Completed reads that bypassed the page cache.
+        uint64_t NumUnbuffered = 0;
+
+        // io_uring_enter calls, each of which submits every read prepared since the last.
+        uint64_t NumSubmitCalls = 0;
+
+        uint32_t MaxInFlight = 0;
+    };
+
+    Stats GetStats() const;
+
+private:
+    friend class IoHandle;
+
+    using OperationPtr = std::shared_ptr<IoOperation>;
+
+    // Falls back to the thread pool if io_uring cannot be set up and |fallBack| is set, and throws
+    // otherwise.
+    void Start(bool fallBack);
+
+    void Enqueue(std::span<IoRequest> requests, std::vector<IoHandle>* outHandles);
+
+    // Takes up to |maxCount| queued operations, highest priority first, waiting for one if |wait|
+    // is set. Takes none once stopping.
+    void Dequeue(size_t maxCount, bool wait, std::vector<OperationPtr>* outOps);
+
+    bool Cancel(const OperationPtr& op);
+
+    // Sizes the read to the file and picks where the data lands. Returns false, having finished
+    // the operation, if there is nothing to read.
+    bool Prepare(const OperationPtr& op, uint64_t fileSize);
+
+    void Finish(const OperationPtr& op, IoStatus status, std::string error = {});
+
+    void UpdateMaxInFlight(uint32_t numInFlight);
+
+    void ThreadPoolMain();
+    void ThreadPoolRead(const OperationPtr& op);
+
+    // Sets |started| once the ring is set up, or its exception if that failed.
+    void IoUringMain(std::promise<void>* started);
+
+    JobSystem* m_jobSystem;
+    IoOptions m_options;
+    IoBackend m_backend;
+
+    IoBufferPool m_bufferPool;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<OperationPtr> m_queues[static_cast<size_t>(IoPriority::Count)];
+    bool m_stop = false;
+
+    std::vector<std::thread> m_threads;
+
+    // Callback jobs still to run.
+    JobCounter m_callbacks;
+
+    std::atomic<uint64_t> m_numCompleted = 0;
+    std::atomic<uint64_t> m_numCancelled = 0;
+    std::atomic<uint64_t> m_numFailed = 0;
+    std::atomic<uint64_t> m_bytesRead = 0;
+    std::atomic<uint64_t> m_numUnbuffered = 0;
+    std::atomic<uint64_t> m_numSubmitCalls = 0;
+    std::atomic<uint32_t> m_numInFlight = 0;
+    std::atomic<uint32_t> m_maxInFlight = 0;
+};
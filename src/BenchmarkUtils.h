@@ -0,0 +1,186 @@
+#pragma once
+
+// Helpers shared by the benchmark executables: option parsing, timing, checks and results.
+
+#include <nlohmann/json.hpp>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace benchmark
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Pass/fail results by name. A benchmark exits with an error if any check failed.
+struct Checks
+{
+    nlohmann::json Results = nlohmann::json::object();
+    bool AllPassed = true;
+
+    void Check(const std::string& name, bool passed)
+    {
+        Results[name] = passed;
+        AllPassed = AllPassed && passed;
+    }
+};
+
+inline double ElapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Fastest of |iterations| runs of |fn|, each after |prepare|, which is not timed.
+inline double MeasureMs(int iterations, const std::function<void()>& fn,
+                        const std::function<void()>& prepare = nullptr)
+{
+    double bestMs = 1e30;
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        if (prepare)
+            prepare();
+
+        Clock::time_point start = Clock::now();
+        fn();
+        bestMs = std::min(bestMs, ElapsedMs(start));
+    }
+
+    return bestMs;
+}
+
+inline double GbPerSec(uint64_t bytes, double ms)
+{
+    return ms > 0.0 ? static_cast<double>(bytes) / (ms * 1e6) : 0.0;
+}
+
+// Writes back and evicts |path| from the page cache, so that the next read goes to the disk.
+// Only supported on Linux, and not by every file system.
+inline bool DropFromPageCache(const std::filesystem::path& path)
+{
+#ifdef __linux__
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return false;
+
+    bool dropped = fdatasync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+
+    return dropped;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+// Every regular file under |dir|, sorted.
+inline std::vector<std::filesystem::path> ListFiles(const std::filesystem::path& dir)
+{
+    std::vector<std::filesystem::path> paths;
+
+    for (const auto& item : std::filesystem::recursive_directory_iterator(dir))
+    {
+        if (item.is_regular_file())
+            paths.push_back(item.path());
+    }
+
+    std::sort(paths.begin(), paths.end());
+
+    return paths;
+}
+
+// Parses "--name value" pairs with |parseOption|, which returns false for names it does not know.
+// Names in |switches| take no value and are passed an empty one. Returns false on --help, or
+// having said what was wrong.
+template<typename ParseOption>
+bool ParseArgs(int argc, char** argv, ParseOption parseOption,
+               std::initializer_list<std::string_view> switches = {})
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--help")
+            return false;
+
+        std::string value;
+
+        if (std::find(switches.begin(), switches.end(), arg) == switches.end())
+        {
+            if (i + 1 >= argc)
+            {
+                std::fprintf(stderr, "Missing value for %s.\n", arg.c_str());
+                return false;
+            }
+
+            value = argv[++i];
+        }
+
+        if (!parseOption(arg, value))
+        {
+            std::fprintf(stderr, "Unknown option %s.\n", arg.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Writes |results| to |path|. Returns false, having said so, if the file cannot be written.
+inline bool WriteResults(const nlohmann::json& results, const std::string& path)
+{
+    std::ofstream file(path);
+
+    if (!file)
+    {
+        std::fprintf(stderr, "Could not open %s.\n", path.c_str());
+        return false;
+    }
+
+    file << results.dump(2) << "\n";
+
+    return true;
+}
+
+// The body of a benchmark's main(). Parses the command line into |Options| with
+// |parseOptions|, printing |usage| if that fails, and returns the exit code of |runBenchmark|.
+template<typename Options, typename ParseOptions, typename RunBenchmark>
+int Main(int argc, char** argv, const std::string& usage, ParseOptions parseOptions,
+         RunBenchmark runBenchmark)
+{
+    try
+    {
+        Options options;
+
+        if (!parseOptions(argc, argv, &options))
+        {
+            std::printf("%s", usage.c_str());
+            return 1;
+        }
+
+        return runBenchmark(options);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "Benchmark failed: %s\n", e.what());
+        return 1;
+    }
+}
+
+} // namespace benchmark
@@ -1,15 +1,20 @@
 #include "Camera.h"
 
+#include "Profiler.h"
+
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/rotate_vector.hpp>
-#include <winrt/base.h>
 
+#ifdef _MSC_VER
 #pragma warning(push)
 #pragma warning(disable:4201)
+#endif
 #include <glm/gtx/euler_angles.hpp>
+#ifdef _MSC_VER
 #pragma warning(pop)
+#endif
 
-using winrt::check_bool;
+#include <cmath>
 
 Camera::Camera(InputManager* inputManager)
     : m_inputManager(inputManager)
@@ -31,24 +36,16 @@ Camera::Camera(InputManager* inputManager)
 
 void Camera::Tick(double elapsedSec)
 {
-    POINT currentMousePos{};
-    check_bool(GetCursorPos(&currentMousePos));
-
-    float mouseXDiff = 0.f;
-    float mouseYDiff = 0.f;
-
-    if (m_prevMouseX)
-    {
-        mouseXDiff = static_cast<float>(currentMousePos.x - *m_prevMouseX);
-    }
+    PROFILE_SCOPE("Camera::Tick");
 
-    if (m_prevMouseY)
-    {
-        mouseYDiff = static_cast<float>(currentMousePos.y - *m_prevMouseY);
-    }
+    // Cursor movement comes from the input event stream so that replays see the same deltas. It
+    // is consumed so that it only applies once when several steps run in one frame.
+    int mouseDeltaX = 0;
+    int mouseDeltaY = 0;
+    m_inputManager->ConsumeMouseDelta(&mouseDeltaX, &mouseDeltaY);
 
-    m_prevMouseX = currentMousePos.x;
-    m_prevMouseY = currentMousePos.y;
+    float mouseXDiff = static_cast<float>(mouseDeltaX);
+    float mouseYDiff = static_cast<float>(mouseDeltaY);
 
     if (m_middleMouseDown)
     {
@@ -122,19 +119,37 @@ void Camera::Tick(double elapsedSec)
 
         static constexpr float lookSpeed = 0.001f;
 
-        if (m_prevMouseX)
-        {
-            m_yaw += mouseXDiff * lookSpeed;
-        }
-
-        if (m_prevMouseY)
-        {
-            m_pitch += mouseYDiff * lookSpeed;
-        }
+        m_yaw += mouseXDiff * lookSpeed;
+        m_pitch += mouseYDiff * lookSpeed;
     }
 }
 
-glm::mat4 Camera::GetViewMat()
+CameraState Camera::GetState() const
 {
-    return glm::eulerAngleXY(-m_pitch, -m_yaw) * glm::translate(glm::mat4(1.f), -m_position);
+    CameraState state{};
+    state.Position = m_position;
+    state.Yaw = m_yaw;
+    state.Pitch = m_pitch;
+
+    return state;
+}
+
+glm::mat4 Camera::GetViewMat() const
+{
+    return GetState().GetViewMat();
+}
+
+glm::mat4 CameraState::GetViewMat() const
+{
+    return glm::eulerAngleXY(-Pitch, -Yaw) * glm::translate(glm::mat4(1.f), -Position);
+}
+
+CameraState CameraState::Lerp(const CameraState& from, const CameraState& to, float t)
+{
+    CameraState state{};
+    state.Position = glm::mix(from.Position, to.Position, t);
+    state.Yaw = glm::mix(from.Yaw, to.Yaw, t);
+    state.Pitch = glm::mix(from.Pitch, to.Pitch, t);
+
+    return state;
 }
@@ -4,7 +4,18 @@
 
 #include <glm/glm.hpp>
 
-#include <optional>
+// Pose of the camera at one simulation step. Rendering interpolates between two of these.
+struct CameraState
+{
+    glm::vec3 Position = glm::vec3(0.f);
+
+    float Yaw = 0.f;
+    float Pitch = 0.f;
+
+    glm::mat4 GetViewMat() const;
+
+    static CameraState Lerp(const CameraState& from, const CameraState& to, float t);
+};
 
 class Camera
 {
@@ -13,7 +24,9 @@ public:
 
     void Tick(double elapsedSec);
 
-    glm::mat4 GetViewMat();
+    CameraState GetState() const;
+
+    glm::mat4 GetViewMat() const;
 
 private:
     InputManager* m_inputManager;
@@ -32,9 +45,6 @@ private:
 
     bool m_fpsMode = false;
 
-    std::optional<int> m_prevMouseX;
-    std::optional<int> m_prevMouseY;
-
     InputHandle m_upKeyDownHandle;
     InputHandle m_downKeyDownHandle;
     InputHandle m_leftKeyDownHandle;
@@ -0,0 +1,66 @@
+#include "CameraPath.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <numbers>
+
+CameraPath::CameraPath(Type type, const glm::vec3& sceneMin, const glm::vec3& sceneMax)
+    : m_type(type),
+      m_center((sceneMin + sceneMax) * 0.5f),
+      m_extents((sceneMax - sceneMin) * 0.5f)
+{
+}
+
+glm::mat4 CameraPath::GetViewMat(float t) const
+{
+    constexpr float twoPi = 2.f * std::numbers::pi_v<float>;
+    const glm::vec3 up(0.f, 1.f, 0.f);
+
+    if (m_type == Type::Orbit)
+    {
+        float radius = glm::max(m_extents.x, m_extents.z) * 1.5f;
+        float angle = t * twoPi;
+
+        glm::vec3 eye = m_center + glm::vec3(radius * std::cos(angle), 0.f,
+                                             radius * std::sin(angle));
+
+        return glm::lookAt(eye, m_center, up);
+    }
+
+    // Travel back and forth along the longer horizontal axis so the path loops seamlessly.
+    bool alongX = m_extents.x >= m_extents.z;
+
+    glm::vec3 axis = alongX ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 0.f, 1.f);
+    glm::vec3 side = alongX ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(1.f, 0.f, 0.f);
+
+    float halfLength = (alongX ? m_extents.x : m_extents.z) * 0.9f;
+
+    glm::vec3 eye = m_center + axis * (halfLength * -std::cos(t * twoPi));
+    eye.y = m_center.y - m_extents.y * 0.5f;
+
+    // Face the direction of travel, swaying to either side.
+    float direction = std::sin(t * twoPi) >= 0.f ? 1.f : -1.f;
+    float sway = std::sin(t * twoPi * 4.f) * 0.75f;
+
+    glm::vec3 forward = glm::normalize(axis * direction + side * sway);
+
+    return glm::lookAt(eye, eye + forward, up);
+}
+
+bool CameraPath::ParseType(const std::string& name, Type* type)
+{
+    if (name == "orbit")
+    {
+        *type = Type::Orbit;
+        return true;
+    }
+
+    if (name == "flythrough")
+    {
+        *type = Type::Flythrough;
+        return true;
+    }
+
+    return false;
+}
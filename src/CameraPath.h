@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+
+// Deterministic camera motion for benchmarks, so every run sees the same sequence of views.
+class CameraPath
+{
+public:
+    enum class Type
+    {
+        // Circles the scene at mid height, looking at its centre.
+        Orbit,
+
+        // Flies through the scene along its longest axis, sweeping the view from side to side.
+        Flythrough
+    };
+
+    CameraPath(Type type, const glm::vec3& sceneMin, const glm::vec3& sceneMax);
+
+    // Returns the view matrix at |t| in [0, 1], the fraction of the path travelled.
+    glm::mat4 GetViewMat(float t) const;
+
+    static bool ParseType(const std::string& name, Type* type);
+
+private:
+    Type m_type;
+
+    glm::vec3 m_center;
+    glm::vec3 m_extents;
+};
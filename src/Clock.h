@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+
+// Time source used by components that need to be driven deterministically in tests and replays.
+class Clock
+{
+public:
+    using Duration = std::chrono::nanoseconds;
+
+    // Time since an arbitrary, fixed epoch.
+    using TimePoint = std::chrono::nanoseconds;
+
+    virtual ~Clock() = default;
+
+    virtual TimePoint Now() = 0;
+
+    virtual void SleepFor(Duration duration) = 0;
+};
+
+class SteadyClock : public Clock
+{
+public:
+    TimePoint Now() override
+    {
+        return std::chrono::duration_cast<TimePoint>(
+            std::chrono::steady_clock::now().time_since_epoch());
+    }
+
+    void SleepFor(Duration duration) override
+    {
+        std::this_thread::sleep_for(duration);
+    }
+};
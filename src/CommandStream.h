@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class CommandType : uint32_t
+{
+    SetBaseColorTexture,
+    SetGeometry,
+    SetInstanceCount,
+    DrawIndexed
+};
+
+struct Command
+{
+    CommandType Type;
+    uint32_t Value;
+};
+
+// API-independent list of draw commands for one frame. Redundant state changes are filtered out
+// while recording, and a backend translates the remaining commands into its own command list.
+//
+// Every draw is instanced. Draws consume the frame's instance data in order, each taking the next
+// SetInstanceCount entries, so a backend finds a draw's first instance by counting.
+class CommandStream
+{
+public:
+    // Redundant state changes are dropped, so a draw records each command type at most once.
+    static constexpr size_t MAX_COMMANDS_PER_DRAW = 4;
+
+    void Reserve(size_t numCommands)
+    {
+        m_commands.reserve(numCommands);
+    }
+
+    void Reset()
+    {
+        m_commands.clear();
+
+        for (auto& state : m_currentState)
+        {
+            state = INVALID_STATE;
+        }
+
+        m_numDraws = 0;
+        m_numInstances = 0;
+        m_numStateChanges = 0;
+        m_numTriangles = 0;
+    }
+
+    void SetBaseColorTexture(uint32_t textureId)
+    {
+        SetState(CommandType::SetBaseColorTexture, textureId);
+    }
+
+    // Index into the backend's table of vertex/index buffer bindings.
+    void SetGeometry(uint32_t geometryIdx)
+    {
+        SetState(CommandType::SetGeometry, geometryIdx);
+    }
+
+    void DrawIndexed(uint32_t indexCount, uint32_t instanceCount = 1)
+    {
+        SetState(CommandType::SetInstanceCount, instanceCount);
+
+        m_commands.push_back({CommandType::DrawIndexed, indexCount});
+
+        ++m_numDraws;
+        m_numInstances += instanceCount;
+        m_numTriangles += static_cast<uint64_t>(indexCount / 3) * instanceCount;
+    }
+
+    const std::vector<Command>& GetCommands() const
+    {
+        return m_commands;
+    }
+
+    uint32_t GetNumDraws() const
+    {
+        return m_numDraws;
+    }
+
+    uint32_t GetNumInstances() const
+    {
+        return m_numInstances;
+    }
+
+    uint32_t GetNumStateChanges() const
+    {
+        return m_numStateChanges;
+    }
+
+    uint64_t GetNumTriangles() const
+    {
+        return m_numTriangles;
+    }
+
+private:
+    static constexpr uint32_t INVALID_STATE = UINT32_MAX;
+
+    void SetState(CommandType type, uint32_t value)
+    {
+        uint32_t& current = m_currentState[static_cast<int>(type)];
+
+        if (current == value)
+            return;
+
+        current = value;
+
+        m_commands.push_back({type, value});
+
+        ++m_numStateChanges;
+    }
+
+    std::vector<Command> m_commands;
+
+    uint32_t m_currentState[static_cast<int>(CommandType::DrawIndexed)] = {
+        INVALID_STATE, INVALID_STATE, INVALID_STATE
+    };
+
+    uint32_t m_numDraws = 0;
+    uint32_t m_numInstances = 0;
+    uint32_t m_numStateChanges = 0;
+    uint64_t m_numTriangles = 0;
+};
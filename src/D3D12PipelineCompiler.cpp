@@ -0,0 +1,232 @@
+#include "D3D12PipelineCompiler.h"
+
+#include "Hash.h"
+
+#include <d3dx12.h>
+
+using winrt::check_hresult;
+using winrt::com_ptr;
+
+namespace
+{
+
+D3D12_BLEND_DESC GetBlendDesc(BlendMode mode)
+{
+    D3D12_BLEND_DESC desc = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+
+    D3D12_RENDER_TARGET_BLEND_DESC& target = desc.RenderTarget[0];
+
+    switch (mode)
+    {
+        case BlendMode::Opaque:
+            break;
+        case BlendMode::Alpha:
+            target.BlendEnable = true;
+            target.SrcBlend = D3D12_BLEND_SRC_ALPHA;
+            target.DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
+            target.SrcBlendAlpha = D3D12_BLEND_ONE;
+            target.DestBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA;
+            break;
+        case BlendMode::Additive:
+            target.BlendEnable = true;
+            target.SrcBlend = D3D12_BLEND_ONE;
+            target.DestBlend = D3D12_BLEND_ONE;
+            target.SrcBlendAlpha = D3D12_BLEND_ONE;
+            target.DestBlendAlpha = D3D12_BLEND_ONE;
+            break;
+    }
+
+    return desc;
+}
+
+D3D12_RASTERIZER_DESC GetRasterizerDesc(const RasterState& state)
+{
+    D3D12_RASTERIZER_DESC desc = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+
+    desc.FillMode = state.Fill == FillMode::Wireframe ? D3D12_FILL_MODE_WIREFRAME :
+                                                        D3D12_FILL_MODE_SOLID;
+
+    switch (state.Cull)
+    {
+        case CullMode::None:
+            desc.CullMode = D3D12_CULL_MODE_NONE;
+            break;
+        case CullMode::Front:
+            desc.CullMode = D3D12_CULL_MODE_FRONT;
+            break;
+        case CullMode::Back:
+            desc.CullMode = D3D12_CULL_MODE_BACK;
+            break;
+    }
+
+    desc.FrontCounterClockwise = state.FrontCounterClockwise;
+    desc.DepthClipEnable = state.DepthClip;
+    desc.DepthBias = state.DepthBias;
+    desc.SlopeScaledDepthBias = state.SlopeScaledDepthBias;
+
+    return desc;
+}
+
+D3D12_DEPTH_STENCIL_DESC GetDepthStencilDesc(const DepthState& state)
+{
+    D3D12_DEPTH_STENCIL_DESC desc = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+
+    desc.DepthEnable = state.DepthEnable;
+    desc.DepthWriteMask = state.DepthWrite ? D3D12_DEPTH_WRITE_MASK_ALL :
+                                             D3D12_DEPTH_WRITE_MASK_ZERO;
+
+    // CompareFunc follows the order of D3D12_COMPARISON_FUNC.
+    desc.DepthFunc = static_cast<D3D12_COMPARISON_FUNC>(
+        D3D12_COMPARISON_FUNC_NEVER + static_cast<int>(state.DepthFunc));
+
+    return desc;
+}
+
+D3D12_PRIMITIVE_TOPOLOGY_TYPE GetTopologyType(PrimitiveTopology topology)
+{
+    switch (topology)
+    {
+        case PrimitiveTopology::Point:
+            return D3D12_PRIMITIVE_TOPOLOGY_TYPE_POINT;
+        case PrimitiveTopology::Line:
+            return D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE;
+        case PrimitiveTopology::Triangle:
+            return D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    }
+
+    return D3D12_PRIMITIVE_TOPOLOGY_TYPE_UNDEFINED;
+}
+
+// Returned when a cached blob was produced by another adapter or driver, or is otherwise
+// unusable.
+bool IsCachedBlobRejection(HRESULT hr)
+{
+    return hr == D3D12_ERROR_ADAPTER_NOT_FOUND || hr == D3D12_ERROR_DRIVER_VERSION_MISMATCH ||
+        hr == E_INVALIDARG;
+}
+
+} // namespace
+
+D3D12Pipeline::D3D12Pipeline(com_ptr<ID3D12PipelineState> state)
+    : m_state(std::move(state))
+{
+}
+
+ID3D12PipelineState* D3D12Pipeline::GetState() const
+{
+    return m_state.get();
+}
+
+std::vector<std::byte> D3D12Pipeline::GetCachedBlob() const
+{
+    com_ptr<ID3DBlob> blob;
+
+    if (FAILED(m_state->GetCachedBlob(blob.put())))
+        return {};
+
+    const std::byte* data = static_cast<const std::byte*>(blob->GetBufferPointer());
+
+    return std::vector<std::byte>(data, data + blob->GetBufferSize());
+}
+
+ID3D12PipelineState* GetD3D12PipelineState(Pipeline* pipeline)
+{
+    return static_cast<D3D12Pipeline*>(pipeline)->GetState();
+}
+
+D3D12PipelineCompiler::D3D12PipelineCompiler(ID3D12Device* device, IDXGIAdapter1* adapter)
+    : m_device(device)
+{
+    DXGI_ADAPTER_DESC1 adapterDesc{};
+    check_hresult(adapter->GetDesc1(&adapterDesc));
+
+    // The user-mode driver version. This is the documented way to query it even though
+    // IDXGIDevice itself is not supported through this call.
+    LARGE_INTEGER driverVersion{};
+    adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion);
+
+    Hasher hasher;
+    hasher.Add(adapterDesc.VendorId);
+    hasher.Add(adapterDesc.DeviceId);
+    hasher.Add(adapterDesc.SubSysId);
+    hasher.Add(adapterDesc.Revision);
+    hasher.Add(driverVersion.QuadPart);
+
+    m_driverHash = hasher.GetHash();
+}
+
+com_ptr<ID3D12RootSignature> D3D12PipelineCompiler::CreateRootSignature(
+    const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc, uint64_t* hash)
+{
+    com_ptr<ID3DBlob> signatureBlob;
+    com_ptr<ID3DBlob> errorBlob;
+    check_hresult(D3D12SerializeVersionedRootSignature(&desc, signatureBlob.put(),
+                                                       errorBlob.put()));
+
+    com_ptr<ID3D12RootSignature> rootSig;
+    check_hresult(m_device->CreateRootSignature(0, signatureBlob->GetBufferPointer(),
+                                                signatureBlob->GetBufferSize(),
+                                                IID_PPV_ARGS(rootSig.put())));
+
+    Hasher hasher;
+    hasher.AddBytes(signatureBlob->GetBufferPointer(), signatureBlob->GetBufferSize());
+    *hash = hasher.GetHash();
+
+    return rootSig;
+}
+
+uint64_t D3D12PipelineCompiler::GetDriverHash() const
+{
+    return m_driverHash;
+}
+
+std::unique_ptr<Pipeline> D3D12PipelineCompiler::Compile(const PipelineDesc& desc,
+                                                         std::span<const std::byte> cachedBlob)
+{
+    std::vector<D3D12_INPUT_ELEMENT_DESC> inputElementDescs;
+    inputElementDescs.reserve(desc.InputLayout.size());
+
+    for (const InputElement& element : desc.InputLayout)
+    {
+        D3D12_INPUT_CLASSIFICATION classification = element.InstanceStepRate ?
+            D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA :
+            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+
+        inputElementDescs.push_back({element.SemanticName, element.SemanticIndex,
+                                     static_cast<DXGI_FORMAT>(element.Format), element.InputSlot,
+                                     element.AlignedByteOffset, classification,
+                                     element.InstanceStepRate});
+    }
+
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC pipelineDesc{};
+    pipelineDesc.InputLayout.pInputElementDescs = inputElementDescs.data();
+    pipelineDesc.InputLayout.NumElements = static_cast<UINT>(inputElementDescs.size());
+    pipelineDesc.pRootSignature = static_cast<ID3D12RootSignature*>(desc.RootSignature);
+    pipelineDesc.VS = {desc.VS.Data, desc.VS.Size};
+    pipelineDesc.PS = {desc.PS.Data, desc.PS.Size};
+    pipelineDesc.RasterizerState = GetRasterizerDesc(desc.Raster);
+    pipelineDesc.BlendState = GetBlendDesc(desc.Blend);
+    pipelineDesc.DepthStencilState = GetDepthStencilDesc(desc.Depth);
+    pipelineDesc.SampleMask = UINT_MAX;
+    pipelineDesc.PrimitiveTopologyType = GetTopologyType(desc.Topology);
+    pipelineDesc.NumRenderTargets = desc.NumRenderTargets;
+
+    for (uint32_t i = 0; i < desc.NumRenderTargets && i < PipelineDesc::MAX_RENDER_TARGETS; ++i)
+    {
+        pipelineDesc.RTVFormats[i] = static_cast<DXGI_FORMAT>(desc.RenderTargetFormats[i]);
+    }
+
+    pipelineDesc.DSVFormat = static_cast<DXGI_FORMAT>(desc.DepthFormat);
+    pipelineDesc.SampleDesc.Count = desc.SampleCount;
+    pipelineDesc.CachedPSO = {cachedBlob.data(), cachedBlob.size()};
+
+    com_ptr<ID3D12PipelineState> state;
+    HRESULT hr = m_device->CreateGraphicsPipelineState(&pipelineDesc, IID_PPV_ARGS(state.put()));
+
+    if (!cachedBlob.empty() && IsCachedBlobRejection(hr))
+        return nullptr;
+
+    check_hresult(hr);
+
+    return std::make_unique<D3D12Pipeline>(std::move(state));
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "PipelineCache.h"
+
+#include <d3d12.h>
+#include <dxgi1_6.h>
+#include <winrt/base.h>
+
+#include <cstdint>
+
+class D3D12Pipeline : public Pipeline
+{
+public:
+    explicit D3D12Pipeline(winrt::com_ptr<ID3D12PipelineState> state);
+
+    ID3D12PipelineState* GetState() const;
+
+    std::vector<std::byte> GetCachedBlob() const override;
+
+private:
+    winrt::com_ptr<ID3D12PipelineState> m_state;
+};
+
+// |pipeline| must have been created by a D3D12PipelineCompiler.
+ID3D12PipelineState* GetD3D12PipelineState(Pipeline* pipeline);
+
+class D3D12PipelineCompiler : public PipelineCompiler
+{
+public:
+    D3D12PipelineCompiler(ID3D12Device* device, IDXGIAdapter1* adapter);
+
+    // Also returns the hash of the serialized root signature, for PipelineDesc::RootSignatureHash.
+    winrt::com_ptr<ID3D12RootSignature> CreateRootSignature(
+        const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc, uint64_t* hash);
+
+    uint64_t GetDriverHash() const override;
+
+    std::unique_ptr<Pipeline> Compile(const PipelineDesc& desc,
+                                      std::span<const std::byte> cachedBlob) override;
+
+private:
+    ID3D12Device* m_device;
+
+    uint64_t m_driverHash = 0;
+};
@@ -10,8 +10,10 @@
 using winrt::check_hresult;
 using winrt::com_ptr;
 
-DebugPass::DebugPass(Scene* scene, ID3D12Device* device, GpuResourceManager* resourceManager)
-    : m_scene(scene), m_device(device), m_resourceManager(resourceManager)
+DebugPass::DebugPass(Scene* scene, ID3D12Device* device, GpuResourceManager* resourceManager,
+                     D3D12PipelineCompiler* pipelineCompiler, PipelineCache* pipelineCache)
+    : m_scene(scene), m_device(device), m_resourceManager(resourceManager),
+      m_pipelineCompiler(pipelineCompiler), m_pipelineCache(pipelineCache)
 {
     CreatePipelineState();
 
@@ -33,43 +35,21 @@ void DebugPass::CreatePipelineState()
     rootSigDesc.Init_1_1(1, &rootParam, 0, nullptr,
                          D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
-    com_ptr<ID3DBlob> signatureBlob;
-    com_ptr<ID3DBlob> errorBlob;
-    check_hresult(D3D12SerializeVersionedRootSignature(&rootSigDesc, signatureBlob.put(),
-                                                       errorBlob.put()));
-    check_hresult(m_device->CreateRootSignature(0, signatureBlob->GetBufferPointer(),
-                                                signatureBlob->GetBufferSize(),
-                                                IID_PPV_ARGS(m_rootSig.put())));
-
-    D3D12_INPUT_ELEMENT_DESC inputElementDescs[] = {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,
-         D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+    m_rootSig = m_pipelineCompiler->CreateRootSignature(rootSigDesc, &m_rootSigHash);
+
+    PipelineDesc pipelineDesc{};
+    pipelineDesc.RootSignature = m_rootSig.get();
+    pipelineDesc.RootSignatureHash = m_rootSigHash;
+    pipelineDesc.VS = {g_debugVS, sizeof(g_debugVS)};
+    pipelineDesc.PS = {g_debugPS, sizeof(g_debugPS)};
+    pipelineDesc.InputLayout = {
+        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0}
     };
+    pipelineDesc.Raster.Fill = FillMode::Wireframe;
+    pipelineDesc.RenderTargetFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+    pipelineDesc.DepthFormat = DXGI_FORMAT_D32_FLOAT;
 
-    D3D12_INPUT_LAYOUT_DESC inputLayoutDesc{};
-    inputLayoutDesc.pInputElementDescs = inputElementDescs;
-    inputLayoutDesc.NumElements = _countof(inputElementDescs);
-
-    D3D12_RASTERIZER_DESC rasterizer = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-    rasterizer.FillMode = D3D12_FILL_MODE_WIREFRAME;
-
-    D3D12_GRAPHICS_PIPELINE_STATE_DESC pipelineDesc{};
-    pipelineDesc.InputLayout = inputLayoutDesc;
-    pipelineDesc.pRootSignature = m_rootSig.get();
-    pipelineDesc.VS = CD3DX12_SHADER_BYTECODE(g_debugVS, ARRAYSIZE(g_debugVS));
-    pipelineDesc.PS = CD3DX12_SHADER_BYTECODE(g_debugPS, ARRAYSIZE(g_debugPS));;
-    pipelineDesc.RasterizerState = rasterizer;
-    pipelineDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-    pipelineDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
-    pipelineDesc.SampleMask = UINT_MAX;
-    pipelineDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-    pipelineDesc.NumRenderTargets = 1;
-    pipelineDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-    pipelineDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
-    pipelineDesc.SampleDesc.Count = 1;
-
-    check_hresult(m_device->CreateGraphicsPipelineState(&pipelineDesc,
-                                                        IID_PPV_ARGS(m_pipeline.put())));
+    m_pipelineRequest = m_pipelineCache->Request(pipelineDesc);
 }
 
 namespace
@@ -160,7 +140,7 @@ void DebugPass::RecordCommands(const glm::mat4& viewProjMat, ID3D12GraphicsComma
 
     m_constantsPtr->WorldViewProjMatrix = viewProjMat * modelMat;
 
-    cmdList->SetPipelineState(m_pipeline.get());
+    cmdList->SetPipelineState(GetD3D12PipelineState(m_pipelineRequest.Wait()));
     cmdList->SetGraphicsRootSignature(m_rootSig.get());
 
     cmdList->SetGraphicsRootConstantBufferView(0, m_constantBuffer->GetGPUVirtualAddress());
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "D3D12PipelineCompiler.h"
 #include "GpuResourceManager.h"
+#include "PipelineCache.h"
 #include "Scene.h"
 
 #include <d3d12.h>
@@ -10,7 +12,8 @@
 class DebugPass
 {
 public:
-    DebugPass(Scene* scene, ID3D12Device* device, GpuResourceManager* resourceManager);
+    DebugPass(Scene* scene, ID3D12Device* device, GpuResourceManager* resourceManager,
+              D3D12PipelineCompiler* pipelineCompiler, PipelineCache* pipelineCache);
 
     void RecordCommands(const glm::mat4& viewProjMat, ID3D12GraphicsCommandList* cmdList);
 
@@ -27,8 +30,13 @@ private:
 
     GpuResourceManager* m_resourceManager;
 
+    D3D12PipelineCompiler* m_pipelineCompiler;
+    PipelineCache* m_pipelineCache;
+
     winrt::com_ptr<ID3D12RootSignature> m_rootSig;
-    winrt::com_ptr<ID3D12PipelineState> m_pipeline;
+    uint64_t m_rootSigHash = 0;
+
+    PipelineRequest m_pipelineRequest;
 
     winrt::com_ptr<ID3D12Resource> m_positionBuffer;
     size_t m_positionBufferSize = 0;
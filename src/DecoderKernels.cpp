@@ -0,0 +1,1225 @@
+#include "DecoderKernels.h"
+
+#include "Simd.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+
+// Fixed point constants of the libjpeg accurate integer IDCT, FIX(x) = round(x * 2^13).
+constexpr int IDCT_CONST_BITS = 13;
+constexpr int IDCT_PASS1_BITS = 2;
+constexpr int IDCT_PASS1_SHIFT = IDCT_CONST_BITS - IDCT_PASS1_BITS;
+constexpr int IDCT_PASS2_SHIFT = IDCT_CONST_BITS + IDCT_PASS1_BITS + 3;
+
+constexpr int32_t FIX_0_298631336 = 2446;
+constexpr int32_t FIX_0_390180644 = 3196;
+constexpr int32_t FIX_0_541196100 = 4433;
+constexpr int32_t FIX_0_765366865 = 6270;
+constexpr int32_t FIX_0_899976223 = 7373;
+constexpr int32_t FIX_1_175875602 = 9633;
+constexpr int32_t FIX_1_501321110 = 12299;
+constexpr int32_t FIX_1_847759065 = 15137;
+constexpr int32_t FIX_1_961570560 = 16069;
+constexpr int32_t FIX_2_053119869 = 16819;
+constexpr int32_t FIX_2_562915447 = 20995;
+constexpr int32_t FIX_3_072711026 = 25172;
+
+// The YCbCr to RGB factors of libjpeg with 16 fractional bits, split into a multiple of 2^16 and
+// a remainder that fits in 16 bits so that the SIMD versions can use 16-bit multiplies:
+// 1.402 = 1 + 26345 / 2^16, 1.772 = 2 - 14942 / 2^16, 0.71414 = 1 - 18734 / 2^16 and
+// 0.34414 = 22554 / 2^16.
+constexpr int32_t CR_TO_R = 26345;
+constexpr int32_t CB_TO_B = -14942;
+constexpr int32_t CR_TO_G = 18734;
+constexpr int32_t CB_TO_G = -22554;
+
+// Emulates the range limit table of libjpeg, which also maps the wildly out of range values that
+// corrupt coefficients can produce.
+uint8_t RangeLimitIdct(int32_t value)
+{
+    int32_t index = (value + 128) & 1023;
+
+    return index < 640 ? static_cast<uint8_t>(std::min(index, 255)) : 0;
+}
+
+uint8_t ClampToByte(int32_t value)
+{
+    return static_cast<uint8_t>(std::clamp(value, 0, 255));
+}
+
+// Lane operations for the IDCT butterfly. The scalar version wraps around like the vector ones,
+// so that corrupt data decodes the same at every level.
+struct ScalarLanes
+{
+    using Type = uint32_t;
+
+    static Type Add(Type a, Type b) { return a + b; }
+    static Type Sub(Type a, Type b) { return a - b; }
+    static Type Mul(Type a, int32_t c) { return a * static_cast<uint32_t>(c); }
+    static Type Shl(Type a, int bits) { return a << bits; }
+
+    // Arithmetic right shift with rounding.
+    static Type Descale(Type a, int bits)
+    {
+        return static_cast<uint32_t>(static_cast<int32_t>(a + (1u << (bits - 1))) >> bits);
+    }
+};
+
+// One pass of the IDCT over 8 inputs, each holding as many independent columns as there are
+// lanes.
+template<typename Lanes>
+void IdctButterfly(typename Lanes::Type* v, int shift)
+{
+    using L = Lanes;
+    using T = typename Lanes::Type;
+
+    // Even part.
+    T z1 = L::Mul(L::Add(v[2], v[6]), FIX_0_541196100);
+    T tmp2 = L::Add(z1, L::Mul(v[6], -FIX_1_847759065));
+    T tmp3 = L::Add(z1, L::Mul(v[2], FIX_0_765366865));
+    T tmp0 = L::Shl(L::Add(v[0], v[4]), IDCT_CONST_BITS);
+    T tmp1 = L::Shl(L::Sub(v[0], v[4]), IDCT_CONST_BITS);
+
+    T tmp10 = L::Add(tmp0, tmp3);
+    T tmp13 = L::Sub(tmp0, tmp3);
+    T tmp11 = L::Add(tmp1, tmp2);
+    T tmp12 = L::Sub(tmp1, tmp2);
+
+    // Odd part.
+    T o0 = v[7];
+    T o1 = v[5];
+    T o2 = v[3];
+    T o3 = v[1];
+
+    T z5 = L::Mul(L::Add(L::Add(o0, o2), L::Add(o1, o3)), FIX_1_175875602);
+    T w1 = L::Mul(L::Add(o0, o3), -FIX_0_899976223);
+    T w2 = L::Mul(L::Add(o1, o2), -FIX_2_562915447);
+    T w3 = L::Add(L::Mul(L::Add(o0, o2), -FIX_1_961570560), z5);
+    T w4 = L::Add(L::Mul(L::Add(o1, o3), -FIX_0_390180644), z5);
+
+    o0 = L::Add(L::Mul(o0, FIX_0_298631336), L::Add(w1, w3));
+    o1 = L::Add(L::Mul(o1, FIX_2_053119869), L::Add(w2, w4));
+    o2 = L::Add(L::Mul(o2, FIX_3_072711026), L::Add(w2, w3));
+    o3 = L::Add(L::Mul(o3, FIX_1_501321110), L::Add(w1, w4));
+
+    v[0] = L::Descale(L::Add(tmp10, o3), shift);
+    v[7] = L::Descale(L::Sub(tmp10, o3), shift);
+    v[1] = L::Descale(L::Add(tmp11, o2), shift);
+    v[6] = L::Descale(L::Sub(tmp11, o2), shift);
+    v[2] = L::Descale(L::Add(tmp12, o1), shift);
+    v[5] = L::Descale(L::Sub(tmp12, o1), shift);
+    v[3] = L::Descale(L::Add(tmp13, o0), shift);
+    v[4] = L::Descale(L::Sub(tmp13, o0), shift);
+}
+
+// Scalar reference versions. The SIMD versions use them for the samples that do not fill a whole
+// vector.
+
+void GrayToRgbaScalar(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+        dst[4 * i + 0] = src[i];
+        dst[4 * i + 1] = src[i];
+        dst[4 * i + 2] = src[i];
+        dst[4 * i + 3] = 255;
+    }
+}
+
+void InverseDctScalar(const int16_t* coefs, const uint16_t* quant, uint8_t* dst,
+                      size_t dstStride)
+{
+    uint32_t workspace[64];
+    uint32_t v[8];
+
+    for (int column = 0; column < 8; ++column)
+    {
+        for (int i = 0; i < 8; ++i)
+            v[i] = static_cast<uint32_t>(coefs[8 * i + column] * quant[8 * i + column]);
+
+        IdctButterfly<ScalarLanes>(v, IDCT_PASS1_SHIFT);
+
+        for (int i = 0; i < 8; ++i)
+            workspace[8 * i + column] = v[i];
+    }
+
+    for (int row = 0; row < 8; ++row)
+    {
+        std::copy_n(workspace + 8 * row, 8, v);
+
+        IdctButterfly<ScalarLanes>(v, IDCT_PASS2_SHIFT);
+
+        for (int i = 0; i < 8; ++i)
+            dst[row * dstStride + i] = RangeLimitIdct(static_cast<int32_t>(v[i]));
+    }
+}
+
+void YCbCrToRgbaScalar(const uint8_t* y, const uint8_t* cb, const uint8_t* cr, uint8_t* dst,
+                       size_t numPixels)
+{
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+        int32_t luma = y[i];
+        int32_t blue = cb[i] - 128;
+        int32_t red = cr[i] - 128;
+
+        dst[4 * i + 0] = ClampToByte(luma + red + ((CR_TO_R * red + 32768) >> 16));
+        dst[4 * i + 1] =
+            ClampToByte(luma - red + ((CB_TO_G * blue + CR_TO_G * red + 32768) >> 16));
+        dst[4 * i + 2] = ClampToByte(luma + 2 * blue + ((CB_TO_B * blue + 32768) >> 16));
+        dst[4 * i + 3] = 255;
+    }
+}
+
+// Writes the output samples of source samples [begin, end) of a horizontal upsample.
+void UpsampleH2Range(const uint8_t* src, uint8_t* dst, size_t numSamples, size_t begin,
+                     size_t end)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        int32_t current = 3 * src[i];
+        int32_t left = src[i > 0 ? i - 1 : 0];
+        int32_t right = src[i + 1 < numSamples ? i + 1 : i];
+
+        dst[2 * i + 0] = static_cast<uint8_t>((current + left + 1) >> 2);
+        dst[2 * i + 1] = static_cast<uint8_t>((current + right + 2) >> 2);
+    }
+}
+
+void UpsampleH2Scalar(const uint8_t* src, uint8_t* dst, size_t numSamples)
+{
+    UpsampleH2Range(src, dst, numSamples, 0, numSamples);
+}
+
+void UpsampleV2Scalar(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst,
+                      size_t numSamples, bool farRowAbove)
+{
+    int32_t bias = farRowAbove ? 1 : 2;
+
+    for (size_t i = 0; i < numSamples; ++i)
+        dst[i] = static_cast<uint8_t>((3 * nearRow[i] + farRow[i] + bias) >> 2);
+}
+
+void UpsampleH2V2Range(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst,
+                       size_t numSamples, size_t begin, size_t end)
+{
+    auto columnSum = [&](size_t i) { return 3 * nearRow[i] + farRow[i]; };
+
+    for (size_t i = begin; i < end; ++i)
+    {
+        int32_t current = 3 * columnSum(i);
+        int32_t left = columnSum(i > 0 ? i - 1 : 0);
+        int32_t right = columnSum(i + 1 < numSamples ? i + 1 : i);
+
+        dst[2 * i + 0] = static_cast<uint8_t>((current + left + 8) >> 4);
+        dst[2 * i + 1] = static_cast<uint8_t>((current + right + 7) >> 4);
+    }
+}
+
+void UpsampleH2V2Scalar(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst,
+                        size_t numSamples)
+{
+    UpsampleH2V2Range(nearRow, farRow, dst, numSamples, 0, numSamples);
+}
+
+uint8_t PaethPredictor(int32_t a, int32_t b, int32_t c)
+{
+    int32_t pa = std::abs(b - c);
+    int32_t pb = std::abs(a - c);
+    int32_t pc = std::abs(a + b - 2 * c);
+
+    if (pa <= pb && pa <= pc)
+        return static_cast<uint8_t>(a);
+
+    return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+
+// Unfilters bytes [begin, rowSize) of a row whose earlier bytes are already done.
+void UnfilterPngRange(uint32_t filter, uint8_t* row, const uint8_t* prevRow, size_t rowSize,
+                      size_t bytesPerPixel, size_t begin)
+{
+    size_t i = begin;
+
+    switch (filter)
+    {
+        case 1:
+            for (i = std::max(i, bytesPerPixel); i < rowSize; ++i)
+                row[i] = static_cast<uint8_t>(row[i] + row[i - bytesPerPixel]);
+            break;
+        case 2:
+            for (; i < rowSize; ++i)
+                row[i] = static_cast<uint8_t>(row[i] + prevRow[i]);
+            break;
+        case 3:
+            for (; i < bytesPerPixel && i < rowSize; ++i)
+                row[i] = static_cast<uint8_t>(row[i] + (prevRow[i] >> 1));
+
+            for (; i < rowSize; ++i)
+            {
+                row[i] = static_cast<uint8_t>(row[i] +
+                                              ((row[i - bytesPerPixel] + prevRow[i]) >> 1));
+            }
+            break;
+        case 4:
+            for (; i < bytesPerPixel && i < rowSize; ++i)
+                row[i] = static_cast<uint8_t>(row[i] + prevRow[i]);
+
+            for (; i < rowSize; ++i)
+            {
+                row[i] = static_cast<uint8_t>(
+                    row[i] + PaethPredictor(row[i - bytesPerPixel], prevRow[i],
+                                            prevRow[i - bytesPerPixel]));
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void UnfilterPngRowScalar(uint32_t filter, uint8_t* row, const uint8_t* prevRow, size_t rowSize,
+                          size_t bytesPerPixel)
+{
+    UnfilterPngRange(filter, row, prevRow, rowSize, bytesPerPixel, 0);
+}
+
+#if defined(GRFX_SIMD_X86)
+
+TARGET_SSE41 void GrayToRgbaSse41(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    const __m128i opaque = _mm_set1_epi8(-1);
+
+    size_t i = 0;
+
+    for (; i + 16 <= numPixels; i += 16)
+    {
+        __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+
+        __m128i grayGrayLo = _mm_unpacklo_epi8(gray, gray);
+        __m128i grayGrayHi = _mm_unpackhi_epi8(gray, gray);
+        __m128i grayAlphaLo = _mm_unpacklo_epi8(gray, opaque);
+        __m128i grayAlphaHi = _mm_unpackhi_epi8(gray, opaque);
+
+        __m128i* out = reinterpret_cast<__m128i*>(dst + 4 * i);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(grayGrayLo, grayAlphaLo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(grayGrayLo, grayAlphaLo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(grayGrayHi, grayAlphaHi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(grayGrayHi, grayAlphaHi));
+    }
+
+    GrayToRgbaScalar(src + i, dst + 4 * i, numPixels - i);
+}
+
+TARGET_SSE41 __m128i MulSse41(__m128i a, int32_t c)
+{
+    return _mm_mullo_epi32(a, _mm_set1_epi32(c));
+}
+
+// Arithmetic right shift with rounding.
+template<int Shift>
+TARGET_SSE41 __m128i DescaleSse41(__m128i a)
+{
+    return _mm_srai_epi32(_mm_add_epi32(a, _mm_set1_epi32(1 << (Shift - 1))), Shift);
+}
+
+// IDCT pass over 8 rows of 4 columns.
+template<int Shift>
+TARGET_SSE41 void IdctButterflySse41(__m128i* v)
+{
+    // Even part.
+    __m128i z1 = MulSse41(_mm_add_epi32(v[2], v[6]), FIX_0_541196100);
+    __m128i tmp2 = _mm_add_epi32(z1, MulSse41(v[6], -FIX_1_847759065));
+    __m128i tmp3 = _mm_add_epi32(z1, MulSse41(v[2], FIX_0_765366865));
+    __m128i tmp0 = _mm_slli_epi32(_mm_add_epi32(v[0], v[4]), IDCT_CONST_BITS);
+    __m128i tmp1 = _mm_slli_epi32(_mm_sub_epi32(v[0], v[4]), IDCT_CONST_BITS);
+
+    __m128i tmp10 = _mm_add_epi32(tmp0, tmp3);
+    __m128i tmp13 = _mm_sub_epi32(tmp0, tmp3);
+    __m128i tmp11 = _mm_add_epi32(tmp1, tmp2);
+    __m128i tmp12 = _mm_sub_epi32(tmp1, tmp2);
+
+    // Odd part.
+    __m128i o0 = v[7];
+    __m128i o1 = v[5];
+    __m128i o2 = v[3];
+    __m128i o3 = v[1];
+
+    __m128i z5 = MulSse41(_mm_add_epi32(_mm_add_epi32(o0, o2), _mm_add_epi32(o1, o3)),
+                     FIX_1_175875602);
+    __m128i w1 = MulSse41(_mm_add_epi32(o0, o3), -FIX_0_899976223);
+    __m128i w2 = MulSse41(_mm_add_epi32(o1, o2), -FIX_2_562915447);
+    __m128i w3 = _mm_add_epi32(MulSse41(_mm_add_epi32(o0, o2), -FIX_1_961570560), z5);
+    __m128i w4 = _mm_add_epi32(MulSse41(_mm_add_epi32(o1, o3), -FIX_0_390180644), z5);
+
+    o0 = _mm_add_epi32(MulSse41(o0, FIX_0_298631336), _mm_add_epi32(w1, w3));
+    o1 = _mm_add_epi32(MulSse41(o1, FIX_2_053119869), _mm_add_epi32(w2, w4));
+    o2 = _mm_add_epi32(MulSse41(o2, FIX_3_072711026), _mm_add_epi32(w2, w3));
+    o3 = _mm_add_epi32(MulSse41(o3, FIX_1_501321110), _mm_add_epi32(w1, w4));
+
+    v[0] = DescaleSse41<Shift>(_mm_add_epi32(tmp10, o3));
+    v[7] = DescaleSse41<Shift>(_mm_sub_epi32(tmp10, o3));
+    v[1] = DescaleSse41<Shift>(_mm_add_epi32(tmp11, o2));
+    v[6] = DescaleSse41<Shift>(_mm_sub_epi32(tmp11, o2));
+    v[2] = DescaleSse41<Shift>(_mm_add_epi32(tmp12, o1));
+    v[5] = DescaleSse41<Shift>(_mm_sub_epi32(tmp12, o1));
+    v[3] = DescaleSse41<Shift>(_mm_add_epi32(tmp13, o0));
+    v[4] = DescaleSse41<Shift>(_mm_sub_epi32(tmp13, o0));
+}
+
+TARGET_SSE41 void Transpose4x4Sse41(__m128i& r0, __m128i& r1, __m128i& r2, __m128i& r3)
+{
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+    r0 = _mm_unpacklo_epi64(t0, t1);
+    r1 = _mm_unpackhi_epi64(t0, t1);
+    r2 = _mm_unpacklo_epi64(t2, t3);
+    r3 = _mm_unpackhi_epi64(t2, t3);
+}
+
+// Transposes an 8x8 matrix held as the left halves of its rows followed by the right halves.
+TARGET_SSE41 void Transpose8x8Sse41(__m128i* left, __m128i* right)
+{
+    Transpose4x4Sse41(left[0], left[1], left[2], left[3]);
+    Transpose4x4Sse41(left[4], left[5], left[6], left[7]);
+    Transpose4x4Sse41(right[0], right[1], right[2], right[3]);
+    Transpose4x4Sse41(right[4], right[5], right[6], right[7]);
+
+    for (int i = 0; i < 4; ++i)
+        std::swap(left[4 + i], right[i]);
+}
+
+TARGET_SSE41 __m128i RangeLimitIdctSse41(__m128i value)
+{
+    __m128i index = _mm_and_si128(_mm_add_epi32(value, _mm_set1_epi32(128)),
+                                  _mm_set1_epi32(1023));
+    __m128i inRange = _mm_cmplt_epi32(index, _mm_set1_epi32(640));
+
+    return _mm_and_si128(_mm_min_epi32(index, _mm_set1_epi32(255)), inRange);
+}
+
+TARGET_SSE41 void InverseDctSse41(const int16_t* coefs, const uint16_t* quant, uint8_t* dst,
+                                  size_t dstStride)
+{
+    __m128i left[8];
+    __m128i right[8];
+
+    for (int i = 0; i < 8; ++i)
+    {
+        __m128i coefRow = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefs + 8 * i));
+        __m128i quantRow = _mm_loadu_si128(reinterpret_cast<const __m128i*>(quant + 8 * i));
+
+        left[i] = _mm_mullo_epi32(_mm_cvtepi16_epi32(coefRow), _mm_cvtepu16_epi32(quantRow));
+        right[i] = _mm_mullo_epi32(_mm_cvtepi16_epi32(_mm_srli_si128(coefRow, 8)),
+                                   _mm_cvtepu16_epi32(_mm_srli_si128(quantRow, 8)));
+    }
+
+    IdctButterflySse41<IDCT_PASS1_SHIFT>(left);
+    IdctButterflySse41<IDCT_PASS1_SHIFT>(right);
+
+    Transpose8x8Sse41(left, right);
+
+    IdctButterflySse41<IDCT_PASS2_SHIFT>(left);
+    IdctButterflySse41<IDCT_PASS2_SHIFT>(right);
+
+    Transpose8x8Sse41(left, right);
+
+    for (int i = 0; i < 8; ++i)
+    {
+        __m128i words = _mm_packus_epi32(RangeLimitIdctSse41(left[i]),
+                                         RangeLimitIdctSse41(right[i]));
+
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i * dstStride),
+                         _mm_packus_epi16(words, words));
+    }
+}
+
+// Chroma offsets of 4 pixels from their interleaved, centered Cb and Cr values.
+TARGET_SSE41 void ChromaOffsetsSse41(__m128i cbcr, __m128i& red, __m128i& green, __m128i& blue)
+{
+    const __m128i round = _mm_set1_epi32(32768);
+
+    red = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cbcr, _mm_set1_epi32(CR_TO_R << 16)),
+                                       round), 16);
+    green = _mm_srai_epi32(
+        _mm_add_epi32(_mm_madd_epi16(cbcr, _mm_set1_epi32((CR_TO_G << 16) | (CB_TO_G & 0xFFFF))),
+                      round), 16);
+    blue = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cbcr, _mm_set1_epi32(CB_TO_B & 0xFFFF)),
+                                        round), 16);
+}
+
+TARGET_SSE41 void YCbCrToRgbaSse41(const uint8_t* y, const uint8_t* cb, const uint8_t* cr,
+                                   uint8_t* dst, size_t numPixels)
+{
+    const __m128i center = _mm_set1_epi16(128);
+    const __m128i opaque = _mm_set1_epi8(-1);
+
+    size_t i = 0;
+
+    for (; i + 8 <= numPixels; i += 8)
+    {
+        __m128i luma = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + i)));
+        __m128i blue = _mm_sub_epi16(
+            _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cb + i))), center);
+        __m128i red = _mm_sub_epi16(
+            _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cr + i))), center);
+
+        __m128i rLo, gLo, bLo, rHi, gHi, bHi;
+        ChromaOffsetsSse41(_mm_unpacklo_epi16(blue, red), rLo, gLo, bLo);
+        ChromaOffsetsSse41(_mm_unpackhi_epi16(blue, red), rHi, gHi, bHi);
+
+        __m128i r = _mm_add_epi16(_mm_add_epi16(luma, red), _mm_packs_epi32(rLo, rHi));
+        __m128i g = _mm_add_epi16(_mm_sub_epi16(luma, red), _mm_packs_epi32(gLo, gHi));
+        __m128i b = _mm_add_epi16(_mm_add_epi16(luma, _mm_add_epi16(blue, blue)),
+                                  _mm_packs_epi32(bLo, bHi));
+
+        __m128i rg = _mm_unpacklo_epi8(_mm_packus_epi16(r, r), _mm_packus_epi16(g, g));
+        __m128i ba = _mm_unpacklo_epi8(_mm_packus_epi16(b, b), opaque);
+
+        __m128i* out = reinterpret_cast<__m128i*>(dst + 4 * i);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(rg, ba));
+    }
+
+    YCbCrToRgbaScalar(y + i, cb + i, cr + i, dst + 4 * i, numPixels - i);
+}
+
+TARGET_SSE41 __m128i LoadWideSse41(const uint8_t* src)
+{
+    return _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)));
+}
+
+TARGET_SSE41 void UpsampleH2Sse41(const uint8_t* src, uint8_t* dst, size_t numSamples)
+{
+    const __m128i three = _mm_set1_epi16(3);
+
+    // The vector loop reads one sample on either side, so the edges are left to the scalar code.
+    size_t i = 1;
+
+    for (; i + 9 <= numSamples; i += 8)
+    {
+        __m128i current = _mm_mullo_epi16(LoadWideSse41(src + i), three);
+        __m128i left = LoadWideSse41(src + i - 1);
+        __m128i right = LoadWideSse41(src + i + 1);
+
+        __m128i even = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(current, left),
+                                                    _mm_set1_epi16(1)), 2);
+        __m128i odd = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(current, right),
+                                                   _mm_set1_epi16(2)), 2);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i),
+                         _mm_packus_epi16(_mm_unpacklo_epi16(even, odd),
+                                          _mm_unpackhi_epi16(even, odd)));
+    }
+
+    UpsampleH2Range(src, dst, numSamples, 0, std::min<size_t>(1, numSamples));
+    UpsampleH2Range(src, dst, numSamples, std::max<size_t>(i, 1), numSamples);
+}
+
+TARGET_SSE41 void UpsampleV2Sse41(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst,
+                                  size_t numSamples, bool farRowAbove)
+{
+    const __m128i three = _mm_set1_epi16(3);
+    const __m128i bias = _mm_set1_epi16(farRowAbove ? 1 : 2);
+
+    size_t i = 0;
+
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(LoadWideSse41(nearRow + i), three),
+                                    LoadWideSse41(farRow + i));
+        __m128i value = _mm_srli_epi16(_mm_add_epi16(sum, bias), 2);
+
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(value, value));
+    }
+
+    UpsampleV2Scalar(nearRow + i, farRow + i, dst + i, numSamples - i, farRowAbove);
+}
+
+TARGET_SSE41 __m128i ColumnSumSse41(const uint8_t* nearRow, const uint8_t* farRow)
+{
+    return _mm_add_epi16(_mm_mullo_epi16(LoadWideSse41(nearRow), _mm_set1_epi16(3)),
+                         LoadWideSse41(farRow));
+}
+
+TARGET_SSE41 void UpsampleH2V2Sse41(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst,
+                                    size_t numSamples)
+{
+    size_t i = 1;
+
+    for (; i + 9 <= numSamples; i += 8)
+    {
+        __m128i current = _mm_mullo_epi16(ColumnSumSse41(nearRow + i, farRow + i),
+                                          _mm_set1_epi16(3));
+        __m128i left = ColumnSumSse41(nearRow + i - 1, farRow + i - 1);
+        __m128i right = ColumnSumSse41(nearRow + i + 1, farRow + i + 1);
+
+        __m128i even = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(current, left),
+                                                    _mm_set1_epi16(8)), 4);
+        __m128i odd = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(current, right),
+                                                   _mm_set1_epi16(7)), 4);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i),
+                         _mm_packus_epi16(_mm_unpacklo_epi16(even, odd),
+                                          _mm_unpackhi_epi16(even, odd)));
+    }
+
+    UpsampleH2V2Range(nearRow, farRow, dst, numSamples, 0, std::min<size_t>(1, numSamples));
+    UpsampleH2V2Range(nearRow, farRow, dst, numSamples, std::max<size_t>(i, 1), numSamples);
+}
+
+// Pixels of 3 or 4 bytes, widened to 16 bits. Reads and writes only the bytes of the pixel.
+template<size_t BytesPerPixel>
+TARGET_SSE41 __m128i LoadPixelSse41(const uint8_t* src)
+{
+    int32_t value = 0;
+    std::memcpy(&value, src, BytesPerPixel);
+
+    return _mm_cvtepu8_epi16(_mm_cvtsi32_si128(value));
+}
+
+template<size_t BytesPerPixel>
+TARGET_SSE41 void StorePixelSse41(uint8_t* dst, __m128i pixel)
+{
+    int32_t value = _mm_cvtsi128_si32(_mm_packus_epi16(pixel, pixel));
+    std::memcpy(dst, &value, BytesPerPixel);
+}
+
+// The Sub, Average and Paeth filters depend on the pixel to the left, so they are vectorized
+// across the channels of one pixel, which only pays off for 3 and 4 byte pixels. Arithmetic is
+// done in 16 bits and wrapped to 8 when stored.
+template<size_t BytesPerPixel>
+TARGET_SSE41 void UnfilterPixelsSse41(uint32_t filter, uint8_t* row, const uint8_t* prevRow,
+                                      size_t rowSize)
+{
+    const __m128i byteMask = _mm_set1_epi16(0xFF);
+
+    __m128i a = _mm_setzero_si128();
+    __m128i c = _mm_setzero_si128();
+
+    for (size_t i = 0; i + BytesPerPixel <= rowSize; i += BytesPerPixel)
+    {
+        __m128i x = LoadPixelSse41<BytesPerPixel>(row + i);
+        __m128i b = LoadPixelSse41<BytesPerPixel>(prevRow + i);
+
+        if (filter == 1)
+        {
+            x = _mm_add_epi16(x, a);
+        }
+        else if (filter == 3)
+        {
+            x = _mm_add_epi16(x, _mm_srli_epi16(_mm_add_epi16(a, b), 1));
+        }
+        else
+        {
+            __m128i pa = _mm_abs_epi16(_mm_sub_epi16(b, c));
+            __m128i pb = _mm_abs_epi16(_mm_sub_epi16(a, c));
+            __m128i pc = _mm_abs_epi16(_mm_add_epi16(_mm_sub_epi16(b, c), _mm_sub_epi16(a, c)));
+            __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+            __m128i predictor = _mm_blendv_epi8(c, b, _mm_cmpeq_epi16(pb, smallest));
+            predictor = _mm_blendv_epi8(predictor, a, _mm_cmpeq_epi16(pa, smallest));
+
+            x = _mm_add_epi16(x, predictor);
+            c = b;
+        }
+
+        a = _mm_and_si128(x, byteMask);
+        StorePixelSse41<BytesPerPixel>(row + i, a);
+    }
+}
+
+TARGET_SSE41 void UnfilterPngRowSse41(uint32_t filter, uint8_t* row, const uint8_t* prevRow,
+                                      size_t rowSize, size_t bytesPerPixel)
+{
+    if (filter == 2)
+    {
+        size_t i = 0;
+
+        for (; i + 16 <= rowSize; i += 16)
+        {
+            __m128i* rowPtr = reinterpret_cast<__m128i*>(row + i);
+            __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prevRow + i));
+
+            _mm_storeu_si128(rowPtr, _mm_add_epi8(_mm_loadu_si128(rowPtr), prev));
+        }
+
+        UnfilterPngRange(filter, row, prevRow, rowSize, bytesPerPixel, i);
+    }
+    else if (filter != 0 && bytesPerPixel == 3)
+    {
+        UnfilterPixelsSse41<3>(filter, row, prevRow, rowSize);
+    }
+    else if (filter != 0 && bytesPerPixel == 4)
+    {
+        UnfilterPixelsSse41<4>(filter, row, prevRow, rowSize);
+    }
+    else
+    {
+        UnfilterPngRowScalar(filter, row, prevRow, rowSize, bytesPerPixel);
+    }
+}
+
+TARGET_AVX2 __m256i MulAvx2(__m256i a, int32_t c)
+{
+    return _mm256_mullo_epi32(a, _mm256_set1_epi32(c));
+}
+
+// Arithmetic right shift with rounding.
+template<int Shift>
+TARGET_AVX2 __m256i DescaleAvx2(__m256i a)
+{
+    return _mm256_srai_epi32(_mm256_add_epi32(a, _mm256_set1_epi32(1 << (Shift - 1))), Shift);
+}
+
+// IDCT pass over 8 rows of 8 columns.
+template<int Shift>
+TARGET_AVX2 void IdctButterflyAvx2(__m256i* v)
+{
+    // Even part.
+    __m256i z1 = MulAvx2(_mm256_add_epi32(v[2], v[6]), FIX_0_541196100);
+    __m256i tmp2 = _mm256_add_epi32(z1, MulAvx2(v[6], -FIX_1_847759065));
+    __m256i tmp3 = _mm256_add_epi32(z1, MulAvx2(v[2], FIX_0_765366865));
+    __m256i tmp0 = _mm256_slli_epi32(_mm256_add_epi32(v[0], v[4]), IDCT_CONST_BITS);
+    __m256i tmp1 = _mm256_slli_epi32(_mm256_sub_epi32(v[0], v[4]), IDCT_CONST_BITS);
+
+    __m256i tmp10 = _mm256_add_epi32(tmp0, tmp3);
+    __m256i tmp13 = _mm256_sub_epi32(tmp0, tmp3);
+    __m256i tmp11 = _mm256_add_epi32(tmp1, tmp2);
+    __m256i tmp12 = _mm256_sub_epi32(tmp1, tmp2);
+
+    // Odd part.
+    __m256i o0 = v[7];
+    __m256i o1 = v[5];
+    __m256i o2 = v[3];
+    __m256i o3 = v[1];
+
+    __m256i z5 = MulAvx2(_mm256_add_epi32(_mm256_add_epi32(o0, o2), _mm256_add_epi32(o1, o3)),
+                     FIX_1_175875602);
+    __m256i w1 = MulAvx2(_mm256_add_epi32(o0, o3), -FIX_0_899976223);
+    __m256i w2 = MulAvx2(_mm256_add_epi32(o1, o2), -FIX_2_562915447);
+    __m256i w3 = _mm256_add_epi32(MulAvx2(_mm256_add_epi32(o0, o2), -FIX_1_961570560), z5);
+    __m256i w4 = _mm256_add_epi32(MulAvx2(_mm256_add_epi32(o1, o3), -FIX_0_390180644), z5);
+
+    o0 = _mm256_add_epi32(MulAvx2(o0, FIX_0_298631336), _mm256_add_epi32(w1, w3));
+    o1 = _mm256_add_epi32(MulAvx2(o1, FIX_2_053119869), _mm256_add_epi32(w2, w4));
+    o2 = _mm256_add_epi32(MulAvx2(o2, FIX_3_072711026), _mm256_add_epi32(w2, w3));
+    o3 = _mm256_add_epi32(MulAvx2(o3, FIX_1_501321110), _mm256_add_epi32(w1, w4));
+
+    v[0] = DescaleAvx2<Shift>(_mm256_add_epi32(tmp10, o3));
+    v[7] = DescaleAvx2<Shift>(_mm256_sub_epi32(tmp10, o3));
+    v[1] = DescaleAvx2<Shift>(_mm256_add_epi32(tmp11, o2));
+    v[6] = DescaleAvx2<Shift>(_mm256_sub_epi32(tmp11, o2));
+    v[2] = DescaleAvx2<Shift>(_mm256_add_epi32(tmp12, o1));
+    v[5] = DescaleAvx2<Shift>(_mm256_sub_epi32(tmp12, o1));
+    v[3] = DescaleAvx2<Shift>(_mm256_add_epi32(tmp13, o0));
+    v[4] = DescaleAvx2<Shift>(_mm256_sub_epi32(tmp13, o0));
+}
+
+TARGET_AVX2 void Transpose8x8Avx2(__m256i* v)
+{
+    __m256i t0 = _mm256_unpacklo_epi32(v[0], v[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(v[0], v[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(v[2], v[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(v[2], v[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(v[4], v[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(v[4], v[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(v[6], v[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(v[6], v[7]);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    v[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    v[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    v[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    v[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    v[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    v[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    v[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    v[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+TARGET_AVX2 __m256i RangeLimitIdctAvx2(__m256i value)
+{
+    __m256i index = _mm256_and_si256(_mm256_add_epi32(value, _mm256_set1_epi32(128)),
+                                     _mm256_set1_epi32(1023));
+    __m256i inRange = _mm256_cmpgt_epi32(_mm256_set1_epi32(640), index);
+
+    return _mm256_and_si256(_mm256_min_epi32(index, _mm256_set1_epi32(255)), inRange);
+}
+
+TARGET_AVX2 void InverseDctAvx2(const int16_t* coefs, const uint16_t* quant, uint8_t* dst,
+                                size_t dstStride)
+{
+    __m256i v[8];
+
+    for (int i = 0; i < 8; ++i)
+    {
+        __m128i coefRow = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefs + 8 * i));
+        __m128i quantRow = _mm_loadu_si128(reinterpret_cast<const __m128i*>(quant + 8 * i));
+
+        v[i] = _mm256_mullo_epi32(_mm256_cvtepi16_epi32(coefRow),
+                                  _mm256_cvtepu16_epi32(quantRow));
+    }
+
+    IdctButterflyAvx2<IDCT_PASS1_SHIFT>(v);
+    Transpose8x8Avx2(v);
+    IdctButterflyAvx2<IDCT_PASS2_SHIFT>(v);
+    Transpose8x8Avx2(v);
+
+    // Packing works within 128-bit lanes, which leaves the left and right halves of rows 0 to 3
+    // interleaved as 32-bit groups.
+    const __m256i rowOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    for (int i = 0; i < 8; i += 4)
+    {
+        __m256i words01 = _mm256_packus_epi32(RangeLimitIdctAvx2(v[i + 0]),
+                                              RangeLimitIdctAvx2(v[i + 1]));
+        __m256i words23 = _mm256_packus_epi32(RangeLimitIdctAvx2(v[i + 2]),
+                                              RangeLimitIdctAvx2(v[i + 3]));
+        __m256i rows = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(words01, words23),
+                                                   rowOrder);
+
+        __m128i rows01 = _mm256_castsi256_si128(rows);
+        __m128i rows23 = _mm256_extracti128_si256(rows, 1);
+
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + (i + 0) * dstStride), rows01);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + (i + 1) * dstStride),
+                         _mm_unpackhi_epi64(rows01, rows01));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + (i + 2) * dstStride), rows23);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + (i + 3) * dstStride),
+                         _mm_unpackhi_epi64(rows23, rows23));
+    }
+}
+
+TARGET_AVX2 void ChromaOffsetsAvx2(__m256i cbcr, __m256i& red, __m256i& green, __m256i& blue)
+{
+    const __m256i round = _mm256_set1_epi32(32768);
+
+    red = _mm256_srai_epi32(
+        _mm256_add_epi32(_mm256_madd_epi16(cbcr, _mm256_set1_epi32(CR_TO_R << 16)), round), 16);
+    green = _mm256_srai_epi32(
+        _mm256_add_epi32(
+            _mm256_madd_epi16(cbcr, _mm256_set1_epi32((CR_TO_G << 16) | (CB_TO_G & 0xFFFF))),
+            round),
+        16);
+    blue = _mm256_srai_epi32(
+        _mm256_add_epi32(_mm256_madd_epi16(cbcr, _mm256_set1_epi32(CB_TO_B & 0xFFFF)), round),
+        16);
+}
+
+TARGET_AVX2 __m256i LoadWideAvx2(const uint8_t* src)
+{
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+}
+
+TARGET_AVX2 void YCbCrToRgbaAvx2(const uint8_t* y, const uint8_t* cb, const uint8_t* cr,
+                                 uint8_t* dst, size_t numPixels)
+{
+    const __m256i center = _mm256_set1_epi16(128);
+    const __m256i opaque = _mm256_set1_epi16(255);
+
+    // Interleaves the two 8-byte halves of each lane.
+    const __m256i interleave = _mm256_setr_epi8(0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7,
+                                                15, 0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14,
+                                                7, 15);
+
+    size_t i = 0;
+
+    for (; i + 16 <= numPixels; i += 16)
+    {
+        __m256i luma = LoadWideAvx2(y + i);
+        __m256i blue = _mm256_sub_epi16(LoadWideAvx2(cb + i), center);
+        __m256i red = _mm256_sub_epi16(LoadWideAvx2(cr + i), center);
+
+        // The unpacks and packs both work within lanes, so the pixels end up in order.
+        __m256i rLo, gLo, bLo, rHi, gHi, bHi;
+        ChromaOffsetsAvx2(_mm256_unpacklo_epi16(blue, red), rLo, gLo, bLo);
+        ChromaOffsetsAvx2(_mm256_unpackhi_epi16(blue, red), rHi, gHi, bHi);
+
+        __m256i r = _mm256_add_epi16(_mm256_add_epi16(luma, red), _mm256_packs_epi32(rLo, rHi));
+        __m256i g = _mm256_add_epi16(_mm256_sub_epi16(luma, red), _mm256_packs_epi32(gLo, gHi));
+        __m256i b = _mm256_add_epi16(_mm256_add_epi16(luma, _mm256_add_epi16(blue, blue)),
+                                     _mm256_packs_epi32(bLo, bHi));
+
+        __m256i rg = _mm256_shuffle_epi8(_mm256_packus_epi16(r, g), interleave);
+        __m256i ba = _mm256_shuffle_epi8(_mm256_packus_epi16(b, opaque), interleave);
+
+        __m256i pixelsLo = _mm256_unpacklo_epi16(rg, ba);
+        __m256i pixelsHi = _mm256_unpackhi_epi16(rg, ba);
+
+        __m256i* out = reinterpret_cast<__m256i*>(dst + 4 * i);
+        _mm256_storeu_si256(out + 0, _mm256_permute2x128_si256(pixelsLo, pixelsHi, 0x20));
+        _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(pixelsLo, pixelsHi, 0x31));
+    }
+
+    YCbCrToRgbaSse41(y + i, cb + i, cr + i, dst + 4 * i, numPixels - i);
+}
+
+TARGET_AVX2 void UpsampleH2Avx2(const uint8_t* src, uint8_t* dst, size_t numSamples)
+{
+    const __m256i three = _mm256_set1_epi16(3);
+
+    size_t i = 1;
+
+    for (; i + 17 <= numSamples; i += 16)
+    {
+        __m256i current = _mm256_mullo_epi16(LoadWideAvx2(src + i), three);
+        __m256i left = LoadWideAvx2(src + i - 1);
+        __m256i right = LoadWideAvx2(src + i + 1);
+
+        __m256i even = _mm256_srli_epi16(
+            _mm256_add_epi16(_mm256_add_epi16(current, left), _mm256_set1_epi16(1)), 2);
+        __m256i odd = _mm256_srli_epi16(
+            _mm256_add_epi16(_mm256_add_epi16(current, right), _mm256_set1_epi16(2)), 2);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i),
+                            _mm256_packus_epi16(_mm256_unpacklo_epi16(even, odd),
+                                                _mm256_unpackhi_epi16(even, odd)));
+    }
+
+    UpsampleH2Range(src, dst, numSamples, 0, std::min<size_t>(1, numSamples));
+    UpsampleH2Range(src, dst, numSamples, std::max<size_t>(i, 1), numSamples);
+}
+
+TARGET_AVX2 void UpsampleV2Avx2(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst,
+                                size_t numSamples, bool farRowAbove)
+{
+    const __m256i three = _mm256_set1_epi16(3);
+    const __m256i bias = _mm256_set1_epi16(farRowAbove ? 1 : 2);
+
+    size_t i = 0;
+
+    for (; i + 16 <= numSamples; i += 16)
+    {
+        __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(LoadWideAvx2(nearRow + i), three),
+                                       LoadWideAvx2(farRow + i));
+        __m256i value = _mm256_srli_epi16(_mm256_add_epi16(sum, bias), 2);
+        __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(value, value), 0x08);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_castsi256_si128(bytes));
+    }
+
+    UpsampleV2Sse41(nearRow + i, farRow + i, dst + i, numSamples - i, farRowAbove);
+}
+
+TARGET_AVX2 __m256i ColumnSumAvx2(const uint8_t* nearRow, const uint8_t* farRow)
+{
+    return _mm256_add_epi16(_mm256_mullo_epi16(LoadWideAvx2(nearRow), _mm256_set1_epi16(3)),
+                            LoadWideAvx2(farRow));
+}
+
+TARGET_AVX2 void UpsampleH2V2Avx2(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst,
+                                  size_t numSamples)
+{
+    size_t i = 1;
+
+    for (; i + 17 <= numSamples; i += 16)
+    {
+        __m256i current = _mm256_mullo_epi16(ColumnSumAvx2(nearRow + i, farRow + i),
+                                             _mm256_set1_epi16(3));
+        __m256i left = ColumnSumAvx2(nearRow + i - 1, farRow + i - 1);
+        __m256i right = ColumnSumAvx2(nearRow + i + 1, farRow + i + 1);
+
+        __m256i even = _mm256_srli_epi16(
+            _mm256_add_epi16(_mm256_add_epi16(current, left), _mm256_set1_epi16(8)), 4);
+        __m256i odd = _mm256_srli_epi16(
+            _mm256_add_epi16(_mm256_add_epi16(current, right), _mm256_set1_epi16(7)), 4);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i),
+                            _mm256_packus_epi16(_mm256_unpacklo_epi16(even, odd),
+                                                _mm256_unpackhi_epi16(even, odd)));
+    }
+
+    UpsampleH2V2Range(nearRow, farRow, dst, numSamples, 0, std::min<size_t>(1, numSamples));
+    UpsampleH2V2Range(nearRow, farRow, dst, numSamples, std::max<size_t>(i, 1), numSamples);
+}
+
+TARGET_AVX2 void UnfilterPngRowAvx2(uint32_t filter, uint8_t* row, const uint8_t* prevRow,
+                                    size_t rowSize, size_t bytesPerPixel)
+{
+    if (filter != 2)
+    {
+        UnfilterPngRowSse41(filter, row, prevRow, rowSize, bytesPerPixel);
+        return;
+    }
+
+    size_t i = 0;
+
+    for (; i + 32 <= rowSize; i += 32)
+    {
+        __m256i* rowPtr = reinterpret_cast<__m256i*>(row + i);
+        __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prevRow + i));
+
+        _mm256_storeu_si256(rowPtr, _mm256_add_epi8(_mm256_loadu_si256(rowPtr), prev));
+    }
+
+    UnfilterPngRange(filter, row, prevRow, rowSize, bytesPerPixel, i);
+}
+
+#elif defined(GRFX_SIMD_NEON)
+
+struct NeonLanes
+{
+    using Type = int32x4_t;
+
+    static Type Add(Type a, Type b) { return vaddq_s32(a, b); }
+    static Type Sub(Type a, Type b) { return vsubq_s32(a, b); }
+    static Type Mul(Type a, int32_t c) { return vmulq_n_s32(a, c); }
+    static Type Shl(Type a, int bits) { return vshlq_s32(a, vdupq_n_s32(bits)); }
+
+    // A negative count shifts right, arithmetically for signed lanes.
+    static Type Descale(Type a, int bits)
+    {
+        return vshlq_s32(vaddq_s32(a, vdupq_n_s32(1 << (bits - 1))), vdupq_n_s32(-bits));
+    }
+};
+
+void GrayToRgbaNeon(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= numPixels; i += 16)
+    {
+        uint8x16_t gray = vld1q_u8(src + i);
+
+        uint8x16x4_t pixels;
+        pixels.val[0] = gray;
+        pixels.val[1] = gray;
+        pixels.val[2] = gray;
+        pixels.val[3] = vdupq_n_u8(255);
+
+        vst4q_u8(dst + 4 * i, pixels);
+    }
+
+    GrayToRgbaScalar(src + i, dst + 4 * i, numPixels - i);
+}
+
+void Transpose4x4Neon(int32x4_t& r0, int32x4_t& r1, int32x4_t& r2, int32x4_t& r3)
+{
+    int32x4x2_t t01 = vtrnq_s32(r0, r1);
+    int32x4x2_t t23 = vtrnq_s32(r2, r3);
+
+    r0 = vcombine_s32(vget_low_s32(t01.val[0]), vget_low_s32(t23.val[0]));
+    r1 = vcombine_s32(vget_low_s32(t01.val[1]), vget_low_s32(t23.val[1]));
+    r2 = vcombine_s32(vget_high_s32(t01.val[0]), vget_high_s32(t23.val[0]));
+    r3 = vcombine_s32(vget_high_s32(t01.val[1]), vget_high_s32(t23.val[1]));
+}
+
+// Transposes an 8x8 matrix held as the left halves of its rows followed by the right halves.
+void Transpose8x8Neon(int32x4_t* left, int32x4_t* right)
+{
+    Transpose4x4Neon(left[0], left[1], left[2], left[3]);
+    Transpose4x4Neon(left[4], left[5], left[6], left[7]);
+    Transpose4x4Neon(right[0], right[1], right[2], right[3]);
+    Transpose4x4Neon(right[4], right[5], right[6], right[7]);
+
+    for (int i = 0; i < 4; ++i)
+        std::swap(left[4 + i], right[i]);
+}
+
+uint16x4_t RangeLimitIdctNeon(int32x4_t value)
+{
+    int32x4_t index = vandq_s32(vaddq_s32(value, vdupq_n_s32(128)), vdupq_n_s32(1023));
+    uint32x4_t inRange = vcltq_s32(index, vdupq_n_s32(640));
+    uint32x4_t limited = vandq_u32(vreinterpretq_u32_s32(vminq_s32(index, vdupq_n_s32(255))),
+                                   inRange);
+
+    return vmovn_u32(limited);
+}
+
+void InverseDctNeon(const int16_t* coefs, const uint16_t* quant, uint8_t* dst, size_t dstStride)
+{
+    int32x4_t left[8];
+    int32x4_t right[8];
+
+    for (int i = 0; i < 8; ++i)
+    {
+        int16x8_t coefRow = vld1q_s16(coefs + 8 * i);
+        int32x4_t quantLo = vreinterpretq_s32_u32(vmovl_u16(vld1_u16(quant + 8 * i)));
+        int32x4_t quantHi = vreinterpretq_s32_u32(vmovl_u16(vld1_u16(quant + 8 * i + 4)));
+
+        left[i] = vmulq_s32(vmovl_s16(vget_low_s16(coefRow)), quantLo);
+        right[i] = vmulq_s32(vmovl_s16(vget_high_s16(coefRow)), quantHi);
+    }
+
+    IdctButterfly<NeonLanes>(left, IDCT_PASS1_SHIFT);
+    IdctButterfly<NeonLanes>(right, IDCT_PASS1_SHIFT);
+
+    Transpose8x8Neon(left, right);
+
+    IdctButterfly<NeonLanes>(left, IDCT_PASS2_SHIFT);
+    IdctButterfly<NeonLanes>(right, IDCT_PASS2_SHIFT);
+
+    Transpose8x8Neon(left, right);
+
+    for (int i = 0; i < 8; ++i)
+    {
+        uint16x8_t words = vcombine_u16(RangeLimitIdctNeon(left[i]),
+                                        RangeLimitIdctNeon(right[i]));
+
+        vst1_u8(dst + i * dstStride, vmovn_u16(words));
+    }
+}
+
+// Adds the chroma offset (value * factor + 2^15) >> 16 to 4 luma values.
+int32x4_t AddChromaNeon(int32x4_t luma, int32x4_t value, int32_t factor)
+{
+    int32x4_t product = vmlaq_n_s32(vdupq_n_s32(32768), value, factor);
+
+    return vaddq_s32(luma, vshrq_n_s32(product, 16));
+}
+
+void YCbCrToRgbaNeon(const uint8_t* y, const uint8_t* cb, const uint8_t* cr, uint8_t* dst,
+                     size_t numPixels)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= numPixels; i += 8)
+    {
+        int16x8_t luma = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(y + i)));
+        int16x8_t blue = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(cb + i))),
+                                   vdupq_n_s16(128));
+        int16x8_t red = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(cr + i))),
+                                  vdupq_n_s16(128));
+
+        // Red, green and blue of the low and high 4 pixels.
+        int16x4_t channels[2][3];
+
+        for (int half = 0; half < 2; ++half)
+        {
+            int32x4_t l = vmovl_s16(half ? vget_high_s16(luma) : vget_low_s16(luma));
+            int32x4_t b = vmovl_s16(half ? vget_high_s16(blue) : vget_low_s16(blue));
+            int32x4_t r = vmovl_s16(half ? vget_high_s16(red) : vget_low_s16(red));
+
+            int32x4_t greenOffset = vmlaq_n_s32(vmulq_n_s32(b, CB_TO_G), r, CR_TO_G);
+            int32x4_t green = vaddq_s32(vsubq_s32(l, r),
+                                        vshrq_n_s32(vaddq_s32(greenOffset, vdupq_n_s32(32768)),
+                                                    16));
+
+            channels[half][0] = vmovn_s32(AddChromaNeon(vaddq_s32(l, r), r, CR_TO_R));
+            channels[half][1] = vmovn_s32(green);
+            channels[half][2] = vmovn_s32(AddChromaNeon(vaddq_s32(l, vaddq_s32(b, b)), b,
+                                                        CB_TO_B));
+        }
+
+        uint8x8x4_t pixels;
+        pixels.val[0] = vqmovun_s16(vcombine_s16(channels[0][0], channels[1][0]));
+        pixels.val[1] = vqmovun_s16(vcombine_s16(channels[0][1], channels[1][1]));
+        pixels.val[2] = vqmovun_s16(vcombine_s16(channels[0][2], channels[1][2]));
+        pixels.val[3] = vdup_n_u8(255);
+
+        vst4_u8(dst + 4 * i, pixels);
+    }
+
+    YCbCrToRgbaScalar(y + i, cb + i, cr + i, dst + 4 * i, numPixels - i);
+}
+
+void UpsampleV2Neon(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst,
+                    size_t numSamples, bool farRowAbove)
+{
+    const uint16x8_t bias = vdupq_n_u16(farRowAbove ? 1 : 2);
+
+    size_t i = 0;
+
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        uint16x8_t sum = vmlal_u8(vmovl_u8(vld1_u8(farRow + i)), vld1_u8(nearRow + i),
+                                  vdup_n_u8(3));
+
+        vst1_u8(dst + i, vshrn_n_u16(vaddq_u16(sum, bias), 2));
+    }
+
+    UpsampleV2Scalar(nearRow + i, farRow + i, dst + i, numSamples - i, farRowAbove);
+}
+
+void UnfilterPngRowNeon(uint32_t filter, uint8_t* row, const uint8_t* prevRow, size_t rowSize,
+                        size_t bytesPerPixel)
+{
+    size_t i = 0;
+
+    if (filter == 2)
+    {
+        for (; i + 16 <= rowSize; i += 16)
+            vst1q_u8(row + i, vaddq_u8(vld1q_u8(row + i), vld1q_u8(prevRow + i)));
+    }
+
+    UnfilterPngRange(filter, row, prevRow, rowSize, bytesPerPixel, i);
+}
+
+#endif
+
+} // namespace
+
+uint8_t InverseDctDcOnly(int16_t dc, uint16_t quant)
+{
+    // With only v[0] set, both butterfly passes reduce to scaling it up and descaling it again.
+    using L = ScalarLanes;
+
+    uint32_t value = static_cast<uint32_t>(dc * quant);
+    value = L::Descale(L::Shl(value, IDCT_CONST_BITS), IDCT_PASS1_SHIFT);
+    value = L::Descale(L::Shl(value, IDCT_CONST_BITS), IDCT_PASS2_SHIFT);
+
+    return RangeLimitIdct(static_cast<int32_t>(value));
+}
+
+void AddDecoderKernels(PixelKernels* kernels)
+{
+    kernels->GrayToRgba = GrayToRgbaScalar;
+    kernels->InverseDct = InverseDctScalar;
+    kernels->YCbCrToRgba = YCbCrToRgbaScalar;
+    kernels->UpsampleH2 = UpsampleH2Scalar;
+    kernels->UpsampleV2 = UpsampleV2Scalar;
+    kernels->UpsampleH2V2 = UpsampleH2V2Scalar;
+    kernels->UnfilterPngRow = UnfilterPngRowScalar;
+
+    switch (kernels->Level)
+    {
+#if defined(GRFX_SIMD_X86)
+        case SimdLevel::Sse41:
+            kernels->GrayToRgba = GrayToRgbaSse41;
+            kernels->InverseDct = InverseDctSse41;
+            kernels->YCbCrToRgba = YCbCrToRgbaSse41;
+            kernels->UpsampleH2 = UpsampleH2Sse41;
+            kernels->UpsampleV2 = UpsampleV2Sse41;
+            kernels->UpsampleH2V2 = UpsampleH2V2Sse41;
+            kernels->UnfilterPngRow = UnfilterPngRowSse41;
+            break;
+        case SimdLevel::Avx2:
+            // Gray rows are rare enough that the SSE4.1 version does.
+            kernels->GrayToRgba = GrayToRgbaSse41;
+            kernels->InverseDct = InverseDctAvx2;
+            kernels->YCbCrToRgba = YCbCrToRgbaAvx2;
+            kernels->UpsampleH2 = UpsampleH2Avx2;
+            kernels->UpsampleV2 = UpsampleV2Avx2;
+            kernels->UpsampleH2V2 = UpsampleH2V2Avx2;
+            kernels->UnfilterPngRow = UnfilterPngRowAvx2;
+            break;
+#elif defined(GRFX_SIMD_NEON)
+        case SimdLevel::Neon:
+            // Horizontal upsampling and the filters that depend on the pixel to the left keep
+            // the scalar versions.
+            kernels->GrayToRgba = GrayToRgbaNeon;
+            kernels->InverseDct = InverseDctNeon;
+            kernels->YCbCrToRgba = YCbCrToRgbaNeon;
+            kernels->UpsampleV2 = UpsampleV2Neon;
+            kernels->UnfilterPngRow = UnfilterPngRowNeon;
+            break;
+#endif
+        default:
+            break;
+    }
+}
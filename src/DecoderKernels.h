@@ -0,0 +1,11 @@
+#pragma once
+
+#include "PixelKernels.h"
+
+// Sets the decoder entries of |kernels| to the versions for kernels->Level. The image kernels
+// live in PixelKernels.cpp and the decoder ones in DecoderKernels.cpp.
+void AddDecoderKernels(PixelKernels* kernels);
+
+// The sample value of every pixel of a block whose AC coefficients are all zero. Equal to what
+// InverseDct computes for it, but much cheaper.
+uint8_t InverseDctDcOnly(int16_t dc, uint16_t quant);
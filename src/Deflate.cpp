@@ -0,0 +1,221 @@
+#include "Deflate.h"
+
+#include "Inflate.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+constexpr uint32_t WINDOW_SIZE = 32768;
+constexpr uint32_t MIN_MATCH = 3;
+constexpr uint32_t MAX_MATCH = 258;
+
+constexpr uint32_t HASH_BITS = 15;
+
+// Candidates tried per position. More finds longer matches at the cost of speed.
+constexpr uint32_t MAX_CHAIN_LENGTH = 32;
+
+constexpr uint32_t END_OF_BLOCK = 256;
+
+constexpr uint16_t LENGTH_BASE[] = {3,  4,  5,  6,  7,  8,  9,  10,  11,  13,
+                                    15, 17, 19, 23, 27, 31, 35, 43,  51,  59,
+                                    67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t LENGTH_EXTRA[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                    2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t DIST_BASE[] = {1,    2,    3,    4,    5,    7,     9,    13,
+                                  17,   25,   33,   49,   65,   97,    129,  193,
+                                  257,  385,  513,  769,  1025, 1537,  2049, 3073,
+                                  4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t DIST_EXTRA[] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                  6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Writes bits least significant first, as deflate packs them.
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<std::byte>* dst) : m_dst(dst) {}
+
+    void Write(uint32_t bits, uint32_t numBits)
+    {
+        m_bits |= static_cast<uint64_t>(bits) << m_numBits;
+        m_numBits += numBits;
+
+        while (m_numBits >= 8)
+        {
+            m_dst->push_back(static_cast<std::byte>(m_bits & 0xFF));
+            m_bits >>= 8;
+            m_numBits -= 8;
+        }
+    }
+
+    // Huffman codes are packed most significant bit first.
+    void WriteCode(uint32_t code, uint32_t numBits)
+    {
+        uint32_t reversed = 0;
+
+        for (uint32_t i = 0; i < numBits; ++i)
+            reversed |= ((code >> i) & 1) << (numBits - 1 - i);
+
+        Write(reversed, numBits);
+    }
+
+    void Flush()
+    {
+        if (m_numBits > 0)
+            m_dst->push_back(static_cast<std::byte>(m_bits & 0xFF));
+
+        m_bits = 0;
+        m_numBits = 0;
+    }
+
+private:
+    std::vector<std::byte>* m_dst;
+
+    uint64_t m_bits = 0;
+    uint32_t m_numBits = 0;
+};
+
+// The fixed literal/length code of RFC 1951 section 3.2.6.
+void WriteLitlen(BitWriter* writer, uint32_t symbol)
+{
+    if (symbol < 144)
+        writer->WriteCode(0x30 + symbol, 8);
+    else if (symbol < 256)
+        writer->WriteCode(0x190 + symbol - 144, 9);
+    else if (symbol < 280)
+        writer->WriteCode(symbol - 256, 7);
+    else
+        writer->WriteCode(0xC0 + symbol - 280, 8);
+}
+
+void WriteMatch(BitWriter* writer, uint32_t length, uint32_t distance)
+{
+    uint32_t lengthCode = static_cast<uint32_t>(
+        std::upper_bound(std::begin(LENGTH_BASE), std::end(LENGTH_BASE), length) -
+        std::begin(LENGTH_BASE) - 1);
+
+    WriteLitlen(writer, 257 + lengthCode);
+    writer->Write(length - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode]);
+
+    uint32_t distCode = static_cast<uint32_t>(
+        std::upper_bound(std::begin(DIST_BASE), std::end(DIST_BASE), distance) -
+        std::begin(DIST_BASE) - 1);
+
+    writer->WriteCode(distCode, 5);
+    writer->Write(distance - DIST_BASE[distCode], DIST_EXTRA[distCode]);
+}
+
+uint32_t Hash3(const uint8_t* bytes)
+{
+    uint32_t value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16);
+
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+} // namespace
+
+std::vector<std::byte> DeflateZlib(std::span<const uint8_t> src)
+{
+    std::vector<std::byte> dst;
+    dst.reserve(src.size() / 2 + 64);
+
+    // Deflate with a 32K window and no dictionary, at the default level.
+    dst.push_back(std::byte{0x78});
+    dst.push_back(std::byte{0x9C});
+
+    BitWriter writer(&dst);
+
+    // One final block with the fixed codes.
+    writer.Write(1, 1);
+    writer.Write(1, 2);
+
+    // Most recent position of each hash, and the previous position with the same hash of each
+    // position in the window. Positions are offset by one so that zero means none.
+    std::vector<uint32_t> head(size_t{1} << HASH_BITS, 0);
+    std::vector<uint32_t> prev(WINDOW_SIZE, 0);
+
+    const uint8_t* bytes = src.data();
+    auto size = static_cast<uint32_t>(src.size());
+
+    auto insert = [&](uint32_t pos) {
+        uint32_t hash = Hash3(bytes + pos);
+        prev[pos % WINDOW_SIZE] = head[hash];
+        head[hash] = pos + 1;
+    };
+
+    uint32_t pos = 0;
+
+    while (pos < size)
+    {
+        uint32_t bestLength = 0;
+        uint32_t bestDistance = 0;
+
+        if (size - pos >= MIN_MATCH)
+        {
+            uint32_t maxLength = std::min(MAX_MATCH, size - pos);
+            uint32_t candidate = head[Hash3(bytes + pos)];
+
+            for (uint32_t chain = 0; chain < MAX_CHAIN_LENGTH && candidate != 0; ++chain)
+            {
+                uint32_t matchPos = candidate - 1;
+
+                if (pos - matchPos > WINDOW_SIZE)
+                    break;
+
+                uint32_t length = 0;
+
+                while (length < maxLength && bytes[matchPos + length] == bytes[pos + length])
+                    ++length;
+
+                if (length > bestLength)
+                {
+                    bestLength = length;
+                    bestDistance = pos - matchPos;
+
+                    if (length == maxLength)
+                        break;
+                }
+
+                uint32_t next = prev[matchPos % WINDOW_SIZE];
+
+                // Entries older than the window have been overwritten by newer positions.
+                if (next >= candidate)
+                    break;
+
+                candidate = next;
+            }
+        }
+
+        if (bestLength >= MIN_MATCH)
+        {
+            WriteMatch(&writer, bestLength, bestDistance);
+
+            for (uint32_t matchEnd = pos + bestLength; pos < matchEnd; ++pos)
+            {
+                if (size - pos >= MIN_MATCH)
+                    insert(pos);
+            }
+        }
+        else
+        {
+            WriteLitlen(&writer, bytes[pos]);
+
+            if (size - pos >= MIN_MATCH)
+                insert(pos);
+
+            ++pos;
+        }
+    }
+
+    WriteLitlen(&writer, END_OF_BLOCK);
+    writer.Flush();
+
+    uint32_t checksum = Adler32(src);
+
+    for (int shift = 24; shift >= 0; shift -= 8)
+        dst.push_back(static_cast<std::byte>((checksum >> shift) & 0xFF));
+
+    return dst;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Compresses |src| into a zlib stream (RFC 1950) that InflateZlib() reads back. Uses greedy LZ77
+// matching and the fixed Huffman codes of a single deflate block - well short of zlib's ratio,
+// but simple and fast enough for writing images.
+std::vector<std::byte> DeflateZlib(std::span<const uint8_t> src);
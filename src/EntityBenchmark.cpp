@@ -0,0 +1,547 @@
+// Benchmark for the entity store. Creates a million entities spread over a few archetypes, then
+// every frame updates them with serial and parallel queries, reads them with a narrower query,
+// and makes structural changes under load: adding and removing a component, and destroying and
+// creating entities. Mirrors every change in a plain array and checks the store against it:
+// queries visit exactly the matching entities, components keep their values as entities move
+// between chunks, handles of destroyed entities stop resolving, and chunks stay dense. Exits with
+// an error if any check fails.
+
+#include "BenchmarkUtils.h"
+#include "EntityStore.h"
+#include "JobSystem.h"
+
+#include <glm/glm.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+using benchmark::ElapsedMs;
+
+struct Options
+{
+    std::string OutPath = "entity_benchmark_results.json";
+
+    int NumEntities = 1000000;
+
+    // Components added and removed, and entities destroyed and created, per frame.
+    int NumChanges = 10000;
+
+    int NumFrames = 50;
+
+    int NumThreads = 0;
+};
+
+constexpr const char* USAGE =
+    "Usage: EntityBenchmark [options]\n"
+    "  --entities N  Number of entities (default 1000000)\n"
+    "  --changes N   Structural changes of each kind per frame (default 10000)\n"
+    "  --frames N    Frames (default 50)\n"
+    "  --threads N   Job system threads, 0 for one per core (default 0)\n"
+    "  --out FILE    Results file (default entity_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--entities")
+            options->NumEntities = std::stoi(value);
+        else if (arg == "--changes")
+            options->NumChanges = std::stoi(value);
+        else if (arg == "--frames")
+            options->NumFrames = std::stoi(value);
+        else if (arg == "--threads")
+            options->NumThreads = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->NumEntities > 0 && options->NumChanges >= 0 &&
+        options->NumChanges <= options->NumEntities / 4 && options->NumFrames > 0;
+}
+
+json Summarize(std::vector<double> times)
+{
+    std::sort(times.begin(), times.end());
+
+    double mean = 0.0;
+
+    for (double time : times)
+    {
+        mean += time / static_cast<double>(times.size());
+    }
+
+    return {
+        {"mean_ms", mean},
+        {"p50_ms", times[times.size() / 2]},
+        {"max_ms", times.back()}
+    };
+}
+
+struct Position
+{
+    glm::vec3 Value;
+};
+
+struct Velocity
+{
+    glm::vec3 Value;
+};
+
+struct Rotation
+{
+    glm::vec4 Value;
+};
+
+struct RenderMesh
+{
+    uint32_t MeshIdx;
+    uint32_t MaterialIdx;
+};
+
+struct Health
+{
+    float Value;
+};
+
+// Added and removed while the benchmark runs.
+struct Burning
+{
+    float TimeLeft;
+};
+
+// What the store should hold for one entity.
+struct ExpectedEntity
+{
+    Entity Handle;
+
+    Position Pos;
+    Velocity Vel;
+
+    bool HasMesh = false;
+    bool IsBurning = false;
+    float BurnTime = 0.f;
+};
+
+// Everything an object-per-allocation engine would keep per instance, for comparison.
+struct FatObject
+{
+    glm::mat4 WorldMat;
+    glm::vec3 Position;
+    glm::vec3 Velocity;
+    glm::vec4 Rotation;
+    uint32_t MeshIdx;
+    uint32_t MaterialIdx;
+    float Health;
+    float BurnTime;
+};
+
+class EntityBenchmark
+{
+public:
+    explicit EntityBenchmark(const Options& options)
+        : m_options(options), m_jobSystem(options.NumThreads), m_rng(1234)
+    {
+    }
+
+    int Run();
+
+private:
+    ExpectedEntity CreateEntity(uint32_t i);
+
+    size_t PickAlive()
+    {
+        return std::uniform_int_distribution<size_t>(0, m_alive.size() - 1)(m_rng);
+    }
+
+    void MakeStructuralChanges(double* addMs, double* removeMs, double* destroyMs,
+                               double* createMs);
+
+    bool CheckComponents();
+    bool CheckDestroyedHandles();
+    bool CheckChunksDense();
+
+    const Options& m_options;
+
+    JobSystem m_jobSystem;
+    EntityStore m_store;
+
+    std::mt19937 m_rng;
+
+    std::vector<ExpectedEntity> m_expected;
+
+    // Indices into m_expected of live entities.
+    std::vector<uint32_t> m_alive;
+
+    std::vector<Entity> m_destroyed;
+
+    uint32_t m_numCreated = 0;
+};
+
+ExpectedEntity EntityBenchmark::CreateEntity(uint32_t i)
+{
+    ExpectedEntity expected{};
+    expected.Pos.Value = glm::vec3(static_cast<float>(i % 1000), 0.f,
+                                   static_cast<float>(i / 1000));
+    expected.Vel.Value = glm::vec3(static_cast<float>(i % 7) * 0.25f, 1.f,
+                                   static_cast<float>(i % 5) * -0.5f);
+
+    // Four archetypes: everything moves, half are drawn, a quarter also have health.
+    if (i % 2 == 0)
+    {
+        expected.HasMesh = true;
+        expected.Handle = m_store.Create(expected.Pos, expected.Vel,
+                                         Rotation{glm::vec4(0.f, 0.f, 0.f, 1.f)},
+                                         RenderMesh{i % 16, i % 64});
+    }
+    else if (i % 4 == 1)
+    {
+        expected.Handle = m_store.Create(expected.Pos, expected.Vel, Health{100.f});
+    }
+    else
+    {
+        expected.Handle = m_store.Create(expected.Pos, expected.Vel);
+    }
+
+    return expected;
+}
+
+void EntityBenchmark::MakeStructuralChanges(double* addMs, double* removeMs, double* destroyMs,
+                                            double* createMs)
+{
+    auto numChanges = static_cast<size_t>(m_options.NumChanges);
+
+    std::vector<uint32_t> picked;
+
+    // Pick the entities up front so that only the store's work is timed. An entity picked twice
+    // has its component overwritten, or removed when it is already gone, which is fine.
+    auto pick = [&](bool burning) {
+        picked.clear();
+
+        while (picked.size() < numChanges)
+        {
+            uint32_t idx = m_alive[PickAlive()];
+
+            if (m_expected[idx].IsBurning == burning)
+                picked.push_back(idx);
+        }
+    };
+
+    pick(false);
+
+    Clock::time_point start = Clock::now();
+
+    for (uint32_t idx : picked)
+    {
+        float burnTime = static_cast<float>(idx % 100);
+        m_store.AddComponent(m_expected[idx].Handle, Burning{burnTime});
+    }
+
+    *addMs = ElapsedMs(start);
+
+    for (uint32_t idx : picked)
+    {
+        m_expected[idx].IsBurning = true;
+        m_expected[idx].BurnTime = static_cast<float>(idx % 100);
+    }
+
+    pick(true);
+
+    start = Clock::now();
+
+    for (uint32_t idx : picked)
+    {
+        m_store.RemoveComponent<Burning>(m_expected[idx].Handle);
+    }
+
+    *removeMs = ElapsedMs(start);
+
+    for (uint32_t idx : picked)
+    {
+        m_expected[idx].IsBurning = false;
+    }
+
+    // Destroy, then create as many, which reuses the freed slots.
+    std::vector<size_t> slots;
+
+    while (slots.size() < numChanges)
+    {
+        while (slots.size() < numChanges)
+        {
+            slots.push_back(PickAlive());
+        }
+
+        // Remove from the back so that swap-removal does not move a picked slot.
+        std::sort(slots.begin(), slots.end(), std::greater<size_t>());
+        slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+    }
+
+    start = Clock::now();
+
+    for (size_t slot : slots)
+    {
+        m_store.Destroy(m_expected[m_alive[slot]].Handle);
+    }
+
+    *destroyMs = ElapsedMs(start);
+
+    for (size_t slot : slots)
+    {
+        if (m_destroyed.size() < 10000)
+            m_destroyed.push_back(m_expected[m_alive[slot]].Handle);
+
+        m_alive[slot] = m_alive.back();
+        m_alive.pop_back();
+    }
+
+    start = Clock::now();
+
+    for (size_t i = 0; i < numChanges; ++i)
+    {
+        m_expected.push_back(CreateEntity(m_numCreated++));
+    }
+
+    *createMs = ElapsedMs(start);
+
+    for (size_t i = 0; i < numChanges; ++i)
+    {
+        m_alive.push_back(static_cast<uint32_t>(m_expected.size() - numChanges + i));
+    }
+}
+
+bool EntityBenchmark::CheckComponents()
+{
+    for (uint32_t idx : m_alive)
+    {
+        const ExpectedEntity& expected = m_expected[idx];
+
+        Position* pos = m_store.Get<Position>(expected.Handle);
+        Burning* burning = m_store.Get<Burning>(expected.Handle);
+
+        if (!pos || pos->Value != expected.Pos.Value ||
+            m_store.Has<RenderMesh>(expected.Handle) != expected.HasMesh ||
+            (burning != nullptr) != expected.IsBurning ||
+            (burning && burning->TimeLeft != expected.BurnTime))
+        {
+            return false;
+        }
+    }
+
+    return m_store.GetNumEntities() == m_alive.size();
+}
+
+bool EntityBenchmark::CheckDestroyedHandles()
+{
+    for (Entity entity : m_destroyed)
+    {
+        if (m_store.IsAlive(entity) || m_store.Get<Position>(entity))
+            return false;
+    }
+
+    return true;
+}
+
+// All chunks of an archetype are full except the last.
+bool EntityBenchmark::CheckChunksDense()
+{
+    size_t numEntities = 0;
+    size_t numPartial = 0;
+
+    m_store.ForEachChunk<>([&](const EntityStore::ChunkView& view) {
+        numEntities += view.GetCount();
+        numPartial += view.GetCount() < view.GetCapacity();
+    });
+
+    return numEntities == m_store.GetNumEntities() && numPartial <= m_store.GetNumArchetypes();
+}
+
+int EntityBenchmark::Run()
+{
+    auto numEntities = static_cast<uint32_t>(m_options.NumEntities);
+
+    Clock::time_point start = Clock::now();
+
+    for (uint32_t i = 0; i < numEntities; ++i)
+    {
+        m_expected.push_back(CreateEntity(m_numCreated++));
+    }
+
+    double createAllMs = ElapsedMs(start);
+
+    for (uint32_t i = 0; i < numEntities; ++i)
+    {
+        m_alive.push_back(i);
+    }
+
+    std::vector<FatObject> fatObjects(numEntities);
+
+    for (uint32_t i = 0; i < numEntities; ++i)
+    {
+        fatObjects[i].Position = m_expected[i].Pos.Value;
+        fatObjects[i].Velocity = m_expected[i].Vel.Value;
+    }
+
+    std::vector<double> updateMs;
+    std::vector<double> parallelUpdateMs;
+    std::vector<double> readMs;
+    std::vector<double> fatUpdateMs;
+    std::vector<double> addMs;
+    std::vector<double> removeMs;
+    std::vector<double> destroyMs;
+    std::vector<double> createMs;
+
+    Checks checks;
+    bool queriesMatch = true;
+    bool componentsMatch = true;
+    bool chunksDense = true;
+
+    const float dt = 1.f / 60.f;
+    double checksum = 0.0;
+
+    for (int frame = 0; frame < m_options.NumFrames; ++frame)
+    {
+        start = Clock::now();
+        m_store.ForEach<Position, const Velocity>([dt](Position& pos, const Velocity& vel) {
+            pos.Value += vel.Value * dt;
+        });
+        updateMs.push_back(ElapsedMs(start));
+
+        size_t numVisited = 0;
+        m_store.ForEachChunk<Position, const Velocity>(
+            [&](const EntityStore::ChunkView& view) { numVisited += view.GetCount(); });
+
+        queriesMatch = queriesMatch && numVisited == m_alive.size();
+
+        start = Clock::now();
+        m_store.ParallelForEach<Position, const Velocity>(
+            &m_jobSystem, [dt](Position& pos, const Velocity& vel) {
+                pos.Value += vel.Value * dt;
+            });
+        parallelUpdateMs.push_back(ElapsedMs(start));
+
+        for (uint32_t idx : m_alive)
+        {
+            ExpectedEntity& expected = m_expected[idx];
+            expected.Pos.Value += expected.Vel.Value * dt;
+            expected.Pos.Value += expected.Vel.Value * dt;
+        }
+
+        size_t numDrawn = 0;
+        size_t numBurning = 0;
+
+        start = Clock::now();
+        m_store.ForEach<const Position, const RenderMesh>(
+            [&](const Position& pos, const RenderMesh& mesh) {
+                checksum += static_cast<double>(pos.Value.x) * mesh.MaterialIdx;
+                ++numDrawn;
+            });
+        readMs.push_back(ElapsedMs(start));
+
+        m_store.ForEach<const Burning>([&](const Burning&) { ++numBurning; });
+
+        size_t expectedDrawn = 0;
+        size_t expectedBurning = 0;
+
+        for (uint32_t idx : m_alive)
+        {
+            expectedDrawn += m_expected[idx].HasMesh;
+            expectedBurning += m_expected[idx].IsBurning;
+        }
+
+        queriesMatch = queriesMatch && numDrawn == expectedDrawn &&
+            numBurning == expectedBurning;
+
+        start = Clock::now();
+
+        for (FatObject& object : fatObjects)
+        {
+            object.Position += object.Velocity * dt;
+        }
+
+        fatUpdateMs.push_back(ElapsedMs(start));
+
+        double add = 0.0;
+        double remove = 0.0;
+        double destroy = 0.0;
+        double create = 0.0;
+        MakeStructuralChanges(&add, &remove, &destroy, &create);
+
+        addMs.push_back(add);
+        removeMs.push_back(remove);
+        destroyMs.push_back(destroy);
+        createMs.push_back(create);
+
+        chunksDense = chunksDense && CheckChunksDense();
+
+        if (frame % 10 == 0 || frame == m_options.NumFrames - 1)
+            componentsMatch = componentsMatch && CheckComponents();
+    }
+
+    checks.Check("queries_visit_matching_entities", queriesMatch);
+    checks.Check("components_match_reference", componentsMatch);
+    checks.Check("destroyed_handles_invalid", CheckDestroyedHandles());
+    checks.Check("chunks_dense", chunksDense);
+
+    double perChange = 1e6 / std::max(1, m_options.NumChanges);
+    double perEntity = 1e6 / static_cast<double>(numEntities);
+
+    json results = {
+        {"entities", m_options.NumEntities},
+        {"changes_per_frame", m_options.NumChanges},
+        {"frames", m_options.NumFrames},
+        {"threads", m_jobSystem.GetThreadCount()},
+        {"archetypes", m_store.GetNumArchetypes()},
+        {"create_all_ms", createAllMs},
+        {"update", Summarize(updateMs)},
+        {"update_ns_per_entity", Summarize(updateMs)["p50_ms"].get<double>() * perEntity},
+        {"parallel_update", Summarize(parallelUpdateMs)},
+        {"read_mesh_query", Summarize(readMs)},
+        {"fat_object_update", Summarize(fatUpdateMs)},
+        {"add_component_ns", Summarize(addMs)["p50_ms"].get<double>() * perChange},
+        {"remove_component_ns", Summarize(removeMs)["p50_ms"].get<double>() * perChange},
+        {"destroy_ns", Summarize(destroyMs)["p50_ms"].get<double>() * perChange},
+        {"create_ns", Summarize(createMs)["p50_ms"].get<double>() * perChange},
+        {"checksum", checksum},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, m_options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Entity store checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    auto runBenchmark = [](const Options& options) { return EntityBenchmark(options).Run(); };
+
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, runBenchmark);
+}
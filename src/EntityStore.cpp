@@ -0,0 +1,346 @@
+#include "EntityStore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+
+namespace
+{
+
+constexpr size_t columnAlignment = 16;
+
+std::mutex s_componentTypesMutex;
+std::array<ComponentInfo, MAX_COMPONENT_TYPES> s_componentTypes;
+std::atomic<uint32_t> s_numComponentTypes = 0;
+
+size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace
+
+uint32_t RegisterComponentType(const ComponentInfo& info)
+{
+    std::lock_guard lock(s_componentTypesMutex);
+
+    uint32_t typeId = s_numComponentTypes.load();
+
+    if (typeId == MAX_COMPONENT_TYPES)
+        throw std::runtime_error("Too many component types.");
+
+    s_componentTypes[typeId] = info;
+    s_numComponentTypes.store(typeId + 1);
+
+    return typeId;
+}
+
+const ComponentInfo& GetComponentInfo(uint32_t typeId)
+{
+    assert(typeId < s_numComponentTypes.load());
+
+    return s_componentTypes[typeId];
+}
+
+EntityStore::EntityStore()
+{
+    // The empty archetype, for entities created without components.
+    GetArchetype(0);
+}
+
+void EntityStore::Destroy(Entity entity)
+{
+    EntityRecord record = GetRecord(entity);
+
+    FreeRow(record.ArchetypeIdx, record.ChunkIdx, record.Row);
+
+    EntityRecord& freed = m_records[entity.Index];
+    freed.ArchetypeIdx = NO_ARCHETYPE;
+    ++freed.Generation;
+
+    m_freeIndices.push_back(entity.Index);
+
+    --m_numEntities;
+    ++m_structureVersion;
+}
+
+bool EntityStore::IsAlive(Entity entity) const
+{
+    return entity.Index < m_records.size() &&
+        m_records[entity.Index].Generation == entity.Generation &&
+        m_records[entity.Index].ArchetypeIdx != NO_ARCHETYPE;
+}
+
+size_t EntityStore::GetNumEntities() const
+{
+    return m_numEntities;
+}
+
+uint64_t EntityStore::GetStructureVersion() const
+{
+    return m_structureVersion;
+}
+
+size_t EntityStore::GetNumArchetypes() const
+{
+    return m_archetypes.size();
+}
+
+void EntityStore::Clear()
+{
+    for (Archetype& archetype : m_archetypes)
+    {
+        for (Chunk& chunk : archetype.Chunks)
+        {
+            m_spareChunks.push_back(std::move(chunk.Data));
+        }
+
+        archetype.Chunks.clear();
+    }
+
+    // Bump the generation of live slots so their handles stop resolving.
+    m_freeIndices.clear();
+
+    for (uint32_t i = 0; i < m_records.size(); ++i)
+    {
+        EntityRecord& record = m_records[i];
+
+        if (record.ArchetypeIdx != NO_ARCHETYPE)
+        {
+            record.ArchetypeIdx = NO_ARCHETYPE;
+            ++record.Generation;
+        }
+
+        m_freeIndices.push_back(i);
+    }
+
+    m_numEntities = 0;
+    ++m_structureVersion;
+}
+
+const EntityStore::EntityRecord& EntityStore::GetRecord(Entity entity) const
+{
+    if (!IsAlive(entity))
+        throw std::runtime_error("Entity is not alive.");
+
+    return m_records[entity.Index];
+}
+
+uint32_t EntityStore::GetArchetype(ComponentMask mask)
+{
+    auto it = m_archetypesByMask.find(mask);
+
+    if (it != m_archetypesByMask.end())
+        return it->second;
+
+    Archetype archetype{};
+    archetype.Mask = mask;
+    archetype.ColumnOffsets.fill(NO_COLUMN);
+    archetype.AddTargets.fill(NO_ARCHETYPE);
+    archetype.RemoveTargets.fill(NO_ARCHETYPE);
+
+    size_t bytesPerEntity = sizeof(Entity);
+
+    for (ComponentMask bits = mask; bits; bits &= bits - 1)
+    {
+        auto typeId = static_cast<uint32_t>(std::countr_zero(bits));
+
+        archetype.TypeIds.push_back(typeId);
+        bytesPerEntity += GetComponentInfo(typeId).Size;
+    }
+
+    // Leave room for aligning every array.
+    size_t padding = columnAlignment * (archetype.TypeIds.size() + 1);
+
+    if (CHUNK_SIZE < padding + bytesPerEntity)
+        throw std::runtime_error("Components too large for a chunk.");
+
+    archetype.Capacity = static_cast<uint32_t>((CHUNK_SIZE - padding) / bytesPerEntity);
+
+    size_t offset = AlignUp(sizeof(Entity) * archetype.Capacity, columnAlignment);
+
+    for (uint32_t typeId : archetype.TypeIds)
+    {
+        archetype.ColumnOffsets[typeId] = static_cast<uint32_t>(offset);
+        offset = AlignUp(offset + GetComponentInfo(typeId).Size * archetype.Capacity,
+                         columnAlignment);
+    }
+
+    assert(offset <= CHUNK_SIZE);
+
+    auto archetypeIdx = static_cast<uint32_t>(m_archetypes.size());
+
+    m_archetypes.push_back(std::move(archetype));
+    m_archetypesByMask.emplace(mask, archetypeIdx);
+
+    return archetypeIdx;
+}
+
+uint32_t EntityStore::GetAddTarget(uint32_t archetypeIdx, uint32_t typeId)
+{
+    uint32_t target = m_archetypes[archetypeIdx].AddTargets[typeId];
+
+    if (target == NO_ARCHETYPE)
+    {
+        target = GetArchetype(m_archetypes[archetypeIdx].Mask | (ComponentMask{1} << typeId));
+
+        m_archetypes[archetypeIdx].AddTargets[typeId] = target;
+        m_archetypes[target].RemoveTargets[typeId] = archetypeIdx;
+    }
+
+    return target;
+}
+
+uint32_t EntityStore::GetRemoveTarget(uint32_t archetypeIdx, uint32_t typeId)
+{
+    uint32_t target = m_archetypes[archetypeIdx].RemoveTargets[typeId];
+
+    if (target == NO_ARCHETYPE)
+    {
+        target = GetArchetype(m_archetypes[archetypeIdx].Mask & ~(ComponentMask{1} << typeId));
+
+        m_archetypes[archetypeIdx].RemoveTargets[typeId] = target;
+        m_archetypes[target].AddTargets[typeId] = archetypeIdx;
+    }
+
+    return target;
+}
+
+Entity EntityStore::CreateEntity(uint32_t archetypeIdx)
+{
+    Entity entity{};
+
+    if (!m_freeIndices.empty())
+    {
+        entity.Index = m_freeIndices.back();
+        m_freeIndices.pop_back();
+    }
+    else
+    {
+        entity.Index = static_cast<uint32_t>(m_records.size());
+        m_records.emplace_back();
+    }
+
+    entity.Generation = m_records[entity.Index].Generation;
+
+    AllocateRow(archetypeIdx, entity);
+
+    ++m_numEntities;
+    ++m_structureVersion;
+
+    return entity;
+}
+
+void* EntityStore::GetComponentPtr(const EntityRecord& record, uint32_t typeId)
+{
+    Archetype& archetype = m_archetypes[record.ArchetypeIdx];
+    uint32_t offset = archetype.ColumnOffsets[typeId];
+
+    if (offset == NO_COLUMN)
+        return nullptr;
+
+    return archetype.Chunks[record.ChunkIdx].Data.get() + offset +
+        static_cast<size_t>(record.Row) * GetComponentInfo(typeId).Size;
+}
+
+void EntityStore::AllocateRow(uint32_t archetypeIdx, Entity entity)
+{
+    Archetype& archetype = m_archetypes[archetypeIdx];
+
+    if (archetype.Chunks.empty() || archetype.Chunks.back().Count == archetype.Capacity)
+    {
+        Chunk chunk{};
+
+        if (!m_spareChunks.empty())
+        {
+            chunk.Data = std::move(m_spareChunks.back());
+            m_spareChunks.pop_back();
+        }
+        else
+        {
+            chunk.Data = std::make_unique<std::byte[]>(CHUNK_SIZE);
+        }
+
+        archetype.Chunks.push_back(std::move(chunk));
+    }
+
+    Chunk& chunk = archetype.Chunks.back();
+    uint32_t row = chunk.Count++;
+
+    std::memcpy(chunk.Data.get() + row * sizeof(Entity), &entity, sizeof(Entity));
+
+    EntityRecord& record = m_records[entity.Index];
+    record.ArchetypeIdx = archetypeIdx;
+    record.ChunkIdx = static_cast<uint32_t>(archetype.Chunks.size() - 1);
+    record.Row = row;
+}
+
+void EntityStore::FreeRow(uint32_t archetypeIdx, uint32_t chunkIdx, uint32_t row)
+{
+    Archetype& archetype = m_archetypes[archetypeIdx];
+
+    auto lastChunkIdx = static_cast<uint32_t>(archetype.Chunks.size() - 1);
+    Chunk& lastChunk = archetype.Chunks[lastChunkIdx];
+    uint32_t lastRow = lastChunk.Count - 1;
+
+    if (chunkIdx != lastChunkIdx || row != lastRow)
+    {
+        std::byte* dst = archetype.Chunks[chunkIdx].Data.get();
+        const std::byte* src = lastChunk.Data.get();
+
+        Entity moved{};
+        std::memcpy(&moved, src + lastRow * sizeof(Entity), sizeof(Entity));
+        std::memcpy(dst + row * sizeof(Entity), &moved, sizeof(Entity));
+
+        for (uint32_t typeId : archetype.TypeIds)
+        {
+            size_t size = GetComponentInfo(typeId).Size;
+            uint32_t offset = archetype.ColumnOffsets[typeId];
+
+            std::memcpy(dst + offset + row * size, src + offset + lastRow * size, size);
+        }
+
+        EntityRecord& movedRecord = m_records[moved.Index];
+        movedRecord.ChunkIdx = chunkIdx;
+        movedRecord.Row = row;
+    }
+
+    if (--lastChunk.Count == 0)
+    {
+        m_spareChunks.push_back(std::move(lastChunk.Data));
+        archetype.Chunks.pop_back();
+    }
+}
+
+void EntityStore::MoveEntity(Entity entity, uint32_t dstArchetypeIdx)
+{
+    EntityRecord src = m_records[entity.Index];
+
+    AllocateRow(dstArchetypeIdx, entity);
+
+    const EntityRecord& dst = m_records[entity.Index];
+
+    const Archetype& srcArchetype = m_archetypes[src.ArchetypeIdx];
+    const Archetype& dstArchetype = m_archetypes[dstArchetypeIdx];
+
+    const std::byte* srcData = srcArchetype.Chunks[src.ChunkIdx].Data.get();
+    std::byte* dstData = dstArchetype.Chunks[dst.ChunkIdx].Data.get();
+
+    for (uint32_t typeId : srcArchetype.TypeIds)
+    {
+        uint32_t dstOffset = dstArchetype.ColumnOffsets[typeId];
+
+        if (dstOffset == NO_COLUMN)
+            continue;
+
+        size_t size = GetComponentInfo(typeId).Size;
+
+        std::memcpy(dstData + dstOffset + dst.Row * size,
+                    srcData + srcArchetype.ColumnOffsets[typeId] + src.Row * size, size);
+    }
+
+    FreeRow(src.ArchetypeIdx, src.ChunkIdx, src.Row);
+
+    ++m_structureVersion;
+}
@@ -0,0 +1,339 @@
+#pragma once
+
+#include "JobSystem.h"
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Component types are numbered as they are first used, up to this many per process.
+constexpr uint32_t MAX_COMPONENT_TYPES = 64;
+
+// Bit i is set for component type i.
+using ComponentMask = uint64_t;
+
+// Refers to one entity for as long as it lives, wherever its components move. Slots are reused
+// with a new generation, so a destroyed entity's handle never refers to a later entity.
+struct Entity
+{
+    uint32_t Index = UINT32_MAX;
+    uint32_t Generation = 0;
+
+    bool operator==(const Entity&) const = default;
+};
+
+struct ComponentInfo
+{
+    uint32_t Size = 0;
+    uint32_t Alignment = 0;
+};
+
+// Assigns the next component type id. Throws once MAX_COMPONENT_TYPES are in use.
+uint32_t RegisterComponentType(const ComponentInfo& info);
+
+const ComponentInfo& GetComponentInfo(uint32_t typeId);
+
+// Components are moved between chunks with memcpy and never destroyed, so they must be plain
+// data. Chunk arrays are 16-byte aligned.
+template<typename T>
+uint32_t GetComponentTypeId()
+{
+    static_assert(std::is_same_v<T, std::remove_cv_t<T>>);
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+    static_assert(alignof(T) <= 16);
+
+    static const uint32_t typeId = RegisterComponentType({sizeof(T), alignof(T)});
+
+    return typeId;
+}
+
+template<typename T>
+ComponentMask GetComponentMask()
+{
+    return ComponentMask{1} << GetComponentTypeId<std::remove_const_t<T>>();
+}
+
+// Stores entities grouped by archetype - the exact set of components they have. Each archetype
+// keeps its entities in fixed-size chunks, with one contiguous array per component, so queries
+// walk memory linearly and touch only the components they ask for. All chunks of an archetype
+// are full except the last, so adding and removing components, which move an entity to another
+// archetype, keep memory dense.
+//
+// Not thread-safe. Structural changes - creating and destroying entities, adding and removing
+// components - must not happen during a query.
+class EntityStore
+{
+    struct Archetype;
+    struct Chunk;
+
+public:
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
+
+    // One chunk of a query's results.
+    class ChunkView
+    {
+    public:
+        ChunkView(const Archetype* archetype, const Chunk* chunk)
+            : m_archetype(archetype), m_chunk(chunk)
+        {
+        }
+
+        size_t GetCount() const
+        {
+            return m_chunk->Count;
+        }
+
+        size_t GetCapacity() const
+        {
+            return m_archetype->Capacity;
+        }
+
+        ComponentMask GetMask() const
+        {
+            return m_archetype->Mask;
+        }
+
+        std::span<const Entity> GetEntities() const
+        {
+            return {reinterpret_cast<const Entity*>(m_chunk->Data.get()), m_chunk->Count};
+        }
+
+        // The chunk must have the component.
+        template<typename T>
+        std::span<T> Get() const
+        {
+            std::span<T> column = TryGet<T>();
+            assert(column.data() || m_chunk->Count == 0);
+
+            return column;
+        }
+
+        // Empty if the chunk's archetype lacks the component.
+        template<typename T>
+        std::span<T> TryGet() const
+        {
+            uint32_t offset =
+                m_archetype->ColumnOffsets[GetComponentTypeId<std::remove_const_t<T>>()];
+
+            if (offset == NO_COLUMN)
+                return {};
+
+            return {reinterpret_cast<T*>(m_chunk->Data.get() + offset), m_chunk->Count};
+        }
+
+    private:
+        const Archetype* m_archetype;
+        const Chunk* m_chunk;
+    };
+
+    EntityStore();
+
+    EntityStore(const EntityStore&) = delete;
+    EntityStore& operator=(const EntityStore&) = delete;
+
+    template<typename... Ts>
+    Entity Create(const Ts&... components)
+    {
+        ComponentMask mask = (ComponentMask{0} | ... | GetComponentMask<Ts>());
+        assert(std::popcount(mask) == static_cast<int>(sizeof...(Ts)));
+
+        Entity entity = CreateEntity(GetArchetype(mask));
+        (WriteComponent(entity, components), ...);
+
+        return entity;
+    }
+
+    // Throws if |entity| is not alive.
+    void Destroy(Entity entity);
+
+    bool IsAlive(Entity entity) const;
+
+    size_t GetNumEntities() const;
+
+    // Overwrites the component if the entity already has one. Throws if |entity| is not alive.
+    template<typename T>
+    void AddComponent(Entity entity, const T& component)
+    {
+        uint32_t archetypeIdx = GetRecord(entity).ArchetypeIdx;
+
+        if (!(m_archetypes[archetypeIdx].Mask & GetComponentMask<T>()))
+            MoveEntity(entity, GetAddTarget(archetypeIdx, GetComponentTypeId<T>()));
+
+        WriteComponent(entity, component);
+    }
+
+    // Does nothing if the entity lacks the component. Throws if |entity| is not alive.
+    template<typename T>
+    void RemoveComponent(Entity entity)
+    {
+        uint32_t archetypeIdx = GetRecord(entity).ArchetypeIdx;
+
+        if (m_archetypes[archetypeIdx].Mask & GetComponentMask<T>())
+            MoveEntity(entity, GetRemoveTarget(archetypeIdx, GetComponentTypeId<T>()));
+    }
+
+    template<typename T>
+    bool Has(Entity entity) const
+    {
+        return IsAlive(entity) &&
+            (m_archetypes[m_records[entity.Index].ArchetypeIdx].Mask & GetComponentMask<T>());
+    }
+
+    // Null if the entity is not alive or lacks the component. Valid until the next structural
+    // change.
+    template<typename T>
+    T* Get(Entity entity)
+    {
+        if (!IsAlive(entity))
+            return nullptr;
+
+        return static_cast<T*>(GetComponentPtr(m_records[entity.Index],
+                                               GetComponentTypeId<std::remove_const_t<T>>()));
+    }
+
+    // Calls |fn| with a ChunkView for every non-empty chunk whose entities have all of |Ts|.
+    template<typename... Ts, typename Fn>
+    void ForEachChunk(Fn&& fn)
+    {
+        ComponentMask mask = (ComponentMask{0} | ... | GetComponentMask<Ts>());
+
+        for (const Archetype& archetype : m_archetypes)
+        {
+            if ((archetype.Mask & mask) != mask)
+                continue;
+
+            for (const Chunk& chunk : archetype.Chunks)
+            {
+                fn(ChunkView(&archetype, &chunk));
+            }
+        }
+    }
+
+    // Calls |fn| with references to the components |Ts| of every entity that has them. Declare
+    // components the query only reads as const.
+    template<typename... Ts, typename Fn>
+    void ForEach(Fn&& fn)
+    {
+        ForEachChunk<Ts...>([&](const ChunkView& view) {
+            ForEachRow(view.GetCount(), fn, view.Get<Ts>().data()...);
+        });
+    }
+
+    // As ForEach(), with chunks spread over |jobSystem|'s workers. |fn| must be safe to call
+    // concurrently for different entities.
+    template<typename... Ts, typename Fn>
+    void ParallelForEach(JobSystem* jobSystem, Fn&& fn)
+    {
+        std::vector<ChunkView> views;
+        ForEachChunk<Ts...>([&](const ChunkView& view) { views.push_back(view); });
+
+        jobSystem->ParallelFor(views.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+            {
+                ForEachRow(views[i].GetCount(), fn, views[i].Get<Ts>().data()...);
+            }
+        });
+    }
+
+    // Changes whenever entities are created or destroyed, or components are added or removed.
+    uint64_t GetStructureVersion() const;
+
+    size_t GetNumArchetypes() const;
+
+    void Clear();
+
+private:
+    static constexpr uint32_t NO_COLUMN = UINT32_MAX;
+    static constexpr uint32_t NO_ARCHETYPE = UINT32_MAX;
+
+    struct Chunk
+    {
+        // The entity array, then one array per component.
+        std::unique_ptr<std::byte[]> Data;
+        uint32_t Count = 0;
+    };
+
+    struct Archetype
+    {
+        ComponentMask Mask = 0;
+
+        // Component types in increasing order.
+        std::vector<uint32_t> TypeIds;
+
+        // Byte offset of each component's array within a chunk, indexed by type id.
+        std::array<uint32_t, MAX_COMPONENT_TYPES> ColumnOffsets;
+
+        uint32_t Capacity = 0;
+
+        std::vector<Chunk> Chunks;
+
+        // Archetypes with one component type added or removed, found as needed.
+        std::array<uint32_t, MAX_COMPONENT_TYPES> AddTargets;
+        std::array<uint32_t, MAX_COMPONENT_TYPES> RemoveTargets;
+    };
+
+    // Where an entity's components live. ArchetypeIdx is NO_ARCHETYPE while the slot is free.
+    struct EntityRecord
+    {
+        uint32_t Generation = 0;
+        uint32_t ArchetypeIdx = NO_ARCHETYPE;
+        uint32_t ChunkIdx = 0;
+        uint32_t Row = 0;
+    };
+
+    template<typename Fn, typename... Columns>
+    static void ForEachRow(size_t count, Fn& fn, Columns*... columns)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            fn(columns[i]...);
+        }
+    }
+
+    template<typename T>
+    void WriteComponent(Entity entity, const T& component)
+    {
+        std::memcpy(GetComponentPtr(m_records[entity.Index], GetComponentTypeId<T>()), &component,
+                    sizeof(T));
+    }
+
+    const EntityRecord& GetRecord(Entity entity) const;
+
+    uint32_t GetArchetype(ComponentMask mask);
+
+    uint32_t GetAddTarget(uint32_t archetypeIdx, uint32_t typeId);
+    uint32_t GetRemoveTarget(uint32_t archetypeIdx, uint32_t typeId);
+
+    Entity CreateEntity(uint32_t archetypeIdx);
+
+    void* GetComponentPtr(const EntityRecord& record, uint32_t typeId);
+
+    // Appends a row for |entity| to the archetype's last chunk, and points its record at it.
+    void AllocateRow(uint32_t archetypeIdx, Entity entity);
+
+    // Fills the row with the archetype's last row, keeping chunks dense.
+    void FreeRow(uint32_t archetypeIdx, uint32_t chunkIdx, uint32_t row);
+
+    // Copies the components both archetypes share; the others are left for the caller to write.
+    void MoveEntity(Entity entity, uint32_t dstArchetypeIdx);
+
+    std::vector<Archetype> m_archetypes;
+    std::unordered_map<ComponentMask, uint32_t> m_archetypesByMask;
+
+    std::vector<EntityRecord> m_records;
+    std::vector<uint32_t> m_freeIndices;
+
+    // Chunks emptied by removals, kept for reuse.
+    std::vector<std::unique_ptr<std::byte[]>> m_spareChunks;
+
+    size_t m_numEntities = 0;
+    uint64_t m_structureVersion = 0;
+};
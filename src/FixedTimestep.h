@@ -0,0 +1,46 @@
+#pragma once
+
+#include <algorithm>
+
+// Accumulates variable frame times into a whole number of fixed simulation steps. The leftover
+// fraction of a step is exposed as an interpolation factor for rendering between the last two
+// simulated states.
+class FixedTimestep
+{
+public:
+    static constexpr double DEFAULT_STEP_SEC = 1.0 / 120.0;
+
+    // Steps beyond |maxStepsPerFrame| are dropped so that a long stall does not snowball.
+    explicit FixedTimestep(double stepSec, int maxStepsPerFrame = 8)
+        : m_stepSec(stepSec), m_maxStepsPerFrame(maxStepsPerFrame)
+    {
+    }
+
+    // Returns the number of steps to simulate for a frame that took |elapsedSec|.
+    int Advance(double elapsedSec)
+    {
+        m_accumulator += elapsedSec;
+
+        int numSteps = static_cast<int>(m_accumulator / m_stepSec);
+        m_accumulator -= numSteps * m_stepSec;
+
+        return std::min(numSteps, m_maxStepsPerFrame);
+    }
+
+    double GetStepSec() const
+    {
+        return m_stepSec;
+    }
+
+    // How far rendering is between the previous and the current simulated state, in [0, 1).
+    float GetAlpha() const
+    {
+        return static_cast<float>(m_accumulator / m_stepSec);
+    }
+
+private:
+    double m_stepSec;
+    int m_maxStepsPerFrame;
+
+    double m_accumulator = 0.0;
+};
@@ -0,0 +1,37 @@
+#include "FrameArena.h"
+
+#include <atomic>
+
+namespace
+{
+
+// Bumped by EndThreadFrame(). Each thread's arena remembers the frame it was last reset for.
+std::atomic<uint64_t> g_frameIdx = 0;
+
+struct ThreadArena
+{
+    FrameArena Arena;
+    uint64_t FrameIdx = 0;
+};
+
+thread_local ThreadArena t_arena;
+
+} // namespace
+
+FrameArena& FrameArena::GetThreadArena()
+{
+    uint64_t frameIdx = g_frameIdx.load(std::memory_order_acquire);
+
+    if (t_arena.FrameIdx != frameIdx)
+    {
+        t_arena.Arena.Reset();
+        t_arena.FrameIdx = frameIdx;
+    }
+
+    return t_arena.Arena;
+}
+
+void FrameArena::EndThreadFrame()
+{
+    g_frameIdx.fetch_add(1, std::memory_order_release);
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for data that lives for one frame. Reset() rewinds it without releasing memory,
+// so after the first few frames allocation never reaches the heap. Only trivially destructible
+// types may be allocated since nothing is destroyed.
+class FrameArena
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    FrameArena() = default;
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    FrameArena(FrameArena&&) = default;
+    FrameArena& operator=(FrameArena&&) = default;
+
+    // The calling thread's arena, for scratch data that lives no longer than the frame. Only for
+    // work that the frame waits for - a thread that runs frames of its own, like the render
+    // thread, should keep its own arena.
+    static FrameArena& GetThreadArena();
+
+    // Ends the frame for every thread's arena. Each is reset the next time its thread asks for it,
+    // so threads that sit idle are not touched.
+    static void EndThreadFrame();
+
+    void* Allocate(size_t size, size_t alignment)
+    {
+        assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+        for (;;)
+        {
+            if (m_blockIdx < m_blocks.size())
+            {
+                Block& block = m_blocks[m_blockIdx];
+
+                uintptr_t base = reinterpret_cast<uintptr_t>(block.Data.get());
+                size_t offset = ((base + m_offset + alignment - 1) & ~(alignment - 1)) - base;
+
+                if (offset + size <= block.Size)
+                {
+                    m_offset = offset + size;
+                    return block.Data.get() + offset;
+                }
+
+                // Move on to the next block, which may already exist from a previous frame.
+                if (m_blockIdx + 1 < m_blocks.size() && m_blocks[m_blockIdx + 1].Size >= size)
+                {
+                    ++m_blockIdx;
+                    m_offset = 0;
+                    continue;
+                }
+            }
+
+            // Leave room to align the start of the allocation within a fresh block.
+            size_t blockSize = std::max(BLOCK_SIZE, size + alignment);
+
+            m_blocks.insert(m_blocks.begin() + std::min(m_blockIdx + 1, m_blocks.size()),
+                            Block{std::make_unique<std::byte[]>(blockSize), blockSize});
+
+            m_blockIdx = m_blocks.size() == 1 ? 0 : m_blockIdx + 1;
+            m_offset = 0;
+        }
+    }
+
+    // Makes the first block hold at least |size| bytes, so that a frame allocating no more than
+    // that, alignment included, stays off the heap. The arena must be reset.
+    void Reserve(size_t size)
+    {
+        assert(m_blockIdx == 0 && m_offset == 0);
+
+        if (!m_blocks.empty() && m_blocks[0].Size >= size)
+            return;
+
+        size_t blockSize = std::max(BLOCK_SIZE, size);
+        Block block{std::make_unique<std::byte[]>(blockSize), blockSize};
+
+        if (m_blocks.empty())
+            m_blocks.push_back(std::move(block));
+        else
+            m_blocks[0] = std::move(block);
+    }
+
+    template<typename T>
+    std::span<T> AllocateArray(size_t count)
+    {
+        static_assert(std::is_trivially_destructible_v<T>);
+
+        if (count == 0)
+            return {};
+
+        T* ptr = static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+
+        return std::span<T>(ptr, count);
+    }
+
+    template<typename T>
+    std::span<T> CopyArray(std::span<const T> src)
+    {
+        std::span<T> dst = AllocateArray<T>(src.size());
+        std::copy(src.begin(), src.end(), dst.begin());
+
+        return dst;
+    }
+
+    void Reset()
+    {
+        m_blockIdx = 0;
+        m_offset = 0;
+    }
+
+    size_t GetCapacity() const
+    {
+        size_t capacity = 0;
+
+        for (const Block& block : m_blocks)
+        {
+            capacity += block.Size;
+        }
+
+        return capacity;
+    }
+
+private:
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> Data;
+        size_t Size;
+    };
+
+    std::vector<Block> m_blocks;
+
+    size_t m_blockIdx = 0;
+    size_t m_offset = 0;
+};
+
+// Adapts a FrameArena for standard containers, whose memory is then released all at once when the
+// arena is reset. Deallocation does nothing, so a container that grows leaves its old storage
+// behind until then - reserve what is known up front. Elements are still destroyed by the
+// container, so any type may be used.
+template<typename T>
+class FrameAllocator
+{
+public:
+    using value_type = T;
+
+    // Allocates from the calling thread's arena.
+    FrameAllocator()
+        : m_arena(&FrameArena::GetThreadArena())
+    {
+    }
+
+    explicit FrameAllocator(FrameArena* arena)
+        : m_arena(arena)
+    {
+    }
+
+    template<typename U>
+    FrameAllocator(const FrameAllocator<U>& other)
+        : m_arena(other.GetArena())
+    {
+    }
+
+    T* allocate(size_t count)
+    {
+        if (count > SIZE_MAX / sizeof(T))
+            throw std::bad_array_new_length();
+
+        return static_cast<T*>(m_arena->Allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void deallocate(T*, size_t)
+    {
+    }
+
+    FrameArena* GetArena() const
+    {
+        return m_arena;
+    }
+
+    template<typename U>
+    bool operator==(const FrameAllocator<U>& other) const
+    {
+        return m_arena == other.GetArena();
+    }
+
+private:
+    FrameArena* m_arena;
+};
+
+// A vector for per-frame scratch, in the calling thread's arena unless given another.
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
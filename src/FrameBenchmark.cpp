@@ -0,0 +1,720 @@
+// Headless benchmark for the CPU side of a frame. Loads a scene, flies the camera along a scripted
+// path or replays input recorded by the app, and runs the same FrameBuilder stages as the app,
+// submitting to a null backend instead of D3D12. Needs no window or GPU, so it runs on any
+// platform. With --render-thread, frames are handed to the backend through the app's
+// RenderThread.
+
+#include "AllocationTracker.h"
+#include "BenchmarkUtils.h"
+#include "Camera.h"
+#include "CameraPath.h"
+#include "Clock.h"
+#include "CommandStream.h"
+#include "FixedTimestep.h"
+#include "FrameArena.h"
+#include "FrameBuilder.h"
+#include "FramePacket.h"
+#include "GltfLoader.h"
+#include "InputManager.h"
+#include "InputRecording.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "RenderThread.h"
+#include "Utils.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <nlohmann/json.hpp>
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <numbers>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Clock;
+
+struct Options
+{
+    std::string Scene = "sponza";
+    std::string Path = "orbit";
+    std::string OutPath = "benchmark_results.json";
+
+    // Input recorded by the app, replayed through the app's camera instead of following Path.
+    std::string InputPath;
+
+    int NumObjects = 10000;
+    int NumMeshes = 16;
+    int NumCopies = 1;
+
+    // Fraction of synthetic objects whose transform changes every frame.
+    float DynamicFraction = 0.1f;
+
+    int NumFrames = 1000;
+    int NumWarmupFrames = 50;
+    int NumThreads = 0;
+
+    bool UseRenderThread = false;
+
+    // Fail if any measured frame touches the heap.
+    bool RequireZeroAllocations = false;
+};
+
+constexpr const char* USAGE =
+    "Usage: FrameBenchmark [options]\n"
+    "  --scene sponza|synthetic   Scene to render (default sponza)\n"
+    "  --copies N                 Copies of Sponza laid side by side (default 1)\n"
+    "  --objects N                Objects in the synthetic scene (default 10000)\n"
+    "  --meshes N                 Distinct meshes in the synthetic scene (default 16)\n"
+    "  --dynamic F                Fraction of synthetic objects moving (default 0.1)\n"
+    "  --path orbit|flythrough    Camera path (default orbit)\n"
+    "  --input FILE               Drive the camera from an input recording instead\n"
+    "  --frames N                 Measured frames (default 1000)\n"
+    "  --warmup N                 Unmeasured frames before measuring (default 50)\n"
+    "  --threads N                Job system threads, 0 for one per core (default 0)\n"
+    "  --render-thread            Submit through a render thread, as the app does\n"
+    "  --require-zero-allocations Fail if any measured frame allocates\n"
+    "  --out FILE                 Results file (default benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--render-thread")
+            options->UseRenderThread = true;
+        else if (arg == "--require-zero-allocations")
+            options->RequireZeroAllocations = true;
+        else if (arg == "--scene")
+            options->Scene = value;
+        else if (arg == "--copies")
+            options->NumCopies = std::stoi(value);
+        else if (arg == "--objects")
+            options->NumObjects = std::stoi(value);
+        else if (arg == "--meshes")
+            options->NumMeshes = std::stoi(value);
+        else if (arg == "--dynamic")
+            options->DynamicFraction = std::stof(value);
+        else if (arg == "--path")
+            options->Path = value;
+        else if (arg == "--input")
+            options->InputPath = value;
+        else if (arg == "--frames")
+            options->NumFrames = std::stoi(value);
+        else if (arg == "--warmup")
+            options->NumWarmupFrames = std::stoi(value);
+        else if (arg == "--threads")
+            options->NumThreads = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption,
+                              {"--render-thread", "--require-zero-allocations"}))
+        return false;
+
+    return options->NumFrames > 0 && options->NumMeshes > 0;
+}
+
+// Adds every primitive of the Sponza model, once per copy. Geometry indices are the primitive
+// indices, as they would be in the app.
+void BuildSponzaScene(const Options& options, FrameBuilder* builder)
+{
+    ModelData model = LoadGltfModelData("assets/sponza/Sponza.gltf");
+
+    glm::mat4 scaleMat = glm::scale(glm::mat4(1.f), glm::vec3(0.008f));
+
+    for (int copy = 0; copy < options.NumCopies; ++copy)
+    {
+        glm::mat4 worldMat =
+            glm::translate(glm::mat4(1.f), glm::vec3(40.f * static_cast<float>(copy), 0.f, 0.f)) *
+            scaleMat;
+
+        uint32_t transformIdx = builder->AddTransform(worldMat);
+
+        uint32_t geometryIdx = 0;
+
+        for (const MeshData& mesh : model.Meshes)
+        {
+            for (const PrimitiveData& prim : mesh.Primitives)
+            {
+                RenderObject object{};
+                object.GeometryIdx = geometryIdx++;
+                object.MaterialIdx = static_cast<uint32_t>(prim.MaterialIdx);
+                object.BaseColorTextureId = model.Materials[prim.MaterialIdx].BaseColorTextureId;
+                object.IndexCount = prim.Indices.Count;
+                object.TransformIdx = transformIdx;
+                object.LocalBoundsMin = prim.BoundsMin;
+                object.LocalBoundsMax = prim.BoundsMax;
+
+                builder->AddObject(object);
+            }
+        }
+    }
+}
+
+constexpr uint32_t syntheticNumMaterials = 64;
+constexpr int syntheticNumTextures = 32;
+
+glm::mat4 GetSyntheticTransform(const glm::vec3& position, float angle)
+{
+    return glm::rotate(glm::translate(glm::mat4(1.f), position), angle, glm::vec3(0.f, 1.f, 0.f));
+}
+
+// Unit cubes scattered over a square field, with a fixed seed so runs are comparable. Each object
+// uses one of the meshes and one of the materials, which decides its texture.
+void BuildSyntheticScene(const Options& options, FrameBuilder* builder,
+                         std::vector<glm::vec3>* positions)
+{
+    std::mt19937 rng(1234);
+
+    float fieldSize = std::sqrt(static_cast<float>(options.NumObjects)) * 4.f;
+
+    std::uniform_real_distribution<float> posDist(-fieldSize * 0.5f, fieldSize * 0.5f);
+    std::uniform_real_distribution<float> heightDist(0.f, 8.f);
+
+    auto numMeshes = static_cast<uint32_t>(options.NumMeshes);
+
+    for (int i = 0; i < options.NumObjects; ++i)
+    {
+        glm::vec3 position(posDist(rng), heightDist(rng), posDist(rng));
+        positions->push_back(position);
+
+        RenderObject object{};
+        object.GeometryIdx = static_cast<uint32_t>(rng() % static_cast<uint64_t>(numMeshes));
+        object.MaterialIdx = rng() % syntheticNumMaterials;
+        object.BaseColorTextureId = static_cast<TextureId>(object.MaterialIdx %
+                                                           syntheticNumTextures);
+        object.IndexCount = 36 * (object.GeometryIdx + 1);
+        object.TransformIdx = builder->AddTransform(GetSyntheticTransform(position, 0.f));
+        object.LocalBoundsMin = glm::vec3(-0.5f);
+        object.LocalBoundsMax = glm::vec3(0.5f);
+
+        builder->AddObject(object);
+    }
+}
+
+// Stands in for the D3D12 backend. Walks the command stream and the instance data the same way
+// the real backend does and folds the bound state and each instance's material into a checksum, so
+// the work cannot be optimised away and runs with different settings can be checked for identical
+// output. Packets skipped by the render thread never reach it, so the checksum is only comparable
+// between single-threaded runs.
+class NullGraphicsBackend : public RenderBackend
+{
+public:
+    void RenderFrame(const FramePacket& packet) override
+    {
+        Submit(packet.Commands, packet.Instances);
+    }
+
+    void Submit(std::span<const Command> commands, std::span<const InstanceData> instances)
+    {
+        size_t firstInstance = 0;
+
+        for (const Command& cmd : commands)
+        {
+            if (cmd.Type == CommandType::DrawIndexed)
+            {
+                for (uint32_t state : m_state)
+                {
+                    Hash(state);
+                }
+
+                Hash(cmd.Value);
+
+                size_t instanceCount = m_state[static_cast<int>(CommandType::SetInstanceCount)];
+
+                if (firstInstance + instanceCount > instances.size())
+                {
+                    m_instancesMatch = false;
+                    return;
+                }
+
+                for (size_t i = firstInstance; i < firstInstance + instanceCount; ++i)
+                {
+                    Hash(instances[i].MaterialIdx);
+                }
+
+                firstInstance += instanceCount;
+            }
+            else
+            {
+                m_state[static_cast<int>(cmd.Type)] = cmd.Value;
+            }
+        }
+
+        m_instancesMatch = m_instancesMatch && firstInstance == instances.size();
+    }
+
+    uint64_t GetChecksum() const
+    {
+        return m_checksum;
+    }
+
+    // False if any frame's draws did not consume exactly its instances.
+    bool InstancesMatch() const
+    {
+        return m_instancesMatch;
+    }
+
+private:
+    void Hash(uint32_t value)
+    {
+        // FNV-1a.
+        m_checksum = (m_checksum ^ value) * 1099511628211ull;
+    }
+
+    std::array<uint32_t, static_cast<int>(CommandType::DrawIndexed)> m_state{};
+
+    bool m_instancesMatch = true;
+
+    uint64_t m_checksum = 14695981039346656037ull;
+};
+
+enum class Stage
+{
+    UpdateScene,
+    UpdateTransforms,
+    Cull,
+    Sort,
+    WriteInstances,
+    Record,
+    Submit,
+    Total,
+
+    Count
+};
+
+constexpr const char* stageNames[] = {
+    "update_scene",
+    "update_transforms",
+    "cull",
+    "sort",
+    "write_instances",
+    "record",
+    "submit",
+    "total"
+};
+
+static_assert(std::size(stageNames) == static_cast<size_t>(Stage::Count));
+
+json SummarizeTimes(const std::vector<double>& times)
+{
+    double sum = 0.0;
+
+    for (double time : times)
+    {
+        sum += time;
+    }
+
+    return {
+        {"mean_ms", times.empty() ? 0.0 : sum / static_cast<double>(times.size())},
+        {"p50_ms", utils::Percentile(times, 0.5)},
+        {"p95_ms", utils::Percentile(times, 0.95)},
+        {"p99_ms", utils::Percentile(times, 0.99)},
+        {"max_ms", utils::Percentile(times, 1.0)}
+    };
+}
+
+int RunBenchmark(Options options)
+{
+    CameraPath::Type pathType;
+
+    if (!CameraPath::ParseType(options.Path, &pathType))
+    {
+        std::fprintf(stderr, "Unknown camera path %s.\n", options.Path.c_str());
+        return 1;
+    }
+
+    InputManager inputManager;
+    Camera camera(&inputManager);
+
+    std::optional<InputReplayer> inputReplayer;
+
+    if (!options.InputPath.empty())
+    {
+        inputReplayer.emplace(InputRecording::Load(options.InputPath));
+
+        // Every measured frame consumes one recorded frame. Warmup frames keep the camera still.
+        options.NumFrames = static_cast<int>(inputReplayer->GetNumFrames());
+        options.Path = "replay";
+
+        if (options.NumFrames == 0)
+        {
+            std::fprintf(stderr, "Input recording %s is empty.\n", options.InputPath.c_str());
+            return 1;
+        }
+    }
+
+    // The benchmark does its own timing, and scopes from thousands of frames would only fill the
+    // profiler's buffers.
+    Profiler::SetEnabled(false);
+
+    JobSystem jobSystem(options.NumThreads);
+
+    FrameBuilder builder(&jobSystem);
+
+    std::vector<glm::vec3> syntheticPositions;
+
+    if (options.Scene == "sponza")
+    {
+        BuildSponzaScene(options, &builder);
+    }
+    else if (options.Scene == "synthetic")
+    {
+        BuildSyntheticScene(options, &builder, &syntheticPositions);
+    }
+    else
+    {
+        std::fprintf(stderr, "Unknown scene %s.\n", options.Scene.c_str());
+        return 1;
+    }
+
+    size_t numDynamic = static_cast<size_t>(static_cast<float>(syntheticPositions.size()) *
+                                            options.DynamicFraction);
+
+    builder.UpdateTransforms();
+
+    glm::vec3 sceneMin;
+    glm::vec3 sceneMax;
+    builder.GetSceneBounds(&sceneMin, &sceneMax);
+
+    CameraPath path(pathType, sceneMin, sceneMax);
+
+    glm::mat4 projMat = glm::perspective(std::numbers::pi_v<float> / 4.f, 16.f / 9.f, 0.1f,
+                                         1000.f);
+
+    // Room for every object, as in the app's instance buffer.
+    std::vector<InstanceData> instances(builder.GetNumObjects());
+
+    CommandStream stream;
+    NullGraphicsBackend backend;
+    SteadyClock clock;
+
+    // Constructed after the backend so that it is stopped first.
+    std::optional<RenderThread> renderThread;
+
+    if (options.UseRenderThread)
+        renderThread.emplace(&backend, &clock);
+
+    // Replays are simulated in fixed steps and interpolated, as in the app.
+    FixedTimestep timestep(FixedTimestep::DEFAULT_STEP_SEC);
+    CameraState prevCameraState = camera.GetState();
+
+    // Reserved up front, so that only the frames themselves are counted as allocating.
+    std::array<std::vector<double>, static_cast<size_t>(Stage::Count)> stageTimes;
+
+    for (std::vector<double>& times : stageTimes)
+    {
+        times.reserve(static_cast<size_t>(options.NumFrames));
+    }
+
+    std::vector<double> allocationCounts;
+    allocationCounts.reserve(static_cast<size_t>(options.NumFrames));
+
+    AllocationStats measuredAllocations;
+
+    uint64_t numVisible = 0;
+    uint64_t numDraws = 0;
+    uint64_t numInstances = 0;
+    uint64_t numStateChanges = 0;
+
+    int totalFrames = options.NumWarmupFrames + options.NumFrames;
+
+    for (int frame = 0; frame < totalFrames; ++frame)
+    {
+                bool measured = frame >= options.NumWarmupFrames;
+
+        AllocationStats allocationsBefore = AllocationTracker::GetStats();
+
+        Clock::time_point stageStart = Clock::now();
+        Clock::time_point frameStart = stageStart;
+
+        auto endStage = [&](Stage stage) {
+            Clock::time_point now = Clock::now();
+
+            if (measured)
+            {
+                stageTimes[static_cast<size_t>(stage)].push_back(
+                    std::chrono::duration<double, std::milli>(now - stageStart).count());
+            }
+
+            stageStart = now;
+        };
+
+        float t = static_cast<float>(frame % options.NumFrames) /
+            static_cast<float>(options.NumFrames);
+
+        glm::mat4 viewMat;
+
+        if (inputReplayer)
+        {
+            if (measured)
+            {
+                const InputFrame& inputFrame = inputReplayer->NextFrame();
+
+                {
+                    AllocationScope allocationScope(AllocationSubsystem::Input);
+
+                    inputManager.SetFrameEvents(inputFrame.Events);
+                    inputManager.DispatchEvents();
+                }
+
+                AllocationScope allocationScope(AllocationSubsystem::Simulation);
+
+                int numSteps = timestep.Advance(inputFrame.ElapsedSec);
+
+                for (int i = 0; i < numSteps; ++i)
+                {
+                    prevCameraState = camera.GetState();
+                    camera.Tick(timestep.GetStepSec());
+                }
+            }
+
+            viewMat = CameraState::Lerp(prevCameraState, camera.GetState(), timestep.GetAlpha())
+                .GetViewMat();
+        }
+        else
+        {
+            viewMat = path.GetViewMat(t);
+        }
+
+        FrameBuilder::FrameParams params{};
+        params.ViewProjMat = projMat * viewMat;
+        params.Instances = instances.data();
+
+        AllocationScope allocationScope(AllocationSubsystem::FrameBuild);
+
+        // Same packet contents as FrameBuilder::BuildFramePacket(), with the stages timed apart.
+        FramePacket* packet = nullptr;
+
+        if (renderThread)
+        {
+            packet = &renderThread->BeginPacket();
+            packet->FrameIdx = static_cast<uint64_t>(frame);
+            packet->ViewMat = viewMat;
+            packet->ProjMat = projMat;
+            packet->ViewProjMat = params.ViewProjMat;
+            packet->LightPos = glm::vec4(0.f, 10.f, 0.f, 1.f);
+        }
+
+        float angle = static_cast<float>(frame) * 0.01f;
+
+        for (size_t i = 0; i < numDynamic; ++i)
+        {
+            builder.SetTransform(static_cast<uint32_t>(i),
+                                 GetSyntheticTransform(syntheticPositions[i], angle));
+        }
+
+        endStage(Stage::UpdateScene);
+
+        builder.UpdateTransforms();
+        endStage(Stage::UpdateTransforms);
+
+        builder.Cull(params.ViewProjMat);
+        endStage(Stage::Cull);
+
+        builder.Sort();
+        endStage(Stage::Sort);
+
+        stream.Reserve(builder.GetMaxCommands());
+
+        if (packet)
+        {
+            packet->Arena.Reserve(builder.GetMaxPacketSize());
+
+            std::span<InstanceData> packetInstances =
+                packet->Arena.AllocateArray<InstanceData>(builder.GetNumVisibleObjects());
+
+            packet->Instances = packetInstances;
+            params.Instances = packetInstances.data();
+        }
+
+        builder.WriteInstances(params);
+        endStage(Stage::WriteInstances);
+
+        builder.Record(&stream);
+        endStage(Stage::Record);
+
+        if (packet)
+        {
+            packet->Commands = packet->Arena.CopyArray<Command>(stream.GetCommands());
+            packet->NumDraws = stream.GetNumDraws();
+            packet->NumInstances = stream.GetNumInstances();
+            packet->NumStateChanges = stream.GetNumStateChanges();
+            packet->NumTriangles = stream.GetNumTriangles();
+
+            renderThread->SubmitPacket();
+        }
+        else
+        {
+            backend.Submit(stream.GetCommands(),
+                           std::span(instances.data(), builder.GetNumVisibleObjects()));
+        }
+
+        endStage(Stage::Submit);
+
+        FrameArena::EndThreadFrame();
+
+        if (measured)
+        {
+            stageTimes[static_cast<size_t>(Stage::Total)].push_back(
+                std::chrono::duration<double, std::milli>(stageStart - frameStart).count());
+
+            AllocationStats frameAllocations =
+                AllocationTracker::GetStats().Since(allocationsBefore);
+
+            allocationCounts.push_back(static_cast<double>(frameAllocations.GetTotalCount()));
+
+            for (size_t i = 0; i < AllocationStats::NUM_SUBSYSTEMS; ++i)
+            {
+                measuredAllocations.Counts[i] += frameAllocations.Counts[i];
+                measuredAllocations.Bytes[i] += frameAllocations.Bytes[i];
+            }
+
+            numVisible += builder.GetNumVisibleObjects();
+            numDraws += stream.GetNumDraws();
+            numInstances += stream.GetNumInstances();
+            numStateChanges += stream.GetNumStateChanges();
+        }
+    }
+
+    json renderThreadResults = nullptr;
+
+    if (renderThread)
+    {
+        renderThread->Stop();
+
+        renderThreadResults = {
+            {"submitted_packets", renderThread->GetNumSubmittedPackets()},
+            {"rendered_packets", renderThread->GetNumRenderedPackets()},
+            {"skipped_packets", renderThread->GetNumSkippedPackets()}
+        };
+    }
+
+    json stages = json::object();
+
+    for (size_t i = 0; i < static_cast<size_t>(Stage::Count); ++i)
+    {
+        stages[stageNames[i]] = SummarizeTimes(stageTimes[i]);
+    }
+
+    auto totalAllocations = static_cast<double>(measuredAllocations.GetTotalCount());
+
+    json subsystemAllocations = json::object();
+
+    for (size_t i = 0; i < AllocationStats::NUM_SUBSYSTEMS; ++i)
+    {
+        auto subsystem = static_cast<AllocationSubsystem>(i);
+
+        subsystemAllocations[AllocationTracker::GetSubsystemName(subsystem)] = {
+            {"count", measuredAllocations.Counts[i]},
+            {"bytes", measuredAllocations.Bytes[i]}
+        };
+    }
+
+    double numFrames = static_cast<double>(options.NumFrames);
+
+    json results = {
+        {"scene", options.Scene},
+        {"path", options.Path},
+        {"frames", options.NumFrames},
+        {"warmup_frames", options.NumWarmupFrames},
+        {"threads", jobSystem.GetThreadCount()},
+        {"objects", builder.GetNumObjects()},
+        {"transforms", builder.GetNumTransforms()},
+        {"stages", stages},
+        {"allocations", {
+            {"total", totalAllocations},
+            {"per_frame_mean", totalAllocations / numFrames},
+            {"per_frame_max", utils::Percentile(allocationCounts, 1.0)},
+            {"bytes", measuredAllocations.GetTotalBytes()},
+            {"subsystems", subsystemAllocations}
+        }},
+        {"visible_objects_mean", static_cast<double>(numVisible) / numFrames},
+        {"draws_mean", static_cast<double>(numDraws) / numFrames},
+        {"instances_per_draw",
+         numDraws ? static_cast<double>(numInstances) / static_cast<double>(numDraws) : 0.0},
+        {"state_changes_mean", static_cast<double>(numStateChanges) / numFrames},
+        {"render_thread", renderThreadResults},
+        {"instances_match", backend.InstancesMatch()},
+        {"checksum", backend.GetChecksum()}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s, %s path, %zu objects, %d threads, %d frames\n", options.Scene.c_str(),
+                options.Path.c_str(), builder.GetNumObjects(), jobSystem.GetThreadCount(),
+                options.NumFrames);
+
+    std::printf("%-18s %10s %10s %10s %10s\n", "stage", "mean ms", "p50 ms", "p95 ms", "p99 ms");
+
+    for (size_t i = 0; i < static_cast<size_t>(Stage::Count); ++i)
+    {
+        const json& stage = stages[stageNames[i]];
+
+        std::printf("%-18s %10.4f %10.4f %10.4f %10.4f\n", stageNames[i],
+                    stage["mean_ms"].get<double>(), stage["p50_ms"].get<double>(),
+                    stage["p95_ms"].get<double>(), stage["p99_ms"].get<double>());
+    }
+
+    std::printf("allocations/frame  %.2f (max %.0f)\n", totalAllocations / numFrames,
+                utils::Percentile(allocationCounts, 1.0));
+
+    for (size_t i = 0; i < AllocationStats::NUM_SUBSYSTEMS; ++i)
+    {
+        if (measuredAllocations.Counts[i] == 0)
+            continue;
+
+        std::printf("  %-16s %llu allocations, %llu bytes\n",
+                    AllocationTracker::GetSubsystemName(static_cast<AllocationSubsystem>(i)),
+                    static_cast<unsigned long long>(measuredAllocations.Counts[i]),
+                    static_cast<unsigned long long>(measuredAllocations.Bytes[i]));
+    }
+
+    if (renderThread)
+    {
+        std::printf("render thread      %llu submitted, %llu rendered, %llu skipped\n",
+                    static_cast<unsigned long long>(renderThread->GetNumSubmittedPackets()),
+                    static_cast<unsigned long long>(renderThread->GetNumRenderedPackets()),
+                    static_cast<unsigned long long>(renderThread->GetNumSkippedPackets()));
+    }
+
+    std::printf("results written to %s\n", options.OutPath.c_str());
+
+    if (!backend.InstancesMatch())
+    {
+        std::fprintf(stderr, "Draws did not consume exactly the instances written.\n");
+        return 1;
+    }
+
+    if (options.RequireZeroAllocations && measuredAllocations.GetTotalCount() > 0)
+    {
+        std::fprintf(stderr, "Measured frames made %llu heap allocations.\n",
+                     static_cast<unsigned long long>(measuredAllocations.GetTotalCount()));
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
@@ -0,0 +1,305 @@
+#include "FrameBuilder.h"
+
+#include "FrameArena.h"
+#include "FramePacket.h"
+#include "Frustum.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+
+// Objects are processed in batches of at least this many per job.
+constexpr size_t minObjectsPerJob = 256;
+
+// Texture changes are the most expensive to re-bind (descriptor table), so batches are ordered by
+// texture first and then by geometry.
+uint64_t MakeBatchKey(const RenderObject& object)
+{
+    uint64_t textureBits = static_cast<uint32_t>(object.BaseColorTextureId + 1);
+
+    return (textureBits << 32) | object.GeometryIdx;
+}
+
+} // namespace
+
+FrameBuilder::FrameBuilder(JobSystem* jobSystem)
+    : m_jobSystem(jobSystem)
+{
+}
+
+uint32_t FrameBuilder::AddTransform(const glm::mat4& worldMat)
+{
+    m_transforms.push_back(worldMat);
+    m_transformDirty.push_back(true);
+
+    return static_cast<uint32_t>(m_transforms.size() - 1);
+}
+
+void FrameBuilder::SetTransform(uint32_t idx, const glm::mat4& worldMat)
+{
+    m_transforms[idx] = worldMat;
+    m_transformDirty[idx] = true;
+}
+
+uint32_t FrameBuilder::AddObject(const RenderObject& object)
+{
+    assert(object.TransformIdx < m_transforms.size());
+
+    m_objects.push_back(object);
+    m_objectBatches.push_back(0);
+    m_batchesDirty = true;
+
+    m_worldBoundsMin.push_back(object.LocalBoundsMin);
+    m_worldBoundsMax.push_back(object.LocalBoundsMax);
+
+    m_visible.push_back(false);
+
+    m_transformDirty[object.TransformIdx] = true;
+
+    return static_cast<uint32_t>(m_objects.size() - 1);
+}
+
+void FrameBuilder::Clear()
+{
+    m_transforms.clear();
+    m_transformDirty.clear();
+    m_objects.clear();
+    m_objectBatches.clear();
+    m_numBatches = 0;
+    m_batchesDirty = false;
+    m_worldBoundsMin.clear();
+    m_worldBoundsMax.clear();
+    m_visible.clear();
+    m_drawKeys.clear();
+}
+
+void FrameBuilder::BuildFrame(const FrameParams& params, CommandStream* stream)
+{
+    PROFILE_SCOPE("FrameBuilder::BuildFrame");
+
+    UpdateTransforms();
+
+    Cull(params.ViewProjMat);
+
+    Sort();
+
+    WriteInstances(params);
+
+    Record(stream);
+}
+
+void FrameBuilder::BuildFramePacket(FramePacket* packet)
+{
+    PROFILE_SCOPE("FrameBuilder::BuildFramePacket");
+
+    UpdateTransforms();
+
+    Cull(packet->ViewProjMat);
+
+    Sort();
+
+    // Sized for every object being visible, so that neither grows again until objects are added,
+    // whatever is in view in the frames that follow.
+    m_packetStream.Reserve(GetMaxCommands());
+    packet->Arena.Reserve(GetMaxPacketSize());
+
+    // Sized once the visible objects are known.
+    std::span<InstanceData> instances =
+        packet->Arena.AllocateArray<InstanceData>(m_drawKeys.size());
+
+    FrameParams params{};
+    params.ViewProjMat = packet->ViewProjMat;
+    params.Instances = instances.data();
+
+    WriteInstances(params);
+
+    Record(&m_packetStream);
+
+    packet->Instances = instances;
+    packet->Commands = packet->Arena.CopyArray<Command>(m_packetStream.GetCommands());
+
+    packet->NumDraws = m_packetStream.GetNumDraws();
+    packet->NumInstances = m_packetStream.GetNumInstances();
+    packet->NumStateChanges = m_packetStream.GetNumStateChanges();
+    packet->NumTriangles = m_packetStream.GetNumTriangles();
+}
+
+void FrameBuilder::UpdateTransforms()
+{
+    PROFILE_SCOPE("FrameBuilder::UpdateTransforms");
+
+    m_jobSystem->ParallelFor(m_objects.size(), [this](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const RenderObject& object = m_objects[i];
+
+            if (!m_transformDirty[object.TransformIdx])
+                continue;
+
+            TransformAabb(m_transforms[object.TransformIdx], object.LocalBoundsMin,
+                          object.LocalBoundsMax, &m_worldBoundsMin[i], &m_worldBoundsMax[i]);
+        }
+    }, minObjectsPerJob);
+
+    std::fill(m_transformDirty.begin(), m_transformDirty.end(), uint8_t{0});
+}
+
+void FrameBuilder::Cull(const glm::mat4& viewProjMat)
+{
+    PROFILE_SCOPE("FrameBuilder::Cull");
+
+    Frustum frustum = Frustum::FromViewProj(viewProjMat);
+
+    m_jobSystem->ParallelFor(m_objects.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            m_visible[i] = frustum.IntersectsAabb(m_worldBoundsMin[i], m_worldBoundsMax[i]);
+        }
+    }, minObjectsPerJob);
+}
+
+void FrameBuilder::Sort()
+{
+    PROFILE_SCOPE("FrameBuilder::Sort");
+
+    if (m_batchesDirty)
+        UpdateBatches();
+
+    m_drawKeys.clear();
+
+    for (uint32_t i = 0; i < m_objects.size(); ++i)
+    {
+        if (m_visible[i])
+            m_drawKeys.push_back((static_cast<uint64_t>(m_objectBatches[i]) << 32) | i);
+    }
+
+    std::sort(m_drawKeys.begin(), m_drawKeys.end());
+}
+
+void FrameBuilder::WriteInstances(const FrameParams& params)
+{
+    PROFILE_SCOPE("FrameBuilder::WriteInstances");
+
+    m_jobSystem->ParallelFor(m_drawKeys.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const RenderObject& object = m_objects[static_cast<uint32_t>(m_drawKeys[i])];
+
+            InstanceData instance{};
+            instance.WorldViewProjMat = params.ViewProjMat * m_transforms[object.TransformIdx];
+            instance.MaterialIdx = object.MaterialIdx;
+
+            // The destination may be write-combined upload memory, so write it in one go.
+            memcpy(params.Instances + i, &instance, sizeof(instance));
+        }
+    }, minObjectsPerJob);
+}
+
+void FrameBuilder::Record(CommandStream* stream)
+{
+    PROFILE_SCOPE("FrameBuilder::Record");
+
+    stream->Reset();
+
+    size_t first = 0;
+
+    while (first < m_drawKeys.size())
+    {
+        uint64_t batch = m_drawKeys[first] >> 32;
+        size_t end = first + 1;
+
+        while (end < m_drawKeys.size() && (m_drawKeys[end] >> 32) == batch)
+        {
+            ++end;
+        }
+
+        const RenderObject& object = m_objects[static_cast<uint32_t>(m_drawKeys[first])];
+
+        stream->SetBaseColorTexture(static_cast<uint32_t>(object.BaseColorTextureId));
+        stream->SetGeometry(object.GeometryIdx);
+        stream->DrawIndexed(object.IndexCount, static_cast<uint32_t>(end - first));
+
+        first = end;
+    }
+
+    PROFILE_COUNTER(ProfileCounter::DrawCalls, stream->GetNumDraws());
+    PROFILE_COUNTER(ProfileCounter::StateChanges, stream->GetNumStateChanges());
+    PROFILE_COUNTER(ProfileCounter::Triangles, static_cast<int64_t>(stream->GetNumTriangles()));
+}
+
+void FrameBuilder::UpdateBatches()
+{
+    PROFILE_SCOPE("FrameBuilder::UpdateBatches");
+
+    FrameVector<uint64_t> batchKeys(m_objects.size());
+
+    for (size_t i = 0; i < m_objects.size(); ++i)
+    {
+        batchKeys[i] = MakeBatchKey(m_objects[i]);
+    }
+
+    FrameVector<uint64_t> sortedKeys = batchKeys;
+    std::sort(sortedKeys.begin(), sortedKeys.end());
+    sortedKeys.erase(std::unique(sortedKeys.begin(), sortedKeys.end()), sortedKeys.end());
+
+    for (size_t i = 0; i < m_objects.size(); ++i)
+    {
+        auto it = std::lower_bound(sortedKeys.begin(), sortedKeys.end(), batchKeys[i]);
+        m_objectBatches[i] = static_cast<uint32_t>(it - sortedKeys.begin());
+    }
+
+    m_numBatches = sortedKeys.size();
+    m_batchesDirty = false;
+
+    // Room for every object to be visible, so that sorting never reallocates.
+    m_drawKeys.reserve(m_objects.size());
+}
+
+size_t FrameBuilder::GetNumObjects() const
+{
+    return m_objects.size();
+}
+
+size_t FrameBuilder::GetNumTransforms() const
+{
+    return m_transforms.size();
+}
+
+size_t FrameBuilder::GetNumVisibleObjects() const
+{
+    return m_drawKeys.size();
+}
+
+size_t FrameBuilder::GetMaxCommands() const
+{
+    return m_numBatches * CommandStream::MAX_COMMANDS_PER_DRAW;
+}
+
+size_t FrameBuilder::GetMaxPacketSize() const
+{
+    // Each array may need padding to its alignment.
+    return m_objects.size() * sizeof(InstanceData) + alignof(InstanceData) +
+        GetMaxCommands() * sizeof(Command) + alignof(Command);
+}
+
+void FrameBuilder::GetSceneBounds(glm::vec3* boundsMin, glm::vec3* boundsMax) const
+{
+    *boundsMin = glm::vec3(0.f);
+    *boundsMax = glm::vec3(0.f);
+
+    if (m_objects.empty())
+        return;
+
+    *boundsMin = m_worldBoundsMin[0];
+    *boundsMax = m_worldBoundsMax[0];
+
+    for (size_t i = 1; i < m_objects.size(); ++i)
+    {
+        *boundsMin = glm::min(*boundsMin, m_worldBoundsMin[i]);
+        *boundsMax = glm::max(*boundsMax, m_worldBoundsMax[i]);
+    }
+}
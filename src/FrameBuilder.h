@@ -0,0 +1,130 @@
+#pragma once
+
+#include "CommandStream.h"
+#include "JobSystem.h"
+#include "ModelData.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-instance vertex data. Matches the instance inputs in Shader.hlsl.
+struct InstanceData
+{
+    glm::mat4 WorldViewProjMat;
+
+    // Index into the backend's material table.
+    uint32_t MaterialIdx = 0;
+};
+
+struct FramePacket;
+
+// One drawable primitive placed in the world.
+struct RenderObject
+{
+    // Index into the backend's geometry table. Objects with the same geometry must have the same
+    // IndexCount.
+    uint32_t GeometryIdx = 0;
+
+    uint32_t MaterialIdx = 0;
+
+    // Passed on to the backend as is. The app gives materials without a texture its default one.
+    TextureId BaseColorTextureId = -1;
+
+    uint32_t IndexCount = 0;
+
+    // Index of the transform the object is drawn with.
+    uint32_t TransformIdx = 0;
+
+    glm::vec3 LocalBoundsMin = glm::vec3(0.f);
+    glm::vec3 LocalBoundsMax = glm::vec3(0.f);
+};
+
+// CPU side of a frame, independent of the graphics API: updates world bounds, culls against the
+// view frustum, sorts visible objects into batches, writes their instance data and records a
+// CommandStream with one instanced draw per batch. Each stage is exposed so it can be timed on its
+// own.
+//
+// Objects that share geometry and base color texture form a batch. Materials are read per
+// instance, so they do not split batches.
+class FrameBuilder
+{
+public:
+    explicit FrameBuilder(JobSystem* jobSystem);
+
+    uint32_t AddTransform(const glm::mat4& worldMat);
+    void SetTransform(uint32_t idx, const glm::mat4& worldMat);
+
+    uint32_t AddObject(const RenderObject& object);
+
+    void Clear();
+
+    struct FrameParams
+    {
+        glm::mat4 ViewProjMat;
+
+        // Destination for one InstanceData per visible object, in draw order.
+        InstanceData* Instances = nullptr;
+    };
+
+    // Runs every stage below in order. |params.Instances| must have room for every object.
+    void BuildFrame(const FrameParams& params, CommandStream* stream);
+
+    // Runs every stage, writing the instance data and commands into |packet|'s arena. The packet's
+    // matrices must already be set.
+    void BuildFramePacket(FramePacket* packet);
+
+    void UpdateTransforms();
+
+    void Cull(const glm::mat4& viewProjMat);
+
+    void Sort();
+
+    // Writes GetNumVisibleObjects() instances, valid after Sort().
+    void WriteInstances(const FrameParams& params);
+
+    void Record(CommandStream* stream);
+
+    size_t GetNumObjects() const;
+    size_t GetNumTransforms() const;
+
+    size_t GetNumVisibleObjects() const;
+
+    // The most commands Record() can produce and the most a frame packet's arena can need, with
+    // every object visible. Valid after Sort().
+    size_t GetMaxCommands() const;
+    size_t GetMaxPacketSize() const;
+
+    // World-space bounds of every object, valid after UpdateTransforms().
+    void GetSceneBounds(glm::vec3* boundsMin, glm::vec3* boundsMax) const;
+
+private:
+    // Numbers the distinct (texture, geometry) pairs in sorted order and assigns each object the
+    // number of its pair.
+    void UpdateBatches();
+
+    JobSystem* m_jobSystem;
+
+    std::vector<glm::mat4> m_transforms;
+    std::vector<uint8_t> m_transformDirty;
+
+    std::vector<RenderObject> m_objects;
+
+    // Batch of each object, numbered in draw order. Renumbered when objects are added.
+    std::vector<uint32_t> m_objectBatches;
+    size_t m_numBatches = 0;
+    bool m_batchesDirty = false;
+
+    std::vector<glm::vec3> m_worldBoundsMin;
+    std::vector<glm::vec3> m_worldBoundsMax;
+
+    std::vector<uint8_t> m_visible;
+
+    // Sort keys of the visible objects: the batch in the high bits, the object index in the low.
+    std::vector<uint64_t> m_drawKeys;
+
+    // Recording target for BuildFramePacket().
+    CommandStream m_packetStream;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Hands the latest value from one producer thread to one consumer thread through three slots.
+// The producer writes its slot and publishes it without ever blocking, replacing any published
+// value the consumer has not taken yet. The consumer always gets the most recent value, and a slot
+// it holds is never written until it acquires another.
+template<typename T>
+class FrameMailbox
+{
+public:
+    // Producer only. The slot to fill before Publish().
+    T& GetWriteSlot()
+    {
+        return m_slots[m_writeIdx];
+    }
+
+    // Producer only. Returns true if the previously published value was never acquired.
+    bool Publish()
+    {
+        uint32_t prev = m_state.load(std::memory_order_relaxed);
+        uint32_t next;
+
+        do
+        {
+            next = m_writeIdx | FRESH_BIT | (prev & CLOSED_BIT);
+        } while (!m_state.compare_exchange_weak(prev, next, std::memory_order_acq_rel,
+                                                std::memory_order_relaxed));
+
+        m_writeIdx = prev & INDEX_MASK;
+
+        m_state.notify_one();
+
+        return (prev & FRESH_BIT) != 0;
+    }
+
+    // Consumer only. Returns the newest published value, or nullptr if nothing was published since
+    // the last call. The returned value stays valid until the next acquire.
+    const T* TryAcquire()
+    {
+        uint32_t state = m_state.load(std::memory_order_relaxed);
+
+        if ((state & FRESH_BIT) == 0)
+            return nullptr;
+
+        return Swap(state);
+    }
+
+    // Consumer only. Blocks until a new value is published, returning nullptr once the mailbox is
+    // closed and drained.
+    const T* WaitAcquire()
+    {
+        for (;;)
+        {
+            uint32_t state = m_state.load(std::memory_order_acquire);
+
+            if (state & FRESH_BIT)
+                return Swap(state);
+
+            if (state & CLOSED_BIT)
+                return nullptr;
+
+            m_state.wait(state, std::memory_order_acquire);
+        }
+    }
+
+    // Wakes the consumer for good. Values published before closing are still delivered.
+    void Close()
+    {
+        m_state.fetch_or(CLOSED_BIT, std::memory_order_release);
+        m_state.notify_one();
+    }
+
+private:
+    static constexpr uint32_t INDEX_MASK = 0x3;
+    static constexpr uint32_t FRESH_BIT = 0x4;
+    static constexpr uint32_t CLOSED_BIT = 0x8;
+
+    const T* Swap(uint32_t state)
+    {
+        uint32_t next;
+
+        do
+        {
+            next = m_readIdx | (state & CLOSED_BIT);
+        } while (!m_state.compare_exchange_weak(state, next, std::memory_order_acq_rel,
+                                                std::memory_order_relaxed));
+
+        m_readIdx = state & INDEX_MASK;
+
+        return &m_slots[m_readIdx];
+    }
+
+    T m_slots[3];
+
+    // Slot owned by each side. The third slot's index lives in m_state.
+    uint32_t m_writeIdx = 0;
+    uint32_t m_readIdx = 1;
+
+    std::atomic<uint32_t> m_state = 2;
+};
@@ -0,0 +1,214 @@
+#include "FramePacer.h"
+
+#include "Utils.h"
+
+#include <algorithm>
+#include <span>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+// Upper bound for the spin window - beyond this a sleep that overshoots is a scheduling hiccup
+// rather than timer granularity, and spinning for it would waste a core.
+constexpr Clock::Duration maxSpinWindow = 2ms;
+
+double ToSeconds(Clock::Duration duration)
+{
+    return std::chrono::duration<double>(duration).count();
+}
+
+} // namespace
+
+FramePacer::FramePacer(Clock* clock, double targetRateHz)
+    : m_clock(clock), m_spinWindow(1ms)
+{
+    SetTargetRate(targetRateHz);
+
+    m_history.reserve(HISTORY_SIZE);
+    m_workTimes.resize(HISTORY_SIZE);
+}
+
+void FramePacer::SetTargetRate(double targetRateHz)
+{
+    m_period = std::chrono::duration_cast<Clock::Duration>(
+        std::chrono::duration<double>(1.0 / targetRateHz));
+}
+
+double FramePacer::BeginFrame()
+{
+    if (!m_hasStarted)
+    {
+        m_hasStarted = true;
+        m_frameStart = m_clock->Now();
+        m_deadline = m_frameStart + PredictWorkTime();
+
+        return 0.0;
+    }
+
+    m_deadline += m_period;
+
+    Clock::TimePoint startTime = m_deadline - PredictWorkTime();
+
+    Clock::TimePoint now = m_clock->Now();
+
+    if (now < startTime)
+    {
+        WaitUntil(startTime);
+        now = m_clock->Now();
+    }
+    else if (now > m_deadline)
+    {
+        // Fell behind by more than a frame. Re-anchor rather than trying to catch up with a burst
+        // of unpaced frames.
+        m_deadline = now + PredictWorkTime();
+    }
+
+    double elapsedSec = ToSeconds(now - m_frameStart);
+
+    if (!m_history.empty())
+    {
+        size_t prevPos = (m_historyPos + HISTORY_SIZE - 1) % HISTORY_SIZE;
+        m_history[prevPos].FrameTime = elapsedSec;
+    }
+
+    m_frameStart = now;
+
+    return elapsedSec;
+}
+
+uint64_t FramePacer::GetFrameIdx() const
+{
+    return m_numFrames;
+}
+
+void FramePacer::EndFrame()
+{
+    Clock::TimePoint now = m_clock->Now();
+
+    FrameRecord record{};
+    record.WorkTime = ToSeconds(now - m_frameStart);
+    record.Start = m_frameStart;
+    record.Deadline = m_deadline;
+    record.Missed = now > m_deadline;
+
+    if (record.Missed)
+        ++m_missedFrames;
+
+    // The frame time is measured start to start, so it is filled in when the next frame begins.
+    // Until then use the target period as the best estimate.
+    record.FrameTime = std::max(record.WorkTime, ToSeconds(m_period));
+
+    if (m_history.size() < HISTORY_SIZE)
+    {
+        m_history.push_back(record);
+    }
+    else
+    {
+        m_history[m_historyPos] = record;
+    }
+
+    m_historyPos = (m_historyPos + 1) % HISTORY_SIZE;
+    ++m_numFrames;
+}
+
+void FramePacer::FramePresented(uint64_t frameIdx, Clock::TimePoint presentTime)
+{
+    if (frameIdx >= m_numFrames || m_numFrames - frameIdx > m_history.size())
+        return;
+
+    // Frames fill the history in order, so a frame's record is at its index.
+    FrameRecord& record = m_history[frameIdx % HISTORY_SIZE];
+
+    record.WorkTime = std::max(record.WorkTime, ToSeconds(presentTime - record.Start));
+
+    if (presentTime > record.Deadline && !record.Missed)
+    {
+        record.Missed = true;
+        ++m_missedFrames;
+    }
+}
+
+void FramePacer::WaitUntil(Clock::TimePoint deadline)
+{
+    Clock::TimePoint now = m_clock->Now();
+
+    if (deadline - now > m_spinWindow)
+    {
+        Clock::Duration sleepTime = deadline - now - m_spinWindow;
+
+        m_clock->SleepFor(sleepTime);
+
+        Clock::TimePoint wakeTime = m_clock->Now();
+        Clock::Duration overshoot = (wakeTime - now) - sleepTime;
+
+        // Grow quickly when the OS oversleeps and shrink slowly, so an occasional late wakeup
+        // widens the spin window for a while.
+        if (overshoot > m_spinWindow)
+        {
+            m_spinWindow = std::min(overshoot, maxSpinWindow);
+        }
+        else
+        {
+            m_spinWindow = std::max<Clock::Duration>(m_spinWindow - m_spinWindow / 64,
+                                                     overshoot + 100us);
+        }
+
+        now = wakeTime;
+    }
+
+    while (now < deadline)
+    {
+        now = m_clock->Now();
+    }
+}
+
+Clock::Duration FramePacer::PredictWorkTime()
+{
+    if (m_history.empty())
+        return WORK_SAFETY_MARGIN;
+
+    for (size_t i = 0; i < m_history.size(); ++i)
+    {
+        m_workTimes[i] = m_history[i].WorkTime;
+    }
+
+    // Plan for a slow-but-typical frame rather than the average so that few frames miss.
+    double predicted = utils::PercentileInPlace(
+        std::span<double>(m_workTimes.data(), m_history.size()), 0.95);
+
+    Clock::Duration predictedWork = std::chrono::duration_cast<Clock::Duration>(
+        std::chrono::duration<double>(predicted));
+
+    // Presenting on another thread overlaps building the next frame, so a frame's work may take
+    // longer than a period without lowering the frame rate - but not two, as the render thread
+    // has only one frame queued.
+    return std::min(predictedWork + WORK_SAFETY_MARGIN, 2 * m_period);
+}
+
+FramePacer::Stats FramePacer::GetStats() const
+{
+    std::vector<double> frameTimes;
+    std::vector<double> workTimes;
+
+    frameTimes.reserve(m_history.size());
+    workTimes.reserve(m_history.size());
+
+    for (const auto& record : m_history)
+    {
+        frameTimes.push_back(record.FrameTime);
+        workTimes.push_back(record.WorkTime);
+    }
+
+    Stats stats{};
+    stats.FrameTimeP50 = utils::Percentile(frameTimes, 0.50);
+    stats.FrameTimeP95 = utils::Percentile(frameTimes, 0.95);
+    stats.FrameTimeP99 = utils::Percentile(frameTimes, 0.99);
+    stats.WorkTimeP50 = utils::Percentile(workTimes, 0.50);
+    stats.WorkTimeP95 = utils::Percentile(workTimes, 0.95);
+    stats.WorkTimeP99 = utils::Percentile(workTimes, 0.99);
+    stats.MissedFrames = m_missedFrames;
+
+    return stats;
+}
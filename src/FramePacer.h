@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Clock.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Caps the frame rate while keeping input-to-present latency low. Instead of sleeping after a
+// frame, the pacer delays the start of the next frame so that its work finishes just before the
+// target present time. A frame's work runs to EndFrame(), or to its present when that happens on
+// another thread and is reported with FramePresented(). Waits sleep for the bulk of the interval
+// and spin for the remainder, with the spin window sized from observed sleep overshoot.
+class FramePacer
+{
+public:
+    FramePacer(Clock* clock, double targetRateHz);
+
+    void SetTargetRate(double targetRateHz);
+
+    // Waits until the next frame should start. Returns the seconds elapsed since the previous
+    // frame started.
+    double BeginFrame();
+
+    // Index of the current frame, counting from zero.
+    uint64_t GetFrameIdx() const;
+
+    // Marks the end of the frame's work on the calling thread, including any wait on the GPU.
+    void EndFrame();
+
+    // Marks when frame |frameIdx| was presented, any wait on the GPU included, for frames that
+    // are presented on another thread after EndFrame(). Frames that have dropped out of the
+    // history are ignored.
+    void FramePresented(uint64_t frameIdx, Clock::TimePoint presentTime);
+
+    struct Stats
+    {
+        double FrameTimeP50 = 0.0;
+        double FrameTimeP95 = 0.0;
+        double FrameTimeP99 = 0.0;
+
+        double WorkTimeP50 = 0.0;
+        double WorkTimeP95 = 0.0;
+        double WorkTimeP99 = 0.0;
+
+        // Frames that finished their work, or were presented, after the target present time. Unlike
+        // the percentiles, a total over every frame since the pacer was created.
+        size_t MissedFrames = 0;
+    };
+
+    // Percentiles over the most recent HISTORY_SIZE frames, in seconds, and the missed frame
+    // total.
+    Stats GetStats() const;
+
+    static constexpr size_t HISTORY_SIZE = 512;
+
+    // Slack added to the predicted work time so small variations do not miss the deadline.
+    static constexpr Clock::Duration WORK_SAFETY_MARGIN = std::chrono::microseconds(500);
+
+private:
+    void WaitUntil(Clock::TimePoint deadline);
+
+    Clock::Duration PredictWorkTime();
+
+    Clock* m_clock;
+
+    Clock::Duration m_period{};
+
+    // Present time the current frame is targeting.
+    Clock::TimePoint m_deadline{};
+
+    Clock::TimePoint m_frameStart{};
+    bool m_hasStarted = false;
+
+    // How much earlier than the deadline to stop sleeping and start spinning.
+    Clock::Duration m_spinWindow{};
+
+    struct FrameRecord
+    {
+        double FrameTime = 0.0;
+        double WorkTime = 0.0;
+
+        Clock::TimePoint Start{};
+        Clock::TimePoint Deadline{};
+        bool Missed = false;
+    };
+
+    std::vector<FrameRecord> m_history;
+    size_t m_historyPos = 0;
+
+    // Frames that have ended, so also the index of the current one.
+    uint64_t m_numFrames = 0;
+
+    // Scratch for PredictWorkTime(), sized for the whole history up front so that pacing a frame
+    // never allocates.
+    std::vector<double> m_workTimes;
+
+    // Since construction, not just over the history.
+    size_t m_missedFrames = 0;
+};
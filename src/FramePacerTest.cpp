@@ -0,0 +1,392 @@
+// Deterministic test for the frame pacer. Drives BeginFrame() and EndFrame() with a scripted
+// clock, on which the test decides how long each frame's work and each sleep take, and checks
+// when the pacer starts each frame: ahead of its deadline by the 95th percentile of recent work
+// times plus the safety margin, a period apart, unmoved by rare slow frames and by oversleeping,
+// and re-anchored rather than bursting after a stall. Frames presented later, as on a render
+// thread, are planned to their presents. Also checks the reported percentiles and that pacing a
+// frame does not allocate. Exits with an error if any check fails.
+
+#include "AllocationTracker.h"
+#include "BenchmarkUtils.h"
+#include "Clock.h"
+#include "FramePacer.h"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using namespace std::chrono_literals;
+
+struct Options
+{
+    std::string OutPath = "frame_pacer_test_results.json";
+};
+
+constexpr const char* USAGE =
+    "Usage: FramePacerTest [options]\n"
+    "  --out FILE   Results file (default frame_pacer_test_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    return benchmark::ParseArgs(argc, argv, parseOption);
+}
+
+// Time moves only when the test says so: by the work it scripts, by sleeps, which take as long as
+// asked plus |Oversleep|, and by a tick per reading, so that the pacer's spin loop ends.
+class ScriptedClock : public Clock
+{
+public:
+    static constexpr Duration READ_TICK = 1us;
+
+    TimePoint Now() override
+    {
+        m_now += READ_TICK;
+        return m_now;
+    }
+
+    void SleepFor(Duration duration) override
+    {
+        m_now += duration + Oversleep;
+    }
+
+    void Advance(Duration duration)
+    {
+        m_now += duration;
+    }
+
+    // The time of the last reading, without taking another.
+    TimePoint Peek() const
+    {
+        return m_now;
+    }
+
+    Duration Oversleep{};
+
+private:
+    TimePoint m_now = 1s;
+};
+
+constexpr double TARGET_RATE_HZ = 60.0;
+
+const Clock::Duration PERIOD = std::chrono::duration_cast<Clock::Duration>(
+    std::chrono::duration<double>(1.0 / TARGET_RATE_HZ));
+
+// Covers the clock's ticks, which the pacer sees as a few microseconds of extra work or waiting.
+constexpr Clock::Duration TOLERANCE = 20us;
+
+constexpr int NUM_FRAMES = 600;
+
+bool IsNear(Clock::Duration value, Clock::Duration expected)
+{
+    return value - expected <= TOLERANCE && expected - value <= TOLERANCE;
+}
+
+bool IsNear(double seconds, Clock::Duration expected)
+{
+    return IsNear(std::chrono::duration_cast<Clock::Duration>(
+                      std::chrono::duration<double>(seconds)),
+                  expected);
+}
+
+double ToMs(Clock::Duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// Paces |numFrames| frames, the i-th of which works for |workTime(i)|, and returns when each
+// started.
+template<typename WorkTime>
+std::vector<Clock::TimePoint> RunFrames(FramePacer* pacer, ScriptedClock* clock, int numFrames,
+                                        WorkTime workTime)
+{
+    std::vector<Clock::TimePoint> starts;
+    starts.reserve(static_cast<size_t>(numFrames));
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+        pacer->BeginFrame();
+        starts.push_back(clock->Peek());
+
+        clock->Advance(workTime(i));
+        pacer->EndFrame();
+    }
+
+    return starts;
+}
+
+// Paces |numFrames| frames that are built in |buildTime| and presented |presentDelay| later, as
+// on a render thread. Each present is reported at the end of the next frame, as the main loop
+// picks it up. Returns when each frame started.
+std::vector<Clock::TimePoint> RunPresentedFrames(FramePacer* pacer, ScriptedClock* clock,
+                                                 int numFrames, Clock::Duration buildTime,
+                                                 Clock::Duration presentDelay)
+{
+    std::vector<Clock::TimePoint> starts;
+    starts.reserve(static_cast<size_t>(numFrames));
+
+    Clock::TimePoint prevPresentTime{};
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+        pacer->BeginFrame();
+        starts.push_back(clock->Peek());
+
+        uint64_t frameIdx = pacer->GetFrameIdx();
+
+        clock->Advance(buildTime);
+        pacer->EndFrame();
+
+        if (frameIdx > 0)
+            pacer->FramePresented(frameIdx - 1, prevPresentTime);
+
+        prevPresentTime = clock->Peek() + presentDelay;
+    }
+
+    return starts;
+}
+
+// How long before its deadline each frame started. The first frame's deadline is the safety
+// margin after it starts, and the deadlines that follow are a period apart until the pacer
+// re-anchors.
+std::vector<Clock::Duration> GetLeads(const std::vector<Clock::TimePoint>& starts)
+{
+    std::vector<Clock::Duration> leads;
+    Clock::TimePoint deadline = starts.front() + FramePacer::WORK_SAFETY_MARGIN;
+
+    for (Clock::TimePoint start : starts)
+    {
+        leads.push_back(deadline - start);
+        deadline += PERIOD;
+    }
+
+    return leads;
+}
+
+// Whether every frame from |first| on started |expected| before its deadline.
+bool LeadsAre(const std::vector<Clock::Duration>& leads, size_t first, Clock::Duration expected)
+{
+    for (size_t i = first; i < leads.size(); ++i)
+    {
+        if (!IsNear(leads[i], expected))
+            return false;
+    }
+
+    return true;
+}
+
+int RunTest(const Options& options)
+{
+    Checks checks;
+    json leadsMs = json::object();
+
+    // The first frame has no history to predict from, so always misses its deadline. It has left
+    // the history by the end, but the missed frame total keeps it.
+    static_assert(NUM_FRAMES > FramePacer::HISTORY_SIZE);
+
+    {
+        ScriptedClock clock;
+        FramePacer pacer(&clock, TARGET_RATE_HZ);
+
+        std::vector<Clock::Duration> leads =
+            GetLeads(RunFrames(&pacer, &clock, NUM_FRAMES, [](int) { return 5ms; }));
+
+        leadsMs["steady"] = ToMs(leads.back());
+
+        checks.Check("steady_work_starts_ahead_by_work_and_margin",
+                     LeadsAre(leads, 1, 5ms + FramePacer::WORK_SAFETY_MARGIN) &&
+                         pacer.GetStats().MissedFrames == 1);
+
+        FramePacer::Stats stats = pacer.GetStats();
+
+        checks.Check("stats_of_steady_work", IsNear(stats.WorkTimeP50, 5ms) &&
+                                                  IsNear(stats.WorkTimeP99, 5ms) &&
+                                                  IsNear(stats.FrameTimeP50, PERIOD) &&
+                                                  IsNear(stats.FrameTimeP99, PERIOD));
+
+        // The history is full, so the pacer's buffers are at their final size.
+        uint64_t allocationsBefore = AllocationTracker::GetThreadCount();
+
+        for (int i = 0; i < NUM_FRAMES; ++i)
+        {
+            pacer.BeginFrame();
+            clock.Advance(5ms);
+            pacer.EndFrame();
+        }
+
+        checks.Check("pacing_does_not_allocate",
+                     AllocationTracker::GetThreadCount() == allocationsBefore);
+    }
+
+    // One frame in ten is slow, more than the 5% the 95th percentile leaves out, so the pacer
+    // plans every frame for a slow one. The slow first frame runs past the second frame's start
+    // time, so that one starts late.
+    {
+        ScriptedClock clock;
+        FramePacer pacer(&clock, TARGET_RATE_HZ);
+
+        std::vector<Clock::Duration> leads = GetLeads(RunFrames(
+            &pacer, &clock, NUM_FRAMES, [](int i) { return i % 10 == 0 ? 10ms : 4ms; }));
+
+        leadsMs["one_in_ten_slow"] = ToMs(leads.back());
+
+        checks.Check("frequent_slow_frames_set_the_lead",
+                     LeadsAre(leads, 2, 10ms + FramePacer::WORK_SAFETY_MARGIN) &&
+                         pacer.GetStats().MissedFrames == 1);
+
+        FramePacer::Stats stats = pacer.GetStats();
+
+        checks.Check("stats_of_mixed_work",
+                     IsNear(stats.WorkTimeP50, 4ms) && IsNear(stats.WorkTimeP95, 10ms) &&
+                         IsNear(stats.FrameTimeP50, PERIOD));
+    }
+
+    // One frame in fifty is slow. Those frames miss, but do not move the others, nor push the
+    // next frame off its cadence.
+    {
+        ScriptedClock clock;
+        FramePacer pacer(&clock, TARGET_RATE_HZ);
+
+        auto isSlow = [](int i) { return i % 50 == 25; };
+
+        std::vector<Clock::Duration> leads = GetLeads(RunFrames(
+            &pacer, &clock, NUM_FRAMES, [&](int i) { return isSlow(i) ? 12ms : 4ms; }));
+
+        size_t numSlow = 0;
+
+        for (int i = 0; i < NUM_FRAMES; ++i)
+            numSlow += isSlow(i) ? 1 : 0;
+
+        leadsMs["one_in_fifty_slow"] = ToMs(leads.back());
+
+        checks.Check("rare_slow_frames_are_ignored",
+                     LeadsAre(leads, 1, 4ms + FramePacer::WORK_SAFETY_MARGIN) &&
+                         pacer.GetStats().MissedFrames == 1 + numSlow);
+    }
+
+    // Every sleep runs long. The spin window grows to cover it within a few frames, after which
+    // frames start on time again.
+    {
+        constexpr int numWarmUpFrames = 10;
+
+        ScriptedClock clock;
+        clock.Oversleep = 1500us;
+
+        FramePacer pacer(&clock, TARGET_RATE_HZ);
+
+        auto work = [](int) { return 5ms; };
+
+        std::vector<Clock::TimePoint> starts = RunFrames(&pacer, &clock, numWarmUpFrames, work);
+        size_t missedInWarmUp = pacer.GetStats().MissedFrames;
+
+        std::vector<Clock::TimePoint> laterStarts =
+            RunFrames(&pacer, &clock, NUM_FRAMES - numWarmUpFrames, work);
+        starts.insert(starts.end(), laterStarts.begin(), laterStarts.end());
+
+        std::vector<Clock::Duration> leads = GetLeads(starts);
+
+        leadsMs["oversleeping"] = ToMs(leads.back());
+
+        checks.Check("oversleeping_is_absorbed",
+                     LeadsAre(leads, numWarmUpFrames, 5ms + FramePacer::WORK_SAFETY_MARGIN) &&
+                         pacer.GetStats().MissedFrames == missedInWarmUp);
+    }
+
+    // A frame stalls for more than two periods. The next starts as soon as it ends, against a new
+    // deadline, and the rest follow a period apart instead of running back to back to catch up.
+    {
+        constexpr int stalledFrame = 100;
+
+        ScriptedClock clock;
+        FramePacer pacer(&clock, TARGET_RATE_HZ);
+
+        std::vector<Clock::TimePoint> starts = RunFrames(
+            &pacer, &clock, NUM_FRAMES, [](int i) { return i == stalledFrame ? 40ms : 5ms; });
+
+        bool reanchored = IsNear(starts[stalledFrame + 1] - starts[stalledFrame], 40ms);
+
+        for (size_t i = stalledFrame + 2; i < starts.size(); ++i)
+            reanchored = reanchored && IsNear(starts[i] - starts[i - 1], PERIOD);
+
+        checks.Check("stall_reanchors_without_a_burst",
+                     reanchored && pacer.GetStats().MissedFrames == 2);
+    }
+
+    // Frames are presented on a render thread after they are built, so the pacer plans for both.
+    // Until the first present is reported, the second frame plans for building alone and misses.
+    {
+        ScriptedClock clock;
+        FramePacer pacer(&clock, TARGET_RATE_HZ);
+
+        std::vector<Clock::Duration> leads =
+            GetLeads(RunPresentedFrames(&pacer, &clock, NUM_FRAMES, 4ms, 10ms));
+
+        leadsMs["presented_later"] = ToMs(leads.back());
+
+        checks.Check("presents_set_the_lead",
+                     LeadsAre(leads, 2, 14ms + FramePacer::WORK_SAFETY_MARGIN) &&
+                         pacer.GetStats().MissedFrames == 2);
+    }
+
+    // Building and presenting a frame take longer than a period between them. The next frame is
+    // built while the last one is presented, and every frame is still presented on time.
+    {
+        ScriptedClock clock;
+        FramePacer pacer(&clock, TARGET_RATE_HZ);
+
+        std::vector<Clock::Duration> leads =
+            GetLeads(RunPresentedFrames(&pacer, &clock, NUM_FRAMES, 8ms, 12ms));
+
+        leadsMs["presented_over_a_period_later"] = ToMs(leads.back());
+
+        checks.Check("long_presents_overlap_the_next_frame",
+                     LeadsAre(leads, 3, 20ms + FramePacer::WORK_SAFETY_MARGIN) &&
+                         pacer.GetStats().MissedFrames == 3);
+    }
+
+    json results = {
+        {"target_rate_hz", TARGET_RATE_HZ},
+        {"frames", NUM_FRAMES},
+        {"last_lead_ms", leadsMs},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    for (const auto& [name, passed] : checks.Results.items())
+        std::printf("%-44s %s\n", name.c_str(), passed.get<bool>() ? "passed" : "FAILED");
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Frame pacer checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunTest);
+}
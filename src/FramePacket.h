@@ -0,0 +1,38 @@
+#pragma once
+
+#include "CommandStream.h"
+#include "FrameArena.h"
+#include "FrameBuilder.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <span>
+
+// Everything the render thread needs to draw one frame, built by the main thread. Arrays point into
+// the packet's own arena, so a packet is self-contained and immutable once published.
+struct FramePacket
+{
+    uint64_t FrameIdx = 0;
+
+    glm::mat4 ViewMat;
+    glm::mat4 ProjMat;
+    glm::mat4 ViewProjMat;
+
+    glm::vec4 LightPos;
+
+    // One entry per visible object, consumed in order by the instanced draws.
+    std::span<const InstanceData> Instances;
+
+    std::span<const Command> Commands;
+
+    uint32_t NumDraws = 0;
+    uint32_t NumInstances = 0;
+    uint32_t NumStateChanges = 0;
+    uint64_t NumTriangles = 0;
+
+    // Steady clock time of the oldest input event that affected this frame, or -1.
+    int64_t OldestInputTimestamp = -1;
+
+    FrameArena Arena;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Axis-aligned bounding box of |localMin|/|localMax| after transforming by |mat|.
+inline void TransformAabb(const glm::mat4& mat, const glm::vec3& localMin,
+                          const glm::vec3& localMax, glm::vec3* worldMin, glm::vec3* worldMax)
+{
+    glm::vec3 center = (localMin + localMax) * 0.5f;
+    glm::vec3 extents = (localMax - localMin) * 0.5f;
+
+    glm::vec3 worldCenter = glm::vec3(mat * glm::vec4(center, 1.f));
+
+    glm::vec3 worldExtents = glm::abs(glm::vec3(mat[0])) * extents.x +
+        glm::abs(glm::vec3(mat[1])) * extents.y + glm::abs(glm::vec3(mat[2])) * extents.z;
+
+    *worldMin = worldCenter - worldExtents;
+    *worldMax = worldCenter + worldExtents;
+}
+
+struct Frustum
+{
+    // Inward-facing planes as (normal, distance): left, right, bottom, top, near, far.
+    glm::vec4 Planes[6];
+
+    // Extracts the planes from a view-projection matrix with a [0, 1] clip depth range.
+    static Frustum FromViewProj(const glm::mat4& viewProj)
+    {
+        glm::vec4 row0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+        glm::vec4 row1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+        glm::vec4 row2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+        glm::vec4 row3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+        Frustum frustum{};
+        frustum.Planes[0] = row3 + row0;
+        frustum.Planes[1] = row3 - row0;
+        frustum.Planes[2] = row3 + row1;
+        frustum.Planes[3] = row3 - row1;
+        frustum.Planes[4] = row2;
+        frustum.Planes[5] = row3 - row2;
+
+        for (auto& plane : frustum.Planes)
+        {
+            plane /= glm::length(glm::vec3(plane));
+        }
+
+        return frustum;
+    }
+
+    bool IntersectsAabb(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+    {
+        for (const auto& plane : Planes)
+        {
+            // Corner furthest along the plane normal.
+            glm::vec3 positive(plane.x >= 0.f ? boundsMax.x : boundsMin.x,
+                               plane.y >= 0.f ? boundsMax.y : boundsMin.y,
+                               plane.z >= 0.f ? boundsMax.z : boundsMin.z);
+
+            if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.f)
+                return false;
+        }
+
+        return true;
+    }
+};
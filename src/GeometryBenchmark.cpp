@@ -0,0 +1,507 @@
+// Benchmark for the geometry optimizer. Builds a model of grids stored as triangle soup, with a UV
+// seam, corners jittered by less than the weld epsilon and repeated copies, welds it exactly and
+// within the epsilon, then does the same for a glTF file. Checks that every triangle keeps its
+// corners, that seams stay split, that copies share one range and that the expected vertices are
+// welded, including vertices either side of any boundary a grid of cells could put between them.
+// Exits with an error if any check fails.
+
+#include "BenchmarkUtils.h"
+#include "GeometryOptimizer.h"
+#include "GltfLoader.h"
+#include "JobSystem.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+using benchmark::ElapsedMs;
+
+struct Options
+{
+    std::string OutPath = "geometry_benchmark_results.json";
+
+    std::string ModelPath = "assets/box/Box.gltf";
+
+    int NumGrids = 64;
+    int GridSize = 64;
+
+    // Identical copies of each grid.
+    int NumCopies = 4;
+
+    float Epsilon = 1e-4f;
+
+    int NumThreads = 0;
+};
+
+constexpr const char* USAGE =
+    "Usage: GeometryBenchmark [options]\n"
+    "  --model FILE      glTF file to weld as well (default assets/box/Box.gltf)\n"
+    "  --grids N         Distinct grid primitives (default 64)\n"
+    "  --size N          Quads per grid side, at most 100 (default 64)\n"
+    "  --copies N        Copies of each grid (default 4)\n"
+    "  --epsilon F       Weld epsilon (default 0.0001)\n"
+    "  --threads N       Job system threads, 0 for one per core (default 0)\n"
+    "  --out FILE        Results file (default geometry_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--model")
+            options->ModelPath = value;
+        else if (arg == "--grids")
+            options->NumGrids = std::stoi(value);
+        else if (arg == "--size")
+            options->GridSize = std::stoi(value);
+        else if (arg == "--copies")
+            options->NumCopies = std::stoi(value);
+        else if (arg == "--epsilon")
+            options->Epsilon = std::stof(value);
+        else if (arg == "--threads")
+            options->NumThreads = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    // Soup vertices must fit 16-bit indices.
+    return options->NumGrids > 0 && options->GridSize > 1 && options->GridSize <= 100 &&
+        options->NumCopies > 0 && options->Epsilon > 0.f && options->NumThreads >= 0;
+}
+
+// Grid spacing, far wider than the default epsilon.
+constexpr float CELL_SIZE = 1.f / 16.f;
+
+// Interleaved position, normal and texture coordinates.
+struct SoupVertex
+{
+    float Position[3];
+    float Normal[3];
+    float TexCoord[2];
+};
+
+// A grid in the XZ plane at height |y|, as a triangle list with every corner stored separately.
+// Texture coordinates wrap from 1 back to 0 at the middle column, which leaves a seam there.
+void AppendGrid(int gridSize, float y, float jitter, std::mt19937* rng,
+                std::vector<SoupVertex>* vertices)
+{
+    std::uniform_real_distribution<float> jitterDist(-jitter, jitter);
+    int seam = gridSize / 2;
+
+    auto corner = [&](int x, int z, int quadX) {
+        SoupVertex vertex{};
+        vertex.Position[0] = static_cast<float>(x) * CELL_SIZE;
+        vertex.Position[1] = y;
+        vertex.Position[2] = static_cast<float>(z) * CELL_SIZE;
+        vertex.Normal[1] = 1.f;
+
+        // Quads left of the seam see its column at u = 1, those right of it at u = 0.
+        int u = quadX < seam ? x : x - seam;
+        vertex.TexCoord[0] = static_cast<float>(u) / static_cast<float>(seam);
+        vertex.TexCoord[1] = static_cast<float>(z) / static_cast<float>(gridSize);
+
+        // Every fourth corner is slightly off, so that only some are exact copies.
+        if ((*rng)() % 4 == 0)
+            vertex.Position[0] += jitterDist(*rng);
+
+        vertices->push_back(vertex);
+    };
+
+    for (int z = 0; z < gridSize; ++z)
+    {
+        for (int x = 0; x < gridSize; ++x)
+        {
+            corner(x, z, x);
+            corner(x, z + 1, x);
+            corner(x + 1, z, x);
+
+            corner(x + 1, z, x);
+            corner(x, z + 1, x);
+            corner(x + 1, z + 1, x);
+        }
+    }
+}
+
+// One mesh per grid, holding each of its copies. Every primitive gets its own vertices and
+// indices in one interleaved buffer.
+ModelData MakeGridModel(const Options& options, float jitter)
+{
+    std::mt19937 rng(1234);
+
+    ModelData model;
+    model.Buffers.emplace_back();
+    std::vector<std::byte>& buffer = model.Buffers[0];
+
+    for (int grid = 0; grid < options.NumGrids; ++grid)
+    {
+        std::vector<SoupVertex> vertices;
+        AppendGrid(options.GridSize, static_cast<float>(grid) * 0.5f, jitter, &rng, &vertices);
+
+        std::vector<uint16_t> indices(vertices.size());
+
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            indices[i] = static_cast<uint16_t>(i);
+        }
+
+        MeshData mesh;
+
+        for (int copy = 0; copy < options.NumCopies; ++copy)
+        {
+            size_t vertexOffset = buffer.size();
+            size_t vertexBytes = vertices.size() * sizeof(SoupVertex);
+            size_t indexOffset = vertexOffset + vertexBytes;
+            size_t indexBytes = indices.size() * sizeof(uint16_t);
+
+            buffer.resize(indexOffset + indexBytes);
+            std::memcpy(buffer.data() + vertexOffset, vertices.data(), vertexBytes);
+            std::memcpy(buffer.data() + indexOffset, indices.data(), indexBytes);
+
+            auto count = static_cast<uint32_t>(vertices.size());
+
+            PrimitiveData prim;
+            prim.Positions = {0, vertexOffset + offsetof(SoupVertex, Position), sizeof(SoupVertex),
+                              count};
+            prim.Normals = {0, vertexOffset + offsetof(SoupVertex, Normal), sizeof(SoupVertex),
+                            count};
+            prim.TexCoords = {0, vertexOffset + offsetof(SoupVertex, TexCoord), sizeof(SoupVertex),
+                              count};
+            prim.Indices = {0, indexOffset, sizeof(uint16_t),
+                            static_cast<uint32_t>(indices.size())};
+            prim.MaterialIdx = copy;
+
+            mesh.Primitives.push_back(prim);
+        }
+
+        model.Meshes.push_back(std::move(mesh));
+    }
+
+    return model;
+}
+
+// One primitive of triangles whose first two corners are within |epsilon| of each other and
+// straddle boundaries at every multiple of half the epsilon, by a single ulp for some triangles
+// and at every phase for others. Welding within the epsilon keeps two corners of each.
+ModelData MakeStraddleModel(float epsilon, int numTriangles)
+{
+    std::vector<SoupVertex> vertices;
+
+    for (int i = 0; i < numTriangles; ++i)
+    {
+        // Far enough apart that triangles never weld with each other.
+        float base = static_cast<float>(i) * 16.f * epsilon;
+
+        SoupVertex a{};
+        SoupVertex b{};
+
+        if (i % 2 == 0)
+        {
+            float boundary = base + static_cast<float>(i / 2 % 4) * 0.5f * epsilon;
+
+            for (int c = 0; c < 3; ++c)
+            {
+                a.Position[c] = std::nextafter(boundary, -1.f);
+                b.Position[c] = std::nextafter(boundary, 1.f);
+            }
+        }
+        else
+        {
+            float phase = static_cast<float>(i % 100) * 0.02f * epsilon;
+
+            for (int c = 0; c < 3; ++c)
+            {
+                a.Position[c] = base + phase;
+                b.Position[c] = base + phase + 0.6f * epsilon;
+            }
+        }
+
+        a.Normal[1] = 1.f;
+        b.Normal[1] = 1.f;
+        a.TexCoord[0] = static_cast<float>(i % 7) * 0.5f * epsilon;
+        b.TexCoord[0] = a.TexCoord[0] + 0.6f * epsilon;
+
+        // Well below every other corner.
+        SoupVertex far = a;
+        far.Position[1] = -1.f;
+
+        vertices.push_back(a);
+        vertices.push_back(b);
+        vertices.push_back(far);
+    }
+
+    std::vector<uint16_t> indices(vertices.size());
+
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        indices[i] = static_cast<uint16_t>(i);
+    }
+
+    ModelData model;
+    model.Buffers.emplace_back();
+    std::vector<std::byte>& buffer = model.Buffers[0];
+
+    size_t vertexBytes = vertices.size() * sizeof(SoupVertex);
+    size_t indexBytes = indices.size() * sizeof(uint16_t);
+
+    buffer.resize(vertexBytes + indexBytes);
+    std::memcpy(buffer.data(), vertices.data(), vertexBytes);
+    std::memcpy(buffer.data() + vertexBytes, indices.data(), indexBytes);
+
+    auto count = static_cast<uint32_t>(vertices.size());
+
+    PrimitiveData prim;
+    prim.Positions = {0, offsetof(SoupVertex, Position), sizeof(SoupVertex), count};
+    prim.Normals = {0, offsetof(SoupVertex, Normal), sizeof(SoupVertex), count};
+    prim.TexCoords = {0, offsetof(SoupVertex, TexCoord), sizeof(SoupVertex), count};
+    prim.Indices = {0, vertexBytes, sizeof(uint16_t), static_cast<uint32_t>(indices.size())};
+
+    MeshData mesh;
+    mesh.Primitives.push_back(prim);
+    model.Meshes.push_back(std::move(mesh));
+
+    return model;
+}
+
+std::vector<float> ReadFloats(const ModelData& model, const BufferRange& range,
+                              size_t numComponents)
+{
+    std::vector<float> values(range.Count * numComponents);
+
+    for (size_t i = 0; i < range.Count; ++i)
+    {
+        std::memcpy(values.data() + i * numComponents,
+                    model.Buffers[range.Buffer].data() + range.ByteOffset + i * range.ByteStride,
+                    numComponents * sizeof(float));
+    }
+
+    return values;
+}
+
+std::vector<uint16_t> ReadIndices(const ModelData& model, const BufferRange& range)
+{
+    std::vector<uint16_t> indices(range.Count);
+
+    for (size_t i = 0; i < range.Count; ++i)
+    {
+        std::memcpy(&indices[i],
+                    model.Buffers[range.Buffer].data() + range.ByteOffset + i * range.ByteStride,
+                    sizeof(uint16_t));
+    }
+
+    return indices;
+}
+
+bool InBufferAndAligned(const ModelData& model, const BufferRange& range)
+{
+    return !range.IsValid() ||
+        (range.Buffer == 0 && range.ByteOffset % 4 == 0 &&
+         range.ByteOffset + range.GetByteSize() <= model.Buffers[0].size());
+}
+
+// Every triangle corner of every primitive has the same attributes as before, within |epsilon|
+// per component, or bit for bit when it is zero.
+bool CheckTopology(const ModelData& before, const ModelData& after, const GeometryOptions& options)
+{
+    if (after.Buffers.size() != 1 || after.Meshes.size() != before.Meshes.size())
+        return false;
+
+    for (size_t m = 0; m < before.Meshes.size(); ++m)
+    {
+        for (size_t p = 0; p < before.Meshes[m].Primitives.size(); ++p)
+        {
+            const PrimitiveData& a = before.Meshes[m].Primitives[p];
+            const PrimitiveData& b = after.Meshes[m].Primitives[p];
+
+            const BufferRange* rangesA[] = {&a.Positions, &a.Normals, &a.TexCoords, &a.Tangents};
+            const BufferRange* rangesB[] = {&b.Positions, &b.Normals, &b.TexCoords, &b.Tangents};
+            const size_t numComponents[] = {3, 3, 2, 4};
+
+            if (!InBufferAndAligned(after, b.Indices) || a.Indices.Count != b.Indices.Count)
+                return false;
+
+            std::vector<uint16_t> indicesA = ReadIndices(before, a.Indices);
+            std::vector<uint16_t> indicesB = ReadIndices(after, b.Indices);
+
+            for (int s = 0; s < 4; ++s)
+            {
+                if (rangesA[s]->IsValid() != rangesB[s]->IsValid() ||
+                    !InBufferAndAligned(after, *rangesB[s]))
+                    return false;
+
+                if (!rangesA[s]->IsValid())
+                    continue;
+
+                size_t n = numComponents[s];
+                float epsilon = s == 0 ? options.PositionEpsilon : options.AttributeEpsilon;
+
+                std::vector<float> valuesA = ReadFloats(before, *rangesA[s], n);
+                std::vector<float> valuesB = ReadFloats(after, *rangesB[s], n);
+
+                for (size_t i = 0; i < indicesA.size(); ++i)
+                {
+                    if (indicesB[i] >= rangesB[s]->Count)
+                        return false;
+
+                    const float* cornerA = valuesA.data() + indicesA[i] * n;
+                    const float* cornerB = valuesB.data() + indicesB[i] * n;
+
+                    for (size_t c = 0; c < n; ++c)
+                    {
+                        bool same = epsilon > 0.f ? std::abs(cornerA[c] - cornerB[c]) < epsilon :
+                                                    cornerA[c] == cornerB[c];
+
+                        if (!same)
+                            return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+struct Pass
+{
+    GeometryStats Stats;
+    double Ms = 0.0;
+    bool TopologyPreserved = false;
+};
+
+Pass RunPass(const ModelData& model, const GeometryOptions& geometryOptions, JobSystem* jobSystem)
+{
+    ModelData optimized = model;
+
+    Pass pass;
+    Clock::time_point start = Clock::now();
+    pass.Stats = OptimizeGeometry(&optimized, jobSystem, geometryOptions);
+    pass.Ms = ElapsedMs(start);
+
+    pass.TopologyPreserved = CheckTopology(model, optimized, geometryOptions);
+
+    return pass;
+}
+
+json ToJson(const Pass& pass)
+{
+    const GeometryStats& stats = pass.Stats;
+
+    return {
+        {"ms", pass.Ms},
+        {"primitives", stats.NumPrimitives},
+        {"shared_primitives", stats.NumSharedPrimitives},
+        {"vertices_before", stats.NumVerticesBefore},
+        {"vertices_after", stats.NumVerticesAfter},
+        {"bytes_before", stats.BytesBefore},
+        {"bytes_after", stats.BytesAfter},
+        {"saved_bytes", static_cast<int64_t>(stats.BytesBefore) -
+                            static_cast<int64_t>(stats.BytesAfter)},
+        {"vertices_per_sec",
+         static_cast<double>(stats.NumVerticesBefore) / (pass.Ms / 1e3)}
+    };
+}
+
+int RunBenchmark(const Options& options)
+{
+    JobSystem jobSystem(options.NumThreads);
+
+    Checks checks;
+
+    // Corners of the same grid point stay less than the epsilon apart.
+    ModelData grids = MakeGridModel(options, options.Epsilon * 0.45f);
+
+    GeometryOptions exact;
+    GeometryOptions welded{options.Epsilon, options.Epsilon};
+
+    Pass exactPass = RunPass(grids, exact, &jobSystem);
+    Pass weldedPass = RunPass(grids, welded, &jobSystem);
+
+    auto numGrids = static_cast<uint64_t>(options.NumGrids);
+    auto gridSize = static_cast<uint64_t>(options.GridSize);
+
+    // The grid's vertices, plus the seam column a second time.
+    uint64_t expectedVertices = numGrids * ((gridSize + 1) * (gridSize + 1) + gridSize + 1);
+    uint64_t expectedShared = numGrids * static_cast<uint64_t>(options.NumCopies - 1);
+
+    checks.Check("exact_topology_lossless", exactPass.TopologyPreserved);
+    checks.Check("epsilon_topology_preserved", weldedPass.TopologyPreserved);
+    checks.Check("epsilon_weld_count", weldedPass.Stats.NumVerticesAfter == expectedVertices);
+    checks.Check("exact_weld_partial",
+                 exactPass.Stats.NumVerticesAfter > expectedVertices &&
+                     exactPass.Stats.NumVerticesAfter < exactPass.Stats.NumVerticesBefore /
+                         static_cast<uint64_t>(options.NumCopies));
+    checks.Check("copies_shared", exactPass.Stats.NumSharedPrimitives == expectedShared &&
+                 weldedPass.Stats.NumSharedPrimitives == expectedShared);
+
+    constexpr int NUM_STRADDLE_TRIANGLES = 1000;
+
+    ModelData straddle = MakeStraddleModel(options.Epsilon, NUM_STRADDLE_TRIANGLES);
+    Pass straddlePass = RunPass(straddle, welded, &jobSystem);
+
+    checks.Check("straddling_vertices_welded",
+                 straddlePass.TopologyPreserved &&
+                     straddlePass.Stats.NumVerticesAfter == 2 * NUM_STRADDLE_TRIANGLES);
+
+    ModelData model = LoadGltfModelData(options.ModelPath);
+
+    Pass modelExactPass = RunPass(model, exact, &jobSystem);
+    Pass modelWeldedPass = RunPass(model, welded, &jobSystem);
+
+    checks.Check("model_exact_topology_lossless", modelExactPass.TopologyPreserved);
+    checks.Check("model_epsilon_topology_preserved", modelWeldedPass.TopologyPreserved);
+
+    json results = {
+        {"threads", jobSystem.GetThreadCount()},
+        {"grids", options.NumGrids},
+        {"grid_size", options.GridSize},
+        {"copies", options.NumCopies},
+        {"epsilon", options.Epsilon},
+        {"grid_exact", ToJson(exactPass)},
+        {"grid_epsilon", ToJson(weldedPass)},
+        {"straddle_epsilon", ToJson(straddlePass)},
+        {"model", options.ModelPath},
+        {"model_exact", ToJson(modelExactPass)},
+        {"model_epsilon", ToJson(modelWeldedPass)},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Geometry checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
@@ -0,0 +1,1187 @@
+#include "GeometryCodec.h"
+
+#include "Hash.h"
+#include "Profiler.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+// Vertex data
+
+// Bytes of a plane are packed in groups of this many.
+constexpr size_t GROUP_SIZE = 16;
+
+// Packed size of a group, by its 2-bit width code: 0, 2, 4 or 8 bits per byte.
+constexpr size_t GROUP_BYTES[4] = {0, 4, 8, 16};
+
+// Vertices are decoded a block at a time into a buffer this large, which stays in L1 along with
+// the block's planes, and is then copied out in one go.
+constexpr size_t BLOCK_BYTES = 8192;
+constexpr size_t MAX_BLOCK_VERTICES = 256;
+
+void CheckStride(size_t stride)
+{
+    if (stride == 0 || stride % 4 != 0 || stride > MAX_VERTEX_STRIDE)
+        throw std::runtime_error("Unsupported vertex stride.");
+}
+
+// A whole number of groups, at most MAX_BLOCK_VERTICES and at most BLOCK_BYTES of vertices.
+size_t GetBlockVertices(size_t stride)
+{
+    return std::clamp(BLOCK_BYTES / stride / GROUP_SIZE * GROUP_SIZE, GROUP_SIZE,
+                      MAX_BLOCK_VERTICES);
+}
+
+uint32_t ZigzagEncode(uint32_t delta)
+{
+    return (delta << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(delta) >> 31);
+}
+
+uint32_t ZigzagDecode(uint32_t value)
+{
+    return (value >> 1) ^ (0u - (value & 1));
+}
+
+size_t GetHeaderSize(size_t numGroups)
+{
+    return (numGroups + 3) / 4;
+}
+
+uint32_t GetGroupCode(const uint8_t* header, size_t group)
+{
+    return (header[group / 4] >> (2 * (group % 4))) & 3;
+}
+
+// Appends the width codes of a plane's groups, followed by the packed groups. In a group packed
+// at 2 bits, byte k of the group is in bits 2 * (k / 4) of packed byte k % 4, and at 4 bits in
+// bits 4 * (k / 8) of packed byte k % 8, which is what the SIMD decoders unpack fastest.
+void EncodePlane(const uint8_t* plane, size_t numGroups, std::vector<std::byte>* encoded)
+{
+    size_t headerPos = encoded->size();
+    encoded->resize(headerPos + GetHeaderSize(numGroups));
+
+    for (size_t group = 0; group < numGroups; ++group)
+    {
+        const uint8_t* values = plane + group * GROUP_SIZE;
+        uint8_t maxValue = *std::max_element(values, values + GROUP_SIZE);
+
+        uint32_t code = maxValue == 0 ? 0 : maxValue < 4 ? 1 : maxValue < 16 ? 2 : 3;
+        (*encoded)[headerPos + group / 4] |= static_cast<std::byte>(code << (2 * (group % 4)));
+
+        uint8_t packed[GROUP_SIZE] = {};
+
+        for (size_t k = 0; k < GROUP_SIZE; ++k)
+        {
+            if (code == 1)
+                packed[k % 4] |= static_cast<uint8_t>(values[k] << (2 * (k / 4)));
+            else if (code == 2)
+                packed[k % 8] |= static_cast<uint8_t>(values[k] << (4 * (k / 8)));
+            else
+                packed[k] = values[k];
+        }
+
+        const std::byte* bytes = reinterpret_cast<const std::byte*>(packed);
+        encoded->insert(encoded->end(), bytes, bytes + GROUP_BYTES[code]);
+    }
+}
+
+// Planes of a block are this far apart in the decoder's scratch buffer.
+constexpr size_t PLANE_STRIDE = MAX_BLOCK_VERTICES;
+
+// Unpacks the groups of a plane, starting at its header, into |dst|.
+using DecodePlaneFn = void (*)(const uint8_t* src, size_t numGroups, uint8_t* dst);
+
+// Joins the byte planes of one word into 32-bit words, undoes the zigzag coding and the deltas
+// starting from |prev|, and writes word i to dst + i * stride. |numVertices| is a multiple of
+// GROUP_SIZE. Returns the last word.
+using RebuildWordsFn = uint32_t (*)(const uint8_t* planes, size_t numVertices, uint32_t prev,
+                                    uint8_t* dst, size_t stride);
+
+struct VertexKernels
+{
+    DecodePlaneFn DecodePlane;
+    RebuildWordsFn RebuildWords;
+};
+
+void DecodePlaneScalar(const uint8_t* src, size_t numGroups, uint8_t* dst)
+{
+    const uint8_t* data = src + GetHeaderSize(numGroups);
+
+    for (size_t group = 0; group < numGroups; ++group, dst += GROUP_SIZE)
+    {
+        uint32_t code = GetGroupCode(src, group);
+
+        for (size_t k = 0; k < GROUP_SIZE; ++k)
+        {
+            if (code == 0)
+                dst[k] = 0;
+            else if (code == 1)
+                dst[k] = (data[k % 4] >> (2 * (k / 4))) & 3;
+            else if (code == 2)
+                dst[k] = (data[k % 8] >> (4 * (k / 8))) & 15;
+            else
+                dst[k] = data[k];
+        }
+
+        data += GROUP_BYTES[code];
+    }
+}
+
+uint32_t RebuildWordsScalar(const uint8_t* planes, size_t numVertices, uint32_t prev,
+                            uint8_t* dst, size_t stride)
+{
+    for (size_t i = 0; i < numVertices; ++i)
+    {
+        uint32_t value = planes[i] | (planes[PLANE_STRIDE + i] << 8) |
+            (planes[2 * PLANE_STRIDE + i] << 16) |
+            (static_cast<uint32_t>(planes[3 * PLANE_STRIDE + i]) << 24);
+
+        prev += ZigzagDecode(value);
+        std::memcpy(dst + i * stride, &prev, sizeof(prev));
+    }
+
+    return prev;
+}
+
+void StoreWord(uint8_t* dst, int value)
+{
+    std::memcpy(dst, &value, sizeof(value));
+}
+
+#if defined(GRFX_SIMD_X86)
+
+TARGET_SSE41 __m128i UnpackGroupSse41(uint32_t code, const uint8_t* src)
+{
+    switch (code)
+    {
+        case 0:
+            return _mm_setzero_si128();
+        case 1:
+        {
+            int bits;
+            std::memcpy(&bits, src, sizeof(bits));
+
+            // Shifting 16-bit lanes lets bits of the neighbouring byte in at the top, which the
+            // mask drops.
+            const __m128i mask = _mm_set1_epi8(3);
+            __m128i packed = _mm_cvtsi32_si128(bits);
+            __m128i v0 = _mm_and_si128(packed, mask);
+            __m128i v1 = _mm_and_si128(_mm_srli_epi16(packed, 2), mask);
+            __m128i v2 = _mm_and_si128(_mm_srli_epi16(packed, 4), mask);
+            __m128i v3 = _mm_and_si128(_mm_srli_epi16(packed, 6), mask);
+
+            return _mm_unpacklo_epi64(_mm_unpacklo_epi32(v0, v1), _mm_unpacklo_epi32(v2, v3));
+        }
+        case 2:
+        {
+            const __m128i mask = _mm_set1_epi8(15);
+            __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+
+            return _mm_unpacklo_epi64(_mm_and_si128(packed, mask),
+                                      _mm_and_si128(_mm_srli_epi16(packed, 4), mask));
+        }
+        default:
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    }
+}
+
+TARGET_SSE41 void DecodePlaneSse41(const uint8_t* src, size_t numGroups, uint8_t* dst)
+{
+    const uint8_t* data = src + GetHeaderSize(numGroups);
+
+    for (size_t group = 0; group < numGroups; ++group, dst += GROUP_SIZE)
+    {
+        uint32_t code = GetGroupCode(src, group);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), UnpackGroupSse41(code, data));
+        data += GROUP_BYTES[code];
+    }
+}
+
+// Zigzag-decodes four words and adds each to the ones before it.
+TARGET_SSE41 __m128i PrefixSumSse41(__m128i zigzag)
+{
+    __m128i delta = _mm_xor_si128(_mm_srli_epi32(zigzag, 1),
+                                  _mm_sub_epi32(_mm_setzero_si128(),
+                                                _mm_and_si128(zigzag, _mm_set1_epi32(1))));
+
+    delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 4));
+    return _mm_add_epi32(delta, _mm_slli_si128(delta, 8));
+}
+
+TARGET_SSE41 uint32_t RebuildWordsSse41(const uint8_t* planes, size_t numVertices, uint32_t prev,
+                                        uint8_t* dst, size_t stride)
+{
+    __m128i last = _mm_set1_epi32(static_cast<int>(prev));
+
+    for (size_t i = 0; i < numVertices; i += GROUP_SIZE)
+    {
+        auto load = [&](size_t plane) {
+            return _mm_load_si128(reinterpret_cast<const __m128i*>(planes + plane * PLANE_STRIDE +
+                                                                    i));
+        };
+
+        __m128i b0 = load(0);
+        __m128i b1 = load(1);
+        __m128i b2 = load(2);
+        __m128i b3 = load(3);
+
+        __m128i low01 = _mm_unpacklo_epi8(b0, b1);
+        __m128i low23 = _mm_unpacklo_epi8(b2, b3);
+        __m128i high01 = _mm_unpackhi_epi8(b0, b1);
+        __m128i high23 = _mm_unpackhi_epi8(b2, b3);
+
+        __m128i words[4] = {_mm_unpacklo_epi16(low01, low23), _mm_unpackhi_epi16(low01, low23),
+                            _mm_unpacklo_epi16(high01, high23),
+                            _mm_unpackhi_epi16(high01, high23)};
+
+        uint8_t* out = dst + i * stride;
+
+        for (__m128i zigzag : words)
+        {
+            __m128i values = _mm_add_epi32(PrefixSumSse41(zigzag), last);
+            last = _mm_shuffle_epi32(values, _MM_SHUFFLE(3, 3, 3, 3));
+
+            StoreWord(out, _mm_cvtsi128_si32(values));
+            StoreWord(out + stride, _mm_extract_epi32(values, 1));
+            StoreWord(out + 2 * stride, _mm_extract_epi32(values, 2));
+            StoreWord(out + 3 * stride, _mm_extract_epi32(values, 3));
+            out += 4 * stride;
+        }
+    }
+
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(last));
+}
+
+// Eight words at a time. Unpacking groups gains nothing from wider registers, so the AVX2 kernels
+// share DecodePlaneSse41.
+TARGET_AVX2 uint32_t RebuildWordsAvx2(const uint8_t* planes, size_t numVertices, uint32_t prev,
+                                      uint8_t* dst, size_t stride)
+{
+    __m256i last = _mm256_set1_epi32(static_cast<int>(prev));
+
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i lastLane = _mm256_set1_epi32(7);
+
+    for (size_t i = 0; i < numVertices; i += GROUP_SIZE)
+    {
+        auto load = [&](size_t plane) {
+            return _mm_load_si128(reinterpret_cast<const __m128i*>(planes + plane * PLANE_STRIDE +
+                                                                    i));
+        };
+
+        __m128i b0 = load(0);
+        __m128i b1 = load(1);
+        __m128i b2 = load(2);
+        __m128i b3 = load(3);
+
+        __m128i low01 = _mm_unpacklo_epi8(b0, b1);
+        __m128i low23 = _mm_unpacklo_epi8(b2, b3);
+        __m128i high01 = _mm_unpackhi_epi8(b0, b1);
+        __m128i high23 = _mm_unpackhi_epi8(b2, b3);
+
+        __m256i words[2] = {
+            _mm256_set_m128i(_mm_unpackhi_epi16(low01, low23), _mm_unpacklo_epi16(low01, low23)),
+            _mm256_set_m128i(_mm_unpackhi_epi16(high01, high23),
+                             _mm_unpacklo_epi16(high01, high23))};
+
+        uint8_t* out = dst + i * stride;
+
+        for (__m256i zigzag : words)
+        {
+            __m256i delta = _mm256_xor_si256(_mm256_srli_epi32(zigzag, 1),
+                                             _mm256_sub_epi32(_mm256_setzero_si256(),
+                                                              _mm256_and_si256(zigzag, one)));
+
+            // Sums within each 128-bit half, then carries the low half's total into the high one.
+            delta = _mm256_add_epi32(delta, _mm256_slli_si256(delta, 4));
+            delta = _mm256_add_epi32(delta, _mm256_slli_si256(delta, 8));
+
+            __m256i lowTotal = _mm256_shuffle_epi32(_mm256_permute2x128_si256(delta, delta, 0x08),
+                                                    _MM_SHUFFLE(3, 3, 3, 3));
+
+            __m256i values = _mm256_add_epi32(_mm256_add_epi32(delta, lowTotal), last);
+            last = _mm256_permutevar8x32_epi32(values, lastLane);
+
+            __m128i low = _mm256_castsi256_si128(values);
+            __m128i high = _mm256_extracti128_si256(values, 1);
+
+            StoreWord(out, _mm_cvtsi128_si32(low));
+            StoreWord(out + stride, _mm_extract_epi32(low, 1));
+            StoreWord(out + 2 * stride, _mm_extract_epi32(low, 2));
+            StoreWord(out + 3 * stride, _mm_extract_epi32(low, 3));
+            StoreWord(out + 4 * stride, _mm_cvtsi128_si32(high));
+            StoreWord(out + 5 * stride, _mm_extract_epi32(high, 1));
+            StoreWord(out + 6 * stride, _mm_extract_epi32(high, 2));
+            StoreWord(out + 7 * stride, _mm_extract_epi32(high, 3));
+            out += 8 * stride;
+        }
+    }
+
+    return static_cast<uint32_t>(_mm256_cvtsi256_si32(last));
+}
+
+#elif defined(GRFX_SIMD_NEON)
+
+uint8x16_t UnpackGroupNeon(uint32_t code, const uint8_t* src)
+{
+    switch (code)
+    {
+        case 0:
+            return vdupq_n_u8(0);
+        case 1:
+        {
+            uint32_t bits;
+            std::memcpy(&bits, src, sizeof(bits));
+
+            const uint8x8_t mask = vdup_n_u8(3);
+            uint8x8_t packed = vreinterpret_u8_u32(vdup_n_u32(bits));
+            uint32x2_t v0 = vreinterpret_u32_u8(vand_u8(packed, mask));
+            uint32x2_t v1 = vreinterpret_u32_u8(vand_u8(vshr_n_u8(packed, 2), mask));
+            uint32x2_t v2 = vreinterpret_u32_u8(vand_u8(vshr_n_u8(packed, 4), mask));
+            uint32x2_t v3 = vreinterpret_u32_u8(vshr_n_u8(packed, 6));
+
+            return vcombine_u8(vreinterpret_u8_u32(vzip1_u32(v0, v1)),
+                               vreinterpret_u8_u32(vzip1_u32(v2, v3)));
+        }
+        case 2:
+        {
+            uint8x8_t packed = vld1_u8(src);
+
+            return vcombine_u8(vand_u8(packed, vdup_n_u8(15)), vshr_n_u8(packed, 4));
+        }
+        default:
+            return vld1q_u8(src);
+    }
+}
+
+void DecodePlaneNeon(const uint8_t* src, size_t numGroups, uint8_t* dst)
+{
+    const uint8_t* data = src + GetHeaderSize(numGroups);
+
+    for (size_t group = 0; group < numGroups; ++group, dst += GROUP_SIZE)
+    {
+        uint32_t code = GetGroupCode(src, group);
+
+        vst1q_u8(dst, UnpackGroupNeon(code, data));
+        data += GROUP_BYTES[code];
+    }
+}
+
+uint32_t RebuildWordsNeon(const uint8_t* planes, size_t numVertices, uint32_t prev,
+                          uint8_t* dst, size_t stride)
+{
+    const uint32x4_t zero = vdupq_n_u32(0);
+    const uint32x4_t one = vdupq_n_u32(1);
+
+    for (size_t i = 0; i < numVertices; i += GROUP_SIZE)
+    {
+        uint8x16_t b0 = vld1q_u8(planes + i);
+        uint8x16_t b1 = vld1q_u8(planes + PLANE_STRIDE + i);
+        uint8x16_t b2 = vld1q_u8(planes + 2 * PLANE_STRIDE + i);
+        uint8x16_t b3 = vld1q_u8(planes + 3 * PLANE_STRIDE + i);
+
+        uint16x8_t low01 = vreinterpretq_u16_u8(vzip1q_u8(b0, b1));
+        uint16x8_t low23 = vreinterpretq_u16_u8(vzip1q_u8(b2, b3));
+        uint16x8_t high01 = vreinterpretq_u16_u8(vzip2q_u8(b0, b1));
+        uint16x8_t high23 = vreinterpretq_u16_u8(vzip2q_u8(b2, b3));
+
+        uint32x4_t words[4] = {vreinterpretq_u32_u16(vzip1q_u16(low01, low23)),
+                               vreinterpretq_u32_u16(vzip2q_u16(low01, low23)),
+                               vreinterpretq_u32_u16(vzip1q_u16(high01, high23)),
+                               vreinterpretq_u32_u16(vzip2q_u16(high01, high23))};
+
+        uint8_t* out = dst + i * stride;
+
+        for (uint32x4_t zigzag : words)
+        {
+            uint32x4_t delta = veorq_u32(vshrq_n_u32(zigzag, 1),
+                                         vsubq_u32(zero, vandq_u32(zigzag, one)));
+
+            delta = vaddq_u32(delta, vextq_u32(zero, delta, 3));
+            delta = vaddq_u32(delta, vextq_u32(zero, delta, 2));
+
+            uint32x4_t values = vaddq_u32(delta, vdupq_n_u32(prev));
+            prev = vgetq_lane_u32(values, 3);
+
+            StoreWord(out, static_cast<int>(vgetq_lane_u32(values, 0)));
+            StoreWord(out + stride, static_cast<int>(vgetq_lane_u32(values, 1)));
+            StoreWord(out + 2 * stride, static_cast<int>(vgetq_lane_u32(values, 2)));
+            StoreWord(out + 3 * stride, static_cast<int>(prev));
+            out += 4 * stride;
+        }
+    }
+
+    return prev;
+}
+
+#endif
+
+VertexKernels GetVertexKernels(SimdLevel level)
+{
+    if (!IsSimdLevelSupported(level))
+        throw std::runtime_error("SIMD level not supported.");
+
+    switch (level)
+    {
+#if defined(GRFX_SIMD_X86)
+        case SimdLevel::Sse41:
+            return {DecodePlaneSse41, RebuildWordsSse41};
+        case SimdLevel::Avx2:
+            return {DecodePlaneSse41, RebuildWordsAvx2};
+#elif defined(GRFX_SIMD_NEON)
+        case SimdLevel::Neon:
+            return {DecodePlaneNeon, RebuildWordsNeon};
+#endif
+        default:
+            return {DecodePlaneScalar, RebuildWordsScalar};
+    }
+}
+
+// Index data
+
+// Values are stored as LEB128 varints, with signed values zigzag-encoded first.
+class Writer
+{
+public:
+    void WriteByte(uint8_t value)
+    {
+        m_data.push_back(static_cast<std::byte>(value));
+    }
+
+    void WriteBytes(const void* src, size_t size)
+    {
+        const std::byte* bytes = static_cast<const std::byte*>(src);
+        m_data.insert(m_data.end(), bytes, bytes + size);
+    }
+
+    template<typename T>
+    void WriteValue(T value)
+    {
+        WriteBytes(&value, sizeof(value));
+    }
+
+    void WriteVarint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            WriteByte(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+
+        WriteByte(static_cast<uint8_t>(value));
+    }
+
+    void WriteSigned(int64_t value)
+    {
+        WriteVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    std::vector<std::byte>& GetData()
+    {
+        return m_data;
+    }
+
+private:
+    std::vector<std::byte> m_data;
+};
+
+class Reader
+{
+public:
+    explicit Reader(std::span<const std::byte> data)
+        : m_data(data)
+    {
+    }
+
+    uint8_t ReadByte()
+    {
+        if (m_pos >= m_data.size())
+            throw std::runtime_error("Truncated geometry data.");
+
+        return static_cast<uint8_t>(m_data[m_pos++]);
+    }
+
+    template<typename T>
+    T ReadValue()
+    {
+        if (m_data.size() - m_pos < sizeof(T))
+            throw std::runtime_error("Truncated geometry data.");
+
+        T value;
+        std::memcpy(&value, m_data.data() + m_pos, sizeof(T));
+        m_pos += sizeof(T);
+
+        return value;
+    }
+
+    std::span<const std::byte> ReadSpan(size_t size)
+    {
+        if (m_data.size() - m_pos < size)
+            throw std::runtime_error("Truncated geometry data.");
+
+        std::span<const std::byte> span = m_data.subspan(m_pos, size);
+        m_pos += size;
+
+        return span;
+    }
+
+    uint64_t ReadVarint()
+    {
+        uint64_t value = 0;
+
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t byte = ReadByte();
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+
+        throw std::runtime_error("Invalid varint in geometry data.");
+    }
+
+    int64_t ReadSigned()
+    {
+        uint64_t value = ReadVarint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    size_t GetPosition() const
+    {
+        return m_pos;
+    }
+
+    bool IsAtEnd() const
+    {
+        return m_pos == m_data.size();
+    }
+
+private:
+    std::span<const std::byte> m_data;
+    size_t m_pos = 0;
+};
+
+// Both FIFOs hold this many entries. Edge code 15 means no edge, so only 15 edges are ever named.
+constexpr uint32_t FIFO_SIZE = 16;
+constexpr uint32_t NO_EDGE = 15;
+
+// Marks FIFO entries that were never filled.
+constexpr uint32_t UNUSED = UINT32_MAX;
+
+// How a vertex is coded: as the next vertex not yet used, as an entry of the vertex FIFO (a byte
+// with the entry follows), or as a delta from the last vertex that was neither (a varint follows).
+enum class VertexCode : uint32_t
+{
+    Next,
+    Recent,
+    Delta
+};
+
+// The part of the coder's state that the encoder and decoder keep in lockstep. Entries are named
+// by age, with 0 the newest.
+class TriangleCoderState
+{
+public:
+    TriangleCoderState()
+    {
+        std::fill_n(m_edges, FIFO_SIZE, Edge{UNUSED, UNUSED});
+        std::fill_n(m_vertices, FIFO_SIZE, UNUSED);
+    }
+
+    struct Edge
+    {
+        uint32_t A;
+        uint32_t B;
+    };
+
+    Edge GetEdge(uint32_t age) const
+    {
+        return m_edges[(m_numEdges - 1 - age) % FIFO_SIZE];
+    }
+
+    // Edges are pushed reversed, as they appear in the triangle on their other side.
+    void PushEdge(uint32_t a, uint32_t b)
+    {
+        m_edges[m_numEdges++ % FIFO_SIZE] = {b, a};
+    }
+
+    uint32_t GetVertex(uint32_t age) const
+    {
+        return m_vertices[(m_numVertices - 1 - age) % FIFO_SIZE];
+    }
+
+    // Returns the age of |vertex| in the FIFO, or FIFO_SIZE if it is not there.
+    uint32_t FindVertex(uint32_t vertex) const
+    {
+        for (uint32_t age = 0; age < FIFO_SIZE; ++age)
+        {
+            if (GetVertex(age) == vertex)
+                return age;
+        }
+
+        return FIFO_SIZE;
+    }
+
+    // Codes |vertex| and updates the state to match. |extra| is the FIFO age or delta.
+    VertexCode Encode(uint32_t vertex, int64_t* extra)
+    {
+        if (vertex == m_next)
+        {
+            AddVertex(m_next++);
+            return VertexCode::Next;
+        }
+
+        uint32_t age = FindVertex(vertex);
+
+        if (age < FIFO_SIZE)
+        {
+            *extra = age;
+            return VertexCode::Recent;
+        }
+
+        *extra = static_cast<int64_t>(vertex) - m_last;
+        AddVertex(vertex);
+
+        return VertexCode::Delta;
+    }
+
+    uint32_t Decode(VertexCode code, Reader* reader)
+    {
+        switch (code)
+        {
+            case VertexCode::Next:
+            {
+                if (m_next > UINT16_MAX)
+                    throw std::runtime_error("Corrupt triangle data.");
+
+                AddVertex(m_next);
+                return m_next++;
+            }
+            case VertexCode::Recent:
+            {
+                uint8_t age = reader->ReadByte();
+                uint32_t vertex = age < FIFO_SIZE ? GetVertex(age) : UNUSED;
+
+                if (vertex == UNUSED)
+                    throw std::runtime_error("Corrupt triangle data.");
+
+                return vertex;
+            }
+            case VertexCode::Delta:
+            {
+                int64_t vertex = m_last + reader->ReadSigned();
+
+                if (vertex < 0 || vertex > UINT16_MAX)
+                    throw std::runtime_error("Corrupt triangle data.");
+
+                AddVertex(static_cast<uint32_t>(vertex));
+                return static_cast<uint32_t>(vertex);
+            }
+            default:
+                throw std::runtime_error("Corrupt triangle data.");
+        }
+    }
+
+private:
+    void AddVertex(uint32_t vertex)
+    {
+        m_vertices[m_numVertices++ % FIFO_SIZE] = vertex;
+        m_last = vertex;
+    }
+
+    Edge m_edges[FIFO_SIZE];
+    uint32_t m_numEdges = 0;
+
+    uint32_t m_vertices[FIFO_SIZE];
+    uint32_t m_numVertices = 0;
+
+    uint32_t m_next = 0;
+    int64_t m_last = 0;
+};
+
+void WriteVertexExtra(VertexCode code, int64_t extra, Writer* writer)
+{
+    if (code == VertexCode::Recent)
+        writer->WriteByte(static_cast<uint8_t>(extra));
+    else if (code == VertexCode::Delta)
+        writer->WriteSigned(extra);
+}
+
+// Buffers
+
+constexpr char fileMagic[4] = {'G', 'G', 'E', 'O'};
+constexpr uint32_t fileVersion = 1;
+
+// Magic, version, segment count, decoded size and payload hash.
+constexpr size_t FILE_HEADER_SIZE = 28;
+
+void CheckMagic(Reader* reader)
+{
+    char magic[4];
+
+    for (char& c : magic)
+    {
+        c = static_cast<char>(reader->ReadByte());
+    }
+
+    if (std::memcmp(magic, fileMagic, sizeof(magic)) != 0)
+        throw std::runtime_error("Not an encoded geometry buffer.");
+
+    if (reader->ReadValue<uint32_t>() != fileVersion)
+        throw std::runtime_error("Unsupported geometry buffer version.");
+}
+
+// Codes one segment, falling back to storing it as is if the codec cannot take it or does not
+// make it smaller.
+std::vector<std::byte> EncodeSegment(std::span<const std::byte> data, GeometrySegment* segment)
+{
+    std::vector<std::byte> encoded;
+
+    if (segment->Type == GeometrySegment::Kind::Vertices && segment->ByteStride > 0 &&
+        segment->ByteStride % 4 == 0 && segment->ByteStride <= MAX_VERTEX_STRIDE &&
+        data.size() % segment->ByteStride == 0)
+    {
+        encoded = EncodeVertices(data, segment->ByteStride);
+    }
+    else if (segment->Type == GeometrySegment::Kind::Triangles &&
+             segment->ByteOffset % sizeof(uint16_t) == 0 && data.size() % 6 == 0)
+    {
+        std::vector<uint16_t> indices(data.size() / sizeof(uint16_t));
+        std::memcpy(indices.data(), data.data(), data.size());
+
+        encoded = EncodeTriangles(indices);
+    }
+    else
+    {
+        segment->Type = GeometrySegment::Kind::Raw;
+    }
+
+    if (segment->Type == GeometrySegment::Kind::Raw || encoded.size() >= data.size())
+    {
+        segment->Type = GeometrySegment::Kind::Raw;
+        encoded.assign(data.begin(), data.end());
+    }
+
+    return encoded;
+}
+
+} // namespace
+
+std::vector<std::byte> EncodeVertices(std::span<const std::byte> vertices, size_t stride)
+{
+    CheckStride(stride);
+
+    if (vertices.size() % stride != 0)
+        throw std::runtime_error("Vertex data is not a whole number of vertices.");
+
+    size_t count = vertices.size() / stride;
+    size_t numWords = stride / 4;
+    size_t blockVertices = GetBlockVertices(stride);
+
+    std::vector<std::byte> encoded;
+    std::vector<uint32_t> prev(numWords, 0);
+
+    uint8_t planes[4][MAX_BLOCK_VERTICES];
+
+    for (size_t blockStart = 0; blockStart < count; blockStart += blockVertices)
+    {
+        size_t numVertices = std::min(blockVertices, count - blockStart);
+        size_t numGroups = (numVertices + GROUP_SIZE - 1) / GROUP_SIZE;
+
+        for (size_t word = 0; word < numWords; ++word)
+        {
+            // Padding past the last vertex stays zero, i.e. repeats it.
+            std::memset(planes, 0, sizeof(planes));
+
+            for (size_t i = 0; i < numVertices; ++i)
+            {
+                uint32_t value;
+                std::memcpy(&value, vertices.data() + (blockStart + i) * stride + word * 4,
+                            sizeof(value));
+
+                uint32_t zigzag = ZigzagEncode(value - prev[word]);
+                prev[word] = value;
+
+                for (size_t plane = 0; plane < 4; ++plane)
+                {
+                    planes[plane][i] = static_cast<uint8_t>(zigzag >> (8 * plane));
+                }
+            }
+
+            for (const uint8_t* plane : planes)
+            {
+                EncodePlane(plane, numGroups, &encoded);
+            }
+        }
+    }
+
+    return encoded;
+}
+
+void DecodeVertices(std::span<const std::byte> encoded, size_t count, size_t stride,
+                    std::byte* dst)
+{
+    DecodeVertices(encoded, count, stride, dst, GetPixelKernels().Level);
+}
+
+void DecodeVertices(std::span<const std::byte> encoded, size_t count, size_t stride,
+                    std::byte* dst, SimdLevel level)
+{
+    CheckStride(stride);
+
+    VertexKernels kernels = GetVertexKernels(level);
+
+    size_t numWords = stride / 4;
+    size_t blockVertices = GetBlockVertices(stride);
+
+    alignas(16) uint8_t planes[4 * PLANE_STRIDE];
+    alignas(16) uint8_t block[BLOCK_BYTES];
+    uint32_t prev[MAX_VERTEX_STRIDE / 4] = {};
+
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(encoded.data());
+    const uint8_t* end = src + encoded.size();
+
+    for (size_t blockStart = 0; blockStart < count; blockStart += blockVertices)
+    {
+        size_t numVertices = std::min(blockVertices, count - blockStart);
+        size_t numGroups = (numVertices + GROUP_SIZE - 1) / GROUP_SIZE;
+        size_t headerSize = GetHeaderSize(numGroups);
+
+        for (size_t word = 0; word < numWords; ++word)
+        {
+            for (size_t plane = 0; plane < 4; ++plane)
+            {
+                if (static_cast<size_t>(end - src) < headerSize)
+                    throw std::runtime_error("Truncated geometry data.");
+
+                size_t planeSize = headerSize;
+
+                for (size_t group = 0; group < numGroups; ++group)
+                {
+                    planeSize += GROUP_BYTES[GetGroupCode(src, group)];
+                }
+
+                if (static_cast<size_t>(end - src) < planeSize)
+                    throw std::runtime_error("Truncated geometry data.");
+
+                kernels.DecodePlane(src, numGroups, planes + plane * PLANE_STRIDE);
+                src += planeSize;
+            }
+
+            prev[word] = kernels.RebuildWords(planes, numGroups * GROUP_SIZE, prev[word],
+                                              block + word * 4, stride);
+        }
+
+        std::memcpy(dst + blockStart * stride, block, numVertices * stride);
+    }
+
+    if (src != end)
+        throw std::runtime_error("Trailing data after vertices.");
+}
+
+std::vector<std::byte> EncodeTriangles(std::span<const uint16_t> indices)
+{
+    if (indices.size() % 3 != 0)
+        throw std::runtime_error("Index count is not a multiple of 3.");
+
+    TriangleCoderState state;
+    Writer writer;
+
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        uint32_t tri[3] = {indices[i], indices[i + 1], indices[i + 2]};
+
+        uint32_t edge = NO_EDGE;
+        uint32_t rotation = 0;
+
+        for (uint32_t age = 0; age < NO_EDGE && edge == NO_EDGE; ++age)
+        {
+            TriangleCoderState::Edge candidate = state.GetEdge(age);
+
+            for (uint32_t r = 0; r < 3; ++r)
+            {
+                if (candidate.A == tri[r] && candidate.B == tri[(r + 1) % 3])
+                {
+                    edge = age;
+                    rotation = r;
+                    break;
+                }
+            }
+        }
+
+        if (edge != NO_EDGE)
+        {
+            uint32_t a = tri[rotation];
+            uint32_t b = tri[(rotation + 1) % 3];
+            uint32_t c = tri[(rotation + 2) % 3];
+
+            int64_t extra = 0;
+            VertexCode code = state.Encode(c, &extra);
+
+            writer.WriteByte(static_cast<uint8_t>(edge << 4 | rotation << 2 |
+                                                  static_cast<uint32_t>(code)));
+            WriteVertexExtra(code, extra, &writer);
+
+            state.PushEdge(b, c);
+            state.PushEdge(c, a);
+        }
+        else
+        {
+            VertexCode codes[3];
+            int64_t extras[3] = {};
+            uint32_t packedCodes = 0;
+
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                codes[k] = state.Encode(tri[k], &extras[k]);
+                packedCodes |= static_cast<uint32_t>(codes[k]) << (2 * k);
+            }
+
+            writer.WriteByte(NO_EDGE << 4);
+            writer.WriteByte(static_cast<uint8_t>(packedCodes));
+
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                WriteVertexExtra(codes[k], extras[k], &writer);
+            }
+
+            state.PushEdge(tri[0], tri[1]);
+            state.PushEdge(tri[1], tri[2]);
+            state.PushEdge(tri[2], tri[0]);
+        }
+    }
+
+    return std::move(writer.GetData());
+}
+
+void DecodeTriangles(std::span<const std::byte> encoded, size_t count, uint16_t* dst)
+{
+    if (count % 3 != 0)
+        throw std::runtime_error("Index count is not a multiple of 3.");
+
+    TriangleCoderState state;
+    Reader reader(encoded);
+
+    for (size_t i = 0; i < count; i += 3)
+    {
+        uint8_t header = reader.ReadByte();
+        uint32_t edge = header >> 4;
+
+        uint32_t tri[3];
+
+        if (edge != NO_EDGE)
+        {
+            uint32_t rotation = (header >> 2) & 3;
+
+            TriangleCoderState::Edge shared = state.GetEdge(edge);
+
+            if (rotation > 2 || shared.A == UNUSED)
+                throw std::runtime_error("Corrupt triangle data.");
+
+            uint32_t c = state.Decode(static_cast<VertexCode>(header & 3), &reader);
+
+            tri[rotation] = shared.A;
+            tri[(rotation + 1) % 3] = shared.B;
+            tri[(rotation + 2) % 3] = c;
+
+            state.PushEdge(shared.B, c);
+            state.PushEdge(c, shared.A);
+        }
+        else
+        {
+            uint8_t packedCodes = reader.ReadByte();
+
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                tri[k] = state.Decode(static_cast<VertexCode>((packedCodes >> (2 * k)) & 3),
+                                      &reader);
+            }
+
+            state.PushEdge(tri[0], tri[1]);
+            state.PushEdge(tri[1], tri[2]);
+            state.PushEdge(tri[2], tri[0]);
+        }
+
+        dst[i] = static_cast<uint16_t>(tri[0]);
+        dst[i + 1] = static_cast<uint16_t>(tri[1]);
+        dst[i + 2] = static_cast<uint16_t>(tri[2]);
+    }
+
+    if (!reader.IsAtEnd())
+        throw std::runtime_error("Trailing data after triangles.");
+}
+
+std::vector<std::byte> EncodeGeometryBuffer(std::span<const std::byte> buffer,
+                                            std::span<const GeometrySegment> segments)
+{
+    PROFILE_SCOPE("EncodeGeometryBuffer");
+
+    std::vector<GeometrySegment> sorted(segments.begin(), segments.end());
+
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        return a.ByteOffset < b.ByteOffset;
+    });
+
+    // Gaps between segments become raw segments of their own, so the segments cover the buffer.
+    std::vector<GeometrySegment> covering;
+    size_t offset = 0;
+
+    for (const GeometrySegment& segment : sorted)
+    {
+        if (segment.ByteOffset < offset || segment.ByteSize > buffer.size() ||
+            segment.ByteOffset > buffer.size() - segment.ByteSize)
+            throw std::runtime_error("Geometry segments overlap or exceed the buffer.");
+
+        if (segment.ByteOffset > offset)
+            covering.push_back({GeometrySegment::Kind::Raw, offset, segment.ByteOffset - offset});
+
+        if (segment.ByteSize > 0)
+            covering.push_back(segment);
+
+        offset = segment.ByteOffset + segment.ByteSize;
+    }
+
+    if (offset < buffer.size())
+        covering.push_back({GeometrySegment::Kind::Raw, offset, buffer.size() - offset});
+
+    std::vector<std::vector<std::byte>> payloads;
+
+    for (GeometrySegment& segment : covering)
+    {
+        payloads.push_back(
+            EncodeSegment(buffer.subspan(segment.ByteOffset, segment.ByteSize), &segment));
+    }
+
+    Writer payloadWriter;
+
+    for (size_t i = 0; i < covering.size(); ++i)
+    {
+        payloadWriter.WriteValue(static_cast<uint32_t>(covering[i].Type));
+        payloadWriter.WriteValue(static_cast<uint32_t>(covering[i].ByteStride));
+        payloadWriter.WriteValue(static_cast<uint64_t>(covering[i].ByteSize));
+        payloadWriter.WriteValue(static_cast<uint64_t>(payloads[i].size()));
+    }
+
+    for (const std::vector<std::byte>& payload : payloads)
+    {
+        payloadWriter.WriteBytes(payload.data(), payload.size());
+    }
+
+    std::vector<std::byte>& payload = payloadWriter.GetData();
+
+    Writer writer;
+    writer.WriteBytes(fileMagic, sizeof(fileMagic));
+    writer.WriteValue(fileVersion);
+    writer.WriteValue(static_cast<uint32_t>(covering.size()));
+    writer.WriteValue(static_cast<uint64_t>(buffer.size()));
+    writer.WriteValue(HashContent(payload));
+    writer.WriteBytes(payload.data(), payload.size());
+
+    return std::move(writer.GetData());
+}
+
+bool IsGeometryBuffer(std::span<const std::byte> data)
+{
+    return data.size() >= FILE_HEADER_SIZE &&
+        std::memcmp(data.data(), fileMagic, sizeof(fileMagic)) == 0;
+}
+
+size_t GetDecodedGeometryBufferSize(std::span<const std::byte> encoded)
+{
+    Reader reader(encoded);
+    CheckMagic(&reader);
+
+    reader.ReadValue<uint32_t>();
+
+    return reader.ReadValue<uint64_t>();
+}
+
+void DecodeGeometryBuffer(std::span<const std::byte> encoded, std::span<std::byte> dst)
+{
+    PROFILE_SCOPE("DecodeGeometryBuffer");
+
+    Reader reader(encoded);
+    CheckMagic(&reader);
+
+    uint32_t numSegments = reader.ReadValue<uint32_t>();
+    uint64_t decodedSize = reader.ReadValue<uint64_t>();
+    uint64_t payloadHash = reader.ReadValue<uint64_t>();
+
+    if (decodedSize != dst.size())
+        throw std::runtime_error("Destination does not match the decoded size.");
+
+    if (HashContent(encoded.subspan(reader.GetPosition())) != payloadHash)
+        throw std::runtime_error("Corrupt geometry buffer.");
+
+    struct SegmentHeader
+    {
+        uint32_t Type;
+        uint32_t ByteStride;
+        uint64_t ByteSize;
+        uint64_t EncodedSize;
+    };
+
+    std::vector<SegmentHeader> headers(numSegments);
+
+    for (SegmentHeader& header : headers)
+    {
+        header.Type = reader.ReadValue<uint32_t>();
+        header.ByteStride = reader.ReadValue<uint32_t>();
+        header.ByteSize = reader.ReadValue<uint64_t>();
+        header.EncodedSize = reader.ReadValue<uint64_t>();
+    }
+
+    size_t offset = 0;
+
+    for (const SegmentHeader& header : headers)
+    {
+        std::span<const std::byte> payload = reader.ReadSpan(header.EncodedSize);
+
+        if (header.ByteSize > dst.size() - offset)
+            throw std::runtime_error("Corrupt geometry buffer.");
+
+        std::byte* out = dst.data() + offset;
+
+        switch (static_cast<GeometrySegment::Kind>(header.Type))
+        {
+            case GeometrySegment::Kind::Raw:
+                if (payload.size() != header.ByteSize)
+                    throw std::runtime_error("Corrupt geometry buffer.");
+
+                if (!payload.empty())
+                    std::memcpy(out, payload.data(), payload.size());
+
+                break;
+            case GeometrySegment::Kind::Vertices:
+                CheckStride(header.ByteStride);
+
+                if (header.ByteSize % header.ByteStride != 0)
+                    throw std::runtime_error("Corrupt geometry buffer.");
+
+                DecodeVertices(payload, header.ByteSize / header.ByteStride, header.ByteStride,
+                               out);
+                break;
+            case GeometrySegment::Kind::Triangles:
+                if (offset % sizeof(uint16_t) != 0 || header.ByteSize % 6 != 0)
+                    throw std::runtime_error("Corrupt geometry buffer.");
+
+                DecodeTriangles(payload, header.ByteSize / sizeof(uint16_t),
+                                reinterpret_cast<uint16_t*>(out));
+                break;
+            default:
+                throw std::runtime_error("Corrupt geometry buffer.");
+        }
+
+        offset += header.ByteSize;
+    }
+
+    if (offset != dst.size() || !reader.IsAtEnd())
+        throw std::runtime_error("Corrupt geometry buffer.");
+}
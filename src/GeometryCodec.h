@@ -0,0 +1,73 @@
+#pragma once
+
+#include "PixelKernels.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Lossless compression of vertex and index data for storage on disk. Decoding writes its output
+// front to back without reading it, so it can go straight into write-combined upload memory.
+// Decoders throw on truncated or corrupt input rather than reading or writing out of bounds.
+
+// Vertex elements may be up to this large, and their size must be a multiple of 4.
+constexpr size_t MAX_VERTEX_STRIDE = 256;
+
+// Each 32-bit word of a vertex is stored as the zigzag-encoded difference from the same word of
+// the previous vertex. Those differences are split into byte planes, and every 16 bytes of a
+// plane are packed at 0, 2, 4 or 8 bits each. Bytes that vary smoothly across vertices - the high
+// bytes of positions, normals and texture coordinates - mostly pack to nothing.
+std::vector<std::byte> EncodeVertices(std::span<const std::byte> vertices, size_t stride);
+
+// Writes |count| vertices of |stride| bytes to |dst|. Uses the fastest kernels the CPU supports
+// unless |level| is given.
+void DecodeVertices(std::span<const std::byte> encoded, size_t count, size_t stride,
+                    std::byte* dst);
+void DecodeVertices(std::span<const std::byte> encoded, size_t count, size_t stride,
+                    std::byte* dst, SimdLevel level);
+
+// Triangle lists are coded against a FIFO of recently seen edges: a triangle sharing an edge with
+// a recent one mostly takes a single byte, naming the edge and whether the third vertex is the
+// next unused one. Other vertices are found in a FIFO of recent vertices, or stored as deltas.
+// Index order within each triangle is kept, so decoding gives back the exact input.
+std::vector<std::byte> EncodeTriangles(std::span<const uint16_t> indices);
+
+// Writes |count| indices to |dst|. |count| must be a multiple of 3.
+void DecodeTriangles(std::span<const std::byte> encoded, size_t count, uint16_t* dst);
+
+// A part of a buffer and how to code it. Parts not covered by any segment are stored as is.
+struct GeometrySegment
+{
+    enum class Kind : uint32_t
+    {
+        Raw,
+        Vertices,
+        Triangles
+    };
+
+    Kind Type = Kind::Raw;
+
+    size_t ByteOffset = 0;
+    size_t ByteSize = 0;
+
+    // Vertex size, for vertex segments.
+    size_t ByteStride = 0;
+};
+
+// Codes a whole buffer, such as the binary buffer of a glTF file, given segments that may not
+// overlap. Segments that the codecs cannot take - a vertex segment that is not a whole number of
+// vertices, say - are stored as is.
+std::vector<std::byte> EncodeGeometryBuffer(std::span<const std::byte> buffer,
+                                            std::span<const GeometrySegment> segments);
+
+// Whether |data| starts like an encoded geometry buffer.
+bool IsGeometryBuffer(std::span<const std::byte> data);
+
+// Size of the buffer that |encoded| decodes to. Throws if it is not an encoded geometry buffer.
+size_t GetDecodedGeometryBufferSize(std::span<const std::byte> encoded);
+
+// Writes the exact bytes of the buffer that was encoded to |dst|, which must be
+// GetDecodedGeometryBufferSize() long. The encoded data carries a hash of itself, which is checked
+// first.
+void DecodeGeometryBuffer(std::span<const std::byte> encoded, std::span<std::byte> dst);
@@ -0,0 +1,636 @@
+// Benchmark for the geometry codec. Round-trips vertex streams of every supported stride through
+// each SIMD level, triangle lists of several orders and whole buffers with gaps, and checks that
+// corrupt input is rejected. Then measures the compression ratio and decode throughput of a
+// terrain mesh and of the buffers of glTF files. Exits with an error if any check fails.
+
+#include "BenchmarkUtils.h"
+#include "GeometryCodec.h"
+#include "GltfLoader.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+using benchmark::ElapsedMs;
+using benchmark::GbPerSec;
+using benchmark::MeasureMs;
+
+struct Options
+{
+    std::string OutPath = "geometry_codec_benchmark_results.json";
+
+    std::vector<std::string> ModelPaths = {"assets/sponza/Sponza.gltf", "assets/box/Box.gltf"};
+
+    // Quads per side of the terrain, which has (size + 1)^2 vertices.
+    int TerrainSize = 250;
+
+    int Iterations = 20;
+
+    // Writes the encoded copies of the models' buffers, which LoadGltfModelData() then reads.
+    bool WriteEncoded = false;
+};
+
+constexpr const char* USAGE =
+    "Usage: GeometryCodecBenchmark [options]\n"
+    "  --model FILE      glTF file to code, may be repeated (default Sponza and Box)\n"
+    "  --terrain N       Quads per terrain side, at most 254 (default 250)\n"
+    "  --iterations N    Decodes to time, keeping the fastest (default 20)\n"
+    "  --write-encoded   Write the encoded buffers next to the models' buffers\n"
+    "  --out FILE        Results file (default geometry_codec_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    bool modelGiven = false;
+
+    auto parseOption = [options, &modelGiven](const std::string& arg, const std::string& value) {
+        if (arg == "--write-encoded")
+        {
+            options->WriteEncoded = true;
+        }
+        else if (arg == "--model")
+        {
+            if (!modelGiven)
+                options->ModelPaths.clear();
+
+            options->ModelPaths.push_back(value);
+            modelGiven = true;
+        }
+        else if (arg == "--terrain")
+        {
+            options->TerrainSize = std::stoi(value);
+        }
+        else if (arg == "--iterations")
+        {
+            options->Iterations = std::stoi(value);
+        }
+        else if (arg == "--out")
+        {
+            options->OutPath = value;
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption, {"--write-encoded"}))
+        return false;
+
+    // Terrain vertices must fit 16-bit indices.
+    return options->TerrainSize > 0 && options->TerrainSize <= 254 && options->Iterations > 0;
+}
+
+std::vector<SimdLevel> GetSupportedLevels()
+{
+    std::vector<SimdLevel> levels;
+
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2, SimdLevel::Neon})
+    {
+        if (IsSimdLevelSupported(level))
+            levels.push_back(level);
+    }
+
+    return levels;
+}
+
+bool Throws(const std::function<void()>& fn)
+{
+    try
+    {
+        fn();
+    }
+    catch (const std::exception&)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+// Floats that vary smoothly from vertex to vertex, plus low-order noise, like real attributes.
+std::vector<std::byte> MakeSmoothVertices(size_t count, size_t stride, std::mt19937* rng)
+{
+    std::uniform_real_distribution<float> noise(-1e-3f, 1e-3f);
+    std::vector<float> values(count * stride / 4);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (size_t c = 0; c < stride / 4; ++c)
+        {
+            float t = static_cast<float>(i) * 0.01f + static_cast<float>(c);
+            values[i * stride / 4 + c] = std::sin(t) * 10.f + noise(*rng);
+        }
+    }
+
+    std::vector<std::byte> bytes(values.size() * sizeof(float));
+
+    if (!bytes.empty())
+        std::memcpy(bytes.data(), values.data(), bytes.size());
+
+    return bytes;
+}
+
+std::vector<std::byte> MakeRandomBytes(size_t size, std::mt19937* rng)
+{
+    std::vector<std::byte> bytes(size);
+
+    for (std::byte& byte : bytes)
+    {
+        byte = static_cast<std::byte>((*rng)() & 0xff);
+    }
+
+    return bytes;
+}
+
+bool CheckVertexRoundTrips(std::mt19937* rng)
+{
+    const size_t strides[] = {4, 8, 12, 16, 20, 32, 64, 256};
+    const size_t counts[] = {0, 1, 15, 16, 17, 255, 256, 257, 4099};
+
+    for (size_t stride : strides)
+    {
+        for (size_t count : counts)
+        {
+            for (bool smooth : {true, false})
+            {
+                std::vector<std::byte> vertices = smooth ?
+                    MakeSmoothVertices(count, stride, rng) : MakeRandomBytes(count * stride, rng);
+
+                std::vector<std::byte> encoded = EncodeVertices(vertices, stride);
+
+                for (SimdLevel level : GetSupportedLevels())
+                {
+                    std::vector<std::byte> decoded(vertices.size());
+                    DecodeVertices(encoded, count, stride, decoded.data(), level);
+
+                    if (decoded != vertices)
+                        return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+struct Terrain
+{
+    std::vector<std::byte> Positions;
+    std::vector<std::byte> Normals;
+    std::vector<std::byte> TexCoords;
+    std::vector<std::byte> Tangents;
+    std::vector<uint16_t> Indices;
+};
+
+template<typename T>
+void AppendValues(std::vector<std::byte>* bytes, std::initializer_list<T> values)
+{
+    for (T value : values)
+    {
+        const std::byte* src = reinterpret_cast<const std::byte*>(&value);
+        bytes->insert(bytes->end(), src, src + sizeof(value));
+    }
+}
+
+// A heightfield over the XZ plane, stored like a glTF file stores it: one stream per attribute and
+// a triangle list going row by row.
+Terrain MakeTerrain(int size)
+{
+    Terrain terrain;
+
+    auto height = [](float x, float z) {
+        return std::sin(x * 0.37f) * std::cos(z * 0.23f) * 4.f + std::sin(x * 1.7f + z) * 0.5f;
+    };
+
+    for (int z = 0; z <= size; ++z)
+    {
+        for (int x = 0; x <= size; ++x)
+        {
+            float fx = static_cast<float>(x) * 0.5f;
+            float fz = static_cast<float>(z) * 0.5f;
+            float y = height(fx, fz);
+
+            float dx = height(fx + 0.01f, fz) - height(fx - 0.01f, fz);
+            float dz = height(fx, fz + 0.01f) - height(fx, fz - 0.01f);
+            float length = std::sqrt(dx * dx + 0.02f * 0.02f + dz * dz);
+
+            AppendValues(&terrain.Positions, {fx, y, fz});
+            AppendValues(&terrain.Normals, {-dx / length, 0.02f / length, -dz / length});
+            AppendValues(&terrain.TexCoords, {fx / 8.f, fz / 8.f});
+            AppendValues(&terrain.Tangents, {0.02f / length, dx / length, 0.f, 1.f});
+        }
+    }
+
+    auto vertex = [&](int x, int z) {
+        return static_cast<uint16_t>(z * (size + 1) + x);
+    };
+
+    for (int z = 0; z < size; ++z)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            terrain.Indices.insert(terrain.Indices.end(),
+                                   {vertex(x, z), vertex(x, z + 1), vertex(x + 1, z),
+                                    vertex(x + 1, z), vertex(x, z + 1), vertex(x + 1, z + 1)});
+        }
+    }
+
+    return terrain;
+}
+
+bool TrianglesRoundTrip(const std::vector<uint16_t>& indices)
+{
+    std::vector<std::byte> encoded = EncodeTriangles(indices);
+
+    std::vector<uint16_t> decoded(indices.size());
+    DecodeTriangles(encoded, indices.size(), decoded.data());
+
+    return decoded == indices;
+}
+
+bool CheckTriangleRoundTrips(const Terrain& terrain, std::mt19937* rng)
+{
+    std::vector<uint16_t> shuffled = terrain.Indices;
+
+    // Whole triangles in random order, each rotated at random.
+    std::vector<size_t> order(shuffled.size() / 3);
+
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+
+    std::shuffle(order.begin(), order.end(), *rng);
+
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        size_t rotation = (*rng)() % 3;
+
+        for (size_t k = 0; k < 3; ++k)
+        {
+            shuffled[3 * i + k] = terrain.Indices[3 * order[i] + (k + rotation) % 3];
+        }
+    }
+
+    std::vector<uint16_t> random(3000);
+
+    for (uint16_t& index : random)
+    {
+        index = static_cast<uint16_t>((*rng)() & 0xffff);
+    }
+
+    std::vector<uint16_t> edgeCases = {0, 0, 0, 65535, 65535, 0, 1, 2, 3, 3, 2, 1, 65535, 1, 2};
+
+    return TrianglesRoundTrip({}) && TrianglesRoundTrip(terrain.Indices) &&
+        TrianglesRoundTrip(shuffled) && TrianglesRoundTrip(random) &&
+        TrianglesRoundTrip(edgeCases);
+}
+
+// Streams laid out like a glTF buffer, with unaligned padding between some of them and a
+// segment that is not a whole number of vertices.
+struct TestBuffer
+{
+    std::vector<std::byte> Data;
+    std::vector<GeometrySegment> Segments;
+};
+
+void AppendSegment(TestBuffer* buffer, std::span<const std::byte> data,
+                   GeometrySegment::Kind type, size_t stride, size_t padding)
+{
+    buffer->Data.resize(buffer->Data.size() + padding, std::byte{0x5a});
+    buffer->Segments.push_back({type, buffer->Data.size(), data.size(), stride});
+    buffer->Data.insert(buffer->Data.end(), data.begin(), data.end());
+}
+
+TestBuffer MakeTerrainBuffer(const Terrain& terrain)
+{
+    using Kind = GeometrySegment::Kind;
+
+    TestBuffer buffer;
+    AppendSegment(&buffer, terrain.Positions, Kind::Vertices, 12, 0);
+    AppendSegment(&buffer, terrain.Normals, Kind::Vertices, 12, 0);
+    AppendSegment(&buffer, terrain.TexCoords, Kind::Vertices, 8, 0);
+    AppendSegment(&buffer, terrain.Tangents, Kind::Vertices, 16, 0);
+    AppendSegment(&buffer, std::as_bytes(std::span(terrain.Indices)), Kind::Triangles, 0, 0);
+
+    return buffer;
+}
+
+bool BufferRoundTrips(const TestBuffer& buffer)
+{
+    std::vector<std::byte> encoded = EncodeGeometryBuffer(buffer.Data, buffer.Segments);
+
+    if (!IsGeometryBuffer(encoded) || GetDecodedGeometryBufferSize(encoded) != buffer.Data.size())
+        return false;
+
+    std::vector<std::byte> decoded(buffer.Data.size());
+    DecodeGeometryBuffer(encoded, decoded);
+
+    return decoded == buffer.Data;
+}
+
+bool CheckBufferRoundTrips(const Terrain& terrain, std::mt19937* rng)
+{
+    using Kind = GeometrySegment::Kind;
+
+    TestBuffer mixed;
+    AppendSegment(&mixed, terrain.Positions, Kind::Vertices, 12, 3);
+    AppendSegment(&mixed, terrain.Normals, Kind::Vertices, 12, 1);
+    AppendSegment(&mixed, std::span(terrain.TexCoords).first(100), Kind::Vertices, 8, 0);
+    AppendSegment(&mixed, std::as_bytes(std::span(terrain.Indices)), Kind::Triangles, 0, 0);
+    AppendSegment(&mixed, MakeRandomBytes(1000, rng), Kind::Vertices, 20, 2);
+    mixed.Data.resize(mixed.Data.size() + 7, std::byte{0x11});
+
+    TestBuffer empty;
+
+    return BufferRoundTrips(MakeTerrainBuffer(terrain)) && BufferRoundTrips(mixed) &&
+        BufferRoundTrips(empty);
+}
+
+bool CheckCorruptionRejected(const Terrain& terrain)
+{
+    TestBuffer buffer = MakeTerrainBuffer(terrain);
+    std::vector<std::byte> encoded = EncodeGeometryBuffer(buffer.Data, buffer.Segments);
+    std::vector<std::byte> decoded(buffer.Data.size());
+
+    std::vector<std::byte> flipped = encoded;
+    flipped[flipped.size() / 2] ^= std::byte{0x40};
+
+    std::vector<std::byte> truncated(encoded.begin(), encoded.end() - 1);
+
+    std::vector<std::byte> vertices = EncodeVertices(terrain.Positions, 12);
+    size_t numVertices = terrain.Positions.size() / 12;
+    std::vector<std::byte> triangles = EncodeTriangles(terrain.Indices);
+
+    return Throws([&] { DecodeGeometryBuffer(flipped, decoded); }) &&
+        Throws([&] { DecodeGeometryBuffer(truncated, decoded); }) &&
+        Throws([&] {
+            DecodeVertices(std::span(vertices).first(vertices.size() / 2), numVertices, 12,
+                           decoded.data());
+        }) &&
+        Throws([&] {
+            std::vector<uint16_t> indices(terrain.Indices.size());
+            DecodeTriangles(std::span(triangles).first(triangles.size() / 2), indices.size(),
+                            indices.data());
+        });
+}
+
+// Segments the codecs take rather than storing as is, ratios aside.
+bool IsVertexSegment(const GeometrySegment& segment)
+{
+    return segment.Type == GeometrySegment::Kind::Vertices &&
+        segment.ByteSize % segment.ByteStride == 0;
+}
+
+bool IsTriangleSegment(const GeometrySegment& segment)
+{
+    return segment.Type == GeometrySegment::Kind::Triangles && segment.ByteSize % 6 == 0;
+}
+
+// Sizes and decode speed of one buffer at every SIMD level.
+json MeasureBuffer(const TestBuffer& buffer, int iterations, bool* roundTrips)
+{
+    Clock::time_point start = Clock::now();
+    std::vector<std::byte> encoded = EncodeGeometryBuffer(buffer.Data, buffer.Segments);
+    double encodeMs = ElapsedMs(start);
+
+    size_t vertexBytes = 0;
+    size_t encodedVertexBytes = 0;
+    size_t indexBytes = 0;
+    size_t encodedIndexBytes = 0;
+
+    std::vector<std::byte> decoded(buffer.Data.size());
+    json vertexGbPerSec = json::object();
+
+    for (const GeometrySegment& segment : buffer.Segments)
+    {
+        std::span<const std::byte> data =
+            std::span(buffer.Data).subspan(segment.ByteOffset, segment.ByteSize);
+
+        if (IsVertexSegment(segment))
+        {
+            vertexBytes += data.size();
+            encodedVertexBytes += EncodeVertices(data, segment.ByteStride).size();
+        }
+        else if (IsTriangleSegment(segment))
+        {
+            std::vector<uint16_t> indices(data.size() / sizeof(uint16_t));
+            std::memcpy(indices.data(), data.data(), data.size());
+
+            indexBytes += data.size();
+            encodedIndexBytes += EncodeTriangles(indices).size();
+        }
+    }
+
+    // Vertex streams alone, at each level.
+    for (SimdLevel level : GetSupportedLevels())
+    {
+        std::vector<std::vector<std::byte>> streams;
+
+        for (const GeometrySegment& segment : buffer.Segments)
+        {
+            if (IsVertexSegment(segment))
+            {
+                streams.push_back(EncodeVertices(
+                    std::span(buffer.Data).subspan(segment.ByteOffset, segment.ByteSize),
+                    segment.ByteStride));
+            }
+        }
+
+        double ms = MeasureMs(iterations, [&] {
+            size_t i = 0;
+
+            for (const GeometrySegment& segment : buffer.Segments)
+            {
+                if (IsVertexSegment(segment))
+                {
+                    DecodeVertices(streams[i++], segment.ByteSize / segment.ByteStride,
+                                   segment.ByteStride, decoded.data() + segment.ByteOffset,
+                                   level);
+                }
+            }
+        });
+
+        vertexGbPerSec[GetSimdLevelName(level)] = GbPerSec(vertexBytes, ms);
+    }
+
+    std::vector<std::vector<std::byte>> triangleStreams;
+    std::vector<uint16_t> indices;
+
+    Clock::time_point encodeTrianglesStart = Clock::now();
+
+    for (const GeometrySegment& segment : buffer.Segments)
+    {
+        if (IsTriangleSegment(segment))
+        {
+            indices.resize(segment.ByteSize / sizeof(uint16_t));
+            std::memcpy(indices.data(), buffer.Data.data() + segment.ByteOffset, segment.ByteSize);
+
+            triangleStreams.push_back(EncodeTriangles(indices));
+        }
+    }
+
+    double encodeTrianglesMs = ElapsedMs(encodeTrianglesStart);
+
+    double decodeTrianglesMs = MeasureMs(iterations, [&] {
+        size_t i = 0;
+
+        for (const GeometrySegment& segment : buffer.Segments)
+        {
+            if (IsTriangleSegment(segment))
+            {
+                DecodeTriangles(triangleStreams[i++], segment.ByteSize / sizeof(uint16_t),
+                                reinterpret_cast<uint16_t*>(decoded.data() + segment.ByteOffset));
+            }
+        }
+    });
+
+    double bufferMs = MeasureMs(iterations, [&] { DecodeGeometryBuffer(encoded, decoded); });
+
+    *roundTrips = decoded == buffer.Data;
+
+    auto ratio = [](size_t encodedSize, size_t size) {
+        return size > 0 ? static_cast<double>(encodedSize) / static_cast<double>(size) : 1.0;
+    };
+
+    size_t numIndices = indexBytes / sizeof(uint16_t);
+
+    return {
+        {"bytes", buffer.Data.size()},
+        {"encoded_bytes", encoded.size()},
+        {"ratio", ratio(encoded.size(), buffer.Data.size())},
+        {"vertex_bytes", vertexBytes},
+        {"vertex_ratio", ratio(encodedVertexBytes, vertexBytes)},
+        {"index_bytes", indexBytes},
+        {"index_ratio", ratio(encodedIndexBytes, indexBytes)},
+        {"index_bits_per_triangle",
+         numIndices > 0 ? 8.0 * static_cast<double>(encodedIndexBytes) /
+                              static_cast<double>(numIndices / 3) : 0.0},
+        {"encode_ms", encodeMs},
+        {"vertex_decode_gb_per_sec", vertexGbPerSec},
+        {"index_encode_ms", encodeTrianglesMs},
+        {"index_decode_millions_per_sec",
+         static_cast<double>(numIndices) / (decodeTrianglesMs * 1e3)},
+        {"buffer_decode_gb_per_sec", GbPerSec(buffer.Data.size(), bufferMs)}
+    };
+}
+
+std::vector<std::byte> ReadFile(const fs::path& path)
+{
+    std::ifstream strm(path, std::ios::binary);
+
+    if (!strm)
+        throw std::runtime_error("Could not open file.");
+
+    std::vector<std::byte> data(fs::file_size(path));
+    strm.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+    return data;
+}
+
+int RunBenchmark(const Options& options)
+{
+    Checks checks;
+    std::mt19937 rng(1234);
+
+    Terrain terrain = MakeTerrain(options.TerrainSize);
+
+    checks.Check("vertex_round_trip", CheckVertexRoundTrips(&rng));
+    checks.Check("triangle_round_trip", CheckTriangleRoundTrips(terrain, &rng));
+    checks.Check("buffer_round_trip", CheckBufferRoundTrips(terrain, &rng));
+    checks.Check("corruption_rejected", CheckCorruptionRejected(terrain));
+
+    bool terrainRoundTrips = false;
+    json terrainResults = MeasureBuffer(MakeTerrainBuffer(terrain), options.Iterations,
+                                        &terrainRoundTrips);
+
+    checks.Check("terrain_round_trip", terrainRoundTrips);
+    checks.Check("terrain_compressed", terrainResults["ratio"].get<double>() < 0.75);
+
+    json models = json::object();
+
+    for (const std::string& modelPath : options.ModelPaths)
+    {
+        std::vector<GltfBufferLayout> layouts = GetGltfBufferLayouts(modelPath);
+
+        // Sponza's buffer is not part of every checkout.
+        bool missing = std::any_of(layouts.begin(), layouts.end(), [](const auto& layout) {
+            return !fs::exists(layout.Path);
+        });
+
+        if (missing)
+        {
+            std::printf("Skipping %s, whose buffers are missing.\n", modelPath.c_str());
+            continue;
+        }
+
+        json buffers = json::array();
+
+        for (const GltfBufferLayout& layout : layouts)
+        {
+            bool roundTrips = false;
+            TestBuffer buffer{ReadFile(layout.Path), layout.Segments};
+
+            json bufferResults = MeasureBuffer(buffer, options.Iterations, &roundTrips);
+            bufferResults["path"] = layout.Path.generic_string();
+
+            checks.Check("model_round_trip_" + layout.Path.filename().string(), roundTrips);
+            buffers.push_back(bufferResults);
+        }
+
+        if (options.WriteEncoded)
+            WriteEncodedGltfBuffers(modelPath);
+
+        models[modelPath] = buffers;
+    }
+
+    json results = {
+        {"selected_level", GetSimdLevelName(GetPixelKernels().Level)},
+        {"terrain_size", options.TerrainSize},
+        {"terrain", terrainResults},
+        {"models", models},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Geometry codec checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
@@ -0,0 +1,513 @@
+#include "GeometryOptimizer.h"
+
+#include "Hash.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+// Positions, normals, texture coordinates and tangents, in that order.
+constexpr int NUM_STREAMS = 4;
+constexpr size_t STREAM_COMPONENTS[NUM_STREAMS] = {3, 3, 2, 4};
+
+std::array<BufferRange*, NUM_STREAMS> GetStreamRanges(PrimitiveData* prim)
+{
+    return {&prim->Positions, &prim->Normals, &prim->TexCoords, &prim->Tangents};
+}
+
+// One primitive's contents, each attribute tightly packed. Absent attributes are empty.
+struct Geometry
+{
+    uint32_t NumVertices = 0;
+
+    std::vector<float> Streams[NUM_STREAMS];
+    std::vector<uint16_t> Indices;
+
+    uint64_t Hash = 0;
+};
+
+template<typename T>
+void ReadRange(const ModelData& model, const BufferRange& range, size_t numComponents,
+               std::vector<T>* values)
+{
+    if (range.Buffer >= static_cast<int>(model.Buffers.size()))
+        throw std::runtime_error("Accessor buffer out of range.");
+
+    const std::vector<std::byte>& buffer = model.Buffers[range.Buffer];
+    size_t elementSize = sizeof(T) * numComponents;
+
+    if (range.Count > 0 &&
+        range.ByteOffset + (range.Count - 1) * range.ByteStride + elementSize > buffer.size())
+        throw std::runtime_error("Accessor out of bounds.");
+
+    values->resize(range.Count * numComponents);
+
+    for (size_t i = 0; i < range.Count; ++i)
+    {
+        std::memcpy(values->data() + i * numComponents,
+                    buffer.data() + range.ByteOffset + i * range.ByteStride, elementSize);
+    }
+}
+
+Geometry ReadGeometry(const ModelData& model, PrimitiveData* prim)
+{
+    Geometry geometry;
+    geometry.NumVertices = prim->Positions.Count;
+
+    std::array<BufferRange*, NUM_STREAMS> ranges = GetStreamRanges(prim);
+
+    for (int i = 0; i < NUM_STREAMS; ++i)
+    {
+        if (!ranges[i]->IsValid())
+            continue;
+
+        if (ranges[i]->Count != geometry.NumVertices)
+            throw std::runtime_error("Attribute counts differ.");
+
+        ReadRange(model, *ranges[i], STREAM_COMPONENTS[i], &geometry.Streams[i]);
+    }
+
+    ReadRange(model, prim->Indices, 1, &geometry.Indices);
+
+    for (uint16_t index : geometry.Indices)
+    {
+        if (index >= geometry.NumVertices)
+            throw std::runtime_error("Index out of range.");
+    }
+
+    return geometry;
+}
+
+constexpr uint32_t NO_VERTEX = UINT32_MAX;
+
+// Cells are this many position epsilons wide, so that most positions are more than an epsilon
+// from every face of their cell.
+constexpr double CELL_EPSILONS = 4.0;
+
+// Cell of a position in a grid of cubes. A position within the epsilon of another lies in its cell
+// or, along each axis where it is within the epsilon of a face, in the cell across that face.
+struct PositionCell
+{
+    int64_t Coords[3];
+
+    // Per axis, -1 or +1 towards the face the position is within the epsilon of, or 0 if there is
+    // none. Always 0 when only exact copies are welded and the coordinate is the component's bits.
+    int Side[3];
+};
+
+PositionCell GetPositionCell(const float* position, double invCellSize)
+{
+    PositionCell cell{};
+
+    for (int c = 0; c < 3; ++c)
+    {
+        float value = position[c];
+
+        if (invCellSize > 0.0 && std::isfinite(value))
+        {
+            double scaled = value * invCellSize;
+            double coord = std::floor(scaled);
+            double offset = (scaled - coord) * CELL_EPSILONS;
+
+            cell.Coords[c] = static_cast<int64_t>(coord);
+            cell.Side[c] = offset < 1.0 ? -1 : offset > CELL_EPSILONS - 1.0 ? 1 : 0;
+        }
+        else
+        {
+            // -0 and +0 are the same value.
+            cell.Coords[c] = std::bit_cast<uint32_t>(value == 0.f ? 0.f : value);
+            cell.Side[c] = 0;
+        }
+    }
+
+    return cell;
+}
+
+uint64_t HashCell(const int64_t* coords)
+{
+    return HashContent(std::as_bytes(std::span(coords, 3)));
+}
+
+// Exact copies, -0 and +0 and identical NaNs included, are always near.
+bool IsNear(float a, float b, float epsilon)
+{
+    return a == b || std::bit_cast<uint32_t>(a) == std::bit_cast<uint32_t>(b) ||
+        std::abs(a - b) < epsilon;
+}
+
+// Open addressing with linear probing over a power-of-two array that is at most half full, from
+// position cells to the head of a list of the vertices kept in them. Slots keep the upper hash
+// bits next to the vertex whose cell they hold, so probing past other cells rarely needs their
+// coordinates.
+class CellTable
+{
+public:
+    explicit CellTable(size_t numVertices)
+        : m_slots(std::bit_ceil(std::max<size_t>(numVertices * 2, 16)))
+        , m_mask(m_slots.size() - 1)
+    {
+    }
+
+    // Returns the list head of the cell that |equal| accepts the vertex of, or null if there is
+    // none.
+    template<typename Equal>
+    const uint32_t* Find(uint64_t hash, Equal&& equal) const
+    {
+        auto tag = static_cast<uint32_t>(hash >> 32);
+
+        for (size_t i = hash & m_mask;; i = (i + 1) & m_mask)
+        {
+            const Slot& slot = m_slots[i];
+
+            if (slot.Vertex == NO_VERTEX)
+                return nullptr;
+
+            if (slot.Tag == tag && equal(slot.Vertex))
+                return &slot.Head;
+        }
+    }
+
+    // As Find(), but adds an empty cell, keyed by the cell of |vertex|, if there is none.
+    template<typename Equal>
+    uint32_t& FindOrAdd(uint64_t hash, uint32_t vertex, Equal&& equal)
+    {
+        auto tag = static_cast<uint32_t>(hash >> 32);
+
+        for (size_t i = hash & m_mask;; i = (i + 1) & m_mask)
+        {
+            Slot& slot = m_slots[i];
+
+            if (slot.Vertex == NO_VERTEX)
+            {
+                slot = {tag, vertex, NO_VERTEX};
+                return slot.Head;
+            }
+
+            if (slot.Tag == tag && equal(slot.Vertex))
+                return slot.Head;
+        }
+    }
+
+private:
+    struct Slot
+    {
+        uint32_t Tag = 0;
+        uint32_t Vertex = NO_VERTEX;
+        uint32_t Head = NO_VERTEX;
+    };
+
+    std::vector<Slot> m_slots;
+    size_t m_mask;
+};
+
+// Welds every vertex to the first kept vertex within the epsilons of it, or keeps it if there is
+// none, in order, and remaps the indices to the kept vertices.
+void Weld(Geometry* geometry, const GeometryOptions& options)
+{
+    uint32_t numVertices = geometry->NumVertices;
+    const std::vector<float>& positions = geometry->Streams[0];
+
+    double invCellSize =
+        options.PositionEpsilon > 0.f ? 1.0 / (CELL_EPSILONS * options.PositionEpsilon) : 0.0;
+
+    std::vector<PositionCell> cells(numVertices);
+
+    for (uint32_t vertex = 0; vertex < numVertices; ++vertex)
+    {
+        cells[vertex] = GetPositionCell(positions.data() + vertex * 3, invCellSize);
+    }
+
+    // Whether |vertex|, still in place, is near the kept vertex |kept|, already compacted.
+    auto isNear = [&](uint32_t vertex, uint32_t kept) {
+        for (int i = 0; i < NUM_STREAMS; ++i)
+        {
+            const std::vector<float>& stream = geometry->Streams[i];
+            size_t numComponents = STREAM_COMPONENTS[i];
+            float epsilon = i == 0 ? options.PositionEpsilon : options.AttributeEpsilon;
+
+            if (stream.empty())
+                continue;
+
+            const float* a = stream.data() + vertex * numComponents;
+            const float* b = stream.data() + kept * numComponents;
+
+            for (size_t c = 0; c < numComponents; ++c)
+            {
+                if (!IsNear(a[c], b[c], epsilon))
+                    return false;
+            }
+        }
+
+        return true;
+    };
+
+    CellTable table(numVertices);
+
+    // Kept vertices in the same cell are linked through this, newest first, by their kept index.
+    std::vector<uint32_t> next(numVertices);
+
+    std::vector<uint16_t> remap(numVertices);
+    uint32_t numWelded = 0;
+
+    for (uint32_t vertex = 0; vertex < numVertices; ++vertex)
+    {
+        const PositionCell& cell = cells[vertex];
+        uint32_t match = NO_VERTEX;
+
+        // The vertex's own cell and those across the faces it is near.
+        for (int neighbour = 0; neighbour < 8; ++neighbour)
+        {
+            int64_t coords[3];
+            bool exists = true;
+
+            for (int c = 0; c < 3; ++c)
+            {
+                bool offset = (neighbour >> c) & 1;
+
+                exists = exists && !(offset && cell.Side[c] == 0);
+                coords[c] = cell.Coords[c] + (offset ? cell.Side[c] : 0);
+            }
+
+            if (!exists)
+                continue;
+
+            const uint32_t* head = table.Find(HashCell(coords), [&](uint32_t other) {
+                return std::memcmp(coords, cells[other].Coords, sizeof(coords)) == 0;
+            });
+
+            for (uint32_t kept = head ? *head : NO_VERTEX; kept != NO_VERTEX; kept = next[kept])
+            {
+                if (kept < match && isNear(vertex, kept))
+                    match = kept;
+            }
+        }
+
+        if (match != NO_VERTEX)
+        {
+            remap[vertex] = static_cast<uint16_t>(match);
+            continue;
+        }
+
+        // Kept vertices only ever move towards the front, so they can be compacted in place.
+        for (int i = 0; i < NUM_STREAMS; ++i)
+        {
+            std::vector<float>& stream = geometry->Streams[i];
+
+            if (!stream.empty())
+            {
+                std::copy_n(stream.begin() + vertex * STREAM_COMPONENTS[i], STREAM_COMPONENTS[i],
+                            stream.begin() + numWelded * STREAM_COMPONENTS[i]);
+            }
+        }
+
+        uint32_t& head = table.FindOrAdd(HashCell(cell.Coords), vertex, [&](uint32_t other) {
+            return std::memcmp(cell.Coords, cells[other].Coords, sizeof(cell.Coords)) == 0;
+        });
+
+        next[numWelded] = head;
+        head = numWelded;
+
+        remap[vertex] = static_cast<uint16_t>(numWelded++);
+    }
+
+    for (int i = 0; i < NUM_STREAMS; ++i)
+    {
+        if (!geometry->Streams[i].empty())
+            geometry->Streams[i].resize(numWelded * STREAM_COMPONENTS[i]);
+    }
+
+    for (uint16_t& index : geometry->Indices)
+    {
+        index = remap[index];
+    }
+
+    geometry->NumVertices = numWelded;
+}
+
+uint64_t HashGeometry(const Geometry& geometry)
+{
+    ContentHasher hasher;
+    hasher.AddBytes(&geometry.NumVertices, sizeof(geometry.NumVertices));
+
+    for (const std::vector<float>& stream : geometry.Streams)
+    {
+        uint64_t size = stream.size();
+        hasher.AddBytes(&size, sizeof(size));
+        hasher.AddBytes(stream.data(), stream.size() * sizeof(float));
+    }
+
+    uint64_t numIndices = geometry.Indices.size();
+    hasher.AddBytes(&numIndices, sizeof(numIndices));
+    hasher.AddBytes(geometry.Indices.data(), geometry.Indices.size() * sizeof(uint16_t));
+
+    return hasher.GetHash();
+}
+
+template<typename T>
+bool SameBytes(const std::vector<T>& a, const std::vector<T>& b)
+{
+    return a.size() == b.size() &&
+           (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+bool SameGeometry(const Geometry& a, const Geometry& b)
+{
+    if (a.Hash != b.Hash || a.NumVertices != b.NumVertices || !SameBytes(a.Indices, b.Indices))
+        return false;
+
+    for (int i = 0; i < NUM_STREAMS; ++i)
+    {
+        if (!SameBytes(a.Streams[i], b.Streams[i]))
+            return false;
+    }
+
+    return true;
+}
+
+// Appends |values| at the next 4-byte boundary, which vertex and index buffer views need.
+template<typename T>
+BufferRange Append(const std::vector<T>& values, size_t numComponents,
+                   std::vector<std::byte>* buffer)
+{
+    buffer->resize((buffer->size() + 3) & ~size_t{3});
+
+    BufferRange range{};
+    range.Buffer = 0;
+    range.ByteOffset = buffer->size();
+    range.ByteStride = sizeof(T) * numComponents;
+    range.Count = static_cast<uint32_t>(values.size() / numComponents);
+
+    buffer->resize(buffer->size() + values.size() * sizeof(T));
+
+    if (!values.empty())
+        std::memcpy(buffer->data() + range.ByteOffset, values.data(), values.size() * sizeof(T));
+
+    return range;
+}
+
+void CopyRanges(const PrimitiveData& from, PrimitiveData* to)
+{
+    to->Positions = from.Positions;
+    to->Normals = from.Normals;
+    to->TexCoords = from.TexCoords;
+    to->Tangents = from.Tangents;
+    to->Indices = from.Indices;
+}
+
+} // namespace
+
+void GeometryStats::Add(const GeometryStats& other)
+{
+    NumPrimitives += other.NumPrimitives;
+    NumSharedPrimitives += other.NumSharedPrimitives;
+    NumVerticesBefore += other.NumVerticesBefore;
+    NumVerticesAfter += other.NumVerticesAfter;
+    BytesBefore += other.BytesBefore;
+    BytesAfter += other.BytesAfter;
+}
+
+GeometryStats OptimizeGeometry(ModelData* model, JobSystem* jobSystem,
+                               const GeometryOptions& options)
+{
+    PROFILE_SCOPE("OptimizeGeometry");
+
+    GeometryStats stats;
+
+    std::vector<PrimitiveData*> prims;
+
+    for (MeshData& mesh : model->Meshes)
+    {
+        for (PrimitiveData& prim : mesh.Primitives)
+        {
+            prims.push_back(&prim);
+            stats.NumVerticesBefore += prim.Positions.Count;
+        }
+    }
+
+    for (const std::vector<std::byte>& buffer : model->Buffers)
+    {
+        stats.BytesBefore += buffer.size();
+    }
+
+    std::vector<Geometry> geometries(prims.size());
+    std::vector<std::exception_ptr> errors(prims.size());
+
+    jobSystem->ParallelFor(prims.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            try
+            {
+                geometries[i] = ReadGeometry(*model, prims[i]);
+                Weld(&geometries[i], options);
+                geometries[i].Hash = HashGeometry(geometries[i]);
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+        }
+    });
+
+    for (const std::exception_ptr& error : errors)
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    std::vector<std::byte> buffer;
+    std::unordered_multimap<uint64_t, size_t> primsByHash;
+
+    for (size_t i = 0; i < prims.size(); ++i)
+    {
+        const Geometry& geometry = geometries[i];
+        bool shared = false;
+
+        auto [begin, end] = primsByHash.equal_range(geometry.Hash);
+
+        for (auto it = begin; it != end && !shared; ++it)
+        {
+            shared = SameGeometry(geometries[it->second], geometry);
+
+            if (shared)
+                CopyRanges(*prims[it->second], prims[i]);
+        }
+
+        if (shared)
+        {
+            ++stats.NumSharedPrimitives;
+            continue;
+        }
+
+        std::array<BufferRange*, NUM_STREAMS> ranges = GetStreamRanges(prims[i]);
+
+        for (int s = 0; s < NUM_STREAMS; ++s)
+        {
+            if (ranges[s]->IsValid())
+                *ranges[s] = Append(geometry.Streams[s], STREAM_COMPONENTS[s], &buffer);
+        }
+
+        prims[i]->Indices = Append(geometry.Indices, 1, &buffer);
+
+        stats.NumVerticesAfter += geometry.NumVertices;
+        primsByHash.emplace(geometry.Hash, i);
+    }
+
+    stats.NumPrimitives = prims.size();
+    stats.BytesAfter = buffer.size();
+
+    model->Buffers.clear();
+    model->Buffers.push_back(std::move(buffer));
+
+    return stats;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "ModelData.h"
+
+#include <cstdint>
+
+struct GeometryOptions
+{
+    // Vertices are welded when every position component differs by less than |PositionEpsilon| and
+    // every normal, texture coordinate and tangent component by less than |AttributeEpsilon|. Zero
+    // only welds exact copies.
+    float PositionEpsilon = 0.f;
+    float AttributeEpsilon = 0.f;
+};
+
+struct GeometryStats
+{
+    uint64_t NumPrimitives = 0;
+
+    // Primitives whose welded contents matched an earlier one, and so share its ranges.
+    uint64_t NumSharedPrimitives = 0;
+
+    // Vertices of every primitive before welding, and of the distinct primitives after.
+    uint64_t NumVerticesBefore = 0;
+    uint64_t NumVerticesAfter = 0;
+
+    // Size of the model's buffers before and after.
+    uint64_t BytesBefore = 0;
+    uint64_t BytesAfter = 0;
+
+    void Add(const GeometryStats& other);
+};
+
+// Welds duplicate vertices within each primitive and remaps its indices, then stores primitives
+// with identical contents once. The results replace |model|'s buffers with a single buffer, with
+// each attribute tightly packed. Topology is kept: every triangle stays, with corners whose
+// attributes are within the epsilons of the originals. Primitives are processed in parallel on
+// |jobSystem|. Throws if an accessor is out of bounds or an index out of range.
+//
+// Each vertex is welded to the first earlier vertex within the epsilons of it that was kept, so
+// chains of near vertices are not merged beyond the epsilons.
+GeometryStats OptimizeGeometry(ModelData* model, JobSystem* jobSystem,
+                               const GeometryOptions& options = {});
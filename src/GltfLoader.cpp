@@ -0,0 +1,470 @@
+#include "GltfLoader.h"
+
+#include "LoadProfiler.h"
+#include "Profiler.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+namespace fs = std::filesystem;
+
+using nlohmann::json;
+
+static bool IsEncodedBufferCurrent(const fs::path& path, const AssetArchive* archive)
+{
+    fs::path encodedPath = GetEncodedBufferPath(path);
+
+    // Archives are packed from up-to-date files, so an encoded copy in one always wins.
+    if (archive && archive->Contains(encodedPath))
+        return true;
+
+    if (archive && archive->Contains(path))
+        return false;
+
+    return fs::exists(encodedPath) &&
+        (!fs::exists(path) || fs::last_write_time(encodedPath) >= fs::last_write_time(path));
+}
+
+static std::vector<std::byte> ReadBuffer(const fs::path& path, const AssetArchive* archive)
+{
+    if (IsEncodedBufferCurrent(path, archive))
+    {
+        PROFILE_SCOPE("DecodeBuffer");
+        LoadScope scope("DecodeBuffer", path);
+
+        std::vector<std::byte> encoded = ReadAssetFile(GetEncodedBufferPath(path), archive);
+        std::vector<std::byte> data(GetDecodedGeometryBufferSize(encoded));
+
+        DecodeGeometryBuffer(encoded, data);
+        scope.AddBytes(data.size());
+
+        return data;
+    }
+
+    return ReadAssetFile(path, archive);
+}
+
+static std::vector<std::vector<std::byte>> ReadBuffers(std::span<const fs::path> paths,
+                                                       const AssetArchive* archive, IoService* io)
+{
+    std::vector<std::vector<std::byte>> buffers(paths.size());
+
+    struct PendingRead
+    {
+        size_t BufferIdx;
+        bool Encoded;
+
+        // Where an encoded copy lands, to be decoded into the buffer.
+        std::vector<std::byte> EncodedData;
+    };
+
+    std::vector<PendingRead> pending;
+    pending.reserve(paths.size());
+
+    std::vector<IoRequest> requests;
+
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        bool encoded = IsEncodedBufferCurrent(paths[i], archive);
+        fs::path filePath = encoded ? GetEncodedBufferPath(paths[i]) : paths[i];
+
+        // Archives read the chunks of a file in parallel already.
+        if (!io || (archive && archive->Contains(filePath)))
+        {
+            buffers[i] = ReadBuffer(paths[i], archive);
+            continue;
+        }
+
+        pending.push_back({i, encoded, {}});
+
+        std::vector<std::byte>& data = encoded ? pending.back().EncodedData : buffers[i];
+        data.resize(fs::file_size(filePath));
+
+        IoRequest request;
+        request.Path = filePath;
+        request.Destination = data;
+
+        requests.push_back(std::move(request));
+    }
+
+    if (requests.empty())
+        return buffers;
+
+    std::vector<IoHandle> handles = io->SubmitBatch(requests);
+
+    // Every read is waited for before anything can throw, as reads land in the buffers.
+    std::string error;
+
+    for (size_t i = 0; i < pending.size(); ++i)
+    {
+        LoadScope scope("ReadFile", paths[pending[i].BufferIdx], LoadSpanKind::Wait);
+
+        if (handles[i].Wait() == IoStatus::Completed)
+            scope.AddBytes(handles[i].GetData().size());
+        else if (error.empty())
+            error = handles[i].GetError();
+    }
+
+    if (!error.empty())
+        throw std::runtime_error(error);
+
+    for (PendingRead& read : pending)
+    {
+        if (!read.Encoded)
+            continue;
+
+        PROFILE_SCOPE("DecodeBuffer");
+        LoadScope scope("DecodeBuffer", paths[read.BufferIdx]);
+
+        std::vector<std::byte>& data = buffers[read.BufferIdx];
+        data.resize(GetDecodedGeometryBufferSize(read.EncodedData));
+
+        DecodeGeometryBuffer(read.EncodedData, data);
+        scope.AddBytes(data.size());
+    }
+
+    return buffers;
+}
+
+static void WriteFile(const fs::path& path, std::span<const std::byte> data)
+{
+    // Written next to the destination and renamed over it, so that a crash mid-write cannot
+    // leave a truncated file behind.
+    fs::path tempPath = path;
+    tempPath += ".tmp";
+
+    {
+        std::ofstream strm(tempPath, std::ios::binary);
+        if (!strm.is_open())
+            throw std::runtime_error("Could not open file.");
+
+        strm.write(reinterpret_cast<const char*>(data.data()),
+                   static_cast<std::streamsize>(data.size()));
+
+        if (!strm)
+            throw std::runtime_error("Could not write file.");
+    }
+
+    fs::rename(tempPath, path);
+}
+
+static json ReadGltfJson(const fs::path& path, const AssetArchive* archive)
+{
+    std::vector<std::byte> data = ReadAssetFile(path, archive);
+    const char* text = reinterpret_cast<const char*>(data.data());
+
+    LoadScope scope("ParseGltf", path);
+    scope.AddBytes(data.size());
+
+    return json::parse(text, text + data.size());
+}
+
+static size_t GetComponentSize(int componentType)
+{
+    switch (componentType)
+    {
+        case 5123:
+            return sizeof(uint16_t);
+        case 5126:
+            return sizeof(float);
+        default:
+            throw std::runtime_error("Unsupported component type.");
+    }
+}
+
+static size_t GetNumComponents(const std::string& type)
+{
+    if (type == "SCALAR")
+        return 1;
+    if (type == "VEC2")
+        return 2;
+    if (type == "VEC3")
+        return 3;
+    if (type == "VEC4")
+        return 4;
+
+    throw std::runtime_error("Unsupported accessor type.");
+}
+
+static BufferRange ParseAccessor(int accessorIdx, const json& gltfJson)
+{
+    const auto& accessorJson = gltfJson["accessors"][accessorIdx];
+    const auto& bufferViewJson = gltfJson["bufferViews"][accessorJson["bufferView"].get<int>()];
+
+    size_t elementSize = GetComponentSize(accessorJson["componentType"]) *
+        GetNumComponents(accessorJson["type"]);
+
+    BufferRange range{};
+    range.Buffer = bufferViewJson["buffer"];
+    range.ByteOffset = accessorJson.value("byteOffset", size_t{0}) +
+        bufferViewJson.value("byteOffset", size_t{0});
+    range.ByteStride = bufferViewJson.value("byteStride", elementSize);
+    range.Count = accessorJson["count"];
+
+    return range;
+}
+
+// Texture references in materials point at textures[], which in turn name the source image.
+static TextureId ParseTextureRef(const json& textureRefJson, const json& gltfJson)
+{
+    int textureIdx = textureRefJson["index"];
+
+    return gltfJson["textures"][textureIdx]["source"];
+}
+
+ModelData LoadGltfModelData(const fs::path& path, const AssetArchive* archive, IoService* io)
+{
+    PROFILE_SCOPE("LoadGltfModelData");
+
+    json gltfJson = ReadGltfJson(path, archive);
+
+    ModelData model{};
+
+    std::vector<fs::path> bufferPaths;
+
+    for (const auto& bufferJson : gltfJson["buffers"])
+    {
+        bufferPaths.push_back(path.parent_path() / bufferJson["uri"].get<std::string>());
+    }
+
+    model.Buffers = ReadBuffers(bufferPaths, archive, io);
+
+    if (gltfJson.contains("images"))
+    {
+        for (const auto& imageJson : gltfJson["images"])
+        {
+            model.Images.push_back(path.parent_path() / imageJson["uri"].get<std::string>());
+        }
+    }
+
+    for (const auto& materialJson : gltfJson["materials"])
+    {
+        Material material{};
+
+        const auto& pbrJson = materialJson["pbrMetallicRoughness"];
+
+        if (pbrJson.contains("baseColorFactor"))
+        {
+            const auto& factor = pbrJson["baseColorFactor"];
+            material.BaseColorFactor = glm::vec4(factor[0], factor[1], factor[2], factor[3]);
+        }
+        else
+        {
+            material.BaseColorFactor = glm::vec4(1.f, 1.f, 1.f, 1.f);
+        }
+
+        if (pbrJson.contains("metallicFactor"))
+        {
+            float factor = pbrJson["metallicFactor"];
+            material.MetallicFactor = factor;
+        }
+
+        if (pbrJson.contains("roughnessFactor"))
+        {
+            float factor = pbrJson["roughnessFactor"];
+            material.RoughnessFactor = factor;
+        }
+
+        if (pbrJson.contains("baseColorTexture"))
+        {
+            material.BaseColorTextureId = ParseTextureRef(pbrJson["baseColorTexture"], gltfJson);
+        }
+
+        if (pbrJson.contains("metallicRoughnessTexture"))
+        {
+            material.RoughnessTextureId = ParseTextureRef(pbrJson["metallicRoughnessTexture"],
+                                                          gltfJson);
+        }
+
+        if (materialJson.contains("normalTexture"))
+        {
+            material.NormalTextureId = ParseTextureRef(materialJson["normalTexture"], gltfJson);
+        }
+
+        model.Materials.push_back(std::move(material));
+    }
+
+    for (const auto& meshJson : gltfJson["meshes"])
+    {
+        MeshData mesh{};
+
+        for (const auto& primJson : meshJson["primitives"])
+        {
+            PrimitiveData prim{};
+
+            const auto& attrJson = primJson["attributes"];
+
+            int posAccessorIdx = attrJson["POSITION"];
+            prim.Positions = ParseAccessor(posAccessorIdx, gltfJson);
+
+            const auto& posAccessorJson = gltfJson["accessors"][posAccessorIdx];
+
+            if (posAccessorJson.contains("min") && posAccessorJson.contains("max"))
+            {
+                const auto& minJson = posAccessorJson["min"];
+                const auto& maxJson = posAccessorJson["max"];
+
+                prim.BoundsMin = glm::vec3(minJson[0], minJson[1], minJson[2]);
+                prim.BoundsMax = glm::vec3(maxJson[0], maxJson[1], maxJson[2]);
+            }
+
+            prim.Normals = ParseAccessor(attrJson["NORMAL"], gltfJson);
+
+            if (attrJson.contains("TEXCOORD_0"))
+            {
+                prim.TexCoords = ParseAccessor(attrJson["TEXCOORD_0"], gltfJson);
+            }
+
+            if (attrJson.contains("TANGENT"))
+            {
+                prim.Tangents = ParseAccessor(attrJson["TANGENT"], gltfJson);
+            }
+
+            int indicesAccessorIdx = primJson["indices"];
+
+            const auto& indicesAccessorJson = gltfJson["accessors"][indicesAccessorIdx];
+
+            if (indicesAccessorJson["componentType"] != 5123 ||
+                indicesAccessorJson["type"] != "SCALAR")
+                throw std::runtime_error("Unsupported index type.");
+
+            prim.Indices = ParseAccessor(indicesAccessorIdx, gltfJson);
+
+            if (primJson.contains("material"))
+            {
+                prim.MaterialIdx = primJson["material"];
+            }
+
+            mesh.Primitives.push_back(std::move(prim));
+        }
+
+        model.Meshes.push_back(std::move(mesh));
+    }
+
+    return model;
+}
+
+fs::path GetEncodedBufferPath(const fs::path& bufferPath)
+{
+    fs::path encodedPath = bufferPath;
+    encodedPath += ".geom";
+
+    return encodedPath;
+}
+
+std::vector<GltfBufferLayout> GetGltfBufferLayouts(const fs::path& path)
+{
+    json gltfJson = ReadGltfJson(path, nullptr);
+
+    const auto& viewsJson = gltfJson["bufferViews"];
+    const auto& accessorsJson = gltfJson["accessors"];
+
+    // Views holding the indices of triangle lists, and the element size shared by every accessor
+    // of each view, or 0 if they differ.
+    std::vector<bool> isIndexView(viewsJson.size());
+    std::vector<size_t> elementSizes(viewsJson.size(), SIZE_MAX);
+
+    for (const auto& meshJson : gltfJson["meshes"])
+    {
+        for (const auto& primJson : meshJson["primitives"])
+        {
+            if (primJson.contains("indices") && primJson.value("mode", 4) == 4)
+            {
+                const auto& accessorJson = accessorsJson[primJson["indices"].get<int>()];
+
+                if (accessorJson.contains("bufferView") && accessorJson["componentType"] == 5123)
+                    isIndexView[accessorJson["bufferView"].get<size_t>()] = true;
+            }
+        }
+    }
+
+    for (const auto& accessorJson : accessorsJson)
+    {
+        if (!accessorJson.contains("bufferView"))
+            continue;
+
+        size_t& elementSize = elementSizes[accessorJson["bufferView"].get<size_t>()];
+        size_t size = GetComponentSize(accessorJson["componentType"]) *
+            GetNumComponents(accessorJson["type"]);
+
+        elementSize = elementSize == SIZE_MAX || elementSize == size ? size : 0;
+    }
+
+    std::vector<GltfBufferLayout> layouts;
+
+    for (const auto& bufferJson : gltfJson["buffers"])
+    {
+        layouts.push_back({path.parent_path() / bufferJson["uri"].get<std::string>(), {}});
+    }
+
+    for (size_t i = 0; i < viewsJson.size(); ++i)
+    {
+        const auto& viewJson = viewsJson[i];
+
+        GeometrySegment segment{};
+        segment.ByteOffset = viewJson.value("byteOffset", size_t{0});
+        segment.ByteSize = viewJson["byteLength"];
+
+        if (isIndexView[i])
+        {
+            segment.Type = GeometrySegment::Kind::Triangles;
+        }
+        else if (viewJson.contains("byteStride") || (elementSizes[i] > 0 &&
+                                                     elementSizes[i] != SIZE_MAX))
+        {
+            segment.Type = GeometrySegment::Kind::Vertices;
+            segment.ByteStride = viewJson.value("byteStride", elementSizes[i]);
+        }
+
+        layouts.at(viewJson["buffer"].get<size_t>()).Segments.push_back(segment);
+    }
+
+    for (GltfBufferLayout& layout : layouts)
+    {
+        std::vector<GeometrySegment>& segments = layout.Segments;
+
+        std::sort(segments.begin(), segments.end(), [](const auto& a, const auto& b) {
+            return a.ByteOffset < b.ByteOffset;
+        });
+
+        std::vector<GeometrySegment> kept;
+        size_t end = 0;
+
+        for (const GeometrySegment& segment : segments)
+        {
+            if (segment.ByteOffset < end)
+                continue;
+
+            kept.push_back(segment);
+            end = segment.ByteOffset + segment.ByteSize;
+        }
+
+        segments = std::move(kept);
+    }
+
+    return layouts;
+}
+
+size_t WriteEncodedGltfBuffers(const fs::path& path)
+{
+    PROFILE_SCOPE("WriteEncodedGltfBuffers");
+
+    size_t encodedSize = 0;
+
+    for (const GltfBufferLayout& layout : GetGltfBufferLayouts(path))
+    {
+        std::vector<std::byte> encoded =
+            EncodeGeometryBuffer(ReadAssetFile(layout.Path, nullptr), layout.Segments);
+
+        WriteFile(GetEncodedBufferPath(layout.Path), encoded);
+        encodedSize += encoded.size();
+    }
+
+    return encodedSize;
+}
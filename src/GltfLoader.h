@@ -0,0 +1,33 @@
+#pragma once
+
+#include "AssetArchive.h"
+#include "AsyncIo.h"
+#include "GeometryCodec.h"
+#include "ModelData.h"
+
+#include <filesystem>
+#include <vector>
+
+// Parses a .gltf file and reads its buffers into memory. Images are only resolved to paths. A
+// buffer's encoded copy is read in its place when it is at least as new as the buffer, or the
+// buffer is missing. Files in |archive| are read from it rather than from disk. Given |io|, the
+// buffers on disk are read in parallel, straight into the model's buffers.
+ModelData LoadGltfModelData(const std::filesystem::path& path,
+                            const AssetArchive* archive = nullptr, IoService* io = nullptr);
+
+// Where the encoded copy of a buffer file is kept: next to it, with ".geom" appended.
+std::filesystem::path GetEncodedBufferPath(const std::filesystem::path& bufferPath);
+
+// A buffer of a .gltf file and how its buffer views are coded: index views as triangle lists and
+// vertex views by their stride. Views that overlap an earlier one are left out.
+struct GltfBufferLayout
+{
+    std::filesystem::path Path;
+
+    std::vector<GeometrySegment> Segments;
+};
+
+std::vector<GltfBufferLayout> GetGltfBufferLayouts(const std::filesystem::path& path);
+
+// Writes the encoded copy of every buffer of a .gltf file. Returns the total encoded size.
+size_t WriteEncodedGltfBuffers(const std::filesystem::path& path);
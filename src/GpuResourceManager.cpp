@@ -1,21 +1,53 @@
 #include "GpuResourceManager.h"
 
+#include "GeometryCodec.h"
+#include "GeometryOptimizer.h"
+#include "GltfLoader.h"
+#include "ImageDecoder.h"
+#include "LoadProfiler.h"
+#include "Profiler.h"
 #include "Utils.h"
 
 #include <d3dx12.h>
-#include <nlohmann/json.hpp>
 
-#include <fstream>
-#include <variant>
+#include <algorithm>
+#include <cassert>
+#include <thread>
 
 namespace fs = std::filesystem;
 
-using nlohmann::json;
 using winrt::check_hresult;
 using winrt::com_ptr;
 
-GpuResourceManager::GpuResourceManager(ID3D12Device* device)
-    : m_device(device)
+GpuBuffer::GpuBuffer(com_ptr<ID3D12Resource> resource)
+    : m_resource(std::move(resource))
+{
+}
+
+uint64_t GpuBuffer::GetByteSize() const
+{
+    return m_resource->GetDesc().Width;
+}
+
+GpuTexture::GpuTexture(GpuResourceManager* manager, com_ptr<ID3D12Resource> resource,
+                       TextureId id, uint64_t byteSize)
+    : m_manager(manager), m_resource(std::move(resource)), m_id(id), m_byteSize(byteSize)
+{
+}
+
+GpuTexture::~GpuTexture()
+{
+    m_manager->FreeTextureId(m_id);
+}
+
+GpuTextureRef::GpuTextureRef(ResourceHandle texture, TextureId id, uint64_t textureByteSize)
+    : m_texture(std::move(texture)), m_id(id), m_textureByteSize(textureByteSize)
+{
+}
+
+GpuResourceManager::GpuResourceManager(ID3D12Device* device, JobSystem* jobSystem)
+    : m_device(device), m_jobSystem(jobSystem), m_ioService(std::make_unique<IoService>(jobSystem)),
+      m_registry(jobSystem)
 {
     static constexpr auto cmdListType = D3D12_COMMAND_LIST_TYPE_COPY;
 
@@ -35,252 +67,141 @@ GpuResourceManager::GpuResourceManager(ID3D12Device* device)
                                         IID_PPV_ARGS(m_fence.put())));
     ++m_fenceValue;
 
-    check_hresult(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
-                                   IID_PPV_ARGS(m_wicFactory.put())));
-
-    static constexpr int maxDescriptors = 128;
-
     D3D12_DESCRIPTOR_HEAP_DESC heapDesc{};
-    heapDesc.NumDescriptors = maxDescriptors;
+    heapDesc.NumDescriptors = MAX_TEXTURES;
     heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 
     check_hresult(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(m_descriptorHeap.put())));
     m_descriptorHandleSize = device->GetDescriptorHandleIncrementSize(heapDesc.Type);
-
-    m_currentCpuDescriptorHandle = m_descriptorHeap->GetCPUDescriptorHandleForHeapStart();
-    m_currentGpuDescriptorHandle = m_descriptorHeap->GetGPUDescriptorHandleForHeapStart();
 }
 
-namespace
+void GpuResourceManager::MountAssetArchive(const fs::path& path, const fs::path& mountDir)
 {
+    m_assetArchive = std::make_unique<AssetArchive>(path, mountDir, m_jobSystem);
+}
 
-struct GltfAccessor
-{
-    int BufferView;
-    int ByteOffset;
-    int ComponentType;
-    int Count;
-    std::string Type;
-};
-
-struct GltfBufferView
+static D3D12_VERTEX_BUFFER_VIEW CreateVertexBufferView(
+    const BufferRange& range, const std::vector<ID3D12Resource*>& buffers)
 {
-    int Buffer;
-    int ByteOffset;
-    int ByteLength;
-    int Target;
-};
+    D3D12_VERTEX_BUFFER_VIEW view{};
 
-} // namespace
+    if (!range.IsValid())
+        return view;
 
-static void ParseAccessorAndBufferView(int accessorIdx, const json& gltfJson,
-                                       GltfAccessor* accessor, GltfBufferView* bufferView)
-{
-    const auto& accessorJson = gltfJson["accessors"][accessorIdx];
+    view.BufferLocation = buffers[range.Buffer]->GetGPUVirtualAddress() + range.ByteOffset;
+    view.SizeInBytes = static_cast<UINT>(range.GetByteSize());
+    view.StrideInBytes = static_cast<UINT>(range.ByteStride);
 
-    accessor->BufferView = accessorJson["bufferView"];
-    accessor->ByteOffset = accessorJson["byteOffset"];
-    accessor->ComponentType = accessorJson["componentType"];
-    accessor->Count = accessorJson["count"];
-    accessor->Type = accessorJson["type"];
+    return view;
+}
 
-    const auto& bufferViewJson = gltfJson["bufferViews"][accessor->BufferView];
+static D3D12_INDEX_BUFFER_VIEW CreateIndexBufferView(
+    const BufferRange& range, const std::vector<ID3D12Resource*>& buffers)
+{
+    D3D12_INDEX_BUFFER_VIEW view{};
+    view.BufferLocation = buffers[range.Buffer]->GetGPUVirtualAddress() + range.ByteOffset;
+    view.SizeInBytes = static_cast<UINT>(sizeof(uint16_t) * range.Count);
+    view.Format = DXGI_FORMAT_R16_UINT;
 
-    bufferView->Buffer = bufferViewJson["buffer"];
-    bufferView->ByteOffset = bufferViewJson["byteOffset"];
-    bufferView->ByteLength = bufferViewJson["byteLength"];
-    bufferView->Target = bufferViewJson["target"];
+    return view;
 }
 
-static void CreateVertexBufferView(int accessorIdx, const json& gltfJson,
-                                   const std::vector<com_ptr<ID3D12Resource>>& buffers,
-                                   D3D12_VERTEX_BUFFER_VIEW* vertexBufferView)
+void GpuResourceManager::LoadGltfModel(fs::path path, Model* model, TextureStreamer* streamer)
 {
-    GltfAccessor accessor{};
-    GltfBufferView bufferView{};
+    PROFILE_SCOPE("LoadGltfModel");
+    LoadScope scope("LoadModel", path);
 
-    ParseAccessorAndBufferView(accessorIdx, gltfJson, &accessor, &bufferView);
+    ModelData modelData = LoadGltfModelData(path, m_assetArchive.get(), m_ioService.get());
 
-    int componentSize = 0;
+    // Everything is requested before waiting on anything, so that the loads - decoding in
+    // particular - spread across workers. Waiting runs loads on this thread as well.
+    std::vector<ResourceHandle> textureHandles;
+    std::vector<TextureId> textureIds;
 
-    switch (accessor.ComponentType)
+    for (const auto& image : modelData.Images)
     {
-        case 5123:
-            componentSize = sizeof(uint16_t);
-            break;
-        case 5126:
-            componentSize = sizeof(float);
-            break;
-        default:
-            throw std::runtime_error("Unsupported component type.");
+        if (streamer)
+            textureIds.push_back(static_cast<TextureId>(streamer->Add(image)));
+        else
+            textureHandles.push_back(LoadTexture(image));
     }
 
-    int numComponents = 0;
+    // Welded while the textures decode. The epsilons are well below what a vertex format or
+    // rasterizer could tell apart.
+    GeometryStats geometryStats;
 
-    if (accessor.Type == "SCALAR")
     {
-        numComponents = 1;
+        LoadScope optimizeScope("OptimizeGeometry", path);
+        geometryStats = OptimizeGeometry(&modelData, m_jobSystem, {1e-5f, 1e-5f});
     }
-    else if (accessor.Type == "VEC2")
-    {
-        numComponents = 2;
-    }
-    else if (accessor.Type == "VEC3")
-    {
-        numComponents = 3;
-    }
-    else if (accessor.Type == "VEC4")
-    {
-        numComponents = 4;
-    }
-    else
+
     {
-        throw std::runtime_error("Unsupported accessor type.");
+        std::lock_guard lock(m_geometryStatsMutex);
+        m_geometryStats.Add(geometryStats);
     }
 
-    int stride = componentSize * numComponents;
-
-    vertexBufferView->BufferLocation = buffers[bufferView.Buffer]->GetGPUVirtualAddress() +
-        accessor.ByteOffset + bufferView.ByteOffset;
-    vertexBufferView->SizeInBytes = stride * accessor.Count;
-    vertexBufferView->StrideInBytes = stride;
-}
-
-static void CreateIndexBufferView(int accessorIdx, const json& gltfJson,
-                                  const std::vector<com_ptr<ID3D12Resource>>& buffers,
-                                  D3D12_INDEX_BUFFER_VIEW* indexBufferView)
-{
-    GltfAccessor accessor{};
-    GltfBufferView bufferView{};
-
-    ParseAccessorAndBufferView(accessorIdx, gltfJson, &accessor, &bufferView);
-
-    if (accessor.ComponentType != 5123 || accessor.Type != "SCALAR")
-        throw std::runtime_error("Unsupported index type.");
-
-    indexBufferView->BufferLocation = buffers[bufferView.Buffer]->GetGPUVirtualAddress() +
-        accessor.ByteOffset + bufferView.ByteOffset;
-    indexBufferView->SizeInBytes = sizeof(uint16_t) * accessor.Count;
-    indexBufferView->Format = DXGI_FORMAT_R16_UINT;
-}
-
-void GpuResourceManager::LoadGltfModel(fs::path path, Model* model)
-{
-    std::ifstream strm(path);
-    if (!strm.is_open())
-        throw std::runtime_error("Could not open file.");
-
-    json gltfJson = json::parse(strm);
+    std::vector<ResourceHandle> bufferHandles;
 
-    std::vector<com_ptr<ID3D12Resource>> buffers;
-
-    for (const auto& bufferJson : gltfJson["buffers"])
+    for (auto& bufferData : modelData.Buffers)
     {
-        buffers.push_back(
-            LoadBufferToGpu(path.parent_path() / bufferJson["uri"].get<std::string>()));
+        bufferHandles.push_back(LoadBuffer(std::move(bufferData)));
     }
 
-    std::vector<TextureId> textureIds;
+    std::vector<ID3D12Resource*> buffers;
 
-    for (const auto& imageJson : gltfJson["images"])
+    for (const auto& handle : bufferHandles)
     {
-        textureIds.push_back(
-            LoadTextureToGpu(path.parent_path() / imageJson["uri"].get<std::string>()));
+        buffers.push_back(handle.Wait<GpuBuffer>()->GetResource());
     }
 
-    for (const auto& materialJson : gltfJson["materials"])
+    for (const auto& handle : textureHandles)
     {
-        Material material{};
-
-        const auto& pbrJson = materialJson["pbrMetallicRoughness"];
-
-        if (pbrJson.contains("baseColorFactor"))
-        {
-            const auto& factor = pbrJson["baseColorFactor"];
-            material.BaseColorFactor = glm::vec4(factor[0], factor[1], factor[2], factor[3]);
-        }
-        else
-        {
-            material.BaseColorFactor = glm::vec4(1.f, 1.f, 1.f, 1.f);
-        }
-
-        if (pbrJson.contains("metallicFactor"))
-        {
-            float factor = pbrJson["metallicFactor"];
-            material.MetallicFactor = factor;
-        }
-
-        if (pbrJson.contains("roughnessFactor"))
-        {
-            float factor = pbrJson["roughnessFactor"];
-            material.RoughnessFactor = factor;
-        }
-
-        if (pbrJson.contains("baseColorTexture"))
-        {
-            int idx = pbrJson["baseColorTexture"]["index"];
-            material.BaseColorTextureId = textureIds[idx];
-        }
+        textureIds.push_back(handle.Wait<GpuTextureRef>()->GetId());
+    }
 
-        if (pbrJson.contains("metallicRoughnessTexture"))
-        {
-            int idx = pbrJson["metallicRoughnessTexture"]["index"];
-            material.RoughnessTextureId = textureIds[idx];
-        }
+    auto remapTextureId = [&](TextureId imageIdx) {
+        return imageIdx >= 0 ? textureIds[imageIdx] : imageIdx;
+    };
 
-        if (pbrJson.contains("normalTexture"))
-        {
-            int idx = pbrJson["normalTexture"]["index"];
-            material.NormalTextureId = textureIds[idx];
-        }
+    for (Material material : modelData.Materials)
+    {
+        material.BaseColorTextureId = remapTextureId(material.BaseColorTextureId);
+        material.RoughnessTextureId = remapTextureId(material.RoughnessTextureId);
+        material.NormalTextureId = remapTextureId(material.NormalTextureId);
 
-        model->Materials.push_back(std::move(material));
+        model->Materials.push_back(material);
     }
 
-    for (const auto& meshJson : gltfJson["meshes"])
+    model->StreamsTextures = streamer != nullptr;
+
+    for (const auto& meshData : modelData.Meshes)
     {
         Mesh mesh{};
 
-        for (const auto& primJson : meshJson["primitives"])
+        for (const auto& primData : meshData.Primitives)
         {
             Primitive prim{};
+            prim.Positions = CreateVertexBufferView(primData.Positions, buffers);
+            prim.Normals = CreateVertexBufferView(primData.Normals, buffers);
+            prim.TexCoords = CreateVertexBufferView(primData.TexCoords, buffers);
+            prim.Tangents = CreateVertexBufferView(primData.Tangents, buffers);
+            prim.Indices = CreateIndexBufferView(primData.Indices, buffers);
 
-            const auto& attrJson = primJson["attributes"];
-
-            int posAccessorIdx = attrJson["POSITION"];
-            CreateVertexBufferView(posAccessorIdx, gltfJson, buffers, &prim.Positions);
-
-            int normalsAccessorIdx = attrJson["NORMAL"];
-            CreateVertexBufferView(normalsAccessorIdx, gltfJson, buffers, &prim.Normals);
-
-            if (attrJson.contains("TEXCOORD_0"))
-            {
-                int accessorIdx = attrJson["TEXCOORD_0"];
-                CreateVertexBufferView(accessorIdx, gltfJson, buffers, &prim.TexCoords);
-            }
+            prim.MaterialIdx = primData.MaterialIdx;
+            prim.VertexCount = static_cast<int>(primData.Indices.Count);
 
-            if (attrJson.contains("TANGENT"))
-            {
-                int accessorIdx = attrJson["TANGENT"];
-                CreateVertexBufferView(accessorIdx, gltfJson, buffers, &prim.Tangents);
-            }
-
-            int indicesAccessorIdx = primJson["indices"];
-            CreateIndexBufferView(indicesAccessorIdx, gltfJson, buffers, &prim.Indices);
-
-            if (primJson.contains("material"))
-            {
-                prim.MaterialIdx = primJson["material"];
-            }
-
-            prim.VertexCount = gltfJson["accessors"][indicesAccessorIdx]["count"];
+            prim.BoundsMin = primData.BoundsMin;
+            prim.BoundsMax = primData.BoundsMax;
 
             mesh.Primitives.push_back(std::move(prim));
         }
 
         model->Meshes.push_back(std::move(mesh));
     }
+
+    model->Resources.insert(model->Resources.end(), bufferHandles.begin(), bufferHandles.end());
+    model->Resources.insert(model->Resources.end(), textureHandles.begin(), textureHandles.end());
 }
 
 com_ptr<ID3D12Resource> GpuResourceManager::CreateConstantBuffer(size_t elementSize,
@@ -308,11 +229,23 @@ com_ptr<ID3D12Resource> GpuResourceManager::CreateConstantBuffer(size_t elementS
 
 com_ptr<ID3D12Resource> GpuResourceManager::LoadBufferToGpu(std::span<const std::byte> data)
 {
+    return UploadBuffer(data.size(), [&](std::byte* uploadPtr) {
+        memcpy(uploadPtr, data.data(), data.size());
+    });
+}
+
+com_ptr<ID3D12Resource> GpuResourceManager::UploadBuffer(
+    size_t byteSize, const std::function<void(std::byte*)>& write)
+{
+    PROFILE_SCOPE("LoadBufferToGpu");
+    LoadScope scope("UploadBuffer");
+    scope.AddBytes(byteSize);
+
     com_ptr<ID3D12Resource> uploadBuffer;
 
     {
         CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
-        CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(data.size());
+        CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
         check_hresult(m_device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE,
                                                         &bufferDesc,
                                                         D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
@@ -322,7 +255,7 @@ com_ptr<ID3D12Resource> GpuResourceManager::LoadBufferToGpu(std::span<const std:
     std::byte* uploadPtr = nullptr;
     check_hresult(uploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&uploadPtr)));
 
-    memcpy(uploadPtr, data.data(), data.size());
+    write(uploadPtr);
 
     uploadBuffer->Unmap(0, nullptr);
 
@@ -330,152 +263,253 @@ com_ptr<ID3D12Resource> GpuResourceManager::LoadBufferToGpu(std::span<const std:
 
     {
         CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_DEFAULT);
-        CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(data.size());
+        CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
         check_hresult(m_device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE,
                                                         &bufferDesc, D3D12_RESOURCE_STATE_COMMON,
                                                         nullptr, IID_PPV_ARGS(resource.put())));
     }
 
-    check_hresult(m_cmdAllocator->Reset());
-    check_hresult(m_cmdList->Reset(m_cmdAllocator.get(), nullptr));
+    {
+        std::unique_lock lock = LockCopyQueue();
 
-    m_cmdList->CopyBufferRegion(resource.get(), 0, uploadBuffer.get(), 0, data.size());
+        check_hresult(m_cmdAllocator->Reset());
+        check_hresult(m_cmdList->Reset(m_cmdAllocator.get(), nullptr));
 
-    check_hresult(m_cmdList->Close());
+        m_cmdList->CopyBufferRegion(resource.get(), 0, uploadBuffer.get(), 0, byteSize);
 
-    ExecuteCommandListSync();
+        check_hresult(m_cmdList->Close());
 
-    m_buffers.push_back(resource);
+        ExecuteCommandListSync();
+    }
 
     return resource;
 }
 
 com_ptr<ID3D12Resource> GpuResourceManager::LoadBufferToGpu(fs::path path)
 {
-    std::ifstream strm(path, std::ios::binary);
-    if (!strm.is_open())
-        throw std::runtime_error("Could not open file.");
+    // A plain buffer on disk is read straight into upload memory, once its first block shows
+    // that it is not encoded.
+    if (!m_assetArchive || !m_assetArchive->Contains(path))
+    {
+        IoRequest headerRequest;
+        headerRequest.Path = path;
+        headerRequest.Size = IoBufferPool::ALIGNMENT;
+
+        IoHandle header = m_ioService->Submit(std::move(headerRequest));
 
-    std::vector<std::byte> data(fs::file_size(path));
+        if (header.Wait() != IoStatus::Completed)
+            throw std::runtime_error(header.GetError());
+
+        if (!IsGeometryBuffer(header.GetData()))
+        {
+            size_t byteSize = fs::file_size(path);
 
-    strm.read(reinterpret_cast<char*>(data.data()), data.size());
+            return UploadBuffer(byteSize, [&](std::byte* uploadPtr) {
+                LoadScope scope("ReadFile", path, LoadSpanKind::Wait);
 
-    return LoadBufferToGpu(data);
+                IoRequest request;
+                request.Path = path;
+                request.Destination = {uploadPtr, byteSize};
+                request.Priority = IoPriority::High;
+
+                IoHandle read = m_ioService->Submit(std::move(request));
+
+                if (read.Wait() != IoStatus::Completed)
+                    throw std::runtime_error(read.GetError());
+
+                scope.AddBytes(byteSize);
+            });
+        }
+    }
+
+    std::vector<std::byte> data = ReadAssetFile(path, m_assetArchive.get());
+
+    if (!IsGeometryBuffer(data))
+        return LoadBufferToGpu(data);
+
+    size_t decodedSize = GetDecodedGeometryBufferSize(data);
+
+    return UploadBuffer(decodedSize, [&](std::byte* uploadPtr) {
+        DecodeGeometryBuffer(data, {uploadPtr, decodedSize});
+    });
+}
+
+ResourceHandle GpuResourceManager::LoadBuffer(std::vector<std::byte> data)
+{
+    uint64_t key = MakeResourceKey(ResourceKind::Buffer, data);
+
+    auto load = [this, data = std::move(data)]() -> std::unique_ptr<RegisteredResource> {
+        return std::make_unique<GpuBuffer>(LoadBufferToGpu(data));
+    };
+
+    return m_registry.Request(key, std::move(load));
 }
 
-TextureId GpuResourceManager::LoadTextureToGpu(fs::path path)
+ResourceHandle GpuResourceManager::LoadTexture(fs::path path)
 {
-    com_ptr<IWICBitmapDecoder> decoder;
-    check_hresult(m_wicFactory->CreateDecoderFromFilename(path.wstring().c_str(), nullptr,
-                                                          GENERIC_READ,
-                                                          WICDecodeMetadataCacheOnLoad,
-                                                          decoder.put()));
+    uint64_t key = MakeResourceKey(ResourceKind::Texture, path);
 
-    com_ptr<IWICBitmapFrameDecode> decoderFrame;
-    check_hresult(decoder->GetFrame(0, decoderFrame.put()));
+    return m_registry.Request(key, [this, path]() -> std::unique_ptr<RegisteredResource> {
+        std::vector<std::byte> data;
 
-    WICPixelFormatGUID srcFormat;
-    check_hresult(decoderFrame->GetPixelFormat(&srcFormat));
-    assert(srcFormat == GUID_WICPixelFormat24bppBGR || srcFormat == GUID_WICPixelFormat32bppBGRA);
+        {
+            PROFILE_SCOPE("ReadTextureFile");
 
-    com_ptr<IWICFormatConverter> formatConverter;
-    check_hresult(m_wicFactory->CreateFormatConverter(formatConverter.put()));
+            data = ReadAssetFile(path, m_assetArchive.get());
+        }
 
-    static WICPixelFormatGUID dstFormat = GUID_WICPixelFormat32bppRGBA;
+        // Copies of a file under other names are only decoded once.
+        uint64_t fileKey = MakeResourceKey(ResourceKind::TextureFile, data);
 
-    BOOL canConvert = false;
-    check_hresult(formatConverter->CanConvert(srcFormat, dstFormat, &canConvert));
-    assert(canConvert);
+        auto load = [this, path,
+                     data = std::move(data)]() -> std::unique_ptr<RegisteredResource> {
+            return LoadTextureFile(path, data);
+        };
 
-    check_hresult(formatConverter->Initialize(decoderFrame.get(), dstFormat,
-                                              WICBitmapDitherTypeNone, nullptr, 0.f,
-                                              WICBitmapPaletteTypeCustom));
+        ResourceHandle file = m_registry.Request(fileKey, std::move(load));
 
-    com_ptr<IWICBitmap> bitmap;
-    check_hresult(m_wicFactory->CreateBitmapFromSource(formatConverter.get(), WICBitmapCacheOnLoad,
-                                                       bitmap.put()));
+        const GpuTextureRef* fileTexture = file.Wait<GpuTextureRef>();
+        TextureId id = fileTexture->GetId();
+        uint64_t textureByteSize = fileTexture->GetTextureByteSize();
 
-    com_ptr<IWICBitmapLock> bitmapLock;
-    check_hresult(bitmap->Lock(nullptr, WICBitmapLockRead, bitmapLock.put()));
+        ++m_numTextureFilesRead;
+        m_textureReadBytes += textureByteSize;
 
-    uint32_t bitmapBufferSize = 0;
-    BYTE* bitmapBuffer = nullptr;
+        return std::make_unique<GpuTextureRef>(std::move(file), id, textureByteSize);
+    });
+}
 
-    check_hresult(bitmapLock->GetDataPointer(&bitmapBufferSize, &bitmapBuffer));
+std::unique_ptr<GpuTextureRef> GpuResourceManager::LoadTextureFile(
+    const fs::path& path, std::span<const std::byte> data)
+{
+    std::unique_ptr<ImageDecoder> decoder = CreateImageDecoder(data);
+    uint32_t width = decoder->GetWidth();
+    uint32_t height = decoder->GetHeight();
+
+    uint64_t key = 0;
 
-    uint32_t bitmapWidth = 0;
-    uint32_t bitmapHeight = 0;
-    check_hresult(formatConverter->GetSize(&bitmapWidth, &bitmapHeight));
+    StagedTexture staged = StageTexture(width, height, [&](std::byte* dst, size_t rowPitch) {
+        {
+            PROFILE_SCOPE("DecodeTexture");
+            LoadScope scope("DecodeImage", path);
+
+            decoder->Decode(reinterpret_cast<uint8_t*>(dst), rowPitch);
+            scope.AddBytes(size_t{width} * 4 * height);
+        }
 
-    CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM,
-                                                                     bitmapWidth, bitmapHeight);
+        // Files that differ but decode to the same pixels are only uploaded once.
+        key = MakeTextureKey(width, height, dst, rowPitch);
+    });
+
+    ++m_numTexturesDecoded;
+
+    auto load = [this, staged = std::move(staged)]() -> std::unique_ptr<RegisteredResource> {
+        return UploadTexture(staged);
+    };
+
+    ResourceHandle texture = m_registry.Request(key, std::move(load));
+
+    const GpuTexture* gpuTexture = texture.Wait<GpuTexture>();
+    TextureId id = gpuTexture->GetId();
+    uint64_t textureByteSize = gpuTexture->GetByteSize();
+
+    return std::make_unique<GpuTextureRef>(std::move(texture), id, textureByteSize);
+}
+
+GpuResourceManager::StagedTexture GpuResourceManager::StageTexture(
+    uint32_t width, uint32_t height, std::span<const std::byte> pixels)
+{
+    size_t rowSize = size_t{width} * 4;
+
+    return StageTexture(width, height, [&](std::byte* dst, size_t rowPitch) {
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            memcpy(dst + y * rowPitch, pixels.data() + y * rowSize, rowSize);
+        }
+    });
+}
+
+GpuResourceManager::StagedTexture GpuResourceManager::StageTexture(
+    uint32_t width, uint32_t height, const std::function<void(std::byte*, size_t)>& write)
+{
+    PROFILE_SCOPE("StageTexture");
+    LoadScope scope("StageTexture");
+    scope.AddBytes(size_t{width} * 4 * height);
+
+    StagedTexture texture{};
+    texture.Desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, width, height);
 
-    D3D12_PLACED_SUBRESOURCE_FOOTPRINT copySrcLayout{};
     uint64_t uploadBufferSize = 0;
-    m_device->GetCopyableFootprints(&textureDesc, 0, 1, 0, &copySrcLayout, nullptr, nullptr,
+    m_device->GetCopyableFootprints(&texture.Desc, 0, 1, 0, &texture.Footprint, nullptr, nullptr,
                                     &uploadBufferSize);
 
-    com_ptr<ID3D12Resource> uploadBuffer;
-
     {
-        CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
+        // Cached system memory rather than an upload heap, which is write-combined and so far too
+        // slow to read back. The staged rows are hashed in place, and the copy queue reads them
+        // only once per texture.
+        CD3DX12_HEAP_PROPERTIES heapProps(D3D12_CPU_PAGE_PROPERTY_WRITE_BACK,
+                                          D3D12_MEMORY_POOL_L0);
         CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
         check_hresult(m_device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE,
                                                         &bufferDesc,
                                                         D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
-                                                        IID_PPV_ARGS(uploadBuffer.put())));
+                                                        IID_PPV_ARGS(texture.UploadBuffer.put())));
     }
 
     std::byte* uploadPtr = nullptr;
-    check_hresult(uploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&uploadPtr)));
+    check_hresult(texture.UploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&uploadPtr)));
 
-    std::byte* bitmapPtr = reinterpret_cast<std::byte*>(bitmapBuffer);
+    write(uploadPtr, texture.Footprint.Footprint.RowPitch);
 
-    for (size_t i = 0; i < copySrcLayout.Footprint.Height; ++i)
-    {
-        memcpy(uploadPtr, bitmapPtr, bitmapWidth * 4);
+    texture.UploadBuffer->Unmap(0, nullptr);
 
-        uploadPtr += copySrcLayout.Footprint.RowPitch;
-        bitmapPtr += bitmapWidth * 4;
-    }
+    return texture;
+}
 
-    uploadBuffer->Unmap(0, nullptr);
+std::unique_ptr<GpuTexture> GpuResourceManager::UploadTexture(const StagedTexture& texture)
+{
+    PROFILE_SCOPE("UploadTexture");
+    LoadScope scope("UploadTexture");
 
     com_ptr<ID3D12Resource> resource;
 
     {
         CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_DEFAULT);
         check_hresult(m_device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE,
-                                                        &textureDesc, D3D12_RESOURCE_STATE_COMMON,
+                                                        &texture.Desc, D3D12_RESOURCE_STATE_COMMON,
                                                         nullptr, IID_PPV_ARGS(resource.put())));
     }
 
-    check_hresult(m_cmdAllocator->Reset());
-    check_hresult(m_cmdList->Reset(m_cmdAllocator.get(), nullptr));
+    uint64_t byteSize = m_device->GetResourceAllocationInfo(0, 1, &texture.Desc).SizeInBytes;
+    scope.AddBytes(byteSize);
 
     D3D12_TEXTURE_COPY_LOCATION copySrc{};
     copySrc.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-    copySrc.pResource = uploadBuffer.get();
-    copySrc.PlacedFootprint = copySrcLayout;
+    copySrc.pResource = texture.UploadBuffer.get();
+    copySrc.PlacedFootprint = texture.Footprint;
 
     D3D12_TEXTURE_COPY_LOCATION copyDst;
     copyDst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
     copyDst.pResource = resource.get();
     copyDst.SubresourceIndex = 0;
 
-    m_cmdList->CopyTextureRegion(&copyDst, 0, 0, 0, &copySrc, nullptr);
+    {
+        std::unique_lock lock = LockCopyQueue();
 
-    check_hresult(m_cmdList->Close());
+        check_hresult(m_cmdAllocator->Reset());
+        check_hresult(m_cmdList->Reset(m_cmdAllocator.get(), nullptr));
 
-    ExecuteCommandListSync();
+        m_cmdList->CopyTextureRegion(&copyDst, 0, 0, 0, &copySrc, nullptr);
 
-    int textureId = static_cast<int>(m_textures.size());
+        check_hresult(m_cmdList->Close());
 
-    D3D12_CPU_DESCRIPTOR_HANDLE srvCpuHandle = m_currentCpuDescriptorHandle;
-    m_currentCpuDescriptorHandle.Offset(1, m_descriptorHandleSize);
+        ExecuteCommandListSync();
+    }
+
+    TextureId textureId = AllocateTextureId();
 
-    D3D12_GPU_DESCRIPTOR_HANDLE srvGpuHandle = m_currentGpuDescriptorHandle;
-    m_currentGpuDescriptorHandle.Offset(1, m_descriptorHandleSize);
+    CD3DX12_CPU_DESCRIPTOR_HANDLE srvCpuHandle(
+        m_descriptorHeap->GetCPUDescriptorHandleForHeapStart(), textureId, m_descriptorHandleSize);
 
     D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc{};
     srv_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -486,11 +520,10 @@ TextureId GpuResourceManager::LoadTextureToGpu(fs::path path)
 
     m_device->CreateShaderResourceView(resource.get(), &srv_desc, srvCpuHandle);
 
-    m_textureSrvHandles[textureId] = srvGpuHandle;
-
-    m_textures.push_back(resource);
+    ++m_numTexturesUploaded;
+    m_textureUploadedBytes += byteSize;
 
-    return textureId;
+    return std::make_unique<GpuTexture>(this, std::move(resource), textureId, byteSize);
 }
 
 ID3D12DescriptorHeap* GpuResourceManager::GetTextureSrvHeap()
@@ -500,16 +533,87 @@ ID3D12DescriptorHeap* GpuResourceManager::GetTextureSrvHeap()
 
 D3D12_GPU_DESCRIPTOR_HANDLE GpuResourceManager::GetTextureSrvHandle(TextureId id)
 {
-    return m_textureSrvHandles.at(id);
+    // Materials without a texture must be given a default one rather than -1, which would point
+    // outside the heap.
+    assert(id >= 0 && id < MAX_TEXTURES);
+
+    return CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), id,
+                                         m_descriptorHandleSize);
+}
+
+void GpuResourceManager::CollectGarbage(uint64_t currentFenceValue, uint64_t completedFenceValue)
+{
+    m_registry.SetCurrentFenceValue(currentFenceValue);
+    m_registry.Collect(completedFenceValue);
+}
+
+ResourceRegistry::Stats GpuResourceManager::GetResourceStats() const
+{
+    return m_registry.GetStats();
+}
+
+GpuResourceManager::TextureStats GpuResourceManager::GetTextureStats() const
+{
+    TextureStats stats;
+    stats.NumFilesRead = m_numTextureFilesRead;
+    stats.NumDecoded = m_numTexturesDecoded;
+    stats.NumUploaded = m_numTexturesUploaded;
+    stats.ReadBytes = m_textureReadBytes;
+    stats.UploadedBytes = m_textureUploadedBytes;
+
+    return stats;
+}
+
+GeometryStats GpuResourceManager::GetGeometryStats() const
+{
+    std::lock_guard lock(m_geometryStatsMutex);
+
+    return m_geometryStats;
+}
+
+TextureId GpuResourceManager::AllocateTextureId()
+{
+    std::lock_guard lock(m_descriptorMutex);
+
+    if (!m_freeTextureIds.empty())
+    {
+        TextureId id = m_freeTextureIds.back();
+        m_freeTextureIds.pop_back();
+
+        return id;
+    }
+
+    if (m_numTextureIds == MAX_TEXTURES)
+        throw std::runtime_error("Out of texture descriptors.");
+
+    return m_numTextureIds++;
+}
+
+void GpuResourceManager::FreeTextureId(TextureId id)
+{
+    std::lock_guard lock(m_descriptorMutex);
+
+    m_freeTextureIds.push_back(id);
+}
+
+std::unique_lock<std::mutex> GpuResourceManager::LockCopyQueue()
+{
+    LoadScope scope("WaitCopyLock", {}, LoadSpanKind::Wait);
+
+    return std::unique_lock(m_copyMutex);
 }
 
 void GpuResourceManager::ExecuteCommandListSync()
 {
+    PROFILE_SCOPE("ExecuteCommandListSync");
+
     ID3D12CommandList* cmdLists[] = { m_cmdList.get() };
     m_copyQueue->ExecuteCommandLists(static_cast<uint32_t>(std::size(cmdLists)), cmdLists);
 
     check_hresult(m_copyQueue->Signal(m_fence.get(), m_fenceValue));
 
+    LoadScope scope("WaitCopyQueue", {}, LoadSpanKind::Wait);
+
     while (m_fence->GetCompletedValue() < m_fenceValue)
     {
         std::this_thread::sleep_for(std::chrono::milliseconds(1));
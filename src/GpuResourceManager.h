@@ -1,58 +1,239 @@
 #pragma once
 
+#include "AssetArchive.h"
+#include "AsyncIo.h"
+#include "GeometryOptimizer.h"
+#include "JobSystem.h"
 #include "Model.h"
+#include "ResourceRegistry.h"
+#include "TextureStreamer.h"
 
 #include <d3d12.h>
 #include <d3dx12.h>
-#include <wincodec.h>
 #include <winrt/base.h>
 
+#include <atomic>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <span>
 #include <vector>
 
+class GpuResourceManager;
+
+// Registry resources backed by GPU objects.
+class GpuBuffer : public RegisteredResource
+{
+public:
+    explicit GpuBuffer(winrt::com_ptr<ID3D12Resource> resource);
+
+    ID3D12Resource* GetResource() const
+    {
+        return m_resource.get();
+    }
+
+    uint64_t GetByteSize() const override;
+
+private:
+    winrt::com_ptr<ID3D12Resource> m_resource;
+};
+
+class GpuTexture : public RegisteredResource
+{
+public:
+    GpuTexture(GpuResourceManager* manager, winrt::com_ptr<ID3D12Resource> resource, TextureId id,
+               uint64_t byteSize);
+
+    // Frees the texture's SRV slot for reuse.
+    ~GpuTexture() override;
+
+    TextureId GetId() const
+    {
+        return m_id;
+    }
+
+    uint64_t GetByteSize() const override
+    {
+        return m_byteSize;
+    }
+
+private:
+    GpuResourceManager* m_manager;
+    winrt::com_ptr<ID3D12Resource> m_resource;
+    TextureId m_id;
+    uint64_t m_byteSize;
+};
+
+// Shares a texture loaded under another key, such as an image file whose pixels were loaded
+// already from another file. Holds no memory of its own.
+class GpuTextureRef : public RegisteredResource
+{
+public:
+    GpuTextureRef(ResourceHandle texture, TextureId id, uint64_t textureByteSize);
+
+    TextureId GetId() const
+    {
+        return m_id;
+    }
+
+    uint64_t GetTextureByteSize() const
+    {
+        return m_textureByteSize;
+    }
+
+    uint64_t GetByteSize() const override
+    {
+        return 0;
+    }
+
+private:
+    ResourceHandle m_texture;
+    TextureId m_id;
+    uint64_t m_textureByteSize;
+};
+
 class GpuResourceManager
 {
 public:
-    GpuResourceManager(ID3D12Device* device);
+    GpuResourceManager(ID3D12Device* device, JobSystem* jobSystem);
+
+    // Files under |mountDir| are read from the archive at |path| from now on, where it has them.
+    // Must be called before anything is loaded.
+    void MountAssetArchive(const std::filesystem::path& path,
+                           const std::filesystem::path& mountDir);
 
-    void LoadGltfModel(std::filesystem::path path, Model* model);
+    // Returns once the model's geometry is loaded. Its textures are loaded as well, unless
+    // |streamer| is given, in which case they are only added to it.
+    void LoadGltfModel(std::filesystem::path path, Model* model,
+                       TextureStreamer* streamer = nullptr);
 
     winrt::com_ptr<ID3D12Resource> CreateConstantBuffer(size_t elementSize, size_t numElements,
                                                         size_t* outStride = nullptr);
 
+    // Unshared buffers, owned by the caller. A file coded with EncodeGeometryBuffer() is decoded
+    // straight into upload memory, and any other file on disk is read straight into it.
     winrt::com_ptr<ID3D12Resource> LoadBufferToGpu(std::span<const std::byte> data);
     winrt::com_ptr<ID3D12Resource> LoadBufferToGpu(std::filesystem::path path);
 
-    TextureId LoadTextureToGpu(std::filesystem::path path);
+    // Shared resources, loaded in the background by the registry. Buffers are keyed by their
+    // contents, so each is only loaded once while it has handles.
+    ResourceHandle LoadBuffer(std::vector<std::byte> data);
+
+    // Resolves to a GpuTextureRef. Textures are keyed by path, then by the file's contents and
+    // last by the decoded pixels, so images that are copies of each other share one texture and
+    // descriptor across all models.
+    ResourceHandle LoadTexture(std::filesystem::path path);
+
+    // A decoded image in CPU-readable staging memory, laid out for copying into the texture.
+    struct StagedTexture
+    {
+        winrt::com_ptr<ID3D12Resource> UploadBuffer;
+
+        D3D12_RESOURCE_DESC Desc{};
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT Footprint{};
+    };
+
+    // Copies tightly packed RGBA8 pixels into a new staging buffer. Thread-safe - may be called
+    // from job system workers.
+    StagedTexture StageTexture(uint32_t width, uint32_t height, std::span<const std::byte> pixels);
+
+    // Creates a staging buffer for a |width| x |height| RGBA8 texture, which |write| fills through
+    // the mapped buffer, with rows |rowPitch| bytes apart. The memory is cached, so |write| may
+    // read back what it wrote. Thread-safe.
+    StagedTexture StageTexture(uint32_t width, uint32_t height,
+                               const std::function<void(std::byte* dst, size_t rowPitch)>& write);
+
+    std::unique_ptr<GpuTexture> UploadTexture(const StagedTexture& texture);
 
     ID3D12DescriptorHeap* GetTextureSrvHeap();
 
+    // |id| must be a texture's, never -1.
     D3D12_GPU_DESCRIPTOR_HANDLE GetTextureSrvHandle(TextureId id);
 
+    // Call once per frame from the thread that submits frames. Resources released from now on are
+    // kept until |currentFenceValue| completes, and those released before |completedFenceValue|
+    // are destroyed. Handles dropped on other threads must not be used by frames recorded later.
+    void CollectGarbage(uint64_t currentFenceValue, uint64_t completedFenceValue);
+
+    ResourceRegistry::Stats GetResourceStats() const;
+
+    struct TextureStats
+    {
+        // Image files read, those whose contents were new and so decoded, and those whose pixels
+        // were new and so uploaded.
+        uint64_t NumFilesRead = 0;
+        uint64_t NumDecoded = 0;
+        uint64_t NumUploaded = 0;
+
+        // Texture memory of every file read, and of the textures actually uploaded. The
+        // difference is what sharing saved.
+        uint64_t ReadBytes = 0;
+        uint64_t UploadedBytes = 0;
+    };
+
+    TextureStats GetTextureStats() const;
+
+    // Totals of welding and sharing the geometry of every model loaded.
+    GeometryStats GetGeometryStats() const;
+
 private:
+    friend class GpuTexture;
+
+    TextureId AllocateTextureId();
+    void FreeTextureId(TextureId id);
+
+    // Creates a buffer of |byteSize| bytes, which |write| fills through the mapped upload buffer.
+    winrt::com_ptr<ID3D12Resource> UploadBuffer(size_t byteSize,
+                                                const std::function<void(std::byte*)>& write);
+
+    // Decodes an image file straight into staging memory and shares the texture of any other file
+    // with the same pixels, which are hashed where they were staged. |path| only labels the load
+    // in startup reports.
+    std::unique_ptr<GpuTextureRef> LoadTextureFile(const std::filesystem::path& path,
+                                                   std::span<const std::byte> data);
+
+    // Records and executes copies on the shared command list. Loads run on several workers, so
+    // this is serialized by |m_copyMutex|, which LockCopyQueue() takes.
+    std::unique_lock<std::mutex> LockCopyQueue();
     void ExecuteCommandListSync();
 
     ID3D12Device* m_device;
 
+    JobSystem* m_jobSystem;
+
+    std::unique_ptr<AssetArchive> m_assetArchive;
+
+    // Reads buffers on disk in parallel, and straight into upload memory.
+    std::unique_ptr<IoService> m_ioService;
+
     winrt::com_ptr<ID3D12CommandQueue> m_copyQueue;
     winrt::com_ptr<ID3D12CommandAllocator> m_cmdAllocator;
     winrt::com_ptr<ID3D12GraphicsCommandList> m_cmdList;
 
+    std::mutex m_copyMutex;
+
     winrt::com_ptr<ID3D12Fence> m_fence;
     uint64_t m_fenceValue = 0;
 
-    std::vector<winrt::com_ptr<ID3D12Resource>> m_buffers;
+    winrt::com_ptr<ID3D12DescriptorHeap> m_descriptorHeap;
+    uint32_t m_descriptorHandleSize = 0;
 
-    std::vector<winrt::com_ptr<ID3D12Resource>> m_textures;
+    static constexpr int MAX_TEXTURES = 128;
 
-    winrt::com_ptr<IWICImagingFactory> m_wicFactory;
+    std::mutex m_descriptorMutex;
+    std::vector<TextureId> m_freeTextureIds;
+    TextureId m_numTextureIds = 0;
 
-    winrt::com_ptr<ID3D12DescriptorHeap> m_descriptorHeap;
-    uint32_t m_descriptorHandleSize = 0;
+    std::atomic<uint64_t> m_numTextureFilesRead = 0;
+    std::atomic<uint64_t> m_numTexturesDecoded = 0;
+    std::atomic<uint64_t> m_numTexturesUploaded = 0;
+    std::atomic<uint64_t> m_textureReadBytes = 0;
+    std::atomic<uint64_t> m_textureUploadedBytes = 0;
 
-    CD3DX12_CPU_DESCRIPTOR_HANDLE m_currentCpuDescriptorHandle;
-    CD3DX12_GPU_DESCRIPTOR_HANDLE m_currentGpuDescriptorHandle;
+    mutable std::mutex m_geometryStatsMutex;
+    GeometryStats m_geometryStats;
 
-    std::unordered_map<TextureId, D3D12_GPU_DESCRIPTOR_HANDLE> m_textureSrvHandles;
+    // Declared last, so that the textures it destroys can still free their SRV slots.
+    ResourceRegistry m_registry;
 };
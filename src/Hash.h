@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+// Incremental 64-bit FNV-1a. Stable across runs and platforms, so hashes can be persisted.
+class Hasher
+{
+public:
+    void AddBytes(const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            m_hash = (m_hash ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+
+    void AddBytes(std::span<const std::byte> data)
+    {
+        AddBytes(data.data(), data.size());
+    }
+
+    // Integers, enums and bools are hashed by value, with a fixed width so that the result does
+    // not depend on the declared type's size.
+    template<typename T>
+        requires std::is_integral_v<T> || std::is_enum_v<T>
+    void Add(T value)
+    {
+        uint64_t bits = 0;
+
+        if constexpr (std::is_enum_v<T>)
+            bits = static_cast<uint64_t>(static_cast<std::underlying_type_t<T>>(value));
+        else
+            bits = static_cast<uint64_t>(value);
+
+        AddBytes(&bits, sizeof(bits));
+    }
+
+    void Add(float value)
+    {
+        // -0 and +0 compare equal, so they must hash equal as well.
+        Add(std::bit_cast<uint32_t>(value == 0.f ? 0.f : value));
+    }
+
+    // Length-prefixed so that consecutive strings cannot alias.
+    void Add(std::string_view str)
+    {
+        Add(str.size());
+        AddBytes(str.data(), str.size());
+    }
+
+    uint64_t GetHash() const
+    {
+        return m_hash;
+    }
+
+private:
+    uint64_t m_hash = 14695981039346656037ull;
+};
+
+inline uint64_t HashBytes(std::span<const std::byte> data)
+{
+    Hasher hasher;
+    hasher.AddBytes(data);
+
+    return hasher.GetHash();
+}
+
+// Incremental xxHash64 with a zero seed, for large blobs such as file contents and pixels. Each of
+// four lanes takes 8 bytes of every 32-byte stripe, so their multiplies overlap and the hash runs
+// at several bytes per cycle where FNV-1a manages one. Input is read as little-endian, which all
+// supported platforms are, so hashes are stable and can be persisted.
+class ContentHasher
+{
+public:
+    void AddBytes(const void* data, size_t size)
+    {
+        if (size == 0)
+            return;
+
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+        m_totalSize += size;
+
+        if (m_bufferSize > 0)
+        {
+            size_t numCopied = std::min(size, STRIPE_SIZE - m_bufferSize);
+            std::memcpy(m_buffer + m_bufferSize, bytes, numCopied);
+
+            m_bufferSize += numCopied;
+            bytes += numCopied;
+            size -= numCopied;
+
+            if (m_bufferSize < STRIPE_SIZE)
+                return;
+
+            ConsumeStripe(m_buffer);
+            m_bufferSize = 0;
+        }
+
+        for (; size >= STRIPE_SIZE; bytes += STRIPE_SIZE, size -= STRIPE_SIZE)
+        {
+            ConsumeStripe(bytes);
+        }
+
+        std::memcpy(m_buffer, bytes, size);
+        m_bufferSize = size;
+    }
+
+    void AddBytes(std::span<const std::byte> data)
+    {
+        AddBytes(data.data(), data.size());
+    }
+
+    uint64_t GetHash() const
+    {
+        uint64_t hash = 0;
+
+        if (m_totalSize >= STRIPE_SIZE)
+        {
+            hash = std::rotl(m_lanes[0], 1) + std::rotl(m_lanes[1], 7) +
+                std::rotl(m_lanes[2], 12) + std::rotl(m_lanes[3], 18);
+
+            for (uint64_t lane : m_lanes)
+            {
+                hash = (hash ^ Round(0, lane)) * PRIME1 + PRIME4;
+            }
+        }
+        else
+        {
+            hash = PRIME5;
+        }
+
+        hash += m_totalSize;
+
+        const uint8_t* bytes = m_buffer;
+        size_t size = m_bufferSize;
+
+        for (; size >= 8; bytes += 8, size -= 8)
+        {
+            hash = std::rotl(hash ^ Round(0, Load<uint64_t>(bytes)), 27) * PRIME1 + PRIME4;
+        }
+
+        if (size >= 4)
+        {
+            hash = std::rotl(hash ^ (Load<uint32_t>(bytes) * PRIME1), 23) * PRIME2 + PRIME3;
+            bytes += 4;
+            size -= 4;
+        }
+
+        for (; size > 0; ++bytes, --size)
+        {
+            hash = std::rotl(hash ^ (*bytes * PRIME5), 11) * PRIME1;
+        }
+
+        hash = (hash ^ (hash >> 33)) * PRIME2;
+        hash = (hash ^ (hash >> 29)) * PRIME3;
+
+        return hash ^ (hash >> 32);
+    }
+
+private:
+    static constexpr size_t STRIPE_SIZE = 32;
+
+    static constexpr uint64_t PRIME1 = 0x9e3779b185ebca87ull;
+    static constexpr uint64_t PRIME2 = 0xc2b2ae3d27d4eb4full;
+    static constexpr uint64_t PRIME3 = 0x165667b19e3779f9ull;
+    static constexpr uint64_t PRIME4 = 0x85ebca77c2b2ae63ull;
+    static constexpr uint64_t PRIME5 = 0x27d4eb2f165667c5ull;
+
+    template<typename T>
+    static T Load(const uint8_t* bytes)
+    {
+        T value;
+        std::memcpy(&value, bytes, sizeof(T));
+
+        return value;
+    }
+
+    static uint64_t Round(uint64_t lane, uint64_t input)
+    {
+        return std::rotl(lane + input * PRIME2, 31) * PRIME1;
+    }
+
+    void ConsumeStripe(const uint8_t* stripe)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            m_lanes[i] = Round(m_lanes[i], Load<uint64_t>(stripe + 8 * i));
+        }
+    }
+
+    uint64_t m_lanes[4] = {PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1};
+
+    uint8_t m_buffer[STRIPE_SIZE] = {};
+    size_t m_bufferSize = 0;
+
+    uint64_t m_totalSize = 0;
+};
+
+inline uint64_t HashContent(std::span<const std::byte> data)
+{
+    ContentHasher hasher;
+    hasher.AddBytes(data);
+
+    return hasher.GetHash();
+}
@@ -0,0 +1,305 @@
+// Benchmark for the JPEG and PNG decoders. Decodes every image in a directory at each SIMD level
+// supported by the CPU, checks that all levels produce the same pixels and that those match the
+// hashes of the libjpeg and libpng output recorded in a reference file, then measures decode
+// throughput per level. Exits with an error if any check fails.
+
+#include "BenchmarkUtils.h"
+#include "Hash.h"
+#include "ImageDecoder.h"
+#include "Utils.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+
+struct Options
+{
+    std::string OutPath = "image_benchmark_results.json";
+
+    std::string ImageDir = "assets/sponza";
+    std::string ReferencePath = "assets/sponza/decode_reference.json";
+
+    int NumIterations = 5;
+};
+
+constexpr const char* USAGE =
+    "Usage: ImageBenchmark [options]\n"
+    "  --dir DIR           Directory of .jpg and .png files (default assets/sponza)\n"
+    "  --reference FILE    Expected pixel hashes, \"none\" to skip\n"
+    "                      (default assets/sponza/decode_reference.json)\n"
+    "  --iterations N      Timed runs per level, the fastest is reported (default 5)\n"
+    "  --out FILE          Results file (default image_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--dir")
+            options->ImageDir = value;
+        else if (arg == "--reference")
+            options->ReferencePath = value;
+        else if (arg == "--iterations")
+            options->NumIterations = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->NumIterations > 0;
+}
+
+struct ImageFile
+{
+    std::string Name;
+    std::vector<std::byte> Data;
+};
+
+std::vector<ImageFile> LoadImageFiles(const std::string& dir)
+{
+    std::vector<ImageFile> files;
+
+    for (const fs::directory_entry& entry : fs::directory_iterator(dir))
+    {
+        fs::path extension = entry.path().extension();
+
+        if (extension != ".jpg" && extension != ".png")
+            continue;
+
+        std::ifstream file(entry.path(), std::ios::binary);
+
+        if (!file)
+            throw std::runtime_error("Could not open file.");
+
+        std::vector<char> bytes{std::istreambuf_iterator<char>(file), {}};
+
+        ImageFile image;
+        image.Name = entry.path().filename().string();
+        image.Data.resize(bytes.size());
+        std::memcpy(image.Data.data(), bytes.data(), bytes.size());
+
+        files.push_back(std::move(image));
+    }
+
+    std::sort(files.begin(), files.end(),
+              [](const ImageFile& a, const ImageFile& b) { return a.Name < b.Name; });
+
+    return files;
+}
+
+struct DecodedImage
+{
+    size_t Width = 0;
+    size_t Height = 0;
+    size_t RowPitch = 0;
+};
+
+// Decodes into rows laid out like a texture upload buffer.
+DecodedImage DecodeImage(const ImageFile& image, const PixelKernels& kernels,
+                         std::vector<uint8_t>* pixels)
+{
+    constexpr size_t rowPitchAlignment = 256;
+
+    std::unique_ptr<ImageDecoder> decoder = CreateImageDecoder(image.Data, kernels);
+
+    DecodedImage decoded;
+    decoded.Width = decoder->GetWidth();
+    decoded.Height = decoder->GetHeight();
+    decoded.RowPitch = utils::Align(decoded.Width * 4, rowPitchAlignment);
+
+    if (pixels->size() < decoded.RowPitch * decoded.Height)
+        pixels->resize(decoded.RowPitch * decoded.Height);
+
+    decoder->Decode(pixels->data(), decoded.RowPitch);
+
+    return decoded;
+}
+
+// Hash of the tightly packed pixels, as recorded in the reference file.
+std::string HashPixels(const ImageFile& image, const PixelKernels& kernels)
+{
+    std::vector<uint8_t> pixels;
+    DecodedImage decoded = DecodeImage(image, kernels, &pixels);
+
+    Hasher hasher;
+
+    for (size_t y = 0; y < decoded.Height; ++y)
+    {
+        hasher.AddBytes(pixels.data() + y * decoded.RowPitch, decoded.Width * 4);
+    }
+
+    char hash[17];
+    std::snprintf(hash, sizeof(hash), "%016" PRIx64, hasher.GetHash());
+
+    return hash;
+}
+
+void CheckLevels(const std::vector<ImageFile>& files,
+                 const std::vector<const PixelKernels*>& levels, const json& reference,
+                 Checks* checks)
+{
+    for (const ImageFile& image : files)
+    {
+        std::string scalarHash = HashPixels(image, *levels[0]);
+
+        if (!reference.is_null())
+        {
+            bool matches = reference.contains(image.Name) && reference[image.Name] == scalarHash;
+            checks->Check("reference_" + image.Name, matches);
+        }
+
+        for (size_t i = 1; i < levels.size(); ++i)
+        {
+            std::string name = std::string(GetSimdLevelName(levels[i]->Level)) + "_" + image.Name;
+            checks->Check(name, HashPixels(image, *levels[i]) == scalarHash);
+        }
+    }
+}
+
+json MeasureLevel(const Options& options, const std::vector<ImageFile>& files,
+                  const PixelKernels& kernels)
+{
+    std::vector<uint8_t> pixels;
+    double bestSec[2] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+    size_t numBytes[2] = {};
+    size_t numPixels[2] = {};
+
+    for (int iteration = 0; iteration < options.NumIterations; ++iteration)
+    {
+        double sec[2] = {};
+
+        for (const ImageFile& image : files)
+        {
+            size_t format = fs::path(image.Name).extension() == ".png" ? 1 : 0;
+            Clock::time_point start = Clock::now();
+            DecodedImage decoded = DecodeImage(image, kernels, &pixels);
+            sec[format] += std::chrono::duration<double>(Clock::now() - start).count();
+
+            if (iteration == 0)
+            {
+                numBytes[format] += image.Data.size();
+                numPixels[format] += decoded.Width * decoded.Height;
+            }
+        }
+
+        bestSec[0] = std::min(bestSec[0], sec[0]);
+        bestSec[1] = std::min(bestSec[1], sec[1]);
+    }
+
+    json results = json::object();
+    const char* formatNames[2] = {"jpeg", "png"};
+
+    for (size_t format = 0; format < 2; ++format)
+    {
+        if (numPixels[format] == 0)
+            continue;
+
+        results[formatNames[format]] = {
+            {"ms", bestSec[format] * 1e3},
+            {"input_mb_per_sec", static_cast<double>(numBytes[format]) / bestSec[format] / 1e6},
+            {"megapixels_per_sec",
+             static_cast<double>(numPixels[format]) / bestSec[format] / 1e6}
+        };
+    }
+
+    return results;
+}
+
+int RunBenchmark(const Options& options)
+{
+    std::vector<ImageFile> files = LoadImageFiles(options.ImageDir);
+
+    if (files.empty())
+    {
+        std::fprintf(stderr, "No images in %s.\n", options.ImageDir.c_str());
+        return 1;
+    }
+
+    json reference;
+
+    if (options.ReferencePath != "none")
+    {
+        std::ifstream file(options.ReferencePath);
+
+        if (!file)
+        {
+            std::fprintf(stderr, "Could not open %s.\n", options.ReferencePath.c_str());
+            return 1;
+        }
+
+        reference = json::parse(file);
+    }
+
+    std::vector<const PixelKernels*> levels;
+
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2, SimdLevel::Neon})
+    {
+        if (IsSimdLevelSupported(level))
+            levels.push_back(&GetPixelKernels(level));
+    }
+
+    Checks checks;
+    CheckLevels(files, levels, reference, &checks);
+
+    json decoding = json::object();
+
+    for (const PixelKernels* kernels : levels)
+    {
+        decoding[GetSimdLevelName(kernels->Level)] = MeasureLevel(options, files, *kernels);
+    }
+
+    json results = {
+        {"dir", options.ImageDir},
+        {"images", files.size()},
+        {"iterations", options.NumIterations},
+        {"selected_level", GetSimdLevelName(GetPixelKernels().Level)},
+        {"decoding", decoding},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", decoding.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Image decoder checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
@@ -0,0 +1,18 @@
+#include "ImageDecoder.h"
+
+#include "JpegDecoder.h"
+#include "PngDecoder.h"
+
+#include <stdexcept>
+
+std::unique_ptr<ImageDecoder> CreateImageDecoder(std::span<const std::byte> data,
+                                                 const PixelKernels& kernels)
+{
+    if (JpegDecoder::HasSignature(data))
+        return std::make_unique<JpegDecoder>(data, kernels);
+
+    if (PngDecoder::HasSignature(data))
+        return std::make_unique<PngDecoder>(data, kernels);
+
+    throw std::runtime_error("Unsupported image format.");
+}
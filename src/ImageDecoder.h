@@ -0,0 +1,27 @@
+#pragma once
+
+#include "PixelKernels.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+// Decodes an image file held in memory to RGBA8. The file data must outlive the decoder.
+class ImageDecoder
+{
+public:
+    virtual ~ImageDecoder() = default;
+
+    virtual uint32_t GetWidth() const = 0;
+    virtual uint32_t GetHeight() const = 0;
+
+    // Writes the rows |rowPitch| bytes apart. They are written front to back and never read, so
+    // |dst| can be upload memory. Throws if the file is corrupt.
+    virtual void Decode(uint8_t* dst, size_t rowPitch) = 0;
+};
+
+// Picks the decoder from the file signature and reads the header. Throws if the format or one of
+// its features is not supported.
+std::unique_ptr<ImageDecoder> CreateImageDecoder(std::span<const std::byte> data,
+                                                 const PixelKernels& kernels = GetPixelKernels());
@@ -0,0 +1,701 @@
+#include "Inflate.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+// Huffman tables are decoded with one lookup of their first TABLE_BITS bits, plus a second one in
+// a subtable for the rare longer codes.
+constexpr uint32_t LITLEN_TABLE_BITS = 10;
+constexpr uint32_t DIST_TABLE_BITS = 8;
+constexpr uint32_t PRECODE_TABLE_BITS = 7;
+
+constexpr uint32_t MAX_CODE_LENGTH = 15;
+constexpr uint32_t NUM_LITLEN_SYMBOLS = 288;
+constexpr uint32_t NUM_DIST_SYMBOLS = 32;
+constexpr uint32_t NUM_PRECODE_SYMBOLS = 19;
+
+// A table entry packs the value in bits 16 to 31, the number of extra bits (or the number of
+// index bits of a subtable) in bits 8 to 15, the kind in bits 4 to 7 and the number of code bits
+// it consumes in bits 0 to 3.
+enum EntryKind : uint32_t
+{
+    ENTRY_LITERAL,
+    ENTRY_LENGTH,
+    ENTRY_DISTANCE,
+    ENTRY_END_OF_BLOCK,
+    ENTRY_SUBTABLE,
+    ENTRY_INVALID
+};
+
+constexpr uint32_t MakeEntry(EntryKind kind, uint32_t value, uint32_t extraBits = 0)
+{
+    return (value << 16) | (extraBits << 8) | (kind << 4);
+}
+
+uint32_t GetEntryValue(uint32_t entry)
+{
+    return entry >> 16;
+}
+
+uint32_t GetEntryExtraBits(uint32_t entry)
+{
+    return (entry >> 8) & 0xFF;
+}
+
+EntryKind GetEntryKind(uint32_t entry)
+{
+    return static_cast<EntryKind>((entry >> 4) & 0xF);
+}
+
+uint32_t GetEntryCodeBits(uint32_t entry)
+{
+    return entry & 0xF;
+}
+
+struct SymbolTables
+{
+    std::array<uint32_t, NUM_LITLEN_SYMBOLS> Litlen;
+    std::array<uint32_t, NUM_DIST_SYMBOLS> Dist;
+    std::array<uint32_t, NUM_PRECODE_SYMBOLS> Precode;
+
+    SymbolTables()
+    {
+        static constexpr uint16_t LENGTH_BASE[] = {3,  4,  5,  6,  7,  8,  9,  10,  11,  13,
+                                                   15, 17, 19, 23, 27, 31, 35, 43,  51,  59,
+                                                   67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static constexpr uint8_t LENGTH_EXTRA[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                                   2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static constexpr uint16_t DIST_BASE[] = {1,    2,    3,    4,    5,    7,     9,    13,
+                                                 17,   25,   33,   49,   65,   97,    129,  193,
+                                                 257,  385,  513,  769,  1025, 1537,  2049, 3073,
+                                                 4097, 6145, 8193, 12289, 16385, 24577};
+
+        for (uint32_t i = 0; i < 256; ++i)
+            Litlen[i] = MakeEntry(ENTRY_LITERAL, i);
+
+        Litlen[256] = MakeEntry(ENTRY_END_OF_BLOCK, 0);
+
+        for (uint32_t i = 257; i < NUM_LITLEN_SYMBOLS; ++i)
+        {
+            Litlen[i] = i < 286 ? MakeEntry(ENTRY_LENGTH, LENGTH_BASE[i - 257],
+                                            LENGTH_EXTRA[i - 257]) :
+                                  MakeEntry(ENTRY_INVALID, 0);
+        }
+
+        for (uint32_t i = 0; i < NUM_DIST_SYMBOLS; ++i)
+        {
+            // Distance codes 0 to 3 have no extra bits, and every following pair one more.
+            Dist[i] = i < 30 ? MakeEntry(ENTRY_DISTANCE, DIST_BASE[i], i < 4 ? 0 : i / 2 - 1) :
+                               MakeEntry(ENTRY_INVALID, 0);
+        }
+
+        for (uint32_t i = 0; i < NUM_PRECODE_SYMBOLS; ++i)
+            Precode[i] = MakeEntry(ENTRY_LITERAL, i);
+    }
+};
+
+const SymbolTables& GetSymbolTables()
+{
+    static const SymbolTables tables;
+
+    return tables;
+}
+
+uint32_t ReverseBits(uint32_t code, uint32_t numBits)
+{
+    uint32_t reversed = 0;
+
+    for (uint32_t i = 0; i < numBits; ++i)
+    {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+
+    return reversed;
+}
+
+class HuffmanTable
+{
+public:
+    // |symbols| holds each symbol's entry without its code length. Incomplete codes are accepted,
+    // but decoding one of the missing codes throws.
+    void Build(const uint8_t* lengths, uint32_t numSymbols, const uint32_t* symbols,
+               uint32_t tableBits)
+    {
+        uint32_t counts[MAX_CODE_LENGTH + 1] = {};
+
+        for (uint32_t i = 0; i < numSymbols; ++i)
+            ++counts[lengths[i]];
+
+        counts[0] = 0;
+
+        int32_t unused = 1;
+
+        for (uint32_t length = 1; length <= MAX_CODE_LENGTH; ++length)
+        {
+            unused = 2 * unused - static_cast<int32_t>(counts[length]);
+
+            if (unused < 0)
+                throw std::runtime_error("Invalid deflate stream.");
+        }
+
+        // Canonical codes, bit-reversed since deflate packs them starting with the last bit.
+        uint32_t nextCode[MAX_CODE_LENGTH + 1] = {};
+
+        for (uint32_t length = 1; length <= MAX_CODE_LENGTH; ++length)
+            nextCode[length] = (nextCode[length - 1] + counts[length - 1]) << 1;
+
+        uint32_t codes[NUM_LITLEN_SYMBOLS];
+
+        for (uint32_t i = 0; i < numSymbols; ++i)
+        {
+            if (lengths[i] != 0)
+                codes[i] = ReverseBits(nextCode[lengths[i]]++, lengths[i]);
+        }
+
+        uint32_t rootSize = 1u << tableBits;
+
+        m_tableBits = tableBits;
+        m_entries.assign(rootSize, MakeEntry(ENTRY_INVALID, 0));
+
+        // Each root entry whose codes are longer than the root points to a subtable big enough
+        // for the longest of them.
+        uint8_t subtableBits[1u << LITLEN_TABLE_BITS] = {};
+
+        for (uint32_t i = 0; i < numSymbols; ++i)
+        {
+            if (lengths[i] > tableBits)
+            {
+                uint8_t& bits = subtableBits[codes[i] & (rootSize - 1)];
+                bits = std::max<uint8_t>(bits, static_cast<uint8_t>(lengths[i] - tableBits));
+            }
+        }
+
+        for (uint32_t i = 0; i < rootSize; ++i)
+        {
+            if (subtableBits[i] != 0)
+            {
+                m_entries[i] = MakeEntry(ENTRY_SUBTABLE, static_cast<uint32_t>(m_entries.size()),
+                                         subtableBits[i]) |
+                    tableBits;
+                m_entries.resize(m_entries.size() + (1u << subtableBits[i]),
+                                 MakeEntry(ENTRY_INVALID, 0));
+            }
+        }
+
+        for (uint32_t i = 0; i < numSymbols; ++i)
+        {
+            uint32_t length = lengths[i];
+
+            if (length == 0)
+                continue;
+
+            if (length <= tableBits)
+            {
+                for (uint32_t index = codes[i]; index < rootSize; index += 1u << length)
+                    m_entries[index] = symbols[i] | length;
+            }
+            else
+            {
+                uint32_t root = m_entries[codes[i] & (rootSize - 1)];
+                uint32_t offset = GetEntryValue(root);
+                uint32_t size = 1u << GetEntryExtraBits(root);
+                uint32_t subLength = length - tableBits;
+
+                for (uint32_t index = codes[i] >> tableBits; index < size; index += 1u << subLength)
+                    m_entries[offset + index] = symbols[i] | subLength;
+            }
+        }
+    }
+
+    uint32_t GetTableBits() const
+    {
+        return m_tableBits;
+    }
+
+    const uint32_t* GetEntries() const
+    {
+        return m_entries.data();
+    }
+
+private:
+    uint32_t m_tableBits = 0;
+    std::vector<uint32_t> m_entries;
+};
+
+// Reads bits starting with the least significant bit of each byte. Past the end of the input it
+// reads zeros, which the caller detects through GetBitPosition().
+class BitReader
+{
+public:
+    explicit BitReader(std::span<const std::byte> src)
+        : m_begin(reinterpret_cast<const uint8_t*>(src.data()))
+        , m_next(m_begin)
+        , m_end(m_begin + src.size())
+    {
+    }
+
+    // Makes at least 56 bits available.
+    void Refill()
+    {
+        if (m_end - m_next >= 8)
+        {
+            // Loads 8 bytes and keeps as many whole ones as fit. The remaining bits are loaded
+            // again, to the same place, by the next refill. Assumes a little-endian CPU.
+            uint64_t word;
+            std::memcpy(&word, m_next, sizeof(word));
+
+            m_bits |= word << m_count;
+            m_next += (63 - m_count) >> 3;
+            m_count |= 56;
+        }
+        else
+        {
+            while (m_count <= 56)
+            {
+                if (m_next < m_end)
+                    m_bits |= static_cast<uint64_t>(*m_next++) << m_count;
+                else
+                    ++m_overrun;
+
+                m_count += 8;
+            }
+        }
+    }
+
+    uint32_t Peek(uint32_t numBits) const
+    {
+        return static_cast<uint32_t>(m_bits & ((1ull << numBits) - 1));
+    }
+
+    void Consume(uint32_t numBits)
+    {
+        m_bits >>= numBits;
+        m_count -= numBits;
+    }
+
+    uint32_t Read(uint32_t numBits)
+    {
+        uint32_t value = Peek(numBits);
+        Consume(numBits);
+
+        return value;
+    }
+
+    // Only valid right after a refill.
+    uint32_t Decode(const HuffmanTable& table)
+    {
+        const uint32_t* entries = table.GetEntries();
+        uint32_t entry = entries[Peek(table.GetTableBits())];
+
+        if (GetEntryKind(entry) == ENTRY_SUBTABLE)
+        {
+            Consume(table.GetTableBits());
+            entry = entries[GetEntryValue(entry) + Peek(GetEntryExtraBits(entry))];
+        }
+
+        Consume(GetEntryCodeBits(entry));
+
+        return entry;
+    }
+
+    uint64_t GetBitPosition() const
+    {
+        return 8 * static_cast<uint64_t>(m_next - m_begin + m_overrun) - m_count;
+    }
+
+    void SkipToByte()
+    {
+        Consume(m_count & 7);
+    }
+
+    // Restarts reading at a byte offset, discarding the buffered bits.
+    void Seek(size_t offset)
+    {
+        m_next = m_begin + offset;
+        m_bits = 0;
+        m_count = 0;
+        m_overrun = 0;
+    }
+
+    size_t GetSize() const
+    {
+        return static_cast<size_t>(m_end - m_begin);
+    }
+
+    const uint8_t* GetData() const
+    {
+        return m_begin;
+    }
+
+    bool IsPastEnd() const
+    {
+        return GetBitPosition() > 8 * static_cast<uint64_t>(GetSize());
+    }
+
+private:
+    const uint8_t* m_begin;
+    const uint8_t* m_next;
+    const uint8_t* m_end;
+
+    uint64_t m_bits = 0;
+    uint32_t m_count = 0;
+
+    // Zero bytes read past the end.
+    uint32_t m_overrun = 0;
+};
+
+class Inflater
+{
+public:
+    Inflater(std::span<const std::byte> src, std::span<uint8_t> dst)
+        : m_reader(src)
+        , m_outBegin(dst.data())
+        , m_out(dst.data())
+        , m_outEnd(dst.data() + dst.size())
+    {
+    }
+
+    size_t Run()
+    {
+        bool finalBlock = false;
+
+        while (!finalBlock)
+        {
+            m_reader.Refill();
+
+            if (m_reader.IsPastEnd())
+                Fail();
+
+            finalBlock = m_reader.Read(1) != 0;
+
+            switch (m_reader.Read(2))
+            {
+                case 0:
+                    CopyStoredBlock();
+                    break;
+                case 1:
+                    BuildFixedTables();
+                    DecodeBlock();
+                    break;
+                case 2:
+                    ReadDynamicTables();
+                    DecodeBlock();
+                    break;
+                default:
+                    Fail();
+            }
+        }
+
+        if (m_reader.IsPastEnd() || m_out != m_outEnd)
+            Fail();
+
+        return static_cast<size_t>((m_reader.GetBitPosition() + 7) / 8);
+    }
+
+private:
+    [[noreturn]] static void Fail()
+    {
+        throw std::runtime_error("Invalid deflate stream.");
+    }
+
+    void CopyStoredBlock()
+    {
+        m_reader.SkipToByte();
+
+        uint32_t length = m_reader.Read(16);
+        uint32_t inverted = m_reader.Read(16);
+
+        if (length != (~inverted & 0xFFFF))
+            Fail();
+
+        size_t position = static_cast<size_t>(m_reader.GetBitPosition() / 8);
+
+        if (length > m_reader.GetSize() - std::min(position, m_reader.GetSize()) ||
+            length > static_cast<size_t>(m_outEnd - m_out))
+        {
+            Fail();
+        }
+
+        // Empty blocks may come with an empty output.
+        if (length > 0)
+        {
+            std::memcpy(m_out, m_reader.GetData() + position, length);
+            m_out += length;
+        }
+
+        m_reader.Seek(position + length);
+    }
+
+    void BuildFixedTables()
+    {
+        uint8_t lengths[NUM_LITLEN_SYMBOLS + NUM_DIST_SYMBOLS];
+
+        std::fill_n(lengths, 144, uint8_t(8));
+        std::fill_n(lengths + 144, 112, uint8_t(9));
+        std::fill_n(lengths + 256, 24, uint8_t(7));
+        std::fill_n(lengths + 280, 8, uint8_t(8));
+        std::fill_n(lengths + NUM_LITLEN_SYMBOLS, NUM_DIST_SYMBOLS, uint8_t(5));
+
+        BuildTables(lengths, NUM_LITLEN_SYMBOLS, NUM_DIST_SYMBOLS);
+    }
+
+    void ReadDynamicTables()
+    {
+        static constexpr uint8_t PRECODE_ORDER[NUM_PRECODE_SYMBOLS] = {
+            16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+        uint32_t numLitlen = m_reader.Read(5) + 257;
+        uint32_t numDist = m_reader.Read(5) + 1;
+        uint32_t numPrecode = m_reader.Read(4) + 4;
+
+        if (numLitlen > 286 || numDist > 30)
+            Fail();
+
+        uint8_t precodeLengths[NUM_PRECODE_SYMBOLS] = {};
+
+        for (uint32_t i = 0; i < numPrecode; ++i)
+        {
+            m_reader.Refill();
+            precodeLengths[PRECODE_ORDER[i]] = static_cast<uint8_t>(m_reader.Read(3));
+        }
+
+        m_precode.Build(precodeLengths, NUM_PRECODE_SYMBOLS, GetSymbolTables().Precode.data(),
+                        PRECODE_TABLE_BITS);
+
+        uint8_t lengths[NUM_LITLEN_SYMBOLS + NUM_DIST_SYMBOLS];
+        uint32_t numLengths = numLitlen + numDist;
+
+        for (uint32_t i = 0; i < numLengths;)
+        {
+            m_reader.Refill();
+
+            uint32_t entry = m_reader.Decode(m_precode);
+
+            if (GetEntryKind(entry) != ENTRY_LITERAL)
+                Fail();
+
+            uint32_t symbol = GetEntryValue(entry);
+
+            if (symbol < 16)
+            {
+                lengths[i++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+
+            uint8_t value = 0;
+            uint32_t count = 0;
+
+            if (symbol == 16)
+            {
+                if (i == 0)
+                    Fail();
+
+                value = lengths[i - 1];
+                count = 3 + m_reader.Read(2);
+            }
+            else if (symbol == 17)
+            {
+                count = 3 + m_reader.Read(3);
+            }
+            else
+            {
+                count = 11 + m_reader.Read(7);
+            }
+
+            if (count > numLengths - i)
+                Fail();
+
+            std::fill_n(lengths + i, count, value);
+            i += count;
+        }
+
+        if (lengths[256] == 0)
+            Fail();
+
+        BuildTables(lengths, numLitlen, numDist);
+    }
+
+    void BuildTables(const uint8_t* lengths, uint32_t numLitlen, uint32_t numDist)
+    {
+        const SymbolTables& symbols = GetSymbolTables();
+
+        m_litlen.Build(lengths, numLitlen, symbols.Litlen.data(), LITLEN_TABLE_BITS);
+        m_dist.Build(lengths + numLitlen, numDist, symbols.Dist.data(), DIST_TABLE_BITS);
+    }
+
+    void DecodeBlock()
+    {
+        for (;;)
+        {
+            // A length code with its extra bits and a distance code with its extra bits take at
+            // most 48 bits, so one refill covers a whole match.
+            m_reader.Refill();
+
+            uint32_t entry = m_reader.Decode(m_litlen);
+
+            switch (GetEntryKind(entry))
+            {
+                case ENTRY_LITERAL:
+                    if (m_out == m_outEnd)
+                        Fail();
+
+                    *m_out++ = static_cast<uint8_t>(GetEntryValue(entry));
+                    break;
+                case ENTRY_LENGTH:
+                {
+                    uint32_t length = GetEntryValue(entry) +
+                        m_reader.Read(GetEntryExtraBits(entry));
+
+                    uint32_t distEntry = m_reader.Decode(m_dist);
+
+                    if (GetEntryKind(distEntry) != ENTRY_DISTANCE)
+                        Fail();
+
+                    uint32_t distance = GetEntryValue(distEntry) +
+                        m_reader.Read(GetEntryExtraBits(distEntry));
+
+                    CopyMatch(length, distance);
+                    break;
+                }
+                case ENTRY_END_OF_BLOCK:
+                    if (m_reader.IsPastEnd())
+                        Fail();
+
+                    return;
+                default:
+                    Fail();
+            }
+        }
+    }
+
+    void CopyMatch(uint32_t length, uint32_t distance)
+    {
+        if (distance > static_cast<size_t>(m_out - m_outBegin) ||
+            length > static_cast<size_t>(m_outEnd - m_out))
+        {
+            Fail();
+        }
+
+        const uint8_t* from = m_out - distance;
+        uint8_t* end = m_out + length;
+
+        if (distance >= 8 && m_outEnd - end >= 8)
+        {
+            // Copies 8 bytes at a time, which may write a few bytes past the match. They are
+            // overwritten later.
+            do
+            {
+                std::memcpy(m_out, from, 8);
+                m_out += 8;
+                from += 8;
+            } while (m_out < end);
+        }
+        else if (distance == 1)
+        {
+            std::memset(m_out, *from, length);
+        }
+        else
+        {
+            while (m_out < end)
+                *m_out++ = *from++;
+        }
+
+        m_out = end;
+    }
+
+    BitReader m_reader;
+
+    uint8_t* m_outBegin;
+    uint8_t* m_out;
+    uint8_t* m_outEnd;
+
+    HuffmanTable m_litlen;
+    HuffmanTable m_dist;
+    HuffmanTable m_precode;
+};
+
+} // namespace
+
+size_t Inflate(std::span<const std::byte> src, std::span<uint8_t> dst)
+{
+    return Inflater(src, dst).Run();
+}
+
+void InflateZlib(std::span<const std::byte> src, std::span<uint8_t> dst)
+{
+    if (src.size() < 6)
+        throw std::runtime_error("Invalid zlib stream.");
+
+    uint32_t method = static_cast<uint32_t>(src[0]);
+    uint32_t flags = static_cast<uint32_t>(src[1]);
+
+    // Deflate with a window of at most 32 KB, a valid header check and no preset dictionary.
+    if ((method & 0xF) != 8 || (method >> 4) > 7 || (method * 256 + flags) % 31 != 0 ||
+        (flags & 0x20) != 0)
+    {
+        throw std::runtime_error("Invalid zlib stream.");
+    }
+
+    size_t size = Inflate(src.subspan(2), dst);
+
+    if (src.size() - 2 - size < 4)
+        throw std::runtime_error("Invalid zlib stream.");
+
+    uint32_t checksum = 0;
+
+    for (size_t i = 0; i < 4; ++i)
+        checksum = (checksum << 8) | static_cast<uint32_t>(src[2 + size + i]);
+
+    if (checksum != Adler32(dst))
+        throw std::runtime_error("Invalid zlib stream.");
+}
+
+uint32_t Adler32(std::span<const uint8_t> data)
+{
+    // The largest number of bytes after which the sums still fit in 32 bits.
+    constexpr size_t BLOCK_SIZE = 5552;
+    constexpr uint32_t MODULUS = 65521;
+
+    uint32_t a = 1;
+    uint32_t b = 0;
+
+    const uint8_t* bytes = data.data();
+    size_t remaining = data.size();
+
+    while (remaining > 0)
+    {
+        size_t blockSize = std::min(remaining, BLOCK_SIZE);
+        remaining -= blockSize;
+
+        for (; blockSize >= 4; blockSize -= 4)
+        {
+            a += bytes[0];
+            b += a;
+            a += bytes[1];
+            b += a;
+            a += bytes[2];
+            b += a;
+            a += bytes[3];
+            b += a;
+            bytes += 4;
+        }
+
+        for (; blockSize > 0; --blockSize)
+        {
+            a += *bytes++;
+            b += a;
+        }
+
+        a %= MODULUS;
+        b %= MODULUS;
+    }
+
+    return (b << 16) | a;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// Decompresses a raw deflate stream (RFC 1951) into |dst|, which must be exactly the size of the
+// uncompressed data. Returns the number of bytes of |src| the stream took up. Throws if the
+// stream is invalid or does not fill |dst| exactly.
+size_t Inflate(std::span<const std::byte> src, std::span<uint8_t> dst);
+
+// The same for a zlib stream (RFC 1950), whose checksum is verified.
+void InflateZlib(std::span<const std::byte> src, std::span<uint8_t> dst);
+
+uint32_t Adler32(std::span<const uint8_t> data);
@@ -0,0 +1,290 @@
+// Benchmark for the input dispatch core: event queue throughput, cross-thread hand-off latency and
+// listener registration cost. Portable, so it runs wherever the frame benchmark does.
+
+#include "AllocationTracker.h"
+#include "BenchmarkUtils.h"
+#include "InputManager.h"
+#include "Utils.h"
+
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Clock;
+
+struct Options
+{
+    std::string OutPath = "input_benchmark_results.json";
+
+    int NumEvents = 1'000'000;
+    int NumListeners = 64;
+
+    // Interval between events pushed by the producer thread in the latency test.
+    int ProducerIntervalUs = 2;
+};
+
+const std::string USAGE =
+    "Usage: InputBenchmark [options]\n"
+    "  --events N        Events per test (default 1000000)\n"
+    "  --listeners N     Key listeners registered, up to " +
+    std::to_string(InputManager::MAX_LISTENERS) + " (default 64)\n"
+    "  --interval US     Producer interval in the latency test (default 2)\n"
+    "  --out FILE        Results file (default input_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--events")
+            options->NumEvents = std::stoi(value);
+        else if (arg == "--listeners")
+            options->NumListeners = std::stoi(value);
+        else if (arg == "--interval")
+            options->ProducerIntervalUs = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->NumEvents > 0 && options->NumListeners >= 0 &&
+        static_cast<size_t>(options->NumListeners) <= InputManager::MAX_LISTENERS;
+}
+
+int64_t Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+}
+
+double ElapsedNs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// Half the listeners hold a flag, half count presses, spread across letter keys.
+std::vector<InputHandle> AddListeners(InputManager* inputManager, int numListeners,
+                                      bool* holdValue, int* pressCount)
+{
+    std::vector<InputHandle> handles;
+
+    for (int i = 0; i < numListeners; ++i)
+    {
+        KeyCode keyCode = 'A' + static_cast<KeyCode>(i % 26);
+
+        if (i % 2 == 0)
+        {
+            handles.push_back(inputManager->AddKeyHoldListener(keyCode, holdValue));
+        }
+        else
+        {
+            handles.push_back(inputManager->AddKeyPressListener(keyCode, [pressCount] {
+                ++*pressCount;
+            }));
+        }
+    }
+
+    return handles;
+}
+
+InputEvent MakeKeyEvent(int idx)
+{
+    InputEvent event{};
+    event.Type = idx % 2 == 0 ? InputEventType::KeyDown : InputEventType::KeyUp;
+    event.Code = 'A' + static_cast<KeyCode>((idx / 2) % 26);
+
+    return event;
+}
+
+// Push, collect and dispatch on one thread, in tick-sized batches.
+json RunThroughputTest(const Options& options)
+{
+    InputManager inputManager;
+
+    bool holdValue = false;
+    int pressCount = 0;
+    std::vector<InputHandle> handles = AddListeners(&inputManager, options.NumListeners,
+                                                    &holdValue, &pressCount);
+
+    constexpr int batchSize = 256;
+
+    double pushNs = 0.0;
+    double collectNs = 0.0;
+    double dispatchNs = 0.0;
+
+    uint64_t allocationsBefore = AllocationTracker::GetStats().GetTotalCount();
+
+    for (int begin = 0; begin < options.NumEvents; begin += batchSize)
+    {
+        int end = std::min(begin + batchSize, options.NumEvents);
+
+        Clock::time_point start = Clock::now();
+
+        for (int i = begin; i < end; ++i)
+        {
+            inputManager.PushEvent(MakeKeyEvent(i));
+        }
+
+        pushNs += ElapsedNs(start);
+
+        start = Clock::now();
+        inputManager.CollectEvents();
+        collectNs += ElapsedNs(start);
+
+        start = Clock::now();
+        inputManager.DispatchEvents();
+        dispatchNs += ElapsedNs(start);
+    }
+
+    uint64_t numAllocations = AllocationTracker::GetStats().GetTotalCount() -
+        allocationsBefore;
+
+    double numEvents = static_cast<double>(options.NumEvents);
+
+    return {
+        {"push_ns_per_event", pushNs / numEvents},
+        {"collect_ns_per_event", collectNs / numEvents},
+        {"dispatch_ns_per_event", dispatchNs / numEvents},
+        {"allocations", numAllocations},
+        {"press_callbacks", pressCount}
+    };
+}
+
+// A producer thread stands in for the window message thread while the consumer collects and
+// dispatches in a loop. Latency is from push to the start of dispatch.
+json RunLatencyTest(const Options& options)
+{
+    InputManager inputManager;
+
+    bool holdValue = false;
+    int pressCount = 0;
+    std::vector<InputHandle> handles = AddListeners(&inputManager, options.NumListeners,
+                                                    &holdValue, &pressCount);
+
+    std::atomic<bool> producerDone = false;
+
+    std::thread producer([&] {
+        auto interval = std::chrono::microseconds(options.ProducerIntervalUs);
+        Clock::time_point next = Clock::now();
+
+        for (int i = 0; i < options.NumEvents; ++i)
+        {
+            while (Clock::now() < next)
+            {
+                std::this_thread::yield();
+            }
+
+            next += interval;
+
+            InputEvent event = MakeKeyEvent(i);
+            event.Timestamp = Now();
+
+            inputManager.PushEvent(event);
+        }
+
+        producerDone.store(true, std::memory_order_release);
+    });
+
+    std::vector<double> latencies;
+    latencies.reserve(options.NumEvents);
+
+    for (;;)
+    {
+        bool done = producerDone.load(std::memory_order_acquire);
+
+        inputManager.CollectEvents();
+
+        int64_t now = Now();
+
+        for (const InputEvent& event : inputManager.GetFrameEvents())
+        {
+            latencies.push_back(static_cast<double>(now - event.Timestamp) * 1e-3);
+        }
+
+        inputManager.DispatchEvents();
+
+        if (done)
+            break;
+
+        std::this_thread::yield();
+    }
+
+    producer.join();
+
+    return {
+        {"delivered_events", latencies.size()},
+        {"dropped_events", inputManager.GetDroppedEvents()},
+        {"p50_us", utils::Percentile(latencies, 0.5)},
+        {"p95_us", utils::Percentile(latencies, 0.95)},
+        {"p99_us", utils::Percentile(latencies, 0.99)},
+        {"max_us", utils::Percentile(latencies, 1.0)}
+    };
+}
+
+// Adds and releases listeners, which must not touch the heap.
+json RunRegistrationTest(const Options& options)
+{
+    InputManager inputManager;
+
+    bool holdValue = false;
+
+    uint64_t allocationsBefore = AllocationTracker::GetStats().GetTotalCount();
+
+    Clock::time_point start = Clock::now();
+
+    for (int i = 0; i < options.NumEvents; ++i)
+    {
+        InputHandle handle = inputManager.AddKeyHoldListener('A' + static_cast<KeyCode>(i % 26),
+                                                             &holdValue);
+    }
+
+    double elapsedNs = ElapsedNs(start);
+
+    uint64_t numAllocations = AllocationTracker::GetStats().GetTotalCount() -
+        allocationsBefore;
+
+    return {
+        {"add_remove_ns", elapsedNs / static_cast<double>(options.NumEvents)},
+        {"allocations", numAllocations}
+    };
+}
+
+int RunBenchmark(const Options& options)
+{
+    json results = {
+        {"events", options.NumEvents},
+        {"listeners", options.NumListeners},
+        {"throughput", RunThroughputTest(options)},
+        {"latency", RunLatencyTest(options)},
+        {"registration", RunRegistrationTest(options)}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+
+// Key codes are Windows virtual-key codes, which use ASCII for letters and digits.
+using KeyCode = uint32_t;
+
+namespace key_codes
+{
+
+constexpr KeyCode Shift = 0x10;
+constexpr KeyCode Control = 0x11;
+
+} // namespace key_codes
+
+enum class MouseButton
+{
+    Left,
+    Middle,
+    Right
+};
+
+struct ModifierKey
+{
+    enum
+    {
+        None = 0,
+        Shift = 1,
+        Ctrl = 2
+    };
+};
+
+enum class InputEventType : uint8_t
+{
+    KeyDown,
+    KeyUp,
+    MouseDown,
+    MouseUp,
+
+    // Cursor movement since the previous MouseMove, in pixels.
+    MouseMove
+};
+
+struct InputEvent
+{
+    // Steady clock time at which the OS delivered the event, in nanoseconds.
+    int64_t Timestamp = 0;
+
+    InputEventType Type = InputEventType::KeyDown;
+
+    // ModifierKey flags held when the event was delivered.
+    uint8_t Modifiers = ModifierKey::None;
+
+    // KeyCode for key events, MouseButton for button events.
+    uint32_t Code = 0;
+
+    int32_t DeltaX = 0;
+    int32_t DeltaY = 0;
+
+    bool operator==(const InputEvent&) const = default;
+};
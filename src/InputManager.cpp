@@ -1,124 +1,343 @@
 #include "InputManager.h"
 
+#include "Utils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+
 InputHandle::~InputHandle()
 {
-    if (m_id && m_id.use_count() == 1)
+    Release();
+}
+
+InputHandle::InputHandle(InputHandle&& other) noexcept
+    : m_manager(std::exchange(other.m_manager, nullptr)),
+      m_slot(other.m_slot),
+      m_generation(other.m_generation)
+{
+}
+
+InputHandle& InputHandle::operator=(InputHandle&& other) noexcept
+{
+    if (this != &other)
     {
-        assert(m_manager);
-        m_manager->RemoveId(*m_id);
+        Release();
+
+        m_manager = std::exchange(other.m_manager, nullptr);
+        m_slot = other.m_slot;
+        m_generation = other.m_generation;
     }
+
+    return *this;
 }
 
-InputHandle InputManager::AddKeyHoldListener(UINT keyCode, bool* value)
+void InputHandle::Release()
 {
-    auto handle = CreateHandle();
+    if (m_manager)
+    {
+        m_manager->RemoveListener(m_slot, m_generation);
+        m_manager = nullptr;
+    }
+}
 
-    KeyHoldEntry entry{};
-    entry.Id = *handle.m_id;
-    entry.Value = value;
+InputManager::InputManager()
+    : m_listeners(MAX_LISTENERS), m_eventQueue(QUEUE_CAPACITY)
+{
+    for (uint32_t i = 0; i < MAX_LISTENERS; ++i)
+    {
+        m_listeners[i].Next = i + 1 < MAX_LISTENERS ? i + 1 : INVALID_SLOT;
+    }
 
-    m_keyHoldEntries[keyCode].push_back(entry);
+    m_freeHead = 0;
 
-    return handle;
+    m_listHeads.fill(INVALID_SLOT);
+
+    m_frameEvents.reserve(QUEUE_CAPACITY);
 }
 
-InputHandle InputManager::AddKeyPressListener(UINT keyCode, std::function<void()> callback)
+InputHandle InputManager::AddKeyHoldListener(KeyCode keyCode, bool* value)
 {
-    auto handle = CreateHandle();
+    Listener listener{};
+    listener.Value = value;
 
-    KeyPressEntry entry{};
-    entry.Id = *handle.m_id;
-    entry.Callback = std::move(callback);
+    return AddListener(ListenerType::KeyHold, keyCode, std::move(listener));
+}
 
-    m_keyPressEntries[keyCode].push_back(entry);
+InputHandle InputManager::AddKeyPressListener(KeyCode keyCode, std::function<void()> callback)
+{
+    Listener listener{};
+    listener.Callback = std::move(callback);
 
-    return handle;
+    return AddListener(ListenerType::KeyPress, keyCode, std::move(listener));
 }
 
-InputHandle InputManager::AddMouseHoldListener(MouseButton type, bool* value, int modifier)
+InputHandle InputManager::AddMouseHoldListener(MouseButton button, bool* value, int modifier)
 {
-    auto handle = CreateHandle();
+    Listener listener{};
+    listener.Value = value;
+    listener.Modifier = modifier;
+
+    return AddListener(ListenerType::MouseHold, static_cast<uint32_t>(button),
+                       std::move(listener));
+}
 
-    MouseHoldEntry entry{};
-    entry.Id = *handle.m_id;
-    entry.Value = value;
-    entry.Modifier = modifier;
+void InputManager::PushEvent(const InputEvent& event)
+{
+    if (!m_eventQueue.TryPush(event))
+        m_droppedEvents.fetch_add(1, std::memory_order_relaxed);
+}
+
+void InputManager::CollectEvents()
+{
+    InputEvent event;
+
+    while (m_eventQueue.TryPop(&event))
+    {
+        m_frameEvents.push_back(event);
+    }
+}
 
-    m_mouseHoldEntries[static_cast<int>(type)].push_back(entry);
+std::span<const InputEvent> InputManager::GetFrameEvents() const
+{
+    return m_frameEvents;
+}
+
+void InputManager::SetFrameEvents(std::span<const InputEvent> events)
+{
+    m_frameEvents.assign(events.begin(), events.end());
+    m_frameEventsAreLive = false;
+}
+
+void InputManager::DispatchEvents()
+{
+    m_dispatching = true;
+
+    for (const InputEvent& event : m_frameEvents)
+    {
+        switch (event.Type)
+        {
+            case InputEventType::KeyDown:
+                HandleKeyDown(event.Code);
+                break;
+            case InputEventType::KeyUp:
+                HandleKeyUp(event.Code);
+                break;
+            case InputEventType::MouseDown:
+                HandleMouseDown(static_cast<MouseButton>(event.Code), event.Modifiers);
+                break;
+            case InputEventType::MouseUp:
+                HandleMouseUp(static_cast<MouseButton>(event.Code));
+                break;
+            case InputEventType::MouseMove:
+                m_mouseDeltaX += event.DeltaX;
+                m_mouseDeltaY += event.DeltaY;
+                break;
+        }
+
+        if (m_frameEventsAreLive &&
+            (m_oldestEventTimestamp < 0 || event.Timestamp < m_oldestEventTimestamp))
+        {
+            m_oldestEventTimestamp = event.Timestamp;
+        }
+    }
+
+    m_dispatching = false;
+
+    if (m_hasDeferredRemovals)
+    {
+        for (uint32_t slot = 0; slot < MAX_LISTENERS; ++slot)
+        {
+            if (m_listeners[slot].Linked && !m_listeners[slot].Active)
+                Unlink(slot);
+        }
+
+        m_hasDeferredRemovals = false;
+    }
+
+    m_frameEvents.clear();
+    m_frameEventsAreLive = true;
+}
+
+void InputManager::ConsumeMouseDelta(int* deltaX, int* deltaY)
+{
+    *deltaX = std::exchange(m_mouseDeltaX, 0);
+    *deltaY = std::exchange(m_mouseDeltaY, 0);
+}
+
+int64_t InputManager::TakeOldestEventTimestamp()
+{
+    return std::exchange(m_oldestEventTimestamp, -1);
+}
+
+size_t InputManager::GetDroppedEvents() const
+{
+    return m_droppedEvents.load(std::memory_order_relaxed);
+}
+
+uint32_t InputManager::GetListIdx(ListenerType type, uint32_t code)
+{
+    return static_cast<uint32_t>(type) * NUM_KEY_CODES + code;
+}
+
+InputHandle InputManager::AddListener(ListenerType type, uint32_t code, Listener listener)
+{
+    if (code >= NUM_KEY_CODES)
+        throw std::runtime_error("Invalid input code.");
+
+    if (m_freeHead == INVALID_SLOT)
+        throw std::runtime_error("Too many input listeners.");
+
+    uint32_t slot = m_freeHead;
+    m_freeHead = m_listeners[slot].Next;
+
+    uint32_t generation = m_listeners[slot].Generation;
+
+    listener.List = GetListIdx(type, code);
+    listener.Next = INVALID_SLOT;
+    listener.Generation = generation;
+    listener.Active = true;
+    listener.Linked = true;
+
+    m_listeners[slot] = std::move(listener);
+
+    // Append so that listeners are notified in registration order.
+    uint32_t* link = &m_listHeads[m_listeners[slot].List];
+
+    while (*link != INVALID_SLOT)
+    {
+        link = &m_listeners[*link].Next;
+    }
+
+    *link = slot;
+
+    InputHandle handle;
+    handle.m_manager = this;
+    handle.m_slot = slot;
+    handle.m_generation = generation;
 
     return handle;
 }
 
-void InputManager::HandleKeyDown(UINT keyCode)
+void InputManager::RemoveListener(uint32_t slot, uint32_t generation)
 {
-    if (keyCode == VK_SHIFT)
+    assert(slot < MAX_LISTENERS);
+
+    Listener& listener = m_listeners[slot];
+
+    if (!listener.Active || listener.Generation != generation)
+        return;
+
+    listener.Active = false;
+
+    // A dispatch may currently be walking this listener's list.
+    if (m_dispatching)
     {
-        m_shiftDown = true;
+        m_hasDeferredRemovals = true;
         return;
     }
 
-    TraverseEntries(m_keyHoldEntries[keyCode], [](KeyHoldEntry& entry) {
-        *entry.Value = true;
+    Unlink(slot);
+}
+
+void InputManager::Unlink(uint32_t slot)
+{
+    Listener& listener = m_listeners[slot];
+
+    uint32_t* link = &m_listHeads[listener.List];
+
+    while (*link != slot)
+    {
+        assert(*link != INVALID_SLOT);
+        link = &m_listeners[*link].Next;
+    }
+
+    *link = listener.Next;
+
+    listener.Value = nullptr;
+    listener.Callback = nullptr;
+    listener.Linked = false;
+    ++listener.Generation;
+
+    listener.Next = m_freeHead;
+    m_freeHead = slot;
+}
+
+void InputManager::HandleKeyDown(KeyCode keyCode)
+{
+    // Modifiers are tracked through InputEvent::Modifiers instead.
+    if (keyCode == key_codes::Shift)
+        return;
+
+    ForEachListener(ListenerType::KeyHold, keyCode, [](Listener& listener) {
+        *listener.Value = true;
     });
 
-    TraverseEntries(m_keyPressEntries[keyCode], [](KeyPressEntry& entry) {
-        entry.Callback();
+    ForEachListener(ListenerType::KeyPress, keyCode, [](Listener& listener) {
+        listener.Callback();
     });
 }
 
-void InputManager::HandleKeyUp(UINT keyCode)
+void InputManager::HandleKeyUp(KeyCode keyCode)
 {
-    if (keyCode == VK_SHIFT)
-    {
-        m_shiftDown = false;
+    if (keyCode == key_codes::Shift)
         return;
-    }
 
-    TraverseEntries(m_keyHoldEntries[keyCode], [](KeyHoldEntry& entry) {
-        *entry.Value = false;
+    ForEachListener(ListenerType::KeyHold, keyCode, [](Listener& listener) {
+        *listener.Value = false;
     });
 }
 
-void InputManager::HandleMouseDown(MouseButton type)
+void InputManager::HandleMouseDown(MouseButton button, int modifiers)
 {
-    TraverseEntries(m_mouseHoldEntries[static_cast<int>(type)], [this](MouseHoldEntry& entry) {
-        if ((entry.Modifier & ModifierKey::Shift) == ModifierKey::Shift)
-        {
-            if (!m_shiftDown)
-                return;
-        }
-        else
-        {
-            if (m_shiftDown)
-                return;
-        }
+    bool shiftDown = (modifiers & ModifierKey::Shift) == ModifierKey::Shift;
 
-        *entry.Value = true;
+    ForEachListener(ListenerType::MouseHold, static_cast<uint32_t>(button),
+                    [=](Listener& listener) {
+        bool wantsShift = (listener.Modifier & ModifierKey::Shift) == ModifierKey::Shift;
+
+        if (wantsShift == shiftDown)
+            *listener.Value = true;
     });
 }
 
-void InputManager::HandleMouseUp(MouseButton type)
+void InputManager::HandleMouseUp(MouseButton button)
 {
-    TraverseEntries(m_mouseHoldEntries[static_cast<int>(type)], [](MouseHoldEntry& entry) {
-        *entry.Value = false;
+    ForEachListener(ListenerType::MouseHold, static_cast<uint32_t>(button),
+                    [](Listener& listener) {
+        *listener.Value = false;
     });
 }
 
-InputHandle InputManager::CreateHandle()
+InputLatencyTracker::InputLatencyTracker()
 {
-    InputHandle handle;
-    handle.m_manager = this;
-    handle.m_id = std::make_shared<InputId>(m_currentId);
-    m_activeIds.insert(m_currentId);
+    m_history.reserve(HISTORY_SIZE);
+}
 
-    ++m_currentId;
+void InputLatencyTracker::AddSample(int64_t inputTimestamp, int64_t presentTime)
+{
+    double latency = static_cast<double>(presentTime - inputTimestamp) * 1e-9;
 
-    return handle;
-}
+    if (m_history.size() < HISTORY_SIZE)
+    {
+        m_history.push_back(latency);
+    }
+    else
+    {
+        m_history[m_historyIdx] = latency;
+    }
 
+    m_historyIdx = (m_historyIdx + 1) % HISTORY_SIZE;
+}
 
-void InputManager::RemoveId(InputId id)
+InputLatencyTracker::Stats InputLatencyTracker::GetStats() const
 {
-    assert(m_activeIds.contains(id));
-    m_activeIds.erase(id);
+    Stats stats{};
+    stats.P50 = utils::Percentile(m_history, 0.5);
+    stats.P95 = utils::Percentile(m_history, 0.95);
+    stats.P99 = utils::Percentile(m_history, 0.99);
+    stats.NumSamples = m_history.size();
+
+    return stats;
 }
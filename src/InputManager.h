@@ -1,115 +1,205 @@
 #pragma once
 
-#include <windows.h>
+#include "InputEvent.h"
+#include "SpscQueue.h"
 
-#include <cassert>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
-#include <memory>
-#include <unordered_map>
-#include <unordered_set>
+#include <span>
 #include <vector>
 
-using InputId = int;
+class InputManager;
 
+// Owns a listener registration, which is removed when the handle is released or destroyed.
+// Handles are generation-checked, so a stale handle never removes a listener that has since reused
+// its slot.
 class InputHandle
 {
 public:
     InputHandle() = default;
     ~InputHandle();
 
+    InputHandle(InputHandle&& other) noexcept;
+    InputHandle& operator=(InputHandle&& other) noexcept;
+
+    InputHandle(const InputHandle&) = delete;
+    InputHandle& operator=(const InputHandle&) = delete;
+
+    void Release();
+
 private:
     friend class InputManager;
 
-    InputManager* m_manager;
-    std::shared_ptr<InputId> m_id;
-};
+    InputManager* m_manager = nullptr;
 
-enum class MouseButton
-{
-    Left,
-    Middle,
-    Right
-};
-
-struct ModifierKey
-{
-    enum
-    {
-        None = 0,
-        Shift = 1,
-        Ctrl = 2
-    };
+    uint32_t m_slot = 0;
+    uint32_t m_generation = 0;
 };
 
 class InputManager
 {
 public:
-    InputHandle AddKeyHoldListener(UINT keyCode, bool* value);
+    static constexpr size_t QUEUE_CAPACITY = 1024;
+    static constexpr size_t MAX_LISTENERS = 256;
+
+    // Listeners can be attached to key codes below this.
+    static constexpr KeyCode NUM_KEY_CODES = 256;
+
+    InputManager();
 
-    InputHandle AddKeyPressListener(UINT keyCode, std::function<void()> callback);
+    InputManager(const InputManager&) = delete;
+    InputManager& operator=(const InputManager&) = delete;
+
+    InputHandle AddKeyHoldListener(KeyCode keyCode, bool* value);
+
+    InputHandle AddKeyPressListener(KeyCode keyCode, std::function<void()> callback);
 
     InputHandle AddMouseHoldListener(MouseButton button, bool* value,
                                      int modifier = ModifierKey::None);
 
-    void HandleKeyDown(UINT keyCode);
-    void HandleKeyUp(UINT keyCode);
+    // Producer side - may be called from a different thread than everything else, e.g. a window
+    // message thread. Lock-free. Events are dropped if the queue is full.
+    void PushEvent(const InputEvent& event);
 
-    void HandleMouseDown(MouseButton button);
-    void HandleMouseUp(MouseButton button);
+    // Moves everything queued by PushEvent() into the current frame's events. Called once per
+    // tick.
+    void CollectEvents();
+
+    std::span<const InputEvent> GetFrameEvents() const;
+
+    // Replaces the current frame's events, e.g. with recorded ones. Replaced events do not count
+    // towards latency since their timestamps are from another session.
+    void SetFrameEvents(std::span<const InputEvent> events);
+
+    // Notifies listeners of the current frame's events in order, then clears them.
+    void DispatchEvents();
+
+    // Returns the cursor movement dispatched since the last call and resets it.
+    void ConsumeMouseDelta(int* deltaX, int* deltaY);
+
+    // Returns the timestamp of the oldest live event dispatched since the last call and resets
+    // it, or -1 if there was none.
+    int64_t TakeOldestEventTimestamp();
+
+    // Events lost because the queue was full. May be called from any thread.
+    size_t GetDroppedEvents() const;
 
 private:
     friend class InputHandle;
 
-    template<typename Entry, typename Fn>
-    void TraverseEntries(std::vector<Entry>& entries, Fn fn)
+    static constexpr uint32_t INVALID_SLOT = UINT32_MAX;
+
+    enum class ListenerType : uint8_t
+    {
+        KeyHold,
+        KeyPress,
+        MouseHold,
+
+        Count
+    };
+
+    struct Listener
+    {
+        bool* Value = nullptr;
+        std::function<void()> Callback;
+
+        int Modifier = ModifierKey::None;
+
+        // Index into m_listHeads of the list the listener is linked into.
+        uint32_t List = 0;
+
+        // Next listener in the same list, or the next free slot.
+        uint32_t Next = INVALID_SLOT;
+
+        // Incremented whenever the slot is freed.
+        uint32_t Generation = 0;
+
+        bool Active = false;
+        bool Linked = false;
+    };
+
+    static constexpr size_t NUM_LISTS = static_cast<size_t>(ListenerType::Count) * NUM_KEY_CODES;
+
+    static uint32_t GetListIdx(ListenerType type, uint32_t code);
+
+    InputHandle AddListener(ListenerType type, uint32_t code, Listener listener);
+
+    void RemoveListener(uint32_t slot, uint32_t generation);
+
+    void Unlink(uint32_t slot);
+
+    // Calls |fn| on every active listener in the list. Listeners may be added or removed by |fn|.
+    template<typename Fn>
+    void ForEachListener(ListenerType type, uint32_t code, Fn fn)
     {
-        auto it = entries.begin();
-        while (it != entries.end())
+        if (code >= NUM_KEY_CODES)
+            return;
+
+        for (uint32_t slot = m_listHeads[GetListIdx(type, code)]; slot != INVALID_SLOT;
+             slot = m_listeners[slot].Next)
         {
-            if (m_activeIds.contains(it->Id))
-            {
-                fn(*it);
-                ++it;
-            }
-            else
-            {
-                it = entries.erase(it);
-            }
+            if (m_listeners[slot].Active)
+                fn(m_listeners[slot]);
         }
     }
 
-    InputHandle CreateHandle();
+    void HandleKeyDown(KeyCode keyCode);
+    void HandleKeyUp(KeyCode keyCode);
 
-    void RemoveId(InputId id);
+    void HandleMouseDown(MouseButton button, int modifiers);
+    void HandleMouseUp(MouseButton button);
 
-    struct KeyHoldEntry
-    {
-        InputId Id;
-        bool* Value;
-    };
+    // Fixed-size so that listeners never move, even when a callback adds another listener.
+    std::vector<Listener> m_listeners;
+    uint32_t m_freeHead = INVALID_SLOT;
 
-    std::unordered_map<UINT, std::vector<KeyHoldEntry>> m_keyHoldEntries;
+    // Listeners are kept in per-(type, code) intrusive lists in registration order.
+    std::array<uint32_t, NUM_LISTS> m_listHeads;
 
-    struct KeyPressEntry
-    {
-        InputId Id;
-        std::function<void()> Callback;
-    };
+    // Removals during dispatch only deactivate the listener. It is unlinked afterwards.
+    bool m_dispatching = false;
+    bool m_hasDeferredRemovals = false;
+
+    SpscQueue<InputEvent> m_eventQueue;
+    std::atomic<size_t> m_droppedEvents = 0;
 
-    std::unordered_map<UINT, std::vector<KeyPressEntry>> m_keyPressEntries;
+    std::vector<InputEvent> m_frameEvents;
+    bool m_frameEventsAreLive = true;
 
-    struct MouseHoldEntry
+    int m_mouseDeltaX = 0;
+    int m_mouseDeltaY = 0;
+
+    int64_t m_oldestEventTimestamp = -1;
+};
+
+// Rolling input-to-present latency. Fed by whichever thread presents, with the oldest input
+// timestamp of each presented frame.
+class InputLatencyTracker
+{
+public:
+    static constexpr size_t HISTORY_SIZE = 512;
+
+    InputLatencyTracker();
+
+    void AddSample(int64_t inputTimestamp, int64_t presentTime);
+
+    struct Stats
     {
-        InputId Id;
-        bool* Value;
+        // Seconds from the oldest input event of a frame to that frame's present.
+        double P50 = 0.0;
+        double P95 = 0.0;
+        double P99 = 0.0;
 
-        int Modifier = ModifierKey::None;
+        size_t NumSamples = 0;
     };
 
-    std::unordered_map<int, std::vector<MouseHoldEntry>> m_mouseHoldEntries;
-
-    int m_currentId = 1;
-    std::unordered_set<InputId> m_activeIds;
+    // Statistics over the most recent HISTORY_SIZE frames that had input.
+    Stats GetStats() const;
 
-    bool m_shiftDown = false;
+private:
+    std::vector<double> m_history;
+    size_t m_historyIdx = 0;
 };
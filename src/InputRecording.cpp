@@ -0,0 +1,272 @@
+#include "InputRecording.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+
+constexpr char fileMagic[4] = {'G', 'I', 'N', 'P'};
+constexpr uint32_t fileVersion = 2;
+
+// Values are stored as LEB128 varints, with signed values zigzag-encoded first, so the common
+// small key codes, deltas and timestamp gaps take one or two bytes. Elapsed times are stored as
+// their raw 8 bytes, since a double's exponent bits would make its varint longer still.
+class Writer
+{
+public:
+    void WriteByte(uint8_t value)
+    {
+        m_data.push_back(static_cast<std::byte>(value));
+    }
+
+    void WriteBytes(const void* src, size_t size)
+    {
+        const std::byte* bytes = static_cast<const std::byte*>(src);
+        m_data.insert(m_data.end(), bytes, bytes + size);
+    }
+
+    void WriteVarint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            WriteByte(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+
+        WriteByte(static_cast<uint8_t>(value));
+    }
+
+    void WriteSigned(int64_t value)
+    {
+        WriteVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    std::vector<std::byte> TakeData()
+    {
+        return std::move(m_data);
+    }
+
+private:
+    std::vector<std::byte> m_data;
+};
+
+class Reader
+{
+public:
+    explicit Reader(std::span<const std::byte> data)
+        : m_data(data)
+    {
+    }
+
+    uint8_t ReadByte()
+    {
+        if (m_pos >= m_data.size())
+            throw std::runtime_error("Truncated input recording.");
+
+        return static_cast<uint8_t>(m_data[m_pos++]);
+    }
+
+    void ReadBytes(void* dst, size_t size)
+    {
+        if (m_data.size() - m_pos < size)
+            throw std::runtime_error("Truncated input recording.");
+
+        memcpy(dst, m_data.data() + m_pos, size);
+        m_pos += size;
+    }
+
+    uint64_t ReadVarint()
+    {
+        uint64_t value = 0;
+
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t byte = ReadByte();
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+
+        throw std::runtime_error("Invalid varint in input recording.");
+    }
+
+    int64_t ReadSigned()
+    {
+        uint64_t value = ReadVarint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    // Reads a count of items that each take at least |minItemSize| bytes, and checks that the
+    // rest of the input could hold them, so a corrupt count never sizes a huge allocation.
+    size_t ReadCount(size_t minItemSize)
+    {
+        uint64_t count = ReadVarint();
+
+        if (count > (m_data.size() - m_pos) / minItemSize)
+            throw std::runtime_error("Truncated input recording.");
+
+        return static_cast<size_t>(count);
+    }
+
+private:
+    std::span<const std::byte> m_data;
+    size_t m_pos = 0;
+};
+
+// Elapsed time and event count.
+constexpr size_t MIN_FRAME_SIZE = sizeof(double) + 1;
+
+// Type, modifiers, timestamp gap and code.
+constexpr size_t MIN_EVENT_SIZE = 4;
+
+bool HasDelta(InputEventType type)
+{
+    return type == InputEventType::MouseMove;
+}
+
+} // namespace
+
+std::vector<std::byte> InputRecording::Serialize() const
+{
+    Writer writer;
+
+    writer.WriteBytes(fileMagic, sizeof(fileMagic));
+    writer.WriteVarint(fileVersion);
+    writer.WriteVarint(Frames.size());
+
+    // Timestamps are delta-encoded across the whole stream.
+    int64_t prevTimestamp = 0;
+
+    for (const InputFrame& frame : Frames)
+    {
+        // Stored bit-exact so that replayed frames see identical elapsed times.
+        writer.WriteBytes(&frame.ElapsedSec, sizeof(frame.ElapsedSec));
+
+        writer.WriteVarint(frame.Events.size());
+
+        for (const InputEvent& event : frame.Events)
+        {
+            writer.WriteByte(static_cast<uint8_t>(event.Type));
+            writer.WriteByte(event.Modifiers);
+            writer.WriteSigned(event.Timestamp - prevTimestamp);
+
+            if (HasDelta(event.Type))
+            {
+                writer.WriteSigned(event.DeltaX);
+                writer.WriteSigned(event.DeltaY);
+            }
+            else
+            {
+                writer.WriteVarint(event.Code);
+            }
+
+            prevTimestamp = event.Timestamp;
+        }
+    }
+
+    return writer.TakeData();
+}
+
+InputRecording InputRecording::Deserialize(std::span<const std::byte> data)
+{
+    Reader reader(data);
+
+    char magic[sizeof(fileMagic)];
+    reader.ReadBytes(magic, sizeof(magic));
+
+    if (memcmp(magic, fileMagic, sizeof(fileMagic)) != 0)
+        throw std::runtime_error("Not an input recording.");
+
+    if (reader.ReadVarint() != fileVersion)
+        throw std::runtime_error("Unsupported input recording version.");
+
+    InputRecording recording;
+    recording.Frames.resize(reader.ReadCount(MIN_FRAME_SIZE));
+
+    int64_t prevTimestamp = 0;
+
+    for (InputFrame& frame : recording.Frames)
+    {
+        reader.ReadBytes(&frame.ElapsedSec, sizeof(frame.ElapsedSec));
+
+        frame.Events.resize(reader.ReadCount(MIN_EVENT_SIZE));
+
+        for (InputEvent& event : frame.Events)
+        {
+            uint8_t type = reader.ReadByte();
+
+            if (type > static_cast<uint8_t>(InputEventType::MouseMove))
+                throw std::runtime_error("Invalid input event type.");
+
+            event.Type = static_cast<InputEventType>(type);
+            event.Modifiers = reader.ReadByte();
+            event.Timestamp = prevTimestamp + reader.ReadSigned();
+
+            if (HasDelta(event.Type))
+            {
+                event.DeltaX = static_cast<int32_t>(reader.ReadSigned());
+                event.DeltaY = static_cast<int32_t>(reader.ReadSigned());
+            }
+            else
+            {
+                event.Code = static_cast<uint32_t>(reader.ReadVarint());
+            }
+
+            prevTimestamp = event.Timestamp;
+        }
+    }
+
+    return recording;
+}
+
+void InputRecording::Save(const std::filesystem::path& path) const
+{
+    std::ofstream strm(path, std::ios::binary);
+    if (!strm.is_open())
+        throw std::runtime_error("Could not open file.");
+
+    std::vector<std::byte> data = Serialize();
+    strm.write(reinterpret_cast<const char*>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+}
+
+InputRecording InputRecording::Load(const std::filesystem::path& path)
+{
+    std::ifstream strm(path, std::ios::binary);
+    if (!strm.is_open())
+        throw std::runtime_error("Could not open file.");
+
+    std::vector<std::byte> data(std::filesystem::file_size(path));
+
+    strm.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+    return Deserialize(data);
+}
+
+InputReplayer::InputReplayer(InputRecording recording)
+    : m_recording(std::move(recording))
+{
+}
+
+bool InputReplayer::IsFinished() const
+{
+    return m_frameIdx >= m_recording.Frames.size();
+}
+
+const InputFrame& InputReplayer::NextFrame()
+{
+    return m_recording.Frames[m_frameIdx++];
+}
+
+size_t InputReplayer::GetFrameIdx() const
+{
+    return m_frameIdx;
+}
+
+size_t InputReplayer::GetNumFrames() const
+{
+    return m_recording.Frames.size();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "InputEvent.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+// Input delivered to one frame, together with the frame's elapsed time so that time-dependent
+// logic like camera movement replays identically.
+struct InputFrame
+{
+    double ElapsedSec = 0.0;
+
+    std::vector<InputEvent> Events;
+
+    bool operator==(const InputFrame&) const = default;
+};
+
+// A per-frame input event stream that can be saved to and loaded from a compact binary file.
+struct InputRecording
+{
+    std::vector<InputFrame> Frames;
+
+    bool operator==(const InputRecording&) const = default;
+
+    std::vector<std::byte> Serialize() const;
+    static InputRecording Deserialize(std::span<const std::byte> data);
+
+    void Save(const std::filesystem::path& path) const;
+    static InputRecording Load(const std::filesystem::path& path);
+};
+
+// Hands out a recording one frame at a time.
+class InputReplayer
+{
+public:
+    explicit InputReplayer(InputRecording recording);
+
+    bool IsFinished() const;
+
+    const InputFrame& NextFrame();
+
+    size_t GetFrameIdx() const;
+    size_t GetNumFrames() const;
+
+private:
+    InputRecording m_recording;
+
+    size_t m_frameIdx = 0;
+};
@@ -0,0 +1,319 @@
+// Test for input recordings and their replay. Scripts a session of key, button and cursor input
+// with modifiers and jittery frame times, and checks that it comes back unchanged through
+// serialization and through a file, that elapsed times take their raw 8 bytes, and that truncated
+// recordings and corrupt counts are rejected without allocating what they claim. Then replays the
+// session twice through InputManager and Camera, as FrameBenchmark --input does, and checks that
+// both replays give the same camera state on every frame. Exits with an error if any check fails.
+
+#include "BenchmarkUtils.h"
+#include "Camera.h"
+#include "FixedTimestep.h"
+#include "InputManager.h"
+#include "InputRecording.h"
+
+#include <nlohmann/json.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+
+struct Options
+{
+    std::string OutPath = "input_recording_test_results.json";
+
+    int NumFrames = 600;
+};
+
+constexpr const char* USAGE =
+    "Usage: InputRecordingTest [options]\n"
+    "  --frames N   Frames in the scripted session (default 600)\n"
+    "  --out FILE   Results file (default input_recording_test_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--frames")
+            options->NumFrames = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->NumFrames > 0;
+}
+
+// Beyond the listener table, so that it takes a multi-byte varint and reaches no listener.
+constexpr KeyCode UNBOUND_KEY_CODE = 0x1234;
+
+// A session that flies the camera: FPS mode is toggled on, movement keys are held and released
+// at random with Ctrl sometimes down, the cursor moves every frame, and a Shift+middle-button pan
+// runs through the middle of it.
+InputRecording MakeRecording(int numFrames)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> jitterSec(-0.002, 0.002);
+    std::uniform_int_distribution<int32_t> delta(-20, 20);
+    std::uniform_int_distribution<int> action(0, 15);
+
+    constexpr KeyCode MOVE_KEYS[] = {'W', 'A', 'S', 'D'};
+    bool keyDown[4] = {};
+
+    // Steady clock readings are large, so only their gaps are small.
+    int64_t timestamp = 1'234'567'890'123'456;
+
+    InputRecording recording;
+    recording.Frames.resize(static_cast<size_t>(numFrames));
+
+    int panStart = numFrames / 3;
+    int panEnd = panStart + numFrames / 10;
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+        InputFrame& frame = recording.Frames[static_cast<size_t>(i)];
+        frame.ElapsedSec = 1.0 / 60.0 + jitterSec(rng);
+
+        auto addEvent = [&](InputEventType type, uint32_t code, uint8_t modifiers) {
+            timestamp += 100'000 + rng() % 1'000'000;
+
+            InputEvent event{};
+            event.Timestamp = timestamp;
+            event.Type = type;
+            event.Modifiers = modifiers;
+            event.Code = code;
+
+            frame.Events.push_back(event);
+        };
+
+        if (i == 0)
+        {
+            addEvent(InputEventType::KeyDown, 'Z', ModifierKey::None);
+            addEvent(InputEventType::KeyUp, 'Z', ModifierKey::None);
+            addEvent(InputEventType::KeyDown, UNBOUND_KEY_CODE, ModifierKey::None);
+        }
+
+        int choice = action(rng);
+
+        if (choice < 4)
+        {
+            uint8_t modifiers = rng() % 4 == 0 ? ModifierKey::Ctrl : ModifierKey::None;
+
+            addEvent(keyDown[choice] ? InputEventType::KeyUp : InputEventType::KeyDown,
+                     MOVE_KEYS[choice], modifiers);
+
+            keyDown[choice] = !keyDown[choice];
+        }
+
+        if (i == panStart)
+        {
+            addEvent(InputEventType::KeyDown, key_codes::Shift, ModifierKey::Shift);
+            addEvent(InputEventType::MouseDown, static_cast<uint32_t>(MouseButton::Middle),
+                     ModifierKey::Shift);
+        }
+        else if (i == panEnd)
+        {
+            addEvent(InputEventType::MouseUp, static_cast<uint32_t>(MouseButton::Middle),
+                     ModifierKey::Shift);
+            addEvent(InputEventType::KeyUp, key_codes::Shift, ModifierKey::None);
+        }
+
+        addEvent(InputEventType::MouseMove, 0, ModifierKey::None);
+        frame.Events.back().DeltaX = delta(rng);
+        frame.Events.back().DeltaY = delta(rng);
+
+        // Some frames take no input at all.
+        if (rng() % 8 == 0)
+            frame.Events.clear();
+    }
+
+    return recording;
+}
+
+// Whether |data| is rejected as a recording, the way a corrupt file should be.
+bool IsRejected(std::span<const std::byte> data)
+{
+    try
+    {
+        InputRecording::Deserialize(data);
+    }
+    catch (const std::runtime_error&)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+void AppendVarint(std::vector<std::byte>* data, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        data->push_back(static_cast<std::byte>(value | 0x80));
+        value >>= 7;
+    }
+
+    data->push_back(static_cast<std::byte>(value));
+}
+
+// The header Serialize() writes, up to the frame count.
+std::vector<std::byte> MakeHeader()
+{
+    std::vector<std::byte> data = InputRecording{}.Serialize();
+    data.pop_back();
+
+    return data;
+}
+
+// Camera state after every frame, replayed as FrameBenchmark does.
+std::vector<CameraState> Replay(const InputRecording& recording)
+{
+    InputManager inputManager;
+    Camera camera(&inputManager);
+    FixedTimestep timestep(FixedTimestep::DEFAULT_STEP_SEC);
+
+    InputReplayer replayer(recording);
+    std::vector<CameraState> states;
+
+    while (!replayer.IsFinished())
+    {
+        const InputFrame& frame = replayer.NextFrame();
+
+        inputManager.SetFrameEvents(frame.Events);
+        inputManager.DispatchEvents();
+
+        int numSteps = timestep.Advance(frame.ElapsedSec);
+
+        for (int i = 0; i < numSteps; ++i)
+            camera.Tick(timestep.GetStepSec());
+
+        states.push_back(camera.GetState());
+    }
+
+    return states;
+}
+
+// Exact, since replays must be bit-identical.
+bool StatesEqual(const CameraState& a, const CameraState& b)
+{
+    return a.Position == b.Position && a.Yaw == b.Yaw && a.Pitch == b.Pitch;
+}
+
+int RunTest(const Options& options)
+{
+    Checks checks;
+
+    InputRecording recording = MakeRecording(options.NumFrames);
+    std::vector<std::byte> data = recording.Serialize();
+
+    checks.Check("round_trip_equal", InputRecording::Deserialize(data) == recording);
+
+    std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "input_recording_test.ginp";
+
+    recording.Save(path);
+    InputRecording loaded = InputRecording::Load(path);
+    std::filesystem::remove(path);
+
+    checks.Check("save_load_equal", loaded == recording);
+
+    // Frames without events hold only their elapsed time and an event count.
+    {
+        InputRecording empty;
+        empty.Frames.resize(100, InputFrame{1.0 / 60.0, {}});
+
+        // Both frame counts take a byte.
+        size_t headerSize = InputRecording{}.Serialize().size();
+
+        checks.Check("elapsed_times_take_8_bytes",
+                     empty.Serialize().size() == headerSize + 100 * (sizeof(double) + 1));
+    }
+
+    // Every prefix of a short session is missing something.
+    {
+        InputRecording shortRecording = MakeRecording(20);
+        std::vector<std::byte> shortData = shortRecording.Serialize();
+
+        bool rejected = true;
+
+        for (size_t size = 0; size < shortData.size(); ++size)
+            rejected = rejected && IsRejected(std::span(shortData).first(size));
+
+        checks.Check("truncated_recordings_rejected", rejected);
+    }
+
+    // Counts far beyond what the input could hold fail before anything is allocated for them.
+    {
+        std::vector<std::byte> manyFrames = MakeHeader();
+        AppendVarint(&manyFrames, uint64_t{1} << 60);
+
+        std::vector<std::byte> manyEvents = MakeHeader();
+        AppendVarint(&manyEvents, 1);
+
+        double elapsedSec = 1.0 / 60.0;
+        const std::byte* elapsedBytes = reinterpret_cast<const std::byte*>(&elapsedSec);
+        manyEvents.insert(manyEvents.end(), elapsedBytes, elapsedBytes + sizeof(elapsedSec));
+
+        AppendVarint(&manyEvents, UINT64_MAX);
+
+        checks.Check("corrupt_counts_rejected", IsRejected(manyFrames) && IsRejected(manyEvents));
+    }
+
+    std::vector<CameraState> first = Replay(recording);
+    std::vector<CameraState> second = Replay(loaded);
+
+    bool replaysEqual = first.size() == recording.Frames.size() && second.size() == first.size();
+
+    for (size_t i = 0; replaysEqual && i < first.size(); ++i)
+        replaysEqual = StatesEqual(first[i], second[i]);
+
+    checks.Check("replays_identical", replaysEqual);
+
+    // Otherwise identical replays would prove nothing.
+    checks.Check("replay_moves_camera", !first.empty() &&
+                                            !StatesEqual(first.front(), first.back()) &&
+                                            first.back().Yaw != 0.f);
+
+    json results = {
+        {"frames", options.NumFrames},
+        {"recording_bytes", data.size()},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    for (const auto& [name, passed] : checks.Results.items())
+        std::printf("%-32s %s\n", name.c_str(), passed.get<bool>() ? "passed" : "FAILED");
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Input recording checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunTest);
+}
@@ -0,0 +1,489 @@
+// Benchmark for the asynchronous I/O service. Checks, for each backend the OS supports, that reads
+// match a synchronous read - whole files, ranges and into caller memory, buffered and unbuffered -
+// and that errors, cancellation, priorities and completion callbacks behave. Then measures the
+// throughput of reading every file of an asset directory against the queue depth, with the page
+// cache warm and - on Linux - cold, next to a serial read of each file. Exits with an error if any
+// check fails.
+
+#include "AssetArchive.h"
+#include "AsyncIo.h"
+#include "BenchmarkUtils.h"
+#include "GltfLoader.h"
+#include "JobSystem.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::DropFromPageCache;
+using benchmark::GbPerSec;
+using benchmark::ListFiles;
+using benchmark::MeasureMs;
+
+struct Options
+{
+    std::string Dir = "assets/sponza";
+    std::string ModelPath = "assets/sponza/Sponza.gltf";
+
+    std::vector<uint32_t> QueueDepths = {1, 2, 4, 8, 16, 32, 64};
+
+    int Iterations = 3;
+
+    std::string OutPath = "io_benchmark_results.json";
+};
+
+constexpr const char* USAGE =
+    "Usage: IoBenchmark [options]\n"
+    "  --dir DIR         Asset directory to read (default assets/sponza)\n"
+    "  --model FILE      glTF model to load through the service "
+    "(default assets/sponza/Sponza.gltf)\n"
+    "  --depths LIST     Queue depths to measure (default 1,2,4,8,16,32,64)\n"
+    "  --iterations N    Reads to time, keeping the fastest (default 3)\n"
+    "  --out FILE        Results file (default io_benchmark_results.json)\n";
+
+std::vector<uint32_t> ParseList(const std::string& value)
+{
+    std::vector<uint32_t> list;
+    std::stringstream strm(value);
+    std::string item;
+
+    while (std::getline(strm, item, ','))
+    {
+        list.push_back(static_cast<uint32_t>(std::stoul(item)));
+    }
+
+    return list;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--dir")
+            options->Dir = value;
+        else if (arg == "--model")
+            options->ModelPath = value;
+        else if (arg == "--depths")
+            options->QueueDepths = ParseList(value);
+        else if (arg == "--iterations")
+            options->Iterations = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->Iterations > 0 && !options->QueueDepths.empty() &&
+        std::find(options->QueueDepths.begin(), options->QueueDepths.end(), 0u) ==
+            options->QueueDepths.end();
+}
+
+bool Equals(std::span<const std::byte> a, std::span<const std::byte> b)
+{
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+// Submits every file as one batch and waits for all of them.
+std::vector<IoHandle> ReadAll(IoService* io, const std::vector<fs::path>& paths)
+{
+    std::vector<IoRequest> requests(paths.size());
+
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        requests[i].Path = paths[i];
+    }
+
+    std::vector<IoHandle> handles = io->SubmitBatch(requests);
+
+    for (const IoHandle& handle : handles)
+    {
+        handle.Wait();
+    }
+
+    return handles;
+}
+
+bool CheckWholeFiles(IoService* io, const std::vector<fs::path>& paths,
+                     const std::vector<std::vector<std::byte>>& expected)
+{
+    std::vector<IoHandle> handles = ReadAll(io, paths);
+
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        if (handles[i].GetStatus() != IoStatus::Completed ||
+            !Equals(handles[i].GetData(), expected[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CheckRanges(IoService* io, const fs::path& path, std::span<const std::byte> expected)
+{
+    uint64_t size = expected.size();
+
+    auto read = [&](uint64_t offset, uint64_t length, std::span<std::byte> dst = {}) {
+        IoRequest request;
+        request.Path = path;
+        request.Offset = offset;
+        request.Size = length;
+        request.Destination = dst;
+
+        IoHandle handle = io->Submit(std::move(request));
+        handle.Wait();
+
+        return handle;
+    };
+
+    auto matches = [&](const IoHandle& handle, uint64_t offset, uint64_t length) {
+        return handle.GetStatus() == IoStatus::Completed &&
+            Equals(handle.GetData(), expected.subspan(offset, length));
+    };
+
+    // Aligned and unaligned offsets and sizes, and sizes past the end, which are clipped.
+    bool rangesMatch = matches(read(0, 0), 0, size) && matches(read(4096, 5000), 4096, 5000) &&
+        matches(read(1, 100), 1, 100) && matches(read(size - 10, 100), size - 10, 10) &&
+        matches(read(size, 0), size, 0);
+
+    // Into caller memory, aligned and not.
+    std::vector<std::byte> dst(size + 8192, std::byte{0xAB});
+
+    size_t alignedOffset = (4096 - reinterpret_cast<uintptr_t>(dst.data()) % 4096) % 4096;
+
+    bool destinationsMatch = matches(read(0, 0, std::span(dst).subspan(alignedOffset)), 0, size);
+
+    std::fill(dst.begin(), dst.end(), std::byte{0xAB});
+    IoHandle unaligned = read(0, 0, std::span(dst).subspan(3));
+
+    destinationsMatch = destinationsMatch && matches(unaligned, 0, size) &&
+        unaligned.GetData().data() == dst.data() + 3 && dst[2] == std::byte{0xAB};
+
+    std::vector<std::byte> small(size - 1);
+
+    IoRequest missingRequest;
+    missingRequest.Path = path.string() + ".missing";
+
+    IoHandle missing = io->Submit(std::move(missingRequest));
+
+    bool errorsReported = read(size + 1, 0).GetStatus() == IoStatus::Failed &&
+        read(0, 0, small).GetStatus() == IoStatus::Failed &&
+        missing.Wait() == IoStatus::Failed && !missing.GetError().empty();
+
+    return rangesMatch && destinationsMatch && errorsReported;
+}
+
+// With a single read in flight, and the I/O thread held up in the first read's callback, every
+// other read is still queued when cancelled.
+bool CheckCancellation(IoBackend backend, const std::vector<fs::path>& paths,
+                       const std::vector<std::vector<std::byte>>& expected)
+{
+    IoService io(nullptr, {1, false}, backend);
+
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+
+    std::vector<IoRequest> requests(paths.size());
+
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        requests[i].Path = paths[i];
+    }
+
+    requests[0].OnComplete = [released](const IoHandle&) { released.wait(); };
+
+    std::vector<IoHandle> handles = io.SubmitBatch(requests);
+
+    size_t firstCancelled = handles.size() / 2;
+    size_t numCancelled = 0;
+
+    for (size_t i = firstCancelled; i < handles.size(); ++i)
+    {
+        numCancelled += handles[i].Cancel() ? 1 : 0;
+    }
+
+    release.set_value();
+
+    for (size_t i = 0; i < handles.size(); ++i)
+    {
+        IoStatus status = handles[i].Wait();
+
+        if ((i >= firstCancelled) != (status == IoStatus::Cancelled))
+            return false;
+
+        if (status == IoStatus::Cancelled ? !handles[i].GetData().empty() :
+                                            !Equals(handles[i].GetData(), expected[i]))
+        {
+            return false;
+        }
+    }
+
+    // Finished reads are left alone.
+    return numCancelled == handles.size() - firstCancelled && !handles[0].Cancel() &&
+        handles[0].GetStatus() == IoStatus::Completed &&
+        io.GetStats().NumCancelled == numCancelled;
+}
+
+// Queued reads start highest priority first, in submission order within a priority.
+bool CheckPriorities(IoBackend backend, const std::vector<fs::path>& paths)
+{
+    IoService io(nullptr, {1, false}, backend);
+
+    std::mutex mutex;
+    std::vector<size_t> order;
+
+    static constexpr IoPriority priorities[] = {IoPriority::Low, IoPriority::Normal,
+                                                IoPriority::High};
+
+    std::vector<IoRequest> requests;
+
+    for (size_t i = 0; i < 12; ++i)
+    {
+        IoRequest request;
+        request.Path = paths[i % paths.size()];
+        request.Size = 4096;
+        request.Priority = priorities[i / 4];
+        request.OnComplete = [&mutex, &order, i](const IoHandle&) {
+            std::lock_guard lock(mutex);
+            order.push_back(i);
+        };
+
+        requests.push_back(std::move(request));
+    }
+
+    std::vector<IoHandle> handles = io.SubmitBatch(requests);
+
+    for (const IoHandle& handle : handles)
+    {
+        handle.Wait();
+    }
+
+    // Callbacks without a job system run on the I/O thread right after the read finishes.
+    std::lock_guard lock(mutex);
+
+    return order == std::vector<size_t>{8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3};
+}
+
+bool CheckCallbacks(IoBackend backend, const std::vector<fs::path>& paths, JobSystem* jobSystem)
+{
+    std::atomic<size_t> numCalled = 0;
+    std::atomic<size_t> numReady = 0;
+    std::atomic<size_t> numOnWorkers = 0;
+
+    {
+        IoService io(jobSystem, {4, false}, backend);
+
+        std::vector<IoRequest> requests(paths.size());
+
+        for (size_t i = 0; i < paths.size(); ++i)
+        {
+            requests[i].Path = paths[i];
+            requests[i].OnComplete = [&, jobSystem](const IoHandle& handle) {
+                numCalled.fetch_add(1);
+                numReady.fetch_add(handle.IsReady() ? 1 : 0);
+                numOnWorkers.fetch_add(jobSystem->GetCurrentThreadIndex() >= 0 ? 1 : 0);
+            };
+        }
+
+        io.SubmitBatch(requests);
+    }
+
+    // Destroying the service waited for every callback.
+    return numCalled == paths.size() && numReady == paths.size() && numOnWorkers == paths.size();
+}
+
+bool CheckGltf(IoService* io, const fs::path& modelPath)
+{
+    ModelData serial = LoadGltfModelData(modelPath);
+    ModelData parallel = LoadGltfModelData(modelPath, nullptr, io);
+
+    return !serial.Buffers.empty() && serial.Buffers == parallel.Buffers;
+}
+
+struct ReadMode
+{
+    const char* Name;
+    IoBackend Backend;
+    bool Unbuffered;
+};
+
+int RunBenchmark(const Options& options)
+{
+    Checks checks;
+
+    JobSystem jobSystem;
+
+    std::vector<fs::path> paths = ListFiles(options.Dir);
+
+    std::vector<std::vector<std::byte>> expected;
+    uint64_t totalBytes = 0;
+
+    for (const fs::path& path : paths)
+    {
+        expected.push_back(ReadAssetFile(path, nullptr));
+        totalBytes += expected.back().size();
+    }
+
+    // The largest file has whole blocks to read unbuffered, and a partial one at the end.
+    size_t largest = static_cast<size_t>(
+        std::max_element(expected.begin(), expected.end(),
+                         [](const auto& a, const auto& b) { return a.size() < b.size(); }) -
+        expected.begin());
+
+    if (paths.empty() || expected[largest].size() < 16384)
+        throw std::runtime_error("Not enough data to read.");
+
+    std::vector<ReadMode> modes;
+
+    for (IoBackend backend : {IoBackend::IoUring, IoBackend::ThreadPool})
+    {
+        if (!IsIoBackendSupported(backend))
+            continue;
+
+        std::string name = GetIoBackendName(backend);
+
+        checks.Check(name + "_cancellation", CheckCancellation(backend, paths, expected));
+        checks.Check(name + "_priorities", CheckPriorities(backend, paths));
+        checks.Check(name + "_callbacks", CheckCallbacks(backend, paths, &jobSystem));
+
+        modes.push_back({GetIoBackendName(backend), backend, false});
+
+        // The thread pool ignores the flag.
+        if (backend == IoBackend::IoUring)
+            modes.push_back({"io_uring_unbuffered", backend, true});
+    }
+
+    json modeResults = json::object();
+
+    bool canDropCache = DropFromPageCache(paths[0]);
+
+    auto dropAll = [&] {
+        for (const fs::path& path : paths)
+        {
+            DropFromPageCache(path);
+        }
+    };
+
+    for (const ReadMode& mode : modes)
+    {
+        {
+            IoService io(&jobSystem, {8, mode.Unbuffered}, mode.Backend);
+
+            checks.Check(std::string(mode.Name) + "_matches_sync",
+                         CheckWholeFiles(&io, paths, expected));
+            checks.Check(std::string(mode.Name) + "_ranges",
+                         CheckRanges(&io, paths[largest], expected[largest]));
+            checks.Check(std::string(mode.Name) + "_gltf_matches_serial",
+                         CheckGltf(&io, options.ModelPath));
+        }
+
+        json depths = json::array();
+
+        for (uint32_t depth : options.QueueDepths)
+        {
+            IoService io(&jobSystem, {depth, mode.Unbuffered}, mode.Backend);
+
+            auto read = [&] { ReadAll(&io, paths); };
+
+            double warmMs = MeasureMs(options.Iterations, read);
+            double coldMs = canDropCache ? MeasureMs(options.Iterations, read, dropAll) : 0.0;
+
+            IoService::Stats stats = io.GetStats();
+            IoBufferPool::Stats poolStats = io.GetBufferPool().GetStats();
+
+            uint64_t numReads = stats.NumCompleted;
+
+            depths.push_back({
+                {"queue_depth", depth},
+                {"warm_ms", warmMs},
+                {"warm_gb_per_sec", GbPerSec(totalBytes, warmMs)},
+                {"cold_ms", coldMs},
+                {"cold_gb_per_sec", GbPerSec(totalBytes, coldMs)},
+                {"max_in_flight", stats.MaxInFlight},
+                {"unbuffered_fraction", numReads > 0 ? static_cast<double>(stats.NumUnbuffered) /
+                                                           static_cast<double>(numReads) : 0.0},
+                {"submit_calls_per_read", numReads > 0 ?
+                                              static_cast<double>(stats.NumSubmitCalls) /
+                                                  static_cast<double>(numReads) : 0.0},
+                {"buffer_reuse_fraction", poolStats.NumAcquired > 0 ?
+                                              static_cast<double>(poolStats.NumReused) /
+                                                  static_cast<double>(poolStats.NumAcquired) :
+                                              0.0}
+            });
+        }
+
+        modeResults[mode.Name] = depths;
+    }
+
+    // What the loaders did before: one blocking read after another.
+    auto readSerial = [&] {
+        for (const fs::path& path : paths)
+        {
+            ReadAssetFile(path, nullptr);
+        }
+    };
+
+    double serialWarmMs = MeasureMs(options.Iterations, readSerial);
+    double serialColdMs = canDropCache ? MeasureMs(options.Iterations, readSerial, dropAll) : 0.0;
+
+    json results = {
+        {"dir", fs::path(options.Dir).generic_string()},
+        {"files", paths.size()},
+        {"bytes", totalBytes},
+        {"threads", jobSystem.GetThreadCount()},
+        {"cold_cache_supported", canDropCache},
+        {"serial", {
+            {"warm_ms", serialWarmMs},
+            {"warm_gb_per_sec", GbPerSec(totalBytes, serialWarmMs)},
+            {"cold_ms", serialColdMs},
+            {"cold_gb_per_sec", GbPerSec(totalBytes, serialColdMs)}
+        }},
+        {"modes", modeResults},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "I/O checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
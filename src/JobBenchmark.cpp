@@ -0,0 +1,281 @@
+// Benchmark for the job system's scaling. Runs the same parallel-for loops - one with an even
+// cost per item, one whose cost grows along the range - and batches of small jobs submitted with
+// Run() on job systems of 1 to N threads, and reports the throughput of each and its speedup over
+// one thread. Checks that every thread count computes the same results and runs every job once.
+// Exits with an error if any check fails.
+
+#include "BenchmarkUtils.h"
+#include "JobSystem.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::MeasureMs;
+
+struct Options
+{
+    std::string OutPath = "job_benchmark_results.json";
+
+    // Zero for one per hardware thread.
+    int MaxThreads = 0;
+
+    int NumItems = 1 << 20;
+    int NumJobs = 100000;
+    int Iterations = 5;
+};
+
+constexpr const char* USAGE =
+    "Usage: JobBenchmark [options]\n"
+    "  --max-threads N   Most job system threads, 0 for one per core (default 0)\n"
+    "  --items N         Items per parallel-for loop (default 1048576)\n"
+    "  --jobs N          Jobs per Run() batch (default 100000)\n"
+    "  --iterations N    Timed runs, the fastest is reported (default 5)\n"
+    "  --out FILE        Results file (default job_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--max-threads")
+            options->MaxThreads = std::stoi(value);
+        else if (arg == "--items")
+            options->NumItems = std::stoi(value);
+        else if (arg == "--jobs")
+            options->NumJobs = std::stoi(value);
+        else if (arg == "--iterations")
+            options->Iterations = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->MaxThreads >= 0 && options->NumItems > 0 && options->NumJobs > 0 &&
+        options->Iterations > 0;
+}
+
+// A few dozen nanoseconds of arithmetic that the compiler cannot fold away.
+float Work(uint32_t item, int rounds)
+{
+    float x = static_cast<float>(item & 0xffff) * 0.001f + 1.f;
+
+    for (int i = 0; i < rounds; ++i)
+        x = std::sqrt(x * 1.0001f + 0.5f);
+
+    return x;
+}
+
+// Rounds of Work() for |item| of |count| when the cost grows along the range, from 1 to 64.
+int UnevenRounds(size_t item, size_t count)
+{
+    return 1 + static_cast<int>(item * 63 / count);
+}
+
+// Jobs are submitted from inside spawner jobs, a bounded number each, so they land on the
+// workers' own queues rather than overflowing one queue into the shared one.
+constexpr int JOBS_PER_SPAWNER = 1024;
+
+struct RunBatch
+{
+    JobSystem* Jobs;
+    JobCounter* Counter;
+    float* Results;
+    int Begin;
+    int End;
+
+    void operator()() const
+    {
+        for (int i = Begin; i < End; ++i)
+        {
+            float* result = &Results[i];
+            uint32_t item = static_cast<uint32_t>(i);
+
+            Jobs->Run([result, item] { *result += Work(item, 4); }, Counter);
+        }
+    }
+};
+
+void RunJobs(JobSystem* jobSystem, std::vector<float>* results)
+{
+    JobCounter counter;
+    int numJobs = static_cast<int>(results->size());
+
+    for (int begin = 0; begin < numJobs; begin += JOBS_PER_SPAWNER)
+    {
+        int end = std::min(begin + JOBS_PER_SPAWNER, numJobs);
+        jobSystem->Run(RunBatch{jobSystem, &counter, results->data(), begin, end}, &counter);
+    }
+
+    jobSystem->Wait(counter);
+}
+
+struct Measurement
+{
+    int NumThreads = 0;
+
+    double EvenMs = 0.0;
+    double UnevenMs = 0.0;
+    double RunMs = 0.0;
+
+    std::vector<float> Even;
+    std::vector<float> Uneven;
+    std::vector<float> RunResults;
+};
+
+Measurement Measure(const Options& options, int numThreads)
+{
+    JobSystem jobSystem(numThreads);
+
+    size_t numItems = static_cast<size_t>(options.NumItems);
+
+    Measurement measurement;
+    measurement.NumThreads = jobSystem.GetThreadCount();
+    measurement.Even.resize(numItems);
+    measurement.Uneven.resize(numItems);
+
+    float* even = measurement.Even.data();
+    float* uneven = measurement.Uneven.data();
+
+    measurement.EvenMs = MeasureMs(options.Iterations, [&] {
+        jobSystem.ParallelFor(numItems, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                even[i] = Work(static_cast<uint32_t>(i), 16);
+        });
+    });
+
+    measurement.UnevenMs = MeasureMs(options.Iterations, [&] {
+        jobSystem.ParallelFor(numItems, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                uneven[i] = Work(static_cast<uint32_t>(i), UnevenRounds(i, numItems));
+        });
+    });
+
+    // Every job adds to its own result, so a job that ran twice or not at all shows in the sums.
+    measurement.RunMs = MeasureMs(
+        options.Iterations, [&] { RunJobs(&jobSystem, &measurement.RunResults); },
+        [&] { measurement.RunResults.assign(static_cast<size_t>(options.NumJobs), 0.f); });
+
+    return measurement;
+}
+
+json Summarize(double ms, double count, double baseMs)
+{
+    return {
+        {"ms", ms},
+        {"per_sec", ms > 0.0 ? count / (ms * 1e-3) : 0.0},
+        {"speedup", ms > 0.0 ? baseMs / ms : 0.0}
+    };
+}
+
+int RunBenchmark(const Options& options)
+{
+    int maxThreads = options.MaxThreads;
+
+    if (maxThreads == 0)
+        maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    std::vector<Measurement> measurements;
+
+    for (int numThreads = 1; numThreads <= maxThreads; ++numThreads)
+        measurements.push_back(Measure(options, numThreads));
+
+    const Measurement& base = measurements.front();
+
+    bool resultsMatch = true;
+    bool jobsRanOnce = true;
+
+    for (const Measurement& measurement : measurements)
+    {
+        resultsMatch = resultsMatch && measurement.Even == base.Even &&
+            measurement.Uneven == base.Uneven;
+
+        for (size_t i = 0; i < measurement.RunResults.size(); ++i)
+        {
+            jobsRanOnce = jobsRanOnce &&
+                measurement.RunResults[i] == Work(static_cast<uint32_t>(i), 4);
+        }
+    }
+
+    Checks checks;
+    checks.Check("parallel_for_matches_one_thread", resultsMatch);
+    checks.Check("run_jobs_ran_once", jobsRanOnce);
+
+    double numItems = static_cast<double>(options.NumItems);
+    double numJobs = static_cast<double>(options.NumJobs);
+
+    json scaling = json::array();
+
+    for (const Measurement& measurement : measurements)
+    {
+        scaling.push_back({
+            {"threads", measurement.NumThreads},
+            {"parallel_for_even", Summarize(measurement.EvenMs, numItems, base.EvenMs)},
+            {"parallel_for_uneven", Summarize(measurement.UnevenMs, numItems, base.UnevenMs)},
+            {"run", Summarize(measurement.RunMs, numJobs, base.RunMs)}
+        });
+    }
+
+    json results = {
+        {"hardware_threads", std::thread::hardware_concurrency()},
+        {"items", options.NumItems},
+        {"jobs", options.NumJobs},
+        {"iterations", options.Iterations},
+        {"scaling", scaling},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%8s %24s %24s %24s\n", "threads", "even items/s", "uneven items/s",
+                "jobs/s");
+
+    for (const json& run : scaling)
+    {
+        std::printf("%8d", run["threads"].get<int>());
+
+        for (const char* name : {"parallel_for_even", "parallel_for_uneven", "run"})
+        {
+            std::printf(" %14.0f (%5.2fx)", run[name]["per_sec"].get<double>(),
+                        run[name]["speedup"].get<double>());
+        }
+
+        std::printf("\n");
+    }
+
+    for (const auto& [name, passed] : checks.Results.items())
+        std::printf("%-32s %s\n", name.c_str(), passed.get<bool>() ? "passed" : "FAILED");
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Job system checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
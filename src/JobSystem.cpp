@@ -0,0 +1,368 @@
+#include "JobSystem.h"
+
+#include <cassert>
+
+namespace
+{
+
+// Jobs are freed by whichever thread ran them, which is seldom the one that created them. Threads
+// pass surplus jobs on through a shared pool, in batches to keep its lock cold, so that a thread
+// that only submits reuses jobs instead of allocating every one.
+constexpr size_t JOB_BATCH_SIZE = 16;
+
+struct SharedJobPool
+{
+    ~SharedJobPool()
+    {
+        for (Job* job : FreeJobs)
+        {
+            delete job;
+        }
+    }
+
+    std::mutex Mutex;
+    std::vector<Job*> FreeJobs;
+};
+
+SharedJobPool g_sharedJobPool;
+
+struct JobPool
+{
+    JobPool()
+    {
+        FreeJobs.reserve(2 * JOB_BATCH_SIZE);
+    }
+
+    ~JobPool()
+    {
+        for (Job* job : FreeJobs)
+        {
+            delete job;
+        }
+    }
+
+    std::vector<Job*> FreeJobs;
+};
+
+thread_local JobPool t_jobPool;
+
+thread_local const JobSystem* t_jobSystem = nullptr;
+thread_local int t_threadIdx = -1;
+
+thread_local uint32_t t_randomState = 0x9e3779b9u;
+
+uint32_t NextRandom()
+{
+    // xorshift32 - only used to pick steal victims.
+    uint32_t x = t_randomState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    t_randomState = x;
+    return x;
+}
+
+} // namespace
+
+JobSystem::JobSystem(int numThreads, std::function<void()> threadInitFn)
+    : m_threadInitFn(std::move(threadInitFn))
+{
+    if (numThreads <= 0)
+        numThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    for (int i = 0; i < numThreads; ++i)
+    {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+
+    // Every thread may hold up to two batches in its own pool, so this many jobs keeps the shared
+    // pool from running dry while each ParallelFor() has a job per thread in flight.
+    {
+        std::lock_guard lock(g_sharedJobPool.Mutex);
+
+        size_t numJobs = static_cast<size_t>(numThreads) * 2 * JOB_BATCH_SIZE;
+
+        while (g_sharedJobPool.FreeJobs.size() < numJobs)
+        {
+            g_sharedJobPool.FreeJobs.push_back(new Job());
+        }
+    }
+
+    t_jobSystem = this;
+    t_threadIdx = 0;
+
+    for (int i = 1; i < numThreads; ++i)
+    {
+        m_workers[i]->Thread = std::thread([this, i] { WorkerMain(i); });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    m_stop.store(true);
+
+    {
+        std::lock_guard lock(m_sleepMutex);
+        m_epoch.fetch_add(1);
+    }
+    m_sleepCv.notify_all();
+
+    for (auto& worker : m_workers)
+    {
+        if (worker->Thread.joinable())
+            worker->Thread.join();
+    }
+
+    if (t_jobSystem == this)
+    {
+        t_jobSystem = nullptr;
+        t_threadIdx = -1;
+    }
+}
+
+int JobSystem::GetThreadCount() const
+{
+    return static_cast<int>(m_workers.size());
+}
+
+int JobSystem::GetCurrentThreadIndex() const
+{
+    return t_jobSystem == this ? t_threadIdx : -1;
+}
+
+Job* JobSystem::AllocateJob()
+{
+    auto& freeJobs = t_jobPool.FreeJobs;
+
+    if (freeJobs.empty())
+    {
+        std::lock_guard lock(g_sharedJobPool.Mutex);
+
+        std::vector<Job*>& sharedJobs = g_sharedJobPool.FreeJobs;
+        size_t count = std::min(sharedJobs.size(), JOB_BATCH_SIZE);
+
+        freeJobs.insert(freeJobs.end(), sharedJobs.end() - static_cast<ptrdiff_t>(count),
+                        sharedJobs.end());
+        sharedJobs.resize(sharedJobs.size() - count);
+    }
+
+    if (freeJobs.empty())
+        return new Job();
+
+    Job* job = freeJobs.back();
+    freeJobs.pop_back();
+
+    return job;
+}
+
+void JobSystem::FreeJob(Job* job)
+{
+    auto& freeJobs = t_jobPool.FreeJobs;
+
+    freeJobs.push_back(job);
+
+    if (freeJobs.size() < 2 * JOB_BATCH_SIZE)
+        return;
+
+    std::lock_guard lock(g_sharedJobPool.Mutex);
+
+    g_sharedJobPool.FreeJobs.insert(g_sharedJobPool.FreeJobs.end(),
+                                    freeJobs.end() - static_cast<ptrdiff_t>(JOB_BATCH_SIZE),
+                                    freeJobs.end());
+    freeJobs.resize(freeJobs.size() - JOB_BATCH_SIZE);
+}
+
+void JobSystem::Submit(Job* job)
+{
+    int threadIdx = GetCurrentThreadIndex();
+
+    if (threadIdx < 0 || !m_workers[threadIdx]->Queue.Push(job))
+    {
+        std::lock_guard lock(m_injectMutex);
+        m_injectQueue.push_back(job);
+        m_injectCount.fetch_add(1, std::memory_order_release);
+    }
+
+    m_epoch.fetch_add(1, std::memory_order_seq_cst);
+
+    if (m_numSleeping.load(std::memory_order_seq_cst) > 0)
+    {
+        // Taking the lock orders this notify after a sleeper's predicate check.
+        {
+            std::lock_guard lock(m_sleepMutex);
+        }
+        m_sleepCv.notify_one();
+    }
+}
+
+void JobSystem::AddContinuation(JobCounter& dependency, Job* job)
+{
+    Job* head = dependency.m_continuations.load(std::memory_order_relaxed);
+
+    do
+    {
+        job->Next = head;
+    } while (!dependency.m_continuations.compare_exchange_weak(head, job,
+                                                               std::memory_order_seq_cst));
+
+    // If the dependency finished before the push became visible, nobody else will schedule the
+    // continuations, so claim whatever is on the stack.
+    if (dependency.m_value.load(std::memory_order_seq_cst) == 0)
+    {
+        Job* pending = dependency.m_continuations.exchange(nullptr, std::memory_order_acq_rel);
+
+        // The job that finished the dependency may not have let go of it yet. Waiters on the
+        // continuations may destroy the dependency, so they must not run before it has.
+        while (pending && dependency.m_numFinishing.load(std::memory_order_seq_cst) != 0)
+            std::this_thread::yield();
+
+        while (pending)
+        {
+            Job* next = pending->Next;
+            Submit(pending);
+            pending = next;
+        }
+    }
+}
+
+void JobSystem::FinishJob(JobCounter* counter)
+{
+    counter->m_numFinishing.fetch_add(1, std::memory_order_seq_cst);
+
+    Job* pending = nullptr;
+
+    if (counter->m_value.fetch_sub(1, std::memory_order_seq_cst) == 1)
+        pending = counter->m_continuations.exchange(nullptr, std::memory_order_acq_rel);
+
+    // The counter may be destroyed by a waiter as soon as this lands. That includes a waiter on
+    // a continuation, so the continuations are only submitted after it.
+    counter->m_numFinishing.fetch_sub(1, std::memory_order_seq_cst);
+
+    while (pending)
+    {
+        Job* next = pending->Next;
+        Submit(pending);
+        pending = next;
+    }
+}
+
+bool JobSystem::TryGetJob(Job** job)
+{
+    int threadIdx = GetCurrentThreadIndex();
+
+    if (threadIdx >= 0 && m_workers[threadIdx]->Queue.Pop(job))
+        return true;
+
+    if (m_injectCount.load(std::memory_order_acquire) > 0)
+    {
+        std::lock_guard lock(m_injectMutex);
+
+        if (!m_injectQueue.empty())
+        {
+            *job = m_injectQueue.front();
+            m_injectQueue.pop_front();
+            m_injectCount.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    size_t numWorkers = m_workers.size();
+    size_t start = NextRandom() % numWorkers;
+
+    for (size_t i = 0; i < numWorkers; ++i)
+    {
+        size_t victim = (start + i) % numWorkers;
+
+        if (static_cast<int>(victim) == threadIdx)
+            continue;
+
+        if (m_workers[victim]->Queue.Steal(job))
+            return true;
+    }
+
+    return false;
+}
+
+bool JobSystem::TryExecuteOne()
+{
+    Job* job = nullptr;
+
+    if (!TryGetJob(&job))
+        return false;
+
+    Execute(job);
+
+    return true;
+}
+
+void JobSystem::Execute(Job* job)
+{
+    {
+        AllocationScope allocationScope(job->Subsystem);
+        job->Invoke(job);
+    }
+
+    JobCounter* counter = job->Counter;
+
+    FreeJob(job);
+
+    if (counter)
+        FinishJob(counter);
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+    int idleSpins = 0;
+
+    while (!counter.IsDone())
+    {
+        if (TryExecuteOne())
+        {
+            idleSpins = 0;
+            continue;
+        }
+
+        // The remaining jobs are running elsewhere - back off gradually.
+        if (++idleSpins > 64)
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::WorkerMain(int threadIdx)
+{
+    t_jobSystem = this;
+    t_threadIdx = threadIdx;
+    t_randomState ^= static_cast<uint32_t>(threadIdx + 1) * 0x85ebca6bu;
+
+    if (m_threadInitFn)
+        m_threadInitFn();
+
+    static constexpr int spinsBeforeSleep = 256;
+
+    while (!m_stop.load(std::memory_order_relaxed))
+    {
+        uint64_t epoch = m_epoch.load(std::memory_order_seq_cst);
+
+        bool didWork = false;
+
+        for (int i = 0; i < spinsBeforeSleep && !didWork; ++i)
+        {
+            didWork = TryExecuteOne();
+        }
+
+        if (didWork)
+            continue;
+
+        std::unique_lock lock(m_sleepMutex);
+
+        m_numSleeping.fetch_add(1, std::memory_order_seq_cst);
+
+        m_sleepCv.wait(lock, [&] {
+            return m_stop.load() || m_epoch.load(std::memory_order_seq_cst) != epoch;
+        });
+
+        m_numSleeping.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    assert(m_workers[threadIdx]->Queue.IsEmpty());
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "AllocationTracker.h"
+#include "WorkStealingQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct Job;
+
+// Tracks a group of outstanding jobs. A counter must outlive every job that references it, either
+// as its completion counter or as its dependency.
+class JobCounter
+{
+public:
+    JobCounter() = default;
+
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool IsDone() const
+    {
+        // A job that just dropped the value to zero may still be scheduling continuations, so the
+        // counter is only done (and safe to destroy) once that has finished as well.
+        return m_value.load(std::memory_order_seq_cst) == 0 &&
+            m_numFinishing.load(std::memory_order_seq_cst) == 0;
+    }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int> m_value = 0;
+    std::atomic<int> m_numFinishing = 0;
+
+    // Jobs waiting for this counter to reach zero, as an intrusive stack.
+    std::atomic<Job*> m_continuations = nullptr;
+};
+
+struct Job
+{
+    static constexpr size_t STORAGE_SIZE = 64;
+
+    void (*Invoke)(Job*) = nullptr;
+
+    JobCounter* Counter = nullptr;
+
+    Job* Next = nullptr;
+
+    // Charged with the job's allocations - that of the thread that created it.
+    AllocationSubsystem Subsystem = AllocationSubsystem::Other;
+
+    alignas(std::max_align_t) std::byte Storage[STORAGE_SIZE];
+};
+
+class JobSystem
+{
+public:
+    // |numThreads| counts the constructing thread, which becomes worker 0 and executes jobs
+    // whenever it waits. Zero means one worker per hardware thread. |threadInitFn| runs on every
+    // spawned worker before it picks up any jobs.
+    explicit JobSystem(int numThreads = 0, std::function<void()> threadInitFn = nullptr);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    template<typename Fn>
+    void Run(Fn&& fn, JobCounter* counter = nullptr)
+    {
+        Submit(CreateJob(std::forward<Fn>(fn), counter));
+    }
+
+    // Runs |fn| once every job tracked by |dependency| has finished. |counter| is incremented
+    // immediately, so waiting on it also waits for the dependency, which may be destroyed once
+    // that wait returns.
+    template<typename Fn>
+    void RunAfter(JobCounter& dependency, Fn&& fn, JobCounter* counter = nullptr)
+    {
+        AddContinuation(dependency, CreateJob(std::forward<Fn>(fn), counter));
+    }
+
+    // Calls |fn(begin, end)| over sub-ranges of [0, count). Chunks are claimed from a shared
+    // cursor and shrink as the remaining range shrinks (guided scheduling), so uneven per-item
+    // costs still balance across workers. Returns once the whole range is processed.
+    template<typename Fn>
+    void ParallelFor(size_t count, Fn&& fn, size_t minChunkSize = 1)
+    {
+        if (count == 0)
+            return;
+
+        size_t numJobs = std::min(static_cast<size_t>(GetThreadCount()),
+                                  (count + minChunkSize - 1) / minChunkSize);
+
+        if (numJobs <= 1)
+        {
+            fn(size_t{0}, count);
+            return;
+        }
+
+        std::atomic<size_t> cursor = 0;
+
+        auto processChunks = [&] {
+            for (;;)
+            {
+                size_t begin = cursor.load(std::memory_order_relaxed);
+                size_t end = 0;
+
+                do
+                {
+                    if (begin >= count)
+                        return;
+
+                    size_t chunk = std::max((count - begin) / (2 * numJobs), minChunkSize);
+                    end = std::min(begin + chunk, count);
+                } while (!cursor.compare_exchange_weak(begin, end, std::memory_order_relaxed));
+
+                fn(begin, end);
+            }
+        };
+
+        JobCounter counter;
+
+        for (size_t i = 1; i < numJobs; ++i)
+        {
+            Run(processChunks, &counter);
+        }
+
+        processChunks();
+
+        Wait(counter);
+    }
+
+    // Blocks until |counter| reaches zero, executing other jobs in the meantime.
+    void Wait(JobCounter& counter);
+
+    int GetThreadCount() const;
+
+    // Index of the calling thread within this job system, or -1 for foreign threads.
+    int GetCurrentThreadIndex() const;
+
+private:
+    static constexpr size_t QUEUE_CAPACITY = 4096;
+
+    template<typename Fn>
+    Job* CreateJob(Fn&& fn, JobCounter* counter)
+    {
+        using Callable = std::decay_t<Fn>;
+
+        static_assert(sizeof(Callable) <= Job::STORAGE_SIZE,
+                      "Job callable too large - capture by reference or pointer.");
+        static_assert(alignof(Callable) <= alignof(std::max_align_t));
+
+        Job* job = AllocateJob();
+
+        new (job->Storage) Callable(std::forward<Fn>(fn));
+
+        job->Invoke = [](Job* self) {
+            Callable* callable = std::launder(reinterpret_cast<Callable*>(self->Storage));
+            (*callable)();
+            callable->~Callable();
+        };
+
+        job->Counter = counter;
+        job->Next = nullptr;
+        job->Subsystem = AllocationTracker::GetSubsystem();
+
+        if (counter)
+            counter->m_value.fetch_add(1, std::memory_order_relaxed);
+
+        return job;
+    }
+
+    static Job* AllocateJob();
+    static void FreeJob(Job* job);
+
+    void Submit(Job* job);
+
+    void AddContinuation(JobCounter& dependency, Job* job);
+
+    void FinishJob(JobCounter* counter);
+
+    bool TryExecuteOne();
+    bool TryGetJob(Job** job);
+
+    void Execute(Job* job);
+
+    void WorkerMain(int threadIdx);
+
+    struct Worker
+    {
+        Worker() : Queue(QUEUE_CAPACITY) {}
+
+        WorkStealingQueue<Job*> Queue;
+
+        std::thread Thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    std::function<void()> m_threadInitFn;
+
+    // Submissions from threads that do not own a queue.
+    std::mutex m_injectMutex;
+    std::deque<Job*> m_injectQueue;
+    std::atomic<size_t> m_injectCount = 0;
+
+    // Idle workers sleep until the epoch moves on, which happens on every submission.
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCv;
+    std::atomic<uint64_t> m_epoch = 0;
+    std::atomic<int> m_numSleeping = 0;
+
+    std::atomic<bool> m_stop = false;
+};
@@ -0,0 +1,390 @@
+// Stress test for the job system, meant to run under ThreadSanitizer. Races thieves against the
+// owner of a small work-stealing queue, then hammers a job system with nested submissions,
+// continuations added while their dependencies finish, counters destroyed as soon as they are
+// done, submissions and waits from threads outside the job system, and nested parallel-for loops.
+// Every job must run exactly once and every continuation after its dependency. Exits with an
+// error if any check fails.
+
+#include "BenchmarkUtils.h"
+#include "JobSystem.h"
+#include "WorkStealingQueue.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+using benchmark::ElapsedMs;
+
+struct Options
+{
+    std::string OutPath = "job_system_stress_results.json";
+
+    int NumThreads = 4;
+    int NumRounds = 200;
+};
+
+constexpr const char* USAGE =
+    "Usage: JobSystemStress [options]\n"
+    "  --threads N    Job system threads, at least 2 (default 4)\n"
+    "  --rounds N     Rounds of each test (default 200)\n"
+    "  --out FILE     Results file (default job_system_stress_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--threads")
+            options->NumThreads = std::stoi(value);
+        else if (arg == "--rounds")
+            options->NumRounds = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->NumThreads >= 2 && options->NumRounds > 0;
+}
+
+// Whether every slot was counted exactly once.
+bool AllOnce(const std::vector<std::atomic<int>>& counts)
+{
+    return std::all_of(counts.begin(), counts.end(),
+                       [](const std::atomic<int>& count) { return count.load() == 1; });
+}
+
+// The owner pushes and pops while thieves steal, through a queue small enough to wrap and to run
+// down to its last item over and over, where pop and steal race for it.
+bool CheckQueueRaces(int numRounds, int numThieves)
+{
+    constexpr size_t capacity = 16;
+    constexpr uint32_t itemsPerRound = 1000;
+
+    uint32_t numItems = static_cast<uint32_t>(numRounds) * itemsPerRound;
+
+    WorkStealingQueue<uint32_t> queue(capacity);
+    std::vector<std::atomic<int>> taken(numItems);
+    std::atomic<bool> done = false;
+
+    std::vector<std::thread> thieves;
+
+    for (int i = 0; i < numThieves; ++i)
+    {
+        thieves.emplace_back([&] {
+            uint32_t item = 0;
+
+            while (!done.load(std::memory_order_acquire))
+            {
+                if (queue.Steal(&item))
+                    taken[item].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    std::mt19937 rng(1);
+    uint32_t next = 0;
+    uint32_t item = 0;
+
+    while (next < numItems)
+    {
+        // Bursts of pushes, then pops, so the queue swings between full and empty.
+        uint32_t numPushes = static_cast<uint32_t>(rng() % (capacity + 1));
+
+        for (uint32_t i = 0; i < numPushes && next < numItems; ++i)
+        {
+            if (!queue.Push(next))
+                break;
+
+            ++next;
+        }
+
+        uint32_t numPops = static_cast<uint32_t>(rng() % (capacity + 1));
+
+        for (uint32_t i = 0; i < numPops; ++i)
+        {
+            if (queue.Pop(&item))
+                taken[item].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    while (queue.Pop(&item))
+        taken[item].fetch_add(1, std::memory_order_relaxed);
+
+    done.store(true, std::memory_order_release);
+
+    for (std::thread& thief : thieves)
+        thief.join();
+
+    return queue.IsEmpty() && AllOnce(taken);
+}
+
+struct FanOut
+{
+    JobSystem* Jobs;
+    JobCounter* Counter;
+    std::atomic<int>* NumRan;
+    int Depth;
+
+    void operator()() const
+    {
+        NumRan->fetch_add(1, std::memory_order_relaxed);
+
+        if (Depth == 0)
+            return;
+
+        for (int i = 0; i < 4; ++i)
+            Jobs->Run(FanOut{Jobs, Counter, NumRan, Depth - 1}, Counter);
+    }
+};
+
+// Jobs submit jobs, which submit jobs, onto the queues of whichever workers run them.
+bool CheckNestedRuns(JobSystem* jobSystem, int numRounds)
+{
+    constexpr int depth = 5;
+
+    // 4^0 + 4^1 + ... + 4^depth.
+    constexpr int numJobs = ((1 << (2 * (depth + 1))) - 1) / 3;
+
+    bool passed = true;
+
+    for (int round = 0; round < numRounds; ++round)
+    {
+        JobCounter counter;
+        std::atomic<int> numRan = 0;
+
+        jobSystem->Run(FanOut{jobSystem, &counter, &numRan, depth}, &counter);
+        jobSystem->Wait(counter);
+
+        passed = passed && numRan.load() == numJobs;
+    }
+
+    return passed;
+}
+
+// Continuations are added from jobs while the jobs they depend on finish, racing the last of them
+// to schedule the continuations. Each must run once, after all of its dependency, and continuations
+// of continuations must run after those.
+bool CheckContinuations(JobSystem* jobSystem, int numRounds)
+{
+    constexpr int numDependencies = 16;
+    constexpr int numContinuations = 16;
+
+    bool passed = true;
+
+    for (int round = 0; round < numRounds; ++round)
+    {
+        JobCounter dependency;
+        JobCounter adders;
+        JobCounter continuations;
+        JobCounter followUps;
+
+        std::atomic<int> numFinished = 0;
+        std::atomic<int> numRan = 0;
+        std::atomic<int> numEarly = 0;
+        std::atomic<int> numFollowUps = 0;
+
+        for (int i = 0; i < numDependencies; ++i)
+        {
+            jobSystem->Run([&numFinished] { numFinished.fetch_add(1); }, &dependency);
+        }
+
+        for (int i = 0; i < numContinuations; ++i)
+        {
+            jobSystem->Run(
+                [&] {
+                    jobSystem->RunAfter(
+                        dependency,
+                        [&] {
+                            if (numFinished.load() != numDependencies)
+                                numEarly.fetch_add(1);
+
+                            numRan.fetch_add(1);
+                        },
+                        &continuations);
+                },
+                &adders);
+        }
+
+        // Every continuation is on |continuations| once the adders are done.
+        jobSystem->Wait(adders);
+
+        jobSystem->RunAfter(
+            continuations,
+            [&] {
+                if (numRan.load() != numContinuations)
+                    numEarly.fetch_add(1);
+
+                numFollowUps.fetch_add(1);
+            },
+            &followUps);
+
+        jobSystem->Wait(followUps);
+        jobSystem->Wait(dependency);
+
+        passed = passed && numRan.load() == numContinuations && numFollowUps.load() == 1 &&
+            numEarly.load() == 0;
+    }
+
+    return passed;
+}
+
+// Counters are destroyed the moment a wait on them returns, while the job that finished them may
+// still be returning from it. A dependency is destroyed once its continuation has run, without a
+// wait of its own.
+bool CheckCounterTeardown(JobSystem* jobSystem, int numRounds)
+{
+    std::atomic<int> numRan = 0;
+
+    for (int round = 0; round < numRounds * 10; ++round)
+    {
+        auto counter = std::make_unique<JobCounter>();
+        auto after = std::make_unique<JobCounter>();
+
+        jobSystem->Run([&numRan] { numRan.fetch_add(1); }, counter.get());
+        jobSystem->RunAfter(*counter, [&numRan] { numRan.fetch_add(1); }, after.get());
+
+        jobSystem->Wait(*after);
+        after.reset();
+        counter.reset();
+    }
+
+    return numRan.load() == numRounds * 20;
+}
+
+// Threads outside the job system submit into its shared queue and help run jobs while they wait,
+// stealing from the workers.
+bool CheckForeignThreads(JobSystem* jobSystem, int numRounds)
+{
+    constexpr int numThreads = 3;
+    constexpr int numJobs = 64;
+
+    std::vector<std::atomic<int>> counts(static_cast<size_t>(numThreads * numRounds * numJobs));
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < numThreads; ++t)
+    {
+        threads.emplace_back([&, t] {
+            for (int round = 0; round < numRounds; ++round)
+            {
+                JobCounter counter;
+                size_t base = static_cast<size_t>((t * numRounds + round) * numJobs);
+
+                for (size_t i = 0; i < numJobs; ++i)
+                {
+                    jobSystem->Run([&counts, base, i] { counts[base + i].fetch_add(1); },
+                                   &counter);
+                }
+
+                jobSystem->Wait(counter);
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    return AllOnce(counts);
+}
+
+// Parallel-for loops inside the chunks of another, so chunk claiming races across every worker.
+bool CheckNestedParallelFor(JobSystem* jobSystem, int numRounds)
+{
+    constexpr size_t numOuter = 64;
+    constexpr size_t numInner = 64;
+
+    bool passed = true;
+
+    for (int round = 0; round < numRounds; ++round)
+    {
+        std::vector<std::atomic<int>> counts(numOuter * numInner);
+
+        jobSystem->ParallelFor(numOuter, [&](size_t begin, size_t end) {
+            for (size_t outer = begin; outer < end; ++outer)
+            {
+                jobSystem->ParallelFor(numInner, [&](size_t innerBegin, size_t innerEnd) {
+                    for (size_t inner = innerBegin; inner < innerEnd; ++inner)
+                        counts[outer * numInner + inner].fetch_add(1);
+                });
+            }
+        });
+
+        passed = passed && AllOnce(counts);
+    }
+
+    return passed;
+}
+
+int RunStressTest(const Options& options)
+{
+    Checks checks;
+    json timings = json::object();
+
+    auto check = [&](const char* name, auto&& test) {
+        Clock::time_point start = Clock::now();
+        checks.Check(name, test());
+        timings[name] = ElapsedMs(start);
+    };
+
+    check("queue_steal_pop_races",
+          [&] { return CheckQueueRaces(options.NumRounds, options.NumThreads - 1); });
+
+    {
+        JobSystem jobSystem(options.NumThreads);
+
+        check("nested_runs", [&] { return CheckNestedRuns(&jobSystem, options.NumRounds); });
+        check("continuations",
+              [&] { return CheckContinuations(&jobSystem, options.NumRounds); });
+        check("counter_teardown",
+              [&] { return CheckCounterTeardown(&jobSystem, options.NumRounds); });
+        check("foreign_threads",
+              [&] { return CheckForeignThreads(&jobSystem, options.NumRounds); });
+        check("nested_parallel_for",
+              [&] { return CheckNestedParallelFor(&jobSystem, options.NumRounds); });
+    }
+
+    json results = {
+        {"threads", options.NumThreads},
+        {"rounds", options.NumRounds},
+        {"ms", timings},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Job system stress checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunStressTest);
+}
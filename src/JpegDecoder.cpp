@@ -0,0 +1,1174 @@
+#include "JpegDecoder.h"
+
+#include "DecoderKernels.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+constexpr uint32_t FAST_BITS = 9;
+
+enum Marker : uint32_t
+{
+    MARKER_SOF0 = 0xC0,
+    MARKER_SOF1 = 0xC1,
+    MARKER_SOF2 = 0xC2,
+    MARKER_DHT = 0xC4,
+    MARKER_RST0 = 0xD0,
+    MARKER_RST7 = 0xD7,
+    MARKER_SOI = 0xD8,
+    MARKER_EOI = 0xD9,
+    MARKER_SOS = 0xDA,
+    MARKER_DQT = 0xDB,
+    MARKER_DRI = 0xDD,
+    MARKER_APP0 = 0xE0,
+    MARKER_APP14 = 0xEE,
+    MARKER_TEM = 0x01
+};
+
+// Natural order index of each zigzag position. Padded so that corrupt runs past the end of a
+// block land on its last coefficient.
+constexpr uint8_t ZIGZAG[64 + 16] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,  12, 19, 26, 33,
+    40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54,
+    47, 55, 62, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63};
+
+uint32_t ReadBigEndian16(std::span<const std::byte> data, size_t offset)
+{
+    return (static_cast<uint32_t>(data[offset]) << 8) | static_cast<uint32_t>(data[offset + 1]);
+}
+
+uint32_t DivideRoundingUp(uint32_t value, uint32_t divisor)
+{
+    return (value + divisor - 1) / divisor;
+}
+
+uint64_t ByteSwap64(uint64_t value)
+{
+#ifdef _MSC_VER
+    return _byteswap_uint64(value);
+#else
+    return __builtin_bswap64(value);
+#endif
+}
+
+bool HasAcCoefs(const int16_t* coefs)
+{
+    int32_t bits = 0;
+
+    for (int i = 1; i < 64; ++i)
+        bits |= coefs[i];
+
+    return bits != 0;
+}
+
+} // namespace
+
+// Reads entropy-coded data starting with the most significant bit, dropping the zero byte stuffed
+// after each 0xFF. Stops in front of the first marker and reads zeros from there on.
+class JpegDecoder::BitReader
+{
+public:
+    explicit BitReader(std::span<const std::byte> data)
+        : m_begin(reinterpret_cast<const uint8_t*>(data.data()))
+        , m_pos(m_begin)
+        , m_end(m_begin + data.size())
+    {
+    }
+
+    uint32_t DecodeHuffman(const HuffmanTable& table)
+    {
+        if (m_count < 16)
+            Refill();
+
+        uint32_t entry = table.Fast[m_bits >> (64 - FAST_BITS)];
+
+        if (entry != 0)
+        {
+            Consume(entry >> 8);
+            return entry & 0xFF;
+        }
+
+        uint32_t window = static_cast<uint32_t>(m_bits >> 48);
+        uint32_t length = FAST_BITS + 1;
+
+        while (window >= table.EndCode[length])
+            ++length;
+
+        if (length > 16)
+            throw std::runtime_error("Invalid JPEG Huffman code.");
+
+        uint32_t index = static_cast<uint32_t>(static_cast<int32_t>(window >> (16 - length)) +
+                                               table.SymbolOffset[length]);
+
+        if (index >= table.NumSymbols)
+            throw std::runtime_error("Invalid JPEG Huffman code.");
+
+        Consume(length);
+
+        return table.Symbols[index];
+    }
+
+    // Decodes an AC coefficient through FastAc. Returns its entry, or zero without consuming
+    // anything if the coefficient is not in the table.
+    int32_t DecodeFastAc(const HuffmanTable& table)
+    {
+        if (m_count < 16)
+            Refill();
+
+        int32_t entry = table.FastAc[m_bits >> (64 - FAST_BITS)];
+        Consume(static_cast<uint32_t>(entry & 0xF));
+
+        return entry;
+    }
+
+    uint32_t GetBits(uint32_t numBits)
+    {
+        if (m_count < numBits)
+            Refill();
+
+        uint32_t value = static_cast<uint32_t>(m_bits >> (64 - numBits));
+        Consume(numBits);
+
+        return value;
+    }
+
+    // Reads a |size| bit magnitude category value.
+    int32_t ReceiveExtend(uint32_t size)
+    {
+        if (size == 0)
+            return 0;
+
+        if (size > 16)
+            throw std::runtime_error("Invalid JPEG coefficient.");
+
+        int32_t value = static_cast<int32_t>(GetBits(size));
+
+        // Values with a leading zero bit are negative.
+        if (value < (1 << (size - 1)))
+            value -= (1 << size) - 1;
+
+        return value;
+    }
+
+    // Discards the rest of the restart interval and its RSTn marker.
+    void Restart()
+    {
+        m_bits = 0;
+        m_count = 0;
+        m_atMarker = false;
+
+        while (m_end - m_pos >= 2 && m_pos[0] == 0xFF && m_pos[1] == 0xFF)
+            ++m_pos;
+
+        if (m_end - m_pos < 2 || m_pos[0] != 0xFF || m_pos[1] < MARKER_RST0 ||
+            m_pos[1] > MARKER_RST7)
+        {
+            throw std::runtime_error("Invalid JPEG restart marker.");
+        }
+
+        m_pos += 2;
+    }
+
+    size_t GetOffset() const
+    {
+        return static_cast<size_t>(m_pos - m_begin);
+    }
+
+private:
+    void Consume(uint32_t numBits)
+    {
+        m_bits <<= numBits;
+        m_count -= numBits;
+    }
+
+    // Makes at least 57 bits available.
+    void Refill()
+    {
+        if (!m_atMarker && m_end - m_pos >= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, m_pos, sizeof(word));
+
+            // Without 0xFF bytes there is nothing to unstuff, so all 8 bytes can be taken at
+            // once. Bits past the whole bytes that fit are loaded again, to the same place, by the
+            // next refill. The test is the classic has-zero-byte test on the inverted word.
+            if (((~word - 0x0101010101010101ull) & word & 0x8080808080808080ull) == 0)
+            {
+                m_bits |= ByteSwap64(word) >> m_count;
+                m_pos += (63 - m_count) >> 3;
+                m_count |= 56;
+                return;
+            }
+        }
+
+        while (m_count <= 56)
+        {
+            uint64_t byte = 0;
+
+            if (!m_atMarker && m_pos < m_end)
+            {
+                byte = *m_pos;
+
+                if (byte != 0xFF)
+                {
+                    ++m_pos;
+                }
+                else if (m_end - m_pos >= 2 && m_pos[1] == 0)
+                {
+                    m_pos += 2;
+                }
+                else
+                {
+                    m_atMarker = true;
+                    byte = 0;
+                }
+            }
+
+            m_bits |= byte << (56 - m_count);
+            m_count += 8;
+        }
+    }
+
+    const uint8_t* m_begin;
+    const uint8_t* m_pos;
+    const uint8_t* m_end;
+
+    uint64_t m_bits = 0;
+    uint32_t m_count = 0;
+    bool m_atMarker = false;
+};
+
+JpegDecoder::JpegDecoder(std::span<const std::byte> data, const PixelKernels& kernels)
+    : m_data(data)
+    , m_kernels(kernels)
+{
+    if (!HasSignature(data))
+        throw std::runtime_error("Not a JPEG file.");
+
+    m_offset = 2;
+
+    ReadMarkers(true);
+}
+
+JpegDecoder::~JpegDecoder() = default;
+
+uint32_t JpegDecoder::GetWidth() const
+{
+    return m_width;
+}
+
+uint32_t JpegDecoder::GetHeight() const
+{
+    return m_height;
+}
+
+void JpegDecoder::Decode(uint8_t* dst, size_t rowPitch)
+{
+    m_dst = dst;
+    m_rowPitch = rowPitch;
+
+    ReadMarkers(false);
+
+    if (m_components[0].Plane.empty())
+        throw std::runtime_error("Invalid JPEG file.");
+
+    if (m_progressive)
+        WriteProgressiveBlocks();
+
+    for (uint32_t i = 0; i < m_numComponents; ++i)
+        m_components[i].RowsDone = m_components[i].Height;
+
+    EmitRows();
+}
+
+bool JpegDecoder::HasSignature(std::span<const std::byte> data)
+{
+    return data.size() >= 3 && data[0] == std::byte{0xFF} && data[1] == std::byte{MARKER_SOI} &&
+        data[2] == std::byte{0xFF};
+}
+
+void JpegDecoder::ReadMarkers(bool untilFrame)
+{
+    for (;;)
+    {
+        // libjpeg also tolerates a missing end of image marker.
+        if (!untilFrame && m_offset >= m_data.size())
+            return;
+
+        uint32_t marker = ReadMarker();
+
+        switch (marker)
+        {
+            case MARKER_SOF0:
+            case MARKER_SOF1:
+            case MARKER_SOF2:
+                if (!untilFrame)
+                    throw std::runtime_error("Invalid JPEG file.");
+
+                ReadFrameHeader(ReadSegment(), marker == MARKER_SOF2);
+                return;
+            case 0xC3:
+            case 0xC5:
+            case 0xC6:
+            case 0xC7:
+            case 0xC9:
+            case 0xCA:
+            case 0xCB:
+            case 0xCD:
+            case 0xCE:
+            case 0xCF:
+                throw std::runtime_error("Unsupported JPEG coding.");
+            case MARKER_DHT:
+                ReadHuffmanTables(ReadSegment());
+                break;
+            case MARKER_DQT:
+                ReadQuantTables(ReadSegment());
+                break;
+            case MARKER_DRI:
+            {
+                std::span<const std::byte> segment = ReadSegment();
+
+                if (segment.size() != 2)
+                    throw std::runtime_error("Invalid JPEG file.");
+
+                m_restartInterval = ReadBigEndian16(segment, 0);
+                break;
+            }
+            case MARKER_APP0:
+            {
+                std::span<const std::byte> segment = ReadSegment();
+                m_hasJfif = m_hasJfif ||
+                    (segment.size() >= 5 && std::memcmp(segment.data(), "JFIF", 5) == 0);
+                break;
+            }
+            case MARKER_APP14:
+                ReadAdobeSegment(ReadSegment());
+                break;
+            case MARKER_SOS:
+            {
+                if (untilFrame)
+                    throw std::runtime_error("Invalid JPEG file.");
+
+                Scan scan = ReadScanHeader(ReadSegment());
+
+                if (m_components[0].Plane.empty())
+                    AllocateComponents();
+
+                DecodeScan(scan);
+                break;
+            }
+            case MARKER_EOI:
+                if (untilFrame)
+                    throw std::runtime_error("Invalid JPEG file.");
+
+                return;
+            case MARKER_SOI:
+                throw std::runtime_error("Invalid JPEG file.");
+            case MARKER_TEM:
+                break;
+            default:
+                // Restart markers outside of scans are stray and have no segment.
+                if (marker < MARKER_RST0 || marker > MARKER_RST7)
+                    ReadSegment();
+                break;
+        }
+    }
+}
+
+uint32_t JpegDecoder::ReadMarker()
+{
+    // Bytes that are not part of a marker are skipped, as libjpeg does.
+    for (;;)
+    {
+        while (m_offset < m_data.size() && m_data[m_offset] != std::byte{0xFF})
+            ++m_offset;
+
+        while (m_offset < m_data.size() && m_data[m_offset] == std::byte{0xFF})
+            ++m_offset;
+
+        if (m_offset >= m_data.size())
+            throw std::runtime_error("Truncated JPEG file.");
+
+        uint32_t marker = static_cast<uint32_t>(m_data[m_offset++]);
+
+        if (marker != 0)
+            return marker;
+    }
+}
+
+std::span<const std::byte> JpegDecoder::ReadSegment()
+{
+    if (m_data.size() - m_offset < 2)
+        throw std::runtime_error("Truncated JPEG file.");
+
+    size_t length = ReadBigEndian16(m_data, m_offset);
+
+    if (length < 2 || length > m_data.size() - m_offset)
+        throw std::runtime_error("Truncated JPEG file.");
+
+    std::span<const std::byte> segment = m_data.subspan(m_offset + 2, length - 2);
+    m_offset += length;
+
+    return segment;
+}
+
+void JpegDecoder::ReadFrameHeader(std::span<const std::byte> segment, bool progressive)
+{
+    if (segment.size() < 6)
+        throw std::runtime_error("Invalid JPEG file.");
+
+    if (segment[0] != std::byte{8})
+        throw std::runtime_error("Unsupported JPEG sample precision.");
+
+    m_progressive = progressive;
+    m_height = ReadBigEndian16(segment, 1);
+    m_width = ReadBigEndian16(segment, 3);
+    m_numComponents = static_cast<uint32_t>(segment[5]);
+
+    // A zero height would be defined by a DNL marker after the first scan.
+    if (m_width == 0 || m_height == 0)
+        throw std::runtime_error("Unsupported JPEG file.");
+
+    if (m_numComponents != 1 && m_numComponents != 3)
+        throw std::runtime_error("Unsupported JPEG color format.");
+
+    if (segment.size() != 6 + 3 * m_numComponents)
+        throw std::runtime_error("Invalid JPEG file.");
+
+    for (uint32_t i = 0; i < m_numComponents; ++i)
+    {
+        Component& component = m_components[i];
+        uint32_t sampling = static_cast<uint32_t>(segment[7 + 3 * i]);
+
+        component.Id = static_cast<uint32_t>(segment[6 + 3 * i]);
+        component.SamplingX = sampling >> 4;
+        component.SamplingY = sampling & 0xF;
+        component.QuantTable = static_cast<uint32_t>(segment[8 + 3 * i]);
+
+        if (component.SamplingX < 1 || component.SamplingX > 4 || component.SamplingY < 1 ||
+            component.SamplingY > 4 || component.QuantTable > 3)
+        {
+            throw std::runtime_error("Invalid JPEG file.");
+        }
+
+        m_maxSamplingX = std::max(m_maxSamplingX, component.SamplingX);
+        m_maxSamplingY = std::max(m_maxSamplingY, component.SamplingY);
+    }
+
+    m_mcusPerLine = DivideRoundingUp(m_width, 8 * m_maxSamplingX);
+    m_mcusPerColumn = DivideRoundingUp(m_height, 8 * m_maxSamplingY);
+
+    for (uint32_t i = 0; i < m_numComponents; ++i)
+    {
+        Component& component = m_components[i];
+
+        if (m_maxSamplingX % component.SamplingX != 0 ||
+            m_maxSamplingY % component.SamplingY != 0)
+        {
+            throw std::runtime_error("Unsupported JPEG chroma subsampling.");
+        }
+
+        component.Width = DivideRoundingUp(m_width * component.SamplingX, m_maxSamplingX);
+        component.Height = DivideRoundingUp(m_height * component.SamplingY, m_maxSamplingY);
+        component.BlocksPerLine = DivideRoundingUp(component.Width, 8);
+        component.BlocksPerColumn = DivideRoundingUp(component.Height, 8);
+        component.ScaleX = m_maxSamplingX / component.SamplingX;
+        component.ScaleY = m_maxSamplingY / component.SamplingY;
+
+        // The same choices as libjpeg, which falls back to replicating samples when there are
+        // too few of them to interpolate horizontally.
+        bool canInterpolate = component.Width > 2;
+
+        if (component.ScaleX == 1 && component.ScaleY == 1)
+            component.Upsampling = UpsamplingMode::None;
+        else if (component.ScaleX == 2 && component.ScaleY == 1 && canInterpolate)
+            component.Upsampling = UpsamplingMode::H2;
+        else if (component.ScaleX == 1 && component.ScaleY == 2)
+            component.Upsampling = UpsamplingMode::V2;
+        else if (component.ScaleX == 2 && component.ScaleY == 2 && canInterpolate)
+            component.Upsampling = UpsamplingMode::H2V2;
+        else
+            component.Upsampling = UpsamplingMode::Replicate;
+    }
+}
+
+void JpegDecoder::ReadHuffmanTables(std::span<const std::byte> segment)
+{
+    size_t offset = 0;
+
+    while (offset < segment.size())
+    {
+        if (segment.size() - offset < 17)
+            throw std::runtime_error("Invalid JPEG file.");
+
+        uint32_t tableClass = static_cast<uint32_t>(segment[offset]) >> 4;
+        uint32_t index = static_cast<uint32_t>(segment[offset]) & 0xF;
+
+        if (tableClass > 1 || index > 3)
+            throw std::runtime_error("Invalid JPEG file.");
+
+        uint32_t counts[17] = {};
+        uint32_t numSymbols = 0;
+
+        for (uint32_t length = 1; length <= 16; ++length)
+        {
+            counts[length] = static_cast<uint32_t>(segment[offset + length]);
+            numSymbols += counts[length];
+        }
+
+        offset += 17;
+
+        if (numSymbols > 256 || segment.size() - offset < numSymbols)
+            throw std::runtime_error("Invalid JPEG file.");
+
+        HuffmanTable& table = tableClass == 0 ? m_dcTables[index] : m_acTables[index];
+        table = HuffmanTable();
+        table.NumSymbols = numSymbols;
+
+        for (uint32_t i = 0; i < numSymbols; ++i)
+            table.Symbols[i] = static_cast<uint8_t>(segment[offset + i]);
+
+        offset += numSymbols;
+
+        uint32_t code = 0;
+        uint32_t symbol = 0;
+
+        for (uint32_t length = 1; length <= 16; ++length)
+        {
+            table.SymbolOffset[length] = static_cast<int32_t>(symbol) - static_cast<int32_t>(code);
+
+            for (uint32_t i = 0; i < counts[length]; ++i, ++code, ++symbol)
+            {
+                if (length > FAST_BITS)
+                    continue;
+
+                uint32_t first = code << (FAST_BITS - length);
+                uint16_t entry = static_cast<uint16_t>((length << 8) | table.Symbols[symbol]);
+
+                std::fill_n(table.Fast + first, 1u << (FAST_BITS - length), entry);
+            }
+
+            if (code > (1u << length))
+                throw std::runtime_error("Invalid JPEG Huffman table.");
+
+            table.EndCode[length] = code << (16 - length);
+            code <<= 1;
+        }
+
+        table.EndCode[17] = UINT32_MAX;
+
+        for (uint32_t i = 0; i < (1u << FAST_BITS); ++i)
+        {
+            uint32_t length = table.Fast[i] >> 8;
+            uint32_t run = (table.Fast[i] >> 4) & 0xF;
+            uint32_t size = table.Fast[i] & 0xF;
+
+            if (length == 0 || size == 0 || length + size > FAST_BITS)
+                continue;
+
+            uint32_t bits = (i >> (FAST_BITS - length - size)) & ((1u << size) - 1);
+            int32_t value = static_cast<int32_t>(bits);
+
+            if (value < (1 << (size - 1)))
+                value -= (1 << size) - 1;
+
+            table.FastAc[i] = value * 256 + static_cast<int32_t>((run << 4) | (length + size));
+        }
+
+        (tableClass == 0 ? m_hasDcTable : m_hasAcTable)[index] = true;
+    }
+}
+
+void JpegDecoder::ReadQuantTables(std::span<const std::byte> segment)
+{
+    size_t offset = 0;
+
+    while (offset < segment.size())
+    {
+        uint32_t precision = static_cast<uint32_t>(segment[offset]) >> 4;
+        uint32_t index = static_cast<uint32_t>(segment[offset]) & 0xF;
+        size_t valueSize = precision == 0 ? 1 : 2;
+
+        ++offset;
+
+        if (precision > 1 || index > 3 || segment.size() - offset < 64 * valueSize)
+            throw std::runtime_error("Invalid JPEG file.");
+
+        for (uint32_t i = 0; i < 64; ++i)
+        {
+            uint32_t value = valueSize == 1 ? static_cast<uint32_t>(segment[offset + i]) :
+                                              ReadBigEndian16(segment, offset + 2 * i);
+
+            m_quantTables[index][ZIGZAG[i]] = static_cast<uint16_t>(value);
+        }
+
+        offset += 64 * valueSize;
+        m_hasQuantTable[index] = true;
+    }
+}
+
+void JpegDecoder::ReadAdobeSegment(std::span<const std::byte> segment)
+{
+    if (segment.size() < 12 || std::memcmp(segment.data(), "Adobe", 5) != 0)
+        return;
+
+    m_hasAdobe = true;
+    m_adobeTransform = static_cast<uint32_t>(segment[11]);
+}
+
+JpegDecoder::Scan JpegDecoder::ReadScanHeader(std::span<const std::byte> segment)
+{
+    if (segment.empty())
+        throw std::runtime_error("Invalid JPEG file.");
+
+    Scan scan;
+    scan.NumComponents = static_cast<uint32_t>(segment[0]);
+
+    if (scan.NumComponents < 1 || scan.NumComponents > m_numComponents ||
+        segment.size() != 4 + 2 * scan.NumComponents)
+    {
+        throw std::runtime_error("Invalid JPEG file.");
+    }
+
+    for (uint32_t i = 0; i < scan.NumComponents; ++i)
+    {
+        uint32_t id = static_cast<uint32_t>(segment[1 + 2 * i]);
+        uint32_t tables = static_cast<uint32_t>(segment[2 + 2 * i]);
+
+        Component* begin = m_components;
+        Component* end = m_components + m_numComponents;
+        Component* component =
+            std::find_if(begin, end, [id](const Component& c) { return c.Id == id; });
+
+        if (component == end || (tables >> 4) > 3 || (tables & 0xF) > 3)
+            throw std::runtime_error("Invalid JPEG file.");
+
+        scan.Components[i] = static_cast<uint32_t>(component - begin);
+        component->DcTable = tables >> 4;
+        component->AcTable = tables & 0xF;
+    }
+
+    size_t offset = 1 + 2 * scan.NumComponents;
+    scan.SpectralStart = static_cast<uint32_t>(segment[offset]);
+    scan.SpectralEnd = static_cast<uint32_t>(segment[offset + 1]);
+    scan.BitHigh = static_cast<uint32_t>(segment[offset + 2]) >> 4;
+    scan.BitLow = static_cast<uint32_t>(segment[offset + 2]) & 0xF;
+
+    if (m_progressive)
+    {
+        bool isDc = scan.SpectralStart == 0;
+
+        if (scan.SpectralStart > scan.SpectralEnd || scan.SpectralEnd > 63 ||
+            isDc != (scan.SpectralEnd == 0) || (!isDc && scan.NumComponents != 1) ||
+            scan.BitHigh > 13 || scan.BitLow > 13)
+        {
+            throw std::runtime_error("Invalid JPEG file.");
+        }
+    }
+    else
+    {
+        // libjpeg ignores these for sequential scans as well.
+        scan.SpectralStart = 0;
+        scan.SpectralEnd = 63;
+        scan.BitHigh = 0;
+        scan.BitLow = 0;
+    }
+
+    bool needsDc = !m_progressive || (scan.SpectralStart == 0 && scan.BitHigh == 0);
+    bool needsAc = !m_progressive || scan.SpectralStart > 0;
+
+    for (uint32_t i = 0; i < scan.NumComponents; ++i)
+    {
+        Component& component = m_components[scan.Components[i]];
+
+        if ((needsDc && !m_hasDcTable[component.DcTable]) ||
+            (needsAc && !m_hasAcTable[component.AcTable]))
+        {
+            throw std::runtime_error("Invalid JPEG file.");
+        }
+
+        // Like libjpeg, a component keeps the table it started with even if it is redefined.
+        if (!component.HasQuant)
+        {
+            if (!m_hasQuantTable[component.QuantTable])
+                throw std::runtime_error("Invalid JPEG file.");
+
+            std::copy_n(m_quantTables[component.QuantTable], 64, component.Quant);
+            component.HasQuant = true;
+        }
+    }
+
+    return scan;
+}
+
+void JpegDecoder::AllocateComponents()
+{
+    for (uint32_t i = 0; i < m_numComponents; ++i)
+    {
+        Component& component = m_components[i];
+
+        uint32_t blocksPerLine = m_mcusPerLine * component.SamplingX;
+        uint32_t blocksPerColumn = m_mcusPerColumn * component.SamplingY;
+
+        component.PlaneStride = 8 * blocksPerLine;
+        component.Plane.resize(static_cast<size_t>(component.PlaneStride) * 8 * blocksPerColumn);
+        component.UpsampledRow.resize(static_cast<size_t>(component.PlaneStride) *
+                                      component.ScaleX);
+
+        if (m_progressive)
+            component.Coefs.resize(static_cast<size_t>(blocksPerLine) * blocksPerColumn * 64);
+    }
+
+    // libjpeg's rules for telling the color space of three components.
+    if (m_numComponents == 3)
+    {
+        if (m_hasJfif)
+        {
+            m_isRgb = false;
+        }
+        else if (m_hasAdobe)
+        {
+            m_isRgb = m_adobeTransform == 0;
+        }
+        else
+        {
+            m_isRgb = m_components[0].Id == 'R' && m_components[1].Id == 'G' &&
+                m_components[2].Id == 'B';
+        }
+    }
+}
+
+void JpegDecoder::DecodeScan(const Scan& scan)
+{
+    BitReader reader(m_data.subspan(m_offset));
+
+    for (uint32_t i = 0; i < scan.NumComponents; ++i)
+        m_components[scan.Components[i]].DcPredictor = 0;
+
+    m_endOfBandRun = 0;
+
+    // A scan of a single component codes its blocks one by one, leaving out the padding to whole
+    // MCUs. Otherwise each MCU holds the sampling factor's number of blocks of each component.
+    bool interleaved = scan.NumComponents > 1;
+    Component& first = m_components[scan.Components[0]];
+    uint32_t mcusPerLine = interleaved ? m_mcusPerLine : first.BlocksPerLine;
+    uint32_t mcusPerColumn = interleaved ? m_mcusPerColumn : first.BlocksPerColumn;
+
+    // A sequential scan of all components produces rows while it goes, so they are converted
+    // while the samples are still in the cache.
+    bool emitsRows = !m_progressive && scan.NumComponents == m_numComponents;
+
+    uint32_t mcusToRestart = m_restartInterval;
+
+    for (uint32_t mcuY = 0; mcuY < mcusPerColumn; ++mcuY)
+    {
+        for (uint32_t mcuX = 0; mcuX < mcusPerLine; ++mcuX)
+        {
+            if (m_restartInterval != 0)
+            {
+                if (mcusToRestart == 0)
+                {
+                    reader.Restart();
+
+                    for (uint32_t i = 0; i < scan.NumComponents; ++i)
+                        m_components[scan.Components[i]].DcPredictor = 0;
+
+                    m_endOfBandRun = 0;
+                    mcusToRestart = m_restartInterval;
+                }
+
+                --mcusToRestart;
+            }
+
+            if (!interleaved)
+            {
+                DecodeBlock(reader, scan, first, mcuX, mcuY);
+                continue;
+            }
+
+            for (uint32_t i = 0; i < scan.NumComponents; ++i)
+            {
+                Component& component = m_components[scan.Components[i]];
+
+                for (uint32_t y = 0; y < component.SamplingY; ++y)
+                {
+                    for (uint32_t x = 0; x < component.SamplingX; ++x)
+                    {
+                        DecodeBlock(reader, scan, component, mcuX * component.SamplingX + x,
+                                    mcuY * component.SamplingY + y);
+                    }
+                }
+            }
+        }
+
+        if (emitsRows)
+        {
+            for (uint32_t i = 0; i < scan.NumComponents; ++i)
+            {
+                Component& component = m_components[scan.Components[i]];
+                uint32_t rowsPerMcu = 8 * (interleaved ? component.SamplingY : 1);
+
+                component.RowsDone = std::min(component.Height, (mcuY + 1) * rowsPerMcu);
+            }
+
+            EmitRows();
+        }
+    }
+
+    m_offset += reader.GetOffset();
+}
+
+void JpegDecoder::DecodeBlock(BitReader& reader, const Scan& scan, Component& component,
+                              uint32_t blockX, uint32_t blockY)
+{
+    if (!m_progressive)
+    {
+        bool hasAc = DecodeSequentialBlock(reader, component, m_blockCoefs);
+        WriteBlock(component, m_blockCoefs, hasAc, blockX, blockY);
+        return;
+    }
+
+    size_t blockIndex = static_cast<size_t>(blockY) * (component.PlaneStride / 8) + blockX;
+    int16_t* coefs = component.Coefs.data() + 64 * blockIndex;
+
+    if (scan.SpectralStart == 0)
+    {
+        if (scan.BitHigh == 0)
+            DecodeDcFirst(reader, scan, component, coefs);
+        else
+            DecodeDcRefine(reader, scan, coefs);
+    }
+    else
+    {
+        if (scan.BitHigh == 0)
+            DecodeAcFirst(reader, scan, component, coefs);
+        else
+            DecodeAcRefine(reader, scan, component, coefs);
+    }
+}
+
+bool JpegDecoder::DecodeSequentialBlock(BitReader& reader, Component& component, int16_t* coefs)
+{
+    const HuffmanTable& acTable = m_acTables[component.AcTable];
+
+    uint32_t dcSize = reader.DecodeHuffman(m_dcTables[component.DcTable]);
+    component.DcPredictor += reader.ReceiveExtend(dcSize);
+    coefs[0] = static_cast<int16_t>(component.DcPredictor);
+
+    bool hasAc = false;
+
+    for (uint32_t k = 1; k < 64; ++k)
+    {
+        int32_t fast = reader.DecodeFastAc(acTable);
+
+        if (fast != 0)
+        {
+            k += (fast >> 4) & 0xF;
+            coefs[ZIGZAG[k]] = static_cast<int16_t>(fast >> 8);
+            hasAc = true;
+            continue;
+        }
+
+        uint32_t symbol = reader.DecodeHuffman(acTable);
+        uint32_t run = symbol >> 4;
+        uint32_t size = symbol & 0xF;
+
+        if (size == 0)
+        {
+            // Either 16 zeros or the end of the block.
+            if (run != 15)
+                break;
+
+            k += 15;
+            continue;
+        }
+
+        k += run;
+        coefs[ZIGZAG[k]] = static_cast<int16_t>(reader.ReceiveExtend(size));
+        hasAc = true;
+    }
+
+    return hasAc;
+}
+
+void JpegDecoder::DecodeDcFirst(BitReader& reader, const Scan& scan, Component& component,
+                                int16_t* coefs)
+{
+    uint32_t size = reader.DecodeHuffman(m_dcTables[component.DcTable]);
+    component.DcPredictor += reader.ReceiveExtend(size);
+    coefs[0] = static_cast<int16_t>(component.DcPredictor * (1 << scan.BitLow));
+}
+
+void JpegDecoder::DecodeDcRefine(BitReader& reader, const Scan& scan, int16_t* coefs)
+{
+    if (reader.GetBits(1) != 0)
+        coefs[0] = static_cast<int16_t>(coefs[0] | (1 << scan.BitLow));
+}
+
+void JpegDecoder::DecodeAcFirst(BitReader& reader, const Scan& scan, Component& component,
+                                int16_t* coefs)
+{
+    if (m_endOfBandRun > 0)
+    {
+        --m_endOfBandRun;
+        return;
+    }
+
+    const HuffmanTable& table = m_acTables[component.AcTable];
+
+    for (uint32_t k = scan.SpectralStart; k <= scan.SpectralEnd; ++k)
+    {
+        uint32_t symbol = reader.DecodeHuffman(table);
+        uint32_t run = symbol >> 4;
+        uint32_t size = symbol & 0xF;
+
+        if (size != 0)
+        {
+            k += run;
+            coefs[ZIGZAG[k]] =
+                static_cast<int16_t>(reader.ReceiveExtend(size) * (1 << scan.BitLow));
+        }
+        else if (run == 15)
+        {
+            k += 15;
+        }
+        else
+        {
+            // This block and the next 2^run - 1 plus the extra bits are done.
+            m_endOfBandRun = (1u << run) - 1;
+
+            if (run > 0)
+                m_endOfBandRun += reader.GetBits(run);
+
+            break;
+        }
+    }
+}
+
+void JpegDecoder::DecodeAcRefine(BitReader& reader, const Scan& scan, Component& component,
+                                 int16_t* coefs)
+{
+    // Follows decode_mcu_AC_refine of libjpeg. Coefficients that are already nonzero get a
+    // correction bit each time they are passed, new ones are +-1 at the current bit.
+    const int32_t positive = 1 << scan.BitLow;
+    const int32_t negative = -positive;
+
+    auto refine = [&](int16_t& coef) {
+        if (reader.GetBits(1) != 0 && (coef & positive) == 0)
+            coef = static_cast<int16_t>(coef + (coef >= 0 ? positive : negative));
+    };
+
+    uint32_t k = scan.SpectralStart;
+
+    if (m_endOfBandRun == 0)
+    {
+        const HuffmanTable& table = m_acTables[component.AcTable];
+
+        for (; k <= scan.SpectralEnd; ++k)
+        {
+            uint32_t symbol = reader.DecodeHuffman(table);
+            int32_t run = static_cast<int32_t>(symbol >> 4);
+            int32_t value = 0;
+
+            if ((symbol & 0xF) != 0)
+            {
+                value = reader.GetBits(1) != 0 ? positive : negative;
+            }
+            else if (run != 15)
+            {
+                m_endOfBandRun = 1u << run;
+
+                if (run > 0)
+                    m_endOfBandRun += reader.GetBits(static_cast<uint32_t>(run));
+
+                break;
+            }
+
+            // Skips |run| zero coefficients, refining the nonzero ones on the way.
+            do
+            {
+                int16_t& coef = coefs[ZIGZAG[k]];
+
+                if (coef != 0)
+                    refine(coef);
+                else if (--run < 0)
+                    break;
+
+                ++k;
+            } while (k <= scan.SpectralEnd);
+
+            if (value != 0)
+                coefs[ZIGZAG[k]] = static_cast<int16_t>(value);
+        }
+    }
+
+    if (m_endOfBandRun > 0)
+    {
+        for (; k <= scan.SpectralEnd; ++k)
+        {
+            int16_t& coef = coefs[ZIGZAG[k]];
+
+            if (coef != 0)
+                refine(coef);
+        }
+
+        --m_endOfBandRun;
+    }
+}
+
+void JpegDecoder::WriteBlock(Component& component, int16_t* coefs, bool hasAc, uint32_t blockX,
+                             uint32_t blockY)
+{
+    uint8_t* dst = component.Plane.data() +
+        (static_cast<size_t>(blockY) * component.PlaneStride + blockX) * 8;
+
+    if (hasAc)
+    {
+        m_kernels.InverseDct(coefs, component.Quant, dst, component.PlaneStride);
+        std::fill_n(coefs, 64, int16_t(0));
+    }
+    else
+    {
+        uint8_t value = InverseDctDcOnly(coefs[0], component.Quant[0]);
+
+        for (uint32_t y = 0; y < 8; ++y)
+            std::memset(dst + y * component.PlaneStride, value, 8);
+
+        coefs[0] = 0;
+    }
+}
+
+void JpegDecoder::WriteProgressiveBlocks()
+{
+    for (uint32_t i = 0; i < m_numComponents; ++i)
+    {
+        Component& component = m_components[i];
+
+        uint32_t blocksPerLine = component.PlaneStride / 8;
+        uint32_t blocksPerColumn =
+            static_cast<uint32_t>(component.Plane.size() / component.PlaneStride / 8);
+
+        for (uint32_t y = 0; y < blocksPerColumn; ++y)
+        {
+            for (uint32_t x = 0; x < blocksPerLine; ++x)
+            {
+                size_t blockIndex = static_cast<size_t>(y) * blocksPerLine + x;
+                int16_t* coefs = component.Coefs.data() + 64 * blockIndex;
+
+                WriteBlock(component, coefs, HasAcCoefs(coefs), x, y);
+            }
+        }
+    }
+}
+
+void JpegDecoder::EmitRows()
+{
+    // The last source row that output row |y| depends on.
+    auto getLastSourceRow = [](const Component& component, uint32_t y) {
+        uint32_t row = y / component.ScaleY;
+
+        if (component.Upsampling == UpsamplingMode::V2 ||
+            component.Upsampling == UpsamplingMode::H2V2)
+        {
+            if (y % 2 == 1)
+                row = std::min(row + 1, component.Height - 1);
+        }
+
+        return row;
+    };
+
+    for (; m_rowsEmitted < m_height; ++m_rowsEmitted)
+    {
+        uint32_t y = m_rowsEmitted;
+        const uint8_t* rows[3] = {};
+
+        for (uint32_t i = 0; i < m_numComponents; ++i)
+        {
+            if (getLastSourceRow(m_components[i], y) >= m_components[i].RowsDone)
+                return;
+        }
+
+        for (uint32_t i = 0; i < m_numComponents; ++i)
+            rows[i] = GetUpsampledRow(m_components[i], y);
+
+        uint8_t* dst = m_dst + y * m_rowPitch;
+
+        if (m_numComponents == 1)
+        {
+            m_kernels.GrayToRgba(rows[0], dst, m_width);
+        }
+        else if (!m_isRgb)
+        {
+            m_kernels.YCbCrToRgba(rows[0], rows[1], rows[2], dst, m_width);
+        }
+        else
+        {
+            for (uint32_t x = 0; x < m_width; ++x)
+            {
+                dst[4 * x + 0] = rows[0][x];
+                dst[4 * x + 1] = rows[1][x];
+                dst[4 * x + 2] = rows[2][x];
+                dst[4 * x + 3] = 255;
+            }
+        }
+    }
+}
+
+const uint8_t* JpegDecoder::GetUpsampledRow(Component& component, uint32_t y)
+{
+    const uint8_t* plane = component.Plane.data();
+    uint8_t* row = component.UpsampledRow.data();
+    size_t stride = component.PlaneStride;
+
+    switch (component.Upsampling)
+    {
+        case UpsamplingMode::None:
+            return plane + y * stride;
+        case UpsamplingMode::H2:
+            m_kernels.UpsampleH2(plane + y * stride, row, component.Width);
+            return row;
+        case UpsamplingMode::V2:
+        case UpsamplingMode::H2V2:
+        {
+            // Output rows are blended with the source row on their side, with the edge rows
+            // standing in for the missing ones.
+            uint32_t nearRow = y / 2;
+            bool farRowAbove = y % 2 == 0;
+            uint32_t farRow = farRowAbove ? std::max(nearRow, 1u) - 1 :
+                                            std::min(nearRow + 1, component.Height - 1);
+
+            if (component.Upsampling == UpsamplingMode::V2)
+            {
+                m_kernels.UpsampleV2(plane + nearRow * stride, plane + farRow * stride, row,
+                                     component.Width, farRowAbove);
+            }
+            else
+            {
+                m_kernels.UpsampleH2V2(plane + nearRow * stride, plane + farRow * stride, row,
+                                       component.Width);
+            }
+
+            return row;
+        }
+        case UpsamplingMode::Replicate:
+        {
+            const uint8_t* src = plane + (y / component.ScaleY) * stride;
+
+            if (component.ScaleX == 1)
+                return src;
+
+            for (uint32_t x = 0; x < component.Width; ++x)
+                std::memset(row + x * component.ScaleX, src[x], component.ScaleX);
+
+            return row;
+        }
+    }
+
+    return row;
+}
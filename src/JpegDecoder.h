@@ -0,0 +1,182 @@
+#pragma once
+
+#include "ImageDecoder.h"
+
+#include <vector>
+
+// Decodes 8-bit baseline, extended and progressive Huffman-coded JPEG files with one (gray) or
+// three (YCbCr or RGB) components and any integral chroma subsampling. The output matches libjpeg
+// with its default accurate integer IDCT and fancy upsampling.
+class JpegDecoder : public ImageDecoder
+{
+public:
+    JpegDecoder(std::span<const std::byte> data, const PixelKernels& kernels);
+    ~JpegDecoder() override;
+
+    uint32_t GetWidth() const override;
+    uint32_t GetHeight() const override;
+
+    void Decode(uint8_t* dst, size_t rowPitch) override;
+
+    static bool HasSignature(std::span<const std::byte> data);
+
+private:
+    class BitReader;
+
+    struct HuffmanTable
+    {
+        // Code length and symbol of the codes of up to FAST_BITS bits, indexed by the next
+        // FAST_BITS bits of the stream. Zero for longer codes.
+        uint16_t Fast[1 << 9] = {};
+
+        // For AC codes whose value bits fit in the same FAST_BITS: the value times 256, the run
+        // times 16 and the total length. Zero otherwise.
+        int32_t FastAc[1 << 9] = {};
+
+        // One past the last code of each length, left-aligned to 16 bits.
+        uint32_t EndCode[18] = {};
+
+        // Added to a code to get the index of its symbol.
+        int32_t SymbolOffset[17] = {};
+
+        uint8_t Symbols[256] = {};
+        uint32_t NumSymbols = 0;
+    };
+
+    enum class UpsamplingMode
+    {
+        None,
+        H2,
+        V2,
+        H2V2,
+        Replicate
+    };
+
+    struct Component
+    {
+        uint32_t Id = 0;
+        uint32_t SamplingX = 1;
+        uint32_t SamplingY = 1;
+        uint32_t QuantTable = 0;
+
+        // Size in samples, and in blocks as coded in a scan of this component alone.
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+        uint32_t BlocksPerLine = 0;
+        uint32_t BlocksPerColumn = 0;
+
+        // Set by each scan that includes the component.
+        uint32_t DcTable = 0;
+        uint32_t AcTable = 0;
+        int32_t DcPredictor = 0;
+
+        // Copied from the quantization table when the first scan of the component starts.
+        uint16_t Quant[64] = {};
+        bool HasQuant = false;
+
+        // Samples, covering whole MCUs. Rows below RowsDone are complete.
+        std::vector<uint8_t> Plane;
+        uint32_t PlaneStride = 0;
+        uint32_t RowsDone = 0;
+
+        // Coefficients of all blocks covering whole MCUs, in natural order. Only kept for
+        // progressive images.
+        std::vector<int16_t> Coefs;
+
+        UpsamplingMode Upsampling = UpsamplingMode::None;
+        uint32_t ScaleX = 1;
+        uint32_t ScaleY = 1;
+        std::vector<uint8_t> UpsampledRow;
+    };
+
+    struct Scan
+    {
+        uint32_t Components[3] = {};
+        uint32_t NumComponents = 0;
+        uint32_t SpectralStart = 0;
+        uint32_t SpectralEnd = 63;
+        uint32_t BitHigh = 0;
+        uint32_t BitLow = 0;
+    };
+
+    // Handles markers until the frame header, or until the end of the image once decoding.
+    void ReadMarkers(bool untilFrame);
+
+    uint32_t ReadMarker();
+    std::span<const std::byte> ReadSegment();
+
+    void ReadFrameHeader(std::span<const std::byte> segment, bool progressive);
+    void ReadHuffmanTables(std::span<const std::byte> segment);
+    void ReadQuantTables(std::span<const std::byte> segment);
+    void ReadAdobeSegment(std::span<const std::byte> segment);
+    Scan ReadScanHeader(std::span<const std::byte> segment);
+
+    void AllocateComponents();
+
+    void DecodeScan(const Scan& scan);
+    void DecodeBlock(BitReader& reader, const Scan& scan, Component& component, uint32_t blockX,
+                     uint32_t blockY);
+
+    // Returns whether any AC coefficient is set.
+    bool DecodeSequentialBlock(BitReader& reader, Component& component, int16_t* coefs);
+    void DecodeDcFirst(BitReader& reader, const Scan& scan, Component& component, int16_t* coefs);
+    void DecodeDcRefine(BitReader& reader, const Scan& scan, int16_t* coefs);
+    void DecodeAcFirst(BitReader& reader, const Scan& scan, Component& component, int16_t* coefs);
+    void DecodeAcRefine(BitReader& reader, const Scan& scan, Component& component,
+                        int16_t* coefs);
+
+    // Transforms the block to samples and clears it.
+    void WriteBlock(Component& component, int16_t* coefs, bool hasAc, uint32_t blockX,
+                    uint32_t blockY);
+
+    void WriteProgressiveBlocks();
+
+    // Converts the rows that the decoded samples of each component allow.
+    void EmitRows();
+
+    const uint8_t* GetUpsampledRow(Component& component, uint32_t y);
+
+    std::span<const std::byte> m_data;
+    size_t m_offset = 0;
+
+    const PixelKernels& m_kernels;
+
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    bool m_progressive = false;
+
+    Component m_components[3];
+    uint32_t m_numComponents = 0;
+    uint32_t m_maxSamplingX = 1;
+    uint32_t m_maxSamplingY = 1;
+    uint32_t m_mcusPerLine = 0;
+    uint32_t m_mcusPerColumn = 0;
+
+    bool m_hasJfif = false;
+    bool m_hasAdobe = false;
+    uint32_t m_adobeTransform = 0;
+
+    // Whether three components are RGB rather than YCbCr, as told by the segments above or the
+    // component ids.
+    bool m_isRgb = false;
+
+    HuffmanTable m_dcTables[4];
+    HuffmanTable m_acTables[4];
+    bool m_hasDcTable[4] = {};
+    bool m_hasAcTable[4] = {};
+
+    uint16_t m_quantTables[4][64] = {};
+    bool m_hasQuantTable[4] = {};
+
+    uint32_t m_restartInterval = 0;
+
+    // Remaining blocks of a progressive AC scan that are coded as all zero.
+    uint32_t m_endOfBandRun = 0;
+
+    // Sequential blocks are decoded into this, transformed, and cleared again.
+    int16_t m_blockCoefs[64] = {};
+
+    uint8_t* m_dst = nullptr;
+    size_t m_rowPitch = 0;
+    uint32_t m_rowsEmitted = 0;
+};
@@ -0,0 +1,425 @@
+// Benchmark for clustered light assignment. Scatters point and spot lights through a volume the
+// size of a large room, orbits the camera around it and builds the light grid every frame with
+// each supported SIMD level. Checks the grid against brute force - every light tested against
+// every cluster - and checks that points sampled inside each light's reach find that light in
+// their cluster. Exits with an error if any check fails.
+
+#include "BenchmarkUtils.h"
+#include "JobSystem.h"
+#include "LightGrid.h"
+#include "PixelKernels.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <numbers>
+#include <random>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+using benchmark::ElapsedMs;
+
+struct Options
+{
+    std::string OutPath = "light_benchmark_results.json";
+
+    int NumLights = 10000;
+
+    // Fraction of the lights that are spot lights.
+    float SpotFraction = 0.3f;
+
+    int NumTilesX = 16;
+    int NumTilesY = 9;
+    int NumSlices = 24;
+
+    int NumFrames = 200;
+
+    // Frames compared against brute force, spread over the run.
+    int NumCheckedFrames = 3;
+
+    int NumThreads = 0;
+};
+
+constexpr const char* USAGE =
+    "Usage: LightBenchmark [options]\n"
+    "  --lights N          Number of lights (default 10000)\n"
+    "  --spot-fraction F   Fraction of spot lights (default 0.3)\n"
+    "  --tiles-x N         Clusters across the screen (default 16)\n"
+    "  --tiles-y N         Clusters down the screen (default 9)\n"
+    "  --slices N          Depth slices (default 24)\n"
+    "  --frames N          Frames per SIMD level (default 200)\n"
+    "  --checked-frames N  Frames compared against brute force (default 3)\n"
+    "  --threads N         Job system threads, 0 for one per core (default 0)\n"
+    "  --out FILE          Results file (default light_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--lights")
+            options->NumLights = std::stoi(value);
+        else if (arg == "--spot-fraction")
+            options->SpotFraction = std::stof(value);
+        else if (arg == "--tiles-x")
+            options->NumTilesX = std::stoi(value);
+        else if (arg == "--tiles-y")
+            options->NumTilesY = std::stoi(value);
+        else if (arg == "--slices")
+            options->NumSlices = std::stoi(value);
+        else if (arg == "--frames")
+            options->NumFrames = std::stoi(value);
+        else if (arg == "--checked-frames")
+            options->NumCheckedFrames = std::stoi(value);
+        else if (arg == "--threads")
+            options->NumThreads = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->NumLights >= 0 && options->NumTilesX > 0 && options->NumTilesY > 0 &&
+        options->NumSlices > 0 && options->NumFrames > 0 && options->NumCheckedFrames >= 0;
+}
+
+std::vector<Light> CreateLights(const Options& options)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> x(-30.f, 30.f);
+    std::uniform_real_distribution<float> y(0.f, 15.f);
+    std::uniform_real_distribution<float> z(-15.f, 15.f);
+    std::uniform_real_distribution<float> range(0.5f, 4.f);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::uniform_real_distribution<float> coneAngle(0.1f, 1.4f);
+
+    std::vector<Light> lights(options.NumLights);
+
+    for (Light& light : lights)
+    {
+        light.Position = glm::vec3(x(rng), y(rng), z(rng));
+        light.Color = glm::vec3(unit(rng), unit(rng), unit(rng));
+        light.Range = range(rng);
+
+        if (unit(rng) < options.SpotFraction)
+        {
+            light.Type = LightType::Spot;
+            light.Direction = glm::vec3(unit(rng) - 0.5f, -unit(rng), unit(rng) - 0.5f);
+            light.OuterConeAngle = coneAngle(rng);
+        }
+    }
+
+    return lights;
+}
+
+glm::mat4 GetViewMat(int frame, int numFrames)
+{
+    float angle = 2.f * std::numbers::pi_v<float> * static_cast<float>(frame) /
+        static_cast<float>(numFrames);
+
+    glm::vec3 eye(std::cos(angle) * 25.f, 6.f, std::sin(angle) * 12.f);
+
+    return glm::lookAt(eye, glm::vec3(0.f, 4.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
+}
+
+bool IsListed(const LightGrid& grid, uint32_t clusterIdx, uint32_t lightIdx)
+{
+    const LightCluster& cluster = grid.GetClusters()[clusterIdx];
+    std::span<const uint32_t> indices =
+        grid.GetLightIndices().subspan(cluster.Offset, cluster.Count);
+
+    return std::binary_search(indices.begin(), indices.end(), lightIdx);
+}
+
+// Every light against every cluster, with the same test the kernels use.
+bool MatchesBruteForce(const LightGrid& grid, std::span<const Light> lights,
+                       const glm::mat4& viewMat, double* elapsedMs)
+{
+    Clock::time_point start = Clock::now();
+
+    std::vector<LightSphere> spheres;
+
+    for (const Light& light : lights)
+    {
+        spheres.push_back(GetLightSphere(light, viewMat));
+    }
+
+    std::vector<uint32_t> expected;
+    bool matches = true;
+
+    for (uint32_t c = 0; c < grid.GetNumClusters(); ++c)
+    {
+        const ClusterBounds& bounds = grid.GetClusterBounds(c);
+
+        expected.clear();
+
+        for (uint32_t i = 0; i < spheres.size(); ++i)
+        {
+            const LightSphere& sphere = spheres[i];
+
+            if (SphereIntersectsBounds(sphere.Center.x, sphere.Center.y, sphere.Center.z,
+                                       sphere.Radius * sphere.Radius, bounds))
+            {
+                expected.push_back(i);
+            }
+        }
+
+        const LightCluster& cluster = grid.GetClusters()[c];
+        std::span<const uint32_t> actual =
+            grid.GetLightIndices().subspan(cluster.Offset, cluster.Count);
+
+        matches = matches && std::equal(actual.begin(), actual.end(), expected.begin(),
+                                        expected.end());
+    }
+
+    *elapsedMs = ElapsedMs(start);
+
+    return matches;
+}
+
+// A random point that |light| reaches, away from the edge of its volume.
+glm::vec3 SamplePointInLight(const Light& light, std::mt19937* rng)
+{
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    float distance = light.Range * 0.98f * std::cbrt(unit(*rng));
+    float phi = 2.f * std::numbers::pi_v<float> * unit(*rng);
+
+    // Uniform over the sphere, or over the cone for spot lights.
+    float minCosTheta = -1.f;
+    glm::vec3 axis(0.f, 0.f, 1.f);
+
+    if (light.Type == LightType::Spot)
+    {
+        minCosTheta = std::cos(light.OuterConeAngle * 0.98f);
+        axis = glm::normalize(light.Direction);
+    }
+
+    float cosTheta = minCosTheta + (1.f - minCosTheta) * unit(*rng);
+    float sinTheta = std::sqrt(std::max(0.f, 1.f - cosTheta * cosTheta));
+
+    glm::vec3 tangent = glm::normalize(glm::cross(axis, std::abs(axis.x) < 0.9f ?
+                                                             glm::vec3(1.f, 0.f, 0.f) :
+                                                             glm::vec3(0.f, 1.f, 0.f)));
+    glm::vec3 bitangent = glm::cross(axis, tangent);
+
+    glm::vec3 direction = axis * cosTheta +
+        (tangent * std::cos(phi) + bitangent * std::sin(phi)) * sinTheta;
+
+    return light.Position + direction * distance;
+}
+
+// Samples points that lights reach, checks that they are inside the light's bounding sphere, and
+// that the light is listed in the cluster a shader would find from the pixel and its depth. This
+// covers the light bounds, the cluster geometry and the slice parameters, which brute force
+// shares with the grid.
+void CheckSampledPoints(const LightGrid& grid, std::span<const Light> lights,
+                        const glm::mat4& viewMat, bool* spheresBound, bool* lightsListed,
+                        int* numSamplesInView)
+{
+    const LightGridDesc& desc = grid.GetDesc();
+
+    float tanHalfFovY = std::tan(desc.FovY * 0.5f);
+    float tanHalfFovX = tanHalfFovY * desc.AspectRatio;
+
+    float sliceScale = 0.f;
+    float sliceBias = 0.f;
+    grid.GetSliceParams(&sliceScale, &sliceBias);
+
+    std::mt19937 rng(5678);
+    std::uniform_int_distribution<size_t> lightDist(0, lights.size() - 1);
+
+    constexpr int numSamples = 100000;
+
+    for (int i = 0; i < numSamples && !lights.empty(); ++i)
+    {
+        auto lightIdx = static_cast<uint32_t>(lightDist(rng));
+
+        glm::vec3 worldPos = SamplePointInLight(lights[lightIdx], &rng);
+        glm::vec3 viewPos = glm::vec3(viewMat * glm::vec4(worldPos, 1.f));
+
+        LightSphere sphere = GetLightSphere(lights[lightIdx], viewMat);
+        glm::vec3 offset = viewPos - sphere.Center;
+
+        if (glm::length(offset) > sphere.Radius * 1.0001f)
+            *spheresBound = false;
+
+        float depth = viewPos.z;
+        float ndcX = viewPos.x / (depth * tanHalfFovX);
+        float ndcY = viewPos.y / (depth * tanHalfFovY);
+
+        if (depth <= desc.NearZ || depth >= desc.FarZ || std::abs(ndcX) >= 1.f ||
+            std::abs(ndcY) >= 1.f)
+        {
+            continue;
+        }
+
+        ++*numSamplesInView;
+
+        auto tileX = static_cast<uint32_t>((ndcX + 1.f) * 0.5f *
+                                           static_cast<float>(desc.NumTilesX));
+        auto tileY = static_cast<uint32_t>((1.f - ndcY) * 0.5f *
+                                           static_cast<float>(desc.NumTilesY));
+        float slice = std::floor(std::log(depth) * sliceScale + sliceBias);
+
+        tileX = std::min(tileX, desc.NumTilesX - 1);
+        tileY = std::min(tileY, desc.NumTilesY - 1);
+        auto sliceIdx = static_cast<uint32_t>(std::clamp(slice, 0.f,
+                                                         static_cast<float>(desc.NumSlices - 1)));
+
+        if (!IsListed(grid, grid.GetClusterIndex(tileX, tileY, sliceIdx), lightIdx))
+            *lightsListed = false;
+    }
+}
+
+json RunLevel(const Options& options, JobSystem* jobSystem, SimdLevel level,
+              std::span<const Light> lights, Checks* checks)
+{
+    LightGrid grid(jobSystem, level);
+
+    LightGridDesc desc{};
+    desc.NumTilesX = static_cast<uint32_t>(options.NumTilesX);
+    desc.NumTilesY = static_cast<uint32_t>(options.NumTilesY);
+    desc.NumSlices = static_cast<uint32_t>(options.NumSlices);
+    desc.FovY = std::numbers::pi_v<float> / 4.f;
+    desc.AspectRatio = 16.f / 9.f;
+    desc.NearZ = 0.1f;
+    desc.FarZ = 200.f;
+    grid.SetDesc(desc);
+
+    std::string prefix = std::string(GetSimdLevelName(level)) + "_";
+
+    // Warm up the scratch buffers.
+    grid.Build(lights, GetViewMat(0, options.NumFrames));
+
+    std::vector<double> buildMs;
+
+    bool matchesBruteForce = true;
+    bool spheresBound = true;
+    bool lightsListed = true;
+    int numSamplesInView = 0;
+
+    double bruteForceMs = 0.0;
+    uint64_t numIndices = 0;
+    uint32_t maxPerCluster = 0;
+    uint64_t numLitClusters = 0;
+
+    int checkInterval = std::max(1, options.NumFrames / std::max(1, options.NumCheckedFrames));
+
+    for (int frame = 0; frame < options.NumFrames; ++frame)
+    {
+        glm::mat4 viewMat = GetViewMat(frame, options.NumFrames);
+
+        Clock::time_point start = Clock::now();
+        grid.Build(lights, viewMat);
+        buildMs.push_back(ElapsedMs(start));
+
+        numIndices += grid.GetLightIndices().size();
+
+        for (const LightCluster& cluster : grid.GetClusters())
+        {
+            maxPerCluster = std::max(maxPerCluster, cluster.Count);
+            numLitClusters += cluster.Count > 0;
+        }
+
+        if (frame % checkInterval == 0 && frame / checkInterval < options.NumCheckedFrames)
+        {
+            double elapsedMs = 0.0;
+            matchesBruteForce = matchesBruteForce &&
+                MatchesBruteForce(grid, lights, viewMat, &elapsedMs);
+            bruteForceMs = std::max(bruteForceMs, elapsedMs);
+
+            CheckSampledPoints(grid, lights, viewMat, &spheresBound, &lightsListed,
+                               &numSamplesInView);
+        }
+    }
+
+    checks->Check(prefix + "matches_brute_force", matchesBruteForce);
+    checks->Check(prefix + "light_spheres_bound_lights", spheresBound);
+    checks->Check(prefix + "reaching_lights_listed", lightsListed);
+
+    std::sort(buildMs.begin(), buildMs.end());
+
+    double numFrames = static_cast<double>(options.NumFrames);
+    double numClusters = static_cast<double>(grid.GetNumClusters());
+
+    double meanMs = 0.0;
+
+    for (double ms : buildMs)
+    {
+        meanMs += ms / numFrames;
+    }
+
+    return {
+        {"build_ms_mean", meanMs},
+        {"build_ms_p50", buildMs[buildMs.size() / 2]},
+        {"build_ms_max", buildMs.back()},
+        {"brute_force_ms", bruteForceMs},
+        {"sampled_points_in_view", numSamplesInView},
+        {"lights_per_cluster_mean", static_cast<double>(numIndices) / numFrames / numClusters},
+        {"lights_per_cluster_max", maxPerCluster},
+        {"lit_cluster_fraction", static_cast<double>(numLitClusters) / numFrames / numClusters}
+    };
+}
+
+int RunBenchmark(const Options& options)
+{
+    JobSystem jobSystem(options.NumThreads);
+
+    std::vector<Light> lights = CreateLights(options);
+
+    Checks checks;
+    json levels = json::object();
+
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2, SimdLevel::Neon})
+    {
+        if (IsSimdLevelSupported(level))
+            levels[GetSimdLevelName(level)] = RunLevel(options, &jobSystem, level, lights, &checks);
+    }
+
+    json results = {
+        {"lights", options.NumLights},
+        {"spot_fraction", options.SpotFraction},
+        {"grid", {options.NumTilesX, options.NumTilesY, options.NumSlices}},
+        {"frames", options.NumFrames},
+        {"threads", jobSystem.GetThreadCount()},
+        {"selected_level", GetSimdLevelName(LightGrid(&jobSystem).GetSimdLevel())},
+        {"levels", levels},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Light grid checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
@@ -0,0 +1,492 @@
+#include "LightGrid.h"
+
+#include "Profiler.h"
+#include "Simd.h"
+
+#include <bit>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+
+namespace
+{
+
+// Spheres are processed this many at a time by the widest kernel, and sets are padded to it.
+constexpr size_t maxSimdWidth = 8;
+
+constexpr size_t minLightsPerJob = 1024;
+
+size_t CullSpheresScalar(const float* x, const float* y, const float* z, const float* radiusSq,
+                         size_t count, const ClusterBounds& bounds, uint32_t* outSlots)
+{
+    size_t numPassed = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (SphereIntersectsBounds(x[i], y[i], z[i], radiusSq[i], bounds))
+            outSlots[numPassed++] = static_cast<uint32_t>(i);
+    }
+
+    return numPassed;
+}
+
+// Appends |base| plus the index of every set bit of |mask|.
+inline size_t AppendSlots(uint32_t mask, size_t base, uint32_t* outSlots, size_t numPassed)
+{
+    while (mask)
+    {
+        outSlots[numPassed++] = static_cast<uint32_t>(base) + std::countr_zero(mask);
+        mask &= mask - 1;
+    }
+
+    return numPassed;
+}
+
+#if defined(GRFX_SIMD_X86)
+
+TARGET_SSE41 __m128 AxisDistanceSse41(__m128 p, __m128 boundsMin, __m128 boundsMax)
+{
+    return _mm_max_ps(_mm_max_ps(_mm_sub_ps(boundsMin, p), _mm_setzero_ps()),
+                      _mm_sub_ps(p, boundsMax));
+}
+
+TARGET_SSE41 size_t CullSpheresSse41(const float* x, const float* y, const float* z,
+                                     const float* radiusSq, size_t count,
+                                     const ClusterBounds& bounds, uint32_t* outSlots)
+{
+    const __m128 minX = _mm_set1_ps(bounds.Min.x);
+    const __m128 minY = _mm_set1_ps(bounds.Min.y);
+    const __m128 minZ = _mm_set1_ps(bounds.Min.z);
+    const __m128 maxX = _mm_set1_ps(bounds.Max.x);
+    const __m128 maxY = _mm_set1_ps(bounds.Max.y);
+    const __m128 maxZ = _mm_set1_ps(bounds.Max.z);
+
+    size_t numPassed = 0;
+
+    for (size_t i = 0; i < count; i += 4)
+    {
+        __m128 dx = AxisDistanceSse41(_mm_loadu_ps(x + i), minX, maxX);
+        __m128 dy = AxisDistanceSse41(_mm_loadu_ps(y + i), minY, maxY);
+        __m128 dz = AxisDistanceSse41(_mm_loadu_ps(z + i), minZ, maxZ);
+
+        __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                                   _mm_mul_ps(dz, dz));
+
+        __m128 passed = _mm_cmple_ps(distSq, _mm_loadu_ps(radiusSq + i));
+
+        numPassed = AppendSlots(static_cast<uint32_t>(_mm_movemask_ps(passed)), i, outSlots,
+                                numPassed);
+    }
+
+    return numPassed;
+}
+
+TARGET_AVX2 __m256 AxisDistanceAvx2(__m256 p, __m256 boundsMin, __m256 boundsMax)
+{
+    return _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(boundsMin, p), _mm256_setzero_ps()),
+                         _mm256_sub_ps(p, boundsMax));
+}
+
+TARGET_AVX2 size_t CullSpheresAvx2(const float* x, const float* y, const float* z,
+                                   const float* radiusSq, size_t count,
+                                   const ClusterBounds& bounds, uint32_t* outSlots)
+{
+    const __m256 minX = _mm256_set1_ps(bounds.Min.x);
+    const __m256 minY = _mm256_set1_ps(bounds.Min.y);
+    const __m256 minZ = _mm256_set1_ps(bounds.Min.z);
+    const __m256 maxX = _mm256_set1_ps(bounds.Max.x);
+    const __m256 maxY = _mm256_set1_ps(bounds.Max.y);
+    const __m256 maxZ = _mm256_set1_ps(bounds.Max.z);
+
+    size_t numPassed = 0;
+
+    for (size_t i = 0; i < count; i += 8)
+    {
+        __m256 dx = AxisDistanceAvx2(_mm256_loadu_ps(x + i), minX, maxX);
+        __m256 dy = AxisDistanceAvx2(_mm256_loadu_ps(y + i), minY, maxY);
+        __m256 dz = AxisDistanceAvx2(_mm256_loadu_ps(z + i), minZ, maxZ);
+
+        __m256 distSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+                                      _mm256_mul_ps(dz, dz));
+
+        __m256 passed = _mm256_cmp_ps(distSq, _mm256_loadu_ps(radiusSq + i), _CMP_LE_OQ);
+
+        numPassed = AppendSlots(static_cast<uint32_t>(_mm256_movemask_ps(passed)), i, outSlots,
+                                numPassed);
+    }
+
+    return numPassed;
+}
+
+#elif defined(GRFX_SIMD_NEON)
+
+float32x4_t AxisDistanceNeon(float32x4_t p, float32x4_t boundsMin, float32x4_t boundsMax)
+{
+    return vmaxq_f32(vmaxq_f32(vsubq_f32(boundsMin, p), vdupq_n_f32(0.f)),
+                     vsubq_f32(p, boundsMax));
+}
+
+size_t CullSpheresNeon(const float* x, const float* y, const float* z, const float* radiusSq,
+                       size_t count, const ClusterBounds& bounds, uint32_t* outSlots)
+{
+    const float32x4_t minX = vdupq_n_f32(bounds.Min.x);
+    const float32x4_t minY = vdupq_n_f32(bounds.Min.y);
+    const float32x4_t minZ = vdupq_n_f32(bounds.Min.z);
+    const float32x4_t maxX = vdupq_n_f32(bounds.Max.x);
+    const float32x4_t maxY = vdupq_n_f32(bounds.Max.y);
+    const float32x4_t maxZ = vdupq_n_f32(bounds.Max.z);
+
+    static const uint32_t laneBits[4] = {1, 2, 4, 8};
+    const uint32x4_t bits = vld1q_u32(laneBits);
+
+    size_t numPassed = 0;
+
+    for (size_t i = 0; i < count; i += 4)
+    {
+        float32x4_t dx = AxisDistanceNeon(vld1q_f32(x + i), minX, maxX);
+        float32x4_t dy = AxisDistanceNeon(vld1q_f32(y + i), minY, maxY);
+        float32x4_t dz = AxisDistanceNeon(vld1q_f32(z + i), minZ, maxZ);
+
+        float32x4_t distSq = vaddq_f32(vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy)),
+                                       vmulq_f32(dz, dz));
+
+        uint32x4_t passed = vcleq_f32(distSq, vld1q_f32(radiusSq + i));
+
+        numPassed = AppendSlots(vaddvq_u32(vandq_u32(passed, bits)), i, outSlots, numPassed);
+    }
+
+    return numPassed;
+}
+
+#endif
+
+} // namespace
+
+LightSphere GetLightSphere(const Light& light, const glm::mat4& viewMat)
+{
+    LightSphere sphere{};
+    glm::vec3 center = light.Position;
+    sphere.Radius = light.Range;
+
+    float angle = light.OuterConeAngle;
+
+    // The smallest sphere around the cone. Wide cones are bounded by the circle at their end, and
+    // narrow ones by the sphere through that circle and the apex.
+    if (light.Type == LightType::Spot && angle < std::numbers::pi_v<float> / 2.f)
+    {
+        glm::vec3 direction = glm::normalize(light.Direction);
+
+        if (angle > std::numbers::pi_v<float> / 4.f)
+        {
+            center += direction * (light.Range * std::cos(angle));
+            sphere.Radius = light.Range * std::sin(angle);
+        }
+        else
+        {
+            sphere.Radius = light.Range / (2.f * std::cos(angle));
+            center += direction * sphere.Radius;
+        }
+    }
+
+    sphere.Center = glm::vec3(viewMat * glm::vec4(center, 1.f));
+
+    return sphere;
+}
+
+void LightGrid::SphereSet::Resize(size_t count)
+{
+    Count = count;
+
+    size_t paddedCount = (count + maxSimdWidth - 1) / maxSimdWidth * maxSimdWidth;
+
+    X.resize(paddedCount);
+    Y.resize(paddedCount);
+    Z.resize(paddedCount);
+    RadiusSq.resize(paddedCount);
+    LightIdx.resize(paddedCount);
+
+    for (size_t i = count; i < paddedCount; ++i)
+    {
+        X[i] = 0.f;
+        Y[i] = 0.f;
+        Z[i] = 0.f;
+        RadiusSq[i] = -1.f;
+        LightIdx[i] = 0;
+    }
+}
+
+void LightGrid::SphereSet::Set(size_t slot, const LightSphere& sphere, uint32_t lightIdx)
+{
+    X[slot] = sphere.Center.x;
+    Y[slot] = sphere.Center.y;
+    Z[slot] = sphere.Center.z;
+    RadiusSq[slot] = sphere.Radius * sphere.Radius;
+    LightIdx[slot] = lightIdx;
+}
+
+void LightGrid::SphereSet::Gather(const SphereSet& src, std::span<const uint32_t> slots)
+{
+    Resize(slots.size());
+
+    for (size_t i = 0; i < slots.size(); ++i)
+    {
+        uint32_t slot = slots[i];
+
+        X[i] = src.X[slot];
+        Y[i] = src.Y[slot];
+        Z[i] = src.Z[slot];
+        RadiusSq[i] = src.RadiusSq[slot];
+        LightIdx[i] = src.LightIdx[slot];
+    }
+}
+
+LightGrid::LightGrid(JobSystem* jobSystem)
+    : LightGrid(jobSystem, GetPixelKernels().Level)
+{
+}
+
+LightGrid::LightGrid(JobSystem* jobSystem, SimdLevel level)
+    : m_jobSystem(jobSystem), m_simdLevel(level), m_cullSpheres(CullSpheresScalar)
+{
+    if (!IsSimdLevelSupported(level))
+        throw std::runtime_error("SIMD level not supported.");
+
+    switch (level)
+    {
+#if defined(GRFX_SIMD_X86)
+        case SimdLevel::Sse41:
+            m_cullSpheres = CullSpheresSse41;
+            break;
+        case SimdLevel::Avx2:
+            m_cullSpheres = CullSpheresAvx2;
+            break;
+#elif defined(GRFX_SIMD_NEON)
+        case SimdLevel::Neon:
+            m_cullSpheres = CullSpheresNeon;
+            break;
+#endif
+        default:
+            break;
+    }
+
+    SetDesc(LightGridDesc{});
+}
+
+void LightGrid::SetDesc(const LightGridDesc& desc)
+{
+    if (desc.NumTilesX == 0 || desc.NumTilesY == 0 || desc.NumSlices == 0 || desc.NearZ <= 0.f ||
+        desc.FarZ <= desc.NearZ)
+    {
+        throw std::runtime_error("Invalid light grid description.");
+    }
+
+    m_desc = desc;
+
+    float tanHalfFovY = std::tan(desc.FovY * 0.5f);
+    float tanHalfFovX = tanHalfFovY * desc.AspectRatio;
+
+    m_clusterBounds.resize(static_cast<size_t>(desc.NumTilesX) * desc.NumTilesY * desc.NumSlices);
+    m_rowBounds.resize(static_cast<size_t>(desc.NumTilesY) * desc.NumSlices);
+    m_sliceBounds.resize(desc.NumSlices);
+
+    for (uint32_t slice = 0; slice < desc.NumSlices; ++slice)
+    {
+        float nearDepth = desc.NearZ * std::pow(desc.FarZ / desc.NearZ,
+                                                static_cast<float>(slice) /
+                                                    static_cast<float>(desc.NumSlices));
+        float farDepth = desc.NearZ * std::pow(desc.FarZ / desc.NearZ,
+                                               static_cast<float>(slice + 1) /
+                                                   static_cast<float>(desc.NumSlices));
+
+        ClusterBounds& sliceBounds = m_sliceBounds[slice];
+
+        for (uint32_t y = 0; y < desc.NumTilesY; ++y)
+        {
+            // Rows go down the screen, i.e. towards -y.
+            float ndcBottom = 1.f - 2.f * static_cast<float>(y + 1) /
+                static_cast<float>(desc.NumTilesY);
+            float ndcTop = 1.f - 2.f * static_cast<float>(y) / static_cast<float>(desc.NumTilesY);
+
+            ClusterBounds& rowBounds = m_rowBounds[slice * desc.NumTilesY + y];
+
+            for (uint32_t x = 0; x < desc.NumTilesX; ++x)
+            {
+                float ndcLeft = -1.f + 2.f * static_cast<float>(x) /
+                    static_cast<float>(desc.NumTilesX);
+                float ndcRight = -1.f + 2.f * static_cast<float>(x + 1) /
+                    static_cast<float>(desc.NumTilesX);
+
+                // The tile's edges fan out from the camera, so each extreme is at either the near
+                // or the far end of the slice.
+                ClusterBounds bounds{};
+                bounds.Min.x = std::min(ndcLeft * nearDepth, ndcLeft * farDepth) * tanHalfFovX;
+                bounds.Max.x = std::max(ndcRight * nearDepth, ndcRight * farDepth) * tanHalfFovX;
+                bounds.Min.y = std::min(ndcBottom * nearDepth, ndcBottom * farDepth) * tanHalfFovY;
+                bounds.Max.y = std::max(ndcTop * nearDepth, ndcTop * farDepth) * tanHalfFovY;
+                bounds.Min.z = nearDepth;
+                bounds.Max.z = farDepth;
+
+                m_clusterBounds[GetClusterIndex(x, y, slice)] = bounds;
+
+                // Rows and slices bound their clusters, so nothing culled by them could have
+                // intersected a cluster.
+                if (x == 0)
+                {
+                    rowBounds = bounds;
+                }
+                else
+                {
+                    rowBounds.Min = glm::min(rowBounds.Min, bounds.Min);
+                    rowBounds.Max = glm::max(rowBounds.Max, bounds.Max);
+                }
+            }
+
+            if (y == 0)
+            {
+                sliceBounds = rowBounds;
+            }
+            else
+            {
+                sliceBounds.Min = glm::min(sliceBounds.Min, rowBounds.Min);
+                sliceBounds.Max = glm::max(sliceBounds.Max, rowBounds.Max);
+            }
+        }
+    }
+
+    m_slices.resize(desc.NumSlices);
+
+    m_clusters.assign(m_clusterBounds.size(), LightCluster{});
+    m_lightIndices.clear();
+}
+
+const LightGridDesc& LightGrid::GetDesc() const
+{
+    return m_desc;
+}
+
+SimdLevel LightGrid::GetSimdLevel() const
+{
+    return m_simdLevel;
+}
+
+void LightGrid::Build(std::span<const Light> lights, const glm::mat4& viewMat)
+{
+    PROFILE_SCOPE("LightGrid::Build");
+
+    m_spheres.Resize(lights.size());
+
+    m_jobSystem->ParallelFor(lights.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            m_spheres.Set(i, GetLightSphere(lights[i], viewMat), static_cast<uint32_t>(i));
+        }
+    }, minLightsPerJob);
+
+    m_jobSystem->ParallelFor(m_desc.NumSlices, [this](size_t begin, size_t end) {
+        for (size_t slice = begin; slice < end; ++slice)
+        {
+            BuildSlice(static_cast<uint32_t>(slice));
+        }
+    });
+
+    // Slices built their lists separately, so they are joined into one array here, with the
+    // cluster offsets moved along accordingly.
+    std::vector<uint32_t> sliceOffsets(m_desc.NumSlices);
+    size_t numIndices = 0;
+
+    for (uint32_t slice = 0; slice < m_desc.NumSlices; ++slice)
+    {
+        sliceOffsets[slice] = static_cast<uint32_t>(numIndices);
+        numIndices += m_slices[slice].LightIndices.size();
+    }
+
+    m_lightIndices.resize(numIndices);
+
+    size_t clustersPerSlice = static_cast<size_t>(m_desc.NumTilesX) * m_desc.NumTilesY;
+
+    m_jobSystem->ParallelFor(m_desc.NumSlices, [&](size_t begin, size_t end) {
+        for (size_t slice = begin; slice < end; ++slice)
+        {
+            const std::vector<uint32_t>& sliceIndices = m_slices[slice].LightIndices;
+            std::copy(sliceIndices.begin(), sliceIndices.end(),
+                      m_lightIndices.begin() + sliceOffsets[slice]);
+
+            for (size_t i = 0; i < clustersPerSlice; ++i)
+            {
+                m_clusters[slice * clustersPerSlice + i].Offset += sliceOffsets[slice];
+            }
+        }
+    });
+}
+
+size_t LightGrid::GetNumClusters() const
+{
+    return m_clusters.size();
+}
+
+const ClusterBounds& LightGrid::GetClusterBounds(uint32_t clusterIdx) const
+{
+    return m_clusterBounds[clusterIdx];
+}
+
+std::span<const LightCluster> LightGrid::GetClusters() const
+{
+    return m_clusters;
+}
+
+std::span<const uint32_t> LightGrid::GetLightIndices() const
+{
+    return m_lightIndices;
+}
+
+void LightGrid::GetSliceParams(float* scale, float* bias) const
+{
+    *scale = static_cast<float>(m_desc.NumSlices) / std::log(m_desc.FarZ / m_desc.NearZ);
+    *bias = -std::log(m_desc.NearZ) * *scale;
+}
+
+size_t LightGrid::CullSpheres(const SphereSet& spheres, const ClusterBounds& bounds,
+                              uint32_t* outSlots) const
+{
+    // The padding never passes, so the kernels can run over whole SIMD widths.
+    return m_cullSpheres(spheres.X.data(), spheres.Y.data(), spheres.Z.data(),
+                         spheres.RadiusSq.data(), spheres.X.size(), bounds, outSlots);
+}
+
+void LightGrid::BuildSlice(uint32_t slice)
+{
+    SliceScratch& scratch = m_slices[slice];
+
+    scratch.Slots.resize(m_spheres.X.size());
+    scratch.LightIndices.clear();
+
+    size_t numInSlice = CullSpheres(m_spheres, m_sliceBounds[slice], scratch.Slots.data());
+    scratch.SliceSpheres.Gather(m_spheres, std::span(scratch.Slots.data(), numInSlice));
+
+    for (uint32_t y = 0; y < m_desc.NumTilesY; ++y)
+    {
+        size_t numInRow = CullSpheres(scratch.SliceSpheres,
+                                      m_rowBounds[slice * m_desc.NumTilesY + y],
+                                      scratch.Slots.data());
+        scratch.RowSpheres.Gather(scratch.SliceSpheres,
+                                  std::span(scratch.Slots.data(), numInRow));
+
+        for (uint32_t x = 0; x < m_desc.NumTilesX; ++x)
+        {
+            uint32_t clusterIdx = GetClusterIndex(x, y, slice);
+
+            size_t numInCluster = CullSpheres(scratch.RowSpheres, m_clusterBounds[clusterIdx],
+                                              scratch.Slots.data());
+
+            // Relative to the slice until Build() joins the slices.
+            LightCluster& cluster = m_clusters[clusterIdx];
+            cluster.Offset = static_cast<uint32_t>(scratch.LightIndices.size());
+            cluster.Count = static_cast<uint32_t>(numInCluster);
+
+            for (size_t i = 0; i < numInCluster; ++i)
+            {
+                scratch.LightIndices.push_back(scratch.RowSpheres.LightIdx[scratch.Slots[i]]);
+            }
+        }
+    }
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "PixelKernels.h"
+#include "Scene.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Lights and clusters are tested in view space, which is left-handed: z is the distance in front
+// of the camera.
+struct LightSphere
+{
+    glm::vec3 Center = glm::vec3(0.f);
+    float Radius = 0.f;
+};
+
+struct ClusterBounds
+{
+    glm::vec3 Min = glm::vec3(0.f);
+    glm::vec3 Max = glm::vec3(0.f);
+};
+
+// Bounding sphere of the volume a light reaches, in the space above.
+LightSphere GetLightSphere(const Light& light, const glm::mat4& viewMat);
+
+// The test every culling kernel performs. The SIMD versions evaluate exactly these operations, so
+// they agree with it bit for bit.
+inline bool SphereIntersectsBounds(float x, float y, float z, float radiusSq,
+                                   const ClusterBounds& bounds)
+{
+    float dx = std::max(std::max(bounds.Min.x - x, 0.f), x - bounds.Max.x);
+    float dy = std::max(std::max(bounds.Min.y - y, 0.f), y - bounds.Max.y);
+    float dz = std::max(std::max(bounds.Min.z - z, 0.f), z - bounds.Max.z);
+
+    return dx * dx + dy * dy + dz * dz <= radiusSq;
+}
+
+struct LightGridDesc
+{
+    uint32_t NumTilesX = 16;
+    uint32_t NumTilesY = 9;
+    uint32_t NumSlices = 24;
+
+    // Vertical field of view in radians, as passed to glm::perspective().
+    float FovY = 0.785398f;
+    float AspectRatio = 16.f / 9.f;
+
+    float NearZ = 0.1f;
+    float FarZ = 1000.f;
+};
+
+// Range of LightGrid::GetLightIndices() that reaches one cluster. Laid out for uploading as is.
+struct LightCluster
+{
+    uint32_t Offset = 0;
+    uint32_t Count = 0;
+};
+
+// Assigns lights to the clusters of a grid over the view frustum: screen tiles, split into slices
+// whose depth grows exponentially so that clusters stay roughly cubic. Tile (0, 0) is the top
+// left of the screen. Each slice is culled on its own job, testing the light bounding spheres
+// against the slice, then each row of tiles, then each cluster, several lights at a time.
+class LightGrid
+{
+public:
+    // Uses the fastest kernels the CPU supports unless |level| is given.
+    explicit LightGrid(JobSystem* jobSystem);
+    LightGrid(JobSystem* jobSystem, SimdLevel level);
+
+    void SetDesc(const LightGridDesc& desc);
+
+    const LightGridDesc& GetDesc() const;
+
+    SimdLevel GetSimdLevel() const;
+
+    void Build(std::span<const Light> lights, const glm::mat4& viewMat);
+
+    uint32_t GetClusterIndex(uint32_t tileX, uint32_t tileY, uint32_t slice) const
+    {
+        return (slice * m_desc.NumTilesY + tileY) * m_desc.NumTilesX + tileX;
+    }
+
+    size_t GetNumClusters() const;
+
+    const ClusterBounds& GetClusterBounds(uint32_t clusterIdx) const;
+
+    // Valid after Build(). Within a cluster, light indices are in increasing order.
+    std::span<const LightCluster> GetClusters() const;
+    std::span<const uint32_t> GetLightIndices() const;
+
+    // The slice of a point |depth| in front of the camera is floor(log(depth) * scale + bias).
+    void GetSliceParams(float* scale, float* bias) const;
+
+private:
+    // Light spheres, structure of arrays. Padded to a multiple of the widest SIMD width with
+    // spheres that intersect nothing.
+    struct SphereSet
+    {
+        std::vector<float> X;
+        std::vector<float> Y;
+        std::vector<float> Z;
+        std::vector<float> RadiusSq;
+        std::vector<uint32_t> LightIdx;
+
+        size_t Count = 0;
+
+        void Resize(size_t count);
+        void Set(size_t slot, const LightSphere& sphere, uint32_t lightIdx);
+
+        // Copies the spheres at |slots| of |src|.
+        void Gather(const SphereSet& src, std::span<const uint32_t> slots);
+    };
+
+    struct SliceScratch
+    {
+        SphereSet SliceSpheres;
+        SphereSet RowSpheres;
+
+        std::vector<uint32_t> Slots;
+
+        // Light indices of the slice's clusters, in cluster order.
+        std::vector<uint32_t> LightIndices;
+    };
+
+    using CullSpheresFn = size_t (*)(const float* x, const float* y, const float* z,
+                                     const float* radiusSq, size_t count,
+                                     const ClusterBounds& bounds, uint32_t* outSlots);
+
+    size_t CullSpheres(const SphereSet& spheres, const ClusterBounds& bounds,
+                       uint32_t* outSlots) const;
+
+    void BuildSlice(uint32_t slice);
+
+    JobSystem* m_jobSystem;
+
+    SimdLevel m_simdLevel;
+    CullSpheresFn m_cullSpheres;
+
+    LightGridDesc m_desc;
+
+    std::vector<ClusterBounds> m_clusterBounds;
+    std::vector<ClusterBounds> m_rowBounds;
+    std::vector<ClusterBounds> m_sliceBounds;
+
+    SphereSet m_spheres;
+
+    std::vector<SliceScratch> m_slices;
+
+    std::vector<LightCluster> m_clusters;
+    std::vector<uint32_t> m_lightIndices;
+};
@@ -0,0 +1,593 @@
+#include "LoadProfiler.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+using nlohmann::json;
+
+std::atomic<bool> LoadProfiler::s_enabled = false;
+
+namespace
+{
+
+thread_local int t_threadIdx = -1;
+thread_local int t_depth = 0;
+
+std::atomic<int> s_numThreads = 0;
+
+// A stretch of a thread's time within the innermost open span.
+struct Segment
+{
+    int64_t StartNs = 0;
+    int64_t EndNs = 0;
+
+    int Span = 0;
+};
+
+using ThreadSegments = std::map<int, std::vector<Segment>>;
+
+double ToMs(int64_t ns)
+{
+    return static_cast<double>(ns) / 1e6;
+}
+
+ThreadSegments GetThreadSegments(const LoadTrace& trace)
+{
+    std::map<int, std::vector<int>> spansByThread;
+
+    for (size_t i = 0; i < trace.Spans.size(); ++i)
+    {
+        spansByThread[trace.Spans[i].ThreadIdx].push_back(static_cast<int>(i));
+    }
+
+    ThreadSegments threadSegments;
+
+    for (auto& [threadIdx, spans] : spansByThread)
+    {
+        std::sort(spans.begin(), spans.end(), [&](int a, int b) {
+            const LoadSpan& spanA = trace.Spans[a];
+            const LoadSpan& spanB = trace.Spans[b];
+
+            return spanA.StartNs < spanB.StartNs ||
+                (spanA.StartNs == spanB.StartNs && spanA.Depth < spanB.Depth);
+        });
+
+        std::vector<Segment>& segments = threadSegments[threadIdx];
+        std::vector<int> openSpans;
+        int64_t time = 0;
+
+        auto closeUntil = [&](int64_t end) {
+            if (end > time)
+                segments.push_back({time, end, openSpans.back()});
+
+            time = std::max(time, end);
+        };
+
+        for (int spanIdx : spans)
+        {
+            const LoadSpan& span = trace.Spans[spanIdx];
+
+            while (!openSpans.empty() && trace.Spans[openSpans.back()].EndNs <= span.StartNs)
+            {
+                closeUntil(trace.Spans[openSpans.back()].EndNs);
+                openSpans.pop_back();
+            }
+
+            if (!openSpans.empty())
+                closeUntil(span.StartNs);
+
+            openSpans.push_back(spanIdx);
+            time = span.StartNs;
+        }
+
+        while (!openSpans.empty())
+        {
+            closeUntil(trace.Spans[openSpans.back()].EndNs);
+            openSpans.pop_back();
+        }
+    }
+
+    return threadSegments;
+}
+
+// The segment that runs up to |time|, if any.
+const Segment* FindSegment(const std::vector<Segment>& segments, int64_t time)
+{
+    auto it = std::lower_bound(segments.begin(), segments.end(), time,
+                               [](const Segment& segment, int64_t t) { return segment.EndNs < t; });
+
+    return it != segments.end() && it->StartNs < time ? &*it : nullptr;
+}
+
+// End of the last segment before |time|, or |fallback| if there is none.
+int64_t GetLastEndBefore(const std::vector<Segment>& segments, int64_t time, int64_t fallback)
+{
+    auto it = std::lower_bound(segments.begin(), segments.end(), time,
+                               [](const Segment& segment, int64_t t) { return segment.EndNs < t; });
+
+    return it != segments.begin() ? std::prev(it)->EndNs : fallback;
+}
+
+// The thread, other than |waitingThread|, whose work finished last within (begin, end).
+bool FindLastWorkEnd(const LoadTrace& trace, const ThreadSegments& threadSegments,
+                     int waitingThread, int64_t begin, int64_t end, int* outThread,
+                     int64_t* outEnd)
+{
+    bool found = false;
+
+    for (const auto& [threadIdx, segments] : threadSegments)
+    {
+        if (threadIdx == waitingThread)
+            continue;
+
+        auto it = std::lower_bound(segments.begin(), segments.end(), end,
+                                   [](const Segment& segment, int64_t t) {
+                                       return segment.EndNs < t;
+                                   });
+
+        while (it != segments.begin())
+        {
+            --it;
+
+            if (it->EndNs <= begin || (found && it->EndNs <= *outEnd))
+                break;
+
+            if (trace.Spans[it->Span].Kind == LoadSpanKind::Work)
+            {
+                *outThread = threadIdx;
+                *outEnd = it->EndNs;
+                found = true;
+                break;
+            }
+        }
+    }
+
+    return found;
+}
+
+const char* GetKindName(LoadSpanKind kind)
+{
+    return kind == LoadSpanKind::Wait ? "wait" : "work";
+}
+
+} // namespace
+
+LoadProfiler& LoadProfiler::Get()
+{
+    static LoadProfiler profiler;
+    return profiler;
+}
+
+void LoadProfiler::Start()
+{
+    std::lock_guard lock(m_mutex);
+
+    m_trace = {};
+    m_trace.StartNs = Now();
+    m_trace.MainThreadIdx = GetThreadIdx();
+
+    s_enabled.store(true, std::memory_order_relaxed);
+}
+
+LoadTrace LoadProfiler::Stop()
+{
+    std::lock_guard lock(m_mutex);
+
+    s_enabled.store(false, std::memory_order_relaxed);
+
+    m_trace.EndNs = Now();
+
+    return std::exchange(m_trace, {});
+}
+
+void LoadProfiler::AddSpan(LoadSpan span)
+{
+    std::lock_guard lock(m_mutex);
+
+    // Spans that were still open when recording stopped are dropped.
+    if (IsEnabled())
+        m_trace.Spans.push_back(std::move(span));
+}
+
+void LoadProfiler::AddMilestone(const char* name)
+{
+    std::lock_guard lock(m_mutex);
+
+    if (IsEnabled())
+        m_trace.Milestones.push_back({name, Now()});
+}
+
+int64_t LoadProfiler::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int LoadProfiler::GetThreadIdx()
+{
+    if (t_threadIdx < 0)
+        t_threadIdx = s_numThreads.fetch_add(1, std::memory_order_relaxed);
+
+    return t_threadIdx;
+}
+
+LoadScope::LoadScope(const char* stage, const fs::path& asset, LoadSpanKind kind)
+    : m_active(LoadProfiler::IsEnabled()), m_stage(stage), m_kind(kind)
+{
+    if (!m_active)
+        return;
+
+    m_asset = asset.generic_string();
+    m_depth = t_depth++;
+    m_startNs = LoadProfiler::Now();
+}
+
+LoadScope::~LoadScope()
+{
+    if (!m_active)
+        return;
+
+    --t_depth;
+
+    LoadSpan span;
+    span.Stage = m_stage;
+    span.Asset = std::move(m_asset);
+    span.Kind = m_kind;
+    span.ThreadIdx = LoadProfiler::GetThreadIdx();
+    span.Depth = m_depth;
+    span.StartNs = m_startNs;
+    span.EndNs = LoadProfiler::Now();
+    span.Bytes = m_bytes;
+
+    LoadProfiler::Get().AddSpan(std::move(span));
+}
+
+LoadReport AnalyzeLoadTrace(const LoadTrace& trace)
+{
+    LoadReport report;
+    report.TotalMs = ToMs(trace.EndNs - trace.StartNs);
+
+    ThreadSegments threadSegments = GetThreadSegments(trace);
+
+    std::map<std::string, LoadReport::StageTime> stages;
+    std::map<std::string, LoadReport::AssetTime> assets;
+
+    for (const LoadSpan& span : trace.Spans)
+    {
+        LoadReport::StageTime& stage = stages[span.Stage];
+        stage.Stage = span.Stage;
+        ++stage.Count;
+        stage.Bytes += span.Bytes;
+
+        if (!span.Asset.empty())
+        {
+            LoadReport::AssetTime& asset = assets[span.Asset];
+            asset.Asset = span.Asset;
+            asset.Bytes += span.Bytes;
+        }
+    }
+
+    for (const auto& [threadIdx, segments] : threadSegments)
+    {
+        LoadReport::ThreadTime thread;
+        thread.ThreadIdx = threadIdx;
+
+        for (const Segment& segment : segments)
+        {
+            const LoadSpan& span = trace.Spans[segment.Span];
+            double ms = ToMs(segment.EndNs - segment.StartNs);
+
+            (span.Kind == LoadSpanKind::Wait ? thread.WaitMs : thread.WorkMs) += ms;
+            stages[span.Stage].SelfMs += ms;
+
+            if (!span.Asset.empty())
+                assets[span.Asset].SelfMs += ms;
+        }
+
+        thread.IdleMs = std::max(report.TotalMs - thread.WorkMs - thread.WaitMs, 0.0);
+
+        report.Threads.push_back(thread);
+    }
+
+    // Traced backwards from the end, as pieces of spans (or -1 for untracked time).
+    struct PathPiece
+    {
+        int ThreadIdx = 0;
+        int Span = -1;
+
+        int64_t StartNs = 0;
+        int64_t EndNs = 0;
+    };
+
+    std::vector<PathPiece> pieces;
+
+    auto addPiece = [&](int threadIdx, int span, int64_t start, int64_t end) {
+        if (end <= start)
+            return;
+
+        PathPiece* last = pieces.empty() ? nullptr : &pieces.back();
+
+        if (last && last->ThreadIdx == threadIdx && last->Span == span && last->StartNs == end)
+            last->StartNs = start;
+        else
+            pieces.push_back({threadIdx, span, start, end});
+    };
+
+    static const std::vector<Segment> noSegments;
+
+    int threadIdx = trace.MainThreadIdx;
+    int64_t time = trace.EndNs;
+
+    // Every step moves back to an earlier segment boundary, or over to the main thread, which then
+    // moves back. So this bound is never reached - it guards against malformed traces.
+    size_t maxSteps = 8 * trace.Spans.size() + 16;
+
+    for (size_t step = 0; time > trace.StartNs && step < maxSteps; ++step)
+    {
+        auto it = threadSegments.find(threadIdx);
+        const std::vector<Segment>& segments =
+            it != threadSegments.end() ? it->second : noSegments;
+
+        const Segment* segment = FindSegment(segments, time);
+
+        if (!segment)
+        {
+            if (threadIdx != trace.MainThreadIdx)
+            {
+                threadIdx = trace.MainThreadIdx;
+                continue;
+            }
+
+            int64_t start = std::max(GetLastEndBefore(segments, time, trace.StartNs),
+                                     trace.StartNs);
+
+            addPiece(threadIdx, -1, start, time);
+            time = start;
+            continue;
+        }
+
+        int64_t start = std::max(segment->StartNs, trace.StartNs);
+
+        if (trace.Spans[segment->Span].Kind == LoadSpanKind::Wait)
+        {
+            int otherThread = 0;
+            int64_t workEnd = 0;
+
+            if (FindLastWorkEnd(trace, threadSegments, threadIdx, start, time, &otherThread,
+                                &workEnd))
+            {
+                // The rest of the wait is the time it took to notice that the work was done.
+                addPiece(threadIdx, segment->Span, workEnd, time);
+
+                threadIdx = otherThread;
+                time = workEnd;
+                continue;
+            }
+        }
+
+        addPiece(threadIdx, segment->Span, start, time);
+        time = start;
+    }
+
+    std::reverse(pieces.begin(), pieces.end());
+
+    for (const LoadMilestone& milestone : trace.Milestones)
+    {
+        report.Milestones.push_back({milestone.Name, ToMs(milestone.TimeNs - trace.StartNs)});
+    }
+
+    std::stable_sort(report.Milestones.begin(), report.Milestones.end(),
+                     [](const auto& a, const auto& b) { return a.Ms < b.Ms; });
+
+    for (const PathPiece& piece : pieces)
+    {
+        LoadReport::PathSegment segment;
+        segment.ThreadIdx = piece.ThreadIdx;
+        segment.StartMs = ToMs(piece.StartNs - trace.StartNs);
+        segment.DurationMs = ToMs(piece.EndNs - piece.StartNs);
+
+        if (piece.Span < 0)
+        {
+            segment.Stage = UNTRACKED_STAGE;
+            report.CriticalUntrackedMs += segment.DurationMs;
+        }
+        else
+        {
+            const LoadSpan& span = trace.Spans[piece.Span];
+
+            segment.Stage = span.Stage;
+            segment.Asset = span.Asset;
+            segment.Kind = span.Kind;
+
+            (span.Kind == LoadSpanKind::Wait ? report.CriticalWaitMs : report.CriticalWorkMs) +=
+                segment.DurationMs;
+
+            stages[span.Stage].CriticalMs += segment.DurationMs;
+
+            if (!span.Asset.empty())
+                assets[span.Asset].CriticalMs += segment.DurationMs;
+        }
+
+        report.CriticalPath.push_back(std::move(segment));
+    }
+
+    for (auto& [name, stage] : stages)
+    {
+        report.Stages.push_back(std::move(stage));
+    }
+
+    for (auto& [name, asset] : assets)
+    {
+        report.Assets.push_back(std::move(asset));
+    }
+
+    std::stable_sort(report.Stages.begin(), report.Stages.end(), [](const auto& a, const auto& b) {
+        return a.SelfMs > b.SelfMs;
+    });
+
+    std::stable_sort(report.Assets.begin(), report.Assets.end(), [](const auto& a, const auto& b) {
+        return a.SelfMs > b.SelfMs;
+    });
+
+    return report;
+}
+
+void WriteLoadReport(const LoadReport& report, const fs::path& path)
+{
+    auto getMbPerSec = [](uint64_t bytes, double ms) {
+        return ms > 0.0 ? static_cast<double>(bytes) / (ms * 1e3) : 0.0;
+    };
+
+    json threads = json::array();
+
+    for (const LoadReport::ThreadTime& thread : report.Threads)
+    {
+        threads.push_back({
+            {"thread", thread.ThreadIdx},
+            {"work_ms", thread.WorkMs},
+            {"wait_ms", thread.WaitMs},
+            {"idle_ms", thread.IdleMs}
+        });
+    }
+
+    json stages = json::array();
+
+    for (const LoadReport::StageTime& stage : report.Stages)
+    {
+        stages.push_back({
+            {"stage", stage.Stage},
+            {"count", stage.Count},
+            {"bytes", stage.Bytes},
+            {"self_ms", stage.SelfMs},
+            {"critical_ms", stage.CriticalMs},
+            {"mb_per_sec", getMbPerSec(stage.Bytes, stage.SelfMs)}
+        });
+    }
+
+    json assets = json::array();
+
+    for (const LoadReport::AssetTime& asset : report.Assets)
+    {
+        assets.push_back({
+            {"asset", asset.Asset},
+            {"bytes", asset.Bytes},
+            {"self_ms", asset.SelfMs},
+            {"critical_ms", asset.CriticalMs}
+        });
+    }
+
+    json milestones = json::object();
+
+    for (const LoadReport::Milestone& milestone : report.Milestones)
+    {
+        milestones[milestone.Name] = milestone.Ms;
+    }
+
+    json criticalPath = json::array();
+
+    for (const LoadReport::PathSegment& segment : report.CriticalPath)
+    {
+        criticalPath.push_back({
+            {"stage", segment.Stage},
+            {"asset", segment.Asset},
+            {"kind", GetKindName(segment.Kind)},
+            {"thread", segment.ThreadIdx},
+            {"start_ms", segment.StartMs},
+            {"duration_ms", segment.DurationMs}
+        });
+    }
+
+    json reportJson = {
+        {"total_ms", report.TotalMs},
+        {"milestones_ms", milestones},
+        {"critical_path", {
+            {"work_ms", report.CriticalWorkMs},
+            {"wait_ms", report.CriticalWaitMs},
+            {"untracked_ms", report.CriticalUntrackedMs},
+            {"segments", criticalPath}
+        }},
+        {"threads", threads},
+        {"stages", stages},
+        {"assets", assets}
+    };
+
+    std::ofstream strm(path);
+    if (!strm.is_open())
+        throw std::runtime_error("Could not open file.");
+
+    strm << reportJson.dump(2) << "\n";
+}
+
+void WriteLoadChromeTrace(const LoadTrace& trace, const LoadReport& report, const fs::path& path)
+{
+    constexpr int CRITICAL_PATH_TID = -1;
+
+    json events = json::array();
+
+    events.push_back({
+        {"name", "thread_name"},
+        {"ph", "M"},
+        {"pid", 0},
+        {"tid", CRITICAL_PATH_TID},
+        {"args", {{"name", "Critical path"}}}
+    });
+
+    for (const LoadSpan& span : trace.Spans)
+    {
+        events.push_back({
+            {"name", span.Stage},
+            {"cat", GetKindName(span.Kind)},
+            {"ph", "X"},
+            {"ts", static_cast<double>(span.StartNs - trace.StartNs) / 1e3},
+            {"dur", static_cast<double>(span.EndNs - span.StartNs) / 1e3},
+            {"pid", 0},
+            {"tid", span.ThreadIdx},
+            {"args", {{"asset", span.Asset}, {"bytes", span.Bytes}}}
+        });
+    }
+
+    for (const LoadMilestone& milestone : trace.Milestones)
+    {
+        events.push_back({
+            {"name", milestone.Name},
+            {"ph", "i"},
+            {"s", "g"},
+            {"ts", static_cast<double>(milestone.TimeNs - trace.StartNs) / 1e3},
+            {"pid", 0},
+            {"tid", trace.MainThreadIdx}
+        });
+    }
+
+    for (const LoadReport::PathSegment& segment : report.CriticalPath)
+    {
+        events.push_back({
+            {"name", segment.Stage},
+            {"cat", "critical"},
+            {"ph", "X"},
+            {"ts", segment.StartMs * 1e3},
+            {"dur", segment.DurationMs * 1e3},
+            {"pid", 0},
+            {"tid", CRITICAL_PATH_TID},
+            {"args", {{"asset", segment.Asset}, {"thread", segment.ThreadIdx}}}
+        });
+    }
+
+    json traceJson = {
+        {"traceEvents", events},
+        {"displayTimeUnit", "ms"}
+    };
+
+    std::ofstream strm(path);
+    if (!strm.is_open())
+        throw std::runtime_error("Could not open file.");
+
+    strm << traceJson.dump();
+}
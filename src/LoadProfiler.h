@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Records what loading spends its time on: a span for each stage of loading each asset - reading,
+// parsing, decoding, uploading - with the bytes it processed, and a span for each time a thread
+// blocks on another or on the GPU. Unlike Profiler scopes, spans name their asset and are kept
+// whole rather than per frame, so that the critical path across threads can be found once loading
+// is done. Recording takes a lock, which is fine for the few hundred spans of a startup.
+
+enum class LoadSpanKind
+{
+    Work,
+
+    // Blocked on another thread or the GPU.
+    Wait
+};
+
+struct LoadSpan
+{
+    // A string literal.
+    const char* Stage = nullptr;
+
+    // Path of the asset the span belongs to, if any.
+    std::string Asset;
+
+    LoadSpanKind Kind = LoadSpanKind::Work;
+
+    int ThreadIdx = 0;
+
+    // Nesting depth on its thread.
+    int Depth = 0;
+
+    int64_t StartNs = 0;
+    int64_t EndNs = 0;
+
+    uint64_t Bytes = 0;
+};
+
+// A moment of note during loading, such as the first frame.
+struct LoadMilestone
+{
+    // A string literal.
+    const char* Name = nullptr;
+
+    int64_t TimeNs = 0;
+};
+
+struct LoadTrace
+{
+    int64_t StartNs = 0;
+    int64_t EndNs = 0;
+
+    // The thread that started and stopped recording, on which the critical path ends.
+    int MainThreadIdx = 0;
+
+    // In the order they closed.
+    std::vector<LoadSpan> Spans;
+
+    std::vector<LoadMilestone> Milestones;
+};
+
+class LoadProfiler
+{
+public:
+    static LoadProfiler& Get();
+
+    static bool IsEnabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    // Discards anything recorded and starts recording, with the calling thread as the main one.
+    void Start();
+
+    // Stops recording. Spans still open are left out.
+    LoadTrace Stop();
+
+    void AddSpan(LoadSpan span);
+
+    // Records that |name| happened now, from any thread.
+    void AddMilestone(const char* name);
+
+    static int64_t Now();
+
+    // Small, stable index of the calling thread.
+    static int GetThreadIdx();
+
+private:
+    LoadProfiler() = default;
+
+    static std::atomic<bool> s_enabled;
+
+    std::mutex m_mutex;
+    LoadTrace m_trace;
+};
+
+// Records a span from construction to destruction while the load profiler is running.
+class LoadScope
+{
+public:
+    explicit LoadScope(const char* stage, const std::filesystem::path& asset = {},
+                       LoadSpanKind kind = LoadSpanKind::Work);
+    ~LoadScope();
+
+    LoadScope(const LoadScope&) = delete;
+    LoadScope& operator=(const LoadScope&) = delete;
+
+    // Bytes read, decoded or uploaded within the span.
+    void AddBytes(uint64_t bytes)
+    {
+        m_bytes += bytes;
+    }
+
+private:
+    bool m_active;
+
+    const char* m_stage;
+    std::string m_asset;
+    LoadSpanKind m_kind;
+
+    int m_depth = 0;
+    int64_t m_startNs = 0;
+    uint64_t m_bytes = 0;
+};
+
+// Where loading spent its time, from a LoadTrace. Time is attributed to the innermost span open on
+// a thread, so a stage's self time excludes the stages nested in it.
+struct LoadReport
+{
+    double TotalMs = 0.0;
+
+    struct ThreadTime
+    {
+        int ThreadIdx = 0;
+
+        // Idle time is outside any span, which for job workers means waiting for jobs.
+        double WorkMs = 0.0;
+        double WaitMs = 0.0;
+        double IdleMs = 0.0;
+    };
+
+    struct StageTime
+    {
+        std::string Stage;
+
+        int Count = 0;
+        uint64_t Bytes = 0;
+
+        double SelfMs = 0.0;
+        double CriticalMs = 0.0;
+    };
+
+    struct AssetTime
+    {
+        std::string Asset;
+
+        uint64_t Bytes = 0;
+
+        double SelfMs = 0.0;
+        double CriticalMs = 0.0;
+    };
+
+    // A stretch of the critical path spent in one span, or outside any on the main thread.
+    struct PathSegment
+    {
+        std::string Stage;
+        std::string Asset;
+        LoadSpanKind Kind = LoadSpanKind::Work;
+
+        int ThreadIdx = 0;
+
+        double StartMs = 0.0;
+        double DurationMs = 0.0;
+    };
+
+    struct Milestone
+    {
+        std::string Name;
+        double Ms = 0.0;
+    };
+
+    std::vector<ThreadTime> Threads;
+
+    // In time order.
+    std::vector<Milestone> Milestones;
+
+    // Most self time first.
+    std::vector<StageTime> Stages;
+    std::vector<AssetTime> Assets;
+
+    // The chain of work the end of loading waited on, in time order. It is traced back from the
+    // end on the main thread. When a thread waits, the path moves to the work on another thread
+    // that finished last before the wait ended, which is most likely what it waited for, or stays
+    // in the wait if none did - the GPU or a sleep, say. Gaps on the main thread are untracked
+    // work there; gaps on other threads lead back to the main thread, which submits their jobs.
+    std::vector<PathSegment> CriticalPath;
+
+    double CriticalWorkMs = 0.0;
+    double CriticalWaitMs = 0.0;
+    double CriticalUntrackedMs = 0.0;
+};
+
+// Name of the critical path segments that are not in any span.
+constexpr const char* UNTRACKED_STAGE = "(untracked)";
+
+LoadReport AnalyzeLoadTrace(const LoadTrace& trace);
+
+void WriteLoadReport(const LoadReport& report, const std::filesystem::path& path);
+
+// Writes the spans, and the critical path as a track of its own, in the Chrome trace event format.
+void WriteLoadChromeTrace(const LoadTrace& trace, const LoadReport& report,
+                          const std::filesystem::path& path);
@@ -0,0 +1,429 @@
+// Benchmark for the load profiler. Analyzes hand-built traces whose critical paths are known: a
+// wait on another thread's work, a wait on the GPU, untracked time on the main thread and nested
+// spans. Then records a load of a glTF model and of a directory of images on several job threads,
+// checks that its critical path accounts for the whole load, and writes its report and trace.
+// Last, measures the cost of a scope with recording on and off. Exits with an error if any check
+// fails.
+
+#include "AssetArchive.h"
+#include "BenchmarkUtils.h"
+#include "GltfLoader.h"
+#include "ImageDecoder.h"
+#include "JobSystem.h"
+#include "LoadProfiler.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+
+struct Options
+{
+    std::string OutPath = "load_profiler_benchmark_results.json";
+
+    // Where the recorded load's report and trace go.
+    std::string ReportPath = "load_profiler_report.json";
+    std::string TracePath = "load_profiler_trace.json";
+
+    std::string ModelPath = "assets/box/Box.gltf";
+    std::string ImageDir = "assets/sponza";
+
+    // Most images to load from the directory.
+    int MaxImages = 32;
+
+    int NumThreads = 4;
+
+    int ScopeIterations = 1000000;
+};
+
+constexpr const char* USAGE =
+    "Usage: LoadProfilerBenchmark [options]\n"
+    "  --model FILE      glTF file to load (default assets/box/Box.gltf)\n"
+    "  --images DIR      Directory of images to load (default assets/sponza)\n"
+    "  --max-images N    Most images to load (default 32)\n"
+    "  --threads N       Job threads, including the main one (default 4)\n"
+    "  --scopes N        Scopes to time for the overhead (default 1000000)\n"
+    "  --report FILE     Report of the load (default load_profiler_report.json)\n"
+    "  --trace FILE      Trace of the load (default load_profiler_trace.json)\n"
+    "  --out FILE        Results file (default load_profiler_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--model")
+            options->ModelPath = value;
+        else if (arg == "--images")
+            options->ImageDir = value;
+        else if (arg == "--max-images")
+            options->MaxImages = std::stoi(value);
+        else if (arg == "--threads")
+            options->NumThreads = std::stoi(value);
+        else if (arg == "--scopes")
+            options->ScopeIterations = std::stoi(value);
+        else if (arg == "--report")
+            options->ReportPath = value;
+        else if (arg == "--trace")
+            options->TracePath = value;
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->MaxImages >= 0 && options->NumThreads > 0 && options->ScopeIterations > 0;
+}
+
+bool IsNear(double a, double b, double tolerance = 1e-6)
+{
+    return std::abs(a - b) <= tolerance;
+}
+
+// Hand-built traces are in whole milliseconds from zero.
+LoadSpan MakeSpan(const char* stage, int threadIdx, int depth, int startMs, int endMs,
+                  LoadSpanKind kind = LoadSpanKind::Work)
+{
+    LoadSpan span;
+    span.Stage = stage;
+    span.Asset = std::string(stage) + ".bin";
+    span.Kind = kind;
+    span.ThreadIdx = threadIdx;
+    span.Depth = depth;
+    span.StartNs = int64_t(startMs) * 1000000;
+    span.EndNs = int64_t(endMs) * 1000000;
+    span.Bytes = 1000;
+
+    return span;
+}
+
+LoadTrace MakeTrace(int endMs, std::vector<LoadSpan> spans)
+{
+    LoadTrace trace;
+    trace.EndNs = int64_t(endMs) * 1000000;
+    trace.Spans = std::move(spans);
+
+    return trace;
+}
+
+// Compares the critical path to stages and durations, in order.
+bool PathMatches(const LoadReport& report,
+                 const std::vector<std::pair<std::string, double>>& expected)
+{
+    if (report.CriticalPath.size() != expected.size())
+        return false;
+
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        if (report.CriticalPath[i].Stage != expected[i].first ||
+            !IsNear(report.CriticalPath[i].DurationMs, expected[i].second))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const LoadReport::StageTime* FindStage(const LoadReport& report, const std::string& name)
+{
+    for (const LoadReport::StageTime& stage : report.Stages)
+    {
+        if (stage.Stage == name)
+            return &stage;
+    }
+
+    return nullptr;
+}
+
+const LoadReport::ThreadTime* FindThread(const LoadReport& report, int threadIdx)
+{
+    for (const LoadReport::ThreadTime& thread : report.Threads)
+    {
+        if (thread.ThreadIdx == threadIdx)
+            return &thread;
+    }
+
+    return nullptr;
+}
+
+// The main thread parses, then waits for a worker that finished before the wait did. The path
+// runs through the worker's span and ends with the time it took the wait to notice.
+bool CheckWaitOnWorker()
+{
+    LoadReport report = AnalyzeLoadTrace(MakeTrace(50, {
+        MakeSpan("Parse", 0, 0, 0, 10),
+        MakeSpan("Decode", 1, 0, 5, 45),
+        MakeSpan("Wait", 0, 0, 10, 50, LoadSpanKind::Wait)
+    }));
+
+    const LoadReport::ThreadTime* worker = FindThread(report, 1);
+
+    return PathMatches(report, {{"Parse", 5.0}, {"Decode", 40.0}, {"Wait", 5.0}}) &&
+        IsNear(report.CriticalWorkMs, 45.0) && IsNear(report.CriticalWaitMs, 5.0) &&
+        worker && IsNear(worker->WorkMs, 40.0) && IsNear(worker->IdleMs, 10.0);
+}
+
+// No other thread works during the wait, so it is on the GPU and stays on the path whole.
+bool CheckWaitOnGpu()
+{
+    LoadReport report = AnalyzeLoadTrace(MakeTrace(40, {
+        MakeSpan("Upload", 0, 0, 0, 10),
+        MakeSpan("Decode", 1, 0, 0, 8),
+        MakeSpan("WaitGpu", 0, 0, 10, 40, LoadSpanKind::Wait)
+    }));
+
+    return PathMatches(report, {{"Upload", 10.0}, {"WaitGpu", 30.0}}) &&
+        IsNear(report.CriticalWaitMs, 30.0);
+}
+
+// Time on the main thread outside any span is on the path as untracked.
+bool CheckUntracked()
+{
+    LoadReport report = AnalyzeLoadTrace(MakeTrace(40, {
+        MakeSpan("Parse", 0, 0, 0, 10),
+        MakeSpan("Upload", 0, 0, 20, 30)
+    }));
+
+    return PathMatches(report, {{"Parse", 10.0}, {UNTRACKED_STAGE, 10.0}, {"Upload", 10.0},
+                                {UNTRACKED_STAGE, 10.0}}) &&
+        IsNear(report.CriticalUntrackedMs, 20.0) && IsNear(report.CriticalWorkMs, 20.0);
+}
+
+// Nested spans take their time from the span they are nested in.
+bool CheckNestedSelfTime()
+{
+    LoadReport report = AnalyzeLoadTrace(MakeTrace(100, {
+        MakeSpan("Read", 0, 1, 20, 50),
+        MakeSpan("Load", 0, 0, 0, 100)
+    }));
+
+    const LoadReport::StageTime* load = FindStage(report, "Load");
+    const LoadReport::StageTime* read = FindStage(report, "Read");
+
+    return load && read && IsNear(load->SelfMs, 70.0) && IsNear(read->SelfMs, 30.0) &&
+        IsNear(load->CriticalMs, 70.0) && IsNear(read->CriticalMs, 30.0) &&
+        report.Stages.front().Stage == "Load" &&
+        PathMatches(report, {{"Load", 20.0}, {"Read", 30.0}, {"Load", 50.0}});
+}
+
+// A malformed trace, with spans that cross on one thread, still gives a path that ends.
+bool CheckCrossedSpans()
+{
+    LoadReport report = AnalyzeLoadTrace(MakeTrace(30, {
+        MakeSpan("A", 0, 0, 0, 20),
+        MakeSpan("B", 0, 1, 10, 30)
+    }));
+
+    double pathMs = report.CriticalWorkMs + report.CriticalWaitMs + report.CriticalUntrackedMs;
+
+    return pathMs <= report.TotalMs + 1e-6;
+}
+
+std::vector<fs::path> FindImages(const fs::path& dir, int maxImages)
+{
+    std::vector<fs::path> images;
+
+    if (!fs::is_directory(dir))
+        return images;
+
+    for (const fs::directory_entry& entry : fs::directory_iterator(dir))
+    {
+        std::string extension = entry.path().extension().string();
+
+        if (extension == ".jpg" || extension == ".png")
+            images.push_back(entry.path());
+    }
+
+    std::sort(images.begin(), images.end());
+    images.resize(std::min(images.size(), static_cast<size_t>(maxImages)));
+
+    return images;
+}
+
+// Loads the model on the main thread while the images are read and decoded on the workers, as
+// the app does.
+void RecordLoad(const Options& options, JobSystem* jobSystem)
+{
+    std::vector<fs::path> images = FindImages(options.ImageDir, options.MaxImages);
+
+    JobCounter counter;
+
+    for (const fs::path& path : images)
+    {
+        jobSystem->Run([path] {
+            LoadScope scope("LoadImage", path);
+
+            std::vector<std::byte> data = ReadAssetFile(path, nullptr);
+
+            LoadScope decodeScope("DecodeImage", path);
+
+            std::unique_ptr<ImageDecoder> decoder = CreateImageDecoder(data);
+            size_t rowPitch = size_t(decoder->GetWidth()) * 4;
+            std::vector<uint8_t> pixels(rowPitch * decoder->GetHeight());
+
+            decoder->Decode(pixels.data(), rowPitch);
+            decodeScope.AddBytes(pixels.size());
+        }, &counter);
+    }
+
+    {
+        LoadScope scope("LoadModel", options.ModelPath);
+
+        LoadGltfModelData(options.ModelPath);
+    }
+
+    LoadScope scope("WaitImages", {}, LoadSpanKind::Wait);
+
+    jobSystem->Wait(counter);
+}
+
+// The path is in time order, without overlaps, and adds up to the whole load.
+bool IsPathComplete(const LoadReport& report)
+{
+    double endMs = 0.0;
+
+    for (const LoadReport::PathSegment& segment : report.CriticalPath)
+    {
+        if (segment.StartMs + 1e-3 < endMs || segment.DurationMs <= 0.0)
+            return false;
+
+        endMs = segment.StartMs + segment.DurationMs;
+    }
+
+    double pathMs = report.CriticalWorkMs + report.CriticalWaitMs + report.CriticalUntrackedMs;
+
+    return IsNear(pathMs, report.TotalMs, 1e-3) && IsNear(endMs, report.TotalMs, 1e-3);
+}
+
+json ToJson(const LoadReport& report)
+{
+    json stages = json::array();
+
+    for (const LoadReport::StageTime& stage : report.Stages)
+    {
+        stages.push_back({
+            {"stage", stage.Stage},
+            {"count", stage.Count},
+            {"bytes", stage.Bytes},
+            {"self_ms", stage.SelfMs},
+            {"critical_ms", stage.CriticalMs}
+        });
+    }
+
+    return {
+        {"total_ms", report.TotalMs},
+        {"num_threads", report.Threads.size()},
+        {"critical_path_segments", report.CriticalPath.size()},
+        {"critical_work_ms", report.CriticalWorkMs},
+        {"critical_wait_ms", report.CriticalWaitMs},
+        {"critical_untracked_ms", report.CriticalUntrackedMs},
+        {"stages", stages}
+    };
+}
+
+// Nanoseconds per scope, with recording on or off.
+double MeasureScopeNs(int iterations, bool enabled)
+{
+    if (enabled)
+        LoadProfiler::Get().Start();
+
+    Clock::time_point start = Clock::now();
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        LoadScope scope("Scope");
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    if (enabled)
+        LoadProfiler::Get().Stop();
+
+    return ns / iterations;
+}
+
+int RunBenchmark(const Options& options)
+{
+    Checks checks;
+
+    checks.Check("wait_on_worker", CheckWaitOnWorker());
+    checks.Check("wait_on_gpu", CheckWaitOnGpu());
+    checks.Check("untracked", CheckUntracked());
+    checks.Check("nested_self_time", CheckNestedSelfTime());
+    checks.Check("crossed_spans", CheckCrossedSpans());
+
+    JobSystem jobSystem(options.NumThreads);
+
+    LoadProfiler::Get().Start();
+    RecordLoad(options, &jobSystem);
+    LoadTrace trace = LoadProfiler::Get().Stop();
+
+    LoadReport report = AnalyzeLoadTrace(trace);
+
+    WriteLoadReport(report, options.ReportPath);
+    WriteLoadChromeTrace(trace, report, options.TracePath);
+
+    checks.Check("load_path_complete", IsPathComplete(report));
+    checks.Check("load_model_recorded", FindStage(report, "ParseGltf") != nullptr);
+    checks.Check("load_images_recorded", options.MaxImages == 0 ||
+                                             FindStage(report, "DecodeImage") != nullptr);
+
+    // Nothing is recorded once stopped.
+    {
+        LoadScope scope("AfterStop");
+    }
+
+    checks.Check("stopped_records_nothing", LoadProfiler::Get().Stop().Spans.empty());
+
+    double disabledNs = MeasureScopeNs(options.ScopeIterations, false);
+    double enabledNs = MeasureScopeNs(options.ScopeIterations, true);
+
+    json results = {
+        {"load", ToJson(report)},
+        {"scope_ns_disabled", disabledNs},
+        {"scope_ns_enabled", enabledNs},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Load profiler checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
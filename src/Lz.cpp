@@ -0,0 +1,244 @@
+#include "Lz.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t MAX_OFFSET = 65535;
+
+// Lengths that do not fit the token's 4 bits continue in extra bytes.
+constexpr size_t MAX_NIBBLE = 15;
+
+// The match finder remembers the last position of each hash of 4 bytes.
+constexpr int HASH_BITS = 12;
+
+// Every 2^SKIP_SHIFT misses in a row, the search steps one byte further, so incompressible data
+// such as JPEG files goes through quickly.
+constexpr size_t SKIP_SHIFT = 5;
+
+template<typename T>
+T Load(const std::byte* bytes)
+{
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+
+    return value;
+}
+
+uint32_t HashWord(uint32_t word)
+{
+    return (word * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Number of bytes at |pos| that equal those at |match|, up to |end|.
+size_t GetMatchLength(const std::byte* match, const std::byte* pos, const std::byte* end)
+{
+    const std::byte* start = pos;
+
+    for (; end - pos >= 8; pos += 8, match += 8)
+    {
+        uint64_t diff = Load<uint64_t>(match) ^ Load<uint64_t>(pos);
+
+        if (diff != 0)
+            return static_cast<size_t>(pos - start) + std::countr_zero(diff) / 8;
+    }
+
+    for (; pos < end && *pos == *match; ++pos, ++match)
+    {
+    }
+
+    return static_cast<size_t>(pos - start);
+}
+
+void WriteLength(std::vector<std::byte>* dst, size_t length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        dst->push_back(std::byte{255});
+    }
+
+    dst->push_back(static_cast<std::byte>(length));
+}
+
+// A |matchLength| of zero ends the data with the literals alone.
+void WriteSequence(std::vector<std::byte>* dst, std::span<const std::byte> literals,
+                   size_t offset, size_t matchLength)
+{
+    size_t literalNibble = std::min(literals.size(), MAX_NIBBLE);
+    size_t matchNibble = matchLength > 0 ? std::min(matchLength - MIN_MATCH, MAX_NIBBLE) : 0;
+
+    dst->push_back(static_cast<std::byte>(literalNibble << 4 | matchNibble));
+
+    if (literalNibble == MAX_NIBBLE)
+        WriteLength(dst, literals.size() - MAX_NIBBLE);
+
+    dst->insert(dst->end(), literals.begin(), literals.end());
+
+    if (matchLength == 0)
+        return;
+
+    dst->push_back(static_cast<std::byte>(offset & 0xff));
+    dst->push_back(static_cast<std::byte>(offset >> 8));
+
+    if (matchNibble == MAX_NIBBLE)
+        WriteLength(dst, matchLength - MIN_MATCH - MAX_NIBBLE);
+}
+
+[[noreturn]] void ThrowInvalid()
+{
+    throw std::runtime_error("Invalid LZ data.");
+}
+
+size_t ReadLength(const std::byte** pos, const std::byte* end)
+{
+    size_t length = 0;
+
+    for (;;)
+    {
+        if (*pos == end)
+            ThrowInvalid();
+
+        uint8_t value = static_cast<uint8_t>(*(*pos)++);
+        length += value;
+
+        if (value != 255)
+            return length;
+    }
+}
+
+} // namespace
+
+std::vector<std::byte> CompressLz(std::span<const std::byte> src)
+{
+    std::vector<std::byte> dst;
+    dst.reserve(src.size() + src.size() / 255 + 16);
+
+    const std::byte* data = src.data();
+    const std::byte* end = data + src.size();
+
+    // Positions start out as 0, which only ever yields a candidate that fails the comparison.
+    size_t table[size_t{1} << HASH_BITS] = {};
+
+    size_t anchor = 0;
+    size_t pos = 0;
+    size_t numMisses = 0;
+
+    while (pos + MIN_MATCH <= src.size())
+    {
+        uint32_t word = Load<uint32_t>(data + pos);
+        size_t& slot = table[HashWord(word)];
+
+        size_t candidate = slot;
+        slot = pos;
+
+        if (candidate >= pos || pos - candidate > MAX_OFFSET ||
+            Load<uint32_t>(data + candidate) != word)
+        {
+            pos += 1 + (numMisses++ >> SKIP_SHIFT);
+            continue;
+        }
+
+        size_t length = MIN_MATCH + GetMatchLength(data + candidate + MIN_MATCH,
+                                                   data + pos + MIN_MATCH, end);
+
+        WriteSequence(&dst, src.subspan(anchor, pos - anchor), pos - candidate, length);
+
+        pos += length;
+        anchor = pos;
+        numMisses = 0;
+
+        // Positions inside the match are not searched, but one near its end is remembered, so
+        // that runs of matches chain.
+        if (pos + 2 <= src.size())
+            table[HashWord(Load<uint32_t>(data + pos - 2))] = pos - 2;
+    }
+
+    WriteSequence(&dst, src.subspan(anchor), 0, 0);
+
+    return dst;
+}
+
+void DecompressLz(std::span<const std::byte> src, std::span<std::byte> dst)
+{
+    const std::byte* in = src.data();
+    const std::byte* inEnd = in + src.size();
+
+    std::byte* out = dst.data();
+    std::byte* outEnd = out + dst.size();
+
+    for (;;)
+    {
+        if (in == inEnd)
+            ThrowInvalid();
+
+        uint8_t token = static_cast<uint8_t>(*in++);
+
+        size_t literalLength = token >> 4;
+
+        if (literalLength == MAX_NIBBLE)
+            literalLength += ReadLength(&in, inEnd);
+
+        if (literalLength > static_cast<size_t>(inEnd - in) ||
+            literalLength > static_cast<size_t>(outEnd - out))
+        {
+            ThrowInvalid();
+        }
+
+        if (literalLength > 0)
+            std::memcpy(out, in, literalLength);
+
+        in += literalLength;
+        out += literalLength;
+
+        if (in == inEnd)
+            break;
+
+        if (inEnd - in < 2)
+            ThrowInvalid();
+
+        size_t offset = static_cast<size_t>(in[0]) | static_cast<size_t>(in[1]) << 8;
+        in += 2;
+
+        if (offset == 0 || offset > static_cast<size_t>(out - dst.data()))
+            ThrowInvalid();
+
+        size_t matchLength = (token & MAX_NIBBLE) + MIN_MATCH;
+
+        if ((token & MAX_NIBBLE) == MAX_NIBBLE)
+            matchLength += ReadLength(&in, inEnd);
+
+        if (matchLength > static_cast<size_t>(outEnd - out))
+            ThrowInvalid();
+
+        const std::byte* match = out - offset;
+        std::byte* matchEnd = out + matchLength;
+
+        // Copies 8 bytes at a time, which may run up to 7 bytes past the match while there is
+        // room. Each copy only reads bytes that are already final, as the offset is at least 8.
+        if (offset >= 8 && static_cast<size_t>(outEnd - matchEnd) >= 8)
+        {
+            for (; out < matchEnd; out += 8, match += 8)
+            {
+                std::memcpy(out, match, 8);
+            }
+        }
+        else
+        {
+            for (; out < matchEnd; ++out, ++match)
+            {
+                *out = *match;
+            }
+        }
+
+        out = matchEnd;
+    }
+
+    if (out != outEnd)
+        ThrowInvalid();
+}
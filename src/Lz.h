@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// A byte-oriented LZ77 codec in the style of LZ4: no entropy coding, so decompression runs at
+// memory speed. Each sequence is a token byte holding the literal count and match length, the
+// literals, and a 16-bit offset back into the output. Matches reach back at most 64 KB.
+
+// Compresses |src| greedily. The result may be larger than |src| for incompressible data.
+std::vector<std::byte> CompressLz(std::span<const std::byte> src);
+
+// Decompresses into |dst|, which must be exactly the size of the uncompressed data. Throws if
+// the data is invalid or does not fill |dst| exactly. Never reads or writes out of bounds.
+void DecompressLz(std::span<const std::byte> src, std::span<std::byte> dst);
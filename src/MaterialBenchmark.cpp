@@ -0,0 +1,333 @@
+// Benchmark for the material table. Adds many materials, a share of them repeats of earlier ones,
+// then edits a few each frame and re-uploads only the dirty ranges into a mirror of the GPU
+// buffer. Checks that identical materials are stored once, that records are packed as the shader
+// expects, and that uploading the dirty ranges keeps the mirror identical to the table. Exits with
+// an error if any check fails.
+
+#include "BenchmarkUtils.h"
+#include "MaterialTable.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+using benchmark::ElapsedMs;
+
+struct Options
+{
+    std::string OutPath = "material_benchmark_results.json";
+
+    int NumMaterials = 100000;
+
+    // Fraction of Add() calls that repeat an earlier material.
+    float DuplicateFraction = 0.5f;
+
+    int NumEditsPerFrame = 256;
+    int NumFrames = 200;
+};
+
+constexpr const char* USAGE =
+    "Usage: MaterialBenchmark [options]\n"
+    "  --materials N     Distinct materials (default 100000)\n"
+    "  --duplicates F    Fraction of adds repeating an earlier material (default 0.5)\n"
+    "  --edits N         Materials edited per frame (default 256)\n"
+    "  --frames N        Edit frames (default 200)\n"
+    "  --out FILE        Results file (default material_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--materials")
+            options->NumMaterials = std::stoi(value);
+        else if (arg == "--duplicates")
+            options->DuplicateFraction = std::stof(value);
+        else if (arg == "--edits")
+            options->NumEditsPerFrame = std::stoi(value);
+        else if (arg == "--frames")
+            options->NumFrames = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->NumMaterials > 0 && options->DuplicateFraction >= 0.f &&
+        options->DuplicateFraction < 1.f && options->NumEditsPerFrame >= 0 &&
+        options->NumFrames > 0;
+}
+
+// Distinct for every |id|: the id is stored exactly in the red channel.
+Material MakeMaterial(uint32_t id, std::mt19937* rng)
+{
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    Material material{};
+    material.BaseColorFactor = glm::vec4(static_cast<float>(id), unit(*rng), unit(*rng), 1.f);
+    material.MetallicFactor = id % 3 == 0 ? 0.f : unit(*rng);
+    material.RoughnessFactor = unit(*rng);
+    material.BaseColorTextureId = static_cast<TextureId>((*rng)() % 129) - 1;
+    material.RoughnessTextureId = static_cast<TextureId>((*rng)() % 129) - 1;
+    material.NormalTextureId = static_cast<TextureId>((*rng)() % 129) - 1;
+
+    return material;
+}
+
+bool SameRecordBytes(const MaterialRecord& a, const MaterialRecord& b)
+{
+    return std::memcmp(&a, &b, sizeof(MaterialRecord)) == 0;
+}
+
+bool CheckLayout(const MaterialTable& table)
+{
+    bool passed = sizeof(MaterialRecord) == 48 && offsetof(MaterialRecord, BaseColorFactor) == 0 &&
+        offsetof(MaterialRecord, MetallicFactor) == 16 &&
+        offsetof(MaterialRecord, RoughnessFactor) == 20 &&
+        offsetof(MaterialRecord, BaseColorTexture) == 24 &&
+        offsetof(MaterialRecord, RoughnessTexture) == 28 &&
+        offsetof(MaterialRecord, NormalTexture) == 32;
+
+    std::span<const MaterialRecord> records = table.GetRecords();
+    passed = passed && records.size() == table.GetSize();
+
+    for (uint32_t i = 0; i < records.size(); ++i)
+    {
+        const Material& material = table.Get(i);
+        const MaterialRecord& record = records[i];
+
+        passed = passed && SameRecordBytes(record, MaterialTable::Pack(material)) &&
+            record.BaseColorFactor == material.BaseColorFactor &&
+            (material.BaseColorTextureId < 0 ?
+                 record.BaseColorTexture == NO_TEXTURE_INDEX :
+                 record.BaseColorTexture == static_cast<uint32_t>(material.BaseColorTextureId));
+    }
+
+    return passed;
+}
+
+// Sorted, non-empty, and neither overlapping nor touching.
+bool CheckRangesMerged(const std::vector<MaterialRange>& ranges, size_t tableSize)
+{
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+        if (ranges[i].Count == 0 || ranges[i].First + ranges[i].Count > tableSize)
+            return false;
+
+        if (i > 0 && ranges[i - 1].First + ranges[i - 1].Count >= ranges[i].First)
+            return false;
+    }
+
+    return true;
+}
+
+int RunBenchmark(const Options& options)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    auto numDistinct = static_cast<uint32_t>(options.NumMaterials);
+
+    // Every distinct material, then the adds: each material once, with repeats mixed in.
+    std::vector<Material> distinct;
+    distinct.reserve(numDistinct);
+
+    for (uint32_t i = 0; i < numDistinct; ++i)
+    {
+        distinct.push_back(MakeMaterial(i, &rng));
+    }
+
+    std::vector<uint32_t> addOrder;
+    uint32_t numIntroduced = 0;
+
+    while (numIntroduced < numDistinct)
+    {
+        if (numIntroduced > 0 && unit(rng) < options.DuplicateFraction)
+            addOrder.push_back(static_cast<uint32_t>(rng() % numIntroduced));
+        else
+            addOrder.push_back(numIntroduced++);
+    }
+
+    Checks checks;
+
+    MaterialTable table;
+    std::vector<uint32_t> firstIndex(numDistinct, UINT32_MAX);
+    bool indicesStable = true;
+
+    Clock::time_point start = Clock::now();
+
+    for (uint32_t id : addOrder)
+    {
+        Material material = distinct[id];
+
+        // A repeat with -0 instead of +0 is still the same material.
+        if (firstIndex[id] != UINT32_MAX && material.MetallicFactor == 0.f)
+            material.MetallicFactor = -0.f;
+
+        uint32_t idx = table.Add(material);
+
+        if (firstIndex[id] == UINT32_MAX)
+            firstIndex[id] = idx;
+        else
+            indicesStable = indicesStable && idx == firstIndex[id];
+    }
+
+    double addMs = ElapsedMs(start);
+
+    size_t numDuplicates = addOrder.size() - numDistinct;
+
+    checks.Check("dedup_exact", indicesStable && table.GetSize() == numDistinct &&
+                 table.GetNumDeduplicated() == numDuplicates);
+
+    checks.Check("records_packed", CheckLayout(table));
+
+    // Everything added so far is one dirty range, uploaded in full.
+    std::vector<MaterialRange> ranges;
+    table.TakeDirtyRanges(&ranges);
+
+    checks.Check("initial_upload_one_range", ranges.size() == 1 && ranges[0].First == 0 &&
+                 ranges[0].Count == numDistinct);
+
+    std::vector<MaterialRecord> gpuMirror(table.GetRecords().begin(), table.GetRecords().end());
+
+    bool rangesMerged = true;
+    bool mirrorMatches = true;
+    bool editsFindable = true;
+
+    std::vector<double> editMs;
+    std::vector<double> uploadMs;
+    uint64_t uploadedRecords = 0;
+    uint64_t numRanges = 0;
+
+    for (int frame = 0; frame < options.NumFrames; ++frame)
+    {
+        std::vector<uint32_t> edited;
+
+        start = Clock::now();
+
+        // Half the edits in a few runs of neighbours, as when tweaking one model, and the rest
+        // scattered.
+        for (int i = 0; i < options.NumEditsPerFrame; ++i)
+        {
+            uint32_t idx = i % 2 == 0 ?
+                static_cast<uint32_t>((frame * 7919 + i / 2) % numDistinct) :
+                static_cast<uint32_t>(rng() % numDistinct);
+
+            Material material = table.Get(idx);
+            material.BaseColorFactor.y = unit(rng);
+            material.RoughnessTextureId = static_cast<TextureId>(rng() % 129) - 1;
+
+            table.Set(idx, material);
+            edited.push_back(idx);
+        }
+
+        editMs.push_back(ElapsedMs(start));
+
+        start = Clock::now();
+
+        ranges.clear();
+        table.TakeDirtyRanges(&ranges);
+
+        std::span<const MaterialRecord> records = table.GetRecords();
+
+        for (const MaterialRange& range : ranges)
+        {
+            std::memcpy(gpuMirror.data() + range.First, records.data() + range.First,
+                        range.Count * sizeof(MaterialRecord));
+
+            uploadedRecords += range.Count;
+        }
+
+        uploadMs.push_back(ElapsedMs(start));
+
+        numRanges += ranges.size();
+        rangesMerged = rangesMerged && CheckRangesMerged(ranges, table.GetSize());
+
+        mirrorMatches = mirrorMatches &&
+            std::memcmp(gpuMirror.data(), records.data(), records.size_bytes()) == 0;
+
+        // Edited materials are found again by their new contents.
+        for (size_t i = 0; i < std::min<size_t>(edited.size(), 16); ++i)
+        {
+            size_t before = table.GetSize();
+            uint32_t found = table.Add(table.Get(edited[i]));
+
+            editsFindable = editsFindable && table.GetSize() == before &&
+                SameRecordBytes(records[found], records[edited[i]]);
+        }
+    }
+
+    checks.Check("dirty_ranges_merged", rangesMerged);
+    checks.Check("partial_upload_matches", mirrorMatches);
+    checks.Check("edits_findable", editsFindable);
+
+    double numFrames = static_cast<double>(options.NumFrames);
+    double meanEditMs = 0.0;
+    double meanUploadMs = 0.0;
+
+    for (size_t i = 0; i < editMs.size(); ++i)
+    {
+        meanEditMs += editMs[i] / numFrames;
+        meanUploadMs += uploadMs[i] / numFrames;
+    }
+
+    double packedBytes = static_cast<double>(table.GetSize() * sizeof(MaterialRecord));
+
+    // One 256-byte constant buffer slot per add, as before.
+    double stridedBytes = static_cast<double>(addOrder.size() * 256);
+
+    json results = {
+        {"adds", addOrder.size()},
+        {"materials", table.GetSize()},
+        {"deduplicated", table.GetNumDeduplicated()},
+        {"add_ns", addMs * 1e6 / static_cast<double>(addOrder.size())},
+        {"packed_bytes", packedBytes},
+        {"strided_cbv_bytes", stridedBytes},
+        {"edits_per_frame", options.NumEditsPerFrame},
+        {"frames", options.NumFrames},
+        {"edit_ms_mean", meanEditMs},
+        {"upload_ms_mean", meanUploadMs},
+        {"ranges_per_frame", static_cast<double>(numRanges) / numFrames},
+        {"uploaded_bytes_per_frame",
+         static_cast<double>(uploadedRecords * sizeof(MaterialRecord)) / numFrames},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Material checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
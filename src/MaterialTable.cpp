@@ -0,0 +1,179 @@
+#include "MaterialTable.h"
+
+#include "Hash.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+
+uint32_t ToTextureIndex(TextureId id)
+{
+    return id < 0 ? NO_TEXTURE_INDEX : static_cast<uint32_t>(id);
+}
+
+uint64_t HashRecord(const MaterialRecord& record)
+{
+    Hasher hasher;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        hasher.Add(record.BaseColorFactor[i]);
+    }
+
+    hasher.Add(record.MetallicFactor);
+    hasher.Add(record.RoughnessFactor);
+    hasher.Add(record.BaseColorTexture);
+    hasher.Add(record.RoughnessTexture);
+    hasher.Add(record.NormalTexture);
+
+    return hasher.GetHash();
+}
+
+bool SameRecord(const MaterialRecord& a, const MaterialRecord& b)
+{
+    return a.BaseColorFactor == b.BaseColorFactor && a.MetallicFactor == b.MetallicFactor &&
+        a.RoughnessFactor == b.RoughnessFactor && a.BaseColorTexture == b.BaseColorTexture &&
+        a.RoughnessTexture == b.RoughnessTexture && a.NormalTexture == b.NormalTexture;
+}
+
+} // namespace
+
+uint32_t MaterialTable::Add(const Material& material)
+{
+    MaterialRecord record = Pack(material);
+    uint64_t hash = HashRecord(record);
+
+    auto [begin, end] = m_indicesByHash.equal_range(hash);
+
+    for (auto it = begin; it != end; ++it)
+    {
+        if (SameRecord(m_records[it->second], record))
+        {
+            ++m_numDeduplicated;
+            return it->second;
+        }
+    }
+
+    auto idx = static_cast<uint32_t>(m_records.size());
+
+    m_materials.push_back(material);
+    m_records.push_back(record);
+    m_indicesByHash.emplace(hash, idx);
+
+    MarkDirty(idx);
+
+    return idx;
+}
+
+uint32_t MaterialTable::AddUnique(const Material& material)
+{
+    auto idx = static_cast<uint32_t>(m_records.size());
+
+    m_materials.push_back(material);
+    m_records.push_back(Pack(material));
+
+    MarkDirty(idx);
+
+    return idx;
+}
+
+void MaterialTable::Set(uint32_t idx, const Material& material)
+{
+    assert(idx < m_records.size());
+
+    MaterialRecord record = Pack(material);
+
+    auto [begin, end] = m_indicesByHash.equal_range(HashRecord(m_records[idx]));
+
+    for (auto it = begin; it != end; ++it)
+    {
+        if (it->second == idx)
+        {
+            m_indicesByHash.erase(it);
+            break;
+        }
+    }
+
+    m_materials[idx] = material;
+    m_records[idx] = record;
+    m_indicesByHash.emplace(HashRecord(record), idx);
+
+    MarkDirty(idx);
+}
+
+const Material& MaterialTable::Get(uint32_t idx) const
+{
+    return m_materials[idx];
+}
+
+size_t MaterialTable::GetSize() const
+{
+    return m_records.size();
+}
+
+std::span<const MaterialRecord> MaterialTable::GetRecords() const
+{
+    return m_records;
+}
+
+void MaterialTable::TakeDirtyRanges(std::vector<MaterialRange>* ranges)
+{
+    std::sort(m_dirtyRanges.begin(), m_dirtyRanges.end(),
+              [](const MaterialRange& a, const MaterialRange& b) { return a.First < b.First; });
+
+    size_t firstNew = ranges->size();
+
+    for (const MaterialRange& range : m_dirtyRanges)
+    {
+        if (ranges->size() > firstNew)
+        {
+            MaterialRange& last = ranges->back();
+
+            if (range.First <= last.First + last.Count)
+            {
+                last.Count = std::max(last.Count, range.First + range.Count - last.First);
+                continue;
+            }
+        }
+
+        ranges->push_back(range);
+    }
+
+    m_dirtyRanges.clear();
+}
+
+size_t MaterialTable::GetNumDeduplicated() const
+{
+    return m_numDeduplicated;
+}
+
+MaterialRecord MaterialTable::Pack(const Material& material)
+{
+    MaterialRecord record{};
+    record.BaseColorFactor = material.BaseColorFactor;
+    record.MetallicFactor = material.MetallicFactor;
+    record.RoughnessFactor = material.RoughnessFactor;
+    record.BaseColorTexture = ToTextureIndex(material.BaseColorTextureId);
+    record.RoughnessTexture = ToTextureIndex(material.RoughnessTextureId);
+    record.NormalTexture = ToTextureIndex(material.NormalTextureId);
+
+    return record;
+}
+
+void MaterialTable::MarkDirty(uint32_t idx)
+{
+    if (!m_dirtyRanges.empty())
+    {
+        MaterialRange& last = m_dirtyRanges.back();
+
+        if (idx >= last.First && idx <= last.First + last.Count)
+        {
+            last.Count = std::max(last.Count, idx + 1 - last.First);
+            return;
+        }
+    }
+
+    m_dirtyRanges.push_back({idx, 1});
+}
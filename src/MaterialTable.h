@@ -0,0 +1,87 @@
+#pragma once
+
+#include "ModelData.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// Texture index of a material without that texture.
+constexpr uint32_t NO_TEXTURE_INDEX = UINT32_MAX;
+
+// GPU layout of one material. Matches Material in Shader.hlsl, which reads the table as a
+// StructuredBuffer.
+struct MaterialRecord
+{
+    glm::vec4 BaseColorFactor = glm::vec4(1.f);
+    float MetallicFactor = 1.f;
+    float RoughnessFactor = 1.f;
+
+    // Slots in the texture descriptor heap, or NO_TEXTURE_INDEX.
+    uint32_t BaseColorTexture = NO_TEXTURE_INDEX;
+    uint32_t RoughnessTexture = NO_TEXTURE_INDEX;
+    uint32_t NormalTexture = NO_TEXTURE_INDEX;
+
+    // Keeps every record's BaseColorFactor 16-byte aligned.
+    uint32_t Padding[3] = {};
+};
+
+static_assert(sizeof(MaterialRecord) == 48);
+
+// Consecutive records, [First, First + Count).
+struct MaterialRange
+{
+    uint32_t First = 0;
+    uint32_t Count = 0;
+};
+
+// Every material in use, packed into one array of MaterialRecord that is uploaded as it is.
+// Identical materials are stored once, and records changed since the last upload are tracked as
+// ranges, so edits only re-upload what changed.
+//
+// Not thread-safe.
+class MaterialTable
+{
+public:
+    // Returns the index of an identical material already in the table, or appends it.
+    uint32_t Add(const Material& material);
+
+    // Appends |material| without sharing it, for a material that is about to change, such as one
+    // waiting for its textures. Add() only shares it once it has been Set().
+    uint32_t AddUnique(const Material& material);
+
+    // Changes the material at |idx| for everything that refers to it.
+    void Set(uint32_t idx, const Material& material);
+
+    const Material& Get(uint32_t idx) const;
+
+    size_t GetSize() const;
+
+    std::span<const MaterialRecord> GetRecords() const;
+
+    // Appends the records added or changed since the last call to |ranges|, sorted and with
+    // overlapping and adjacent ranges merged.
+    void TakeDirtyRanges(std::vector<MaterialRange>* ranges);
+
+    // Calls to Add() that found an identical material.
+    size_t GetNumDeduplicated() const;
+
+    static MaterialRecord Pack(const Material& material);
+
+private:
+    void MarkDirty(uint32_t idx);
+
+    std::vector<Material> m_materials;
+    std::vector<MaterialRecord> m_records;
+
+    // Indices of the records with each content hash.
+    std::unordered_multimap<uint64_t, uint32_t> m_indicesByHash;
+
+    // In the order they were marked. Neighbouring marks are merged as they come.
+    std::vector<MaterialRange> m_dirtyRanges;
+
+    size_t m_numDeduplicated = 0;
+};
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "ModelData.h"
+#include "ResourceRegistry.h"
+
 #include <d3d12.h>
 #include <glm/glm.hpp>
 
@@ -17,6 +20,9 @@ struct Primitive
     int MaterialIdx = -1;
 
     int VertexCount;
+
+    glm::vec3 BoundsMin;
+    glm::vec3 BoundsMax;
 };
 
 struct Mesh
@@ -24,23 +30,16 @@ struct Mesh
     std::vector<Primitive> Primitives;
 };
 
-using TextureId = int;
-
-struct Material
-{
-    glm::vec4 BaseColorFactor;
-    float MetallicFactor = 1.f;
-    float RoughnessFactor = 1.f;
-
-    TextureId BaseColorTextureId = -1;
-    TextureId RoughnessTextureId = -1;
-    TextureId NormalTextureId = -1;
-};
-
 struct Model
 {
     std::vector<Mesh> Meshes;
 
+    // When the textures are streamed, their IDs are TextureStreamer stream indices, and the
+    // materials are added to the table with TextureStreamer::AddMaterial().
     std::vector<Material> Materials;
-};
 
+    bool StreamsTextures = false;
+
+    // Keeps the buffers and textures the views and materials refer to loaded.
+    std::vector<ResourceHandle> Resources;
+};
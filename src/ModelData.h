@@ -0,0 +1,77 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+using TextureId = int;
+
+struct Material
+{
+    glm::vec4 BaseColorFactor;
+    float MetallicFactor = 1.f;
+    float RoughnessFactor = 1.f;
+
+    TextureId BaseColorTextureId = -1;
+    TextureId RoughnessTextureId = -1;
+    TextureId NormalTextureId = -1;
+};
+
+// A range of elements within one of ModelData::Buffers.
+struct BufferRange
+{
+    int Buffer = -1;
+
+    size_t ByteOffset = 0;
+    size_t ByteStride = 0;
+
+    uint32_t Count = 0;
+
+    bool IsValid() const
+    {
+        return Buffer >= 0;
+    }
+
+    size_t GetByteSize() const
+    {
+        return ByteStride * Count;
+    }
+};
+
+struct PrimitiveData
+{
+    BufferRange Positions;
+    BufferRange Normals;
+    BufferRange TexCoords;
+    BufferRange Tangents;
+
+    // 16-bit indices.
+    BufferRange Indices;
+
+    int MaterialIdx = -1;
+
+    // Object-space bounds of the positions.
+    glm::vec3 BoundsMin = glm::vec3(0.f);
+    glm::vec3 BoundsMax = glm::vec3(0.f);
+};
+
+struct MeshData
+{
+    std::vector<PrimitiveData> Primitives;
+};
+
+// CPU-side contents of a glTF file, independent of any graphics API. Texture IDs in the materials
+// index into Images.
+struct ModelData
+{
+    std::vector<std::vector<std::byte>> Buffers;
+
+    std::vector<std::filesystem::path> Images;
+
+    std::vector<Material> Materials;
+
+    std::vector<MeshData> Meshes;
+};
@@ -0,0 +1,413 @@
+// Benchmark for the pipeline cache: cold creation, deduplication of concurrent requests and warm
+// starts from the blob store. Uses a fake compiler that burns a configurable amount of CPU per
+// pipeline, so it runs without a GPU. Also checks the cache's invariants and exits with an error
+// if any of them fail.
+
+#include "BenchmarkUtils.h"
+#include "JobSystem.h"
+#include "PipelineCache.h"
+#include "PipelineDesc.h"
+#include "PipelineStore.h"
+
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+using benchmark::ElapsedMs;
+
+struct Options
+{
+    std::string OutPath = "pipeline_benchmark_results.json";
+
+    int NumPipelines = 256;
+
+    // Requests per pipeline, spread over the requesting threads.
+    int NumRequestsPerPipeline = 8;
+    int NumRequestThreads = 4;
+
+    int CompileUs = 2000;
+    int CachedCompileUs = 100;
+
+    int NumThreads = 0;
+};
+
+constexpr const char* USAGE =
+    "Usage: PipelineBenchmark [options]\n"
+    "  --pipelines N       Distinct pipeline descriptions (default 256)\n"
+    "  --requests N        Requests per pipeline (default 8)\n"
+    "  --requesters N      Threads issuing requests (default 4)\n"
+    "  --compile-us N      Fake compile time from scratch (default 2000)\n"
+    "  --cached-us N       Fake compile time from a stored blob (default 100)\n"
+    "  --threads N         Job system threads, 0 for one per core (default 0)\n"
+    "  --out FILE          Results file (default pipeline_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--pipelines")
+            options->NumPipelines = std::stoi(value);
+        else if (arg == "--requests")
+            options->NumRequestsPerPipeline = std::stoi(value);
+        else if (arg == "--requesters")
+            options->NumRequestThreads = std::stoi(value);
+        else if (arg == "--compile-us")
+            options->CompileUs = std::stoi(value);
+        else if (arg == "--cached-us")
+            options->CachedCompileUs = std::stoi(value);
+        else if (arg == "--threads")
+            options->NumThreads = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->NumPipelines > 0 && options->NumRequestsPerPipeline > 0 &&
+        options->NumRequestThreads > 0;
+}
+
+void BusyWait(int us)
+{
+    Clock::time_point end = Clock::now() + std::chrono::microseconds(us);
+
+    while (Clock::now() < end)
+    {
+    }
+}
+
+class FakePipeline : public Pipeline
+{
+public:
+    FakePipeline(uint64_t driverHash, uint64_t descHash)
+        : m_driverHash(driverHash), m_descHash(descHash)
+    {
+    }
+
+    std::vector<std::byte> GetCachedBlob() const override
+    {
+        std::vector<std::byte> blob(2 * sizeof(uint64_t));
+        memcpy(blob.data(), &m_driverHash, sizeof(uint64_t));
+        memcpy(blob.data() + sizeof(uint64_t), &m_descHash, sizeof(uint64_t));
+
+        return blob;
+    }
+
+private:
+    uint64_t m_driverHash;
+    uint64_t m_descHash;
+};
+
+// Blobs record the driver and description they were compiled for, and are rejected like a real
+// driver would if either does not match.
+class FakePipelineCompiler : public PipelineCompiler
+{
+public:
+    FakePipelineCompiler(uint64_t driverHash, const Options& options)
+        : m_driverHash(driverHash), m_options(options)
+    {
+    }
+
+    uint64_t GetDriverHash() const override
+    {
+        return m_driverHash;
+    }
+
+    std::unique_ptr<Pipeline> Compile(const PipelineDesc& desc,
+                                      std::span<const std::byte> cachedBlob) override
+    {
+        uint64_t descHash = desc.Hash();
+
+        if (!cachedBlob.empty())
+        {
+            FakePipeline expected(m_driverHash, descHash);
+            std::vector<std::byte> expectedBlob = expected.GetCachedBlob();
+
+            if (cachedBlob.size() != expectedBlob.size() ||
+                memcmp(cachedBlob.data(), expectedBlob.data(), expectedBlob.size()) != 0)
+            {
+                return nullptr;
+            }
+
+            BusyWait(m_options.CachedCompileUs);
+        }
+        else
+        {
+            BusyWait(m_options.CompileUs);
+        }
+
+        m_numCompileCalls.fetch_add(1, std::memory_order_relaxed);
+
+        return std::make_unique<FakePipeline>(m_driverHash, descHash);
+    }
+
+    uint64_t GetNumCompileCalls() const
+    {
+        return m_numCompileCalls.load(std::memory_order_relaxed);
+    }
+
+private:
+    uint64_t m_driverHash;
+    const Options& m_options;
+
+    std::atomic<uint64_t> m_numCompileCalls = 0;
+};
+
+// Distinct descriptions differ in their shader code and in a few fixed-function states, the way
+// material variants would.
+struct DescSet
+{
+    std::vector<std::vector<uint8_t>> Shaders;
+    std::vector<PipelineDesc> Descs;
+};
+
+DescSet CreateDescs(int numPipelines)
+{
+    constexpr size_t shaderSize = 4096;
+
+    DescSet set;
+    set.Shaders.resize(numPipelines);
+
+    for (int i = 0; i < numPipelines; ++i)
+    {
+        std::vector<uint8_t>& shader = set.Shaders[i];
+        shader.resize(shaderSize);
+
+        for (size_t j = 0; j < shaderSize; ++j)
+        {
+            shader[j] = static_cast<uint8_t>(j * 31 + static_cast<size_t>(i / 4));
+        }
+
+        PipelineDesc desc{};
+        desc.RootSignatureHash = 1;
+        desc.VS = {shader.data(), shader.size()};
+        desc.PS = {shader.data(), shader.size()};
+        desc.InputLayout = {
+            {"POSITION", 0, 6, 0, 0},
+            {"NORMAL", 0, 6, 1, 0}
+        };
+        desc.Raster.Fill = i % 2 == 0 ? FillMode::Solid : FillMode::Wireframe;
+        desc.Blend = i % 4 < 2 ? BlendMode::Opaque : BlendMode::Alpha;
+        desc.RenderTargetFormats[0] = 28;
+        desc.DepthFormat = 40;
+
+        set.Descs.push_back(desc);
+    }
+
+    return set;
+}
+
+void CheckHashing(const DescSet& set, Checks* checks)
+{
+    const PipelineDesc& desc = set.Descs[0];
+
+    // Same content in another buffer.
+    std::vector<uint8_t> shaderCopy = set.Shaders[0];
+    PipelineDesc copy = desc;
+    copy.VS = {shaderCopy.data(), shaderCopy.size()};
+    copy.PS = {shaderCopy.data(), shaderCopy.size()};
+
+    std::string semantic = "POSITION";
+    copy.InputLayout[0].SemanticName = semantic.c_str();
+
+    // Not a bound render target, so it must not matter.
+    copy.RenderTargetFormats[3] = 99;
+
+    checks->Check("hash_ignores_data_location", copy.Hash() == desc.Hash());
+
+    shaderCopy[shaderCopy.size() / 2] ^= 1;
+    checks->Check("hash_covers_shader_code", copy.Hash() != desc.Hash());
+
+    PipelineDesc depthChanged = desc;
+    depthChanged.Depth.DepthFunc = CompareFunc::LessEqual;
+    checks->Check("hash_covers_depth_state", depthChanged.Hash() != desc.Hash());
+
+    PipelineDesc rootSigChanged = desc;
+    rootSigChanged.RootSignatureHash = 2;
+    checks->Check("hash_covers_root_signature", rootSigChanged.Hash() != desc.Hash());
+
+    std::unordered_set<uint64_t> hashes;
+
+    for (const PipelineDesc& variant : set.Descs)
+    {
+        hashes.insert(variant.Hash());
+    }
+
+    checks->Check("variants_hash_distinct", hashes.size() == set.Descs.size());
+}
+
+// Every requester asks for every pipeline, in a different order, and waits for all of them.
+json RunRequests(const Options& options, const DescSet& set, PipelineCompiler* compiler,
+                 PipelineStore* store, JobSystem* jobSystem, PipelineCache::Stats* stats)
+{
+    PipelineCache cache(compiler, jobSystem, store);
+
+    int numPipelines = options.NumPipelines;
+    int requestsPerThread = (options.NumRequestsPerPipeline + options.NumRequestThreads - 1) /
+        options.NumRequestThreads;
+
+    std::atomic<bool> failed = false;
+
+    Clock::time_point start = Clock::now();
+
+    std::vector<std::thread> requesters;
+
+    for (int t = 0; t < options.NumRequestThreads; ++t)
+    {
+        requesters.emplace_back([&, t] {
+            std::vector<PipelineRequest> requests;
+
+            for (int r = 0; r < requestsPerThread; ++r)
+            {
+                for (int i = 0; i < numPipelines; ++i)
+                {
+                    int idx = (i * (2 * t + 1) + r) % numPipelines;
+                    requests.push_back(cache.Request(set.Descs[idx]));
+                }
+            }
+
+            for (const PipelineRequest& request : requests)
+            {
+                if (!request.Wait())
+                    failed = true;
+            }
+        });
+    }
+
+    for (std::thread& requester : requesters)
+    {
+        requester.join();
+    }
+
+    double elapsedMs = ElapsedMs(start);
+
+    *stats = cache.GetStats();
+
+    return {
+        {"elapsed_ms", elapsedMs},
+        {"requests", stats->NumRequests},
+        {"pipelines", stats->NumPipelines},
+        {"compiles", stats->NumCompiles},
+        {"store_hits", stats->NumStoreHits},
+        {"store_rejects", stats->NumStoreRejects},
+        {"failed_requests", failed.load()}
+    };
+}
+
+int RunBenchmark(const Options& options)
+{
+    JobSystem jobSystem(options.NumThreads);
+
+    DescSet set = CreateDescs(options.NumPipelines);
+
+    Checks checks;
+    CheckHashing(set, &checks);
+
+    constexpr uint64_t driverHash = 0x1234;
+
+    FakePipelineCompiler compiler(driverHash, options);
+    PipelineStore store(driverHash);
+
+    uint64_t pipelines = static_cast<uint64_t>(options.NumPipelines);
+
+    // Cold start - nothing stored, so every distinct description compiles exactly once.
+    PipelineCache::Stats coldStats{};
+    json cold = RunRequests(options, set, &compiler, &store, &jobSystem, &coldStats);
+
+    checks.Check("cold_dedup", coldStats.NumPipelines == pipelines &&
+                 coldStats.NumCompiles == pipelines && compiler.GetNumCompileCalls() == pipelines);
+    checks.Check("cold_store_filled", store.GetNumEntries() == pipelines);
+
+    // Warm start - a fresh store loaded from the cold run's, as on the next launch.
+    std::vector<std::byte> storeData = store.Serialize();
+
+    PipelineStore warmStore(driverHash);
+    checks.Check("store_round_trip", warmStore.Deserialize(storeData));
+
+    PipelineCache::Stats warmStats{};
+    json warm = RunRequests(options, set, &compiler, &warmStore, &jobSystem, &warmStats);
+
+    checks.Check("warm_from_store", warmStats.NumStoreHits == pipelines &&
+                 warmStats.NumCompiles == 0);
+
+    // A driver update invalidates the whole store.
+    PipelineStore otherDriverStore(driverHash + 1);
+    checks.Check("store_rejects_other_driver", !otherDriverStore.Deserialize(storeData));
+
+    // Corruption anywhere in a blob is caught by its checksum.
+    std::vector<std::byte> corrupted = storeData;
+    corrupted.back() ^= std::byte{1};
+
+    PipelineStore corruptedStore(driverHash);
+    checks.Check("store_rejects_corruption", !corruptedStore.Deserialize(corrupted));
+
+    std::vector<std::byte> truncated(storeData.begin(), storeData.end() - 1);
+
+    PipelineStore truncatedStore(driverHash);
+    checks.Check("store_rejects_truncation", !truncatedStore.Deserialize(truncated));
+
+    // A blob the driver refuses falls back to a full compile and is replaced.
+    FakePipelineCompiler otherCompiler(driverHash + 1, options);
+
+    PipelineStore mismatchedStore(driverHash);
+    mismatchedStore.Deserialize(storeData);
+
+    PipelineCache::Stats rejectStats{};
+    RunRequests(options, set, &otherCompiler, &mismatchedStore, &jobSystem, &rejectStats);
+
+    checks.Check("rejected_blobs_recompiled", rejectStats.NumStoreRejects == pipelines &&
+                 rejectStats.NumCompiles == pipelines);
+
+    json results = {
+        {"pipelines", options.NumPipelines},
+        {"requests_per_pipeline", options.NumRequestsPerPipeline},
+        {"requesters", options.NumRequestThreads},
+        {"threads", jobSystem.GetThreadCount()},
+        {"compile_us", options.CompileUs},
+        {"cached_compile_us", options.CachedCompileUs},
+        {"store_bytes", storeData.size()},
+        {"cold", cold},
+        {"warm", warm},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Pipeline cache checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
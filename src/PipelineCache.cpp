@@ -0,0 +1,154 @@
+#include "PipelineCache.h"
+
+#include "Profiler.h"
+
+#include <stdexcept>
+#include <utility>
+
+struct PipelineCacheEntry
+{
+    // Copied so that the compile job does not depend on the caller's description.
+    PipelineDesc Desc;
+    uint64_t Hash = 0;
+
+    // Tracks the compile job. Waiting on it is what lets a worker that needs the pipeline help
+    // out with other jobs instead of blocking.
+    JobCounter Counter;
+
+    std::unique_ptr<Pipeline> Result;
+    std::exception_ptr Error;
+
+    std::atomic<bool> Ready = false;
+};
+
+bool PipelineRequest::IsReady() const
+{
+    return m_entry->Ready.load(std::memory_order_acquire);
+}
+
+Pipeline* PipelineRequest::Wait() const
+{
+    if (!IsReady())
+        m_jobSystem->Wait(m_entry->Counter);
+
+    if (m_entry->Error)
+        std::rethrow_exception(m_entry->Error);
+
+    return m_entry->Result.get();
+}
+
+PipelineCache::PipelineCache(PipelineCompiler* compiler, JobSystem* jobSystem,
+                             PipelineStore* store)
+    : m_compiler(compiler), m_jobSystem(jobSystem), m_store(store)
+{
+}
+
+PipelineCache::~PipelineCache()
+{
+    for (auto& [hash, entry] : m_entries)
+    {
+        m_jobSystem->Wait(entry->Counter);
+    }
+}
+
+PipelineRequest PipelineCache::Request(const PipelineDesc& desc)
+{
+    // Hashing reads the shaders, so it happens outside the lock.
+    uint64_t hash = desc.Hash();
+
+    m_numRequests.fetch_add(1, std::memory_order_relaxed);
+
+    PipelineRequest request;
+    request.m_jobSystem = m_jobSystem;
+
+    std::lock_guard lock(m_mutex);
+
+    auto [it, inserted] = m_entries.try_emplace(hash);
+
+    if (inserted)
+    {
+        it->second = std::make_unique<PipelineCacheEntry>();
+
+        PipelineCacheEntry* entry = it->second.get();
+        entry->Desc = desc;
+        entry->Hash = hash;
+
+        // Scheduled under the lock so that the counter is raised before any other thread can
+        // find the entry and wait on it.
+        m_jobSystem->Run([this, entry] { Compile(entry); }, &entry->Counter);
+    }
+
+    request.m_entry = it->second.get();
+
+    return request;
+}
+
+Pipeline* PipelineCache::Get(const PipelineDesc& desc)
+{
+    return Request(desc).Wait();
+}
+
+PipelineCache::Stats PipelineCache::GetStats() const
+{
+    Stats stats{};
+    stats.NumRequests = m_numRequests.load(std::memory_order_relaxed);
+    stats.NumStoreHits = m_numStoreHits.load(std::memory_order_relaxed);
+    stats.NumCompiles = m_numCompiles.load(std::memory_order_relaxed);
+    stats.NumStoreRejects = m_numStoreRejects.load(std::memory_order_relaxed);
+
+    {
+        std::lock_guard lock(m_mutex);
+        stats.NumPipelines = m_entries.size();
+    }
+
+    return stats;
+}
+
+void PipelineCache::Compile(PipelineCacheEntry* entry)
+{
+    PROFILE_SCOPE("PipelineCache::Compile");
+
+    try
+    {
+        std::vector<std::byte> blob;
+
+        if (m_store && m_store->Find(entry->Hash, &blob))
+        {
+            entry->Result = m_compiler->Compile(entry->Desc, blob);
+
+            if (entry->Result)
+            {
+                m_numStoreHits.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                m_numStoreRejects.fetch_add(1, std::memory_order_relaxed);
+                m_store->Remove(entry->Hash);
+            }
+        }
+
+        if (!entry->Result)
+        {
+            entry->Result = m_compiler->Compile(entry->Desc, {});
+
+            if (!entry->Result)
+                throw std::runtime_error("Pipeline compiler returned no pipeline.");
+
+            m_numCompiles.fetch_add(1, std::memory_order_relaxed);
+
+            if (m_store)
+            {
+                blob = entry->Result->GetCachedBlob();
+
+                if (!blob.empty())
+                    m_store->Insert(entry->Hash, std::move(blob));
+            }
+        }
+    }
+    catch (...)
+    {
+        entry->Error = std::current_exception();
+    }
+
+    entry->Ready.store(true, std::memory_order_release);
+}
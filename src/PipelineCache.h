@@ -0,0 +1,117 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "PipelineDesc.h"
+#include "PipelineStore.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// A pipeline created by a PipelineCompiler. Backends derive from this to hold the native object.
+class Pipeline
+{
+public:
+    virtual ~Pipeline() = default;
+
+    // Driver-specific serialized form, which lets the driver skip compilation next time. Empty if
+    // the driver does not support it.
+    virtual std::vector<std::byte> GetCachedBlob() const = 0;
+};
+
+// Creates native pipelines. Called from job system workers, so it must be thread-safe.
+class PipelineCompiler
+{
+public:
+    virtual ~PipelineCompiler() = default;
+
+    // Identifies the driver (and device) that compiled blobs are only valid for.
+    virtual uint64_t GetDriverHash() const = 0;
+
+    // |cachedBlob| is either empty or was returned by Pipeline::GetCachedBlob() under the same
+    // driver hash. Returns nullptr if the driver rejects the blob, and throws on other failures.
+    virtual std::unique_ptr<Pipeline> Compile(const PipelineDesc& desc,
+                                              std::span<const std::byte> cachedBlob) = 0;
+};
+
+struct PipelineCacheEntry;
+
+// Refers to a pipeline being created by a PipelineCache. Valid as long as the cache.
+class PipelineRequest
+{
+public:
+    PipelineRequest() = default;
+
+    bool IsReady() const;
+
+    // Blocks until the pipeline is created, executing other jobs in the meantime. Rethrows the
+    // compiler's exception if creation failed.
+    Pipeline* Wait() const;
+
+private:
+    friend class PipelineCache;
+
+    JobSystem* m_jobSystem = nullptr;
+    PipelineCacheEntry* m_entry = nullptr;
+};
+
+// Creates pipelines on job system workers, keyed by PipelineDesc::Hash(). Each distinct
+// description is compiled once no matter how many threads request it, and pipelines live as long
+// as the cache. With a store, driver blobs are looked up before compiling and added after.
+class PipelineCache
+{
+public:
+    // |store| may be null.
+    PipelineCache(PipelineCompiler* compiler, JobSystem* jobSystem, PipelineStore* store);
+
+    // Waits for outstanding compiles.
+    ~PipelineCache();
+
+    PipelineCache(const PipelineCache&) = delete;
+    PipelineCache& operator=(const PipelineCache&) = delete;
+
+    // Starts creating the pipeline in the background, unless an identical description has been
+    // requested before. Thread-safe.
+    PipelineRequest Request(const PipelineDesc& desc);
+
+    // Request() followed by Wait().
+    Pipeline* Get(const PipelineDesc& desc);
+
+    struct Stats
+    {
+        uint64_t NumRequests = 0;
+
+        // Distinct descriptions, i.e. requests that were not deduplicated.
+        uint64_t NumPipelines = 0;
+
+        // Pipelines created from a stored blob, and those compiled from scratch.
+        uint64_t NumStoreHits = 0;
+        uint64_t NumCompiles = 0;
+
+        // Stored blobs the driver refused, which were then compiled from scratch.
+        uint64_t NumStoreRejects = 0;
+    };
+
+    Stats GetStats() const;
+
+private:
+    void Compile(PipelineCacheEntry* entry);
+
+    PipelineCompiler* m_compiler;
+    JobSystem* m_jobSystem;
+    PipelineStore* m_store;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint64_t, std::unique_ptr<PipelineCacheEntry>> m_entries;
+
+    std::atomic<uint64_t> m_numRequests = 0;
+    std::atomic<uint64_t> m_numStoreHits = 0;
+    std::atomic<uint64_t> m_numCompiles = 0;
+    std::atomic<uint64_t> m_numStoreRejects = 0;
+};
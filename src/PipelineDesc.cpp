@@ -0,0 +1,73 @@
+#include "PipelineDesc.h"
+
+#include "Hash.h"
+
+#include <algorithm>
+#include <string_view>
+
+namespace
+{
+
+// Bumped whenever the hashed fields change, so that persisted pipelines keyed by an old layout
+// are never matched.
+constexpr uint32_t hashVersion = 2;
+
+void AddShader(Hasher* hasher, const ShaderBytecode& shader)
+{
+    hasher->Add(shader.Size);
+    hasher->AddBytes(shader.Data, shader.Size);
+}
+
+} // namespace
+
+uint64_t PipelineDesc::Hash() const
+{
+    Hasher hasher;
+
+    hasher.Add(hashVersion);
+
+    hasher.Add(RootSignatureHash);
+
+    AddShader(&hasher, VS);
+    AddShader(&hasher, PS);
+
+    hasher.Add(InputLayout.size());
+
+    for (const InputElement& element : InputLayout)
+    {
+        hasher.Add(std::string_view(element.SemanticName ? element.SemanticName : ""));
+        hasher.Add(element.SemanticIndex);
+        hasher.Add(element.Format);
+        hasher.Add(element.InputSlot);
+        hasher.Add(element.AlignedByteOffset);
+        hasher.Add(element.InstanceStepRate);
+    }
+
+    hasher.Add(Raster.Fill);
+    hasher.Add(Raster.Cull);
+    hasher.Add(Raster.FrontCounterClockwise);
+    hasher.Add(Raster.DepthClip);
+    hasher.Add(Raster.DepthBias);
+    hasher.Add(Raster.SlopeScaledDepthBias);
+
+    hasher.Add(Blend);
+
+    hasher.Add(Depth.DepthEnable);
+    hasher.Add(Depth.DepthWrite);
+    hasher.Add(Depth.DepthFunc);
+
+    hasher.Add(Topology);
+
+    uint32_t numRenderTargets = std::min<uint32_t>(NumRenderTargets, MAX_RENDER_TARGETS);
+    hasher.Add(numRenderTargets);
+
+    for (uint32_t i = 0; i < numRenderTargets; ++i)
+    {
+        hasher.Add(RenderTargetFormats[i]);
+    }
+
+    hasher.Add(DepthFormat);
+    hasher.Add(SampleCount);
+
+    return hasher.GetHash();
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Formats are DXGI_FORMAT values, kept as plain integers so that descriptions can be built and
+// hashed without the D3D12 headers.
+using PipelineFormat = uint32_t;
+
+enum class FillMode : uint8_t
+{
+    Solid,
+    Wireframe
+};
+
+enum class CullMode : uint8_t
+{
+    None,
+    Front,
+    Back
+};
+
+enum class CompareFunc : uint8_t
+{
+    Never,
+    Less,
+    Equal,
+    LessEqual,
+    Greater,
+    NotEqual,
+    GreaterEqual,
+    Always
+};
+
+enum class BlendMode : uint8_t
+{
+    Opaque,
+    Alpha,
+    Additive
+};
+
+enum class PrimitiveTopology : uint8_t
+{
+    Point,
+    Line,
+    Triangle
+};
+
+// Points at compiled shader code, which must outlive every cache the description is passed to.
+// Generated shader headers provide static arrays for this.
+struct ShaderBytecode
+{
+    const void* Data = nullptr;
+    size_t Size = 0;
+};
+
+struct InputElement
+{
+    // Must outlive the cache, like shader bytecode. String literals are fine.
+    const char* SemanticName = nullptr;
+    uint32_t SemanticIndex = 0;
+
+    PipelineFormat Format = 0;
+
+    uint32_t InputSlot = 0;
+    uint32_t AlignedByteOffset = 0;
+
+    // 0 for per-vertex data. Otherwise per-instance data, advancing every this many instances.
+    uint32_t InstanceStepRate = 0;
+};
+
+// Defaults match D3D12's default rasterizer, blend and depth-stencil states.
+struct RasterState
+{
+    FillMode Fill = FillMode::Solid;
+    CullMode Cull = CullMode::Back;
+
+    bool FrontCounterClockwise = false;
+    bool DepthClip = true;
+
+    int32_t DepthBias = 0;
+    float SlopeScaledDepthBias = 0.f;
+};
+
+struct DepthState
+{
+    bool DepthEnable = true;
+    bool DepthWrite = true;
+
+    CompareFunc DepthFunc = CompareFunc::Less;
+};
+
+// Everything that determines a graphics pipeline. Two descriptions with the same Hash() produce
+// the same pipeline.
+struct PipelineDesc
+{
+    static constexpr size_t MAX_RENDER_TARGETS = 8;
+
+    // Native root signature, e.g. an ID3D12RootSignature. Only RootSignatureHash is hashed, so it
+    // must identify the root signature's contents.
+    void* RootSignature = nullptr;
+    uint64_t RootSignatureHash = 0;
+
+    ShaderBytecode VS;
+    ShaderBytecode PS;
+
+    std::vector<InputElement> InputLayout;
+
+    RasterState Raster;
+    BlendMode Blend = BlendMode::Opaque;
+    DepthState Depth;
+
+    PrimitiveTopology Topology = PrimitiveTopology::Triangle;
+
+    uint32_t NumRenderTargets = 1;
+    std::array<PipelineFormat, MAX_RENDER_TARGETS> RenderTargetFormats{};
+    PipelineFormat DepthFormat = 0;
+
+    uint32_t SampleCount = 1;
+
+    // Canonical hash of the description. Shaders and semantic names are hashed by content and
+    // unused render target slots are ignored, so equal descriptions hash equal regardless of
+    // where their data lives. Stable across runs, so it can key persisted pipelines.
+    uint64_t Hash() const;
+};
@@ -0,0 +1,240 @@
+#include "PipelineStore.h"
+
+#include "Hash.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace
+{
+
+constexpr char fileMagic[4] = {'G', 'P', 'S', 'O'};
+constexpr uint32_t fileVersion = 1;
+
+void WriteBytes(std::vector<std::byte>* data, const void* src, size_t size)
+{
+    const std::byte* bytes = static_cast<const std::byte*>(src);
+    data->insert(data->end(), bytes, bytes + size);
+}
+
+template<typename T>
+void WriteValue(std::vector<std::byte>* data, T value)
+{
+    WriteBytes(data, &value, sizeof(value));
+}
+
+// Unlike the input recording reader, running out of data is not exceptional here - a truncated
+// store is simply discarded.
+class Reader
+{
+public:
+    explicit Reader(std::span<const std::byte> data)
+        : m_data(data)
+    {
+    }
+
+    bool ReadBytes(void* dst, size_t size)
+    {
+        if (m_data.size() - m_pos < size)
+            return false;
+
+        memcpy(dst, m_data.data() + m_pos, size);
+        m_pos += size;
+
+        return true;
+    }
+
+    template<typename T>
+    bool ReadValue(T* value)
+    {
+        return ReadBytes(value, sizeof(T));
+    }
+
+    bool ReadSpan(size_t size, std::span<const std::byte>* span)
+    {
+        if (m_data.size() - m_pos < size)
+            return false;
+
+        *span = m_data.subspan(m_pos, size);
+        m_pos += size;
+
+        return true;
+    }
+
+    bool IsAtEnd() const
+    {
+        return m_pos == m_data.size();
+    }
+
+private:
+    std::span<const std::byte> m_data;
+    size_t m_pos = 0;
+};
+
+} // namespace
+
+PipelineStore::PipelineStore(uint64_t driverHash)
+    : m_driverHash(driverHash)
+{
+}
+
+bool PipelineStore::Load(const std::filesystem::path& path)
+{
+    std::ifstream strm(path, std::ios::binary);
+    if (!strm.is_open())
+        return false;
+
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(path, error);
+
+    if (error)
+        return false;
+
+    std::vector<std::byte> data(size);
+
+    if (!strm.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(size)))
+        return false;
+
+    return Deserialize(data);
+}
+
+void PipelineStore::Save(const std::filesystem::path& path) const
+{
+    std::vector<std::byte> data = Serialize();
+
+    // Written next to the destination and renamed over it, so that a crash mid-write cannot
+    // leave a truncated store behind.
+    std::filesystem::path tempPath = path;
+    tempPath += ".tmp";
+
+    {
+        std::ofstream strm(tempPath, std::ios::binary);
+        if (!strm.is_open())
+            throw std::runtime_error("Could not open file.");
+
+        strm.write(reinterpret_cast<const char*>(data.data()),
+                   static_cast<std::streamsize>(data.size()));
+
+        if (!strm)
+            throw std::runtime_error("Could not write file.");
+    }
+
+    std::filesystem::rename(tempPath, path);
+}
+
+std::vector<std::byte> PipelineStore::Serialize() const
+{
+    std::lock_guard lock(m_mutex);
+
+    uint64_t numEntries = 0;
+
+    for (const auto& [key, entry] : m_entries)
+    {
+        if (entry.Used)
+            ++numEntries;
+    }
+
+    std::vector<std::byte> data;
+
+    WriteBytes(&data, fileMagic, sizeof(fileMagic));
+    WriteValue(&data, fileVersion);
+    WriteValue(&data, m_driverHash);
+    WriteValue(&data, numEntries);
+
+    for (const auto& [key, entry] : m_entries)
+    {
+        if (!entry.Used)
+            continue;
+
+        WriteValue(&data, key);
+        WriteValue(&data, static_cast<uint64_t>(entry.Blob.size()));
+        WriteValue(&data, HashBytes(entry.Blob));
+        WriteBytes(&data, entry.Blob.data(), entry.Blob.size());
+    }
+
+    return data;
+}
+
+bool PipelineStore::Deserialize(std::span<const std::byte> data)
+{
+    Reader reader(data);
+
+    char magic[sizeof(fileMagic)];
+    uint32_t version = 0;
+    uint64_t driverHash = 0;
+    uint64_t numEntries = 0;
+
+    if (!reader.ReadBytes(magic, sizeof(magic)) || memcmp(magic, fileMagic, sizeof(magic)) != 0 ||
+        !reader.ReadValue(&version) || version != fileVersion ||
+        !reader.ReadValue(&driverHash) || driverHash != m_driverHash ||
+        !reader.ReadValue(&numEntries))
+    {
+        return false;
+    }
+
+    std::unordered_map<uint64_t, Entry> entries;
+
+    for (uint64_t i = 0; i < numEntries; ++i)
+    {
+        uint64_t key = 0;
+        uint64_t size = 0;
+        uint64_t checksum = 0;
+        std::span<const std::byte> blob;
+
+        if (!reader.ReadValue(&key) || !reader.ReadValue(&size) || !reader.ReadValue(&checksum) ||
+            !reader.ReadSpan(static_cast<size_t>(size), &blob) || HashBytes(blob) != checksum)
+        {
+            return false;
+        }
+
+        entries[key].Blob.assign(blob.begin(), blob.end());
+    }
+
+    if (!reader.IsAtEnd())
+        return false;
+
+    std::lock_guard lock(m_mutex);
+    m_entries = std::move(entries);
+
+    return true;
+}
+
+bool PipelineStore::Find(uint64_t key, std::vector<std::byte>* blob)
+{
+    std::lock_guard lock(m_mutex);
+
+    auto it = m_entries.find(key);
+
+    if (it == m_entries.end())
+        return false;
+
+    it->second.Used = true;
+    *blob = it->second.Blob;
+
+    return true;
+}
+
+void PipelineStore::Insert(uint64_t key, std::vector<std::byte> blob)
+{
+    std::lock_guard lock(m_mutex);
+
+    Entry& entry = m_entries[key];
+    entry.Blob = std::move(blob);
+    entry.Used = true;
+}
+
+void PipelineStore::Remove(uint64_t key)
+{
+    std::lock_guard lock(m_mutex);
+
+    m_entries.erase(key);
+}
+
+size_t PipelineStore::GetNumEntries() const
+{
+    std::lock_guard lock(m_mutex);
+
+    return m_entries.size();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// Persistent store of driver-compiled pipeline blobs, keyed by PipelineDesc::Hash(). The key
+// covers the shaders' contents, so a rebuilt shader never matches a stale blob. The file records
+// the hash of the driver that produced it and is ignored under any other driver. Thread-safe.
+class PipelineStore
+{
+public:
+    explicit PipelineStore(uint64_t driverHash);
+
+    // Returns false, leaving the store unchanged, if the file is missing, from another driver or
+    // corrupt. The store is only a cache, so none of these are errors.
+    bool Load(const std::filesystem::path& path);
+
+    // Only entries found or inserted since loading are written, so blobs for pipelines that are
+    // no longer requested - e.g. after a shader change - are dropped.
+    void Save(const std::filesystem::path& path) const;
+
+    std::vector<std::byte> Serialize() const;
+    bool Deserialize(std::span<const std::byte> data);
+
+    bool Find(uint64_t key, std::vector<std::byte>* blob);
+
+    void Insert(uint64_t key, std::vector<std::byte> blob);
+
+    // Drops a blob the driver refused to create a pipeline from.
+    void Remove(uint64_t key);
+
+    size_t GetNumEntries() const;
+
+private:
+    struct Entry
+    {
+        std::vector<std::byte> Blob;
+
+        bool Used = false;
+    };
+
+    uint64_t m_driverHash;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint64_t, Entry> m_entries;
+};
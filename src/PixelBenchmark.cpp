@@ -0,0 +1,491 @@
+// Benchmark for the pixel conversion kernels. Checks that every SIMD level supported by the CPU
+// produces exactly the scalar output, and that the scalar kernels match their definitions, then
+// measures throughput per kernel and level. Also compares staging a texture the old way, through
+// a tightly packed intermediate image, with converting straight into pitched memory. Exits with
+// an error if any check fails.
+
+#include "BenchmarkUtils.h"
+#include "PixelKernels.h"
+#include "Utils.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+using benchmark::MeasureMs;
+
+struct Options
+{
+    std::string OutPath = "pixel_benchmark_results.json";
+
+    uint32_t Width = 2048;
+    uint32_t Height = 2048;
+
+    int NumIterations = 10;
+};
+
+constexpr const char* USAGE =
+    "Usage: PixelBenchmark [options]\n"
+    "  --width N           Image width in pixels (default 2048)\n"
+    "  --height N          Image height in pixels (default 2048)\n"
+    "  --iterations N      Timed runs per kernel, the fastest is reported (default 10)\n"
+    "  --out FILE          Results file (default pixel_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--width")
+            options->Width = static_cast<uint32_t>(std::stoul(value));
+        else if (arg == "--height")
+            options->Height = static_cast<uint32_t>(std::stoul(value));
+        else if (arg == "--iterations")
+            options->NumIterations = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->Width > 0 && options->Height > 0 && options->NumIterations > 0;
+}
+
+std::vector<uint8_t> RandomBytes(size_t size, std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> dist(0, 255);
+
+    std::vector<uint8_t> bytes(size);
+
+    for (uint8_t& byte : bytes)
+    {
+        byte = static_cast<uint8_t>(dist(rng));
+    }
+
+    return bytes;
+}
+
+// Mostly in [0, 1], with some values out of range and a few that are not finite.
+std::vector<float> RandomFloats(size_t size, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> dist(-0.1f, 1.1f);
+
+    std::vector<float> floats(size);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        switch (i % 97)
+        {
+            case 13:
+                floats[i] = std::numeric_limits<float>::quiet_NaN();
+                break;
+            case 29:
+                floats[i] = std::numeric_limits<float>::infinity();
+                break;
+            case 61:
+                floats[i] = -0.f;
+                break;
+            default:
+                floats[i] = dist(rng);
+                break;
+        }
+    }
+
+    return floats;
+}
+
+double EncodeSrgbExact(double value)
+{
+    value = std::clamp(value, 0.0, 1.0);
+
+    return value <= 0.0031308 ? value * 12.92 : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+}
+
+void CheckDefinitions(const PixelKernels& scalar, Checks* checks)
+{
+    // Every color and alpha combination.
+    std::vector<uint8_t> pixels(256 * 256 * 4);
+
+    for (uint32_t i = 0; i < 256 * 256; ++i)
+    {
+        pixels[4 * i + 0] = static_cast<uint8_t>(i & 0xff);
+        pixels[4 * i + 1] = static_cast<uint8_t>(255 - (i & 0xff));
+        pixels[4 * i + 2] = static_cast<uint8_t>(i & 0xff);
+        pixels[4 * i + 3] = static_cast<uint8_t>(i >> 8);
+    }
+
+    std::vector<uint8_t> premultiplied(pixels.size());
+    scalar.PremultiplyAlpha(pixels.data(), premultiplied.data(), 256 * 256);
+
+    bool premultiplyExact = true;
+
+    for (uint32_t i = 0; i < 256 * 256 * 4; ++i)
+    {
+        double alpha = pixels[i | 3];
+        double expected = i % 4 == 3 ? alpha : std::round(pixels[i] * alpha / 255.0);
+
+        premultiplyExact = premultiplyExact && premultiplied[i] == expected;
+    }
+
+    checks->Check("premultiply_rounds_to_nearest", premultiplyExact);
+
+    // Every 8-bit value survives a round trip through linear.
+    std::vector<uint8_t> codes(256 * 4);
+
+    for (uint32_t i = 0; i < 256 * 4; ++i)
+    {
+        codes[i] = static_cast<uint8_t>(i / 4);
+    }
+
+    std::vector<float> linear(codes.size());
+    std::vector<uint8_t> roundTrip(codes.size());
+    scalar.SrgbToLinear(codes.data(), linear.data(), 256);
+    scalar.LinearToSrgb(linear.data(), roundTrip.data(), 256);
+
+    checks->Check("srgb_round_trip", roundTrip == codes);
+
+    // A dense sweep of linear values against the exact curve.
+    constexpr uint32_t numSteps = 1 << 20;
+
+    std::vector<float> sweep(numSteps * 4);
+
+    for (uint32_t i = 0; i < numSteps * 4; ++i)
+    {
+        sweep[i] = static_cast<float>(i / 4) / (numSteps - 1);
+    }
+
+    std::vector<uint8_t> encoded(sweep.size());
+    scalar.LinearToSrgb(sweep.data(), encoded.data(), numSteps);
+
+    bool encodeExact = true;
+
+    for (uint32_t i = 0; i < numSteps * 4; ++i)
+    {
+        double value = sweep[i];
+        double expected = std::round(255.0 * (i % 4 == 3 ? value : EncodeSrgbExact(value)));
+
+        encodeExact = encodeExact && encoded[i] == expected;
+    }
+
+    checks->Check("linear_to_srgb_rounds_to_nearest", encodeExact);
+}
+
+// Runs |kernel| for both levels on the same input at a range of lengths and source alignments.
+// Lengths below 100 cover every tail case of every vector width.
+template<typename Src, typename Dst>
+bool MatchesScalar(const std::vector<Src>& input, size_t srcStride, size_t dstStride,
+                   const std::function<void(const Src*, Dst*, size_t)>& scalar,
+                   const std::function<void(const Src*, Dst*, size_t)>& simd)
+{
+    std::vector<size_t> lengths;
+
+    for (size_t n = 0; n < 100; ++n)
+    {
+        lengths.push_back(n);
+    }
+
+    lengths.push_back(4099);
+
+    for (size_t offset = 0; offset < 2; ++offset)
+    {
+        for (size_t n : lengths)
+        {
+            const Src* src = input.data() + offset * srcStride;
+
+            std::vector<Dst> expected(n * dstStride);
+            std::vector<Dst> actual(n * dstStride);
+
+            scalar(src, expected.data(), n);
+            simd(src, actual.data(), n);
+
+            if (actual != expected)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// In-place conversion must give the same result as out of place.
+bool MatchesInPlace(const std::vector<uint8_t>& input,
+                    void (*kernel)(const uint8_t*, uint8_t*, size_t))
+{
+    size_t numPixels = input.size() / 4;
+
+    std::vector<uint8_t> expected(input.size());
+    kernel(input.data(), expected.data(), numPixels);
+
+    std::vector<uint8_t> inPlace = input;
+    kernel(inPlace.data(), inPlace.data(), numPixels);
+
+    return inPlace == expected;
+}
+
+void CheckLevel(const PixelKernels& scalar, const PixelKernels& simd, Checks* checks)
+{
+    std::mt19937 rng(1234);
+
+    // Enough for the longest length at the largest stride, plus an offset.
+    std::vector<uint8_t> bytes = RandomBytes(4 * 4100, rng);
+    std::vector<float> floats = RandomFloats(4 * 4100, rng);
+
+    std::string prefix = std::string(GetSimdLevelName(simd.Level)) + "_";
+
+    using ByteKernel = std::function<void(const uint8_t*, uint8_t*, size_t)>;
+
+    checks->Check(prefix + "bgr_to_rgba",
+                  MatchesScalar<uint8_t, uint8_t>(bytes, 3, 4, scalar.BgrToRgba, simd.BgrToRgba));
+    checks->Check(prefix + "rgb_to_rgba",
+                  MatchesScalar<uint8_t, uint8_t>(bytes, 3, 4, scalar.RgbToRgba, simd.RgbToRgba));
+    checks->Check(prefix + "swap_red_blue",
+                  MatchesScalar<uint8_t, uint8_t>(bytes, 4, 4, scalar.SwapRedBlue,
+                                                  simd.SwapRedBlue) &&
+                  MatchesInPlace(bytes, simd.SwapRedBlue));
+    checks->Check(prefix + "premultiply_alpha",
+                  MatchesScalar<uint8_t, uint8_t>(bytes, 4, 4, scalar.PremultiplyAlpha,
+                                                  simd.PremultiplyAlpha) &&
+                  MatchesInPlace(bytes, simd.PremultiplyAlpha));
+    checks->Check(prefix + "srgb_to_linear",
+                  MatchesScalar<uint8_t, float>(bytes, 4, 4, scalar.SrgbToLinear,
+                                                simd.SrgbToLinear));
+    checks->Check(prefix + "linear_to_srgb",
+                  MatchesScalar<float, uint8_t>(floats, 4, 4, scalar.LinearToSrgb,
+                                                simd.LinearToSrgb));
+
+    bool extractMatches = true;
+
+    for (uint32_t channel = 0; channel < 4; ++channel)
+    {
+        ByteKernel scalarExtract = [&](const uint8_t* src, uint8_t* dst, size_t n) {
+            scalar.ExtractChannel(src, dst, n, channel);
+        };
+        ByteKernel simdExtract = [&](const uint8_t* src, uint8_t* dst, size_t n) {
+            simd.ExtractChannel(src, dst, n, channel);
+        };
+
+        extractMatches = extractMatches &&
+            MatchesScalar<uint8_t, uint8_t>(bytes, 4, 1, scalarExtract, simdExtract);
+    }
+
+    checks->Check(prefix + "extract_channel", extractMatches);
+}
+
+// Fastest of |numIterations| runs over the whole image, in GB/s of source plus destination.
+double MeasureGbPerSec(int numIterations, size_t bytesPerRun, const std::function<void()>& run)
+{
+    double bestSec = std::numeric_limits<double>::max();
+
+    for (int i = 0; i < numIterations; ++i)
+    {
+        Clock::time_point start = Clock::now();
+        run();
+        bestSec = std::min(bestSec, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+
+    return static_cast<double>(bytesPerRun) / bestSec / 1e9;
+}
+
+struct Images
+{
+    std::vector<uint8_t> Rgb;
+    std::vector<uint8_t> Rgba;
+    std::vector<float> Linear;
+
+    std::vector<uint8_t> RgbaOut;
+    std::vector<float> LinearOut;
+    std::vector<uint8_t> ChannelOut;
+};
+
+json MeasureLevel(const Options& options, const PixelKernels& kernels, Images* images)
+{
+    size_t width = options.Width;
+    size_t height = options.Height;
+    size_t numPixels = width * height;
+
+    // Converted row by row, as the texture loader does.
+    auto perRow = [&](size_t srcStride, size_t dstStride, auto* src, auto* dst, auto&& kernel) {
+        return [=] {
+            for (size_t y = 0; y < height; ++y)
+            {
+                kernel(src + y * width * srcStride, dst + y * width * dstStride, width);
+            }
+        };
+    };
+
+    int n = options.NumIterations;
+
+    uint8_t* rgbaOut = images->RgbaOut.data();
+
+    json results = {
+        {"bgr_to_rgba", MeasureGbPerSec(n, numPixels * 7, perRow(3, 4, images->Rgb.data(),
+                                                                rgbaOut, kernels.BgrToRgba))},
+        {"rgb_to_rgba", MeasureGbPerSec(n, numPixels * 7, perRow(3, 4, images->Rgb.data(),
+                                                                rgbaOut, kernels.RgbToRgba))},
+        {"swap_red_blue", MeasureGbPerSec(n, numPixels * 8, perRow(4, 4, images->Rgba.data(),
+                                                                  rgbaOut, kernels.SwapRedBlue))},
+        {"premultiply_alpha",
+         MeasureGbPerSec(n, numPixels * 8, perRow(4, 4, images->Rgba.data(), rgbaOut,
+                                                  kernels.PremultiplyAlpha))},
+        {"srgb_to_linear",
+         MeasureGbPerSec(n, numPixels * 20, perRow(4, 4, images->Rgba.data(),
+                                                   images->LinearOut.data(),
+                                                   kernels.SrgbToLinear))},
+        {"linear_to_srgb",
+         MeasureGbPerSec(n, numPixels * 20, perRow(4, 4, images->Linear.data(), rgbaOut,
+                                                   kernels.LinearToSrgb))},
+        {"extract_channel",
+         MeasureGbPerSec(n, numPixels * 5,
+                         perRow(4, 1, images->Rgba.data(), images->ChannelOut.data(),
+                                [&](const uint8_t* src, uint8_t* dst, size_t count) {
+                                    kernels.ExtractChannel(src, dst, count, 1);
+                                }))}
+    };
+
+    return results;
+}
+
+// Staging a decoded 24-bit image for upload. The old path converted the whole image into a
+// tightly packed RGBA copy and then copied that into the pitched upload rows. The new one
+// converts small bands of decoded rows straight into the pitched rows.
+json MeasureStaging(const Options& options, const PixelKernels& kernels, const Images& images)
+{
+    constexpr size_t rowPitchAlignment = 256;
+    constexpr size_t bandRows = 16;
+
+    size_t width = options.Width;
+    size_t height = options.Height;
+    size_t rowSize = width * 4;
+    size_t rowPitch = utils::Align(rowSize, rowPitchAlignment);
+
+    std::vector<uint8_t> staging(rowPitch * height);
+    std::vector<uint8_t> tight(rowSize * height);
+    std::vector<uint8_t> band(width * 3 * bandRows);
+
+    const PixelKernels& scalar = GetPixelKernels(SimdLevel::Scalar);
+
+    auto bestMs = [&](const std::function<void()>& run) {
+        return MeasureMs(options.NumIterations, run);
+    };
+
+    double twoPassMs = bestMs([&] {
+        scalar.BgrToRgba(images.Rgb.data(), tight.data(), width * height);
+
+        for (size_t y = 0; y < height; ++y)
+        {
+            memcpy(staging.data() + y * rowPitch, tight.data() + y * rowSize, rowSize);
+        }
+    });
+
+    // The band copy stands in for the decoder writing its output rows.
+    double directMs = bestMs([&] {
+        for (size_t y = 0; y < height; y += bandRows)
+        {
+            size_t numRows = std::min(bandRows, height - y);
+            memcpy(band.data(), images.Rgb.data() + y * width * 3, numRows * width * 3);
+
+            for (size_t row = 0; row < numRows; ++row)
+            {
+                kernels.BgrToRgba(band.data() + row * width * 3,
+                                  staging.data() + (y + row) * rowPitch, width);
+            }
+        }
+    });
+
+    return {
+        {"row_pitch", rowPitch},
+        {"intermediate_image_ms", twoPassMs},
+        {"direct_ms", directMs}
+    };
+}
+
+int RunBenchmark(const Options& options)
+{
+    const PixelKernels& scalar = GetPixelKernels(SimdLevel::Scalar);
+
+    Checks checks;
+    CheckDefinitions(scalar, &checks);
+
+    std::vector<const PixelKernels*> levels;
+
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2, SimdLevel::Neon})
+    {
+        if (IsSimdLevelSupported(level))
+            levels.push_back(&GetPixelKernels(level));
+    }
+
+    for (const PixelKernels* kernels : levels)
+    {
+        if (kernels->Level != SimdLevel::Scalar)
+            CheckLevel(scalar, *kernels, &checks);
+    }
+
+    size_t numPixels = static_cast<size_t>(options.Width) * options.Height;
+
+    std::mt19937 rng(5678);
+
+    Images images;
+    images.Rgb = RandomBytes(numPixels * 3, rng);
+    images.Rgba = RandomBytes(numPixels * 4, rng);
+    images.Linear = RandomFloats(numPixels * 4, rng);
+    images.RgbaOut.resize(numPixels * 4);
+    images.LinearOut.resize(numPixels * 4);
+    images.ChannelOut.resize(numPixels);
+
+    json gbPerSec = json::object();
+
+    for (const PixelKernels* kernels : levels)
+    {
+        gbPerSec[GetSimdLevelName(kernels->Level)] = MeasureLevel(options, *kernels, &images);
+    }
+
+    const PixelKernels& best = GetPixelKernels();
+
+    json results = {
+        {"width", options.Width},
+        {"height", options.Height},
+        {"iterations", options.NumIterations},
+        {"selected_level", GetSimdLevelName(best.Level)},
+        {"gb_per_sec", gbPerSec},
+        {"staging", MeasureStaging(options, best, images)},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Pixel kernel checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
@@ -0,0 +1,807 @@
+#include "PixelKernels.h"
+
+#include "DecoderKernels.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+
+// Buckets of linear values used by LinearToSrgb. They must be narrower than the smallest gap
+// between two rounding thresholds, which is about 1/3300 at the dark end of the curve.
+constexpr int NUM_LINEAR_BUCKETS = 4096;
+
+double DecodeSrgb(double value)
+{
+    return value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+}
+
+struct SrgbTables
+{
+    // Color codes at [0, 256) and alpha at [256, 512), so that one gather covers a whole pixel.
+    float ToLinear[512];
+
+    // The code at the start of each bucket, and the value at which the next code starts. A bucket
+    // holds at most one such threshold, so the code of any value is one lookup and one comparison
+    // away. Color buckets come first and alpha buckets second, as above.
+    int32_t BucketCode[2 * NUM_LINEAR_BUCKETS];
+    float BucketThreshold[2 * NUM_LINEAR_BUCKETS];
+
+    SrgbTables()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            ToLinear[i] = static_cast<float>(DecodeSrgb(i / 255.0));
+            ToLinear[256 + i] = static_cast<float>(i / 255.0);
+        }
+
+        FillBuckets(BucketCode, BucketThreshold, DecodeSrgb);
+        FillBuckets(BucketCode + NUM_LINEAR_BUCKETS, BucketThreshold + NUM_LINEAR_BUCKETS,
+                    [](double value) { return value; });
+    }
+
+    static void FillBuckets(int32_t* codes, float* bucketThresholds, double (*decode)(double))
+    {
+        // Floats at or above thresholds[i] round to code i or higher. Each threshold is the
+        // smallest float not below the exact midpoint between two codes. Padded past the last code
+        // so that the assert below can look two ahead.
+        float thresholds[258];
+        thresholds[0] = 0.f;
+        thresholds[256] = 2.f;
+        thresholds[257] = 2.f;
+
+        for (int i = 1; i < 256; ++i)
+        {
+            double midpoint = decode((i - 0.5) / 255.0);
+
+            thresholds[i] = static_cast<float>(midpoint);
+
+            if (thresholds[i] < midpoint)
+                thresholds[i] = std::nextafter(thresholds[i], 2.f);
+        }
+
+        int code = 0;
+
+        for (int i = 0; i < NUM_LINEAR_BUCKETS; ++i)
+        {
+            float start = static_cast<float>(i) / NUM_LINEAR_BUCKETS;
+
+            while (thresholds[code + 1] <= start)
+                ++code;
+
+            // Every bucket holds at most one threshold.
+            assert(thresholds[code + 2] >= static_cast<float>(i + 1) / NUM_LINEAR_BUCKETS);
+
+            codes[i] = code;
+            bucketThresholds[i] = thresholds[code + 1];
+        }
+    }
+};
+
+const SrgbTables& GetSrgbTables()
+{
+    static const SrgbTables tables;
+
+    return tables;
+}
+
+// Scalar reference versions. The SIMD versions use them for the pixels that do not fill a whole
+// vector.
+
+void BgrToRgbaScalar(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+        dst[4 * i + 0] = src[3 * i + 2];
+        dst[4 * i + 1] = src[3 * i + 1];
+        dst[4 * i + 2] = src[3 * i + 0];
+        dst[4 * i + 3] = 255;
+    }
+}
+
+void RgbToRgbaScalar(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+        dst[4 * i + 0] = src[3 * i + 0];
+        dst[4 * i + 1] = src[3 * i + 1];
+        dst[4 * i + 2] = src[3 * i + 2];
+        dst[4 * i + 3] = 255;
+    }
+}
+
+void SwapRedBlueScalar(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+        uint8_t first = src[4 * i + 0];
+        uint8_t third = src[4 * i + 2];
+
+        dst[4 * i + 0] = third;
+        dst[4 * i + 1] = src[4 * i + 1];
+        dst[4 * i + 2] = first;
+        dst[4 * i + 3] = src[4 * i + 3];
+    }
+}
+
+void PremultiplyAlphaScalar(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+        uint32_t alpha = src[4 * i + 3];
+
+        for (int c = 0; c < 3; ++c)
+        {
+            dst[4 * i + c] = static_cast<uint8_t>((src[4 * i + c] * alpha + 127) / 255);
+        }
+
+        dst[4 * i + 3] = static_cast<uint8_t>(alpha);
+    }
+}
+
+void SrgbToLinearScalar(const uint8_t* src, float* dst, size_t numPixels)
+{
+    const SrgbTables& tables = GetSrgbTables();
+
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+        dst[4 * i + 0] = tables.ToLinear[src[4 * i + 0]];
+        dst[4 * i + 1] = tables.ToLinear[src[4 * i + 1]];
+        dst[4 * i + 2] = tables.ToLinear[src[4 * i + 2]];
+        dst[4 * i + 3] = tables.ToLinear[256 + src[4 * i + 3]];
+    }
+}
+
+// Written so that NaNs end up as 0, the same as the SIMD min and max instructions.
+float Saturate(float value)
+{
+    value = value > 0.f ? value : 0.f;
+    return value < 1.f ? value : 1.f;
+}
+
+// |offset| selects the color or alpha buckets.
+uint8_t Encode(float value, int offset, const SrgbTables& tables)
+{
+    value = Saturate(value);
+
+    int bucket = std::min(static_cast<int>(value * NUM_LINEAR_BUCKETS), NUM_LINEAR_BUCKETS - 1);
+    bucket += offset;
+
+    int code = tables.BucketCode[bucket] + (value >= tables.BucketThreshold[bucket] ? 1 : 0);
+
+    return static_cast<uint8_t>(code);
+}
+
+void LinearToSrgbScalar(const float* src, uint8_t* dst, size_t numPixels)
+{
+    const SrgbTables& tables = GetSrgbTables();
+
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+        dst[4 * i + 0] = Encode(src[4 * i + 0], 0, tables);
+        dst[4 * i + 1] = Encode(src[4 * i + 1], 0, tables);
+        dst[4 * i + 2] = Encode(src[4 * i + 2], 0, tables);
+        dst[4 * i + 3] = Encode(src[4 * i + 3], NUM_LINEAR_BUCKETS, tables);
+    }
+}
+
+void ExtractChannelScalar(const uint8_t* src, uint8_t* dst, size_t numPixels, uint32_t channel)
+{
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+        dst[i] = src[4 * i + channel];
+    }
+}
+
+#if defined(GRFX_SIMD_X86)
+
+bool CpuSupportsSse41()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+
+    return (info[2] & (1 << 19)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+bool CpuSupportsAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+
+    if (info[0] < 7)
+        return false;
+
+    __cpuid(info, 1);
+
+    // The OS must also preserve the YMM registers across context switches.
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// SSE4.1
+
+// Loads 16 bytes for every 12 it uses, so it stops early enough not to read past the row.
+// Returns the number of pixels converted.
+TARGET_SSE41 size_t ExpandToRgbaSse41(const uint8_t* src, uint8_t* dst, size_t numPixels,
+                                      __m128i shuffle)
+{
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000u));
+
+    size_t i = 0;
+
+    for (; i + 6 <= numPixels; i += 4)
+    {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * i));
+        px = _mm_or_si128(_mm_shuffle_epi8(px, shuffle), alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * i), px);
+    }
+
+    return i;
+}
+
+TARGET_SSE41 void BgrToRgbaSse41(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+
+    size_t i = ExpandToRgbaSse41(src, dst, numPixels, shuffle);
+    BgrToRgbaScalar(src + 3 * i, dst + 4 * i, numPixels - i);
+}
+
+TARGET_SSE41 void RgbToRgbaSse41(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+    size_t i = ExpandToRgbaSse41(src, dst, numPixels, shuffle);
+    RgbToRgbaScalar(src + 3 * i, dst + 4 * i, numPixels - i);
+}
+
+TARGET_SSE41 void SwapRedBlueSse41(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    size_t i = 0;
+
+    for (; i + 4 <= numPixels; i += 4)
+    {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * i), _mm_shuffle_epi8(px, shuffle));
+    }
+
+    SwapRedBlueScalar(src + 4 * i, dst + 4 * i, numPixels - i);
+}
+
+// (x * a + 127) / 255 for 16-bit lanes, without a division.
+TARGET_SSE41 __m128i MulDiv255Sse41(__m128i color, __m128i alpha)
+{
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(color, alpha), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+TARGET_SSE41 void PremultiplyAlphaSse41(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xff000000u));
+
+    size_t i = 0;
+
+    for (; i + 4 <= numPixels; i += 4)
+    {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * i));
+
+        // Two pixels per register, with alpha broadcast to all four channels of each.
+        __m128i lo = _mm_unpacklo_epi8(px, zero);
+        __m128i hi = _mm_unpackhi_epi8(px, zero);
+        __m128i loAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xff), 0xff);
+        __m128i hiAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xff), 0xff);
+
+        __m128i result = _mm_packus_epi16(MulDiv255Sse41(lo, loAlpha),
+                                          MulDiv255Sse41(hi, hiAlpha));
+        result = _mm_blendv_epi8(result, px, alphaMask);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * i), result);
+    }
+
+    PremultiplyAlphaScalar(src + 4 * i, dst + 4 * i, numPixels - i);
+}
+
+// Loads four pixels with the channel's value in the low byte of each 32-bit lane.
+TARGET_SSE41 __m128i LoadChannelSse41(const uint8_t* src, __m128i shift)
+{
+    __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    return _mm_and_si128(_mm_srl_epi32(px, shift), _mm_set1_epi32(0xff));
+}
+
+TARGET_SSE41 void ExtractChannelSse41(const uint8_t* src, uint8_t* dst, size_t numPixels,
+                                      uint32_t channel)
+{
+    const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(8 * channel));
+
+    size_t i = 0;
+
+    for (; i + 16 <= numPixels; i += 16)
+    {
+        const uint8_t* ptr = src + 4 * i;
+
+        __m128i lo = _mm_packus_epi32(LoadChannelSse41(ptr, shift),
+                                      LoadChannelSse41(ptr + 16, shift));
+        __m128i hi = _mm_packus_epi32(LoadChannelSse41(ptr + 32, shift),
+                                      LoadChannelSse41(ptr + 48, shift));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+
+    ExtractChannelScalar(src + 4 * i, dst + i, numPixels - i, channel);
+}
+
+// AVX2. The byte shuffles work within 128-bit lanes, so the masks repeat the SSE ones.
+
+// Each lane loads 16 bytes for 12 used, the second one starting 12 bytes in.
+TARGET_AVX2 size_t ExpandToRgbaAvx2(const uint8_t* src, uint8_t* dst, size_t numPixels,
+                                    __m256i shuffle)
+{
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+
+    size_t i = 0;
+
+    for (; i + 10 <= numPixels; i += 8)
+    {
+        const __m128i* ptr = reinterpret_cast<const __m128i*>(src + 3 * i);
+        const __m128i* next = reinterpret_cast<const __m128i*>(src + 3 * i + 12);
+
+        __m256i px = _mm256_castsi128_si256(_mm_loadu_si128(ptr));
+        px = _mm256_inserti128_si256(px, _mm_loadu_si128(next), 1);
+        px = _mm256_or_si256(_mm256_shuffle_epi8(px, shuffle), alpha);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 4 * i), px);
+    }
+
+    return i;
+}
+
+TARGET_AVX2 void BgrToRgbaAvx2(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+                                             2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+
+    size_t i = ExpandToRgbaAvx2(src, dst, numPixels, shuffle);
+    BgrToRgbaScalar(src + 3 * i, dst + 4 * i, numPixels - i);
+}
+
+TARGET_AVX2 void RgbToRgbaAvx2(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                             0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+    size_t i = ExpandToRgbaAvx2(src, dst, numPixels, shuffle);
+    RgbToRgbaScalar(src + 3 * i, dst + 4 * i, numPixels - i);
+}
+
+TARGET_AVX2 void SwapRedBlueAvx2(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                             2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    size_t i = 0;
+
+    for (; i + 8 <= numPixels; i += 8)
+    {
+        __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4 * i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 4 * i),
+                            _mm256_shuffle_epi8(px, shuffle));
+    }
+
+    SwapRedBlueScalar(src + 4 * i, dst + 4 * i, numPixels - i);
+}
+
+TARGET_AVX2 __m256i MulDiv255Avx2(__m256i color, __m256i alpha)
+{
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(color, alpha), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+TARGET_AVX2 void PremultiplyAlphaAvx2(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+
+    size_t i = 0;
+
+    for (; i + 8 <= numPixels; i += 8)
+    {
+        __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4 * i));
+
+        __m256i lo = _mm256_unpacklo_epi8(px, zero);
+        __m256i hi = _mm256_unpackhi_epi8(px, zero);
+        __m256i loAlpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo, 0xff), 0xff);
+        __m256i hiAlpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi, 0xff), 0xff);
+
+        // Unpacking and packing both work within lanes, so the pixel order comes out unchanged.
+        __m256i result = _mm256_packus_epi16(MulDiv255Avx2(lo, loAlpha),
+                                             MulDiv255Avx2(hi, hiAlpha));
+        result = _mm256_blendv_epi8(result, px, alphaMask);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 4 * i), result);
+    }
+
+    PremultiplyAlphaScalar(src + 4 * i, dst + 4 * i, numPixels - i);
+}
+
+TARGET_AVX2 void SrgbToLinearAvx2(const uint8_t* src, float* dst, size_t numPixels)
+{
+    const SrgbTables& tables = GetSrgbTables();
+
+    const __m256i alphaOffset = _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256);
+
+    size_t i = 0;
+
+    for (; i + 4 <= numPixels; i += 4)
+    {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * i));
+
+        __m256i lo = _mm256_add_epi32(_mm256_cvtepu8_epi32(px), alphaOffset);
+        __m256i hi = _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(px, 8)), alphaOffset);
+
+        _mm256_storeu_ps(dst + 4 * i, _mm256_i32gather_ps(tables.ToLinear, lo, 4));
+        _mm256_storeu_ps(dst + 4 * i + 8, _mm256_i32gather_ps(tables.ToLinear, hi, 4));
+    }
+
+    SrgbToLinearScalar(src + 4 * i, dst + 4 * i, numPixels - i);
+}
+
+TARGET_AVX2 void LinearToSrgbAvx2(const float* src, uint8_t* dst, size_t numPixels)
+{
+    const SrgbTables& tables = GetSrgbTables();
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 bucketScale = _mm256_set1_ps(static_cast<float>(NUM_LINEAR_BUCKETS));
+    const __m256i maxBucket = _mm256_set1_epi32(NUM_LINEAR_BUCKETS - 1);
+    const __m256i alphaOffset = _mm256_setr_epi32(0, 0, 0, NUM_LINEAR_BUCKETS,
+                                                  0, 0, 0, NUM_LINEAR_BUCKETS);
+
+    size_t i = 0;
+
+    for (; i + 2 <= numPixels; i += 2)
+    {
+        // max() returns its second operand for NaNs.
+        __m256 value = _mm256_loadu_ps(src + 4 * i);
+        value = _mm256_min_ps(_mm256_max_ps(value, zero), one);
+
+        __m256i bucket = _mm256_cvttps_epi32(_mm256_mul_ps(value, bucketScale));
+        bucket = _mm256_add_epi32(_mm256_min_epi32(bucket, maxBucket), alphaOffset);
+
+        __m256i code = _mm256_i32gather_epi32(tables.BucketCode, bucket, 4);
+        __m256 threshold = _mm256_i32gather_ps(tables.BucketThreshold, bucket, 4);
+
+        // The comparison yields -1 where the value reaches the next code.
+        __m256 reached = _mm256_cmp_ps(value, threshold, _CMP_GE_OQ);
+        __m256i result = _mm256_sub_epi32(code, _mm256_castps_si256(reached));
+
+        // Narrowing leaves each lane's pixel in its low four bytes.
+        result = _mm256_packus_epi32(result, result);
+        result = _mm256_packus_epi16(result, result);
+
+        uint32_t first = static_cast<uint32_t>(_mm256_extract_epi32(result, 0));
+        uint32_t second = static_cast<uint32_t>(_mm256_extract_epi32(result, 4));
+
+        memcpy(dst + 4 * i, &first, sizeof(first));
+        memcpy(dst + 4 * i + 4, &second, sizeof(second));
+    }
+
+    LinearToSrgbScalar(src + 4 * i, dst + 4 * i, numPixels - i);
+}
+
+TARGET_AVX2 __m256i LoadChannelAvx2(const uint8_t* src, __m128i shift)
+{
+    __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+    return _mm256_and_si256(_mm256_srl_epi32(px, shift), _mm256_set1_epi32(0xff));
+}
+
+TARGET_AVX2 void ExtractChannelAvx2(const uint8_t* src, uint8_t* dst, size_t numPixels,
+                                    uint32_t channel)
+{
+    const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(8 * channel));
+
+    // Packing interleaves the 128-bit lanes of its inputs, and this puts them back in order.
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    size_t i = 0;
+
+    for (; i + 32 <= numPixels; i += 32)
+    {
+        const uint8_t* ptr = src + 4 * i;
+
+        __m256i lo = _mm256_packus_epi32(LoadChannelAvx2(ptr, shift),
+                                         LoadChannelAvx2(ptr + 32, shift));
+        __m256i hi = _mm256_packus_epi32(LoadChannelAvx2(ptr + 64, shift),
+                                         LoadChannelAvx2(ptr + 96, shift));
+        __m256i result = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(lo, hi), order);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), result);
+    }
+
+    ExtractChannelScalar(src + 4 * i, dst + i, numPixels - i, channel);
+}
+
+#elif defined(GRFX_SIMD_NEON)
+
+// The structured loads and stores deinterleave channels into separate registers, so every kernel
+// works on 16 pixels at a time.
+
+void BgrToRgbaNeon(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= numPixels; i += 16)
+    {
+        uint8x16x3_t bgr = vld3q_u8(src + 3 * i);
+
+        uint8x16x4_t rgba;
+        rgba.val[0] = bgr.val[2];
+        rgba.val[1] = bgr.val[1];
+        rgba.val[2] = bgr.val[0];
+        rgba.val[3] = vdupq_n_u8(255);
+
+        vst4q_u8(dst + 4 * i, rgba);
+    }
+
+    BgrToRgbaScalar(src + 3 * i, dst + 4 * i, numPixels - i);
+}
+
+void RgbToRgbaNeon(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= numPixels; i += 16)
+    {
+        uint8x16x3_t rgb = vld3q_u8(src + 3 * i);
+
+        uint8x16x4_t rgba;
+        rgba.val[0] = rgb.val[0];
+        rgba.val[1] = rgb.val[1];
+        rgba.val[2] = rgb.val[2];
+        rgba.val[3] = vdupq_n_u8(255);
+
+        vst4q_u8(dst + 4 * i, rgba);
+    }
+
+    RgbToRgbaScalar(src + 3 * i, dst + 4 * i, numPixels - i);
+}
+
+void SwapRedBlueNeon(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= numPixels; i += 16)
+    {
+        uint8x16x4_t px = vld4q_u8(src + 4 * i);
+        std::swap(px.val[0], px.val[2]);
+        vst4q_u8(dst + 4 * i, px);
+    }
+
+    SwapRedBlueScalar(src + 4 * i, dst + 4 * i, numPixels - i);
+}
+
+// (x * a + 127) / 255, computed as in the x86 versions. The rounding shifts add the 128.
+uint8x16_t MulDiv255Neon(uint8x16_t color, uint8x16_t alpha)
+{
+    uint16x8_t lo = vmull_u8(vget_low_u8(color), vget_low_u8(alpha));
+    uint16x8_t hi = vmull_high_u8(color, alpha);
+
+    return vcombine_u8(vraddhn_u16(lo, vrshrq_n_u16(lo, 8)),
+                       vraddhn_u16(hi, vrshrq_n_u16(hi, 8)));
+}
+
+void PremultiplyAlphaNeon(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= numPixels; i += 16)
+    {
+        uint8x16x4_t px = vld4q_u8(src + 4 * i);
+
+        px.val[0] = MulDiv255Neon(px.val[0], px.val[3]);
+        px.val[1] = MulDiv255Neon(px.val[1], px.val[3]);
+        px.val[2] = MulDiv255Neon(px.val[2], px.val[3]);
+
+        vst4q_u8(dst + 4 * i, px);
+    }
+
+    PremultiplyAlphaScalar(src + 4 * i, dst + 4 * i, numPixels - i);
+}
+
+void ExtractChannelNeon(const uint8_t* src, uint8_t* dst, size_t numPixels, uint32_t channel)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= numPixels; i += 16)
+    {
+        uint8x16x4_t px = vld4q_u8(src + 4 * i);
+        vst1q_u8(dst + i, px.val[channel]);
+    }
+
+    ExtractChannelScalar(src + 4 * i, dst + i, numPixels - i, channel);
+}
+
+#endif
+
+PixelKernels CreateScalarKernels()
+{
+    PixelKernels kernels;
+    kernels.Level = SimdLevel::Scalar;
+    kernels.BgrToRgba = BgrToRgbaScalar;
+    kernels.RgbToRgba = RgbToRgbaScalar;
+    kernels.SwapRedBlue = SwapRedBlueScalar;
+    kernels.PremultiplyAlpha = PremultiplyAlphaScalar;
+    kernels.SrgbToLinear = SrgbToLinearScalar;
+    kernels.LinearToSrgb = LinearToSrgbScalar;
+    kernels.ExtractChannel = ExtractChannelScalar;
+    AddDecoderKernels(&kernels);
+
+    return kernels;
+}
+
+// The sRGB conversions are table lookups, which only AVX2 can vectorize with gathers. The other
+// instruction sets keep the scalar versions for them.
+
+#if defined(GRFX_SIMD_X86)
+
+PixelKernels CreateSse41Kernels()
+{
+    PixelKernels kernels = CreateScalarKernels();
+    kernels.Level = SimdLevel::Sse41;
+    kernels.BgrToRgba = BgrToRgbaSse41;
+    kernels.RgbToRgba = RgbToRgbaSse41;
+    kernels.SwapRedBlue = SwapRedBlueSse41;
+    kernels.PremultiplyAlpha = PremultiplyAlphaSse41;
+    kernels.ExtractChannel = ExtractChannelSse41;
+    AddDecoderKernels(&kernels);
+
+    return kernels;
+}
+
+PixelKernels CreateAvx2Kernels()
+{
+    PixelKernels kernels;
+    kernels.Level = SimdLevel::Avx2;
+    kernels.BgrToRgba = BgrToRgbaAvx2;
+    kernels.RgbToRgba = RgbToRgbaAvx2;
+    kernels.SwapRedBlue = SwapRedBlueAvx2;
+    kernels.PremultiplyAlpha = PremultiplyAlphaAvx2;
+    kernels.SrgbToLinear = SrgbToLinearAvx2;
+    kernels.LinearToSrgb = LinearToSrgbAvx2;
+    kernels.ExtractChannel = ExtractChannelAvx2;
+    AddDecoderKernels(&kernels);
+
+    return kernels;
+}
+
+#elif defined(GRFX_SIMD_NEON)
+
+PixelKernels CreateNeonKernels()
+{
+    PixelKernels kernels = CreateScalarKernels();
+    kernels.Level = SimdLevel::Neon;
+    kernels.BgrToRgba = BgrToRgbaNeon;
+    kernels.RgbToRgba = RgbToRgbaNeon;
+    kernels.SwapRedBlue = SwapRedBlueNeon;
+    kernels.PremultiplyAlpha = PremultiplyAlphaNeon;
+    kernels.ExtractChannel = ExtractChannelNeon;
+    AddDecoderKernels(&kernels);
+
+    return kernels;
+}
+
+#endif
+
+SimdLevel DetectSimdLevel()
+{
+    for (SimdLevel level : {SimdLevel::Avx2, SimdLevel::Neon, SimdLevel::Sse41})
+    {
+        if (IsSimdLevelSupported(level))
+            return level;
+    }
+
+    return SimdLevel::Scalar;
+}
+
+} // namespace
+
+bool IsSimdLevelSupported(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::Scalar:
+            return true;
+#if defined(GRFX_SIMD_X86)
+        case SimdLevel::Sse41:
+            return CpuSupportsSse41();
+        case SimdLevel::Avx2:
+            return CpuSupportsAvx2();
+#elif defined(GRFX_SIMD_NEON)
+        case SimdLevel::Neon:
+            // Part of the AArch64 baseline.
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* GetSimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::Scalar:
+            return "scalar";
+        case SimdLevel::Sse41:
+            return "sse4.1";
+        case SimdLevel::Avx2:
+            return "avx2";
+        case SimdLevel::Neon:
+            return "neon";
+    }
+
+    return "unknown";
+}
+
+const PixelKernels& GetPixelKernels()
+{
+    static const PixelKernels& kernels = GetPixelKernels(DetectSimdLevel());
+
+    return kernels;
+}
+
+const PixelKernels& GetPixelKernels(SimdLevel level)
+{
+    if (!IsSimdLevelSupported(level))
+        throw std::runtime_error("SIMD level not supported.");
+
+    switch (level)
+    {
+#if defined(GRFX_SIMD_X86)
+        case SimdLevel::Sse41:
+        {
+            static const PixelKernels kernels = CreateSse41Kernels();
+            return kernels;
+        }
+        case SimdLevel::Avx2:
+        {
+            static const PixelKernels kernels = CreateAvx2Kernels();
+            return kernels;
+        }
+#elif defined(GRFX_SIMD_NEON)
+        case SimdLevel::Neon:
+        {
+            static const PixelKernels kernels = CreateNeonKernels();
+            return kernels;
+        }
+#endif
+        default:
+        {
+            static const PixelKernels kernels = CreateScalarKernels();
+            return kernels;
+        }
+    }
+}
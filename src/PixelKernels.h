@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Instruction sets the pixel kernels are implemented for.
+enum class SimdLevel
+{
+    Scalar,
+    Sse41,
+    Avx2,
+    Neon
+};
+
+// Converts rows of 8-bit pixels. Each function handles any pixel count, and the SIMD versions
+// produce exactly the same output as the scalar ones. Source and destination may only be the same
+// row where noted. Destination rows are written front to back without being read, so they can be
+// write-combined upload memory.
+struct PixelKernels
+{
+    SimdLevel Level = SimdLevel::Scalar;
+
+    // 24-bit BGR or RGB to RGBA8 with opaque alpha.
+    void (*BgrToRgba)(const uint8_t* src, uint8_t* dst, size_t numPixels) = nullptr;
+    void (*RgbToRgba)(const uint8_t* src, uint8_t* dst, size_t numPixels) = nullptr;
+
+    // Swaps the first and third channel of 32-bit pixels, i.e. BGRA to RGBA and back. In place is
+    // allowed.
+    void (*SwapRedBlue)(const uint8_t* src, uint8_t* dst, size_t numPixels) = nullptr;
+
+    // Multiplies the color of RGBA8 pixels by their alpha, rounding to nearest. In place is
+    // allowed.
+    void (*PremultiplyAlpha)(const uint8_t* src, uint8_t* dst, size_t numPixels) = nullptr;
+
+    // RGBA8 with sRGB-encoded color to linear float RGBA. Alpha is linear in both.
+    void (*SrgbToLinear)(const uint8_t* src, float* dst, size_t numPixels) = nullptr;
+
+    // Inverse of SrgbToLinear. Values are clamped to [0, 1], NaNs become 0, and the result is
+    // rounded to the nearest code, so 8-bit values survive a round trip.
+    void (*LinearToSrgb)(const float* src, uint8_t* dst, size_t numPixels) = nullptr;
+
+    // Copies one channel (0 to 3) of RGBA8 pixels into a single-channel row.
+    void (*ExtractChannel)(const uint8_t* src, uint8_t* dst, size_t numPixels,
+                           uint32_t channel) = nullptr;
+
+    // 8-bit gray to RGBA8 with opaque alpha.
+    void (*GrayToRgba)(const uint8_t* src, uint8_t* dst, size_t numPixels) = nullptr;
+
+    // The stages of the JPEG and PNG decoders. They match libjpeg and libpng bit for bit.
+
+    // Dequantizes an 8x8 block of JPEG coefficients in natural order and writes its inverse DCT,
+    // computed like the accurate integer IDCT of libjpeg, as 8 rows of 8 samples.
+    void (*InverseDct)(const int16_t* coefs, const uint16_t* quant, uint8_t* dst,
+                       size_t dstStride) = nullptr;
+
+    // Full resolution JPEG YCbCr rows to RGBA8 with opaque alpha.
+    void (*YCbCrToRgba)(const uint8_t* y, const uint8_t* cb, const uint8_t* cr, uint8_t* dst,
+                        size_t numPixels) = nullptr;
+
+    // Triangle-filtered chroma upsampling. |numSamples| is the width of the source rows and the
+    // samples past either end are taken to be copies of the edge samples. Vertical filters blend
+    // the nearest source row 3:1 with the one on the other side of the output row, which is above
+    // it when |farRowAbove| is set.
+    void (*UpsampleH2)(const uint8_t* src, uint8_t* dst, size_t numSamples) = nullptr;
+    void (*UpsampleV2)(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst,
+                       size_t numSamples, bool farRowAbove) = nullptr;
+    void (*UpsampleH2V2)(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst,
+                         size_t numSamples) = nullptr;
+
+    // Reverses PNG filter type |filter| (0 to 4) on a row in place. |prevRow| is the previous
+    // unfiltered row, or zeros for the first one.
+    void (*UnfilterPngRow)(uint32_t filter, uint8_t* row, const uint8_t* prevRow, size_t rowSize,
+                           size_t bytesPerPixel) = nullptr;
+};
+
+bool IsSimdLevelSupported(SimdLevel level);
+
+const char* GetSimdLevelName(SimdLevel level);
+
+// The fastest kernels the CPU supports. Detected on first use.
+const PixelKernels& GetPixelKernels();
+
+// Throws if the CPU does not support |level|.
+const PixelKernels& GetPixelKernels(SimdLevel level);
@@ -0,0 +1,413 @@
+#include "PngDecoder.h"
+
+#include "Inflate.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+constexpr uint8_t PNG_SIGNATURE[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+// Larger images are rejected before their size can overflow anything.
+constexpr uint32_t MAX_DIMENSION = 1u << 20;
+
+constexpr uint32_t MakeChunkType(const char (&name)[5])
+{
+    return (static_cast<uint32_t>(name[0]) << 24) | (static_cast<uint32_t>(name[1]) << 16) |
+        (static_cast<uint32_t>(name[2]) << 8) | static_cast<uint32_t>(name[3]);
+}
+
+uint32_t ReadBigEndian32(std::span<const std::byte> data, size_t offset)
+{
+    return (static_cast<uint32_t>(data[offset + 0]) << 24) |
+        (static_cast<uint32_t>(data[offset + 1]) << 16) |
+        (static_cast<uint32_t>(data[offset + 2]) << 8) | static_cast<uint32_t>(data[offset + 3]);
+}
+
+uint16_t ReadBigEndian16(std::span<const std::byte> data, size_t offset)
+{
+    return static_cast<uint16_t>((static_cast<uint32_t>(data[offset]) << 8) |
+                                 static_cast<uint32_t>(data[offset + 1]));
+}
+
+uint32_t GetNumChannels(uint32_t colorType, uint32_t bitDepth)
+{
+    auto isDepth = [bitDepth](std::initializer_list<uint32_t> depths) {
+        return std::find(depths.begin(), depths.end(), bitDepth) != depths.end();
+    };
+
+    switch (colorType)
+    {
+        case 0:
+            return isDepth({1, 2, 4, 8, 16}) ? 1 : 0;
+        case 2:
+            return isDepth({8, 16}) ? 3 : 0;
+        case 3:
+            return isDepth({1, 2, 4, 8}) ? 1 : 0;
+        case 4:
+            return isDepth({8, 16}) ? 2 : 0;
+        case 6:
+            return isDepth({8, 16}) ? 4 : 0;
+        default:
+            return 0;
+    }
+}
+
+// The Adam7 passes, as the first pixel and the step between pixels in either direction.
+struct InterlacePass
+{
+    uint32_t StartX;
+    uint32_t StartY;
+    uint32_t StepX;
+    uint32_t StepY;
+
+    uint32_t GetWidth(uint32_t width) const
+    {
+        return width > StartX ? (width - StartX + StepX - 1) / StepX : 0;
+    }
+
+    uint32_t GetHeight(uint32_t height) const
+    {
+        return height > StartY ? (height - StartY + StepY - 1) / StepY : 0;
+    }
+};
+
+constexpr InterlacePass INTERLACE_PASSES[] = {
+    {0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4},
+    {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2},
+};
+
+} // namespace
+
+PngDecoder::PngDecoder(std::span<const std::byte> data, const PixelKernels& kernels)
+    : m_kernels(kernels)
+{
+    if (!HasSignature(data))
+        throw std::runtime_error("Not a PNG file.");
+
+    for (auto& entry : m_palette)
+        entry[3] = 255;
+
+    bool hasHeader = false;
+    bool hasPalette = false;
+    size_t offset = sizeof(PNG_SIGNATURE);
+
+    for (;;)
+    {
+        if (data.size() - offset < 12)
+            throw std::runtime_error("Truncated PNG file.");
+
+        uint32_t length = ReadBigEndian32(data, offset);
+        uint32_t type = ReadBigEndian32(data, offset + 4);
+
+        if (length > data.size() - offset - 12)
+            throw std::runtime_error("Truncated PNG file.");
+
+        std::span<const std::byte> chunk = data.subspan(offset + 8, length);
+        offset += 12 + static_cast<size_t>(length);
+
+        if (type == MakeChunkType("IEND"))
+            break;
+
+        if (!hasHeader && type != MakeChunkType("IHDR"))
+            throw std::runtime_error("Invalid PNG file.");
+
+        // CRCs are not checked. The zlib stream has its own checksum, and the other chunks are
+        // validated as they are parsed.
+        switch (type)
+        {
+            case MakeChunkType("IHDR"):
+            {
+                if (hasHeader || length != 13)
+                    throw std::runtime_error("Invalid PNG file.");
+
+                m_width = ReadBigEndian32(chunk, 0);
+                m_height = ReadBigEndian32(chunk, 4);
+                m_bitDepth = static_cast<uint32_t>(chunk[8]);
+                m_colorType = static_cast<uint32_t>(chunk[9]);
+                m_channels = GetNumChannels(m_colorType, m_bitDepth);
+
+                uint32_t interlace = static_cast<uint32_t>(chunk[12]);
+                m_interlaced = interlace == 1;
+
+                if (m_width == 0 || m_height == 0 || m_channels == 0 || chunk[10] != std::byte{0} ||
+                    chunk[11] != std::byte{0} || interlace > 1)
+                {
+                    throw std::runtime_error("Invalid PNG file.");
+                }
+
+                if (m_width > MAX_DIMENSION || m_height > MAX_DIMENSION)
+                    throw std::runtime_error("PNG image too large.");
+
+                hasHeader = true;
+                break;
+            }
+            case MakeChunkType("PLTE"):
+            {
+                if (length % 3 != 0 || length / 3 > 256)
+                    throw std::runtime_error("Invalid PNG file.");
+
+                for (uint32_t i = 0; i < length / 3; ++i)
+                {
+                    for (uint32_t c = 0; c < 3; ++c)
+                        m_palette[i][c] = static_cast<uint8_t>(chunk[3 * i + c]);
+                }
+
+                hasPalette = true;
+                break;
+            }
+            case MakeChunkType("tRNS"):
+                if (m_colorType == 3)
+                {
+                    for (uint32_t i = 0; i < std::min(length, 256u); ++i)
+                        m_palette[i][3] = static_cast<uint8_t>(chunk[i]);
+                }
+                else if ((m_colorType == 0 && length == 2) || (m_colorType == 2 && length == 6))
+                {
+                    for (uint32_t c = 0; c < length / 2; ++c)
+                        m_transparentColor[c] = ReadBigEndian16(chunk, 2 * c);
+
+                    m_hasTransparentColor = true;
+                }
+                break;
+            case MakeChunkType("IDAT"):
+                m_dataChunks.push_back(chunk);
+                break;
+            default:
+                // Ancillary chunks, which have a lowercase first letter, can be skipped.
+                if ((type & 0x20000000) == 0)
+                    throw std::runtime_error("Unsupported PNG chunk.");
+        }
+    }
+
+    if (!hasHeader || m_dataChunks.empty() || (m_colorType == 3 && !hasPalette))
+        throw std::runtime_error("Invalid PNG file.");
+}
+
+uint32_t PngDecoder::GetWidth() const
+{
+    return m_width;
+}
+
+uint32_t PngDecoder::GetHeight() const
+{
+    return m_height;
+}
+
+void PngDecoder::Decode(uint8_t* dst, size_t rowPitch)
+{
+    size_t size = 0;
+
+    if (m_interlaced)
+    {
+        for (const InterlacePass& pass : INTERLACE_PASSES)
+        {
+            uint32_t passWidth = pass.GetWidth(m_width);
+
+            if (passWidth > 0)
+                size += pass.GetHeight(m_height) * (1 + GetRowSize(passWidth));
+        }
+    }
+    else
+    {
+        size = m_height * (1 + GetRowSize(m_width));
+    }
+
+    std::vector<uint8_t> rows(size);
+
+    if (m_dataChunks.size() == 1)
+    {
+        InflateZlib(m_dataChunks[0], rows);
+    }
+    else
+    {
+        std::vector<std::byte> stream;
+
+        for (std::span<const std::byte> chunk : m_dataChunks)
+            stream.insert(stream.end(), chunk.begin(), chunk.end());
+
+        InflateZlib(stream, rows);
+    }
+
+    m_unpackedRow.resize(static_cast<size_t>(m_width) * m_channels);
+    m_zeroRow.assign(GetRowSize(m_width), 0);
+
+    if (m_interlaced)
+    {
+        DecodeInterlaced(rows.data(), dst, rowPitch);
+        return;
+    }
+
+    size_t rowSize = GetRowSize(m_width);
+    const uint8_t* prevRow = m_zeroRow.data();
+
+    for (uint32_t y = 0; y < m_height; ++y)
+    {
+        uint8_t* row = rows.data() + y * (1 + rowSize);
+
+        UnfilterRow(row, prevRow, rowSize);
+        ConvertRow(row + 1, dst + y * rowPitch, m_width);
+
+        prevRow = row + 1;
+    }
+}
+
+bool PngDecoder::HasSignature(std::span<const std::byte> data)
+{
+    return data.size() >= sizeof(PNG_SIGNATURE) &&
+        std::memcmp(data.data(), PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) == 0;
+}
+
+size_t PngDecoder::GetRowSize(uint32_t width) const
+{
+    return (static_cast<size_t>(width) * m_channels * m_bitDepth + 7) / 8;
+}
+
+void PngDecoder::UnfilterRow(uint8_t* row, const uint8_t* prevRow, size_t rowSize)
+{
+    uint32_t filter = row[0];
+
+    if (filter > 4)
+        throw std::runtime_error("Invalid PNG filter type.");
+
+    size_t bytesPerPixel = std::max<size_t>(1, m_channels * m_bitDepth / 8);
+
+    m_kernels.UnfilterPngRow(filter, row + 1, prevRow, rowSize, bytesPerPixel);
+}
+
+void PngDecoder::ConvertRow(const uint8_t* src, uint8_t* dst, uint32_t width)
+{
+    const uint8_t* samples = src;
+    size_t numSamples = static_cast<size_t>(width) * m_channels;
+
+    if (m_bitDepth == 16)
+    {
+        for (size_t i = 0; i < numSamples; ++i)
+            m_unpackedRow[i] = src[2 * i];
+
+        samples = m_unpackedRow.data();
+    }
+    else if (m_bitDepth < 8)
+    {
+        UnpackRow(src, m_unpackedRow.data(), width);
+        samples = m_unpackedRow.data();
+    }
+
+    switch (m_colorType)
+    {
+        case 0:
+            m_kernels.GrayToRgba(samples, dst, width);
+            break;
+        case 2:
+            m_kernels.RgbToRgba(samples, dst, width);
+            break;
+        case 3:
+            for (uint32_t i = 0; i < width; ++i)
+                std::memcpy(dst + 4 * i, m_palette[samples[i]], 4);
+            break;
+        case 4:
+            for (uint32_t i = 0; i < width; ++i)
+            {
+                dst[4 * i + 0] = samples[2 * i];
+                dst[4 * i + 1] = samples[2 * i];
+                dst[4 * i + 2] = samples[2 * i];
+                dst[4 * i + 3] = samples[2 * i + 1];
+            }
+            break;
+        default:
+            std::memcpy(dst, samples, numSamples);
+            break;
+    }
+
+    if (m_hasTransparentColor)
+        ApplyTransparentColor(src, dst, width);
+}
+
+void PngDecoder::UnpackRow(const uint8_t* src, uint8_t* dst, uint32_t width) const
+{
+    uint32_t mask = (1u << m_bitDepth) - 1;
+
+    // Gray is scaled to the full range by repeating its bits. Palette indices are kept.
+    uint32_t scale = m_colorType == 0 ? 255 / mask : 1;
+
+    for (uint32_t i = 0; i < width; ++i)
+    {
+        size_t bit = static_cast<size_t>(i) * m_bitDepth;
+        uint32_t value = (src[bit / 8] >> (8 - m_bitDepth - bit % 8)) & mask;
+
+        dst[i] = static_cast<uint8_t>(value * scale);
+    }
+}
+
+void PngDecoder::ApplyTransparentColor(const uint8_t* src, uint8_t* dst, uint32_t width) const
+{
+    // Compares the samples as stored in the file, before any scaling or truncation.
+    auto getSample = [&](size_t index) -> uint32_t {
+        if (m_bitDepth == 16)
+            return (static_cast<uint32_t>(src[2 * index]) << 8) | src[2 * index + 1];
+
+        if (m_bitDepth == 8)
+            return src[index];
+
+        size_t bit = index * m_bitDepth;
+
+        return (src[bit / 8] >> (8 - m_bitDepth - bit % 8)) & ((1u << m_bitDepth) - 1);
+    };
+
+    for (uint32_t i = 0; i < width; ++i)
+    {
+        bool transparent = true;
+
+        for (uint32_t c = 0; c < m_channels; ++c)
+            transparent = transparent && getSample(i * m_channels + c) == m_transparentColor[c];
+
+        if (transparent)
+            dst[4 * i + 3] = 0;
+    }
+}
+
+void PngDecoder::DecodeInterlaced(uint8_t* rows, uint8_t* dst, size_t rowPitch)
+{
+    // The passes fill the image in a scattered order, so it is assembled in memory before being
+    // written out in order.
+    std::vector<uint8_t> image(static_cast<size_t>(m_width) * m_height * 4);
+    std::vector<uint8_t> passRow(static_cast<size_t>(m_width) * 4);
+
+    for (const InterlacePass& pass : INTERLACE_PASSES)
+    {
+        uint32_t passWidth = pass.GetWidth(m_width);
+        uint32_t passHeight = pass.GetHeight(m_height);
+
+        if (passWidth == 0 || passHeight == 0)
+            continue;
+
+        size_t rowSize = GetRowSize(passWidth);
+        const uint8_t* prevRow = m_zeroRow.data();
+
+        for (uint32_t y = 0; y < passHeight; ++y)
+        {
+            UnfilterRow(rows, prevRow, rowSize);
+            ConvertRow(rows + 1, passRow.data(), passWidth);
+
+            size_t imageY = pass.StartY + static_cast<size_t>(y) * pass.StepY;
+
+            for (uint32_t x = 0; x < passWidth; ++x)
+            {
+                size_t imageX = pass.StartX + static_cast<size_t>(x) * pass.StepX;
+                std::memcpy(image.data() + 4 * (imageY * m_width + imageX), passRow.data() + 4 * x,
+                            4);
+            }
+
+            prevRow = rows + 1;
+            rows += 1 + rowSize;
+        }
+    }
+
+    size_t imageRowSize = 4 * static_cast<size_t>(m_width);
+
+    for (uint32_t y = 0; y < m_height; ++y)
+        std::memcpy(dst + y * rowPitch, image.data() + y * imageRowSize, imageRowSize);
+}
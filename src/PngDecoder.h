@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ImageDecoder.h"
+
+#include <vector>
+
+// Decodes PNG files of any color type and bit depth, interlaced or not. 16-bit samples are
+// truncated to their high byte, and transparency chunks become alpha.
+class PngDecoder : public ImageDecoder
+{
+public:
+    PngDecoder(std::span<const std::byte> data, const PixelKernels& kernels);
+
+    uint32_t GetWidth() const override;
+    uint32_t GetHeight() const override;
+
+    void Decode(uint8_t* dst, size_t rowPitch) override;
+
+    static bool HasSignature(std::span<const std::byte> data);
+
+private:
+    // Bytes of a filtered row of |width| pixels, without the filter type byte.
+    size_t GetRowSize(uint32_t width) const;
+
+    // |row| starts with the filter type byte, which is followed by |rowSize| filtered bytes.
+    void UnfilterRow(uint8_t* row, const uint8_t* prevRow, size_t rowSize);
+
+    void ConvertRow(const uint8_t* src, uint8_t* dst, uint32_t width);
+
+    // Converts a row of samples smaller than a byte, or of palette indices, to one byte each.
+    void UnpackRow(const uint8_t* src, uint8_t* dst, uint32_t width) const;
+
+    void ApplyTransparentColor(const uint8_t* src, uint8_t* dst, uint32_t width) const;
+
+    void DecodeInterlaced(uint8_t* rows, uint8_t* dst, size_t rowPitch);
+
+    const PixelKernels& m_kernels;
+
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_bitDepth = 0;
+    uint32_t m_colorType = 0;
+    uint32_t m_channels = 0;
+    bool m_interlaced = false;
+
+    // Palette entries as RGBA, with the alpha of the transparency chunk.
+    uint8_t m_palette[256][4] = {};
+
+    // The color of gray and RGB images that is transparent, in file sample values.
+    bool m_hasTransparentColor = false;
+    uint16_t m_transparentColor[3] = {};
+
+    std::vector<std::span<const std::byte>> m_dataChunks;
+
+    // Samples widened to a byte each, before expanding to RGBA.
+    std::vector<uint8_t> m_unpackedRow;
+    std::vector<uint8_t> m_zeroRow;
+};
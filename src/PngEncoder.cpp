@@ -0,0 +1,202 @@
+#include "PngEncoder.h"
+
+#include "Deflate.h"
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+
+namespace
+{
+
+constexpr size_t BYTES_PER_PIXEL = 4;
+
+constexpr int NUM_FILTERS = 5;
+
+struct CrcTable
+{
+    std::array<uint32_t, 256> Entries;
+
+    CrcTable()
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t crc = i;
+
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+
+            Entries[i] = crc;
+        }
+    }
+};
+
+uint32_t Crc32(std::span<const std::byte> data)
+{
+    static const CrcTable table;
+
+    uint32_t crc = 0xFFFFFFFFu;
+
+    for (std::byte b : data)
+        crc = table.Entries[(crc ^ static_cast<uint32_t>(b)) & 0xFF] ^ (crc >> 8);
+
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void AppendU32(std::vector<std::byte>* dst, uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+        dst->push_back(static_cast<std::byte>((value >> shift) & 0xFF));
+}
+
+// Length, type, data and a CRC of the type and data.
+void AppendChunk(std::vector<std::byte>* dst, const char* type, std::span<const std::byte> data)
+{
+    AppendU32(dst, static_cast<uint32_t>(data.size()));
+
+    size_t typeOffset = dst->size();
+
+    for (int i = 0; i < 4; ++i)
+        dst->push_back(static_cast<std::byte>(type[i]));
+
+    dst->insert(dst->end(), data.begin(), data.end());
+
+    AppendU32(dst, Crc32(std::span(*dst).subspan(typeOffset)));
+}
+
+uint8_t Paeth(uint8_t a, uint8_t b, uint8_t c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+
+    if (pa <= pb && pa <= pc)
+        return a;
+
+    return pb <= pc ? b : c;
+}
+
+// Writes |row| filtered with |filter| to |dst|. |prevRow| is all zeros for the first row.
+void FilterRow(int filter, const uint8_t* row, const uint8_t* prevRow, size_t rowSize,
+               uint8_t* dst)
+{
+    for (size_t i = 0; i < rowSize; ++i)
+    {
+        uint8_t left = i >= BYTES_PER_PIXEL ? row[i - BYTES_PER_PIXEL] : 0;
+        uint8_t up = prevRow[i];
+        uint8_t upLeft = i >= BYTES_PER_PIXEL ? prevRow[i - BYTES_PER_PIXEL] : 0;
+
+        uint8_t predicted = 0;
+
+        switch (filter)
+        {
+            case 1:
+                predicted = left;
+                break;
+            case 2:
+                predicted = up;
+                break;
+            case 3:
+                predicted = static_cast<uint8_t>((left + up) / 2);
+                break;
+            case 4:
+                predicted = Paeth(left, up, upLeft);
+                break;
+            default:
+                break;
+        }
+
+        dst[i] = static_cast<uint8_t>(row[i] - predicted);
+    }
+}
+
+// Filtered bytes read as signed, the usual estimate of how well a row compresses.
+uint64_t GetFilteredCost(const uint8_t* filtered, size_t rowSize)
+{
+    uint64_t cost = 0;
+
+    for (size_t i = 0; i < rowSize; ++i)
+        cost += static_cast<uint64_t>(std::abs(static_cast<int8_t>(filtered[i])));
+
+    return cost;
+}
+
+} // namespace
+
+std::vector<std::byte> EncodePng(const uint8_t* pixels, uint32_t width, uint32_t height,
+                                 size_t rowPitch)
+{
+    if (width == 0 || height == 0)
+        throw std::runtime_error("Empty image.");
+
+    size_t rowSize = size_t{width} * BYTES_PER_PIXEL;
+
+    // Each row is preceded by its filter type.
+    std::vector<uint8_t> filtered((rowSize + 1) * height);
+
+    std::vector<uint8_t> zeroRow(rowSize, 0);
+    std::vector<uint8_t> candidate(rowSize);
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* row = pixels + y * rowPitch;
+        const uint8_t* prevRow = y > 0 ? row - rowPitch : zeroRow.data();
+
+        uint8_t* dst = filtered.data() + y * (rowSize + 1);
+
+        uint64_t bestCost = UINT64_MAX;
+
+        for (int filter = 0; filter < NUM_FILTERS; ++filter)
+        {
+            FilterRow(filter, row, prevRow, rowSize, candidate.data());
+
+            uint64_t cost = GetFilteredCost(candidate.data(), rowSize);
+
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                dst[0] = static_cast<uint8_t>(filter);
+                std::memcpy(dst + 1, candidate.data(), rowSize);
+            }
+        }
+    }
+
+    std::vector<std::byte> png;
+
+    static constexpr uint8_t SIGNATURE[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    for (uint8_t b : SIGNATURE)
+        png.push_back(static_cast<std::byte>(b));
+
+    std::vector<std::byte> header;
+    AppendU32(&header, width);
+    AppendU32(&header, height);
+
+    // 8 bits per sample, RGBA, deflate, adaptive filtering, not interlaced.
+    static constexpr uint8_t FORMAT[] = {8, 6, 0, 0, 0};
+
+    for (uint8_t b : FORMAT)
+        header.push_back(static_cast<std::byte>(b));
+
+    AppendChunk(&png, "IHDR", header);
+    AppendChunk(&png, "IDAT", DeflateZlib(filtered));
+    AppendChunk(&png, "IEND", {});
+
+    return png;
+}
+
+void WritePng(const std::filesystem::path& path, const uint8_t* pixels, uint32_t width,
+              uint32_t height, size_t rowPitch)
+{
+    std::vector<std::byte> png = EncodePng(pixels, width, height, rowPitch);
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+
+    if (!file)
+        throw std::runtime_error("Failed to write " + path.string() + ".");
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Encodes an RGBA8 image as an 8-bit RGBA PNG. Rows of |pixels| are |rowPitch| bytes apart. Each
+// row gets the filter that leaves the smallest sum of absolute differences, as libpng chooses.
+std::vector<std::byte> EncodePng(const uint8_t* pixels, uint32_t width, uint32_t height,
+                                 size_t rowPitch);
+
+// Encodes the image as above and writes it to |path|. Throws if the file cannot be written.
+void WritePng(const std::filesystem::path& path, const uint8_t* pixels, uint32_t width,
+              uint32_t height, size_t rowPitch);
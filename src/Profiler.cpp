@@ -0,0 +1,323 @@
+#include "Profiler.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace fs = std::filesystem;
+
+using nlohmann::json;
+
+std::atomic<bool> Profiler::s_enabled = true;
+
+namespace
+{
+
+thread_local void* t_threadBuffer = nullptr;
+
+const char* GetCounterName(int counter)
+{
+    switch (static_cast<ProfileCounter>(counter))
+    {
+        case ProfileCounter::DrawCalls:
+            return "DrawCalls";
+        case ProfileCounter::StateChanges:
+            return "StateChanges";
+        case ProfileCounter::Triangles:
+            return "Triangles";
+        default:
+            return "Unknown";
+    }
+}
+
+} // namespace
+
+Profiler::Profiler()
+{
+    m_frameStartTime = Now();
+}
+
+Profiler& Profiler::Get()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::SetEnabled(bool enabled)
+{
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+int64_t Profiler::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Profiler::ThreadBuffer* Profiler::GetThreadBuffer()
+{
+    if (t_threadBuffer)
+        return static_cast<ThreadBuffer*>(t_threadBuffer);
+
+    auto buffer = std::make_unique<ThreadBuffer>();
+
+    std::lock_guard lock(m_threadsMutex);
+
+    buffer->ThreadIdx = static_cast<int>(m_threads.size());
+    t_threadBuffer = buffer.get();
+
+    m_threads.push_back(std::move(buffer));
+
+    return m_threads.back().get();
+}
+
+void Profiler::Record(EventType type, ProfileCounter counter, const char* name, int64_t value)
+{
+    ThreadBuffer* buffer = GetThreadBuffer();
+
+    if (type == EventType::End)
+    {
+        if (buffer->DroppedDepth > 0)
+        {
+            --buffer->DroppedDepth;
+            return;
+        }
+
+        if (buffer->RecordedDepth == 0)
+            return;
+
+        --buffer->RecordedDepth;
+    }
+    else
+    {
+        uint64_t writePos = buffer->WritePos.load(std::memory_order_relaxed);
+        uint64_t readPos = buffer->ReadPos.load(std::memory_order_acquire);
+
+        size_t freeSlots = ThreadBuffer::CAPACITY - static_cast<size_t>(writePos - readPos);
+
+        // Keep one slot per open scope for its End event, plus one for this event.
+        bool hasRoom = freeSlots > static_cast<size_t>(buffer->RecordedDepth) + 1;
+
+        if (!hasRoom || (type == EventType::Begin && buffer->DroppedDepth > 0))
+        {
+            buffer->DroppedEvents.fetch_add(1, std::memory_order_relaxed);
+
+            if (type == EventType::Begin)
+                ++buffer->DroppedDepth;
+
+            return;
+        }
+
+        if (type == EventType::Begin)
+            ++buffer->RecordedDepth;
+    }
+
+    uint64_t writePos = buffer->WritePos.load(std::memory_order_relaxed);
+
+    Event& event = buffer->Events[writePos % ThreadBuffer::CAPACITY];
+    event.Type = type;
+    event.Counter = counter;
+    event.Name = name;
+    event.Value = value;
+
+    buffer->WritePos.store(writePos + 1, std::memory_order_release);
+}
+
+void Profiler::BeginScope(const char* name)
+{
+    Record(EventType::Begin, ProfileCounter::Count, name, Now());
+}
+
+void Profiler::EndScope()
+{
+    Record(EventType::End, ProfileCounter::Count, nullptr, Now());
+}
+
+void Profiler::AddCounter(ProfileCounter counter, int64_t value)
+{
+    Record(EventType::Counter, counter, nullptr, value);
+}
+
+void Profiler::EndFrame()
+{
+    int64_t frameEndTime = Now();
+
+    FrameData frame{};
+    frame.FrameIdx = m_frameIdx++;
+    frame.StartTime = m_frameStartTime;
+    frame.DurationMs = static_cast<double>(frameEndTime - m_frameStartTime) / 1e6;
+
+    auto toFrameMs = [&](int64_t time) {
+        return static_cast<double>(time - frame.StartTime) / 1e6;
+    };
+
+    std::lock_guard lock(m_threadsMutex);
+
+    for (auto& buffer : m_threads)
+    {
+        uint64_t readPos = buffer->ReadPos.load(std::memory_order_relaxed);
+        uint64_t writePos = buffer->WritePos.load(std::memory_order_acquire);
+
+        m_closedScopes.clear();
+
+        for (uint64_t pos = readPos; pos < writePos; ++pos)
+        {
+            const Event& event = buffer->Events[pos % ThreadBuffer::CAPACITY];
+
+            switch (event.Type)
+            {
+                case EventType::Begin:
+                {
+                    uint64_t parentId =
+                        buffer->OpenScopes.empty() ? NO_SCOPE : buffer->OpenScopes.back().Id;
+
+                    buffer->OpenScopes.push_back(
+                        {event.Name, event.Value, {}, buffer->NextScopeId++, parentId});
+                    break;
+                }
+
+                case EventType::Counter:
+                {
+                    int counterIdx = static_cast<int>(event.Counter);
+
+                    if (!buffer->OpenScopes.empty())
+                        buffer->OpenScopes.back().Counters[counterIdx] += event.Value;
+
+                    frame.Counters[counterIdx] += event.Value;
+                    break;
+                }
+
+                case EventType::End:
+                {
+                    if (buffer->OpenScopes.empty())
+                        break;
+
+                    const auto& scope = buffer->OpenScopes.back();
+
+                    Node node{};
+                    node.Name = scope.Name;
+                    node.ThreadIdx = buffer->ThreadIdx;
+                    node.Depth = static_cast<int>(buffer->OpenScopes.size()) - 1;
+                    node.StartMs = toFrameMs(scope.StartTime);
+                    node.DurationMs = static_cast<double>(event.Value - scope.StartTime) / 1e6;
+                    std::copy(std::begin(scope.Counters), std::end(scope.Counters),
+                              std::begin(node.Counters));
+
+                    m_closedScopes.push_back({node, scope.Id, scope.ParentId});
+
+                    buffer->OpenScopes.pop_back();
+                    break;
+                }
+            }
+        }
+
+        buffer->ReadPos.store(writePos, std::memory_order_release);
+
+        frame.DroppedEvents += buffer->DroppedEvents.exchange(0, std::memory_order_relaxed);
+
+        // Scopes close children-first, so order them by when they began before linking parents.
+        // A parent that is still open has no node, and leaves its children as roots.
+        auto byId = [](const ClosedScope& a, const ClosedScope& b) {
+            return a.Id < b.Id;
+        };
+
+        std::sort(m_closedScopes.begin(), m_closedScopes.end(), byId);
+
+        auto firstNode = static_cast<int>(frame.Nodes.size());
+
+        for (const ClosedScope& scope : m_closedScopes)
+        {
+            Node& node = frame.Nodes.emplace_back(scope.Data);
+
+            auto parent = std::lower_bound(m_closedScopes.begin(), m_closedScopes.end(),
+                                           ClosedScope{{}, scope.ParentId, NO_SCOPE}, byId);
+
+            if (parent != m_closedScopes.end() && parent->Id == scope.ParentId)
+                node.Parent = firstNode + static_cast<int>(parent - m_closedScopes.begin());
+        }
+    }
+
+    m_frames.push_back(std::move(frame));
+
+    if (m_frames.size() > FRAME_HISTORY_SIZE)
+        m_frames.pop_front();
+
+    m_frameStartTime = frameEndTime;
+}
+
+const Profiler::FrameData& Profiler::GetLastFrame() const
+{
+    static const FrameData emptyFrame{};
+
+    return m_frames.empty() ? emptyFrame : m_frames.back();
+}
+
+void Profiler::WriteChromeTrace(const fs::path& path) const
+{
+    json events = json::array();
+
+    if (!m_frames.empty())
+    {
+        int64_t traceStartTime = m_frames.front().StartTime;
+
+        auto toTraceUs = [&](int64_t frameStartTime, double frameMs) {
+            return static_cast<double>(frameStartTime - traceStartTime) / 1e3 + frameMs * 1e3;
+        };
+
+        for (const auto& frame : m_frames)
+        {
+            events.push_back({
+                {"name", "Frame " + std::to_string(frame.FrameIdx)},
+                {"cat", "frame"},
+                {"ph", "X"},
+                {"ts", toTraceUs(frame.StartTime, 0.0)},
+                {"dur", frame.DurationMs * 1e3},
+                {"pid", 0},
+                {"tid", -1}
+            });
+
+            json counterArgs = json::object();
+
+            for (int i = 0; i < NUM_COUNTERS; ++i)
+            {
+                counterArgs[GetCounterName(i)] = frame.Counters[i];
+            }
+
+            events.push_back({
+                {"name", "Counters"},
+                {"ph", "C"},
+                {"ts", toTraceUs(frame.StartTime, 0.0)},
+                {"pid", 0},
+                {"args", counterArgs}
+            });
+
+            for (const auto& node : frame.Nodes)
+            {
+                events.push_back({
+                    {"name", node.Name},
+                    {"cat", "cpu"},
+                    {"ph", "X"},
+                    {"ts", toTraceUs(frame.StartTime, node.StartMs)},
+                    {"dur", node.DurationMs * 1e3},
+                    {"pid", 0},
+                    {"tid", node.ThreadIdx}
+                });
+            }
+        }
+    }
+
+    json traceJson = {
+        {"traceEvents", events},
+        {"displayTimeUnit", "ms"}
+    };
+
+    std::ofstream strm(path);
+    if (!strm.is_open())
+        throw std::runtime_error("Could not open file.");
+
+    strm << traceJson.dump();
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifndef GRFX_PROFILER_ENABLED
+#define GRFX_PROFILER_ENABLED 1
+#endif
+
+enum class ProfileCounter
+{
+    DrawCalls,
+    StateChanges,
+    Triangles,
+
+    Count
+};
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable:4324) // Structure padded due to alignment specifier.
+#endif
+
+// Hierarchical CPU profiler. Scopes are recorded into a per-thread ring buffer with no locking on
+// the hot path, and collected into a per-frame tree by EndFrame(). Names must be string literals
+// (or otherwise outlive the profiler) since only the pointer is stored.
+class Profiler
+{
+public:
+    static constexpr int NUM_COUNTERS = static_cast<int>(ProfileCounter::Count);
+
+    static Profiler& Get();
+
+    static bool IsEnabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    static void SetEnabled(bool enabled);
+
+    void BeginScope(const char* name);
+    void EndScope();
+
+    // Attributes |value| to the innermost open scope on the calling thread.
+    void AddCounter(ProfileCounter counter, int64_t value);
+
+    // Collects everything recorded since the previous call. Must only be called from one thread.
+    void EndFrame();
+
+    struct Node
+    {
+        const char* Name = nullptr;
+
+        int ThreadIdx = 0;
+        int Depth = 0;
+
+        // Index into FrameData::Nodes, or -1 for roots and for scopes whose parent was still open
+        // when the frame ended.
+        int Parent = -1;
+
+        // Relative to FrameData::StartTime.
+        double StartMs = 0.0;
+        double DurationMs = 0.0;
+
+        // Counters recorded directly inside this scope, excluding children.
+        int64_t Counters[NUM_COUNTERS]{};
+    };
+
+    struct FrameData
+    {
+        uint64_t FrameIdx = 0;
+
+        int64_t StartTime = 0;
+        double DurationMs = 0.0;
+
+        // Scopes that closed during the frame, ordered by thread and then start time.
+        std::vector<Node> Nodes;
+
+        int64_t Counters[NUM_COUNTERS]{};
+
+        size_t DroppedEvents = 0;
+    };
+
+    // Most recently completed frame.
+    const FrameData& GetLastFrame() const;
+
+    // Writes the retained frame history in the Chrome trace event format, which is also what
+    // Perfetto imports.
+    void WriteChromeTrace(const std::filesystem::path& path) const;
+
+    static constexpr size_t FRAME_HISTORY_SIZE = 300;
+
+private:
+    Profiler();
+
+    enum class EventType : uint8_t
+    {
+        Begin,
+        End,
+        Counter
+    };
+
+    struct Event
+    {
+        EventType Type;
+        ProfileCounter Counter;
+
+        const char* Name;
+
+        // Timestamp in nanoseconds for Begin/End, the counter increment otherwise.
+        int64_t Value;
+    };
+
+    // Single-producer, single-consumer ring. The owning thread writes, EndFrame() reads.
+    struct ThreadBuffer
+    {
+        static constexpr size_t CAPACITY = 1 << 16;
+
+        Event Events[CAPACITY];
+
+        alignas(64) std::atomic<uint64_t> WritePos = 0;
+        alignas(64) std::atomic<uint64_t> ReadPos = 0;
+
+        std::atomic<size_t> DroppedEvents = 0;
+
+        int ThreadIdx = 0;
+
+        // Producer-side nesting depth of recorded and dropped Begin events. Space for the End of
+        // every recorded Begin is reserved so that scopes never lose their closing event.
+        int RecordedDepth = 0;
+        int DroppedDepth = 0;
+
+        // Consumer-side state - scopes still open at the end of the last collected frame. Scopes
+        // are numbered in the order they began, so that children can find their parent.
+        struct OpenScope
+        {
+            const char* Name;
+            int64_t StartTime;
+            int64_t Counters[NUM_COUNTERS];
+
+            uint64_t Id;
+            uint64_t ParentId;
+        };
+
+        std::vector<OpenScope> OpenScopes;
+        uint64_t NextScopeId = 0;
+    };
+
+    static constexpr uint64_t NO_SCOPE = UINT64_MAX;
+
+    // A node as collected, before it is linked to its parent.
+    struct ClosedScope
+    {
+        Node Data;
+
+        uint64_t Id;
+        uint64_t ParentId;
+    };
+
+    ThreadBuffer* GetThreadBuffer();
+
+    void Record(EventType type, ProfileCounter counter, const char* name, int64_t value);
+
+    static int64_t Now();
+
+    static std::atomic<bool> s_enabled;
+
+    std::mutex m_threadsMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_threads;
+
+    int64_t m_frameStartTime = 0;
+    uint64_t m_frameIdx = 0;
+
+    std::deque<FrameData> m_frames;
+
+    // Scratch for EndFrame().
+    std::vector<ClosedScope> m_closedScopes;
+};
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name)
+        : m_active(Profiler::IsEnabled())
+    {
+        if (m_active)
+            Profiler::Get().BeginScope(name);
+    }
+
+    ~ProfileScope()
+    {
+        if (m_active)
+            Profiler::Get().EndScope();
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    bool m_active;
+};
+
+#if GRFX_PROFILER_ENABLED
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+#define PROFILE_COUNTER(counter, value)                                \
+    do                                                                 \
+    {                                                                  \
+        if (Profiler::IsEnabled())                                     \
+            Profiler::Get().AddCounter(counter, value);                \
+    } while (false)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_COUNTER(counter, value) ((void)0)
+
+#endif
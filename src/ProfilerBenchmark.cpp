@@ -0,0 +1,309 @@
+// Benchmark for the frame profiler's recorder. Measures the cost of a PROFILE_SCOPE - with
+// recording off, on, and on with a counter inside - first on one thread and then on several
+// threads recording at once, as job workers do. Threads record in batches that fit their ring
+// buffers, and the frame is collected between batches, outside the timing. Checks that no event
+// is dropped, that every scope shows up in its frame, that nothing is recorded while recording
+// is off and that scopes are linked to their parents, or left as roots when the parent is still
+// open as the frame ends. Exits with an error if any check fails.
+
+#include "BenchmarkUtils.h"
+#include "Profiler.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <barrier>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+
+struct Options
+{
+    std::string OutPath = "profiler_benchmark_results.json";
+
+    int NumScopes = 1000000;
+
+    std::vector<int> ThreadCounts = {1, 2, 4, 8};
+};
+
+constexpr const char* USAGE =
+    "Usage: ProfilerBenchmark [options]\n"
+    "  --scopes N          Scopes timed on each thread (default 1000000)\n"
+    "  --threads N[,N...]  Threads recording at once (default 1,2,4,8)\n"
+    "  --out FILE          Results file (default profiler_benchmark_results.json)\n";
+
+std::vector<int> ParseThreadCounts(const std::string& value)
+{
+    std::vector<int> counts;
+    std::stringstream strm(value);
+    std::string item;
+
+    while (std::getline(strm, item, ','))
+        counts.push_back(std::stoi(item));
+
+    return counts;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--scopes")
+            options->NumScopes = std::stoi(value);
+        else if (arg == "--threads")
+            options->ThreadCounts = ParseThreadCounts(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->NumScopes > 0 && !options->ThreadCounts.empty() &&
+        *std::min_element(options->ThreadCounts.begin(), options->ThreadCounts.end()) > 0;
+}
+
+// Scopes each thread records between collections. With a counter, a scope takes three events,
+// so a batch fills three quarters of a thread's ring buffer.
+constexpr int SCOPES_PER_BATCH = 16384;
+
+enum class Mode
+{
+    Disabled,
+    Enabled,
+    EnabledWithCounter
+};
+
+struct RunResult
+{
+    double ScopeNs = 0.0;
+
+    size_t DroppedEvents = 0;
+
+    // Whether every collected frame held exactly the scopes recorded in it.
+    bool FramesComplete = true;
+};
+
+RunResult MeasureThreads(int numThreads, int numScopes, Mode mode)
+{
+    Profiler& profiler = Profiler::Get();
+
+    Profiler::SetEnabled(mode != Mode::Disabled);
+
+    int numBatches = (numScopes + SCOPES_PER_BATCH - 1) / SCOPES_PER_BATCH;
+
+    auto batchSize = [&](int batch) {
+        return std::min(SCOPES_PER_BATCH, numScopes - batch * SCOPES_PER_BATCH);
+    };
+
+    RunResult result;
+
+    // The first frame holds each thread's untimed warm-up scope, which sets up its buffer.
+    int frameBatch = -1;
+
+    auto collect = [&]() noexcept {
+        profiler.EndFrame();
+
+        const Profiler::FrameData& frame = profiler.GetLastFrame();
+
+        size_t expected = mode == Mode::Disabled ? 0 : static_cast<size_t>(numThreads);
+
+        if (frameBatch >= 0)
+            expected *= static_cast<size_t>(batchSize(frameBatch));
+
+        result.DroppedEvents += frame.DroppedEvents;
+        result.FramesComplete = result.FramesComplete && frame.Nodes.size() == expected;
+
+        ++frameBatch;
+    };
+
+    // Drop whatever was recorded before.
+    profiler.EndFrame();
+
+    std::barrier sync(numThreads, collect);
+    std::vector<double> threadNs(static_cast<size_t>(numThreads));
+
+    auto record = [&](int threadIdx) {
+        {
+            PROFILE_SCOPE("Warm-up");
+        }
+
+        sync.arrive_and_wait();
+
+        for (int batch = 0; batch < numBatches; ++batch)
+        {
+            int count = batchSize(batch);
+
+            Clock::time_point start = Clock::now();
+
+            if (mode == Mode::EnabledWithCounter)
+            {
+                for (int i = 0; i < count; ++i)
+                {
+                    PROFILE_SCOPE("Scope");
+                    PROFILE_COUNTER(ProfileCounter::DrawCalls, 1);
+                }
+            }
+            else
+            {
+                for (int i = 0; i < count; ++i)
+                {
+                    PROFILE_SCOPE("Scope");
+                }
+            }
+
+            threadNs[threadIdx] +=
+                std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+            sync.arrive_and_wait();
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (int i = 1; i < numThreads; ++i)
+        threads.emplace_back(record, i);
+
+    record(0);
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    double totalNs = 0.0;
+
+    for (double ns : threadNs)
+        totalNs += ns;
+
+    result.ScopeNs = totalNs / (static_cast<double>(numThreads) * numScopes);
+
+    Profiler::SetEnabled(true);
+
+    return result;
+}
+
+// A scope that closes while its parent is still open at the end of the frame must be a root,
+// not the child of an unrelated scope that closed earlier. Scopes closing with their parent are
+// linked to it.
+bool CheckParentLinks()
+{
+    Profiler& profiler = Profiler::Get();
+
+    // Drop whatever was recorded before.
+    profiler.EndFrame();
+
+    profiler.BeginScope("Earlier");
+    profiler.EndScope();
+
+    profiler.BeginScope("Spanning");
+    profiler.BeginScope("Closed child");
+    profiler.EndScope();
+
+    profiler.EndFrame();
+
+    const std::vector<Profiler::Node>& firstNodes = profiler.GetLastFrame().Nodes;
+
+    bool passed = firstNodes.size() == 2 && firstNodes[0].Parent == -1 &&
+        firstNodes[1].Depth == 1 && firstNodes[1].Parent == -1;
+
+    profiler.BeginScope("Open child");
+    profiler.BeginScope("Grandchild");
+    profiler.EndScope();
+    profiler.EndScope();
+
+    profiler.EndScope();
+
+    profiler.EndFrame();
+
+    const std::vector<Profiler::Node>& secondNodes = profiler.GetLastFrame().Nodes;
+
+    // In the order the scopes began: Spanning, Open child and Grandchild.
+    return passed && secondNodes.size() == 3 && secondNodes[0].Parent == -1 &&
+        secondNodes[1].Parent == 0 && secondNodes[2].Parent == 1;
+}
+
+int RunBenchmark(const Options& options)
+{
+    Checks checks;
+    json scaling = json::array();
+
+    bool noneDropped = true;
+    bool framesComplete = true;
+    bool disabledRecordsNothing = true;
+
+    for (int numThreads : options.ThreadCounts)
+    {
+        RunResult disabled = MeasureThreads(numThreads, options.NumScopes, Mode::Disabled);
+        RunResult enabled = MeasureThreads(numThreads, options.NumScopes, Mode::Enabled);
+        RunResult withCounter =
+            MeasureThreads(numThreads, options.NumScopes, Mode::EnabledWithCounter);
+
+        noneDropped = noneDropped && enabled.DroppedEvents == 0 && withCounter.DroppedEvents == 0;
+        framesComplete = framesComplete && enabled.FramesComplete && withCounter.FramesComplete;
+        disabledRecordsNothing = disabledRecordsNothing && disabled.FramesComplete &&
+            disabled.DroppedEvents == 0;
+
+        scaling.push_back({
+            {"threads", numThreads},
+            {"scope_ns_disabled", disabled.ScopeNs},
+            {"scope_ns_enabled", enabled.ScopeNs},
+            {"scope_ns_enabled_with_counter", withCounter.ScopeNs}
+        });
+    }
+
+    checks.Check("no_events_dropped", noneDropped);
+    checks.Check("frames_complete", framesComplete);
+    checks.Check("disabled_records_nothing", disabledRecordsNothing);
+    checks.Check("open_parents_leave_roots", CheckParentLinks());
+
+    json results = {
+        {"scopes_per_thread", options.NumScopes},
+        {"scopes_per_batch", SCOPES_PER_BATCH},
+        {"scaling", scaling},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%8s %14s %14s %14s\n", "threads", "disabled ns", "enabled ns", "counter ns");
+
+    for (const json& run : scaling)
+    {
+        std::printf("%8d %14.2f %14.2f %14.2f\n", run["threads"].get<int>(),
+                    run["scope_ns_disabled"].get<double>(), run["scope_ns_enabled"].get<double>(),
+                    run["scope_ns_enabled_with_counter"].get<double>());
+    }
+
+    for (const auto& [name, passed] : checks.Results.items())
+        std::printf("%-28s %s\n", name.c_str(), passed.get<bool>() ? "passed" : "FAILED");
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Profiler checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
@@ -0,0 +1,148 @@
+#include "ProfilerWindow.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+
+void ProfilerWindow::Draw()
+{
+    if (!m_open)
+        return;
+
+    if (!ImGui::Begin("Profiler", &m_open))
+    {
+        ImGui::End();
+        return;
+    }
+
+    bool enabled = Profiler::IsEnabled();
+    if (ImGui::Checkbox("Enabled", &enabled))
+        Profiler::SetEnabled(enabled);
+
+    ImGui::SameLine();
+
+    if (ImGui::Checkbox("Paused", &m_paused) && m_paused)
+        m_pausedFrame = Profiler::Get().GetLastFrame();
+
+    ImGui::SameLine();
+
+    if (ImGui::Button("Save trace"))
+        Profiler::Get().WriteChromeTrace("profile_trace.json");
+
+    const Profiler::FrameData& frame = m_paused ? m_pausedFrame : Profiler::Get().GetLastFrame();
+
+    ImGui::Text("Frame %llu: %.3f ms", static_cast<unsigned long long>(frame.FrameIdx),
+                frame.DurationMs);
+
+    ImGui::Text("Draws: %lld  State changes: %lld  Triangles: %lld",
+                static_cast<long long>(frame.Counters[static_cast<int>(ProfileCounter::DrawCalls)]),
+                static_cast<long long>(
+                    frame.Counters[static_cast<int>(ProfileCounter::StateChanges)]),
+                static_cast<long long>(frame.Counters[static_cast<int>(ProfileCounter::Triangles)]));
+
+    if (frame.DroppedEvents > 0)
+        ImGui::TextColored(ImVec4(1.f, 0.4f, 0.4f, 1.f), "Dropped events: %zu",
+                           frame.DroppedEvents);
+
+    ImGui::InputInt("Thread", &m_flameGraphThread);
+    m_flameGraphThread = std::max(m_flameGraphThread, 0);
+
+    DrawFlameGraph(frame);
+
+    DrawScopeTable(frame);
+
+    ImGui::End();
+}
+
+void ProfilerWindow::DrawFlameGraph(const Profiler::FrameData& frame)
+{
+    static constexpr float rowHeight = 18.f;
+    static constexpr int maxDepth = 12;
+
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = std::max(ImGui::GetContentRegionAvail().x, 100.f);
+
+    ImGui::InvisibleButton("FlameGraph", ImVec2(width, rowHeight * maxDepth));
+
+    if (frame.DurationMs <= 0.0)
+        return;
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+
+    float msToPixels = width / static_cast<float>(frame.DurationMs);
+
+    ImVec2 mousePos = ImGui::GetIO().MousePos;
+
+    for (const auto& node : frame.Nodes)
+    {
+        if (node.ThreadIdx != m_flameGraphThread || node.Depth >= maxDepth)
+            continue;
+
+        float x0 = origin.x + std::max(static_cast<float>(node.StartMs), 0.f) * msToPixels;
+        float x1 = origin.x + static_cast<float>(node.StartMs + node.DurationMs) * msToPixels;
+        float y0 = origin.y + static_cast<float>(node.Depth) * rowHeight;
+        float y1 = y0 + rowHeight - 1.f;
+
+        x1 = std::min(x1, origin.x + width);
+
+        if (x1 - x0 < 1.f)
+            continue;
+
+        // Colour by name so a scope keeps its colour from frame to frame.
+        size_t hash = std::hash<const void*>()(node.Name);
+        ImU32 color = IM_COL32(90 + hash % 120, 90 + (hash >> 8) % 120, 160, 255);
+
+        drawList->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y1), color);
+
+        drawList->PushClipRect(ImVec2(x0, y0), ImVec2(x1, y1), true);
+        drawList->AddText(ImVec2(x0 + 2.f, y0 + 2.f), IM_COL32_WHITE, node.Name);
+        drawList->PopClipRect();
+
+        if (mousePos.x >= x0 && mousePos.x < x1 && mousePos.y >= y0 && mousePos.y < y1)
+            ImGui::SetTooltip("%s\n%.3f ms", node.Name, node.DurationMs);
+    }
+}
+
+void ProfilerWindow::DrawScopeTable(const Profiler::FrameData& frame)
+{
+    static constexpr ImGuiTableFlags tableFlags = ImGuiTableFlags_Borders |
+        ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable;
+
+    if (!ImGui::BeginTable("Scopes", 6, tableFlags, ImVec2(0.f, 300.f)))
+        return;
+
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Scope");
+    ImGui::TableSetupColumn("Thread");
+    ImGui::TableSetupColumn("Time (ms)");
+    ImGui::TableSetupColumn("Draws");
+    ImGui::TableSetupColumn("State changes");
+    ImGui::TableSetupColumn("Triangles");
+    ImGui::TableHeadersRow();
+
+    for (const auto& node : frame.Nodes)
+    {
+        ImGui::TableNextRow();
+
+        ImGui::TableNextColumn();
+        ImGui::Indent(static_cast<float>(node.Depth) * 12.f + 1.f);
+        ImGui::TextUnformatted(node.Name);
+        ImGui::Unindent(static_cast<float>(node.Depth) * 12.f + 1.f);
+
+        ImGui::TableNextColumn();
+        ImGui::Text("%d", node.ThreadIdx);
+
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", node.DurationMs);
+
+        for (int i = 0; i < Profiler::NUM_COUNTERS; ++i)
+        {
+            ImGui::TableNextColumn();
+            ImGui::Text("%lld", static_cast<long long>(node.Counters[i]));
+        }
+    }
+
+    ImGui::EndTable();
+}
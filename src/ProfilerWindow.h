@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Profiler.h"
+
+// ImGui overlay for the CPU profiler: a flame graph of the last frame and a table of its scopes.
+class ProfilerWindow
+{
+public:
+    void Draw();
+
+private:
+    void DrawFlameGraph(const Profiler::FrameData& frame);
+
+    void DrawScopeTable(const Profiler::FrameData& frame);
+
+    bool m_open = true;
+
+    bool m_paused = false;
+
+    // Copy of the frame being shown while paused.
+    Profiler::FrameData m_pausedFrame;
+
+    int m_flameGraphThread = 0;
+};
@@ -0,0 +1,885 @@
+// Renders a scene with the software renderer: the frames the app builds, drawn on the CPU. Flies
+// the camera along a scripted path at each requested thread count and reports how setup and
+// rasterization scale. The first frame can be written to a PNG, and compared against a golden
+// image for regression testing.
+//
+// Also checks the renderer itself: every thread count and SIMD level must produce the same
+// frames, small scenes must follow the fill rule, depth test, culling and texture sampling, and
+// written images must read back unchanged.
+
+#include "AssetArchive.h"
+#include "BenchmarkUtils.h"
+#include "CameraPath.h"
+#include "CommandStream.h"
+#include "FrameBuilder.h"
+#include "FramePacket.h"
+#include "GltfLoader.h"
+#include "Hash.h"
+#include "ImageDecoder.h"
+#include "JobSystem.h"
+#include "MaterialTable.h"
+#include "PixelKernels.h"
+#include "PngEncoder.h"
+#include "Profiler.h"
+#include "SoftwareRenderer.h"
+#include "Utils.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <numbers>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+using benchmark::ElapsedMs;
+
+struct Options
+{
+    std::string Scene = "sponza";
+    std::string Path = "orbit";
+    std::string OutPath = "raster_results.json";
+
+    // The first frame is written here, and compared against the golden image.
+    std::string ImagePath;
+    std::string GoldenPath;
+
+    // Largest difference of any channel from the golden image that still counts as a match.
+    int Tolerance = 1;
+
+    int NumBoxes = 8;
+
+    uint32_t Width = 1280;
+    uint32_t Height = 720;
+
+    int NumFrames = 30;
+    int NumWarmupFrames = 2;
+
+    // Thread counts to measure, zero meaning one per core.
+    std::vector<int> ThreadCounts = {0};
+};
+
+constexpr const char* USAGE =
+    "Usage: RasterBenchmark [options]\n"
+    "  --scene sponza|boxes     Scene to render (default sponza)\n"
+    "  --boxes N                Boxes along each side of the boxes scene (default 8)\n"
+    "  --path orbit|flythrough  Camera path (default orbit)\n"
+    "  --width N                Image width (default 1280)\n"
+    "  --height N               Image height (default 720)\n"
+    "  --frames N               Measured frames (default 30)\n"
+    "  --warmup N               Unmeasured frames before measuring (default 2)\n"
+    "  --threads N[,N...]       Thread counts to measure, 0 for one per core (default 0)\n"
+    "  --image FILE             Write the first frame to a PNG\n"
+    "  --golden FILE            Compare the first frame against a PNG\n"
+    "  --tolerance N            Largest channel difference from the golden image (default 1)\n"
+    "  --out FILE               Results file (default raster_results.json)\n";
+
+std::vector<int> ParseThreadCounts(const std::string& value)
+{
+    std::vector<int> counts;
+    std::stringstream strm(value);
+    std::string item;
+
+    while (std::getline(strm, item, ','))
+        counts.push_back(std::stoi(item));
+
+    return counts;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--scene")
+            options->Scene = value;
+        else if (arg == "--boxes")
+            options->NumBoxes = std::stoi(value);
+        else if (arg == "--path")
+            options->Path = value;
+        else if (arg == "--width")
+            options->Width = static_cast<uint32_t>(std::stoul(value));
+        else if (arg == "--height")
+            options->Height = static_cast<uint32_t>(std::stoul(value));
+        else if (arg == "--frames")
+            options->NumFrames = std::stoi(value);
+        else if (arg == "--warmup")
+            options->NumWarmupFrames = std::stoi(value);
+        else if (arg == "--threads")
+            options->ThreadCounts = ParseThreadCounts(value);
+        else if (arg == "--image")
+            options->ImagePath = value;
+        else if (arg == "--golden")
+            options->GoldenPath = value;
+        else if (arg == "--tolerance")
+            options->Tolerance = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->NumFrames > 0 && options->NumBoxes > 0 && !options->ThreadCounts.empty();
+}
+
+// Tightly packed RGBA8 pixels.
+struct Image
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    std::vector<uint8_t> Pixels;
+};
+
+Image CopyImage(const SoftwareRenderer& renderer)
+{
+    Image image;
+    image.Width = renderer.GetWidth();
+    image.Height = renderer.GetHeight();
+
+    size_t rowSize = size_t{image.Width} * 4;
+    image.Pixels.resize(rowSize * image.Height);
+
+    for (uint32_t y = 0; y < image.Height; ++y)
+    {
+        std::copy_n(renderer.GetPixels() + y * renderer.GetRowPitch(), rowSize,
+                    image.Pixels.data() + y * rowSize);
+    }
+
+    return image;
+}
+
+Image DecodeImage(std::span<const std::byte> data)
+{
+    std::unique_ptr<ImageDecoder> decoder = CreateImageDecoder(data);
+
+    Image image;
+    image.Width = decoder->GetWidth();
+    image.Height = decoder->GetHeight();
+    image.Pixels.resize(size_t{image.Width} * image.Height * 4);
+
+    decoder->Decode(image.Pixels.data(), size_t{image.Width} * 4);
+
+    return image;
+}
+
+SoftwareTexture ToTexture(Image image)
+{
+    SoftwareTexture texture;
+    texture.Width = image.Width;
+    texture.Height = image.Height;
+    texture.Texels.resize(size_t{image.Width} * image.Height);
+
+    std::memcpy(texture.Texels.data(), image.Pixels.data(), image.Pixels.size());
+
+    return texture;
+}
+
+uint64_t HashImage(const SoftwareRenderer& renderer)
+{
+    Hasher hasher;
+
+    for (uint32_t y = 0; y < renderer.GetHeight(); ++y)
+    {
+        hasher.AddBytes(renderer.GetPixels() + y * renderer.GetRowPitch(),
+                        size_t{renderer.GetWidth()} * 4);
+    }
+
+    return hasher.GetHash();
+}
+
+// Everything needed to build the scene's frames and render them, independent of any job system.
+struct SceneData
+{
+    std::vector<glm::mat4> Transforms;
+    std::vector<RenderObject> Objects;
+
+    std::vector<SoftwareGeometry> Geometry;
+
+    // Indexed by texture ID.
+    std::vector<SoftwareTexture> Textures;
+
+    std::vector<MaterialRecord> Materials;
+};
+
+// Every primitive of the Sponza model, with its textures. Geometry indices are the primitive
+// indices and texture IDs the image indices, as in FrameBenchmark.
+SceneData LoadSponzaScene()
+{
+    ModelData model = LoadGltfModelData("assets/sponza/Sponza.gltf");
+
+    SceneData scene;
+    scene.Transforms.push_back(glm::scale(glm::mat4(1.f), glm::vec3(0.008f)));
+
+    for (const MeshData& mesh : model.Meshes)
+    {
+        for (const PrimitiveData& prim : mesh.Primitives)
+        {
+            RenderObject object{};
+            object.GeometryIdx = static_cast<uint32_t>(scene.Geometry.size());
+            object.MaterialIdx = static_cast<uint32_t>(prim.MaterialIdx);
+            object.BaseColorTextureId = model.Materials[prim.MaterialIdx].BaseColorTextureId;
+            object.IndexCount = prim.Indices.Count;
+            object.LocalBoundsMin = prim.BoundsMin;
+            object.LocalBoundsMax = prim.BoundsMax;
+
+            scene.Objects.push_back(object);
+            scene.Geometry.push_back(ReadSoftwareGeometry(model, prim));
+        }
+    }
+
+    for (const std::filesystem::path& path : model.Images)
+        scene.Textures.push_back(ToTexture(DecodeImage(ReadAssetFile(path, nullptr))));
+
+    for (const Material& material : model.Materials)
+        scene.Materials.push_back(MaterialTable::Pack(material));
+
+    return scene;
+}
+
+// A grid of turned copies of the box model, tinted from a palette. Loads without Sponza's large
+// buffers.
+SceneData LoadBoxesScene(int numBoxes)
+{
+    ModelData model = LoadGltfModelData("assets/box/Box.gltf");
+
+    const PrimitiveData& prim = model.Meshes.at(0).Primitives.at(0);
+
+    SceneData scene;
+    scene.Geometry.push_back(ReadSoftwareGeometry(model, prim));
+
+    static const glm::vec4 palette[] = {
+        {1.f, 1.f, 1.f, 1.f}, {1.f, 0.5f, 0.2f, 1.f}, {0.3f, 0.8f, 0.3f, 1.f},
+        {0.3f, 0.5f, 1.f, 1.f}, {1.f, 1.f, 0.3f, 1.f}, {0.8f, 0.3f, 0.9f, 1.f}
+    };
+
+    Material boxMaterial = model.Materials.at(static_cast<size_t>(prim.MaterialIdx));
+
+    for (const glm::vec4& tint : palette)
+    {
+        Material material = boxMaterial;
+        material.BaseColorFactor = tint;
+        scene.Materials.push_back(MaterialTable::Pack(material));
+    }
+
+    for (int z = 0; z < numBoxes; ++z)
+    {
+        for (int x = 0; x < numBoxes; ++x)
+        {
+            int i = z * numBoxes + x;
+
+            glm::vec3 position(static_cast<float>(x) * 2.f, static_cast<float>(i % 3) * 0.5f,
+                               static_cast<float>(z) * 2.f);
+
+            glm::mat4 worldMat = glm::rotate(glm::translate(glm::mat4(1.f), position),
+                                             static_cast<float>(i) * 0.4f,
+                                             glm::vec3(0.3f, 1.f, 0.f));
+
+            RenderObject object{};
+            object.GeometryIdx = 0;
+            object.MaterialIdx = static_cast<uint32_t>(static_cast<size_t>(i) % std::size(palette));
+            object.IndexCount = prim.Indices.Count;
+            object.TransformIdx = static_cast<uint32_t>(scene.Transforms.size());
+            object.LocalBoundsMin = prim.BoundsMin;
+            object.LocalBoundsMax = prim.BoundsMax;
+
+            scene.Transforms.push_back(worldMat);
+            scene.Objects.push_back(object);
+        }
+    }
+
+    return scene;
+}
+
+struct RunResult
+{
+    std::vector<double> SetupTimes;
+    std::vector<double> RasterTimes;
+    std::vector<double> FrameTimes;
+
+    // Of every measured frame's pixels, in order.
+    uint64_t FramesHash = 0;
+
+    // The first frame, rendered at t = 0.
+    Image FirstImage;
+
+    SoftwareRenderer::Stats Totals;
+    int NumThreads = 0;
+};
+
+// Builds each frame with FrameBuilder::BuildFramePacket(), as the app does, and renders it.
+RunResult RenderFrames(const Options& options, const SceneData& scene, int numThreads,
+                       SimdLevel level, int numFrames, int numWarmupFrames)
+{
+    JobSystem jobSystem(numThreads);
+    FrameBuilder builder(&jobSystem);
+
+    for (const glm::mat4& transform : scene.Transforms)
+        builder.AddTransform(transform);
+
+    for (const RenderObject& object : scene.Objects)
+        builder.AddObject(object);
+
+    SoftwareRenderer renderer(&jobSystem, options.Width, options.Height, level);
+
+    for (const SoftwareGeometry& geometry : scene.Geometry)
+        renderer.AddGeometry(geometry);
+
+    for (size_t i = 0; i < scene.Textures.size(); ++i)
+        renderer.SetTexture(static_cast<TextureId>(i), scene.Textures[i]);
+
+    renderer.SetMaterials(scene.Materials);
+
+    builder.UpdateTransforms();
+
+    glm::vec3 sceneMin;
+    glm::vec3 sceneMax;
+    builder.GetSceneBounds(&sceneMin, &sceneMax);
+
+    CameraPath::Type pathType;
+    CameraPath::ParseType(options.Path, &pathType);
+    CameraPath path(pathType, sceneMin, sceneMax);
+
+    glm::mat4 projMat = glm::perspective(std::numbers::pi_v<float> / 4.f,
+                                         static_cast<float>(options.Width) /
+                                             static_cast<float>(options.Height),
+                                         0.1f, 1000.f);
+
+    RunResult result;
+    result.NumThreads = jobSystem.GetThreadCount();
+
+    Hasher framesHash;
+    FramePacket packet;
+
+    for (int frame = -numWarmupFrames; frame < numFrames; ++frame)
+    {
+        bool measured = frame >= 0;
+
+        float t = static_cast<float>(std::max(frame, 0)) / static_cast<float>(numFrames);
+
+        packet.Arena.Reset();
+        packet.FrameIdx = static_cast<uint64_t>(frame + numWarmupFrames);
+        packet.ViewMat = path.GetViewMat(t);
+        packet.ProjMat = projMat;
+        packet.ViewProjMat = projMat * packet.ViewMat;
+        packet.LightPos = glm::vec4(0.f, 10.f, 0.f, 1.f);
+
+        builder.BuildFramePacket(&packet);
+
+        Clock::time_point start = Clock::now();
+
+        renderer.RenderFrame(packet);
+
+        double frameMs = ElapsedMs(start);
+
+        if (!measured)
+            continue;
+
+        const SoftwareRenderer::Stats& stats = renderer.GetStats();
+
+        result.SetupTimes.push_back(stats.SetupMs);
+        result.RasterTimes.push_back(stats.RasterMs);
+        result.FrameTimes.push_back(frameMs);
+
+        result.Totals.NumTriangles += stats.NumTriangles;
+        result.Totals.NumRasterized += stats.NumRasterized;
+        result.Totals.NumBinned += stats.NumBinned;
+        result.Totals.NumPixelsShaded += stats.NumPixelsShaded;
+
+        framesHash.Add(HashImage(renderer));
+
+        if (frame == 0)
+            result.FirstImage = CopyImage(renderer);
+    }
+
+    result.FramesHash = framesHash.GetHash();
+
+    return result;
+}
+
+json SummarizeTimes(const std::vector<double>& times)
+{
+    double sum = 0.0;
+
+    for (double time : times)
+        sum += time;
+
+    return {
+        {"mean_ms", times.empty() ? 0.0 : sum / static_cast<double>(times.size())},
+        {"p50_ms", utils::Percentile(times, 0.5)},
+        {"p95_ms", utils::Percentile(times, 0.95)}
+    };
+}
+
+// A triangle of the small check scenes, in clip space with w = 1, so that x and y are NDC.
+struct CheckTriangle
+{
+    glm::vec3 Positions[3];
+    glm::vec2 TexCoords[3];
+};
+
+// Renders the triangles in order, each as its own geometry and draw with material |i|.
+SoftwareRenderer::Stats RenderTriangles(SoftwareRenderer* renderer,
+                                        const std::vector<CheckTriangle>& triangles,
+                                        TextureId textureId)
+{
+    std::vector<InstanceData> instances;
+    std::vector<Command> commands;
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        SoftwareGeometry geometry;
+        geometry.Positions.assign(triangles[i].Positions, triangles[i].Positions + 3);
+        geometry.TexCoords.assign(triangles[i].TexCoords, triangles[i].TexCoords + 3);
+        geometry.Indices = {0, 1, 2};
+
+        uint32_t geometryIdx = renderer->AddGeometry(std::move(geometry));
+
+        InstanceData instance{};
+        instance.WorldViewProjMat = glm::mat4(1.f);
+        instance.MaterialIdx = static_cast<uint32_t>(i);
+        instances.push_back(instance);
+
+        commands.push_back({CommandType::SetBaseColorTexture, static_cast<uint32_t>(textureId)});
+        commands.push_back({CommandType::SetGeometry, geometryIdx});
+        commands.push_back({CommandType::SetInstanceCount, 1});
+        commands.push_back({CommandType::DrawIndexed, 3});
+    }
+
+    FramePacket packet;
+    packet.Instances = instances;
+    packet.Commands = commands;
+
+    renderer->RenderFrame(packet);
+
+    return renderer->GetStats();
+}
+
+uint32_t GetPixel(const SoftwareRenderer& renderer, uint32_t x, uint32_t y)
+{
+    uint32_t pixel = 0;
+    std::memcpy(&pixel, renderer.GetPixels() + y * renderer.GetRowPitch() + x * 4, 4);
+
+    return pixel;
+}
+
+size_t CountUncleared(const SoftwareRenderer& renderer)
+{
+    size_t count = 0;
+
+    for (uint32_t y = 0; y < renderer.GetHeight(); ++y)
+    {
+        for (uint32_t x = 0; x < renderer.GetWidth(); ++x)
+        {
+            if (GetPixel(renderer, x, y) != 0xFF000000u)
+                ++count;
+        }
+    }
+
+    return count;
+}
+
+std::vector<MaterialRecord> MakeCheckMaterials(size_t count)
+{
+    std::vector<MaterialRecord> records(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        float shade = static_cast<float>(i + 1) / static_cast<float>(count);
+        records[i].BaseColorFactor = glm::vec4(shade, 1.f - shade, 0.5f, 1.f);
+    }
+
+    return records;
+}
+
+// Triangles that share edges must together cover each pixel exactly once. Each is drawn nearer
+// than the last, so a pixel covered twice is shaded twice.
+bool CheckFillRule(JobSystem* jobSystem, SimdLevel level)
+{
+    constexpr uint32_t size = 97;
+
+    SoftwareRenderer renderer(jobSystem, size, size, level);
+
+    // Two halves of the whole view, split along the diagonal.
+    std::vector<CheckTriangle> quad = {
+        {{{-1.f, 1.f, 0.6f}, {1.f, 1.f, 0.6f}, {-1.f, -1.f, 0.6f}}, {}},
+        {{{1.f, 1.f, 0.5f}, {1.f, -1.f, 0.5f}, {-1.f, -1.f, 0.5f}}, {}}
+    };
+
+    renderer.SetMaterials(MakeCheckMaterials(quad.size()));
+
+    if (RenderTriangles(&renderer, quad, -1).NumPixelsShaded != size * size)
+        return false;
+
+    // A fan around an off-center point, with edges at every angle.
+    constexpr int numFanTriangles = 23;
+
+    std::vector<CheckTriangle> fan;
+    glm::vec3 center(0.137f, -0.071f, 0.f);
+
+    float step = 2.f * std::numbers::pi_v<float> / static_cast<float>(numFanTriangles);
+
+    for (int i = 0; i < numFanTriangles; ++i)
+    {
+        float a0 = step * static_cast<float>(i);
+        float a1 = step * static_cast<float>(i + 1);
+        float depth = 0.9f - 0.03f * static_cast<float>(i);
+
+        glm::vec3 c(center.x, center.y, depth);
+
+        // Clockwise, from the later angle to the earlier one.
+        fan.push_back({{c, glm::vec3(center.x + 0.83f * std::cos(a1),
+                                     center.y + 0.79f * std::sin(a1), depth),
+                        glm::vec3(center.x + 0.83f * std::cos(a0),
+                                  center.y + 0.79f * std::sin(a0), depth)},
+                       {}});
+    }
+
+    renderer.SetMaterials(MakeCheckMaterials(fan.size()));
+
+    SoftwareRenderer::Stats stats = RenderTriangles(&renderer, fan, -1);
+
+    return stats.NumPixelsShaded > 0 && stats.NumPixelsShaded == CountUncleared(renderer);
+}
+
+// Nearer triangles win whichever order they are drawn in.
+bool CheckDepthTest(JobSystem* jobSystem, SimdLevel level)
+{
+    constexpr uint32_t size = 64;
+
+    SoftwareRenderer renderer(jobSystem, size, size, level);
+
+    CheckTriangle nearTriangle = {{{-1.f, 1.f, 0.2f}, {1.f, 1.f, 0.2f}, {-1.f, -1.f, 0.2f}}, {}};
+    CheckTriangle farTriangle = {{{-1.f, 1.f, 0.7f}, {1.f, 1.f, 0.7f}, {-1.f, -1.f, 0.7f}}, {}};
+
+    std::vector<MaterialRecord> materials(2);
+    materials[0].BaseColorFactor = glm::vec4(1.f, 0.f, 0.f, 1.f);
+    materials[1].BaseColorFactor = glm::vec4(0.f, 1.f, 0.f, 1.f);
+
+    renderer.SetMaterials(materials);
+    RenderTriangles(&renderer, {nearTriangle, farTriangle}, -1);
+
+    // Just inside the triangle's top-left corner.
+    uint32_t nearFirst = GetPixel(renderer, 2, 2);
+
+    std::swap(materials[0], materials[1]);
+
+    renderer.SetMaterials(materials);
+    RenderTriangles(&renderer, {farTriangle, nearTriangle}, -1);
+
+    uint32_t nearSecond = GetPixel(renderer, 2, 2);
+
+    return nearFirst == 0xFF0000FFu && nearSecond == 0xFF0000FFu;
+}
+
+// Counter-clockwise triangles are back faces and culled.
+bool CheckBackFaceCulling(JobSystem* jobSystem, SimdLevel level)
+{
+    SoftwareRenderer renderer(jobSystem, 64, 64, level);
+    renderer.SetMaterials(MakeCheckMaterials(1));
+
+    CheckTriangle backFace = {{{-1.f, 1.f, 0.5f}, {-1.f, -1.f, 0.5f}, {1.f, 1.f, 0.5f}}, {}};
+
+    return RenderTriangles(&renderer, {backFace}, -1).NumPixelsShaded == 0;
+}
+
+// A two-texel texture stretched across the view, so that every pixel blends the texels
+// differently and those at the edges wrap around: black on the left and white on the right,
+// times the material's factor.
+bool CheckTextureSampling(JobSystem* jobSystem, SimdLevel level)
+{
+    constexpr uint32_t width = 80;
+    constexpr uint32_t height = 8;
+
+    SoftwareRenderer renderer(jobSystem, width, height, level);
+
+    SoftwareTexture texture;
+    texture.Width = 2;
+    texture.Height = 1;
+    texture.Texels = {0xFF000000u, 0xFFFFFFFFu};
+
+    renderer.SetTexture(3, texture);
+
+    glm::vec4 factor(1.f, 0.5f, 0.25f, 0.75f);
+
+    std::vector<MaterialRecord> materials(2);
+    materials[0].BaseColorFactor = factor;
+    materials[1].BaseColorFactor = factor;
+    renderer.SetMaterials(materials);
+
+    std::vector<CheckTriangle> quad = {
+        {{{-1.f, 1.f, 0.5f}, {1.f, 1.f, 0.5f}, {-1.f, -1.f, 0.5f}},
+         {{0.f, 0.f}, {1.f, 0.f}, {0.f, 1.f}}},
+        {{{1.f, 1.f, 0.5f}, {1.f, -1.f, 0.5f}, {-1.f, -1.f, 0.5f}},
+         {{1.f, 0.f}, {1.f, 1.f}, {0.f, 1.f}}}
+    };
+
+    RenderTriangles(&renderer, quad, 3);
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            // The texel coordinate, between the two texel centers and wrapping past them.
+            float tx = (static_cast<float>(x) + 0.5f) / static_cast<float>(width) * 2.f - 0.5f;
+            float white = tx < 0.f ? -tx : (tx < 1.f ? tx : 2.f - tx);
+
+            uint32_t pixel = GetPixel(renderer, x, y);
+
+            for (int c = 0; c < 4; ++c)
+            {
+                float expected = (c < 3 ? white : 1.f) * factor[c] * 255.f;
+                float actual = static_cast<float>((pixel >> (8 * c)) & 0xFF);
+
+                if (std::abs(actual - expected) > 1.f)
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Compares against the golden image. Returns whether every channel is within |tolerance|.
+bool CompareImages(const Image& image, const Image& golden, int tolerance, json* results)
+{
+    if (image.Width != golden.Width || image.Height != golden.Height)
+    {
+        (*results)["size_matches"] = false;
+        return false;
+    }
+
+    int maxDifference = 0;
+    size_t numDiffering = 0;
+
+    for (size_t i = 0; i < image.Pixels.size(); i += 4)
+    {
+        int pixelDifference = 0;
+
+        for (size_t c = 0; c < 4; ++c)
+        {
+            pixelDifference = std::max(pixelDifference,
+                                       std::abs(image.Pixels[i + c] - golden.Pixels[i + c]));
+        }
+
+        maxDifference = std::max(maxDifference, pixelDifference);
+
+        if (pixelDifference > 0)
+            ++numDiffering;
+    }
+
+    (*results)["size_matches"] = true;
+    (*results)["max_difference"] = maxDifference;
+    (*results)["differing_pixels"] = numDiffering;
+
+    return maxDifference <= tolerance;
+}
+
+int RunBenchmark(const Options& options)
+{
+    CameraPath::Type pathType;
+
+    if (!CameraPath::ParseType(options.Path, &pathType))
+    {
+        std::fprintf(stderr, "Unknown camera path %s.\n", options.Path.c_str());
+        return 1;
+    }
+
+    // Frames are timed here, and scopes from every frame would only fill the profiler's buffers.
+    Profiler::SetEnabled(false);
+
+    SceneData scene;
+
+    if (options.Scene == "sponza")
+    {
+        scene = LoadSponzaScene();
+    }
+    else if (options.Scene == "boxes")
+    {
+        scene = LoadBoxesScene(options.NumBoxes);
+    }
+    else
+    {
+        std::fprintf(stderr, "Unknown scene %s.\n", options.Scene.c_str());
+        return 1;
+    }
+
+    SimdLevel bestLevel = GetPixelKernels().Level;
+
+    Checks checks;
+
+    {
+        JobSystem jobSystem(options.ThreadCounts.front());
+
+        for (SimdLevel level :
+             {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2, SimdLevel::Neon})
+        {
+            if (!IsSimdLevelSupported(level))
+                continue;
+
+            std::string prefix = std::string(GetSimdLevelName(level)) + "_";
+
+            checks.Check(prefix + "fill_rule", CheckFillRule(&jobSystem, level));
+            checks.Check(prefix + "depth_test", CheckDepthTest(&jobSystem, level));
+            checks.Check(prefix + "back_face_culling", CheckBackFaceCulling(&jobSystem, level));
+            checks.Check(prefix + "texture_sampling", CheckTextureSampling(&jobSystem, level));
+        }
+    }
+
+    // Every level must render the scene's first frame exactly as the scalar kernel does.
+    RunResult scalar = RenderFrames(options, scene, options.ThreadCounts.front(),
+                                    SimdLevel::Scalar, 1, 0);
+
+    for (SimdLevel level : {SimdLevel::Sse41, SimdLevel::Avx2, SimdLevel::Neon})
+    {
+        if (!IsSimdLevelSupported(level))
+            continue;
+
+        RunResult simd = RenderFrames(options, scene, options.ThreadCounts.front(), level, 1, 0);
+
+        checks.Check(std::string(GetSimdLevelName(level)) + "_matches_scalar",
+                     simd.FramesHash == scalar.FramesHash);
+    }
+
+    std::vector<RunResult> runs;
+    json scaling = json::array();
+
+    for (int numThreads : options.ThreadCounts)
+    {
+        RunResult run = RenderFrames(options, scene, numThreads, bestLevel, options.NumFrames,
+                                     options.NumWarmupFrames);
+
+        double numFrames = static_cast<double>(options.NumFrames);
+
+        scaling.push_back({
+            {"threads", run.NumThreads},
+            {"setup", SummarizeTimes(run.SetupTimes)},
+            {"raster", SummarizeTimes(run.RasterTimes)},
+            {"frame", SummarizeTimes(run.FrameTimes)},
+            {"triangles_mean", static_cast<double>(run.Totals.NumTriangles) / numFrames},
+            {"rasterized_mean", static_cast<double>(run.Totals.NumRasterized) / numFrames},
+            {"binned_mean", static_cast<double>(run.Totals.NumBinned) / numFrames},
+            {"pixels_shaded_mean", static_cast<double>(run.Totals.NumPixelsShaded) / numFrames},
+            {"frames_hash", run.FramesHash}
+        });
+
+        runs.push_back(std::move(run));
+    }
+
+    bool threadsMatch = true;
+
+    for (const RunResult& run : runs)
+        threadsMatch = threadsMatch && run.FramesHash == runs.front().FramesHash;
+
+    checks.Check("thread_counts_match", threadsMatch);
+
+    const Image& firstImage = runs.front().FirstImage;
+
+    // Written images must decode to exactly the pixels rendered.
+    std::vector<std::byte> png = EncodePng(firstImage.Pixels.data(), firstImage.Width,
+                                           firstImage.Height, size_t{firstImage.Width} * 4);
+
+    checks.Check("png_round_trip", DecodeImage(png).Pixels == firstImage.Pixels);
+
+    if (!options.ImagePath.empty())
+    {
+        std::ofstream file(options.ImagePath, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(png.data()),
+                   static_cast<std::streamsize>(png.size()));
+
+        if (!file)
+        {
+            std::fprintf(stderr, "Could not write %s.\n", options.ImagePath.c_str());
+            return 1;
+        }
+    }
+
+    json golden = json::object();
+
+    if (!options.GoldenPath.empty())
+    {
+        Image goldenImage = DecodeImage(ReadAssetFile(options.GoldenPath, nullptr));
+
+        golden["path"] = options.GoldenPath;
+        golden["tolerance"] = options.Tolerance;
+
+        checks.Check("matches_golden",
+                     CompareImages(firstImage, goldenImage, options.Tolerance, &golden));
+    }
+
+    json results = {
+        {"scene", options.Scene},
+        {"path", options.Path},
+        {"width", options.Width},
+        {"height", options.Height},
+        {"frames", options.NumFrames},
+        {"warmup_frames", options.NumWarmupFrames},
+        {"simd_level", GetSimdLevelName(bestLevel)},
+        {"tile_size", SoftwareRenderer::TILE_SIZE},
+        {"objects", scene.Objects.size()},
+        {"scaling", scaling},
+        {"golden", golden},
+        {"png_bytes", png.size()},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s, %s path, %ux%u, %d frames, %s kernels\n", options.Scene.c_str(),
+                options.Path.c_str(), options.Width, options.Height, options.NumFrames,
+                GetSimdLevelName(bestLevel));
+
+    std::printf("%8s %12s %12s %12s %10s\n", "threads", "setup ms", "raster ms", "frame ms",
+                "speedup");
+
+    double baseMs = scaling.front()["frame"]["mean_ms"].get<double>();
+
+    for (const json& run : scaling)
+    {
+        double frameMs = run["frame"]["mean_ms"].get<double>();
+
+        std::printf("%8d %12.3f %12.3f %12.3f %9.2fx\n", run["threads"].get<int>(),
+                    run["setup"]["mean_ms"].get<double>(), run["raster"]["mean_ms"].get<double>(),
+                    frameMs, frameMs > 0.0 ? baseMs / frameMs : 0.0);
+    }
+
+    for (const auto& [name, passed] : checks.Results.items())
+        std::printf("%-28s %s\n", name.c_str(), passed.get<bool>() ? "passed" : "FAILED");
+
+    std::printf("results written to %s\n", options.OutPath.c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Software renderer checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
@@ -0,0 +1,84 @@
+#include "RenderThread.h"
+
+#include "AllocationTracker.h"
+
+RenderThread::RenderThread(RenderBackend* backend, Clock* clock)
+    : m_backend(backend), m_clock(clock)
+{
+    m_thread = std::thread([this] { ThreadMain(); });
+}
+
+RenderThread::~RenderThread()
+{
+    Stop();
+}
+
+FramePacket& RenderThread::BeginPacket()
+{
+    FramePacket& packet = m_mailbox.GetWriteSlot();
+    packet.Arena.Reset();
+
+    return packet;
+}
+
+void RenderThread::SubmitPacket()
+{
+    ++m_numSubmitted;
+
+    if (m_mailbox.Publish())
+        ++m_numSkipped;
+}
+
+bool RenderThread::TryGetPresentedPacket(PresentedPacket* outPacket)
+{
+    const PresentedPacket* presented = m_presentedMailbox.TryAcquire();
+
+    if (!presented)
+        return false;
+
+    *outPacket = *presented;
+
+    return true;
+}
+
+void RenderThread::Stop()
+{
+    if (!m_thread.joinable())
+        return;
+
+    m_mailbox.Close();
+    m_thread.join();
+}
+
+uint64_t RenderThread::GetNumSubmittedPackets() const
+{
+    return m_numSubmitted;
+}
+
+uint64_t RenderThread::GetNumRenderedPackets() const
+{
+    return m_numRendered.load(std::memory_order_relaxed);
+}
+
+uint64_t RenderThread::GetNumSkippedPackets() const
+{
+    return m_numSkipped;
+}
+
+void RenderThread::ThreadMain()
+{
+    AllocationTracker::SetSubsystem(AllocationSubsystem::Render);
+
+    while (const FramePacket* packet = m_mailbox.WaitAcquire())
+    {
+        m_backend->RenderFrame(*packet);
+
+        PresentedPacket& presented = m_presentedMailbox.GetWriteSlot();
+        presented.FrameIdx = packet->FrameIdx;
+        presented.Time = m_clock->Now();
+
+        m_presentedMailbox.Publish();
+
+        m_numRendered.fetch_add(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Clock.h"
+#include "FrameMailbox.h"
+#include "FramePacket.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Implemented by whatever submits frames to the GPU. Called on the render thread only.
+class RenderBackend
+{
+public:
+    virtual ~RenderBackend() = default;
+
+    virtual void RenderFrame(const FramePacket& packet) = 0;
+};
+
+// Runs a RenderBackend on its own thread, fed with packets from the main thread. The main thread
+// never waits on the render thread - if it produces packets faster than they are rendered, the
+// render thread skips to the newest one. When each packet was presented goes back the other way,
+// so that the main thread can pace frames to their presents.
+class RenderThread
+{
+public:
+    // |clock| times the presents, from the render thread.
+    RenderThread(RenderBackend* backend, Clock* clock);
+    ~RenderThread();
+
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    // Main thread only. Returns the packet to fill in, with its arena already reset.
+    FramePacket& BeginPacket();
+
+    // Main thread only. Hands the packet from BeginPacket() to the render thread.
+    void SubmitPacket();
+
+    struct PresentedPacket
+    {
+        uint64_t FrameIdx = 0;
+
+        // When the backend finished rendering the packet, its present and any wait on the GPU
+        // included.
+        Clock::TimePoint Time{};
+    };
+
+    // Main thread only. The packet presented most recently, if one was presented since the last
+    // call.
+    bool TryGetPresentedPacket(PresentedPacket* outPacket);
+
+    // Renders any outstanding packet and joins the thread.
+    void Stop();
+
+    uint64_t GetNumSubmittedPackets() const;
+    uint64_t GetNumRenderedPackets() const;
+
+    // Packets replaced by a newer one before the render thread picked them up.
+    uint64_t GetNumSkippedPackets() const;
+
+private:
+    void ThreadMain();
+
+    RenderBackend* m_backend;
+    Clock* m_clock;
+
+    FrameMailbox<FramePacket> m_mailbox;
+    FrameMailbox<PresentedPacket> m_presentedMailbox;
+
+    uint64_t m_numSubmitted = 0;
+    std::atomic<uint64_t> m_numRendered = 0;
+    uint64_t m_numSkipped = 0;
+
+    std::thread m_thread;
+};
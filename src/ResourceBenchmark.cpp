@@ -0,0 +1,521 @@
+// Benchmark for the resource registry: concurrent requests for shared assets, and a streaming
+// workload that keeps loading and releasing resources while frames are in flight. Uses fake
+// resources that burn a configurable amount of CPU to load, so it runs without a GPU. Also checks
+// the registry's lifetime rules and exits with an error if any of them fail.
+
+#include "BenchmarkUtils.h"
+#include "JobSystem.h"
+#include "ResourceRegistry.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+using benchmark::ElapsedMs;
+
+struct Options
+{
+    std::string OutPath = "resource_benchmark_results.json";
+
+    int NumAssets = 256;
+
+    // Requests per asset, spread over the requesting threads.
+    int NumRequestsPerAsset = 8;
+    int NumRequestThreads = 4;
+
+    int LoadUs = 500;
+
+    int NumFrames = 2000;
+    int NumFramesInFlight = 2;
+
+    int NumThreads = 0;
+};
+
+constexpr const char* USAGE =
+    "Usage: ResourceBenchmark [options]\n"
+    "  --assets N          Distinct assets (default 256)\n"
+    "  --requests N        Requests per asset (default 8)\n"
+    "  --requesters N      Threads issuing requests (default 4)\n"
+    "  --load-us N         Fake load time (default 500)\n"
+    "  --frames N          Frames of the streaming workload (default 2000)\n"
+    "  --in-flight N       Frames the fake GPU lags behind (default 2)\n"
+    "  --threads N         Job system threads, 0 for one per core (default 0)\n"
+    "  --out FILE          Results file (default resource_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--assets")
+            options->NumAssets = std::stoi(value);
+        else if (arg == "--requests")
+            options->NumRequestsPerAsset = std::stoi(value);
+        else if (arg == "--requesters")
+            options->NumRequestThreads = std::stoi(value);
+        else if (arg == "--load-us")
+            options->LoadUs = std::stoi(value);
+        else if (arg == "--frames")
+            options->NumFrames = std::stoi(value);
+        else if (arg == "--in-flight")
+            options->NumFramesInFlight = std::stoi(value);
+        else if (arg == "--threads")
+            options->NumThreads = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->NumAssets > 0 && options->NumRequestsPerAsset > 0 &&
+        options->NumRequestThreads > 0 && options->NumFrames > 0 &&
+        options->NumFramesInFlight >= 0;
+}
+
+void BusyWait(int us)
+{
+    Clock::time_point end = Clock::now() + std::chrono::microseconds(us);
+
+    while (Clock::now() < end)
+    {
+    }
+}
+
+// Stands in for the GPU. Resources record the last fence value of the frames that used them, and
+// count it as a failure if they are destroyed before the GPU got there.
+struct FakeGpu
+{
+    std::atomic<uint64_t> CompletedFenceValue = 0;
+
+    std::atomic<int64_t> NumLive = 0;
+    std::atomic<uint64_t> NumLoads = 0;
+    std::atomic<uint64_t> NumEarlyDestroys = 0;
+};
+
+class FakeResource : public RegisteredResource
+{
+public:
+    FakeResource(FakeGpu* gpu, uint64_t byteSize)
+        : m_gpu(gpu), m_byteSize(byteSize)
+    {
+        m_gpu->NumLive.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~FakeResource() override
+    {
+        if (m_lastUsedFenceValue > m_gpu->CompletedFenceValue.load())
+            m_gpu->NumEarlyDestroys.fetch_add(1, std::memory_order_relaxed);
+
+        m_gpu->NumLive.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    uint64_t GetByteSize() const override
+    {
+        return m_byteSize;
+    }
+
+    void Use(uint64_t fenceValue)
+    {
+        m_lastUsedFenceValue = std::max(m_lastUsedFenceValue, fenceValue);
+    }
+
+private:
+    FakeGpu* m_gpu;
+    uint64_t m_byteSize;
+    uint64_t m_lastUsedFenceValue = 0;
+};
+
+uint64_t GetAssetByteSize(int asset)
+{
+    return 4096 * static_cast<uint64_t>(1 + asset % 16);
+}
+
+ResourceRegistry::LoadFn MakeLoader(FakeGpu* gpu, int asset, int loadUs)
+{
+    return [=]() -> std::unique_ptr<RegisteredResource> {
+        BusyWait(loadUs);
+        gpu->NumLoads.fetch_add(1, std::memory_order_relaxed);
+
+        return std::make_unique<FakeResource>(gpu, GetAssetByteSize(asset));
+    };
+}
+
+uint64_t GetAssetKey(int asset)
+{
+    return MakeResourceKey(ResourceKind::Texture, "textures/" + std::to_string(asset) + ".png");
+}
+
+void CheckKeys(Checks* checks)
+{
+    uint64_t key = MakeResourceKey(ResourceKind::Texture, "assets/sponza/white.png");
+
+    checks->Check("key_path_normalized",
+                  key == MakeResourceKey(ResourceKind::Texture, "assets/box/../sponza/white.png") &&
+                      key == MakeResourceKey(ResourceKind::Texture, "assets/./sponza/white.png"));
+    checks->Check("key_kind_distinct",
+                  key != MakeResourceKey(ResourceKind::Buffer, "assets/sponza/white.png"));
+
+    std::vector<std::byte> a(1024, std::byte{1});
+    std::vector<std::byte> b = a;
+    b.back() = std::byte{2};
+
+    checks->Check("key_content",
+                  MakeResourceKey(ResourceKind::Buffer, a) ==
+                          MakeResourceKey(ResourceKind::Buffer, std::vector<std::byte>(a)) &&
+                      MakeResourceKey(ResourceKind::Buffer, a) !=
+                          MakeResourceKey(ResourceKind::Buffer, b));
+}
+
+// Single-threaded walks through the lifetime rules, with the fake GPU driven by hand.
+void CheckLifetimes(JobSystem* jobSystem, Checks* checks)
+{
+    FakeGpu gpu;
+    ResourceRegistry registry(jobSystem);
+
+    // Handles share one load, and copies keep the resource alive.
+    {
+        ResourceHandle first = registry.Request(GetAssetKey(0), MakeLoader(&gpu, 0, 0));
+        ResourceHandle second = registry.Request(GetAssetKey(0), MakeLoader(&gpu, 0, 0));
+        ResourceHandle copy = first;
+
+        checks->Check("same_key_shares_resource",
+                      first.Wait() == second.Wait() && copy.Wait() == first.Wait() &&
+                          gpu.NumLoads == 1);
+        checks->Check("find_live", registry.Find(GetAssetKey(0)).Wait() == first.Wait() &&
+                                       !registry.Find(GetAssetKey(1)));
+
+        ResourceRegistry::Stats stats = registry.GetStats();
+        checks->Check("stats_live", stats.NumLive == 1 && stats.LiveBytes == GetAssetByteSize(0) &&
+                                        stats.NumCoalesced == 1 && stats.NumLoads == 1);
+
+        registry.SetCurrentFenceValue(5);
+    }
+
+    // Released at fence value 5, so it must survive until that completes.
+    ResourceRegistry::Stats releasedStats = registry.GetStats();
+    bool kept = registry.Collect(4) == 0 && gpu.NumLive == 1;
+    bool destroyed = registry.Collect(5) == 1 && gpu.NumLive == 0;
+
+    checks->Check("release_waits_for_fence",
+                  releasedStats.NumLive == 0 && releasedStats.NumPendingDestroy == 1 &&
+                      releasedStats.PendingDestroyBytes == GetAssetByteSize(0) && kept &&
+                      destroyed && !registry.Find(GetAssetKey(0)));
+
+    // Requesting a released resource before its fence revives it without loading again, and a
+    // second release uses the newer fence value.
+    {
+        registry.SetCurrentFenceValue(10);
+        registry.Request(GetAssetKey(1), MakeLoader(&gpu, 1, 0)).Wait();
+
+        uint64_t numLoads = gpu.NumLoads;
+
+        ResourceHandle revived = registry.Request(GetAssetKey(1), MakeLoader(&gpu, 1, 0));
+        revived.Wait();
+
+        bool notReloaded = gpu.NumLoads == numLoads;
+        bool survivedCollect = registry.Collect(10) == 0 && gpu.NumLive == 1;
+
+        registry.SetCurrentFenceValue(12);
+        revived.Reset();
+
+        bool keptUntilNewFence = registry.Collect(11) == 0 && gpu.NumLive == 1;
+        bool destroyedAtNewFence = registry.Collect(12) == 1 && gpu.NumLive == 0;
+
+        checks->Check("revive_before_fence",
+                      notReloaded && survivedCollect && keptUntilNewFence && destroyedAtNewFence);
+    }
+
+    // Released while still loading: the entry stays until the load job is done.
+    {
+        std::atomic<bool> proceed = false;
+
+        ResourceHandle loading =
+            registry.Request(GetAssetKey(2), [&]() -> std::unique_ptr<RegisteredResource> {
+                while (!proceed.load())
+                {
+                    std::this_thread::yield();
+                }
+
+                return std::make_unique<FakeResource>(&gpu, 1);
+            });
+
+        loading.Reset();
+
+        bool keptWhileLoading = registry.Collect(UINT64_MAX) == 0;
+        proceed = true;
+
+        size_t numDestroyed = 0;
+
+        while (numDestroyed == 0)
+        {
+            numDestroyed = registry.Collect(UINT64_MAX);
+            std::this_thread::yield();
+        }
+
+        checks->Check("release_while_loading", keptWhileLoading && gpu.NumLive == 0);
+    }
+
+    // Failed loads rethrow to every waiter, and are retried once released.
+    {
+        ResourceHandle failing =
+            registry.Request(GetAssetKey(3), []() -> std::unique_ptr<RegisteredResource> {
+                throw std::runtime_error("Could not open file.");
+            });
+
+        bool threw = false;
+
+        try
+        {
+            failing.Wait();
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+
+        failing.Reset();
+        registry.Collect(UINT64_MAX);
+
+        ResourceHandle retried = registry.Request(GetAssetKey(3), MakeLoader(&gpu, 3, 0));
+
+        checks->Check("failed_load_rethrown_and_retried",
+                      threw && registry.GetStats().NumFailedLoads == 1 &&
+                          retried.Wait() != nullptr);
+    }
+}
+
+json RunRequests(const Options& options, JobSystem* jobSystem, Checks* checks)
+{
+    FakeGpu gpu;
+    ResourceRegistry registry(jobSystem);
+
+    int numAssets = options.NumAssets;
+    int requestsPerThread = (options.NumRequestsPerAsset + options.NumRequestThreads - 1) /
+        options.NumRequestThreads;
+
+    std::atomic<bool> failed = false;
+
+    Clock::time_point start = Clock::now();
+
+    std::vector<std::thread> requesters;
+    std::vector<std::vector<ResourceHandle>> handles(options.NumRequestThreads);
+
+    for (int t = 0; t < options.NumRequestThreads; ++t)
+    {
+        requesters.emplace_back([&, t] {
+            for (int r = 0; r < requestsPerThread; ++r)
+            {
+                for (int i = 0; i < numAssets; ++i)
+                {
+                    int asset = (i * (2 * t + 1) + r) % numAssets;
+                    handles[t].push_back(registry.Request(GetAssetKey(asset),
+                                                          MakeLoader(&gpu, asset, options.LoadUs)));
+                }
+            }
+
+            for (const ResourceHandle& handle : handles[t])
+            {
+                if (!handle.Wait())
+                    failed = true;
+            }
+        });
+    }
+
+    for (std::thread& requester : requesters)
+    {
+        requester.join();
+    }
+
+    double elapsedMs = ElapsedMs(start);
+
+    ResourceRegistry::Stats stats = registry.GetStats();
+
+    uint64_t assets = static_cast<uint64_t>(numAssets);
+    uint64_t expectedBytes = 0;
+
+    for (int i = 0; i < numAssets; ++i)
+    {
+        expectedBytes += GetAssetByteSize(i);
+    }
+
+    checks->Check("concurrent_requests_coalesced",
+                  !failed && gpu.NumLoads == assets && stats.NumLoads == assets &&
+                      stats.NumCoalesced == stats.NumRequests - assets);
+    checks->Check("concurrent_stats", stats.NumLive == assets && stats.LiveBytes == expectedBytes);
+
+    // Everything goes once the handles do and the fence is reached.
+    registry.SetCurrentFenceValue(1);
+    handles.clear();
+
+    gpu.CompletedFenceValue = 1;
+    registry.Collect(1);
+
+    checks->Check("concurrent_all_destroyed",
+                  gpu.NumLive == 0 && registry.GetStats().NumDestroyed == assets);
+
+    return {
+        {"elapsed_ms", elapsedMs},
+        {"requests", stats.NumRequests},
+        {"loads", stats.NumLoads},
+        {"coalesced", stats.NumCoalesced},
+        {"live_bytes", stats.LiveBytes},
+        {"failed_requests", failed.load()}
+    };
+}
+
+// Each frame swaps a few assets of a working set for others, like streaming as the camera moves,
+// and uses the rest. The fake GPU completes frames |NumFramesInFlight| behind.
+json RunStreaming(const Options& options, JobSystem* jobSystem, Checks* checks)
+{
+    constexpr int workingSetSize = 64;
+    constexpr int swapsPerFrame = 4;
+
+    FakeGpu gpu;
+    ResourceRegistry registry(jobSystem);
+
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> assetDist(0, options.NumAssets - 1);
+    std::uniform_int_distribution<int> slotDist(0, workingSetSize - 1);
+
+    std::vector<ResourceHandle> workingSet(workingSetSize);
+
+    for (ResourceHandle& handle : workingSet)
+    {
+        int asset = assetDist(rng);
+        handle = registry.Request(GetAssetKey(asset), MakeLoader(&gpu, asset, 0));
+    }
+
+    uint64_t maxPendingDestroy = 0;
+    double requestMs = 0.0;
+    double collectMs = 0.0;
+
+    for (int frame = 0; frame < options.NumFrames; ++frame)
+    {
+        uint64_t fenceValue = static_cast<uint64_t>(frame) + 1;
+        uint64_t lag = static_cast<uint64_t>(options.NumFramesInFlight);
+
+        gpu.CompletedFenceValue = fenceValue > lag ? fenceValue - 1 - lag : 0;
+
+        {
+            Clock::time_point start = Clock::now();
+            registry.Collect(gpu.CompletedFenceValue);
+            collectMs += ElapsedMs(start);
+        }
+
+        registry.SetCurrentFenceValue(fenceValue);
+
+        {
+            Clock::time_point start = Clock::now();
+
+            for (int i = 0; i < swapsPerFrame; ++i)
+            {
+                int asset = assetDist(rng);
+                workingSet[slotDist(rng)] =
+                    registry.Request(GetAssetKey(asset), MakeLoader(&gpu, asset, 0));
+            }
+
+            requestMs += ElapsedMs(start);
+        }
+
+        for (ResourceHandle& handle : workingSet)
+        {
+            handle.Wait<FakeResource>()->Use(fenceValue);
+        }
+
+        maxPendingDestroy = std::max(maxPendingDestroy, registry.GetStats().NumPendingDestroy);
+    }
+
+    // Idle the GPU and drop everything.
+    uint64_t lastFenceValue = static_cast<uint64_t>(options.NumFrames);
+
+    workingSet.clear();
+    gpu.CompletedFenceValue = lastFenceValue;
+    registry.Collect(lastFenceValue);
+
+    ResourceRegistry::Stats stats = registry.GetStats();
+
+    checks->Check("streaming_never_destroyed_in_use", gpu.NumEarlyDestroys == 0);
+    checks->Check("streaming_all_destroyed", gpu.NumLive == 0 && stats.NumLive == 0 &&
+                                                 stats.NumPendingDestroy == 0);
+
+    double numFrames = static_cast<double>(options.NumFrames);
+
+    return {
+        {"frames", options.NumFrames},
+        {"frames_in_flight", options.NumFramesInFlight},
+        {"loads", stats.NumLoads},
+        {"revived_or_shared", stats.NumCoalesced},
+        {"destroyed", stats.NumDestroyed},
+        {"max_pending_destroy", maxPendingDestroy},
+        {"request_us_per_frame", requestMs * 1000.0 / numFrames},
+        {"collect_us_per_frame", collectMs * 1000.0 / numFrames}
+    };
+}
+
+int RunBenchmark(const Options& options)
+{
+    Checks checks;
+    CheckKeys(&checks);
+
+    // The release-while-loading check needs a worker besides this thread to run the blocked
+    // loader, whatever the core count.
+    {
+        JobSystem lifetimeJobSystem(2);
+        CheckLifetimes(&lifetimeJobSystem, &checks);
+    }
+
+    JobSystem jobSystem(options.NumThreads);
+
+    json requests = RunRequests(options, &jobSystem, &checks);
+    json streaming = RunStreaming(options, &jobSystem, &checks);
+
+    json results = {
+        {"assets", options.NumAssets},
+        {"requests_per_asset", options.NumRequestsPerAsset},
+        {"requesters", options.NumRequestThreads},
+        {"threads", jobSystem.GetThreadCount()},
+        {"load_us", options.LoadUs},
+        {"requests", requests},
+        {"streaming", streaming},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Resource registry checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
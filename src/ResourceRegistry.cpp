@@ -0,0 +1,360 @@
+#include "ResourceRegistry.h"
+
+#include "Hash.h"
+#include "LoadProfiler.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+struct ResourceEntry
+{
+    uint64_t Key = 0;
+
+    // Cleared once the load job has run.
+    ResourceRegistry::LoadFn Load;
+
+    // Tracks the load job, so that waiting on it lets a worker help out with other jobs.
+    JobCounter Counter;
+
+    std::unique_ptr<RegisteredResource> Resource;
+    std::exception_ptr Error;
+
+    std::atomic<bool> Ready = false;
+
+    // The rest is guarded by the registry's mutex.
+    uint32_t RefCount = 0;
+
+    // Fence value current when the last handle was dropped, and whether the entry is in the
+    // registry's release list.
+    uint64_t ReleaseFenceValue = 0;
+    bool IsReleased = false;
+};
+
+uint64_t MakeResourceKey(ResourceKind kind, const std::filesystem::path& path)
+{
+    // Spelled the same on every platform, so that "a/../b.png" and "b.png" share a key.
+    std::string normalized = path.lexically_normal().generic_string();
+
+    Hasher hasher;
+    hasher.Add(kind);
+    hasher.Add(std::string_view(normalized));
+
+    return hasher.GetHash();
+}
+
+uint64_t MakeResourceKey(ResourceKind kind, std::span<const std::byte> content)
+{
+    Hasher hasher;
+    hasher.Add(kind);
+    hasher.Add(content.size());
+    hasher.Add(HashContent(content));
+
+    return hasher.GetHash();
+}
+
+uint64_t MakeTextureKey(uint32_t width, uint32_t height, std::span<const std::byte> pixels)
+{
+    return MakeTextureKey(width, height, pixels.data(), size_t{width} * 4);
+}
+
+uint64_t MakeTextureKey(uint32_t width, uint32_t height, const std::byte* rows, size_t rowPitch)
+{
+    size_t rowSize = size_t{width} * 4;
+
+    // Hashed a row at a time, which gives the same content hash as the rows packed together.
+    ContentHasher pixelHasher;
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        pixelHasher.AddBytes(rows + y * rowPitch, rowSize);
+    }
+
+    // As MakeResourceKey(ResourceKind::Texture, pixels) would give.
+    Hasher contentKey;
+    contentKey.Add(ResourceKind::Texture);
+    contentKey.Add(rowSize * height);
+    contentKey.Add(pixelHasher.GetHash());
+
+    Hasher hasher;
+    hasher.Add(contentKey.GetHash());
+    hasher.Add(width);
+    hasher.Add(height);
+
+    return hasher.GetHash();
+}
+
+ResourceHandle::ResourceHandle(ResourceRegistry* registry, ResourceEntry* entry)
+    : m_registry(registry), m_entry(entry)
+{
+}
+
+ResourceHandle::ResourceHandle(const ResourceHandle& other)
+    : m_registry(other.m_registry), m_entry(other.m_entry)
+{
+    if (m_entry)
+        m_registry->AddRef(m_entry);
+}
+
+ResourceHandle::ResourceHandle(ResourceHandle&& other) noexcept
+    : m_registry(std::exchange(other.m_registry, nullptr))
+    , m_entry(std::exchange(other.m_entry, nullptr))
+{
+}
+
+ResourceHandle& ResourceHandle::operator=(ResourceHandle other) noexcept
+{
+    std::swap(m_registry, other.m_registry);
+    std::swap(m_entry, other.m_entry);
+
+    return *this;
+}
+
+ResourceHandle::~ResourceHandle()
+{
+    Reset();
+}
+
+bool ResourceHandle::IsReady() const
+{
+    return m_entry->Ready.load(std::memory_order_acquire);
+}
+
+RegisteredResource* ResourceHandle::Wait() const
+{
+    if (!IsReady())
+    {
+        // Jobs run while waiting record spans of their own, which take precedence.
+        LoadScope scope("WaitResource", {}, LoadSpanKind::Wait);
+
+        m_registry->m_jobSystem->Wait(m_entry->Counter);
+    }
+
+    if (m_entry->Error)
+        std::rethrow_exception(m_entry->Error);
+
+    return m_entry->Resource.get();
+}
+
+void ResourceHandle::Reset()
+{
+    if (m_entry)
+        m_registry->Release(m_entry);
+
+    m_registry = nullptr;
+    m_entry = nullptr;
+}
+
+ResourceRegistry::ResourceRegistry(JobSystem* jobSystem)
+    : m_jobSystem(jobSystem)
+{
+}
+
+ResourceRegistry::~ResourceRegistry()
+{
+    // Loads may request further resources, so wait until a pass finds no new entries.
+    std::vector<ResourceEntry*> entries;
+
+    for (;;)
+    {
+        {
+            std::lock_guard lock(m_mutex);
+
+            if (entries.size() == m_entries.size())
+                break;
+
+            entries.clear();
+
+            for (auto& [key, entry] : m_entries)
+            {
+                entries.push_back(entry.get());
+            }
+        }
+
+        for (ResourceEntry* entry : entries)
+        {
+            m_jobSystem->Wait(entry->Counter);
+        }
+    }
+
+    // Resources may hold handles to other entries, so every resource goes before any entry.
+    for (ResourceEntry* entry : entries)
+    {
+        entry->Resource.reset();
+    }
+}
+
+ResourceHandle ResourceRegistry::Request(uint64_t key, LoadFn load)
+{
+    std::lock_guard lock(m_mutex);
+
+    ++m_numRequests;
+
+    auto [it, inserted] = m_entries.try_emplace(key);
+    ResourceEntry* entry = nullptr;
+
+    if (inserted)
+    {
+        it->second = std::make_unique<ResourceEntry>();
+
+        entry = it->second.get();
+        entry->Key = key;
+        entry->Load = std::move(load);
+
+        // Scheduled under the lock so that the counter is raised before any other thread can
+        // find the entry and wait on it.
+        m_jobSystem->Run([this, entry] { Load(entry); }, &entry->Counter);
+    }
+    else
+    {
+        entry = it->second.get();
+        ++m_numCoalesced;
+    }
+
+    // A released entry that is still waiting for its fence is revived. Collect() drops it from
+    // the release list.
+    ++entry->RefCount;
+
+    return ResourceHandle(this, entry);
+}
+
+ResourceHandle ResourceRegistry::Find(uint64_t key)
+{
+    std::lock_guard lock(m_mutex);
+
+    auto it = m_entries.find(key);
+
+    if (it == m_entries.end() || it->second->RefCount == 0)
+        return {};
+
+    ++it->second->RefCount;
+
+    return ResourceHandle(this, it->second.get());
+}
+
+void ResourceRegistry::SetCurrentFenceValue(uint64_t fenceValue)
+{
+    std::lock_guard lock(m_mutex);
+
+    m_currentFenceValue = std::max(m_currentFenceValue, fenceValue);
+}
+
+size_t ResourceRegistry::Collect(uint64_t completedFenceValue)
+{
+    PROFILE_SCOPE("ResourceRegistry::Collect");
+
+    // Destroyed after unlocking, since freeing native objects can take a while.
+    std::vector<std::unique_ptr<ResourceEntry>> destroyed;
+
+    {
+        std::lock_guard lock(m_mutex);
+
+        auto isDone = [&](ResourceEntry* entry) {
+            if (entry->RefCount > 0)
+            {
+                entry->IsReleased = false;
+                return true;
+            }
+
+            // The load job must be completely finished, counter included, before its entry goes.
+            if (entry->ReleaseFenceValue > completedFenceValue || !entry->Counter.IsDone())
+            {
+                return false;
+            }
+
+            auto it = m_entries.find(entry->Key);
+            destroyed.push_back(std::move(it->second));
+            m_entries.erase(it);
+
+            return true;
+        };
+
+        m_released.erase(std::remove_if(m_released.begin(), m_released.end(), isDone),
+                         m_released.end());
+
+        m_numDestroyed += destroyed.size();
+    }
+
+    return destroyed.size();
+}
+
+ResourceRegistry::Stats ResourceRegistry::GetStats() const
+{
+    Stats stats{};
+    stats.NumFailedLoads = m_numFailedLoads.load(std::memory_order_relaxed);
+
+    std::lock_guard lock(m_mutex);
+
+    stats.NumRequests = m_numRequests;
+    stats.NumCoalesced = m_numCoalesced;
+    stats.NumLoads = m_numRequests - m_numCoalesced;
+    stats.NumDestroyed = m_numDestroyed;
+
+    for (const auto& [key, entry] : m_entries)
+    {
+        uint64_t byteSize = 0;
+
+        if (entry->Ready.load(std::memory_order_acquire) && entry->Resource)
+            byteSize = entry->Resource->GetByteSize();
+
+        if (entry->RefCount > 0)
+        {
+            ++stats.NumLive;
+            stats.LiveBytes += byteSize;
+        }
+        else
+        {
+            ++stats.NumPendingDestroy;
+            stats.PendingDestroyBytes += byteSize;
+        }
+    }
+
+    return stats;
+}
+
+void ResourceRegistry::AddRef(ResourceEntry* entry)
+{
+    std::lock_guard lock(m_mutex);
+
+    ++entry->RefCount;
+}
+
+void ResourceRegistry::Release(ResourceEntry* entry)
+{
+    std::lock_guard lock(m_mutex);
+
+    if (--entry->RefCount > 0)
+        return;
+
+    // Released again after a revival, so the latest fence value is the one that counts.
+    entry->ReleaseFenceValue = m_currentFenceValue;
+
+    if (!entry->IsReleased)
+    {
+        entry->IsReleased = true;
+        m_released.push_back(entry);
+    }
+}
+
+void ResourceRegistry::Load(ResourceEntry* entry)
+{
+    PROFILE_SCOPE("ResourceRegistry::Load");
+
+    try
+    {
+        entry->Resource = entry->Load();
+
+        if (!entry->Resource)
+            throw std::runtime_error("Resource loader returned no resource.");
+    }
+    catch (...)
+    {
+        entry->Error = std::current_exception();
+        m_numFailedLoads.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    entry->Load = nullptr;
+    entry->Ready.store(true, std::memory_order_release);
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "JobSystem.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// An object owned by a ResourceRegistry. Backends derive from this to hold the native object.
+class RegisteredResource
+{
+public:
+    virtual ~RegisteredResource() = default;
+
+    // Memory held by the resource, for the registry's statistics.
+    virtual uint64_t GetByteSize() const = 0;
+};
+
+enum class ResourceKind : uint8_t
+{
+    Buffer,
+    Texture,
+
+    // An encoded image file, which refers to the Texture with its decoded pixels.
+    TextureFile
+};
+
+// Keys for assets loaded from a file, and for assets created from data in memory. The kind is part
+// of the key, so the same file can be loaded as different kinds of resource. Content keys hash
+// the whole content, at memory bandwidth.
+uint64_t MakeResourceKey(ResourceKind kind, const std::filesystem::path& path);
+uint64_t MakeResourceKey(ResourceKind kind, std::span<const std::byte> content);
+
+// Key for a Texture by its size and tightly packed RGBA8 pixels.
+uint64_t MakeTextureKey(uint32_t width, uint32_t height, std::span<const std::byte> pixels);
+
+// The same key for RGBA8 rows |rowPitch| bytes apart, where any padding between rows is ignored.
+uint64_t MakeTextureKey(uint32_t width, uint32_t height, const std::byte* rows, size_t rowPitch);
+
+class ResourceRegistry;
+struct ResourceEntry;
+
+// Counted reference to a resource in a ResourceRegistry. Dropping the last handle releases the
+// resource, which is destroyed once the GPU is done with it. Must not outlive the registry.
+class ResourceHandle
+{
+public:
+    ResourceHandle() = default;
+
+    ResourceHandle(const ResourceHandle& other);
+    ResourceHandle(ResourceHandle&& other) noexcept;
+    ResourceHandle& operator=(ResourceHandle other) noexcept;
+
+    ~ResourceHandle();
+
+    explicit operator bool() const
+    {
+        return m_entry != nullptr;
+    }
+
+    bool IsReady() const;
+
+    // Blocks until the resource is loaded, executing other jobs in the meantime. Rethrows the
+    // loader's exception if loading failed.
+    RegisteredResource* Wait() const;
+
+    template<typename T>
+    T* Wait() const
+    {
+        return static_cast<T*>(Wait());
+    }
+
+    void Reset();
+
+private:
+    friend class ResourceRegistry;
+
+    // Takes over a reference that the registry already counted.
+    ResourceHandle(ResourceRegistry* registry, ResourceEntry* entry);
+
+    ResourceRegistry* m_registry = nullptr;
+    ResourceEntry* m_entry = nullptr;
+};
+
+// Loads resources on job system workers, keyed by MakeResourceKey(). Each key is loaded once no
+// matter how many threads request it, and stays loaded while there are handles to it. Released
+// resources are kept until the fence value current at their release has completed, since GPU work
+// recorded until then may still use them. Requesting a released resource before that revives it.
+class ResourceRegistry
+{
+public:
+    using LoadFn = std::function<std::unique_ptr<RegisteredResource>()>;
+
+    explicit ResourceRegistry(JobSystem* jobSystem);
+
+    // Waits for outstanding loads and destroys every resource, so the GPU must be idle. Resources
+    // may hold handles to others in the same registry.
+    ~ResourceRegistry();
+
+    ResourceRegistry(const ResourceRegistry&) = delete;
+    ResourceRegistry& operator=(const ResourceRegistry&) = delete;
+
+    // Starts loading the resource in the background, unless the key is loaded or loading
+    // already. Thread-safe.
+    ResourceHandle Request(uint64_t key, LoadFn load);
+
+    // Returns an empty handle if nothing with |key| is loaded or loading, or if it was released.
+    // Thread-safe.
+    ResourceHandle Find(uint64_t key);
+
+    // Resources released from now on may be used by GPU work that completes when the fence
+    // reaches |fenceValue|. Values must not decrease.
+    void SetCurrentFenceValue(uint64_t fenceValue);
+
+    // Destroys the released resources whose fence value has completed. Returns their number.
+    size_t Collect(uint64_t completedFenceValue);
+
+    struct Stats
+    {
+        uint64_t NumRequests = 0;
+
+        // Requests for a key that was loaded or loading already, i.e. that did not load again.
+        uint64_t NumCoalesced = 0;
+
+        uint64_t NumLoads = 0;
+        uint64_t NumFailedLoads = 0;
+
+        // Resources with handles. Bytes only count finished loads.
+        uint64_t NumLive = 0;
+        uint64_t LiveBytes = 0;
+
+        // Released resources waiting for their fence.
+        uint64_t NumPendingDestroy = 0;
+        uint64_t PendingDestroyBytes = 0;
+
+        uint64_t NumDestroyed = 0;
+    };
+
+    Stats GetStats() const;
+
+private:
+    friend class ResourceHandle;
+
+    void AddRef(ResourceEntry* entry);
+    void Release(ResourceEntry* entry);
+
+    void Load(ResourceEntry* entry);
+
+    JobSystem* m_jobSystem;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint64_t, std::unique_ptr<ResourceEntry>> m_entries;
+
+    // Entries whose last handle was dropped. They stay here if revived, until the next Collect().
+    std::vector<ResourceEntry*> m_released;
+
+    uint64_t m_currentFenceValue = 0;
+
+    uint64_t m_numRequests = 0;
+    uint64_t m_numCoalesced = 0;
+    uint64_t m_numDestroyed = 0;
+
+    std::atomic<uint64_t> m_numFailedLoads = 0;
+};
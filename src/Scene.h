@@ -1,8 +1,70 @@
 #pragma once
 
+#include "EntityStore.h"
+
 #include <glm/glm.hpp>
 
+#include <cstdint>
+#include <vector>
+
+enum class LightType : uint32_t
+{
+    Point,
+    Spot
+};
+
+struct Light
+{
+    LightType Type = LightType::Point;
+
+    glm::vec3 Position = glm::vec3(0.f);
+    glm::vec3 Color = glm::vec3(1.f);
+
+    // Distance at which the light stops contributing.
+    float Range = 1.f;
+
+    // Spot lights only. The angle is the cone's half angle, in radians.
+    glm::vec3 Direction = glm::vec3(0.f, 0.f, -1.f);
+    float OuterConeAngle = 0.f;
+};
+
+// Components of entities drawn as model instances.
+struct WorldTransform
+{
+    glm::mat4 WorldMat;
+};
+
+struct ModelInstance
+{
+    // Index into the backend's model table.
+    uint32_t ModelIdx = 0;
+};
+
+// Draws every primitive of the instance with one material instead of the model's own.
+struct MaterialOverride
+{
+    // Index into the backend's material table.
+    uint32_t MaterialIdx = 0;
+};
+
+// Turns the instance about its local y axis.
+struct Spin
+{
+    float RadiansPerSec = 0.f;
+};
+
+// The FrameBuilder transform the instance was registered with, set by the backend.
+struct RenderProxy
+{
+    uint32_t TransformIdx = 0;
+};
+
 struct Scene
 {
     glm::vec3 LightPos;
+
+    std::vector<Light> Lights;
+
+    // Model instances. Instances carry a WorldTransform, a ModelInstance and a RenderProxy.
+    EntityStore Entities;
 };
@@ -3,6 +3,13 @@ struct VSInput
     float3 Position : POSITION;
     float3 Normal : NORMAL;
     float2 TexCoord : TEXCOORD;
+
+    // Per instance: the columns of the world-view-projection matrix, and the material.
+    float4 WorldViewProjCol0 : INSTANCE_TRANSFORM0;
+    float4 WorldViewProjCol1 : INSTANCE_TRANSFORM1;
+    float4 WorldViewProjCol2 : INSTANCE_TRANSFORM2;
+    float4 WorldViewProjCol3 : INSTANCE_TRANSFORM3;
+    uint MaterialIdx : INSTANCE_MATERIAL;
 };
 
 struct PSInput {
@@ -10,22 +17,25 @@ struct PSInput {
     float3 WorldPos : POSITION;
     float3 Normal : NORMAL;
     float2 TexCoord : TEXCOORD;
+    nointerpolation uint MaterialIdx : MATERIAL;
 };
 
-struct Constants
-{
-    float4x4 WorldViewProjMat;
-    float4 LightPos;
-};
-
-ConstantBuffer<Constants> g_constants : register(b0);
-
+// Matches MaterialRecord in MaterialTable.h.
 struct Material
 {
     float4 BaseColorFactor;
+    float MetallicFactor;
+    float RoughnessFactor;
+
+    // Slots in the texture descriptor heap, or 0xffffffff.
+    uint BaseColorTexture;
+    uint RoughnessTexture;
+    uint NormalTexture;
+
+    uint3 Padding;
 };
 
-ConstantBuffer<Material> g_material : register(b1);
+StructuredBuffer<Material> g_materials : register(t1);
 
 Texture2D g_baseColorTexture : register(t0);
 
@@ -34,10 +44,13 @@ SamplerState g_sampler : register(s0);
 PSInput VSMain(VSInput input)
 {
     PSInput output;
-    output.Position = mul(g_constants.WorldViewProjMat, float4(input.Position, 1.f));
+    output.Position = input.WorldViewProjCol0 * input.Position.x +
+        input.WorldViewProjCol1 * input.Position.y + input.WorldViewProjCol2 * input.Position.z +
+        input.WorldViewProjCol3;
     output.WorldPos = input.Position;
     output.Normal = input.Normal;
     output.TexCoord = input.TexCoord;
+    output.MaterialIdx = input.MaterialIdx;
 
     return output;
 }
@@ -55,7 +68,7 @@ float4 PSMain(PSInput input) : SV_TARGET
     // return float4(color, 1.f);
 
     float4 baseColor = float4(g_baseColorTexture.Sample(g_sampler, input.TexCoord).rgb, 1.f) *
-        g_material.BaseColorFactor;
+        g_materials[input.MaterialIdx].BaseColorFactor;
 
     return baseColor;
 }
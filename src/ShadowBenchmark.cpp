@@ -0,0 +1,578 @@
+// Benchmark for cascaded shadow setup. Scatters box-shaped casters over a large terrain, walks
+// the camera through it, and every frame fits the cascades and culls the casters with each
+// supported SIMD level. Checks the split scheme, that cascades cover their slice of the view
+// frustum and stay texel aligned at a fixed size, that culling matches brute force, and that
+// every caster blocking the light from a point in a cascade is in its draw list. Exits with an
+// error if any check fails.
+
+#include "BenchmarkUtils.h"
+#include "JobSystem.h"
+#include "PixelKernels.h"
+#include "ShadowCascades.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <numbers>
+#include <random>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+using benchmark::ElapsedMs;
+
+struct Options
+{
+    std::string OutPath = "shadow_benchmark_results.json";
+
+    int NumCasters = 100000;
+    int NumCascades = 4;
+    int Resolution = 2048;
+
+    float SplitLambda = 0.75f;
+    float MaxDistance = 150.f;
+
+    int NumFrames = 200;
+
+    // Frames checked against brute force, spread over the run.
+    int NumCheckedFrames = 3;
+
+    int NumThreads = 0;
+};
+
+constexpr const char* USAGE =
+    "Usage: ShadowBenchmark [options]\n"
+    "  --casters N         Number of shadow casters (default 100000)\n"
+    "  --cascades N        Number of cascades, at most 8 (default 4)\n"
+    "  --resolution N      Shadow map size in texels (default 2048)\n"
+    "  --lambda F          Split blend, 0 uniform to 1 logarithmic (default 0.75)\n"
+    "  --max-distance F    Shadow distance (default 150)\n"
+    "  --frames N          Frames per SIMD level (default 200)\n"
+    "  --checked-frames N  Frames checked against brute force (default 3)\n"
+    "  --threads N         Job system threads, 0 for one per core (default 0)\n"
+    "  --out FILE          Results file (default shadow_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--casters")
+            options->NumCasters = std::stoi(value);
+        else if (arg == "--cascades")
+            options->NumCascades = std::stoi(value);
+        else if (arg == "--resolution")
+            options->Resolution = std::stoi(value);
+        else if (arg == "--lambda")
+            options->SplitLambda = std::stof(value);
+        else if (arg == "--max-distance")
+            options->MaxDistance = std::stof(value);
+        else if (arg == "--frames")
+            options->NumFrames = std::stoi(value);
+        else if (arg == "--checked-frames")
+            options->NumCheckedFrames = std::stoi(value);
+        else if (arg == "--threads")
+            options->NumThreads = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->NumCasters >= 0 && options->NumCascades > 0 &&
+        options->NumCascades <= static_cast<int>(MAX_SHADOW_CASCADES) &&
+        options->Resolution > 2 && options->MaxDistance > 1.f && options->NumFrames > 0 &&
+        options->NumCheckedFrames >= 0;
+}
+
+struct Casters
+{
+    std::vector<glm::vec3> BoundsMin;
+    std::vector<glm::vec3> BoundsMax;
+
+    glm::vec3 SceneMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 SceneMax = glm::vec3(-std::numeric_limits<float>::max());
+};
+
+// Buildings and trees over a 400 x 400 terrain, plus a few tall towers.
+Casters CreateCasters(const Options& options)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-200.f, 200.f);
+    std::uniform_real_distribution<float> width(0.5f, 6.f);
+    std::uniform_real_distribution<float> height(0.5f, 12.f);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    Casters casters;
+
+    for (int i = 0; i < options.NumCasters; ++i)
+    {
+        glm::vec3 base(position(rng), unit(rng) * 2.f, position(rng));
+        glm::vec3 size(width(rng), height(rng), width(rng));
+
+        if (unit(rng) < 0.002f)
+            size.y *= 8.f;
+
+        glm::vec3 boundsMin = base - glm::vec3(size.x, 0.f, size.z) * 0.5f;
+        glm::vec3 boundsMax = base + glm::vec3(size.x * 0.5f, size.y, size.z * 0.5f);
+
+        casters.BoundsMin.push_back(boundsMin);
+        casters.BoundsMax.push_back(boundsMax);
+
+        casters.SceneMin = glm::min(casters.SceneMin, boundsMin);
+        casters.SceneMax = glm::max(casters.SceneMax, boundsMax);
+    }
+
+    if (casters.BoundsMin.empty())
+    {
+        casters.SceneMin = glm::vec3(-1.f);
+        casters.SceneMax = glm::vec3(1.f);
+    }
+
+    return casters;
+}
+
+// Walks slowly across the terrain while looking around, so that consecutive frames move the
+// camera by less than a texel of the nearest cascade.
+ShadowCamera GetCamera(int frame, int numFrames)
+{
+    float t = static_cast<float>(frame) / static_cast<float>(numFrames);
+    float angle = 2.f * std::numbers::pi_v<float> * t;
+
+    glm::vec3 eye(-20.f + 40.f * t, 3.f, 10.f * std::sin(angle));
+    glm::vec3 target = eye + glm::vec3(std::cos(angle * 3.f), -0.15f, std::sin(angle * 3.f));
+
+    ShadowCamera camera{};
+    camera.ViewMat = glm::lookAt(eye, target, glm::vec3(0.f, 1.f, 0.f));
+    camera.FovY = std::numbers::pi_v<float> / 4.f;
+    camera.AspectRatio = 16.f / 9.f;
+    camera.NearZ = 0.1f;
+    camera.FarZ = 1000.f;
+
+    return camera;
+}
+
+ShadowSettings GetSettings(const Options& options)
+{
+    ShadowSettings settings{};
+    settings.NumCascades = static_cast<uint32_t>(options.NumCascades);
+    settings.Resolution = static_cast<uint32_t>(options.Resolution);
+    settings.SplitLambda = options.SplitLambda;
+    settings.MaxDistance = options.MaxDistance;
+
+    return settings;
+}
+
+bool IsClose(float a, float b)
+{
+    return std::abs(a - b) <= 1e-4f * std::max(1.f, std::abs(b));
+}
+
+// Endpoints, ordering, and the pure uniform and logarithmic ends of the blend.
+bool CheckSplits(const Options& options)
+{
+    ShadowSettings settings = GetSettings(options);
+
+    float nearZ = 0.1f;
+    float farZ = options.MaxDistance;
+    uint32_t numCascades = settings.NumCascades;
+
+    std::vector<float> splits(numCascades + 1);
+    bool valid = true;
+
+    for (float lambda : {0.f, options.SplitLambda, 1.f})
+    {
+        settings.SplitLambda = lambda;
+        ComputeCascadeSplits(settings, nearZ, farZ, splits);
+
+        valid = valid && splits.front() == nearZ && splits.back() == farZ;
+
+        for (uint32_t i = 0; i < numCascades; ++i)
+        {
+            valid = valid && splits[i] < splits[i + 1];
+
+            float t = static_cast<float>(i) / static_cast<float>(numCascades);
+
+            if (lambda == 0.f)
+                valid = valid && IsClose(splits[i], nearZ + (farZ - nearZ) * t);
+            else if (lambda == 1.f)
+                valid = valid && IsClose(splits[i], nearZ * std::pow(farZ / nearZ, t));
+        }
+    }
+
+    return valid;
+}
+
+// The point of the camera frustum at normalized device |x| and |y|, |depth| in front of the
+// camera, in world space.
+glm::vec3 GetFrustumPoint(const ShadowCamera& camera, float x, float y, float depth)
+{
+    float tanHalfFovY = std::tan(camera.FovY * 0.5f);
+    float tanHalfFovX = tanHalfFovY * camera.AspectRatio;
+
+    glm::vec4 viewPos(x * tanHalfFovX * depth, y * tanHalfFovY * depth, depth, 1.f);
+
+    return glm::vec3(glm::inverse(camera.ViewMat) * viewPos);
+}
+
+// A random point of the camera frustum between |nearDist| and |farDist|.
+glm::vec3 SamplePointInSlice(const ShadowCamera& camera, float nearDist, float farDist,
+                             std::mt19937* rng)
+{
+    std::uniform_real_distribution<float> ndc(-1.f, 1.f);
+    std::uniform_real_distribution<float> depthDist(nearDist, farDist);
+
+    float depth = depthDist(*rng);
+
+    return GetFrustumPoint(camera, ndc(*rng), ndc(*rng), depth);
+}
+
+// Points in each cascade's slice, starting with its corners, must land inside its shadow map.
+bool CheckCoverage(const ShadowCamera& camera, std::span<const ShadowCascade> cascades)
+{
+    std::mt19937 rng(42);
+    bool covered = true;
+
+    for (const ShadowCascade& cascade : cascades)
+    {
+        for (int i = 0; i < 2000; ++i)
+        {
+            glm::vec3 p = i < 8 ?
+                GetFrustumPoint(camera, i & 1 ? 1.f : -1.f, i & 2 ? 1.f : -1.f,
+                                i & 4 ? cascade.SplitFar : cascade.SplitNear) :
+                SamplePointInSlice(camera, cascade.SplitNear, cascade.SplitFar, &rng);
+            glm::vec4 clip = cascade.ViewProjMat * glm::vec4(p, 1.f);
+
+            covered = covered && std::abs(clip.x) <= 1.f && std::abs(clip.y) <= 1.f &&
+                clip.z >= 0.f && clip.z <= 1.f;
+        }
+    }
+
+    return covered;
+}
+
+// The window must keep its size and sit on whole texels of light space.
+bool CheckStable(std::span<const ShadowCascade> cascades,
+                 std::span<const ShadowCascade> firstCascades)
+{
+    bool stable = true;
+
+    for (size_t i = 0; i < cascades.size(); ++i)
+    {
+        const ShadowCascade& cascade = cascades[i];
+        const ShadowCascade& first = firstCascades[i];
+
+        stable = stable && cascade.TexelSize == first.TexelSize &&
+            IsClose(cascade.BoundsMax.x - cascade.BoundsMin.x,
+                    first.BoundsMax.x - first.BoundsMin.x) &&
+            IsClose(cascade.BoundsMax.y - cascade.BoundsMin.y,
+                    first.BoundsMax.y - first.BoundsMin.y);
+
+        for (int axis = 0; axis < 2; ++axis)
+        {
+            float center = (cascade.BoundsMin[axis] + cascade.BoundsMax[axis]) * 0.5f;
+            float texels = center / cascade.TexelSize;
+
+            stable = stable && std::abs(texels - std::round(texels)) < 0.01f;
+        }
+    }
+
+    return stable;
+}
+
+// Every caster against every cascade, with the same test the kernels use.
+bool MatchesBruteForce(const ShadowCasterCuller& culler, const LightBasis& light,
+                       std::span<const ShadowCascade> cascades, const Casters& casters,
+                       double* elapsedMs)
+{
+    Clock::time_point start = Clock::now();
+
+    std::span<const uint8_t> masks = culler.GetCascadeMasks();
+    bool matches = masks.size() == casters.BoundsMin.size();
+
+    std::vector<std::vector<uint32_t>> expected(cascades.size());
+
+    for (uint32_t i = 0; i < casters.BoundsMin.size() && matches; ++i)
+    {
+        glm::vec3 lightMin;
+        glm::vec3 lightMax;
+        GetLightSpaceBounds(light, casters.BoundsMin[i], casters.BoundsMax[i], &lightMin,
+                            &lightMax);
+
+        uint8_t mask = 0;
+
+        for (size_t c = 0; c < cascades.size(); ++c)
+        {
+            if (CasterAffectsCascade(lightMin, lightMax, cascades[c]))
+            {
+                mask |= static_cast<uint8_t>(1u << c);
+                expected[c].push_back(i);
+            }
+        }
+
+        matches = masks[i] == mask;
+    }
+
+    for (uint32_t c = 0; c < cascades.size() && matches; ++c)
+    {
+        std::span<const uint32_t> actual = culler.GetDrawList(c);
+        matches = std::equal(actual.begin(), actual.end(), expected[c].begin(), expected[c].end());
+    }
+
+    *elapsedMs = ElapsedMs(start);
+
+    return matches;
+}
+
+bool RayHitsBox(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& boxMin,
+                const glm::vec3& boxMax)
+{
+    float tMin = 0.f;
+    float tMax = std::numeric_limits<float>::max();
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (std::abs(direction[axis]) < 1e-8f)
+        {
+            if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis])
+                return false;
+
+            continue;
+        }
+
+        float t0 = (boxMin[axis] - origin[axis]) / direction[axis];
+        float t1 = (boxMax[axis] - origin[axis]) / direction[axis];
+
+        tMin = std::max(tMin, std::min(t0, t1));
+        tMax = std::min(tMax, std::max(t0, t1));
+    }
+
+    return tMin <= tMax;
+}
+
+// Traces from points in each cascade's slice toward the light. Every caster hit must be in the
+// cascade's draw list, with its depth inside the shadow map's range. Checks the cascade volumes
+// and the extrusion independently of the shared culling test.
+void CheckBlockingCasters(const ShadowCasterCuller& culler, const ShadowCamera& camera,
+                          const LightBasis& light, std::span<const ShadowCascade> cascades,
+                          const Casters& casters, bool* blockersListed, int* numBlockedSamples)
+{
+    std::mt19937 rng(5678);
+
+    for (uint32_t c = 0; c < cascades.size(); ++c)
+    {
+        const ShadowCascade& cascade = cascades[c];
+        std::span<const uint32_t> drawList = culler.GetDrawList(c);
+
+        for (int i = 0; i < 100; ++i)
+        {
+            glm::vec3 p = SamplePointInSlice(camera, cascade.SplitNear, cascade.SplitFar, &rng);
+
+            // Keep receivers near the ground, where the casters are.
+            p.y = std::clamp(p.y, 0.f, 6.f);
+
+            bool blocked = false;
+
+            for (uint32_t j = 0; j < casters.BoundsMin.size(); ++j)
+            {
+                if (!RayHitsBox(p, -light.Forward, casters.BoundsMin[j], casters.BoundsMax[j]))
+                    continue;
+
+                blocked = true;
+
+                glm::vec3 lightMin;
+                glm::vec3 lightMax;
+                GetLightSpaceBounds(light, casters.BoundsMin[j], casters.BoundsMax[j],
+                                    &lightMin, &lightMax);
+
+                if (!std::binary_search(drawList.begin(), drawList.end(), j) ||
+                    lightMin.z < cascade.BoundsMin.z)
+                {
+                    *blockersListed = false;
+                }
+            }
+
+            *numBlockedSamples += blocked;
+        }
+    }
+}
+
+json RunLevel(const Options& options, JobSystem* jobSystem, SimdLevel level,
+              const LightBasis& light, const Casters& casters, Checks* checks)
+{
+    ShadowCasterCuller culler(jobSystem, level);
+    ShadowSettings settings = GetSettings(options);
+
+    std::string prefix = std::string(GetSimdLevelName(level)) + "_";
+
+    std::vector<ShadowCascade> cascades(settings.NumCascades);
+    std::vector<ShadowCascade> firstCascades(settings.NumCascades);
+
+    // Warm up the scratch buffers.
+    ComputeShadowCascades(settings, GetCamera(0, options.NumFrames), light, casters.SceneMin,
+                          casters.SceneMax, firstCascades);
+    culler.Cull(light, firstCascades, casters.BoundsMin, casters.BoundsMax);
+
+    std::vector<double> cascadeMs;
+    std::vector<double> cullMs;
+
+    bool covered = true;
+    bool stable = true;
+    bool matchesBruteForce = true;
+    bool blockersListed = true;
+    int numBlockedSamples = 0;
+
+    double bruteForceMs = 0.0;
+    std::vector<uint64_t> numDrawn(settings.NumCascades);
+
+    int checkInterval = std::max(1, options.NumFrames / std::max(1, options.NumCheckedFrames));
+
+    for (int frame = 0; frame < options.NumFrames; ++frame)
+    {
+        ShadowCamera camera = GetCamera(frame, options.NumFrames);
+
+        Clock::time_point start = Clock::now();
+        ComputeShadowCascades(settings, camera, light, casters.SceneMin, casters.SceneMax,
+                              cascades);
+        cascadeMs.push_back(ElapsedMs(start));
+
+        start = Clock::now();
+        culler.Cull(light, cascades, casters.BoundsMin, casters.BoundsMax);
+        cullMs.push_back(ElapsedMs(start));
+
+        for (uint32_t c = 0; c < settings.NumCascades; ++c)
+        {
+            numDrawn[c] += culler.GetDrawList(c).size();
+        }
+
+        stable = stable && CheckStable(cascades, firstCascades);
+
+        if (frame % checkInterval == 0 && frame / checkInterval < options.NumCheckedFrames)
+        {
+            covered = covered && CheckCoverage(camera, cascades);
+
+            double elapsedMs = 0.0;
+            matchesBruteForce = matchesBruteForce &&
+                MatchesBruteForce(culler, light, cascades, casters, &elapsedMs);
+            bruteForceMs = std::max(bruteForceMs, elapsedMs);
+
+            CheckBlockingCasters(culler, camera, light, cascades, casters, &blockersListed,
+                                 &numBlockedSamples);
+        }
+    }
+
+    checks->Check(prefix + "cascades_cover_slices", covered);
+    checks->Check(prefix + "cascades_texel_stable", stable);
+    checks->Check(prefix + "matches_brute_force", matchesBruteForce);
+    checks->Check(prefix + "blocking_casters_listed", blockersListed);
+
+    std::sort(cascadeMs.begin(), cascadeMs.end());
+    std::sort(cullMs.begin(), cullMs.end());
+
+    double numFrames = static_cast<double>(options.NumFrames);
+
+    double meanMs = 0.0;
+
+    for (double ms : cullMs)
+    {
+        meanMs += ms / numFrames;
+    }
+
+    json drawnPerCascade = json::array();
+
+    for (uint64_t drawn : numDrawn)
+    {
+        drawnPerCascade.push_back(static_cast<double>(drawn) / numFrames);
+    }
+
+    return {
+        {"cull_ms_mean", meanMs},
+        {"cull_ms_p50", cullMs[cullMs.size() / 2]},
+        {"cull_ms_max", cullMs.back()},
+        {"cascades_ms_p50", cascadeMs[cascadeMs.size() / 2]},
+        {"brute_force_ms", bruteForceMs},
+        {"blocked_samples", numBlockedSamples},
+        {"casters_per_cascade_mean", drawnPerCascade}
+    };
+}
+
+int RunBenchmark(const Options& options)
+{
+    JobSystem jobSystem(options.NumThreads);
+
+    Casters casters = CreateCasters(options);
+    LightBasis light = LightBasis::FromDirection(glm::vec3(0.4f, -1.f, 0.3f));
+
+    Checks checks;
+    checks.Check("splits_practical", CheckSplits(options));
+
+    json levels = json::object();
+
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2, SimdLevel::Neon})
+    {
+        if (IsSimdLevelSupported(level))
+        {
+            levels[GetSimdLevelName(level)] =
+                RunLevel(options, &jobSystem, level, light, casters, &checks);
+        }
+    }
+
+    ShadowSettings settings = GetSettings(options);
+    std::vector<ShadowCascade> cascades(settings.NumCascades);
+    ComputeShadowCascades(settings, GetCamera(0, options.NumFrames), light, casters.SceneMin,
+                          casters.SceneMax, cascades);
+
+    json splits = json::array();
+
+    for (const ShadowCascade& cascade : cascades)
+    {
+        splits.push_back({cascade.SplitNear, cascade.SplitFar});
+    }
+
+    json results = {
+        {"casters", options.NumCasters},
+        {"cascades", options.NumCascades},
+        {"resolution", options.Resolution},
+        {"splits", splits},
+        {"frames", options.NumFrames},
+        {"threads", jobSystem.GetThreadCount()},
+        {"selected_level", GetSimdLevelName(ShadowCasterCuller(&jobSystem).GetSimdLevel())},
+        {"levels", levels},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Shadow checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
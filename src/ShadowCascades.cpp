@@ -0,0 +1,517 @@
+#include "ShadowCascades.h"
+
+#include "Profiler.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+constexpr size_t castersPerChunk = 4096;
+
+void CullCastersScalar(const LightBasis& light, std::span<const ShadowCascade> cascades,
+                       const glm::vec3* boundsMin, const glm::vec3* boundsMax, size_t count,
+                       uint8_t* outMasks)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        glm::vec3 lightMin;
+        glm::vec3 lightMax;
+        GetLightSpaceBounds(light, boundsMin[i], boundsMax[i], &lightMin, &lightMax);
+
+        uint8_t mask = 0;
+
+        for (size_t c = 0; c < cascades.size(); ++c)
+        {
+            if (CasterAffectsCascade(lightMin, lightMax, cascades[c]))
+                mask |= static_cast<uint8_t>(1u << c);
+        }
+
+        outMasks[i] = mask;
+    }
+}
+
+#if defined(GRFX_SIMD_X86)
+
+// Four packed vec3s into one register per component.
+TARGET_SSE41 void LoadVec3x4Sse41(const glm::vec3* src, __m128* x, __m128* y, __m128* z)
+{
+    const float* ptr = &src->x;
+
+    __m128 a = _mm_loadu_ps(ptr);
+    __m128 b = _mm_loadu_ps(ptr + 4);
+    __m128 c = _mm_loadu_ps(ptr + 8);
+
+    *x = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0)),
+                        _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+    *y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                        _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+    *z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                        _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+TARGET_SSE41 void CullCastersSse41(const LightBasis& light,
+                                   std::span<const ShadowCascade> cascades,
+                                   const glm::vec3* boundsMin, const glm::vec3* boundsMax,
+                                   size_t count, uint8_t* outMasks)
+{
+    const glm::vec3 axes[3] = {light.Right, light.Up, light.Forward};
+
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 minX, minY, minZ, maxX, maxY, maxZ;
+        LoadVec3x4Sse41(boundsMin + i, &minX, &minY, &minZ);
+        LoadVec3x4Sse41(boundsMax + i, &maxX, &maxY, &maxZ);
+
+        __m128 centerX = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+        __m128 centerY = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+        __m128 centerZ = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+        __m128 extentX = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+        __m128 extentY = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+        __m128 extentZ = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+
+        __m128 lightMin[3];
+        __m128 lightMax[3];
+
+        for (int a = 0; a < 3; ++a)
+        {
+            const glm::vec3& axis = axes[a];
+
+            __m128 c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(axis.x), centerX),
+                                             _mm_mul_ps(_mm_set1_ps(axis.y), centerY)),
+                                  _mm_mul_ps(_mm_set1_ps(axis.z), centerZ));
+            __m128 e = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(axis.x)), extentX),
+                           _mm_mul_ps(_mm_set1_ps(std::abs(axis.y)), extentY)),
+                _mm_mul_ps(_mm_set1_ps(std::abs(axis.z)), extentZ));
+
+            lightMin[a] = _mm_sub_ps(c, e);
+            lightMax[a] = _mm_add_ps(c, e);
+        }
+
+        __m128i masks = _mm_setzero_si128();
+
+        for (size_t c = 0; c < cascades.size(); ++c)
+        {
+            const ShadowCascade& cascade = cascades[c];
+
+            __m128 affects = _mm_and_ps(
+                _mm_and_ps(_mm_cmpge_ps(lightMax[0], _mm_set1_ps(cascade.BoundsMin.x)),
+                           _mm_cmple_ps(lightMin[0], _mm_set1_ps(cascade.BoundsMax.x))),
+                _mm_and_ps(
+                    _mm_and_ps(_mm_cmpge_ps(lightMax[1], _mm_set1_ps(cascade.BoundsMin.y)),
+                               _mm_cmple_ps(lightMin[1], _mm_set1_ps(cascade.BoundsMax.y))),
+                    _mm_cmple_ps(lightMin[2], _mm_set1_ps(cascade.BoundsMax.z))));
+
+            masks = _mm_or_si128(masks, _mm_and_si128(_mm_castps_si128(affects),
+                                                      _mm_set1_epi32(1 << c)));
+        }
+
+        // Each mask fits in the low byte of its lane.
+        __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(masks, masks), masks);
+        int packed = _mm_cvtsi128_si32(bytes);
+        std::memcpy(outMasks + i, &packed, 4);
+    }
+
+    CullCastersScalar(light, cascades, boundsMin + i, boundsMax + i, count - i, outMasks + i);
+}
+
+TARGET_AVX2 void LoadVec3x8Avx2(const glm::vec3* src, __m256* x, __m256* y, __m256* z)
+{
+    __m128 loX, loY, loZ, hiX, hiY, hiZ;
+    LoadVec3x4Sse41(src, &loX, &loY, &loZ);
+    LoadVec3x4Sse41(src + 4, &hiX, &hiY, &hiZ);
+
+    *x = _mm256_insertf128_ps(_mm256_castps128_ps256(loX), hiX, 1);
+    *y = _mm256_insertf128_ps(_mm256_castps128_ps256(loY), hiY, 1);
+    *z = _mm256_insertf128_ps(_mm256_castps128_ps256(loZ), hiZ, 1);
+}
+
+TARGET_AVX2 void CullCastersAvx2(const LightBasis& light, std::span<const ShadowCascade> cascades,
+                                 const glm::vec3* boundsMin, const glm::vec3* boundsMax,
+                                 size_t count, uint8_t* outMasks)
+{
+    const glm::vec3 axes[3] = {light.Right, light.Up, light.Forward};
+
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 minX, minY, minZ, maxX, maxY, maxZ;
+        LoadVec3x8Avx2(boundsMin + i, &minX, &minY, &minZ);
+        LoadVec3x8Avx2(boundsMax + i, &maxX, &maxY, &maxZ);
+
+        __m256 centerX = _mm256_mul_ps(_mm256_add_ps(minX, maxX), half);
+        __m256 centerY = _mm256_mul_ps(_mm256_add_ps(minY, maxY), half);
+        __m256 centerZ = _mm256_mul_ps(_mm256_add_ps(minZ, maxZ), half);
+        __m256 extentX = _mm256_mul_ps(_mm256_sub_ps(maxX, minX), half);
+        __m256 extentY = _mm256_mul_ps(_mm256_sub_ps(maxY, minY), half);
+        __m256 extentZ = _mm256_mul_ps(_mm256_sub_ps(maxZ, minZ), half);
+
+        __m256 lightMin[3];
+        __m256 lightMax[3];
+
+        for (int a = 0; a < 3; ++a)
+        {
+            const glm::vec3& axis = axes[a];
+
+            __m256 c = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(axis.x), centerX),
+                              _mm256_mul_ps(_mm256_set1_ps(axis.y), centerY)),
+                _mm256_mul_ps(_mm256_set1_ps(axis.z), centerZ));
+            __m256 e = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::abs(axis.x)), extentX),
+                              _mm256_mul_ps(_mm256_set1_ps(std::abs(axis.y)), extentY)),
+                _mm256_mul_ps(_mm256_set1_ps(std::abs(axis.z)), extentZ));
+
+            lightMin[a] = _mm256_sub_ps(c, e);
+            lightMax[a] = _mm256_add_ps(c, e);
+        }
+
+        __m256i masks = _mm256_setzero_si256();
+
+        for (size_t c = 0; c < cascades.size(); ++c)
+        {
+            const ShadowCascade& cascade = cascades[c];
+
+            __m256 overlapX = _mm256_and_ps(
+                _mm256_cmp_ps(lightMax[0], _mm256_set1_ps(cascade.BoundsMin.x), _CMP_GE_OQ),
+                _mm256_cmp_ps(lightMin[0], _mm256_set1_ps(cascade.BoundsMax.x), _CMP_LE_OQ));
+            __m256 overlapY = _mm256_and_ps(
+                _mm256_cmp_ps(lightMax[1], _mm256_set1_ps(cascade.BoundsMin.y), _CMP_GE_OQ),
+                _mm256_cmp_ps(lightMin[1], _mm256_set1_ps(cascade.BoundsMax.y), _CMP_LE_OQ));
+            __m256 inFront =
+                _mm256_cmp_ps(lightMin[2], _mm256_set1_ps(cascade.BoundsMax.z), _CMP_LE_OQ);
+
+            __m256 affects = _mm256_and_ps(_mm256_and_ps(overlapX, overlapY), inFront);
+
+            masks = _mm256_or_si256(masks, _mm256_and_si256(_mm256_castps_si256(affects),
+                                                            _mm256_set1_epi32(1 << c)));
+        }
+
+        // Each mask fits in the low byte of its lane. Packing works within 128-bit halves, so
+        // the two halves' bytes end up in the first and fifth dwords.
+        __m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(masks, masks), masks);
+        int lo = _mm256_extract_epi32(bytes, 0);
+        int hi = _mm256_extract_epi32(bytes, 4);
+        std::memcpy(outMasks + i, &lo, 4);
+        std::memcpy(outMasks + i + 4, &hi, 4);
+    }
+
+    CullCastersScalar(light, cascades, boundsMin + i, boundsMax + i, count - i, outMasks + i);
+}
+
+#elif defined(GRFX_SIMD_NEON)
+
+void CullCastersNeon(const LightBasis& light, std::span<const ShadowCascade> cascades,
+                     const glm::vec3* boundsMin, const glm::vec3* boundsMax, size_t count,
+                     uint8_t* outMasks)
+{
+    const glm::vec3 axes[3] = {light.Right, light.Up, light.Forward};
+
+    const float32x4_t half = vdupq_n_f32(0.5f);
+
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        // Deinterleaves four packed vec3s.
+        float32x4x3_t mins = vld3q_f32(&boundsMin[i].x);
+        float32x4x3_t maxs = vld3q_f32(&boundsMax[i].x);
+
+        float32x4_t center[3];
+        float32x4_t extent[3];
+
+        for (int a = 0; a < 3; ++a)
+        {
+            center[a] = vmulq_f32(vaddq_f32(mins.val[a], maxs.val[a]), half);
+            extent[a] = vmulq_f32(vsubq_f32(maxs.val[a], mins.val[a]), half);
+        }
+
+        float32x4_t lightMin[3];
+        float32x4_t lightMax[3];
+
+        for (int a = 0; a < 3; ++a)
+        {
+            const glm::vec3& axis = axes[a];
+
+            float32x4_t c = vaddq_f32(vaddq_f32(vmulq_n_f32(center[0], axis.x),
+                                                vmulq_n_f32(center[1], axis.y)),
+                                      vmulq_n_f32(center[2], axis.z));
+            float32x4_t e = vaddq_f32(vaddq_f32(vmulq_n_f32(extent[0], std::abs(axis.x)),
+                                                vmulq_n_f32(extent[1], std::abs(axis.y))),
+                                      vmulq_n_f32(extent[2], std::abs(axis.z)));
+
+            lightMin[a] = vsubq_f32(c, e);
+            lightMax[a] = vaddq_f32(c, e);
+        }
+
+        uint32x4_t masks = vdupq_n_u32(0);
+
+        for (size_t c = 0; c < cascades.size(); ++c)
+        {
+            const ShadowCascade& cascade = cascades[c];
+
+            uint32x4_t affects = vandq_u32(
+                vandq_u32(vcgeq_f32(lightMax[0], vdupq_n_f32(cascade.BoundsMin.x)),
+                          vcleq_f32(lightMin[0], vdupq_n_f32(cascade.BoundsMax.x))),
+                vandq_u32(vandq_u32(vcgeq_f32(lightMax[1], vdupq_n_f32(cascade.BoundsMin.y)),
+                                    vcleq_f32(lightMin[1], vdupq_n_f32(cascade.BoundsMax.y))),
+                          vcleq_f32(lightMin[2], vdupq_n_f32(cascade.BoundsMax.z))));
+
+            masks = vorrq_u32(masks, vandq_u32(affects, vdupq_n_u32(1u << c)));
+        }
+
+        uint8x8_t bytes = vmovn_u16(vcombine_u16(vmovn_u32(masks), vmovn_u32(masks)));
+        vst1_lane_u32(reinterpret_cast<uint32_t*>(outMasks + i), vreinterpret_u32_u8(bytes), 0);
+    }
+
+    CullCastersScalar(light, cascades, boundsMin + i, boundsMax + i, count - i, outMasks + i);
+}
+
+#endif
+
+} // namespace
+
+LightBasis LightBasis::FromDirection(const glm::vec3& direction)
+{
+    LightBasis basis{};
+    basis.Forward = glm::normalize(direction);
+
+    // Any axis not parallel to the light will do, as long as it never changes.
+    glm::vec3 reference = std::abs(basis.Forward.y) < 0.99f ? glm::vec3(0.f, 1.f, 0.f) :
+                                                              glm::vec3(0.f, 0.f, 1.f);
+
+    basis.Right = glm::normalize(glm::cross(reference, basis.Forward));
+    basis.Up = glm::cross(basis.Forward, basis.Right);
+
+    return basis;
+}
+
+void ComputeCascadeSplits(const ShadowSettings& settings, float nearZ, float farZ,
+                          std::span<float> splits)
+{
+    uint32_t numCascades = settings.NumCascades;
+
+    if (splits.size() != numCascades + 1 || nearZ <= 0.f || farZ <= nearZ)
+        throw std::runtime_error("Invalid cascade split range.");
+
+    splits[0] = nearZ;
+
+    for (uint32_t i = 1; i < numCascades; ++i)
+    {
+        float t = static_cast<float>(i) / static_cast<float>(numCascades);
+
+        float logSplit = nearZ * std::pow(farZ / nearZ, t);
+        float uniformSplit = nearZ + (farZ - nearZ) * t;
+
+        splits[i] = settings.SplitLambda * logSplit + (1.f - settings.SplitLambda) * uniformSplit;
+    }
+
+    splits[numCascades] = farZ;
+}
+
+void ComputeShadowCascades(const ShadowSettings& settings, const ShadowCamera& camera,
+                           const LightBasis& light, const glm::vec3& sceneMin,
+                           const glm::vec3& sceneMax, std::span<ShadowCascade> cascades)
+{
+    if (settings.NumCascades == 0 || settings.NumCascades > MAX_SHADOW_CASCADES ||
+        settings.Resolution <= 2 || cascades.size() != settings.NumCascades)
+    {
+        throw std::runtime_error("Invalid shadow settings.");
+    }
+
+    float splits[MAX_SHADOW_CASCADES + 1];
+    ComputeCascadeSplits(settings, camera.NearZ, std::min(camera.FarZ, settings.MaxDistance),
+                         std::span(splits, settings.NumCascades + 1));
+
+    glm::mat4 invViewMat = glm::inverse(camera.ViewMat);
+    glm::vec3 cameraPos = glm::vec3(invViewMat[3]);
+    glm::vec3 cameraForward = glm::normalize(glm::vec3(invViewMat[2]));
+
+    // Squared tangent from the view axis to the frustum's corner edges.
+    float tanHalfFovY = std::tan(camera.FovY * 0.5f);
+    float tanHalfFovX = tanHalfFovY * camera.AspectRatio;
+    float cornerTanSq = tanHalfFovX * tanHalfFovX + tanHalfFovY * tanHalfFovY;
+
+    glm::vec3 sceneLightMin;
+    glm::vec3 sceneLightMax;
+    GetLightSpaceBounds(light, sceneMin, sceneMax, &sceneLightMin, &sceneLightMax);
+
+    float resolution = static_cast<float>(settings.Resolution);
+
+    for (uint32_t i = 0; i < settings.NumCascades; ++i)
+    {
+        float n = splits[i];
+        float f = splits[i + 1];
+
+        // The sphere through the near and far corners of the slice, centered on the view axis.
+        // Wide slices are bounded by the far corners alone.
+        float centerDist = (f + n) * (1.f + cornerTanSq) * 0.5f;
+        float radius = 0.f;
+
+        if (centerDist >= f)
+        {
+            centerDist = f;
+            radius = f * std::sqrt(cornerTanSq);
+        }
+        else
+        {
+            radius = std::sqrt((centerDist - n) * (centerDist - n) + n * n * cornerTanSq);
+        }
+
+        glm::vec3 center = light.ToLightSpace(cameraPos + cameraForward * centerDist);
+
+        // The map is a texel wider than the sphere on each side, so snapping its center to whole
+        // texels keeps the sphere inside. Snapping stops shadow edges from crawling as the camera
+        // moves.
+        float texelSize = 2.f * radius / (resolution - 2.f);
+        float halfSize = resolution * 0.5f * texelSize;
+
+        center.x = std::round(center.x / texelSize) * texelSize;
+        center.y = std::round(center.y / texelSize) * texelSize;
+
+        ShadowCascade& cascade = cascades[i];
+        cascade.SplitNear = n;
+        cascade.SplitFar = f;
+        cascade.TexelSize = texelSize;
+
+        cascade.BoundsMin = glm::vec3(center.x - halfSize, center.y - halfSize,
+                                      std::min(sceneLightMin.z, center.z - radius));
+        cascade.BoundsMax = glm::vec3(center.x + halfSize, center.y + halfSize,
+                                      center.z + radius);
+
+        glm::vec3 size = cascade.BoundsMax - cascade.BoundsMin;
+
+        // Rows of the orthographic projection of the light-space box, applied to the basis.
+        glm::vec4 rowX(light.Right * (2.f / size.x),
+                       -(cascade.BoundsMin.x + cascade.BoundsMax.x) / size.x);
+        glm::vec4 rowY(light.Up * (2.f / size.y),
+                       -(cascade.BoundsMin.y + cascade.BoundsMax.y) / size.y);
+        glm::vec4 rowZ(light.Forward / size.z, -cascade.BoundsMin.z / size.z);
+
+        glm::mat4 viewProj(1.f);
+
+        for (int col = 0; col < 4; ++col)
+        {
+            viewProj[col][0] = rowX[col];
+            viewProj[col][1] = rowY[col];
+            viewProj[col][2] = rowZ[col];
+        }
+
+        cascade.ViewProjMat = viewProj;
+    }
+}
+
+ShadowCasterCuller::ShadowCasterCuller(JobSystem* jobSystem)
+    : ShadowCasterCuller(jobSystem, GetPixelKernels().Level)
+{
+}
+
+ShadowCasterCuller::ShadowCasterCuller(JobSystem* jobSystem, SimdLevel level)
+    : m_jobSystem(jobSystem), m_simdLevel(level), m_cullCasters(CullCastersScalar)
+{
+    if (!IsSimdLevelSupported(level))
+        throw std::runtime_error("SIMD level not supported.");
+
+    switch (level)
+    {
+#if defined(GRFX_SIMD_X86)
+        case SimdLevel::Sse41:
+            m_cullCasters = CullCastersSse41;
+            break;
+        case SimdLevel::Avx2:
+            m_cullCasters = CullCastersAvx2;
+            break;
+#elif defined(GRFX_SIMD_NEON)
+        case SimdLevel::Neon:
+            m_cullCasters = CullCastersNeon;
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+SimdLevel ShadowCasterCuller::GetSimdLevel() const
+{
+    return m_simdLevel;
+}
+
+void ShadowCasterCuller::Cull(const LightBasis& light, std::span<const ShadowCascade> cascades,
+                              std::span<const glm::vec3> boundsMin,
+                              std::span<const glm::vec3> boundsMax)
+{
+    PROFILE_SCOPE("ShadowCasterCuller::Cull");
+
+    if (cascades.size() > MAX_SHADOW_CASCADES || boundsMin.size() != boundsMax.size())
+        throw std::runtime_error("Invalid shadow caster culling input.");
+
+    size_t numCasters = boundsMin.size();
+    size_t numChunks = (numCasters + castersPerChunk - 1) / castersPerChunk;
+
+    m_numCascades = static_cast<uint32_t>(cascades.size());
+    m_masks.resize(numCasters);
+
+    if (m_chunks.size() < numChunks)
+        m_chunks.resize(numChunks);
+
+    m_jobSystem->ParallelFor(numChunks, [&](size_t beginChunk, size_t endChunk) {
+        for (size_t chunkIdx = beginChunk; chunkIdx < endChunk; ++chunkIdx)
+        {
+            size_t begin = chunkIdx * castersPerChunk;
+            size_t count = std::min(castersPerChunk, numCasters - begin);
+
+            m_cullCasters(light, cascades, boundsMin.data() + begin, boundsMax.data() + begin,
+                          count, m_masks.data() + begin);
+
+            ChunkScratch& chunk = m_chunks[chunkIdx];
+
+            for (uint32_t c = 0; c < m_numCascades; ++c)
+            {
+                chunk.DrawLists[c].clear();
+            }
+
+            for (size_t i = begin; i < begin + count; ++i)
+            {
+                for (uint32_t mask = m_masks[i]; mask; mask &= mask - 1)
+                {
+                    chunk.DrawLists[std::countr_zero(mask)].push_back(static_cast<uint32_t>(i));
+                }
+            }
+        }
+    });
+
+    for (uint32_t c = 0; c < m_numCascades; ++c)
+    {
+        std::vector<uint32_t>& drawList = m_drawLists[c];
+        drawList.clear();
+
+        for (size_t chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+        {
+            const std::vector<uint32_t>& chunkList = m_chunks[chunkIdx].DrawLists[c];
+            drawList.insert(drawList.end(), chunkList.begin(), chunkList.end());
+        }
+    }
+}
+
+std::span<const uint8_t> ShadowCasterCuller::GetCascadeMasks() const
+{
+    return m_masks;
+}
+
+std::span<const uint32_t> ShadowCasterCuller::GetDrawList(uint32_t cascade) const
+{
+    return cascade < m_numCascades ? std::span<const uint32_t>(m_drawLists[cascade]) :
+                                     std::span<const uint32_t>();
+}
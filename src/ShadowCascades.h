@@ -0,0 +1,167 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "PixelKernels.h"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Casters are culled against every cascade at once into a byte of flags.
+constexpr uint32_t MAX_SHADOW_CASCADES = 8;
+
+struct ShadowSettings
+{
+    uint32_t NumCascades = 4;
+
+    // Width and height of each cascade's shadow map, in texels.
+    uint32_t Resolution = 2048;
+
+    // Blend between uniform (0) and logarithmic (1) split distances.
+    float SplitLambda = 0.75f;
+
+    // Shadows end this far from the camera, or at its far plane if that is closer.
+    float MaxDistance = 100.f;
+};
+
+// The camera the cascades cover, with the projection as passed to glm::perspective(). View space
+// is left-handed, looking down +z.
+struct ShadowCamera
+{
+    glm::mat4 ViewMat = glm::mat4(1.f);
+
+    float FovY = 0.785398f;
+    float AspectRatio = 16.f / 9.f;
+
+    float NearZ = 0.1f;
+    float FarZ = 1000.f;
+};
+
+// Axes of light space: x and y across the shadow maps, z along the light direction. It depends on
+// nothing but the direction, so shadow map texels stay put in the world while the camera moves.
+struct LightBasis
+{
+    glm::vec3 Right = glm::vec3(1.f, 0.f, 0.f);
+    glm::vec3 Up = glm::vec3(0.f, 1.f, 0.f);
+    glm::vec3 Forward = glm::vec3(0.f, 0.f, 1.f);
+
+    static LightBasis FromDirection(const glm::vec3& direction);
+
+    glm::vec3 ToLightSpace(const glm::vec3& p) const
+    {
+        return glm::vec3(glm::dot(Right, p), glm::dot(Up, p), glm::dot(Forward, p));
+    }
+};
+
+struct ShadowCascade
+{
+    // Distances in front of the camera the cascade covers.
+    float SplitNear = 0.f;
+    float SplitFar = 0.f;
+
+    // Light-space box the shadow map covers. Its depth starts at the scene bounds, so that
+    // casters between the light and the cascade are still rendered.
+    glm::vec3 BoundsMin = glm::vec3(0.f);
+    glm::vec3 BoundsMax = glm::vec3(0.f);
+
+    float TexelSize = 0.f;
+
+    // World to shadow map clip space, with depth in [0, 1].
+    glm::mat4 ViewProjMat = glm::mat4(1.f);
+};
+
+// Fills |splits| (NumCascades + 1 entries) with the practical split scheme: a blend of
+// logarithmic and uniform distances between |nearZ| and |farZ|.
+void ComputeCascadeSplits(const ShadowSettings& settings, float nearZ, float farZ,
+                          std::span<float> splits);
+
+// Fits each cascade around the bounding sphere of its slice of the camera frustum. The sphere only
+// depends on the projection, so the cascade does not change size as the camera turns, and its
+// position is snapped to whole texels. |sceneMin| and |sceneMax| bound every caster.
+void ComputeShadowCascades(const ShadowSettings& settings, const ShadowCamera& camera,
+                           const LightBasis& light, const glm::vec3& sceneMin,
+                           const glm::vec3& sceneMax, std::span<ShadowCascade> cascades);
+
+// Light-space box around a world-space box. The culling kernels evaluate exactly these
+// operations, so they agree with it bit for bit.
+inline void GetLightSpaceBounds(const LightBasis& light, const glm::vec3& worldMin,
+                                const glm::vec3& worldMax, glm::vec3* lightMin,
+                                glm::vec3* lightMax)
+{
+    glm::vec3 center = (worldMin + worldMax) * 0.5f;
+    glm::vec3 extents = (worldMax - worldMin) * 0.5f;
+
+    const glm::vec3 axes[3] = {light.Right, light.Up, light.Forward};
+
+    for (int i = 0; i < 3; ++i)
+    {
+        const glm::vec3& axis = axes[i];
+
+        float c = axis.x * center.x + axis.y * center.y + axis.z * center.z;
+        float e = std::abs(axis.x) * extents.x + std::abs(axis.y) * extents.y +
+            std::abs(axis.z) * extents.z;
+
+        (*lightMin)[i] = c - e;
+        (*lightMax)[i] = c + e;
+    }
+}
+
+// Casters are extruded along the light direction: one shadows the cascade if it overlaps it
+// across the shadow map and is not entirely beyond it.
+inline bool CasterAffectsCascade(const glm::vec3& lightMin, const glm::vec3& lightMax,
+                                 const ShadowCascade& cascade)
+{
+    return lightMax.x >= cascade.BoundsMin.x && lightMin.x <= cascade.BoundsMax.x &&
+        lightMax.y >= cascade.BoundsMin.y && lightMin.y <= cascade.BoundsMax.y &&
+        lightMin.z <= cascade.BoundsMax.z;
+}
+
+// Culls shadow casters, given as world-space boxes, against all cascades in one pass and builds
+// a draw list per cascade.
+class ShadowCasterCuller
+{
+public:
+    // Uses the fastest kernels the CPU supports unless |level| is given.
+    explicit ShadowCasterCuller(JobSystem* jobSystem);
+    ShadowCasterCuller(JobSystem* jobSystem, SimdLevel level);
+
+    SimdLevel GetSimdLevel() const;
+
+    void Cull(const LightBasis& light, std::span<const ShadowCascade> cascades,
+              std::span<const glm::vec3> boundsMin, std::span<const glm::vec3> boundsMax);
+
+    // Per caster, bit i is set if it affects cascade i. Valid after Cull().
+    std::span<const uint8_t> GetCascadeMasks() const;
+
+    // Indices of the casters that affect |cascade|, in increasing order.
+    std::span<const uint32_t> GetDrawList(uint32_t cascade) const;
+
+private:
+    using CullCastersFn = void (*)(const LightBasis& light,
+                                   std::span<const ShadowCascade> cascades,
+                                   const glm::vec3* boundsMin, const glm::vec3* boundsMax,
+                                   size_t count, uint8_t* outMasks);
+
+    // Casters are culled in fixed chunks, each with its own draw lists, which are joined at the
+    // end.
+    struct ChunkScratch
+    {
+        std::vector<uint32_t> DrawLists[MAX_SHADOW_CASCADES];
+    };
+
+    JobSystem* m_jobSystem;
+
+    SimdLevel m_simdLevel;
+    CullCastersFn m_cullCasters;
+
+    std::vector<uint8_t> m_masks;
+
+    std::vector<ChunkScratch> m_chunks;
+
+    uint32_t m_numCascades = 0;
+    std::vector<uint32_t> m_drawLists[MAX_SHADOW_CASCADES];
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+// Platform switches shared by the files with SIMD kernels.
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define GRFX_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define GRFX_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang only emit instructions beyond the baseline in functions that ask for them, which
+// keeps the rest of the program runnable on older CPUs. MSVC emits whatever intrinsics are used.
+// Helpers called from such functions need the same attribute to be inlined.
+#if defined(__GNUC__)
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE41
+#define TARGET_AVX2
+#endif
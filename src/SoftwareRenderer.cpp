@@ -0,0 +1,1044 @@
+#include "SoftwareRenderer.h"
+
+#include "Profiler.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+constexpr int32_t SUBPIXEL_BITS = 4;
+constexpr int32_t SUBPIXELS = 1 << SUBPIXEL_BITS;
+
+// Triangles reaching further than this from the center of the image are clipped, which keeps
+// snapped coordinates and edge functions small. Those within it are rasterized as they are.
+constexpr float GUARD_BAND_PIXELS = 4096.f;
+
+// Spans start and end on multiples of the widest kernel.
+constexpr int32_t SPAN_ALIGNMENT = 8;
+
+// Triangles set up by one job. Small enough for the setup of a few large draws to spread across
+// workers.
+constexpr uint32_t TRIANGLES_PER_RANGE = 1024;
+
+// Clipping a triangle against the six planes adds at most one vertex per plane.
+constexpr int MAX_CLIP_VERTICES = 9;
+constexpr int NUM_CLIP_PLANES = 6;
+
+constexpr uint32_t CLEAR_COLOR = 0xFF000000u;
+constexpr float CLEAR_DEPTH = 1.f;
+
+static_assert(SoftwareRenderer::TILE_SIZE % SPAN_ALIGNMENT == 0);
+static_assert(SoftwareRenderer::TILE_SIZE <= 64, "Span masks have one bit per pixel.");
+
+struct ClipVertex
+{
+    glm::vec4 Position;
+    glm::vec2 TexCoord;
+};
+
+struct ScreenVertex
+{
+    // Snapped to 1/16 pixel.
+    int32_t X;
+    int32_t Y;
+
+    float Depth;
+    float InvW;
+    float UOverW;
+    float VOverW;
+};
+
+// Signed distance to one of the clip planes, non-negative inside: near, far, then the guard band
+// on the right, left, top and bottom.
+float GetPlaneDistance(const glm::vec4& p, int plane, float guardX, float guardY)
+{
+    switch (plane)
+    {
+        case 0:
+            return p.z;
+        case 1:
+            return p.w - p.z;
+        case 2:
+            return guardX * p.w - p.x;
+        case 3:
+            return guardX * p.w + p.x;
+        case 4:
+            return guardY * p.w - p.y;
+        default:
+            return guardY * p.w + p.y;
+    }
+}
+
+// Sutherland-Hodgman against every plane. Returns the number of vertices left in |vertices|.
+int ClipPolygon(ClipVertex* vertices, int numVertices, float guardX, float guardY)
+{
+    ClipVertex scratch[MAX_CLIP_VERTICES];
+
+    ClipVertex* src = vertices;
+    ClipVertex* dst = scratch;
+
+    for (int plane = 0; plane < NUM_CLIP_PLANES && numVertices >= 3; ++plane)
+    {
+        int numOut = 0;
+
+        for (int i = 0; i < numVertices; ++i)
+        {
+            const ClipVertex& a = src[i];
+            const ClipVertex& b = src[(i + 1) % numVertices];
+
+            float da = GetPlaneDistance(a.Position, plane, guardX, guardY);
+            float db = GetPlaneDistance(b.Position, plane, guardX, guardY);
+
+            if (da >= 0.f)
+                dst[numOut++] = a;
+
+            if ((da >= 0.f) != (db >= 0.f) && numOut < MAX_CLIP_VERTICES)
+            {
+                float t = da / (da - db);
+
+                dst[numOut].Position = a.Position + (b.Position - a.Position) * t;
+                dst[numOut].TexCoord = a.TexCoord + (b.TexCoord - a.TexCoord) * t;
+                ++numOut;
+            }
+        }
+
+        std::swap(src, dst);
+        numVertices = numOut;
+    }
+
+    if (src != vertices)
+        std::copy(src, src + numVertices, vertices);
+
+    return numVertices;
+}
+
+// Pixels whose centers lie in [minFixed, maxFixed], as [*begin, *end).
+void GetPixelRange(int32_t minFixed, int32_t maxFixed, int32_t* begin, int32_t* end)
+{
+    // Shifts round towards negative infinity.
+    *begin = (minFixed - SUBPIXELS / 2 + SUBPIXELS - 1) >> SUBPIXEL_BITS;
+    *end = ((maxFixed - SUBPIXELS / 2) >> SUBPIXEL_BITS) + 1;
+}
+
+// Value at (x, y) of an attribute plane {value at origin, step along x, step along y}.
+inline float EvaluatePlane(const float (&plane)[3], float dx, float dy)
+{
+    return plane[0] + plane[1] * dx + plane[2] * dy;
+}
+
+inline glm::vec4 UnpackTexel(uint32_t texel)
+{
+    return glm::vec4(static_cast<float>(texel & 0xFF), static_cast<float>((texel >> 8) & 0xFF),
+                     static_cast<float>((texel >> 16) & 0xFF), static_cast<float>(texel >> 24)) *
+        (1.f / 255.f);
+}
+
+inline uint32_t PackColor(const glm::vec4& color)
+{
+    uint32_t packed = 0;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        float c = std::min(std::max(color[i], 0.f), 1.f);
+        packed |= static_cast<uint32_t>(c * 255.f + 0.5f) << (8 * i);
+    }
+
+    return packed;
+}
+
+// Bilinear filtering of the only mip with wrap addressing, as the app's sampler does.
+glm::vec4 SampleTexture(const SoftwareTexture& texture, float u, float v)
+{
+    if (!std::isfinite(u) || !std::isfinite(v))
+    {
+        u = 0.f;
+        v = 0.f;
+    }
+
+    u -= std::floor(u);
+    v -= std::floor(v);
+
+    float tx = u * static_cast<float>(texture.Width) - 0.5f;
+    float ty = v * static_cast<float>(texture.Height) - 0.5f;
+
+    float fx = std::floor(tx);
+    float fy = std::floor(ty);
+
+    float ax = tx - fx;
+    float ay = ty - fy;
+
+    auto width = static_cast<int32_t>(texture.Width);
+    auto height = static_cast<int32_t>(texture.Height);
+
+    int32_t x0 = static_cast<int32_t>(fx);
+    int32_t y0 = static_cast<int32_t>(fy);
+
+    x0 = x0 < 0 ? x0 + width : std::min(x0, width - 1);
+    y0 = y0 < 0 ? y0 + height : std::min(y0, height - 1);
+
+    int32_t x1 = x0 + 1 == width ? 0 : x0 + 1;
+    int32_t y1 = y0 + 1 == height ? 0 : y0 + 1;
+
+    const uint32_t* row0 = texture.Texels.data() + static_cast<size_t>(y0) * texture.Width;
+    const uint32_t* row1 = texture.Texels.data() + static_cast<size_t>(y1) * texture.Width;
+
+    glm::vec4 top = glm::mix(UnpackTexel(row0[x0]), UnpackTexel(row0[x1]), ax);
+    glm::vec4 bottom = glm::mix(UnpackTexel(row1[x0]), UnpackTexel(row1[x1]), ax);
+
+    return glm::mix(top, bottom, ay);
+}
+
+// The span kernels. Every one evaluates exactly these operations, so they agree bit for bit.
+
+uint64_t RasterSpanScalar(const SoftwareRenderer::SpanParams& params, float* depthRow)
+{
+    uint64_t mask = 0;
+
+    for (int32_t i = 0; i < params.Count; ++i)
+    {
+        int32_t x = params.X + i;
+
+        if (x < params.MinX || x >= params.MaxX)
+            continue;
+
+        int32_t e0 = params.Edges[0] + params.Steps[0] * i;
+        int32_t e1 = params.Edges[1] + params.Steps[1] * i;
+        int32_t e2 = params.Edges[2] + params.Steps[2] * i;
+
+        if ((e0 | e1 | e2) < 0)
+            continue;
+
+        float px = static_cast<float>(x) + 0.5f;
+        float depth = params.DepthDx * (px - params.OriginX) + params.DepthRow;
+
+        // The argument order matches the SIMD min and max.
+        depth = std::min(1.f, std::max(0.f, depth));
+
+        if (depth < depthRow[x])
+        {
+            depthRow[x] = depth;
+            mask |= uint64_t{1} << i;
+        }
+    }
+
+    return mask;
+}
+
+#if defined(GRFX_SIMD_X86)
+
+TARGET_SSE41 uint64_t RasterSpanSse41(const SoftwareRenderer::SpanParams& params,
+                                      float* depthRow)
+{
+    const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+
+    __m128i edges[3];
+    __m128i steps[3];
+
+    for (int k = 0; k < 3; ++k)
+    {
+        edges[k] = _mm_add_epi32(_mm_set1_epi32(params.Edges[k]),
+                                 _mm_mullo_epi32(_mm_set1_epi32(params.Steps[k]), lanes));
+        steps[k] = _mm_set1_epi32(params.Steps[k] * 4);
+    }
+
+    const __m128i minX = _mm_set1_epi32(params.MinX - 1);
+    const __m128i maxX = _mm_set1_epi32(params.MaxX);
+    const __m128i allOnes = _mm_set1_epi32(-1);
+
+    const __m128 depthDx = _mm_set1_ps(params.DepthDx);
+    const __m128 depthRowValue = _mm_set1_ps(params.DepthRow);
+    const __m128 originX = _mm_set1_ps(params.OriginX);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+
+    __m128i x = _mm_add_epi32(_mm_set1_epi32(params.X), lanes);
+
+    uint64_t mask = 0;
+
+    for (int32_t i = 0; i < params.Count; i += 4)
+    {
+        __m128i edgeBits = _mm_or_si128(_mm_or_si128(edges[0], edges[1]), edges[2]);
+
+        __m128i covered = _mm_and_si128(_mm_cmpgt_epi32(edgeBits, allOnes),
+                                        _mm_and_si128(_mm_cmpgt_epi32(x, minX),
+                                                      _mm_cmplt_epi32(x, maxX)));
+
+        __m128 px = _mm_add_ps(_mm_cvtepi32_ps(x), half);
+        __m128 depth = _mm_add_ps(_mm_mul_ps(depthDx, _mm_sub_ps(px, originX)), depthRowValue);
+        depth = _mm_min_ps(_mm_max_ps(depth, zero), one);
+
+        float* dst = depthRow + params.X + i;
+        __m128 prevDepth = _mm_loadu_ps(dst);
+
+        __m128 passed = _mm_and_ps(_mm_castsi128_ps(covered), _mm_cmplt_ps(depth, prevDepth));
+
+        _mm_storeu_ps(dst, _mm_blendv_ps(prevDepth, depth, passed));
+
+        mask |= static_cast<uint64_t>(_mm_movemask_ps(passed)) << i;
+
+        for (int k = 0; k < 3; ++k)
+            edges[k] = _mm_add_epi32(edges[k], steps[k]);
+
+        x = _mm_add_epi32(x, _mm_set1_epi32(4));
+    }
+
+    return mask;
+}
+
+TARGET_AVX2 uint64_t RasterSpanAvx2(const SoftwareRenderer::SpanParams& params, float* depthRow)
+{
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    __m256i edges[3];
+    __m256i steps[3];
+
+    for (int k = 0; k < 3; ++k)
+    {
+        edges[k] = _mm256_add_epi32(_mm256_set1_epi32(params.Edges[k]),
+                                    _mm256_mullo_epi32(_mm256_set1_epi32(params.Steps[k]), lanes));
+        steps[k] = _mm256_set1_epi32(params.Steps[k] * 8);
+    }
+
+    const __m256i minX = _mm256_set1_epi32(params.MinX - 1);
+    const __m256i maxX = _mm256_set1_epi32(params.MaxX);
+    const __m256i allOnes = _mm256_set1_epi32(-1);
+
+    const __m256 depthDx = _mm256_set1_ps(params.DepthDx);
+    const __m256 depthRowValue = _mm256_set1_ps(params.DepthRow);
+    const __m256 originX = _mm256_set1_ps(params.OriginX);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.f);
+
+    __m256i x = _mm256_add_epi32(_mm256_set1_epi32(params.X), lanes);
+
+    uint64_t mask = 0;
+
+    for (int32_t i = 0; i < params.Count; i += 8)
+    {
+        __m256i edgeBits = _mm256_or_si256(_mm256_or_si256(edges[0], edges[1]), edges[2]);
+
+        __m256i covered = _mm256_and_si256(_mm256_cmpgt_epi32(edgeBits, allOnes),
+                                           _mm256_and_si256(_mm256_cmpgt_epi32(x, minX),
+                                                            _mm256_cmpgt_epi32(maxX, x)));
+
+        __m256 px = _mm256_add_ps(_mm256_cvtepi32_ps(x), half);
+        __m256 depth = _mm256_add_ps(_mm256_mul_ps(depthDx, _mm256_sub_ps(px, originX)),
+                                     depthRowValue);
+        depth = _mm256_min_ps(_mm256_max_ps(depth, zero), one);
+
+        float* dst = depthRow + params.X + i;
+        __m256 prevDepth = _mm256_loadu_ps(dst);
+
+        __m256 passed = _mm256_and_ps(_mm256_castsi256_ps(covered),
+                                      _mm256_cmp_ps(depth, prevDepth, _CMP_LT_OQ));
+
+        _mm256_storeu_ps(dst, _mm256_blendv_ps(prevDepth, depth, passed));
+
+        mask |= static_cast<uint64_t>(_mm256_movemask_ps(passed)) << i;
+
+        for (int k = 0; k < 3; ++k)
+            edges[k] = _mm256_add_epi32(edges[k], steps[k]);
+
+        x = _mm256_add_epi32(x, _mm256_set1_epi32(8));
+    }
+
+    return mask;
+}
+
+#elif defined(GRFX_SIMD_NEON)
+
+uint64_t RasterSpanNeon(const SoftwareRenderer::SpanParams& params, float* depthRow)
+{
+    static const int32_t laneIndices[4] = {0, 1, 2, 3};
+    static const uint32_t laneBits[4] = {1, 2, 4, 8};
+
+    const int32x4_t lanes = vld1q_s32(laneIndices);
+    const uint32x4_t bits = vld1q_u32(laneBits);
+
+    int32x4_t edges[3];
+    int32x4_t steps[3];
+
+    for (int k = 0; k < 3; ++k)
+    {
+        edges[k] = vaddq_s32(vdupq_n_s32(params.Edges[k]),
+                             vmulq_s32(vdupq_n_s32(params.Steps[k]), lanes));
+        steps[k] = vdupq_n_s32(params.Steps[k] * 4);
+    }
+
+    const int32x4_t minX = vdupq_n_s32(params.MinX);
+    const int32x4_t maxX = vdupq_n_s32(params.MaxX);
+    const int32x4_t zeroInt = vdupq_n_s32(0);
+
+    const float32x4_t depthDx = vdupq_n_f32(params.DepthDx);
+    const float32x4_t depthRowValue = vdupq_n_f32(params.DepthRow);
+    const float32x4_t originX = vdupq_n_f32(params.OriginX);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    const float32x4_t zero = vdupq_n_f32(0.f);
+    const float32x4_t one = vdupq_n_f32(1.f);
+
+    int32x4_t x = vaddq_s32(vdupq_n_s32(params.X), lanes);
+
+    uint64_t mask = 0;
+
+    for (int32_t i = 0; i < params.Count; i += 4)
+    {
+        int32x4_t edgeBits = vorrq_s32(vorrq_s32(edges[0], edges[1]), edges[2]);
+
+        uint32x4_t covered = vandq_u32(vcgeq_s32(edgeBits, zeroInt),
+                                       vandq_u32(vcgeq_s32(x, minX), vcltq_s32(x, maxX)));
+
+        float32x4_t px = vaddq_f32(vcvtq_f32_s32(x), half);
+        float32x4_t depth = vaddq_f32(vmulq_f32(depthDx, vsubq_f32(px, originX)), depthRowValue);
+        depth = vminq_f32(vmaxq_f32(depth, zero), one);
+
+        float* dst = depthRow + params.X + i;
+        float32x4_t prevDepth = vld1q_f32(dst);
+
+        uint32x4_t passed = vandq_u32(covered, vcltq_f32(depth, prevDepth));
+
+        vst1q_f32(dst, vbslq_f32(passed, depth, prevDepth));
+
+        mask |= static_cast<uint64_t>(vaddvq_u32(vandq_u32(passed, bits))) << i;
+
+        for (int k = 0; k < 3; ++k)
+            edges[k] = vaddq_s32(edges[k], steps[k]);
+
+        x = vaddq_s32(x, vdupq_n_s32(4));
+    }
+
+    return mask;
+}
+
+#endif
+
+template<typename T>
+void ReadElements(const ModelData& model, const BufferRange& range, std::vector<T>* dst)
+{
+    const std::vector<std::byte>& buffer = model.Buffers.at(static_cast<size_t>(range.Buffer));
+
+    size_t stride = range.ByteStride ? range.ByteStride : sizeof(T);
+
+    if (range.Count > 0 &&
+        range.ByteOffset + (range.Count - 1) * stride + sizeof(T) > buffer.size())
+    {
+        throw std::runtime_error("Buffer range out of bounds.");
+    }
+
+    dst->resize(range.Count);
+
+    for (size_t i = 0; i < range.Count; ++i)
+        std::memcpy(&(*dst)[i], buffer.data() + range.ByteOffset + i * stride, sizeof(T));
+}
+
+} // namespace
+
+SoftwareGeometry ReadSoftwareGeometry(const ModelData& model, const PrimitiveData& prim)
+{
+    SoftwareGeometry geometry;
+
+    ReadElements(model, prim.Positions, &geometry.Positions);
+
+    if (prim.TexCoords.IsValid())
+        ReadElements(model, prim.TexCoords, &geometry.TexCoords);
+
+    std::vector<uint16_t> indices;
+    ReadElements(model, prim.Indices, &indices);
+
+    geometry.Indices.assign(indices.begin(), indices.end());
+
+    return geometry;
+}
+
+SoftwareRenderer::SoftwareRenderer(JobSystem* jobSystem, uint32_t width, uint32_t height)
+    : SoftwareRenderer(jobSystem, width, height, GetPixelKernels().Level)
+{
+}
+
+SoftwareRenderer::SoftwareRenderer(JobSystem* jobSystem, uint32_t width, uint32_t height,
+                                   SimdLevel level)
+    : m_jobSystem(jobSystem)
+    , m_simdLevel(level)
+    , m_rasterSpan(RasterSpanScalar)
+    , m_width(width)
+    , m_height(height)
+{
+    if (!IsSimdLevelSupported(level))
+        throw std::runtime_error("SIMD level not supported.");
+
+    if (width == 0 || height == 0 || width > MAX_SIZE || height > MAX_SIZE)
+        throw std::runtime_error("Invalid software render target size.");
+
+    switch (level)
+    {
+#if defined(GRFX_SIMD_X86)
+        case SimdLevel::Sse41:
+            m_rasterSpan = RasterSpanSse41;
+            break;
+        case SimdLevel::Avx2:
+            m_rasterSpan = RasterSpanAvx2;
+            break;
+#elif defined(GRFX_SIMD_NEON)
+        case SimdLevel::Neon:
+            m_rasterSpan = RasterSpanNeon;
+            break;
+#endif
+        default:
+            break;
+    }
+
+    m_numTilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    m_numTilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+    m_stride = size_t{m_numTilesX} * TILE_SIZE;
+
+    m_color.assign(m_stride * height, CLEAR_COLOR);
+    m_depth.assign(m_stride * height, CLEAR_DEPTH);
+
+    // One more for the thread that renders, should it not be a worker.
+    m_threadStates.resize(static_cast<size_t>(jobSystem->GetThreadCount()) + 1);
+
+    for (ThreadState& state : m_threadStates)
+    {
+        state.Bins.resize(size_t{m_numTilesX} * m_numTilesY);
+        state.Cursors.resize(m_threadStates.size());
+    }
+}
+
+uint32_t SoftwareRenderer::AddGeometry(SoftwareGeometry geometry)
+{
+    if (!geometry.TexCoords.empty() && geometry.TexCoords.size() != geometry.Positions.size())
+        throw std::runtime_error("Texture coordinates do not match positions.");
+
+    for (uint32_t index : geometry.Indices)
+    {
+        if (index >= geometry.Positions.size())
+            throw std::runtime_error("Index out of range.");
+    }
+
+    m_geometry.push_back(std::move(geometry));
+
+    return static_cast<uint32_t>(m_geometry.size() - 1);
+}
+
+void SoftwareRenderer::SetTexture(TextureId id, SoftwareTexture texture)
+{
+    if (id < 0)
+        throw std::runtime_error("Invalid texture ID.");
+
+    if (texture.Texels.size() != size_t{texture.Width} * texture.Height)
+        throw std::runtime_error("Texture size does not match its texels.");
+
+    if (static_cast<size_t>(id) >= m_textures.size())
+        m_textures.resize(static_cast<size_t>(id) + 1);
+
+    m_textures[static_cast<size_t>(id)] = std::move(texture);
+}
+
+void SoftwareRenderer::SetMaterials(std::span<const MaterialRecord> records)
+{
+    m_materials.assign(records.begin(), records.end());
+}
+
+void SoftwareRenderer::RenderFrame(const FramePacket& packet)
+{
+    PROFILE_SCOPE("SoftwareRenderer::RenderFrame");
+
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point start = Clock::now();
+
+    m_stats = {};
+
+    BuildRanges(packet);
+
+    for (ThreadState& state : m_threadStates)
+    {
+        state.Triangles.clear();
+
+        for (std::vector<BinEntry>& bin : state.Bins)
+            bin.clear();
+
+        state.NumRasterized = 0;
+        state.NumBinned = 0;
+        state.NumPixelsShaded = 0;
+    }
+
+    // Each worker claims ranges in increasing order, so its bins are sorted by range.
+    m_jobSystem->ParallelFor(m_ranges.size(), [&](size_t begin, size_t end) {
+        ThreadState& state = GetThreadState();
+
+        for (size_t i = begin; i < end; ++i)
+            SetupRange(packet, static_cast<uint32_t>(i), &state);
+    });
+
+    Clock::time_point setupEnd = Clock::now();
+
+    m_jobSystem->ParallelFor(size_t{m_numTilesX} * m_numTilesY, [&](size_t begin, size_t end) {
+        ThreadState& state = GetThreadState();
+
+        for (size_t i = begin; i < end; ++i)
+            RasterizeTile(static_cast<uint32_t>(i), &state);
+    });
+
+    Clock::time_point rasterEnd = Clock::now();
+
+    for (const ThreadState& state : m_threadStates)
+    {
+        m_stats.NumRasterized += state.NumRasterized;
+        m_stats.NumBinned += state.NumBinned;
+        m_stats.NumPixelsShaded += state.NumPixelsShaded;
+    }
+
+    m_stats.SetupMs = std::chrono::duration<double, std::milli>(setupEnd - start).count();
+    m_stats.RasterMs = std::chrono::duration<double, std::milli>(rasterEnd - setupEnd).count();
+}
+
+uint32_t SoftwareRenderer::GetWidth() const
+{
+    return m_width;
+}
+
+uint32_t SoftwareRenderer::GetHeight() const
+{
+    return m_height;
+}
+
+const uint8_t* SoftwareRenderer::GetPixels() const
+{
+    return reinterpret_cast<const uint8_t*>(m_color.data());
+}
+
+size_t SoftwareRenderer::GetRowPitch() const
+{
+    return m_stride * sizeof(uint32_t);
+}
+
+SimdLevel SoftwareRenderer::GetSimdLevel() const
+{
+    return m_simdLevel;
+}
+
+const SoftwareRenderer::Stats& SoftwareRenderer::GetStats() const
+{
+    return m_stats;
+}
+
+SoftwareRenderer::ThreadState& SoftwareRenderer::GetThreadState()
+{
+    int threadIdx = m_jobSystem->GetCurrentThreadIndex();
+
+    if (threadIdx < 0)
+        return m_threadStates.back();
+
+    return m_threadStates[static_cast<size_t>(threadIdx)];
+}
+
+void SoftwareRenderer::BuildRanges(const FramePacket& packet)
+{
+    m_ranges.clear();
+
+    uint32_t geometryIdx = UINT32_MAX;
+    uint32_t textureId = UINT32_MAX;
+    uint32_t instanceCount = 1;
+    uint32_t firstInstance = 0;
+
+    // The same walk as the D3D12 backend's.
+    for (const Command& command : packet.Commands)
+    {
+        switch (command.Type)
+        {
+            case CommandType::SetBaseColorTexture:
+                textureId = command.Value;
+                break;
+            case CommandType::SetGeometry:
+                geometryIdx = command.Value;
+                break;
+            case CommandType::SetInstanceCount:
+                instanceCount = command.Value;
+                break;
+            case CommandType::DrawIndexed: {
+                if (geometryIdx >= m_geometry.size())
+                    throw std::runtime_error("Draw with unknown geometry.");
+
+                if (size_t{firstInstance} + instanceCount > packet.Instances.size())
+                    throw std::runtime_error("Draw reads past the frame's instances.");
+
+                const SoftwareGeometry& geometry = m_geometry[geometryIdx];
+
+                auto numTriangles = static_cast<uint32_t>(
+                    std::min<size_t>(command.Value, geometry.Indices.size()) / 3);
+
+                for (uint32_t instance = 0; instance < instanceCount; ++instance)
+                {
+                    for (uint32_t first = 0; first < numTriangles; first += TRIANGLES_PER_RANGE)
+                    {
+                        m_ranges.push_back({geometryIdx, firstInstance + instance, textureId, first,
+                                            std::min(TRIANGLES_PER_RANGE, numTriangles - first)});
+                    }
+                }
+
+                m_stats.NumTriangles += uint64_t{numTriangles} * instanceCount;
+                firstInstance += instanceCount;
+                break;
+        }
+        }
+    }
+}
+
+void SoftwareRenderer::SetupRange(const FramePacket& packet, uint32_t rangeIdx,
+                                  ThreadState* state)
+{
+    const DrawRange& range = m_ranges[rangeIdx];
+    const SoftwareGeometry& geometry = m_geometry[range.GeometryIdx];
+    const InstanceData& instance = packet.Instances[range.InstanceIdx];
+
+    const glm::mat4& m = instance.WorldViewProjMat;
+
+    const uint32_t* indices = geometry.Indices.data() + size_t{range.FirstTriangle} * 3;
+
+    for (uint32_t i = 0; i < range.NumTriangles; ++i)
+    {
+        glm::vec4 positions[3];
+        glm::vec2 texCoords[3];
+
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t index = indices[i * 3 + static_cast<uint32_t>(k)];
+            const glm::vec3& p = geometry.Positions[index];
+
+            // As VSMain multiplies by the instance's matrix columns.
+            positions[k] = m[0] * p.x + m[1] * p.y + m[2] * p.z + m[3];
+            texCoords[k] = geometry.TexCoords.empty() ? glm::vec2(0.f) : geometry.TexCoords[index];
+        }
+
+        AddTriangle(positions, texCoords, range, instance.MaterialIdx, rangeIdx, state);
+    }
+}
+
+void SoftwareRenderer::AddTriangle(const glm::vec4 (&positions)[3],
+                                   const glm::vec2 (&texCoords)[3], const DrawRange& range,
+                                   uint32_t materialIdx, uint32_t rangeIdx, ThreadState* state)
+{
+    const glm::vec4& p0 = positions[0];
+    const glm::vec4& p1 = positions[1];
+    const glm::vec4& p2 = positions[2];
+
+    // Entirely outside one side of the view volume.
+    if ((p0.x > p0.w && p1.x > p1.w && p2.x > p2.w) ||
+        (p0.x < -p0.w && p1.x < -p1.w && p2.x < -p2.w) ||
+        (p0.y > p0.w && p1.y > p1.w && p2.y > p2.w) ||
+        (p0.y < -p0.w && p1.y < -p1.w && p2.y < -p2.w) ||
+        (p0.z < 0.f && p1.z < 0.f && p2.z < 0.f) ||
+        (p0.z > p0.w && p1.z > p1.w && p2.z > p2.w))
+    {
+        return;
+    }
+
+    float halfWidth = static_cast<float>(m_width) * 0.5f;
+    float halfHeight = static_cast<float>(m_height) * 0.5f;
+
+    float guardX = GUARD_BAND_PIXELS / halfWidth;
+    float guardY = GUARD_BAND_PIXELS / halfHeight;
+
+    ClipVertex vertices[MAX_CLIP_VERTICES];
+    int numVertices = 3;
+    bool needsClipping = false;
+
+    for (int k = 0; k < 3; ++k)
+    {
+        vertices[k] = {positions[k], texCoords[k]};
+
+        for (int plane = 0; plane < NUM_CLIP_PLANES; ++plane)
+        {
+            if (GetPlaneDistance(positions[k], plane, guardX, guardY) < 0.f)
+                needsClipping = true;
+        }
+    }
+
+    if (needsClipping)
+        numVertices = ClipPolygon(vertices, numVertices, guardX, guardY);
+
+    ScreenVertex screen[MAX_CLIP_VERTICES];
+
+    for (int k = 0; k < numVertices; ++k)
+    {
+        const ClipVertex& v = vertices[k];
+
+        if (!(v.Position.w > 0.f))
+            return;
+
+        float invW = 1.f / v.Position.w;
+
+        float x = (v.Position.x * invW + 1.f) * halfWidth;
+        float y = (1.f - v.Position.y * invW) * halfHeight;
+
+        screen[k].X = static_cast<int32_t>(std::floor(x * SUBPIXELS + 0.5f));
+        screen[k].Y = static_cast<int32_t>(std::floor(y * SUBPIXELS + 0.5f));
+        screen[k].Depth = v.Position.z * invW;
+        screen[k].InvW = invW;
+        screen[k].UOverW = v.TexCoord.x * invW;
+        screen[k].VOverW = v.TexCoord.y * invW;
+    }
+
+    // Clipped polygons are convex, so a fan covers them.
+    for (int k = 1; k + 1 < numVertices; ++k)
+    {
+        const ScreenVertex* v[3] = {&screen[0], &screen[k], &screen[k + 1]};
+
+        // Twice the area, positive for the clockwise front faces in this y-down space.
+        int64_t area = int64_t{v[1]->X - v[0]->X} * (v[2]->Y - v[0]->Y) -
+            int64_t{v[2]->X - v[0]->X} * (v[1]->Y - v[0]->Y);
+
+        if (area <= 0)
+            continue;
+
+        Triangle tri;
+
+        GetPixelRange(std::min({v[0]->X, v[1]->X, v[2]->X}), std::max({v[0]->X, v[1]->X, v[2]->X}),
+                      &tri.MinX, &tri.MaxX);
+        GetPixelRange(std::min({v[0]->Y, v[1]->Y, v[2]->Y}), std::max({v[0]->Y, v[1]->Y, v[2]->Y}),
+                      &tri.MinY, &tri.MaxY);
+
+        tri.MinX = std::max(tri.MinX, 0);
+        tri.MinY = std::max(tri.MinY, 0);
+        tri.MaxX = std::min(tri.MaxX, static_cast<int32_t>(m_width));
+        tri.MaxY = std::min(tri.MaxY, static_cast<int32_t>(m_height));
+
+        if (tri.MinX >= tri.MaxX || tri.MinY >= tri.MaxY)
+            continue;
+
+        for (int e = 0; e < 3; ++e)
+        {
+            const ScreenVertex& a = *v[e];
+            const ScreenVertex& b = *v[(e + 1) % 3];
+
+            int32_t dx = b.X - a.X;
+            int32_t dy = b.Y - a.Y;
+
+            // Pixels exactly on an edge belong to the triangle only if it is a top or left edge.
+            bool isTopLeft = (dy == 0 && dx > 0) || dy < 0;
+
+            tri.EdgeStepsX[e] = -dy * SUBPIXELS;
+            tri.EdgeStepsY[e] = dx * SUBPIXELS;
+            tri.EdgeOrigins[e] = int64_t{-dy} * (SUBPIXELS / 2 - a.X) +
+                int64_t{dx} * (SUBPIXELS / 2 - a.Y) - (isTopLeft ? 0 : 1);
+        }
+
+        // Planes through the snapped positions, relative to the first vertex to keep precision.
+        tri.OriginX = static_cast<float>(v[0]->X) / SUBPIXELS;
+        tri.OriginY = static_cast<float>(v[0]->Y) / SUBPIXELS;
+
+        float dx1 = static_cast<float>(v[1]->X) / SUBPIXELS - tri.OriginX;
+        float dy1 = static_cast<float>(v[1]->Y) / SUBPIXELS - tri.OriginY;
+        float dx2 = static_cast<float>(v[2]->X) / SUBPIXELS - tri.OriginX;
+        float dy2 = static_cast<float>(v[2]->Y) / SUBPIXELS - tri.OriginY;
+
+        float invArea = 1.f / (dx1 * dy2 - dx2 * dy1);
+
+        auto setPlane = [&](float a0, float a1, float a2, float (&plane)[3]) {
+            float da1 = a1 - a0;
+            float da2 = a2 - a0;
+
+            plane[0] = a0;
+            plane[1] = (da1 * dy2 - da2 * dy1) * invArea;
+            plane[2] = (da2 * dx1 - da1 * dx2) * invArea;
+        };
+
+        setPlane(v[0]->Depth, v[1]->Depth, v[2]->Depth, tri.Depth);
+        setPlane(v[0]->InvW, v[1]->InvW, v[2]->InvW, tri.InvW);
+        setPlane(v[0]->UOverW, v[1]->UOverW, v[2]->UOverW, tri.UOverW);
+        setPlane(v[0]->VOverW, v[1]->VOverW, v[2]->VOverW, tri.VOverW);
+
+        tri.MaterialIdx = materialIdx;
+        tri.TextureId = range.TextureId;
+
+        auto triangleIdx = static_cast<uint32_t>(state->Triangles.size());
+        state->Triangles.push_back(tri);
+        ++state->NumRasterized;
+
+        int32_t tileX0 = tri.MinX / TILE_SIZE;
+        int32_t tileX1 = (tri.MaxX - 1) / TILE_SIZE;
+        int32_t tileY0 = tri.MinY / TILE_SIZE;
+        int32_t tileY1 = (tri.MaxY - 1) / TILE_SIZE;
+
+        for (int32_t tileY = tileY0; tileY <= tileY1; ++tileY)
+        {
+            for (int32_t tileX = tileX0; tileX <= tileX1; ++tileX)
+            {
+                size_t tileIdx = static_cast<size_t>(tileY) * m_numTilesX +
+                    static_cast<size_t>(tileX);
+
+                state->Bins[tileIdx].push_back({rangeIdx, triangleIdx});
+                ++state->NumBinned;
+            }
+        }
+    }
+}
+
+void SoftwareRenderer::RasterizeTile(uint32_t tileIdx, ThreadState* state)
+{
+    auto tileX = static_cast<int32_t>(tileIdx % m_numTilesX);
+    auto tileY = static_cast<int32_t>(tileIdx / m_numTilesX);
+
+    size_t x0 = static_cast<size_t>(tileX) * TILE_SIZE;
+    size_t y0 = static_cast<size_t>(tileY) * TILE_SIZE;
+    size_t y1 = std::min(y0 + TILE_SIZE, size_t{m_height});
+
+    for (size_t y = y0; y < y1; ++y)
+    {
+        std::fill_n(m_color.data() + y * m_stride + x0, TILE_SIZE, CLEAR_COLOR);
+        std::fill_n(m_depth.data() + y * m_stride + x0, TILE_SIZE, CLEAR_DEPTH);
+    }
+
+    // Merges the threads' bins back into submission order. Each range was set up by one thread,
+    // so its triangles are consecutive in that thread's bin.
+    std::vector<size_t>& cursors = state->Cursors;
+    std::fill(cursors.begin(), cursors.end(), 0);
+
+    for (;;)
+    {
+        size_t nextThread = m_threadStates.size();
+        uint32_t nextRange = UINT32_MAX;
+
+        for (size_t t = 0; t < m_threadStates.size(); ++t)
+        {
+            const std::vector<BinEntry>& bin = m_threadStates[t].Bins[tileIdx];
+
+            if (cursors[t] < bin.size() && bin[cursors[t]].RangeIdx < nextRange)
+            {
+                nextThread = t;
+                nextRange = bin[cursors[t]].RangeIdx;
+            }
+        }
+
+        if (nextThread == m_threadStates.size())
+            break;
+
+        const ThreadState& binner = m_threadStates[nextThread];
+        const std::vector<BinEntry>& bin = binner.Bins[tileIdx];
+        size_t& cursor = cursors[nextThread];
+
+        for (; cursor < bin.size() && bin[cursor].RangeIdx == nextRange; ++cursor)
+            RasterizeTriangle(binner.Triangles[bin[cursor].TriangleIdx], tileX, tileY, state);
+    }
+}
+
+void SoftwareRenderer::RasterizeTriangle(const Triangle& tri, int32_t tileX, int32_t tileY,
+                                         ThreadState* state)
+{
+    int32_t minX = std::max(tri.MinX, tileX * TILE_SIZE);
+    int32_t minY = std::max(tri.MinY, tileY * TILE_SIZE);
+    int32_t maxX = std::min(tri.MaxX, (tileX + 1) * TILE_SIZE);
+    int32_t maxY = std::min(tri.MaxY, (tileY + 1) * TILE_SIZE);
+
+    if (minX >= maxX || minY >= maxY)
+        return;
+
+    // Aligned spans stay within the tile, which owns the padding past the right of the image.
+    int32_t spanX = minX & ~(SPAN_ALIGNMENT - 1);
+    int32_t spanEnd = (maxX + SPAN_ALIGNMENT - 1) & ~(SPAN_ALIGNMENT - 1);
+
+    int64_t rowEdges[3];
+    int32_t stepsX[3];
+    int32_t stepsY[3];
+
+    for (int e = 0; e < 3; ++e)
+    {
+        int64_t corner = tri.EdgeOrigins[e] + int64_t{tri.EdgeStepsX[e]} * spanX +
+            int64_t{tri.EdgeStepsY[e]} * minY;
+
+        int64_t acrossX = int64_t{tri.EdgeStepsX[e]} * (spanEnd - 1 - spanX);
+        int64_t acrossY = int64_t{tri.EdgeStepsY[e]} * (maxY - 1 - minY);
+
+        int64_t lowest = corner + std::min<int64_t>(acrossX, 0) + std::min<int64_t>(acrossY, 0);
+        int64_t highest = corner + std::max<int64_t>(acrossX, 0) + std::max<int64_t>(acrossY, 0);
+
+        // The edge misses the rectangle entirely, or covers all of it and need not be tested.
+        if (highest < 0)
+            return;
+
+        if (lowest >= 0)
+        {
+            rowEdges[e] = 0;
+            stepsX[e] = 0;
+            stepsY[e] = 0;
+        }
+        else
+        {
+            rowEdges[e] = corner;
+            stepsX[e] = tri.EdgeStepsX[e];
+            stepsY[e] = tri.EdgeStepsY[e];
+        }
+    }
+
+    const SoftwareTexture* texture = nullptr;
+
+    if (tri.TextureId < m_textures.size() && !m_textures[tri.TextureId].Texels.empty())
+        texture = &m_textures[tri.TextureId];
+
+    glm::vec4 factor = tri.MaterialIdx < m_materials.size() ?
+        m_materials[tri.MaterialIdx].BaseColorFactor : glm::vec4(1.f);
+
+    // What ShadePixel() returns for a white texel.
+    uint32_t untexturedColor = PackColor(factor);
+
+    SpanParams params;
+    params.X = spanX;
+    params.Count = spanEnd - spanX;
+    params.MinX = minX;
+    params.MaxX = maxX;
+    params.DepthDx = tri.Depth[1];
+    params.OriginX = tri.OriginX;
+
+    for (int e = 0; e < 3; ++e)
+        params.Steps[e] = stepsX[e];
+
+    for (int32_t y = minY; y < maxY; ++y)
+    {
+        // Within 32 bits, since the edge crosses the rectangle.
+        for (int e = 0; e < 3; ++e)
+            params.Edges[e] = static_cast<int32_t>(rowEdges[e] + int64_t{stepsY[e]} * (y - minY));
+
+        float py = static_cast<float>(y) + 0.5f;
+        params.DepthRow = tri.Depth[0] + tri.Depth[2] * (py - tri.OriginY);
+
+        size_t rowOffset = static_cast<size_t>(y) * m_stride;
+
+        uint64_t mask = m_rasterSpan(params, m_depth.data() + rowOffset);
+
+        state->NumPixelsShaded += static_cast<uint64_t>(std::popcount(mask));
+
+        while (mask)
+        {
+            int32_t x = spanX + std::countr_zero(mask);
+            mask &= mask - 1;
+
+            m_color[rowOffset + static_cast<size_t>(x)] = texture ?
+                ShadePixel(tri, *texture, factor, x, y) : untexturedColor;
+        }
+    }
+}
+
+uint32_t SoftwareRenderer::ShadePixel(const Triangle& tri, const SoftwareTexture& texture,
+                                      const glm::vec4& factor, int32_t x, int32_t y) const
+{
+    float dx = static_cast<float>(x) + 0.5f - tri.OriginX;
+    float dy = static_cast<float>(y) + 0.5f - tri.OriginY;
+
+    // Perspective-correct texture coordinates.
+    float w = 1.f / EvaluatePlane(tri.InvW, dx, dy);
+    float u = EvaluatePlane(tri.UOverW, dx, dy) * w;
+    float v = EvaluatePlane(tri.VOverW, dx, dy) * w;
+
+    // PSMain: the texture's color with an alpha of one, times the material's base color factor.
+    return PackColor(glm::vec4(glm::vec3(SampleTexture(texture, u, v)), 1.f) * factor);
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "FramePacket.h"
+#include "JobSystem.h"
+#include "MaterialTable.h"
+#include "ModelData.h"
+#include "PixelKernels.h"
+#include "RenderThread.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Vertex and index data of one geometry, the attributes the app's shaders use.
+struct SoftwareGeometry
+{
+    std::vector<glm::vec3> Positions;
+
+    // Empty for geometry without texture coordinates, which then reads zero.
+    std::vector<glm::vec2> TexCoords;
+
+    std::vector<uint32_t> Indices;
+};
+
+// Copies a primitive's positions, texture coordinates and indices out of |model|'s buffers.
+SoftwareGeometry ReadSoftwareGeometry(const ModelData& model, const PrimitiveData& prim);
+
+// RGBA8 texels, rows tightly packed, with a single mip.
+struct SoftwareTexture
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+
+    std::vector<uint32_t> Texels;
+};
+
+// Draws frame packets on the CPU, as a reference for the D3D12 backend that needs no GPU. Follows
+// the app's pipeline state and shaders: the vertex shader's transform, clockwise front faces with
+// back faces culled, a Less depth test with depth writes, and PSMain's base color - the texture
+// sampled bilinearly with wrapping, times the material's factor. Coverage follows the D3D rules:
+// pixel centers, 1/16 pixel vertex snapping and the top-left fill rule.
+//
+// Triangles are clipped, set up and binned into tiles in parallel over ranges of the draws. Tiles
+// are then rasterized in parallel, each drawing its triangles in submission order, so the image
+// does not depend on the number of threads. The coverage and depth test runs a row of a tile at a
+// time in SIMD, and every level produces the same image.
+class SoftwareRenderer : public RenderBackend
+{
+public:
+    static constexpr int32_t TILE_SIZE = 64;
+
+    // Largest width and height. Keeps edge functions within 32 bits inside a tile.
+    static constexpr uint32_t MAX_SIZE = 4096;
+
+    // Uses the fastest kernels the CPU supports unless |level| is given.
+    SoftwareRenderer(JobSystem* jobSystem, uint32_t width, uint32_t height);
+    SoftwareRenderer(JobSystem* jobSystem, uint32_t width, uint32_t height, SimdLevel level);
+
+    // Returns the geometry's index, which SetGeometry commands refer to. Geometry is numbered in
+    // the order it is added.
+    uint32_t AddGeometry(SoftwareGeometry geometry);
+
+    // Sets the texture SetBaseColorTexture commands refer to as |id|. Draws with a texture that
+    // was never set sample white, as the app's placeholder does.
+    void SetTexture(TextureId id, SoftwareTexture texture);
+
+    // The records instances' MaterialIdx index into. Only BaseColorFactor is used.
+    void SetMaterials(std::span<const MaterialRecord> records);
+
+    // Clears to opaque black and far depth, as the app does, then draws the packet. Returns once
+    // the image is complete.
+    void RenderFrame(const FramePacket& packet) override;
+
+    uint32_t GetWidth() const;
+    uint32_t GetHeight() const;
+
+    // RGBA8 pixels of the last frame, rows GetRowPitch() bytes apart.
+    const uint8_t* GetPixels() const;
+    size_t GetRowPitch() const;
+
+    SimdLevel GetSimdLevel() const;
+
+    struct Stats
+    {
+        // Triangles drawn by the commands, counting every instance.
+        uint64_t NumTriangles = 0;
+
+        // Triangles left after culling and clipping, which may split them.
+        uint64_t NumRasterized = 0;
+
+        // Triangle-tile pairs.
+        uint64_t NumBinned = 0;
+
+        // Pixels that passed the depth test.
+        uint64_t NumPixelsShaded = 0;
+
+        double SetupMs = 0.0;
+        double RasterMs = 0.0;
+    };
+
+    // Of the last frame.
+    const Stats& GetStats() const;
+
+    // Tests the pixels [X, X + Count) of one row against a triangle's edges and the depth buffer.
+    // X and Count are multiples of 8. Pixels outside [MinX, MaxX) are not touched.
+    struct SpanParams
+    {
+        // Edge functions at pixel X, and their steps per pixel. A pixel is inside where all three
+        // are non-negative.
+        int32_t Edges[3];
+        int32_t Steps[3];
+
+        int32_t X;
+        int32_t Count;
+        int32_t MinX;
+        int32_t MaxX;
+
+        // Depth at pixel center px is DepthDx * (px - OriginX) + DepthRow.
+        float DepthDx;
+        float DepthRow;
+        float OriginX;
+    };
+
+    // Writes the depth of each pixel that passes and returns those pixels, bit i for X + i.
+    using RasterSpanFn = uint64_t (*)(const SpanParams& params, float* depthRow);
+
+private:
+    // A triangle after clipping and setup, in screen space.
+    struct Triangle
+    {
+        // Edge function at pixel (x, y): EdgeStepsX * x + EdgeStepsY * y + EdgeOrigins, in
+        // squared 1/16 pixels, with the fill rule's bias applied.
+        int64_t EdgeOrigins[3];
+        int32_t EdgeStepsX[3];
+        int32_t EdgeStepsY[3];
+
+        // Pixels that may be covered, [MinX, MaxX) x [MinY, MaxY), within the image.
+        int32_t MinX;
+        int32_t MinY;
+        int32_t MaxX;
+        int32_t MaxY;
+
+        // Attribute planes, as the value at the first vertex and the steps along x and y from it.
+        float OriginX;
+        float OriginY;
+
+        float Depth[3];
+        float InvW[3];
+        float UOverW[3];
+        float VOverW[3];
+
+        uint32_t MaterialIdx;
+        uint32_t TextureId;
+    };
+
+    // A triangle binned into a tile, by the range it came from and its index in the binning
+    // thread's triangles.
+    struct BinEntry
+    {
+        uint32_t RangeIdx;
+        uint32_t TriangleIdx;
+    };
+
+    // Triangles of one instance of one draw, set up by a single job.
+    struct DrawRange
+    {
+        uint32_t GeometryIdx;
+        uint32_t InstanceIdx;
+        uint32_t TextureId;
+        uint32_t FirstTriangle;
+        uint32_t NumTriangles;
+    };
+
+    struct alignas(64) ThreadState
+    {
+        std::vector<Triangle> Triangles;
+
+        // Per tile, in the order the thread set them up.
+        std::vector<std::vector<BinEntry>> Bins;
+
+        // Read positions in the threads' bins while merging them.
+        std::vector<size_t> Cursors;
+
+        uint64_t NumRasterized = 0;
+        uint64_t NumBinned = 0;
+        uint64_t NumPixelsShaded = 0;
+    };
+
+    // State of the calling thread. Foreign threads share the last one.
+    ThreadState& GetThreadState();
+
+    void BuildRanges(const FramePacket& packet);
+
+    void SetupRange(const FramePacket& packet, uint32_t rangeIdx, ThreadState* state);
+
+    // Appends the triangle if it survives culling and bins it.
+    void AddTriangle(const glm::vec4 (&positions)[3], const glm::vec2 (&texCoords)[3],
+                     const DrawRange& range, uint32_t materialIdx, uint32_t rangeIdx,
+                     ThreadState* state);
+
+    void RasterizeTile(uint32_t tileIdx, ThreadState* state);
+
+    void RasterizeTriangle(const Triangle& tri, int32_t tileX, int32_t tileY,
+                           ThreadState* state);
+
+    // PSMain for a textured triangle. Untextured ones sample white, a color that is the same for
+    // every pixel.
+    uint32_t ShadePixel(const Triangle& tri, const SoftwareTexture& texture,
+                        const glm::vec4& factor, int32_t x, int32_t y) const;
+
+    JobSystem* m_jobSystem;
+    SimdLevel m_simdLevel;
+    RasterSpanFn m_rasterSpan;
+
+    uint32_t m_width;
+    uint32_t m_height;
+
+    uint32_t m_numTilesX;
+    uint32_t m_numTilesY;
+
+    // Rows are padded to whole tiles, which own every pixel of their columns.
+    size_t m_stride;
+
+    std::vector<uint32_t> m_color;
+    std::vector<float> m_depth;
+
+    std::vector<SoftwareGeometry> m_geometry;
+    std::vector<SoftwareTexture> m_textures;
+    std::vector<MaterialRecord> m_materials;
+
+    std::vector<DrawRange> m_ranges;
+
+    std::vector<ThreadState> m_threadStates;
+
+    Stats m_stats;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable:4324) // Structure padded due to alignment specifier.
+#endif
+
+// Fixed-capacity single-producer, single-consumer ring buffer. One thread pushes and one thread
+// pops, without locks. Each side caches the other's index so the shared cache lines are only
+// touched when the cached view says the queue is full or empty.
+template<typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity)
+        : m_mask(capacity - 1), m_items(std::make_unique<T[]>(capacity))
+    {
+        // Indices are wrapped with a mask, so the capacity must be a power of two.
+        assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+    }
+
+    // Producer thread only. Returns false if the queue is full.
+    bool TryPush(const T& item)
+    {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+
+        if (tail - m_cachedHead > m_mask)
+        {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+
+            if (tail - m_cachedHead > m_mask)
+                return false;
+        }
+
+        m_items[tail & m_mask] = item;
+
+        m_tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Consumer thread only. Returns false if the queue is empty.
+    bool TryPop(T* item)
+    {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+
+        if (head == m_cachedTail)
+        {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+
+            if (head == m_cachedTail)
+                return false;
+        }
+
+        *item = m_items[head & m_mask];
+
+        m_head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+private:
+    size_t m_mask;
+
+    std::unique_ptr<T[]> m_items;
+
+    // Consumer side.
+    alignas(64) std::atomic<uint64_t> m_head = 0;
+    uint64_t m_cachedTail = 0;
+
+    // Producer side.
+    alignas(64) std::atomic<uint64_t> m_tail = 0;
+    uint64_t m_cachedHead = 0;
+};
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
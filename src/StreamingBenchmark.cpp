@@ -0,0 +1,587 @@
+// Benchmark for progressive texture loading. Checks that the texture streamer loads by priority,
+// also when priorities change while it streams, that materials show the placeholder until each of
+// their textures is swapped in, that failed textures keep it, and that nearer and larger bounds
+// are estimated to cover more of the view. Then loads the images of a directory through a
+// ResourceRegistry, with CPU textures standing in for GPU ones, once all before the first frame
+// and once streamed while frames go by, and reports the time to the first frame, to the most
+// visible textures and to everything being loaded. Exits with an error if any check fails.
+
+#include "AssetArchive.h"
+#include "BenchmarkUtils.h"
+#include "ImageDecoder.h"
+#include "JobSystem.h"
+#include "MaterialTable.h"
+#include "ResourceRegistry.h"
+#include "TextureStreamer.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using json = nlohmann::json;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+using benchmark::ElapsedMs;
+
+struct Options
+{
+    std::string OutPath = "streaming_benchmark_results.json";
+
+    std::string ImageDir = "assets/sponza";
+
+    // Includes the main thread, which only submits frames.
+    int NumThreads = 4;
+
+    int MaxLoading = 8;
+
+    // Time between the simulated frames that update the streamer.
+    double FrameMs = 4.0;
+
+    // Fraction of the textures, by priority, that count as the most visible.
+    double VisibleFraction = 0.25;
+};
+
+constexpr const char* USAGE =
+    "Usage: StreamingBenchmark [options]\n"
+    "  --images DIR      Directory of images to load (default assets/sponza)\n"
+    "  --threads N       Job threads, including the main one, at least 2 (default 4)\n"
+    "  --max-loading N   Textures loading at once (default 8)\n"
+    "  --frame-ms MS     Time between frames (default 4)\n"
+    "  --visible F       Fraction of textures that count as most visible (default 0.25)\n"
+    "  --out FILE        Results file (default streaming_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--images")
+            options->ImageDir = value;
+        else if (arg == "--threads")
+            options->NumThreads = std::stoi(value);
+        else if (arg == "--max-loading")
+            options->MaxLoading = std::stoi(value);
+        else if (arg == "--frame-ms")
+            options->FrameMs = std::stod(value);
+        else if (arg == "--visible")
+            options->VisibleFraction = std::stod(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    // The main thread sleeps between frames, so loads need a worker of their own.
+    return options->NumThreads >= 2 && options->MaxLoading > 0 && options->FrameMs >= 0.0 &&
+        options->VisibleFraction > 0.0 && options->VisibleFraction <= 1.0;
+}
+
+// Stands in for a GPU texture. IDs count up from one, leaving zero to the placeholder.
+class CpuTexture : public RegisteredResource
+{
+public:
+    CpuTexture(TextureId id, std::vector<uint8_t> pixels)
+        : m_id(id), m_pixels(std::move(pixels))
+    {
+    }
+
+    TextureId GetId() const
+    {
+        return m_id;
+    }
+
+    uint64_t GetByteSize() const override
+    {
+        return m_pixels.size();
+    }
+
+private:
+    TextureId m_id;
+    std::vector<uint8_t> m_pixels;
+};
+
+constexpr TextureId PLACEHOLDER_ID = 0;
+
+TextureId GetTextureId(const RegisteredResource& texture)
+{
+    return static_cast<const CpuTexture&>(texture).GetId();
+}
+
+// Loads textures through a registry, recording the order the streamer asked for them in.
+class TextureLoader
+{
+public:
+    // Loads take |loadUs| each. Paths named "missing" fail.
+    TextureLoader(ResourceRegistry* registry, int loadUs)
+        : m_registry(registry), m_loadUs(loadUs)
+    {
+    }
+
+    ResourceHandle Load(const fs::path& path)
+    {
+        m_order.push_back(path.generic_string());
+
+        TextureId id = m_nextId++;
+        int loadUs = m_loadUs;
+        bool decode = m_decode;
+
+        return m_registry->Request(MakeResourceKey(ResourceKind::Texture, path),
+                                   [=]() -> std::unique_ptr<RegisteredResource> {
+            if (path.filename() == "missing")
+                throw std::runtime_error("Missing texture.");
+
+            std::vector<uint8_t> pixels;
+
+            if (decode)
+                pixels = DecodeImageFile(path);
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(loadUs));
+
+            return std::make_unique<CpuTexture>(id, std::move(pixels));
+        });
+    }
+
+    // Loads decode the image files rather than sleeping.
+    void SetDecode(bool decode)
+    {
+        m_decode = decode;
+    }
+
+    const std::vector<std::string>& GetOrder() const
+    {
+        return m_order;
+    }
+
+private:
+    static std::vector<uint8_t> DecodeImageFile(const fs::path& path)
+    {
+        std::vector<std::byte> data = ReadAssetFile(path, nullptr);
+        std::unique_ptr<ImageDecoder> decoder = CreateImageDecoder(data);
+
+        size_t rowPitch = size_t{decoder->GetWidth()} * 4;
+        std::vector<uint8_t> pixels(rowPitch * decoder->GetHeight());
+
+        decoder->Decode(pixels.data(), rowPitch);
+
+        return pixels;
+    }
+
+    ResourceRegistry* m_registry;
+    int m_loadUs;
+    bool m_decode = false;
+
+    TextureId m_nextId = PLACEHOLDER_ID + 1;
+    std::vector<std::string> m_order;
+};
+
+TextureStreamer MakeStreamer(TextureLoader* loader, size_t maxLoading)
+{
+    return TextureStreamer([loader](const fs::path& path) { return loader->Load(path); },
+                           GetTextureId, PLACEHOLDER_ID, maxLoading);
+}
+
+// Updates until everything has loaded, as frames would.
+void StreamAll(TextureStreamer* streamer, MaterialTable* table)
+{
+    while (!streamer->IsDone())
+    {
+        streamer->Update(table);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+// One at a time, streams load by priority, ties in the order they were added.
+bool CheckPriorityOrder(JobSystem* jobSystem)
+{
+    ResourceRegistry registry(jobSystem);
+    TextureLoader loader(&registry, 100);
+    TextureStreamer streamer = MakeStreamer(&loader, 1);
+    MaterialTable table;
+
+    const float priorities[] = {0.1f, 0.5f, 0.f, 0.5f, 1.f, 0.2f};
+
+    for (int i = 0; i < 6; ++i)
+    {
+        streamer.SetPriority(streamer.Add("t" + std::to_string(i)), priorities[i]);
+    }
+
+    StreamAll(&streamer, &table);
+
+    std::vector<std::string> expected = {"t4", "t1", "t3", "t5", "t0", "t2"};
+
+    return loader.GetOrder() == expected && streamer.GetStats().NumLoaded == 6;
+}
+
+// Priorities changed after loading started decide the order of what is still queued.
+bool CheckReprioritized(JobSystem* jobSystem)
+{
+    ResourceRegistry registry(jobSystem);
+    TextureLoader loader(&registry, 100);
+    TextureStreamer streamer = MakeStreamer(&loader, 1);
+    MaterialTable table;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        streamer.SetPriority(streamer.Add("t" + std::to_string(i)), static_cast<float>(i));
+    }
+
+    streamer.Update(&table);
+
+    // The camera turned: t0 is now the most visible, t2 the least.
+    streamer.SetPriority(0, 5.f);
+    streamer.SetPriority(2, -1.f);
+
+    StreamAll(&streamer, &table);
+
+    std::vector<std::string> expected = {"t3", "t0", "t1", "t2"};
+
+    return loader.GetOrder() == expected;
+}
+
+// Materials show the placeholder until their textures load, then each texture in its own slot,
+// keeping edits made meanwhile. Materials that only differ in streamed textures are not shared.
+// Materials without a base color texture keep the placeholder for it.
+bool CheckPlaceholderSwap(JobSystem* jobSystem)
+{
+    ResourceRegistry registry(jobSystem);
+    TextureLoader loader(&registry, 100);
+    TextureStreamer streamer = MakeStreamer(&loader, 4);
+    MaterialTable table;
+
+    auto baseColor = static_cast<TextureId>(streamer.Add("base.png"));
+    auto normal = static_cast<TextureId>(streamer.Add("normal.png"));
+    auto other = static_cast<TextureId>(streamer.Add("other.png"));
+
+    Material a{};
+    a.BaseColorFactor = glm::vec4(1.f);
+    a.BaseColorTextureId = baseColor;
+    a.NormalTextureId = normal;
+
+    Material b = a;
+    b.BaseColorTextureId = other;
+
+    Material untextured{};
+    untextured.NormalTextureId = normal;
+
+    uint32_t aIdx = streamer.AddMaterial(&table, a);
+    uint32_t bIdx = streamer.AddMaterial(&table, b);
+    uint32_t untexturedIdx = streamer.AddMaterial(&table, untextured);
+
+    const Material& aPending = table.Get(aIdx);
+
+    bool placeholders = aIdx != bIdx && aPending.BaseColorTextureId == PLACEHOLDER_ID &&
+        aPending.NormalTextureId == PLACEHOLDER_ID && aPending.RoughnessTextureId == -1;
+
+    // Not shared with a material added later that matches the placeholder version either.
+    Material pending = table.Get(aIdx);
+    bool unshared = table.Add(pending) != aIdx;
+
+    Material edited = table.Get(aIdx);
+    edited.MetallicFactor = 0.25f;
+    table.Set(aIdx, edited);
+
+    StreamAll(&streamer, &table);
+
+    const Material& aLoaded = table.Get(aIdx);
+    const Material& bLoaded = table.Get(bIdx);
+
+    // IDs follow load order, so they are all distinct and none is the placeholder.
+    bool swapped = aLoaded.BaseColorTextureId > PLACEHOLDER_ID &&
+        aLoaded.NormalTextureId > PLACEHOLDER_ID &&
+        aLoaded.BaseColorTextureId != aLoaded.NormalTextureId &&
+        bLoaded.BaseColorTextureId > PLACEHOLDER_ID &&
+        bLoaded.BaseColorTextureId != aLoaded.BaseColorTextureId &&
+        bLoaded.NormalTextureId == aLoaded.NormalTextureId && aLoaded.RoughnessTextureId == -1;
+
+    bool editKept = aLoaded.MetallicFactor == 0.25f;
+
+    const Material& untexturedLoaded = table.Get(untexturedIdx);
+
+    bool untexturedKeepsPlaceholder = untexturedLoaded.BaseColorTextureId == PLACEHOLDER_ID &&
+        untexturedLoaded.NormalTextureId == aLoaded.NormalTextureId &&
+        untexturedLoaded.RoughnessTextureId == -1;
+
+    // Adding a material whose streams have loaded uses their textures straight away.
+    uint32_t cIdx = streamer.AddMaterial(&table, a);
+    bool loadedUsed = table.Get(cIdx).BaseColorTextureId == aLoaded.BaseColorTextureId;
+
+    return placeholders && unshared && swapped && editKept && untexturedKeepsPlaceholder &&
+        loadedUsed && streamer.Add("base.png") == static_cast<uint32_t>(baseColor) &&
+        streamer.GetNumStreams() == 3;
+}
+
+// A texture that fails to load leaves its materials on the placeholder.
+bool CheckFailedKeepsPlaceholder(JobSystem* jobSystem)
+{
+    ResourceRegistry registry(jobSystem);
+    TextureLoader loader(&registry, 100);
+    TextureStreamer streamer = MakeStreamer(&loader, 2);
+    MaterialTable table;
+
+    Material material{};
+    material.BaseColorTextureId = static_cast<TextureId>(streamer.Add("textures/missing"));
+    material.NormalTextureId = static_cast<TextureId>(streamer.Add("textures/normal.png"));
+
+    uint32_t idx = streamer.AddMaterial(&table, material);
+
+    StreamAll(&streamer, &table);
+
+    TextureStreamer::Stats stats = streamer.GetStats();
+
+    return stats.NumFailed == 1 && stats.NumLoaded == 1 && stats.NumQueued == 0 &&
+        table.Get(idx).BaseColorTextureId == PLACEHOLDER_ID &&
+        table.Get(idx).NormalTextureId > PLACEHOLDER_ID;
+}
+
+bool CheckCoverage()
+{
+    glm::vec3 boundsMin(-1.f);
+    glm::vec3 boundsMax(1.f);
+    glm::mat4 identity(1.f);
+    glm::vec3 eye(0.f, 0.f, -10.f);
+
+    float coverage = EstimateScreenCoverage(boundsMin, boundsMax, identity, eye);
+    float farther = EstimateScreenCoverage(boundsMin, boundsMax, identity, eye * 2.f);
+    float larger = EstimateScreenCoverage(boundsMin * 2.f, boundsMax * 2.f, identity, eye);
+    float scaled = EstimateScreenCoverage(boundsMin, boundsMax,
+                                          glm::scale(identity, glm::vec3(2.f)), eye);
+    float moved = EstimateScreenCoverage(boundsMin, boundsMax,
+                                         glm::translate(identity, glm::vec3(0.f, 0.f, -9.f)),
+                                         eye);
+    float inside = EstimateScreenCoverage(boundsMin, boundsMax, identity, glm::vec3(0.5f));
+
+    return coverage > 0.f && farther < coverage && larger > coverage &&
+        std::abs(scaled - larger) < 1e-6f && moved > coverage && inside == 1.f;
+}
+
+std::vector<fs::path> FindImages(const fs::path& dir)
+{
+    std::vector<fs::path> images;
+
+    if (!fs::is_directory(dir))
+        return images;
+
+    for (const fs::directory_entry& entry : fs::directory_iterator(dir))
+    {
+        std::string extension = entry.path().extension().string();
+
+        if (extension == ".jpg" || extension == ".png")
+            images.push_back(entry.path());
+    }
+
+    std::sort(images.begin(), images.end());
+
+    return images;
+}
+
+struct LoadTimes
+{
+    double FirstFrameMs = 0.0;
+    double VisibleMs = 0.0;
+    double LoadedMs = 0.0;
+
+    int NumFrames = 0;
+};
+
+// Loads every image and times the milestones of startup. With |stream| the first frame comes
+// right away and textures load, by priority if |prioritize|, while frames go by. Otherwise every
+// texture loads before the first frame.
+LoadTimes MeasureLoad(const Options& options, JobSystem* jobSystem,
+                      const std::vector<fs::path>& images, const std::vector<float>& priorities,
+                      bool stream, bool prioritize)
+{
+    ResourceRegistry registry(jobSystem);
+    TextureLoader loader(&registry, 0);
+    loader.SetDecode(true);
+
+    MaterialTable table;
+    LoadTimes times;
+
+    // The most visible textures are the given fraction with the highest priorities.
+    std::vector<float> sorted = priorities;
+    std::sort(sorted.begin(), sorted.end(), std::greater<float>());
+
+    auto numVisible = static_cast<size_t>(
+        std::max(1.0, options.VisibleFraction * static_cast<double>(images.size())));
+    float visibleThreshold = sorted[numVisible - 1];
+
+    Clock::time_point start = Clock::now();
+
+    if (!stream)
+    {
+        std::vector<ResourceHandle> handles;
+
+        for (const fs::path& path : images)
+        {
+            handles.push_back(loader.Load(path));
+        }
+
+        for (const ResourceHandle& handle : handles)
+        {
+            handle.Wait();
+        }
+
+        times.FirstFrameMs = ElapsedMs(start);
+        times.VisibleMs = times.FirstFrameMs;
+        times.LoadedMs = times.FirstFrameMs;
+        times.NumFrames = 1;
+
+        return times;
+    }
+
+    TextureStreamer streamer = MakeStreamer(&loader, static_cast<size_t>(options.MaxLoading));
+    std::vector<uint32_t> visibleMaterials;
+
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        uint32_t streamIdx = streamer.Add(images[i]);
+
+        if (prioritize)
+            streamer.SetPriority(streamIdx, priorities[i]);
+
+        Material material{};
+        material.BaseColorTextureId = static_cast<TextureId>(streamIdx);
+
+        uint32_t materialIdx = streamer.AddMaterial(&table, material);
+
+        if (priorities[i] >= visibleThreshold)
+            visibleMaterials.push_back(materialIdx);
+    }
+
+    auto frameInterval = std::chrono::duration<double, std::milli>(options.FrameMs);
+    bool visibleLoaded = false;
+
+    for (;;)
+    {
+        streamer.Update(&table);
+
+        // Everything is published before the first update returns, so that frame can draw.
+        if (times.NumFrames++ == 0)
+            times.FirstFrameMs = ElapsedMs(start);
+
+        if (!visibleLoaded)
+        {
+            visibleLoaded = std::all_of(visibleMaterials.begin(), visibleMaterials.end(),
+                                        [&](uint32_t idx) {
+                                            return table.Get(idx).BaseColorTextureId !=
+                                                PLACEHOLDER_ID;
+                                        });
+
+            if (visibleLoaded)
+                times.VisibleMs = ElapsedMs(start);
+        }
+
+        if (streamer.IsDone())
+            break;
+
+        std::this_thread::sleep_for(frameInterval);
+    }
+
+    times.LoadedMs = ElapsedMs(start);
+
+    return times;
+}
+
+json ToJson(const LoadTimes& times)
+{
+    return {
+        {"first_frame_ms", times.FirstFrameMs},
+        {"visible_loaded_ms", times.VisibleMs},
+        {"fully_loaded_ms", times.LoadedMs},
+        {"frames", times.NumFrames}
+    };
+}
+
+int RunBenchmark(const Options& options)
+{
+    Checks checks;
+    JobSystem jobSystem(options.NumThreads);
+
+    checks.Check("priority_order", CheckPriorityOrder(&jobSystem));
+    checks.Check("reprioritized", CheckReprioritized(&jobSystem));
+    checks.Check("placeholder_swap", CheckPlaceholderSwap(&jobSystem));
+    checks.Check("failed_keeps_placeholder", CheckFailedKeepsPlaceholder(&jobSystem));
+    checks.Check("coverage", CheckCoverage());
+
+    std::vector<fs::path> images = FindImages(options.ImageDir);
+    json loads = json::object();
+
+    if (images.empty())
+    {
+        std::printf("Skipping the load, as %s has no images.\n", options.ImageDir.c_str());
+    }
+    else
+    {
+        // Stand-ins for screen coverage, which in the app comes from the camera.
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> coverage(0.f, 1.f);
+        std::vector<float> priorities(images.size());
+
+        for (float& priority : priorities)
+        {
+            priority = coverage(rng);
+        }
+
+        LoadTimes blocking = MeasureLoad(options, &jobSystem, images, priorities, false, false);
+        LoadTimes unordered = MeasureLoad(options, &jobSystem, images, priorities, true, false);
+        LoadTimes prioritized = MeasureLoad(options, &jobSystem, images, priorities, true, true);
+
+        loads = {
+            {"images", images.size()},
+            {"blocking", ToJson(blocking)},
+            {"streamed_in_order", ToJson(unordered)},
+            {"streamed_by_priority", ToJson(prioritized)}
+        };
+
+        checks.Check("first_frame_sooner", prioritized.FirstFrameMs < blocking.FirstFrameMs);
+    }
+
+    json results = {
+        {"threads", options.NumThreads},
+        {"max_loading", options.MaxLoading},
+        {"frame_ms", options.FrameMs},
+        {"loads", loads},
+        {"checks", checks.Results}
+    };
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Streaming checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
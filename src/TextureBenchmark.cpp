@@ -0,0 +1,562 @@
+// Benchmark for texture deduplication. Loads every image in a directory once per model through a
+// ResourceRegistry keyed the way GpuResourceManager keys textures - by path, then by file contents,
+// then by decoded pixels - with CPU textures standing in for GPU ones, and reports what sharing
+// saves. Also measures content hashing throughput. Checks that the hash matches xxHash64, that
+// shared textures hold exactly each image's pixels and that nothing identical is loaded twice,
+// and exits with an error if any check fails.
+
+#include "BenchmarkUtils.h"
+#include "Hash.h"
+#include "ImageDecoder.h"
+#include "JobSystem.h"
+#include "ResourceRegistry.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+using benchmark::Checks;
+using benchmark::Clock;
+
+struct Options
+{
+    std::string OutPath = "texture_benchmark_results.json";
+
+    std::string ImageDir = "assets/sponza";
+
+    // Models that each load every image, so that textures are shared across models as well.
+    int NumModels = 2;
+
+    int NumIterations = 5;
+    int NumThreads = 0;
+};
+
+constexpr const char* USAGE =
+    "Usage: TextureBenchmark [options]\n"
+    "  --dir DIR           Directory of .jpg and .png files (default assets/sponza)\n"
+    "  --models N          Models loading every image (default 2)\n"
+    "  --iterations N      Timed hashing runs, the fastest is reported (default 5)\n"
+    "  --threads N         Job system threads, 0 for one per core (default 0)\n"
+    "  --out FILE          Results file (default texture_benchmark_results.json)\n";
+
+bool ParseOptions(int argc, char** argv, Options* options)
+{
+    auto parseOption = [options](const std::string& arg, const std::string& value) {
+        if (arg == "--dir")
+            options->ImageDir = value;
+        else if (arg == "--models")
+            options->NumModels = std::stoi(value);
+        else if (arg == "--iterations")
+            options->NumIterations = std::stoi(value);
+        else if (arg == "--threads")
+            options->NumThreads = std::stoi(value);
+        else if (arg == "--out")
+            options->OutPath = value;
+        else
+            return false;
+
+        return true;
+    };
+
+    if (!benchmark::ParseArgs(argc, argv, parseOption))
+        return false;
+
+    return options->NumModels > 0 && options->NumIterations > 0 && options->NumThreads >= 0;
+}
+
+double ElapsedSec(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::vector<std::byte> ReadFile(const fs::path& path)
+{
+    std::ifstream strm(path, std::ios::binary);
+
+    if (!strm)
+        throw std::runtime_error("Could not open file.");
+
+    std::vector<std::byte> data(fs::file_size(path));
+    strm.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+    return data;
+}
+
+std::vector<fs::path> FindImages(const std::string& dir)
+{
+    std::vector<fs::path> paths;
+
+    for (const fs::directory_entry& entry : fs::directory_iterator(dir))
+    {
+        fs::path extension = entry.path().extension();
+
+        if (extension == ".jpg" || extension == ".png")
+            paths.push_back(entry.path());
+    }
+
+    std::sort(paths.begin(), paths.end());
+
+    return paths;
+}
+
+struct Image
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    std::vector<std::byte> Pixels;
+};
+
+Image DecodeImage(std::span<const std::byte> data)
+{
+    std::unique_ptr<ImageDecoder> decoder = CreateImageDecoder(data);
+
+    Image image;
+    image.Width = decoder->GetWidth();
+    image.Height = decoder->GetHeight();
+    image.Pixels.resize(size_t{image.Width} * image.Height * 4);
+
+    decoder->Decode(reinterpret_cast<uint8_t*>(image.Pixels.data()), size_t{image.Width} * 4);
+
+    return image;
+}
+
+// Stands in for GpuTexture.
+class CpuTexture : public RegisteredResource
+{
+public:
+    explicit CpuTexture(Image image) : m_image(std::move(image)) {}
+
+    const Image& GetImage() const
+    {
+        return m_image;
+    }
+
+    uint64_t GetByteSize() const override
+    {
+        return m_image.Pixels.size();
+    }
+
+private:
+    Image m_image;
+};
+
+// Stands in for GpuTextureRef.
+class CpuTextureRef : public RegisteredResource
+{
+public:
+    CpuTextureRef(ResourceHandle texture, const CpuTexture* target)
+        : m_texture(std::move(texture)), m_target(target)
+    {
+    }
+
+    const CpuTexture* GetTarget() const
+    {
+        return m_target;
+    }
+
+    uint64_t GetByteSize() const override
+    {
+        return 0;
+    }
+
+private:
+    ResourceHandle m_texture;
+    const CpuTexture* m_target;
+};
+
+// The loading side of GpuResourceManager, with uploads replaced by keeping the pixels.
+class TextureLoader
+{
+public:
+    explicit TextureLoader(JobSystem* jobSystem) : m_registry(jobSystem) {}
+
+    ResourceHandle LoadTexture(const fs::path& path)
+    {
+        uint64_t key = MakeResourceKey(ResourceKind::Texture, path);
+
+        return m_registry.Request(key, [this, path]() -> std::unique_ptr<RegisteredResource> {
+            std::vector<std::byte> data = ReadFile(path);
+
+            uint64_t fileKey = MakeResourceKey(ResourceKind::TextureFile, data);
+
+            auto load = [this, data = std::move(data)]() -> std::unique_ptr<RegisteredResource> {
+                return LoadTextureFile(data);
+            };
+
+            ResourceHandle file = m_registry.Request(fileKey, std::move(load));
+            const CpuTexture* target = file.Wait<CpuTextureRef>()->GetTarget();
+
+            ++NumFilesRead;
+            ReadBytes += target->GetByteSize();
+
+            return std::make_unique<CpuTextureRef>(std::move(file), target);
+        });
+    }
+
+    ResourceRegistry::Stats GetStats() const
+    {
+        return m_registry.GetStats();
+    }
+
+    std::atomic<uint64_t> NumFilesRead = 0;
+    std::atomic<uint64_t> NumDecoded = 0;
+    std::atomic<uint64_t> NumUploaded = 0;
+    std::atomic<uint64_t> ReadBytes = 0;
+    std::atomic<uint64_t> UploadedBytes = 0;
+
+private:
+    std::unique_ptr<CpuTextureRef> LoadTextureFile(std::span<const std::byte> data)
+    {
+        Image image = DecodeImage(data);
+
+        ++NumDecoded;
+
+        uint64_t key = MakeTextureKey(image.Width, image.Height, image.Pixels);
+
+        auto load = [this, image = std::move(image)]() -> std::unique_ptr<RegisteredResource> {
+            ++NumUploaded;
+            UploadedBytes += image.Pixels.size();
+
+            return std::make_unique<CpuTexture>(image);
+        };
+
+        ResourceHandle texture = m_registry.Request(key, std::move(load));
+        const CpuTexture* target = texture.Wait<CpuTexture>();
+
+        return std::make_unique<CpuTextureRef>(std::move(texture), target);
+    }
+
+    ResourceRegistry m_registry;
+};
+
+bool CheckKnownHashes()
+{
+    struct Vector
+    {
+        std::string_view Input;
+        uint64_t Hash;
+    };
+
+    // Published xxHash64 values for a zero seed.
+    constexpr Vector vectors[] = {
+        {"", 0xef46db3751d8e999ull},
+        {"abc", 0x44bc2cf5ad770999ull},
+        {"Nobody inspects the spammish repetition", 0xfbcea83c8a378bf1ull}
+    };
+
+    bool passed = true;
+
+    for (const Vector& vector : vectors)
+    {
+        passed = passed && HashContent(std::as_bytes(std::span(vector.Input))) == vector.Hash;
+    }
+
+    return passed;
+}
+
+// Feeding the input in random pieces gives the same hash as all at once.
+bool CheckStreamedHashes()
+{
+    std::mt19937 rng(1234);
+    bool passed = true;
+
+    for (size_t size = 0; size < 300; ++size)
+    {
+        std::vector<std::byte> data(size);
+
+        for (std::byte& value : data)
+        {
+            value = static_cast<std::byte>(rng());
+        }
+
+        ContentHasher hasher;
+        size_t offset = 0;
+
+        while (offset < size)
+        {
+            size_t pieceSize = std::min<size_t>(rng() % 40, size - offset);
+            hasher.AddBytes(data.data() + offset, pieceSize);
+            offset += pieceSize;
+        }
+
+        passed = passed && hasher.GetHash() == HashContent(data);
+    }
+
+    return passed;
+}
+
+// Keys of staged rows, which are padded out to the row pitch, must match the keys of the same
+// pixels packed together, and so of a texture loaded any other way.
+bool CheckPitchedTextureKeys()
+{
+    std::mt19937 rng(5678);
+    bool passed = true;
+
+    for (uint32_t width : {1u, 7u, 64u, 65u})
+    {
+        uint32_t height = 5;
+        size_t rowSize = size_t{width} * 4;
+        size_t rowPitch = rowSize + 256 - rowSize % 256;
+
+        std::vector<std::byte> pixels(rowSize * height);
+        std::vector<std::byte> rows(rowPitch * height);
+
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (size_t x = 0; x < rowPitch; ++x)
+            {
+                std::byte value = static_cast<std::byte>(rng());
+                rows[y * rowPitch + x] = value;
+
+                if (x < rowSize)
+                    pixels[y * rowSize + x] = value;
+            }
+        }
+
+        Hasher expected;
+        expected.Add(MakeResourceKey(ResourceKind::Texture, pixels));
+        expected.Add(width);
+        expected.Add(height);
+
+        passed = passed && MakeTextureKey(width, height, pixels) == expected.GetHash() &&
+            MakeTextureKey(width, height, rows.data(), rowPitch) == expected.GetHash();
+    }
+
+    return passed;
+}
+
+json MeasureHashing(const Options& options, const std::vector<std::vector<std::byte>>& files,
+                    JobSystem* jobSystem)
+{
+    size_t numBytes = 0;
+
+    for (const std::vector<std::byte>& file : files)
+    {
+        numBytes += file.size();
+    }
+
+    double bestSec[3] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max(),
+                         std::numeric_limits<double>::max()};
+
+    // Summed so that the hashing cannot be optimized away.
+    uint64_t sum = 0;
+
+    for (int iteration = 0; iteration < options.NumIterations; ++iteration)
+    {
+        Clock::time_point start = Clock::now();
+
+        for (const std::vector<std::byte>& file : files)
+        {
+            sum += HashBytes(file);
+        }
+
+        bestSec[0] = std::min(bestSec[0], ElapsedSec(start));
+
+        start = Clock::now();
+
+        for (const std::vector<std::byte>& file : files)
+        {
+            sum += HashContent(file);
+        }
+
+        bestSec[1] = std::min(bestSec[1], ElapsedSec(start));
+
+        std::atomic<uint64_t> parallelSum = 0;
+        start = Clock::now();
+
+        jobSystem->ParallelFor(files.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+            {
+                parallelSum += HashContent(files[i]);
+            }
+        });
+
+        bestSec[2] = std::min(bestSec[2], ElapsedSec(start));
+        sum += parallelSum;
+    }
+
+    auto gbPerSec = [&](double sec) { return static_cast<double>(numBytes) / sec / 1e9; };
+
+    return {
+        {"bytes", numBytes},
+        {"fnv1a_gb_per_sec", gbPerSec(bestSec[0])},
+        {"content_gb_per_sec", gbPerSec(bestSec[1])},
+        {"content_parallel_gb_per_sec", gbPerSec(bestSec[2])},
+        {"checksum", sum % 1000}
+    };
+}
+
+// Distinct values among |items|, by |same|.
+template<typename T, typename Fn>
+size_t CountDistinct(const std::vector<T>& items, Fn&& same)
+{
+    size_t numDistinct = 0;
+
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        bool seen = false;
+
+        for (size_t j = 0; j < i && !seen; ++j)
+        {
+            seen = same(items[i], items[j]);
+        }
+
+        numDistinct += seen ? 0 : 1;
+    }
+
+    return numDistinct;
+}
+
+int RunBenchmark(const Options& options)
+{
+    std::vector<fs::path> paths = FindImages(options.ImageDir);
+
+    if (paths.empty())
+    {
+        std::fprintf(stderr, "No images in %s.\n", options.ImageDir.c_str());
+        return 1;
+    }
+
+    JobSystem jobSystem(options.NumThreads);
+
+    Checks checks;
+    checks.Check("content_hash_vectors", CheckKnownHashes());
+    checks.Check("content_hash_streamed", CheckStreamedHashes());
+    checks.Check("pitched_texture_keys", CheckPitchedTextureKeys());
+
+    std::vector<std::vector<std::byte>> files;
+
+    for (const fs::path& path : paths)
+    {
+        files.push_back(ReadFile(path));
+    }
+
+    json hashing = MeasureHashing(options, files, &jobSystem);
+
+    // What the dedup should find, worked out by brute force.
+    std::vector<Image> images(files.size());
+
+    jobSystem.ParallelFor(files.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            images[i] = DecodeImage(files[i]);
+        }
+    });
+
+    size_t numDistinctFiles = CountDistinct(
+        files, [](const std::vector<std::byte>& a, const std::vector<std::byte>& b) {
+            return a == b;
+        });
+
+    size_t numDistinctImages = CountDistinct(images, [](const Image& a, const Image& b) {
+        return a.Width == b.Width && a.Height == b.Height && a.Pixels == b.Pixels;
+    });
+
+    // Every model requests every image up front, as LoadGltfModel does, then waits.
+    TextureLoader loader(&jobSystem);
+    std::vector<ResourceHandle> handles;
+
+    Clock::time_point start = Clock::now();
+
+    for (int model = 0; model < options.NumModels; ++model)
+    {
+        for (const fs::path& path : paths)
+        {
+            handles.push_back(loader.LoadTexture(path));
+        }
+    }
+
+    bool texturesExact = true;
+    std::vector<const CpuTexture*> textures;
+
+    for (size_t i = 0; i < handles.size(); ++i)
+    {
+        const CpuTexture* texture = handles[i].Wait<CpuTextureRef>()->GetTarget();
+        const Image& expected = images[i % images.size()];
+
+        texturesExact = texturesExact && texture->GetImage().Width == expected.Width &&
+            texture->GetImage().Height == expected.Height &&
+            texture->GetImage().Pixels == expected.Pixels;
+
+        textures.push_back(texture);
+    }
+
+    double loadMs = ElapsedSec(start) * 1e3;
+
+    size_t numTextures = CountDistinct(
+        textures, [](const CpuTexture* a, const CpuTexture* b) { return a == b; });
+
+    checks.Check("shared_textures_exact", texturesExact);
+    checks.Check("files_read_once", loader.NumFilesRead == paths.size());
+    checks.Check("file_dedup_exact", loader.NumDecoded == numDistinctFiles);
+    checks.Check("pixel_dedup_exact", loader.NumUploaded == numDistinctImages &&
+                 numTextures == numDistinctImages);
+
+    uint64_t imageBytes = 0;
+
+    for (const Image& image : images)
+    {
+        imageBytes += image.Pixels.size();
+    }
+
+    ResourceRegistry::Stats stats = loader.GetStats();
+
+    json results = {
+        {"dir", options.ImageDir},
+        {"models", options.NumModels},
+        {"images", paths.size()},
+        {"distinct_files", numDistinctFiles},
+        {"textures", numTextures},
+        {"load_ms", loadMs},
+        {"texture_bytes_unshared", imageBytes * options.NumModels},
+        {"texture_bytes_per_path", loader.ReadBytes.load()},
+        {"texture_bytes_uploaded", loader.UploadedBytes.load()},
+        {"saved_bytes_by_content", loader.ReadBytes - loader.UploadedBytes},
+        {"registry_requests", stats.NumRequests},
+        {"registry_coalesced", stats.NumCoalesced},
+        {"hashing", hashing},
+        {"checks", checks.Results}
+    };
+
+    handles.clear();
+
+    if (!benchmark::WriteResults(results, options.OutPath))
+        return 1;
+
+    std::printf("%s\n", results.dump(2).c_str());
+
+    if (!checks.AllPassed)
+    {
+        std::fprintf(stderr, "Texture checks failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return benchmark::Main<Options>(argc, argv, USAGE, ParseOptions, RunBenchmark);
+}
@@ -0,0 +1,240 @@
+#include "TextureStreamer.h"
+
+#include "MaterialTable.h"
+
+#include <algorithm>
+#include <cassert>
+#include <exception>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr int NUM_TEXTURE_SLOTS = 3;
+constexpr int BASE_COLOR_SLOT = 0;
+
+// One of a material's texture IDs, which are stream indices in streamed materials.
+TextureId* GetTextureSlot(Material* material, int slot)
+{
+    switch (slot)
+    {
+        case BASE_COLOR_SLOT:
+            return &material->BaseColorTextureId;
+        case 1:
+            return &material->RoughnessTextureId;
+        default:
+            return &material->NormalTextureId;
+    }
+}
+
+} // namespace
+
+TextureStreamer::TextureStreamer(LoadFn load, GetIdFn getId, TextureId placeholderId,
+                                 size_t maxLoading)
+    : m_load(std::move(load))
+    , m_getId(std::move(getId))
+    , m_placeholderId(placeholderId)
+    , m_maxLoading(std::max<size_t>(maxLoading, 1))
+{
+}
+
+uint32_t TextureStreamer::Add(const fs::path& path)
+{
+    auto [it, inserted] = m_streamsByKey.try_emplace(MakeResourceKey(ResourceKind::Texture, path),
+                                                     static_cast<uint32_t>(m_streams.size()));
+
+    if (inserted)
+    {
+        m_streams.emplace_back().Path = path;
+        m_queued.push_back(it->second);
+    }
+
+    return it->second;
+}
+
+uint32_t TextureStreamer::AddMaterial(MaterialTable* table, const Material& material)
+{
+    Material placeholder = material;
+    Material streams = material;
+
+    for (int slot = 0; slot < NUM_TEXTURE_SLOTS; ++slot)
+    {
+        TextureId stream = *GetTextureSlot(&streams, slot);
+
+        if (stream < 0)
+        {
+            // Every draw binds a base color texture, so materials without one keep the
+            // placeholder for good. The other slots are left without a texture.
+            if (slot == BASE_COLOR_SLOT)
+                *GetTextureSlot(&placeholder, slot) = m_placeholderId;
+
+            continue;
+        }
+
+        assert(static_cast<size_t>(stream) < m_streams.size());
+
+        Stream& streamState = m_streams[stream];
+
+        // Streams that loaded already are swapped in straight away.
+        if (streamState.State == StreamState::Loaded)
+            *GetTextureSlot(&placeholder, slot) = m_getId(*streamState.Handle.Wait());
+        else
+            *GetTextureSlot(&placeholder, slot) = m_placeholderId;
+    }
+
+    uint32_t tableIdx = table->AddUnique(placeholder);
+    auto materialIdx = static_cast<uint32_t>(m_materials.size());
+
+    m_materials.push_back({tableIdx, streams});
+
+    for (int slot = 0; slot < NUM_TEXTURE_SLOTS; ++slot)
+    {
+        TextureId stream = *GetTextureSlot(&streams, slot);
+
+        if (stream < 0)
+            continue;
+
+        std::vector<uint32_t>& materials = m_streams[stream].Materials;
+
+        if (materials.empty() || materials.back() != materialIdx)
+            materials.push_back(materialIdx);
+    }
+
+    return tableIdx;
+}
+
+void TextureStreamer::SetPriority(uint32_t stream, float priority)
+{
+    m_streams[stream].Priority = priority;
+}
+
+size_t TextureStreamer::Update(MaterialTable* table)
+{
+    size_t numChanged = 0;
+
+    for (size_t i = 0; i < m_loading.size();)
+    {
+        uint32_t streamIdx = m_loading[i];
+        Stream& stream = m_streams[streamIdx];
+
+        if (!stream.Handle.IsReady())
+        {
+            ++i;
+            continue;
+        }
+
+        m_loading[i] = m_loading.back();
+        m_loading.pop_back();
+
+        TextureId id = -1;
+
+        try
+        {
+            id = m_getId(*stream.Handle.Wait());
+        }
+        catch (const std::exception&)
+        {
+        }
+
+        if (id < 0)
+        {
+            stream.State = StreamState::Failed;
+            stream.Handle.Reset();
+            ++m_numFailed;
+            continue;
+        }
+
+        stream.State = StreamState::Loaded;
+        ++m_numLoaded;
+
+        SwapIn(table, streamIdx, id);
+        numChanged += stream.Materials.size();
+    }
+
+    if (m_loading.size() < m_maxLoading && !m_queued.empty())
+    {
+        // Stable, so that equal priorities load in the order they were added.
+        std::stable_sort(m_queued.begin(), m_queued.end(), [this](uint32_t a, uint32_t b) {
+            return m_streams[a].Priority > m_streams[b].Priority;
+        });
+
+        size_t numStarted = std::min(m_maxLoading - m_loading.size(), m_queued.size());
+
+        for (size_t i = 0; i < numStarted; ++i)
+        {
+            uint32_t streamIdx = m_queued[i];
+            Stream& stream = m_streams[streamIdx];
+
+            stream.State = StreamState::Loading;
+            stream.Handle = m_load(stream.Path);
+
+            m_loading.push_back(streamIdx);
+        }
+
+        m_queued.erase(m_queued.begin(), m_queued.begin() + static_cast<ptrdiff_t>(numStarted));
+    }
+
+    return numChanged;
+}
+
+bool TextureStreamer::IsDone() const
+{
+    return m_queued.empty() && m_loading.empty();
+}
+
+size_t TextureStreamer::GetNumStreams() const
+{
+    return m_streams.size();
+}
+
+TextureStreamer::Stats TextureStreamer::GetStats() const
+{
+    Stats stats;
+    stats.NumQueued = m_queued.size();
+    stats.NumLoading = m_loading.size();
+    stats.NumLoaded = m_numLoaded;
+    stats.NumFailed = m_numFailed;
+
+    return stats;
+}
+
+void TextureStreamer::SwapIn(MaterialTable* table, uint32_t stream, TextureId id)
+{
+    for (uint32_t materialIdx : m_streams[stream].Materials)
+    {
+        StreamedMaterial& streamed = m_materials[materialIdx];
+
+        // Starts from the table's copy, so edits made meanwhile are kept.
+        Material material = table->Get(streamed.TableIdx);
+
+        for (int slot = 0; slot < NUM_TEXTURE_SLOTS; ++slot)
+        {
+            if (*GetTextureSlot(&streamed.Streams, slot) == static_cast<TextureId>(stream))
+                *GetTextureSlot(&material, slot) = id;
+        }
+
+        table->Set(streamed.TableIdx, material);
+    }
+}
+
+float EstimateScreenCoverage(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                             const glm::mat4& worldMat, const glm::vec3& eye)
+{
+    glm::vec3 center = glm::vec3(worldMat * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.f));
+
+    float scale = std::max({glm::length(glm::vec3(worldMat[0])),
+                            glm::length(glm::vec3(worldMat[1])),
+                            glm::length(glm::vec3(worldMat[2]))});
+
+    float radius = glm::length(boundsMax - boundsMin) * 0.5f * scale;
+    float distance = glm::length(center - eye);
+
+    if (distance <= radius)
+        return 1.f;
+
+    float ratio = radius / distance;
+
+    return ratio * ratio;
+}
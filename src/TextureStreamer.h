@@ -0,0 +1,125 @@
+#pragma once
+
+#include "ModelData.h"
+#include "ResourceRegistry.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+class MaterialTable;
+
+// Loads textures after the materials that use them are published, so that the first frame only
+// waits for geometry. Materials refer to a placeholder texture until each of their textures is
+// loaded, and then have it swapped in. Textures load a few at a time, highest priority first, so
+// that priorities set while they stream in - what is nearest and largest on screen - still take
+// effect.
+//
+// Not thread-safe. Loads themselves run on the registry's workers.
+class TextureStreamer
+{
+public:
+    // Starts loading the texture of an image file.
+    using LoadFn = std::function<ResourceHandle(const std::filesystem::path&)>;
+
+    // The ID of a loaded texture.
+    using GetIdFn = std::function<TextureId(const RegisteredResource&)>;
+
+    // At most |maxLoading| textures load at once.
+    TextureStreamer(LoadFn load, GetIdFn getId, TextureId placeholderId, size_t maxLoading);
+
+    // Returns the stream of the image at |path|, adding it if it is new. Streams are numbered
+    // from zero in the order they were added.
+    uint32_t Add(const std::filesystem::path& path);
+
+    // Adds |material| to |table| with the placeholder in place of each texture, and swaps the
+    // textures in as they load. Its texture IDs are stream indices, or -1 for none. A material
+    // without a base color texture keeps the placeholder for it. Returns its table index, which
+    // is not shared with any other material, since its records are about to change.
+    uint32_t AddMaterial(MaterialTable* table, const Material& material);
+
+    // Loads go highest first. Zero to start with.
+    void SetPriority(uint32_t stream, float priority);
+
+    // Call once per frame. Swaps the textures loaded since the last call into |table|, then starts
+    // loading the highest priority textures still queued. Returns the number of materials
+    // changed.
+    size_t Update(MaterialTable* table);
+
+    // Whether every stream has loaded or failed.
+    bool IsDone() const;
+
+    size_t GetNumStreams() const;
+
+    struct Stats
+    {
+        uint64_t NumQueued = 0;
+        uint64_t NumLoading = 0;
+        uint64_t NumLoaded = 0;
+
+        // Failed textures keep the placeholder.
+        uint64_t NumFailed = 0;
+    };
+
+    Stats GetStats() const;
+
+private:
+    enum class StreamState : uint8_t
+    {
+        Queued,
+        Loading,
+        Loaded,
+        Failed
+    };
+
+    struct Stream
+    {
+        std::filesystem::path Path;
+
+        StreamState State = StreamState::Queued;
+        float Priority = 0.f;
+
+        ResourceHandle Handle;
+
+        // Indices into m_materials that use the stream.
+        std::vector<uint32_t> Materials;
+    };
+
+    // A material in the table, with stream indices for texture IDs.
+    struct StreamedMaterial
+    {
+        uint32_t TableIdx = 0;
+        Material Streams;
+    };
+
+    void SwapIn(MaterialTable* table, uint32_t stream, TextureId id);
+
+    LoadFn m_load;
+    GetIdFn m_getId;
+    TextureId m_placeholderId;
+    size_t m_maxLoading;
+
+    std::vector<Stream> m_streams;
+
+    // Keyed the way the registry keys textures by path.
+    std::unordered_map<uint64_t, uint32_t> m_streamsByKey;
+
+    std::vector<StreamedMaterial> m_materials;
+
+    std::vector<uint32_t> m_queued;
+    std::vector<uint32_t> m_loading;
+
+    uint64_t m_numLoaded = 0;
+    uint64_t m_numFailed = 0;
+};
+
+// How much of the view the bounds cover as seen from |eye|, as the square of the ratio of their
+// radius to their distance: 1 when |eye| is inside them, falling off with distance and growing
+// with size. A measure of how noticeable a missing texture is.
+float EstimateScreenCoverage(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                             const glm::mat4& worldMat, const glm::vec3& eye);
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <vector>
+
 namespace utils
 {
 
@@ -8,4 +13,24 @@ inline size_t Align(size_t value, size_t alignment)
     return ((value - 1) / alignment + 1) * alignment;
 }
 
+// Nearest-rank percentile, |p| in [0, 1]. Partially sorts |values|.
+template<typename T>
+T PercentileInPlace(std::span<T> values, double p)
+{
+    if (values.empty())
+        return T{};
+
+    size_t rank = static_cast<size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+
+    return values[rank];
+}
+
+// Takes |values| by copy since it is partially sorted.
+template<typename T>
+T Percentile(std::vector<T> values, double p)
+{
+    return PercentileInPlace(std::span<T>(values), p);
+}
+
 } // namespace utils
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable:4324) // Structure padded due to alignment specifier.
+#endif
+
+// Fixed-capacity Chase-Lev deque. The owning thread pushes and pops at the bottom while any other
+// thread may steal from the top. Memory orderings follow "Correct and Efficient Work-Stealing for
+// Weak Memory Models" (Le et al., 2013).
+template<typename T>
+class WorkStealingQueue
+{
+public:
+    explicit WorkStealingQueue(size_t capacity)
+        : m_capacity(capacity), m_mask(capacity - 1),
+          m_items(std::make_unique<std::atomic<T>[]>(capacity))
+    {
+        static_assert(std::atomic<T>::is_always_lock_free);
+
+        // Indices are wrapped with a mask, so the capacity must be a power of two.
+        assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+    }
+
+    // Owner thread only. Returns false if the queue is full.
+    bool Push(T item)
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_acquire);
+
+        if (bottom - top >= static_cast<int64_t>(m_capacity))
+            return false;
+
+        m_items[bottom & m_mask].store(item, std::memory_order_relaxed);
+
+        m_bottom.store(bottom + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Owner thread only.
+    bool Pop(T* item)
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(bottom, std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        int64_t top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        *item = m_items[bottom & m_mask].load(std::memory_order_relaxed);
+
+        if (top == bottom)
+        {
+            // Last item - race against thieves for it.
+            bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                     std::memory_order_relaxed);
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+
+        return true;
+    }
+
+    // Any thread.
+    bool Steal(T* item)
+    {
+        int64_t top = m_top.load(std::memory_order_acquire);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+            return false;
+
+        T value = m_items[top & m_mask].load(std::memory_order_relaxed);
+
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                           std::memory_order_relaxed))
+            return false;
+
+        *item = value;
+        return true;
+    }
+
+    bool IsEmpty() const
+    {
+        return m_top.load(std::memory_order_relaxed) >= m_bottom.load(std::memory_order_relaxed);
+    }
+
+private:
+    size_t m_capacity;
+    size_t m_mask;
+
+    std::unique_ptr<std::atomic<T>[]> m_items;
+
+    alignas(64) std::atomic<int64_t> m_top = 0;
+    alignas(64) std::atomic<int64_t> m_bottom = 0;
+};
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
@@ -1,20 +1,80 @@
+#include "AllocationTracker.h"
 #include "App.h"
+#include "FixedTimestep.h"
+#include "FrameArena.h"
+#include "FramePacer.h"
 #include "InputManager.h"
+#include "InputRecording.h"
+#include "RenderThread.h"
 
 #include <imgui_impl_win32.h>
 #include <windows.h>
 
 #include <chrono>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
 
 static InputManager* g_inputManager = nullptr;
 
+// ImGui's message handler runs here while the render thread builds the GUI.
+static std::mutex g_guiMutex;
+
+static uint8_t GetModifiers()
+{
+    uint8_t modifiers = ModifierKey::None;
+
+    if (GetKeyState(VK_SHIFT) < 0)
+        modifiers |= ModifierKey::Shift;
+
+    if (GetKeyState(VK_CONTROL) < 0)
+        modifiers |= ModifierKey::Ctrl;
+
+    return modifiers;
+}
+
+static int64_t GetSteadyTime()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// GetMessageTime() is when the OS generated the current message, in milliseconds on the
+// GetTickCount() clock. It is rebased onto the steady clock by its age.
+static int64_t GetMessageTimestamp()
+{
+    DWORD ageMs = GetTickCount() - static_cast<DWORD>(GetMessageTime());
+
+    return GetSteadyTime() - static_cast<int64_t>(ageMs) * 1'000'000;
+}
+
+static void PushInputEvent(InputEventType type, int64_t timestamp, uint32_t code,
+                           int32_t deltaX = 0, int32_t deltaY = 0)
+{
+    InputEvent event{};
+    event.Timestamp = timestamp;
+    event.Type = type;
+    event.Modifiers = GetModifiers();
+    event.Code = code;
+    event.DeltaX = deltaX;
+    event.DeltaY = deltaY;
+
+    g_inputManager->PushEvent(event);
+}
+
 extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND, UINT, WPARAM, LPARAM);
 
 static LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
 {
-    if (ImGui_ImplWin32_WndProcHandler(hwnd, msg, wparam, lparam))
-        return 1;
+    {
+        std::lock_guard lock(g_guiMutex);
+
+        if (ImGui_ImplWin32_WndProcHandler(hwnd, msg, wparam, lparam))
+            return 1;
+    }
 
     switch (msg)
     {
@@ -29,16 +89,22 @@ static LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lp
         {
             case WM_KEYDOWN:
                 if ((HIWORD(lparam) & KF_REPEAT) != KF_REPEAT)
-                    g_inputManager->HandleKeyDown(static_cast<UINT>(wparam));
+                {
+                    PushInputEvent(InputEventType::KeyDown, GetMessageTimestamp(),
+                                   static_cast<uint32_t>(wparam));
+                }
                 break;
             case WM_KEYUP:
-                g_inputManager->HandleKeyUp(static_cast<UINT>(wparam));
+                PushInputEvent(InputEventType::KeyUp, GetMessageTimestamp(),
+                               static_cast<uint32_t>(wparam));
                 break;
             case WM_MBUTTONDOWN:
-                g_inputManager->HandleMouseDown(MouseButton::Middle);
+                PushInputEvent(InputEventType::MouseDown, GetMessageTimestamp(),
+                               static_cast<uint32_t>(MouseButton::Middle));
                 break;
             case WM_MBUTTONUP:
-                g_inputManager->HandleMouseUp(MouseButton::Middle);
+                PushInputEvent(InputEventType::MouseUp, GetMessageTimestamp(),
+                               static_cast<uint32_t>(MouseButton::Middle));
                 break;
         }
     }
@@ -52,8 +118,73 @@ static void CheckMMResult(MMRESULT result)
         throw std::runtime_error("Invalid MMResult.");
 }
 
-int WINAPI WinMain(HINSTANCE hinstance, HINSTANCE, LPSTR, int cmdShow)
+static double GetDisplayRefreshRate()
+{
+    static constexpr double defaultRefreshRate = 60.0;
+
+    DEVMODE devMode{};
+    devMode.dmSize = sizeof(DEVMODE);
+
+    if (!EnumDisplaySettings(nullptr, ENUM_CURRENT_SETTINGS, &devMode))
+        return defaultRefreshRate;
+
+    // 0 and 1 both mean the hardware's default rate.
+    if (devMode.dmDisplayFrequency <= 1)
+        return defaultRefreshRate;
+
+    return static_cast<double>(devMode.dmDisplayFrequency);
+}
+
+// The cursor is sampled once per frame rather than through WM_MOUSEMOVE so that movement
+// outside the window (e.g. while looking around in FPS mode) is still seen.
+static void PushCursorDelta(std::optional<POINT>* prevCursorPos)
+{
+    POINT cursorPos{};
+    if (!GetCursorPos(&cursorPos))
+        return;
+
+    if (*prevCursorPos &&
+        (cursorPos.x != (*prevCursorPos)->x || cursorPos.y != (*prevCursorPos)->y))
+    {
+        PushInputEvent(InputEventType::MouseMove, GetSteadyTime(), 0,
+                       cursorPos.x - (*prevCursorPos)->x, cursorPos.y - (*prevCursorPos)->y);
+    }
+
+    *prevCursorPos = cursorPos;
+}
+
+struct CommandLineOptions
+{
+    std::string RecordInputPath;
+    std::string ReplayInputPath;
+};
+
+static CommandLineOptions ParseCommandLine(LPSTR cmdLine)
+{
+    CommandLineOptions options;
+
+    std::istringstream strm(cmdLine);
+    std::string arg;
+
+    while (strm >> arg)
+    {
+        if (arg == "--record-input")
+        {
+            strm >> options.RecordInputPath;
+        }
+        else if (arg == "--replay-input")
+        {
+            strm >> options.ReplayInputPath;
+        }
+    }
+
+    return options;
+}
+
+int WINAPI WinMain(HINSTANCE hinstance, HINSTANCE, LPSTR cmdLine, int cmdShow)
 {
+    CommandLineOptions options = ParseCommandLine(cmdLine);
+
     WNDCLASSEX windowClass{};
     windowClass.cbSize = sizeof(WNDCLASSEX);
     windowClass.style = CS_HREDRAW | CS_VREDRAW;
@@ -68,13 +199,10 @@ int WINAPI WinMain(HINSTANCE hinstance, HINSTANCE, LPSTR, int cmdShow)
                              nullptr);
     ShowWindow(hwnd, cmdShow);
 
-    // Needed by WIC - used in GpuResourceManager to decode images.
-    CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
-
     auto inputManager = std::make_unique<InputManager>();
     g_inputManager = inputManager.get();
 
-    auto app = std::make_unique<App>(hwnd, inputManager.get());
+    auto app = std::make_unique<App>(hwnd, inputManager.get(), &g_guiMutex);
 
     static constexpr int timerResolutionMs = 1;
 
@@ -84,45 +212,107 @@ int WINAPI WinMain(HINSTANCE hinstance, HINSTANCE, LPSTR, int cmdShow)
     if (timecaps.wPeriodMin > timerResolutionMs)
         exit(-1);
 
-    // Sets the resolution of Sleep().
+    // Sets the resolution of Sleep(). The frame pacer spins for whatever Sleep() overshoots.
     CheckMMResult(timeBeginPeriod(timerResolutionMs));
 
-    MSG msg{};
+    SteadyClock clock;
+    FramePacer framePacer(&clock, GetDisplayRefreshRate());
+
+    FixedTimestep timestep(FixedTimestep::DEFAULT_STEP_SEC);
+
+    auto renderThread = std::make_unique<RenderThread>(app.get(), &clock);
+
+    // Input is recorded or replayed at frame boundaries - every frame consumes exactly the events
+    // that were delivered before it started, along with its elapsed time.
+    std::optional<InputRecording> inputRecording;
+    std::optional<InputReplayer> inputReplayer;
+
+    if (!options.ReplayInputPath.empty())
+    {
+        inputReplayer.emplace(InputRecording::Load(options.ReplayInputPath));
+    }
+    else if (!options.RecordInputPath.empty())
+    {
+        inputRecording.emplace();
+    }
+
+    std::optional<POINT> prevCursorPos;
 
-    auto prevTime = std::chrono::steady_clock::now();
-    double prevDuration = 0.0;
+    MSG msg{};
 
     while (msg.message != WM_QUIT)
     {
+        // Wait before pumping messages so the frame sees the most recent input.
+        double elapsedSec = framePacer.BeginFrame();
+
         while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
         {
             TranslateMessage(&msg);
             DispatchMessage(&msg);
         }
 
-        app->Tick(prevDuration);
+        PushCursorDelta(&prevCursorPos);
+
+        AllocationTracker::SetSubsystem(AllocationSubsystem::Input);
 
-        app->Render();
+        inputManager->CollectEvents();
+
+        if (inputReplayer)
+        {
+            if (inputReplayer->IsFinished())
+                break;
 
-        auto endTime = std::chrono::steady_clock::now();
-        double duration = std::chrono::duration<double>(endTime - prevTime).count();
+            // Live input is replaced so that it cannot perturb the replay.
+            const InputFrame& frame = inputReplayer->NextFrame();
 
-        static constexpr double minFrameTime = 1.0 / 60.0;
+            inputManager->SetFrameEvents(frame.Events);
 
-        if (duration < minFrameTime)
+            elapsedSec = frame.ElapsedSec;
+        }
+        else if (inputRecording)
         {
-            int sleepMs = static_cast<int>(std::ceil((minFrameTime - duration) * 1000.0));
+            std::span<const InputEvent> events = inputManager->GetFrameEvents();
+
+            inputRecording->Frames.push_back(
+                InputFrame{elapsedSec, std::vector<InputEvent>(events.begin(), events.end())});
+        }
+
+        inputManager->DispatchEvents();
 
-            Sleep(sleepMs);
+        AllocationTracker::SetSubsystem(AllocationSubsystem::Simulation);
 
-            endTime = std::chrono::steady_clock::now();
-            duration = std::chrono::duration<double>(endTime - prevTime).count();
+        int numSteps = timestep.Advance(elapsedSec);
+
+        for (int i = 0; i < numSteps; ++i)
+        {
+            app->Tick(timestep.GetStepSec());
         }
 
-        prevTime = endTime;
-        prevDuration = duration;
+        AllocationTracker::SetSubsystem(AllocationSubsystem::Other);
+
+        FramePacket& packet = renderThread->BeginPacket();
+        app->BuildFramePacket(framePacer.GetFrameIdx(), timestep.GetAlpha(), &packet);
+        renderThread->SubmitPacket();
+
+        FrameArena::EndThreadFrame();
+
+        framePacer.EndFrame();
+
+        // Presents happen on the render thread, so a frame's work runs on past EndFrame(). The
+        // pacer hears of them a frame or so late, which is soon enough to plan the next frames.
+        RenderThread::PresentedPacket presented;
+
+        if (renderThread->TryGetPresentedPacket(&presented))
+            framePacer.FramePresented(presented.FrameIdx, presented.Time);
     }
 
+    renderThread.reset();
+
+    timeEndPeriod(timerResolutionMs);
+
+    if (inputRecording)
+        inputRecording->Save(options.RecordInputPath);
+
     app.reset();
 
     g_inputManager = nullptr;